@@ -0,0 +1,119 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "AmbientOcclusion.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    constexpr float kTwoPi = 6.28318530718f;
+
+    float RadicalInverse(uint32_t bits)
+    {
+        bits = (bits << 16) | (bits >> 16);
+        bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+        bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+        bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+        bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+        return float(bits) * 2.3283064365386963e-10f;
+    }
+
+    // per-vertex offset of the sample pattern, so neighbours do not band
+    float HashToUnit(uint32_t x)
+    {
+        x ^= x >> 16; x *= 0x7FEB352Du;
+        x ^= x >> 15; x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return float(x >> 8) * (1.f / 16777216.f);
+    }
+
+    // Duff et al. orthonormal basis around a unit normal
+    void Basis(const float n[3], float t[3], float b[3])
+    {
+        const float sign = std::copysign(1.f, n[2]);
+        const float a = -1.f / (sign + n[2]);
+        const float c = n[0] * n[1] * a;
+        t[0] = 1.f + sign * n[0] * n[0] * a; t[1] = sign * c; t[2] = -sign * n[0];
+        b[0] = c; b[1] = sign + n[1] * n[1] * a; b[2] = -n[1];
+    }
+}
+
+AmbientOcclusion::Stats AmbientOcclusion::Bake(MeshData& mesh, const MeshBVH& bvh, const Settings& settings)
+{
+    Stats stats;
+    const auto t0 = std::chrono::steady_clock::now();
+    const size_t count = mesh.vertices.size();
+    const uint32_t rays = std::max(1u, settings.raysPerVertex);
+    if (count == 0 || bvh.Empty()) return stats;
+
+    float mn[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, mx[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (const Vertex& v : mesh.vertices) {
+        const float p[3] = { v.px, v.py, v.pz };
+        for (int a = 0; a < 3; ++a) { mn[a] = std::min(mn[a], p[a]); mx[a] = std::max(mx[a], p[a]); }
+    }
+    const float diag = std::sqrt((mx[0] - mn[0]) * (mx[0] - mn[0]) + (mx[1] - mn[1]) * (mx[1] - mn[1]) + (mx[2] - mn[2]) * (mx[2] - mn[2]));
+    const float reach = std::max(settings.maxDistance * diag, 1e-6f);
+    const float bias = settings.bias * diag;
+
+    // cosine-weighted Hammersley set in the local frame, shared by all vertices
+    std::vector<float> pattern(size_t(rays) * 2);
+    for (uint32_t i = 0; i < rays; ++i) {
+        pattern[i * 2] = (float(i) + 0.5f) / float(rays);
+        pattern[i * 2 + 1] = RadicalInverse(i);
+    }
+
+    std::atomic<uint64_t> traced{ 0 };
+    JobSystem::I().ParallelFor(count, 64, [&](size_t begin, size_t end) {
+        uint64_t local = 0;
+        for (size_t i = begin; i < end; ++i) {
+            Vertex& v = mesh.vertices[i];
+            float n[3] = { v.nx, v.ny, v.nz };
+            const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (!(len > 0.f)) { v.ao = 1.f; continue; }
+            for (float& c : n) c /= len;
+            float t[3], b[3];
+            Basis(n, t, b);
+
+            BVHRay ray;
+            ray.origin[0] = v.px + n[0] * bias;
+            ray.origin[1] = v.py + n[1] * bias;
+            ray.origin[2] = v.pz + n[2] * bias;
+            ray.tMax = reach;
+
+            // Cranley-Patterson rotation of the azimuth
+            const float rotate = HashToUnit(uint32_t(i));
+            uint32_t hits = 0;
+            for (uint32_t r = 0; r < rays; ++r) {
+                const float u = pattern[r * 2];
+                float w = pattern[r * 2 + 1] + rotate;
+                if (w >= 1.f) w -= 1.f;
+                const float rad = std::sqrt(u);
+                const float phi = kTwoPi * w;
+                const float x = rad * std::cos(phi), y = rad * std::sin(phi), z = std::sqrt(std::max(0.f, 1.f - u));
+                for (int a = 0; a < 3; ++a) ray.dir[a] = t[a] * x + b[a] * y + n[a] * z;
+                if (bvh.Occluded(ray)) ++hits;
+            }
+            local += rays;
+            v.ao = 1.f - float(hits) / float(rays);
+        }
+        traced.fetch_add(local, std::memory_order_relaxed);
+    });
+
+    double sum = 0.0;
+    for (const Vertex& v : mesh.vertices) sum += v.ao;
+    stats.rays = traced.load();
+    stats.averageAO = float(sum / double(count));
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return stats;
+}
+
+AmbientOcclusion::Stats AmbientOcclusion::Bake(MeshData& mesh, const Settings& settings)
+{
+    MeshBVH bvh;
+    bvh.Build(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size());
+    return Bake(mesh, bvh, settings);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include "MeshBVH.h"
+#include "MeshData.h"
+
+// GPU-free per-vertex ambient occlusion bake. Each vertex fires
+// cosine-weighted rays over the hemisphere of its normal against the mesh's
+// own BVH and stores the unoccluded fraction in Vertex::ao, which the pixel
+// shader applies to the ambient term only.
+namespace AmbientOcclusion
+{
+    struct Settings
+    {
+        uint32_t raysPerVertex = 64;
+        // ray length relative to the bounding box diagonal; occluders further
+        // away do not darken
+        float maxDistance = 0.1f;
+        // start offset along the normal, relative to the bounding box diagonal
+        float bias = 1e-4f;
+    };
+
+    struct Stats
+    {
+        uint64_t rays = 0;
+        double seconds = 0.0;
+        float averageAO = 1.f;
+    };
+
+    // bump when the output of Bake changes, cooked files are rebuilt
+    constexpr uint32_t kVersion = 1;
+
+    // bvh must have been built from mesh. Deterministic for a given mesh and
+    // settings, whatever the number of worker threads.
+    Stats Bake(MeshData& mesh, const MeshBVH& bvh, const Settings& settings = {});
+
+    // Builds a temporary BVH when the caller has none.
+    Stats Bake(MeshData& mesh, const Settings& settings = {});
+}
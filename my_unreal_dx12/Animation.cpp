@@ -0,0 +1,530 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "Animation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// ANIMATION_SCALAR forces the scalar loops, for comparison (tools/AnimationBench)
+#if !defined(ANIMATION_SCALAR) && (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__))
+#include <emmintrin.h>
+#define ANIMATION_SSE2 1
+#endif
+
+namespace
+{
+    constexpr float kRotationRange = 0.70710678f;  // smallest three lie in [-1/sqrt2, 1/sqrt2]
+    constexpr float kRotationQuant = 32767.f / (2.f * kRotationRange);
+
+    uint16_t Quantize16(float v, float min, float extent)
+    {
+        if (extent <= 0.f) return 0;
+        const float q = (v - min) / extent * 65535.f + 0.5f;
+        return uint16_t(std::clamp(q, 0.f, 65535.f));
+    }
+
+    void EncodeRotation(const float* q, uint16_t* out)
+    {
+        int largest = 0;
+        for (int i = 1; i < 4; ++i)
+            if (std::fabs(q[i]) > std::fabs(q[largest])) largest = i;
+        const float sign = q[largest] < 0.f ? -1.f : 1.f;
+
+        uint16_t v[3];
+        for (int i = 0, k = 0; i < 4; ++i) {
+            if (i == largest) continue;
+            const float x = std::clamp(q[i] * sign, -kRotationRange, kRotationRange);
+            v[k++] = uint16_t((x + kRotationRange) * kRotationQuant + 0.5f);
+        }
+        out[0] = uint16_t(v[0] | ((largest & 1) << 15));
+        out[1] = uint16_t(v[1] | ((largest >> 1) << 15));
+        out[2] = v[2];
+    }
+
+    void DecodeRotation(const uint16_t* in, float* q)
+    {
+        const int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+        float sum = 0.f;
+        for (int i = 0, k = 0; i < 4; ++i) {
+            if (i == largest) continue;
+            const float x = float(in[k++] & 0x7FFF) / kRotationQuant - kRotationRange;
+            q[i] = x;
+            sum += x * x;
+        }
+        q[largest] = std::sqrt(std::max(0.f, 1.f - sum));
+    }
+
+    void Normalize4(float* q)
+    {
+        const float len = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        if (len <= 0.f) { q[0] = q[1] = q[2] = 0.f; q[3] = 1.f; return; }
+        for (int i = 0; i < 4; ++i) q[i] /= len;
+    }
+
+    // linear (or normalized linear for quaternions) interpolation of sample
+    // a and b of a track evaluated at frame f, compared to sample f
+    bool Reproduces(const float* s, int comps, uint32_t a, uint32_t b, uint32_t f, float tolerance, bool rotation)
+    {
+        const float t = float(f - a) / float(b - a);
+        float v[4];
+        for (int k = 0; k < comps; ++k)
+            v[k] = s[a * 4 + k] + (s[b * 4 + k] - s[a * 4 + k]) * t;
+        if (rotation) Normalize4(v);
+        for (int k = 0; k < comps; ++k)
+            if (std::fabs(v[k] - s[f * 4 + k]) > tolerance) return false;
+        return true;
+    }
+
+    // Greedy key reduction: extend each segment while its end points
+    // reproduce every sample in between.
+    void ReduceKeys(const float* s, int comps, uint32_t frames, float tolerance, bool rotation, std::vector<uint32_t>& keys)
+    {
+        keys.assign(1, 0);
+        if (frames <= 1) return;
+
+        bool constant = true;
+        for (uint32_t f = 1; f < frames && constant; ++f)
+            for (int k = 0; k < comps; ++k)
+                if (std::fabs(s[f * 4 + k] - s[k]) > tolerance) { constant = false; break; }
+        if (constant) return;
+
+        uint32_t last = 0;
+        for (uint32_t end = 2; end < frames; ++end) {
+            for (uint32_t f = last + 1; f < end; ++f) {
+                if (!Reproduces(s, comps, last, end, f, tolerance, rotation)) {
+                    last = end - 1;
+                    keys.push_back(last);
+                    break;
+                }
+            }
+        }
+        keys.push_back(frames - 1);
+    }
+
+    // out = a + (b - a) * w with per joint weights for the three channels
+    void LerpPoses(const Pose& a, const Pose& b, const float* wt, const float* wr, const float* ws, Pose& out)
+    {
+        const size_t n = out.PaddedCount();
+#if ANIMATION_SSE2
+        const __m128 signMask = _mm_set1_ps(-0.f);
+        for (size_t i = 0; i < n; i += 4) {
+            const __m128 t = _mm_loadu_ps(wt + i);
+            for (int s = Pose::TX; s <= Pose::TZ; ++s) {
+                const __m128 va = _mm_loadu_ps(a[Pose::Stream(s)] + i);
+                const __m128 vb = _mm_loadu_ps(b[Pose::Stream(s)] + i);
+                _mm_storeu_ps(out[Pose::Stream(s)] + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), t)));
+            }
+            const __m128 sc = _mm_loadu_ps(ws + i);
+            for (int s = Pose::SX; s <= Pose::SZ; ++s) {
+                const __m128 va = _mm_loadu_ps(a[Pose::Stream(s)] + i);
+                const __m128 vb = _mm_loadu_ps(b[Pose::Stream(s)] + i);
+                _mm_storeu_ps(out[Pose::Stream(s)] + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), sc)));
+            }
+
+            __m128 qa[4], qb[4];
+            for (int k = 0; k < 4; ++k) {
+                qa[k] = _mm_loadu_ps(a[Pose::Stream(Pose::RX + k)] + i);
+                qb[k] = _mm_loadu_ps(b[Pose::Stream(Pose::RX + k)] + i);
+            }
+            __m128 dot = _mm_mul_ps(qa[0], qb[0]);
+            for (int k = 1; k < 4; ++k) dot = _mm_add_ps(dot, _mm_mul_ps(qa[k], qb[k]));
+            // shorter arc: flip b where the dot product is negative
+            const __m128 flip = _mm_and_ps(dot, signMask);
+            const __m128 r = _mm_loadu_ps(wr + i);
+            __m128 q[4];
+            __m128 len2 = _mm_setzero_ps();
+            for (int k = 0; k < 4; ++k) {
+                q[k] = _mm_add_ps(qa[k], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(qb[k], flip), qa[k]), r));
+                len2 = _mm_add_ps(len2, _mm_mul_ps(q[k], q[k]));
+            }
+            const __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(len2));
+            for (int k = 0; k < 4; ++k)
+                _mm_storeu_ps(out[Pose::Stream(Pose::RX + k)] + i, _mm_mul_ps(q[k], inv));
+        }
+#else
+        for (size_t i = 0; i < n; ++i) {
+            for (int s = Pose::TX; s <= Pose::TZ; ++s) {
+                const float va = a[Pose::Stream(s)][i], vb = b[Pose::Stream(s)][i];
+                out[Pose::Stream(s)][i] = va + (vb - va) * wt[i];
+            }
+            for (int s = Pose::SX; s <= Pose::SZ; ++s) {
+                const float va = a[Pose::Stream(s)][i], vb = b[Pose::Stream(s)][i];
+                out[Pose::Stream(s)][i] = va + (vb - va) * ws[i];
+            }
+            float qa[4], qb[4], dot = 0.f;
+            for (int k = 0; k < 4; ++k) {
+                qa[k] = a[Pose::Stream(Pose::RX + k)][i];
+                qb[k] = b[Pose::Stream(Pose::RX + k)][i];
+                dot += qa[k] * qb[k];
+            }
+            const float flip = dot < 0.f ? -1.f : 1.f;
+            float q[4];
+            for (int k = 0; k < 4; ++k) q[k] = qa[k] + (qb[k] * flip - qa[k]) * wr[i];
+            Normalize4(q);
+            for (int k = 0; k < 4; ++k) out[Pose::Stream(Pose::RX + k)][i] = q[k];
+        }
+#endif
+    }
+
+    // out = a * b for affine column-major matrices
+    void MulAffine(const JointMatrix& a, const JointMatrix& b, JointMatrix& out)
+    {
+#if ANIMATION_SSE2
+        const __m128 a0 = _mm_load_ps(a.c[0]), a1 = _mm_load_ps(a.c[1]);
+        const __m128 a2 = _mm_load_ps(a.c[2]), a3 = _mm_load_ps(a.c[3]);
+        __m128 r[4];
+        for (int k = 0; k < 4; ++k) {
+            const __m128 bk = _mm_load_ps(b.c[k]);
+            r[k] = _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(a0, _mm_shuffle_ps(bk, bk, _MM_SHUFFLE(0, 0, 0, 0))),
+                _mm_mul_ps(a1, _mm_shuffle_ps(bk, bk, _MM_SHUFFLE(1, 1, 1, 1)))),
+                _mm_mul_ps(a2, _mm_shuffle_ps(bk, bk, _MM_SHUFFLE(2, 2, 2, 2))));
+        }
+        r[3] = _mm_add_ps(r[3], a3);
+        for (int k = 0; k < 4; ++k) _mm_store_ps(out.c[k], r[k]);
+#else
+        JointMatrix r;
+        for (int k = 0; k < 4; ++k)
+            for (int i = 0; i < 4; ++i)
+                r.c[k][i] = a.c[0][i] * b.c[k][0] + a.c[1][i] * b.c[k][1] + a.c[2][i] * b.c[k][2] + (k == 3 ? a.c[3][i] : 0.f);
+        out = r;
+#endif
+    }
+
+    // local matrices of every joint of the pose, four joints per iteration
+    void LocalMatrices(const Pose& pose, JointMatrix* out)
+    {
+        const size_t n = pose.JointCount();
+#if ANIMATION_SSE2
+        const __m128 one = _mm_set1_ps(1.f);
+        for (size_t i = 0; i < n; i += 4) {
+            const __m128 x = _mm_loadu_ps(pose[Pose::RX] + i), y = _mm_loadu_ps(pose[Pose::RY] + i);
+            const __m128 z = _mm_loadu_ps(pose[Pose::RZ] + i), w = _mm_loadu_ps(pose[Pose::RW] + i);
+            const __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+            const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+            const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+            const __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+            const __m128 sx = _mm_loadu_ps(pose[Pose::SX] + i);
+            const __m128 sy = _mm_loadu_ps(pose[Pose::SY] + i);
+            const __m128 sz = _mm_loadu_ps(pose[Pose::SZ] + i);
+
+            // rows of the transposes: column k of joint j ends up in lane j
+            __m128 c[4][4] = {
+                { _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_add_ps(xy, wz), sx), _mm_mul_ps(_mm_sub_ps(xz, wy), sx), _mm_setzero_ps() },
+                { _mm_mul_ps(_mm_sub_ps(xy, wz), sy), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy), _mm_mul_ps(_mm_add_ps(yz, wx), sy), _mm_setzero_ps() },
+                { _mm_mul_ps(_mm_add_ps(xz, wy), sz), _mm_mul_ps(_mm_sub_ps(yz, wx), sz), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), _mm_setzero_ps() },
+                { _mm_loadu_ps(pose[Pose::TX] + i), _mm_loadu_ps(pose[Pose::TY] + i), _mm_loadu_ps(pose[Pose::TZ] + i), one },
+            };
+            for (int k = 0; k < 4; ++k)
+                _MM_TRANSPOSE4_PS(c[k][0], c[k][1], c[k][2], c[k][3]);
+
+            const size_t count = std::min<size_t>(4, n - i);
+            for (size_t j = 0; j < count; ++j)
+                for (int k = 0; k < 4; ++k)
+                    _mm_store_ps(out[i + j].c[k], c[k][j]);
+        }
+#else
+        for (size_t i = 0; i < n; ++i) {
+            const float x = pose[Pose::RX][i], y = pose[Pose::RY][i], z = pose[Pose::RZ][i], w = pose[Pose::RW][i];
+            const float xx = 2 * x * x, yy = 2 * y * y, zz = 2 * z * z;
+            const float xy = 2 * x * y, xz = 2 * x * z, yz = 2 * y * z;
+            const float wx = 2 * w * x, wy = 2 * w * y, wz = 2 * w * z;
+            const float sx = pose[Pose::SX][i], sy = pose[Pose::SY][i], sz = pose[Pose::SZ][i];
+            JointMatrix& m = out[i];
+            m.c[0][0] = (1 - yy - zz) * sx; m.c[0][1] = (xy + wz) * sx; m.c[0][2] = (xz - wy) * sx; m.c[0][3] = 0;
+            m.c[1][0] = (xy - wz) * sy; m.c[1][1] = (1 - xx - zz) * sy; m.c[1][2] = (yz + wx) * sy; m.c[1][3] = 0;
+            m.c[2][0] = (xz + wy) * sz; m.c[2][1] = (yz - wx) * sz; m.c[2][2] = (1 - xx - yy) * sz; m.c[2][3] = 0;
+            m.c[3][0] = pose[Pose::TX][i]; m.c[3][1] = pose[Pose::TY][i]; m.c[3][2] = pose[Pose::TZ][i]; m.c[3][3] = 1;
+        }
+#endif
+    }
+
+#if ANIMATION_SSE2
+    inline __m128 Normalize3(__m128 v)
+    {
+        __m128 d = _mm_mul_ps(v, v);
+        d = _mm_add_ps(_mm_add_ps(_mm_shuffle_ps(d, d, _MM_SHUFFLE(0, 0, 0, 0)),
+            _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 2, 2, 2)));
+        const __m128 len = _mm_sqrt_ps(d);
+        // zero vectors stay zero
+        return _mm_and_ps(_mm_div_ps(v, len), _mm_cmpgt_ps(len, _mm_setzero_ps()));
+    }
+
+    inline __m128 Transform3(const __m128* c, float x, float y, float z)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], _mm_set1_ps(x)), _mm_mul_ps(c[1], _mm_set1_ps(y))),
+            _mm_mul_ps(c[2], _mm_set1_ps(z)));
+    }
+#endif
+}
+
+JointMatrix JointMatrix::Identity()
+{
+    JointMatrix m{};
+    m.c[0][0] = m.c[1][1] = m.c[2][2] = m.c[3][3] = 1.f;
+    return m;
+}
+
+JointMatrix JointMatrix::FromColumnMajor4x4(const float m[16])
+{
+    JointMatrix r;
+    for (int k = 0; k < 4; ++k) {
+        for (int i = 0; i < 3; ++i) r.c[k][i] = m[k * 4 + i];
+        r.c[k][3] = k == 3 ? 1.f : 0.f;
+    }
+    return r;
+}
+
+void Pose::Resize(size_t jointCount)
+{
+    if (jointCount == m_jointCount && !m_data.empty()) return;
+    m_jointCount = jointCount;
+    m_padded = (jointCount + 3) & ~size_t(3);
+    m_data.assign(size_t(StreamCount) * m_padded, 0.f);
+    // identity padding keeps the SIMD lanes past the last joint finite
+    std::fill_n((*this)[RW], m_padded, 1.f);
+    for (int s = SX; s <= SZ; ++s)
+        std::fill_n((*this)[Stream(s)], m_padded, 1.f);
+}
+
+void Pose::SetBindPose(const Skeleton& skeleton)
+{
+    Resize(skeleton.JointCount());
+    for (size_t j = 0; j < skeleton.JointCount(); ++j)
+        Set(j, skeleton.bindPose[j]);
+}
+
+void Pose::Set(size_t joint, const JointTransform& x)
+{
+    for (int k = 0; k < 3; ++k) (*this)[Stream(TX + k)][joint] = x.t[k];
+    for (int k = 0; k < 4; ++k) (*this)[Stream(RX + k)][joint] = x.r[k];
+    for (int k = 0; k < 3; ++k) (*this)[Stream(SX + k)][joint] = x.s[k];
+}
+
+JointTransform Pose::Get(size_t joint) const
+{
+    JointTransform x;
+    for (int k = 0; k < 3; ++k) x.t[k] = (*this)[Stream(TX + k)][joint];
+    for (int k = 0; k < 4; ++k) x.r[k] = (*this)[Stream(RX + k)][joint];
+    for (int k = 0; k < 3; ++k) x.s[k] = (*this)[Stream(SX + k)][joint];
+    return x;
+}
+
+AnimationClip AnimationClip::Compress(const RawClip& raw, size_t jointCount, const ClipCompression& settings)
+{
+    AnimationClip clip;
+    clip.m_name = raw.name;
+    clip.m_sampleRate = raw.sampleRate > 0.f ? raw.sampleRate : 30.f;
+    clip.m_jointCount = uint32_t(jointCount);
+    const uint32_t frames = jointCount ? std::min<uint32_t>(raw.frameCount, uint32_t(raw.frames.size() / jointCount)) : 0;
+    // key times are 16-bit frame numbers
+    clip.m_frameCount = std::min<uint32_t>(frames, 65536u);
+    clip.m_tracks.resize(jointCount * ChannelCount);
+    if (clip.m_frameCount == 0) {
+        clip.m_tracks.clear();
+        clip.m_jointCount = 0;
+        return clip;
+    }
+
+    std::vector<float> samples(size_t(clip.m_frameCount) * 4);
+    std::vector<uint32_t> keys;
+
+    for (size_t j = 0; j < jointCount; ++j) {
+        for (int ch = 0; ch < ChannelCount; ++ch) {
+            const bool rotation = ch == Rotation;
+            const int comps = rotation ? 4 : 3;
+            for (uint32_t f = 0; f < clip.m_frameCount; ++f) {
+                const JointTransform& x = raw.frames[size_t(f) * jointCount + j];
+                const float* src = ch == Translation ? x.t : (rotation ? x.r : x.s);
+                float* dst = &samples[size_t(f) * 4];
+                for (int k = 0; k < comps; ++k) dst[k] = src[k];
+                if (rotation) {
+                    Normalize4(dst);
+                    // keep consecutive samples in one hemisphere so lerp takes the short way
+                    if (f > 0 && dst[0] * dst[-4] + dst[1] * dst[-3] + dst[2] * dst[-2] + dst[3] * dst[-1] < 0.f)
+                        for (int k = 0; k < 4; ++k) dst[k] = -dst[k];
+                }
+            }
+
+            const float tolerance = ch == Translation ? settings.translationTolerance :
+                (rotation ? settings.rotationTolerance : settings.scaleTolerance);
+            ReduceKeys(samples.data(), comps, clip.m_frameCount, tolerance, rotation, keys);
+
+            Track& track = clip.m_tracks[j * ChannelCount + ch];
+            track.firstKey = uint32_t(clip.m_keyFrames.size());
+            track.keyCount = uint32_t(keys.size());
+
+            if (!rotation) {
+                float lo[3] = { INFINITY, INFINITY, INFINITY }, hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+                for (uint32_t k : keys)
+                    for (int c = 0; c < 3; ++c) {
+                        lo[c] = std::min(lo[c], samples[k * 4 + c]);
+                        hi[c] = std::max(hi[c], samples[k * 4 + c]);
+                    }
+                for (int c = 0; c < 3; ++c) {
+                    track.min[c] = lo[c];
+                    track.extent[c] = hi[c] - lo[c];
+                }
+            }
+
+            for (uint32_t k : keys) {
+                clip.m_keyFrames.push_back(uint16_t(k));
+                uint16_t q[3];
+                if (rotation)
+                    EncodeRotation(&samples[k * 4], q);
+                else
+                    for (int c = 0; c < 3; ++c) q[c] = Quantize16(samples[k * 4 + c], track.min[c], track.extent[c]);
+                clip.m_keyValues.insert(clip.m_keyValues.end(), q, q + 3);
+            }
+        }
+    }
+    clip.m_keyFrames.shrink_to_fit();
+    clip.m_keyValues.shrink_to_fit();
+    return clip;
+}
+
+size_t AnimationClip::MemoryBytes() const
+{
+    return sizeof(*this) + m_name.capacity() + m_tracks.capacity() * sizeof(Track) +
+        m_keyFrames.capacity() * sizeof(uint16_t) + m_keyValues.capacity() * sizeof(uint16_t);
+}
+
+void AnimationClip::DecodeKey(const Track& track, Channel channel, uint32_t key, float* out) const
+{
+    const uint16_t* q = &m_keyValues[size_t(track.firstKey + key) * 3];
+    if (channel == Rotation) {
+        DecodeRotation(q, out);
+        return;
+    }
+    for (int c = 0; c < 3; ++c)
+        out[c] = track.min[c] + float(q[c]) * (track.extent[c] * (1.f / 65535.f));
+}
+
+void AnimationClip::Sample(float time, bool loop, Pose& out) const
+{
+    if (m_frameCount == 0) return;
+
+    const float last = float(m_frameCount - 1);
+    float f = time * m_sampleRate;
+    if (m_frameCount == 1) f = 0.f;
+    else if (loop) {
+        f = std::fmod(f, last);
+        if (f < 0.f) f += last;
+    }
+    else f = std::clamp(f, 0.f, last);
+    const uint16_t frame = uint16_t(std::min(std::floor(f), last));
+
+    // keys on either side of f go to out and next, then one SIMD pass
+    // interpolates all joints
+    thread_local Pose next;
+    thread_local std::vector<float> weights;
+    next.Resize(m_jointCount);
+    const size_t padded = next.PaddedCount();
+    weights.assign(padded * ChannelCount, 0.f);
+
+    for (uint32_t j = 0; j < m_jointCount; ++j) {
+        for (int ch = 0; ch < ChannelCount; ++ch) {
+            const Track& track = m_tracks[size_t(j) * ChannelCount + ch];
+            uint32_t a = 0, b = 0;
+            if (track.keyCount > 1) {
+                const uint16_t* frames = &m_keyFrames[track.firstKey];
+                a = uint32_t(std::upper_bound(frames, frames + track.keyCount, frame) - frames);
+                a = std::min(a ? a - 1 : 0, track.keyCount - 2);
+                b = a + 1;
+                weights[size_t(ch) * padded + j] =
+                    std::clamp((f - float(frames[a])) / float(frames[b] - frames[a]), 0.f, 1.f);
+            }
+
+            float va[4], vb[4];
+            DecodeKey(track, Channel(ch), a, va);
+            if (b != a) DecodeKey(track, Channel(ch), b, vb);
+            else memcpy(vb, va, sizeof(va));
+
+            const int first = ch == Translation ? Pose::TX : (ch == Rotation ? Pose::RX : Pose::SX);
+            const int comps = ch == Rotation ? 4 : 3;
+            for (int k = 0; k < comps; ++k) {
+                out[Pose::Stream(first + k)][j] = va[k];
+                next[Pose::Stream(first + k)][j] = vb[k];
+            }
+        }
+    }
+
+    LerpPoses(out, next, &weights[0], &weights[padded], &weights[2 * padded], out);
+}
+
+void BlendPoses(const Pose& a, const Pose& b, float weight, Pose& out)
+{
+    out.Resize(a.JointCount());
+    thread_local std::vector<float> w;
+    w.assign(out.PaddedCount(), weight);
+    LerpPoses(a, b, w.data(), w.data(), w.data(), out);
+}
+
+void ComputeSkinningPalette(const Skeleton& skeleton, const Pose& pose, JointMatrix* world, JointMatrix* palette)
+{
+    const size_t n = skeleton.JointCount();
+    // palette holds the local matrices until each joint is resolved
+    LocalMatrices(pose, palette);
+    for (size_t j = 0; j < n; ++j) {
+        const int32_t parent = skeleton.joints[j].parent;
+        MulAffine(parent >= 0 ? world[parent] : skeleton.root, palette[j], world[j]);
+        MulAffine(world[j], skeleton.inverseBind[j], palette[j]);
+    }
+}
+
+void SkinVertices(const Vertex* bind, const SkinInfluence* influences, size_t count,
+    const JointMatrix* palette, Vertex* out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex& v = bind[i];
+        const SkinInfluence& in = influences[i];
+        Vertex o = v;
+
+#if ANIMATION_SSE2
+        __m128 c[4];
+        {
+            const JointMatrix& m = palette[in.joint[0]];
+            const __m128 w = _mm_set1_ps(in.weight[0]);
+            for (int k = 0; k < 4; ++k) c[k] = _mm_mul_ps(_mm_load_ps(m.c[k]), w);
+        }
+        for (int n = 1; n < 4; ++n) {
+            if (in.weight[n] == 0.f) continue;
+            const JointMatrix& m = palette[in.joint[n]];
+            const __m128 w = _mm_set1_ps(in.weight[n]);
+            for (int k = 0; k < 4; ++k) c[k] = _mm_add_ps(c[k], _mm_mul_ps(_mm_load_ps(m.c[k]), w));
+        }
+
+        alignas(16) float p[4], nn[4], t[4], b[4];
+        _mm_store_ps(p, _mm_add_ps(Transform3(c, v.px, v.py, v.pz), c[3]));
+        _mm_store_ps(nn, Normalize3(Transform3(c, v.nx, v.ny, v.nz)));
+        _mm_store_ps(t, Normalize3(Transform3(c, v.tx, v.ty, v.tz)));
+        _mm_store_ps(b, Normalize3(Transform3(c, v.bx, v.by, v.bz)));
+#else
+        float c[4][3] = {};
+        for (int n = 0; n < 4; ++n) {
+            if (in.weight[n] == 0.f) continue;
+            const JointMatrix& m = palette[in.joint[n]];
+            for (int k = 0; k < 4; ++k)
+                for (int r = 0; r < 3; ++r) c[k][r] += m.c[k][r] * in.weight[n];
+        }
+        auto xf = [&](float x, float y, float z, float* r, bool point) {
+            for (int k = 0; k < 3; ++k) r[k] = c[0][k] * x + c[1][k] * y + c[2][k] * z + (point ? c[3][k] : 0.f);
+            if (!point) {
+                const float len = std::sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+                if (len > 0.f) for (int k = 0; k < 3; ++k) r[k] /= len;
+            }
+        };
+        float p[3], nn[3], t[3], b[3];
+        xf(v.px, v.py, v.pz, p, true);
+        xf(v.nx, v.ny, v.nz, nn, false);
+        xf(v.tx, v.ty, v.tz, t, false);
+        xf(v.bx, v.by, v.bz, b, false);
+#endif
+        o.px = p[0]; o.py = p[1]; o.pz = p[2];
+        o.nx = nn[0]; o.ny = nn[1]; o.nz = nn[2];
+        o.tx = t[0]; o.ty = t[1]; o.tz = t[2];
+        o.bx = b[0]; o.by = b[1]; o.bz = b[2];
+        memcpy(out + i, &o, sizeof(Vertex));
+    }
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// GPU-free skeletal animation: skeletons, compressed clips, SoA pose
+// sampling and blending, skinning palettes and CPU skinning. The hot loops
+// run four joints (or one vertex) per SSE register.
+
+// Column-major affine transform, p' = c0 * x + c1 * y + c2 * z + c3. The w
+// lane of each column is unused.
+struct alignas(16) JointMatrix
+{
+    float c[4][4];
+
+    static JointMatrix Identity();
+    static JointMatrix FromColumnMajor4x4(const float m[16]);
+};
+
+struct JointTransform
+{
+    float t[3]{ 0.f, 0.f, 0.f };
+    float r[4]{ 0.f, 0.f, 0.f, 1.f };  // x, y, z, w
+    float s[3]{ 1.f, 1.f, 1.f };
+};
+
+struct Skeleton
+{
+    struct Joint
+    {
+        std::string name;
+        int32_t parent = -1;    // always before the joint, -1 for roots
+    };
+
+    std::vector<Joint> joints;
+    std::vector<JointTransform> bindPose;   // local transforms of the rest pose
+    std::vector<JointMatrix> inverseBind;
+    // transform of the nodes above the root joints
+    JointMatrix root = JointMatrix::Identity();
+
+    size_t JointCount() const { return joints.size(); }
+};
+
+// Local joint transforms as ten float streams (t.xyz, r.xyzw, s.xyz) padded
+// to a multiple of four joints.
+class Pose
+{
+public:
+    enum Stream { TX, TY, TZ, RX, RY, RZ, RW, SX, SY, SZ, StreamCount };
+
+    void Resize(size_t jointCount);
+    void SetBindPose(const Skeleton& skeleton);
+
+    size_t JointCount() const { return m_jointCount; }
+    size_t PaddedCount() const { return m_padded; }
+
+    float* operator[](Stream s) { return m_data.data() + size_t(s) * m_padded; }
+    const float* operator[](Stream s) const { return m_data.data() + size_t(s) * m_padded; }
+
+    void Set(size_t joint, const JointTransform& x);
+    JointTransform Get(size_t joint) const;
+
+private:
+    size_t m_jointCount = 0;
+    size_t m_padded = 0;
+    std::vector<float> m_data;
+};
+
+// Uniformly sampled clip as produced by an importer, frameCount * jointCount
+// local transforms, joint-major within a frame.
+struct RawClip
+{
+    std::string name;
+    float sampleRate = 30.f;
+    uint32_t frameCount = 0;
+    std::vector<JointTransform> frames;
+
+    float Duration() const { return frameCount > 1 ? float(frameCount - 1) / sampleRate : 0.f; }
+};
+
+struct ClipCompression
+{
+    // largest deviation a removed key may introduce, in scene units and in
+    // quaternion components (about half a radian per unit)
+    float translationTolerance = 1e-4f;
+    float rotationTolerance = 2e-4f;
+    float scaleTolerance = 1e-4f;
+};
+
+// Compressed clip: per joint a translation, rotation and scale track. Keys
+// that linear interpolation of their neighbours reproduces within tolerance
+// are dropped, constant tracks keep a single key. Key times are frame
+// numbers (16 bit); translations and scales are 16-bit fractions of the
+// track range and rotations are smallest-three quaternions in 48 bits.
+class AnimationClip
+{
+public:
+    static AnimationClip Compress(const RawClip& raw, size_t jointCount, const ClipCompression& settings = {});
+
+    const std::string& Name() const { return m_name; }
+    float Duration() const { return m_frameCount > 1 ? float(m_frameCount - 1) / m_sampleRate : 0.f; }
+    size_t JointCount() const { return m_jointCount; }
+    size_t KeyCount() const { return m_keyFrames.size(); }
+    size_t MemoryBytes() const;
+
+    // Local transforms at time, wrapped into the clip when loop is set and
+    // clamped otherwise. out must be sized for JointCount() joints.
+    void Sample(float time, bool loop, Pose& out) const;
+
+private:
+    enum Channel { Translation, Rotation, Scale, ChannelCount };
+
+    struct Track
+    {
+        uint32_t firstKey = 0;
+        uint32_t keyCount = 0;
+        float min[3]{};
+        float extent[3]{};  // zero for rotations
+    };
+
+    void DecodeKey(const Track& track, Channel channel, uint32_t key, float* out) const;
+
+    std::string m_name;
+    float m_sampleRate = 30.f;
+    uint32_t m_frameCount = 0;
+    uint32_t m_jointCount = 0;
+    std::vector<Track> m_tracks;        // joint * ChannelCount + channel
+    std::vector<uint16_t> m_keyFrames;
+    std::vector<uint16_t> m_keyValues;  // three per key
+};
+
+// out = a + (b - a) * weight per joint, rotations by normalized lerp along
+// the shorter arc.
+void BlendPoses(const Pose& a, const Pose& b, float weight, Pose& out);
+
+// palette[j] = world(j) * inverseBind[j]; world must hold JointCount() matrices.
+void ComputeSkinningPalette(const Skeleton& skeleton, const Pose& pose, JointMatrix* world, JointMatrix* palette);
+
+struct SkinInfluence
+{
+    uint16_t joint[4]{};
+    float weight[4]{};  // sums to one
+};
+
+// Linear blend skinning of positions, normals, tangents and bitangents.
+// out is written front to back without being read, so it may point into
+// write-combined upload memory.
+void SkinVertices(const Vertex* bind, const SkinInfluence* influences, size_t count,
+    const JointMatrix* palette, Vertex* out);
@@ -0,0 +1,797 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "BlockCompress.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOCKCOMPRESS_SSE2 1
+#endif
+
+namespace
+{
+    using BlockCompress::Format;
+    using BlockCompress::Quality;
+
+    // texels of one block, channel major, 0..255
+    struct Block
+    {
+        int channels = 0;
+        float v[4][16];
+    };
+
+    // what a block can decode to, up to 16 entries
+    struct Palette
+    {
+        int count = 0;
+        float e[16][4];
+    };
+
+    // Nearest palette entry of every texel, the first one on ties. Returns
+    // the summed squared error.
+    float FitIndices(const Block& b, const Palette& p, uint8_t idx[16], bool simd)
+    {
+        float total = 0.f;
+        int t = 0;
+#if BLOCKCOMPRESS_SSE2
+        if (simd) {
+            alignas(16) float best[4], bestIndex[4];
+            for (; t < 16; t += 4) {
+                __m128 vBest = _mm_set1_ps(FLT_MAX), vIndex = _mm_setzero_ps();
+                for (int e = 0; e < p.count; ++e) {
+                    __m128 err = _mm_setzero_ps();
+                    for (int c = 0; c < b.channels; ++c) {
+                        const __m128 d = _mm_sub_ps(_mm_loadu_ps(b.v[c] + t), _mm_set1_ps(p.e[e][c]));
+                        err = _mm_add_ps(err, _mm_mul_ps(d, d));
+                    }
+                    const __m128 less = _mm_cmplt_ps(err, vBest);
+                    vBest = _mm_min_ps(err, vBest);
+                    vIndex = _mm_or_ps(_mm_and_ps(less, _mm_set1_ps(float(e))), _mm_andnot_ps(less, vIndex));
+                }
+                _mm_store_ps(best, vBest);
+                _mm_store_ps(bestIndex, vIndex);
+                for (int k = 0; k < 4; ++k) {
+                    idx[t + k] = uint8_t(bestIndex[k]);
+                    total += best[k];
+                }
+            }
+        }
+#endif
+        for (; t < 16; ++t) {
+            float best = FLT_MAX;
+            uint8_t bestIndex = 0;
+            for (int e = 0; e < p.count; ++e) {
+                float err = 0.f;
+                for (int c = 0; c < b.channels; ++c) {
+                    const float d = b.v[c][t] - p.e[e][c];
+                    err = err + d * d;
+                }
+                if (err < best) {
+                    best = err;
+                    bestIndex = uint8_t(e);
+                }
+            }
+            idx[t] = bestIndex;
+            total += best;
+        }
+        return total;
+    }
+
+    // Fast variant of FitIndices for palettes on the segment from e[0] to
+    // e[count - 1], in order: each texel takes the entry whose weight, out of
+    // 64, is nearest its projection. nearest[0..64] maps weights to entries.
+    float ProjectIndices(const Block& b, const Palette& p, const uint8_t nearest[65], uint8_t idx[16], bool simd)
+    {
+        const float* a = p.e[0];
+        const float* z = p.e[p.count - 1];
+        float dir[4], len2 = 0.f;
+        for (int c = 0; c < b.channels; ++c) {
+            dir[c] = z[c] - a[c];
+            len2 += dir[c] * dir[c];
+        }
+        const float scale = len2 > 0.f ? 64.f / len2 : 0.f;
+
+        alignas(16) float w[16];
+        int t = 0;
+#if BLOCKCOMPRESS_SSE2
+        if (simd) {
+            for (; t < 16; t += 4) {
+                __m128 dot = _mm_setzero_ps();
+                for (int c = 0; c < b.channels; ++c)
+                    dot = _mm_add_ps(dot, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b.v[c] + t), _mm_set1_ps(a[c])), _mm_set1_ps(dir[c])));
+                const __m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(dot, _mm_set1_ps(scale)), _mm_setzero_ps()), _mm_set1_ps(64.f));
+                _mm_store_ps(w + t, v);
+            }
+        }
+#endif
+        for (; t < 16; ++t) {
+            float dot = 0.f;
+            for (int c = 0; c < b.channels; ++c)
+                dot = dot + (b.v[c][t] - a[c]) * dir[c];
+            w[t] = std::min(std::max(dot * scale, 0.f), 64.f);
+        }
+
+        float total = 0.f;
+        for (t = 0; t < 16; ++t) {
+            idx[t] = nearest[int(w[t] + 0.5f)];
+            float err = 0.f;
+            for (int c = 0; c < b.channels; ++c) {
+                const float d = b.v[c][t] - p.e[idx[t]][c];
+                err = err + d * d;
+            }
+            total += err;
+        }
+        return total;
+    }
+
+    // mean and principal axis of the texels, by power iteration on their covariance
+    void PrincipalAxis(const Block& b, float mean[4], float axis[4])
+    {
+        const int n = b.channels;
+        for (int c = 0; c < n; ++c) {
+            float sum = 0.f;
+            for (int t = 0; t < 16; ++t) sum += b.v[c][t];
+            mean[c] = sum / 16.f;
+        }
+        float cov[4][4]{};
+        for (int i = 0; i < n; ++i)
+            for (int j = i; j < n; ++j) {
+                float sum = 0.f;
+                for (int t = 0; t < 16; ++t) sum += (b.v[i][t] - mean[i]) * (b.v[j][t] - mean[j]);
+                cov[i][j] = cov[j][i] = sum;
+            }
+
+        int widest = 0;
+        for (int c = 1; c < n; ++c)
+            if (cov[c][c] > cov[widest][widest]) widest = c;
+        for (int c = 0; c < n; ++c) axis[c] = c == widest ? 1.f : 0.f;
+        for (int iter = 0; iter < 8; ++iter) {
+            float r[4]{}, len2 = 0.f;
+            for (int i = 0; i < n; ++i) {
+                for (int j = 0; j < n; ++j) r[i] += cov[i][j] * axis[j];
+                len2 += r[i] * r[i];
+            }
+            if (len2 < 1e-12f) break;
+            const float inv = 1.f / std::sqrt(len2);
+            for (int c = 0; c < n; ++c) axis[c] = r[c] * inv;
+        }
+    }
+
+    // the texels' extent along the principal axis
+    void Extents(const Block& b, float e0[4], float e1[4])
+    {
+        float mean[4], axis[4];
+        PrincipalAxis(b, mean, axis);
+        float lo = FLT_MAX, hi = -FLT_MAX;
+        for (int t = 0; t < 16; ++t) {
+            float d = 0.f;
+            for (int c = 0; c < b.channels; ++c) d += (b.v[c][t] - mean[c]) * axis[c];
+            lo = std::min(lo, d);
+            hi = std::max(hi, d);
+        }
+        for (int c = 0; c < b.channels; ++c) {
+            e0[c] = std::clamp(mean[c] + lo * axis[c], 0.f, 255.f);
+            e1[c] = std::clamp(mean[c] + hi * axis[c], 0.f, 255.f);
+        }
+    }
+
+    // Endpoints minimising the error for fixed weights, 0 at e0 and 1 at e1,
+    // over the texels of mask. False when the weights do not separate them.
+    bool LeastSquares(const Block& b, const float w[16], float e0[4], float e1[4], uint32_t mask = 0xFFFF)
+    {
+        float aa = 0.f, ab = 0.f, bb = 0.f, ax[4]{}, bx[4]{};
+        for (int t = 0; t < 16; ++t) {
+            if (!(mask >> t & 1)) continue;
+            const float a = 1.f - w[t], bw = w[t];
+            aa += a * a;
+            ab += a * bw;
+            bb += bw * bw;
+            for (int c = 0; c < b.channels; ++c) {
+                ax[c] += a * b.v[c][t];
+                bx[c] += bw * b.v[c][t];
+            }
+        }
+        const float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1e-6f)
+            return false;
+        for (int c = 0; c < b.channels; ++c) {
+            e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.f, 255.f);
+            e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.f, 255.f);
+        }
+        return true;
+    }
+
+    void LoadBlock(const uint8_t* level, uint32_t w, uint32_t h, uint32_t bx, uint32_t by,
+        const int* channels, int count, Block& b)
+    {
+        b.channels = count;
+        for (uint32_t py = 0; py < 4; ++py) {
+            const uint32_t y = std::min(by * 4 + py, h - 1);
+            for (uint32_t px = 0; px < 4; ++px) {
+                const uint8_t* texel = level + (size_t(y) * w + std::min(bx * 4 + px, w - 1)) * 4;
+                for (int c = 0; c < count; ++c)
+                    b.v[c][py * 4 + px] = float(texel[channels[c]]);
+            }
+        }
+    }
+
+    // --- BC1 colour --------------------------------------------------------
+
+    uint16_t To565(const float c[3])
+    {
+        const int r = std::clamp(int(c[0] * 31.f / 255.f + 0.5f), 0, 31);
+        const int g = std::clamp(int(c[1] * 63.f / 255.f + 0.5f), 0, 63);
+        const int b = std::clamp(int(c[2] * 31.f / 255.f + 0.5f), 0, 31);
+        return uint16_t(r << 11 | g << 5 | b);
+    }
+
+    void From565(uint16_t v, int out[3])
+    {
+        const int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+        out[0] = r << 3 | r >> 2;
+        out[1] = g << 2 | g >> 4;
+        out[2] = b << 3 | b >> 2;
+    }
+
+    // BC2/BC3 colour blocks always decode as four colours
+    void Bc1Palette(uint16_t c0, uint16_t c1, bool fourColors, Palette& p)
+    {
+        int a[3], b[3];
+        From565(c0, a);
+        From565(c1, b);
+        p.count = 4;
+        for (int c = 0; c < 3; ++c) {
+            p.e[0][c] = float(a[c]);
+            p.e[1][c] = float(b[c]);
+            if (fourColors || c0 > c1) {
+                p.e[2][c] = float((2 * a[c] + b[c] + 1) / 3);
+                p.e[3][c] = float((a[c] + 2 * b[c] + 1) / 3);
+            }
+            else {
+                p.e[2][c] = float((a[c] + b[c] + 1) / 2);
+                p.e[3][c] = 0.f;
+            }
+        }
+    }
+
+    void EncodeColor(const Block& b, Quality quality, bool simd, uint8_t out[8])
+    {
+        static const float kWeight[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+        float e0[4], e1[4];
+        Extents(b, e0, e1);
+
+        float bestErr = FLT_MAX;
+        uint16_t best0 = 0, best1 = 0;
+        uint8_t bestIdx[16]{};
+        const int rounds = quality == Quality::Fast ? 2 : 6;
+        for (int round = 0; round < rounds; ++round) {
+            uint16_t c0 = To565(e0), c1 = To565(e1);
+            if (c0 < c1) {
+                std::swap(c0, c1);
+                for (int c = 0; c < 3; ++c) std::swap(e0[c], e1[c]);
+            }
+            Palette p;
+            Bc1Palette(c0, c1, true, p);
+            // equal endpoints decode as three colours and black in BC1
+            if (c0 == c1) p.count = 1;
+            uint8_t idx[16];
+            const float err = FitIndices(b, p, idx, simd);
+            if (err < bestErr) {
+                bestErr = err;
+                best0 = c0;
+                best1 = c1;
+                std::memcpy(bestIdx, idx, 16);
+            }
+            if (bestErr == 0.f || c0 == c1)
+                break;
+
+            float w[16];
+            for (int t = 0; t < 16; ++t) w[t] = kWeight[bestIdx[t]];
+            if (!LeastSquares(b, w, e0, e1))
+                break;
+        }
+
+        uint32_t bits = 0;
+        for (int t = 0; t < 16; ++t) bits |= uint32_t(bestIdx[t]) << (2 * t);
+        out[0] = uint8_t(best0); out[1] = uint8_t(best0 >> 8);
+        out[2] = uint8_t(best1); out[3] = uint8_t(best1 >> 8);
+        for (int i = 0; i < 4; ++i) out[4 + i] = uint8_t(bits >> (8 * i));
+    }
+
+    // --- BC4 single channel ------------------------------------------------
+
+    void Bc4Palette(int r0, int r1, Palette& p)
+    {
+        p.count = 8;
+        p.e[0][0] = float(r0);
+        p.e[1][0] = float(r1);
+        if (r0 > r1) {
+            for (int k = 1; k <= 6; ++k) p.e[k + 1][0] = float(((7 - k) * r0 + k * r1 + 3) / 7);
+        }
+        else {
+            for (int k = 1; k <= 4; ++k) p.e[k + 1][0] = float(((5 - k) * r0 + k * r1 + 2) / 5);
+            p.e[6][0] = 0.f;
+            p.e[7][0] = 255.f;
+        }
+    }
+
+    float EvalBc4(const Block& b, int r0, int r1, uint8_t idx[16], bool simd)
+    {
+        Palette p;
+        Bc4Palette(r0, r1, p);
+        return FitIndices(b, p, idx, simd);
+    }
+
+    void EncodeBc4(const Block& b, Quality quality, bool simd, uint8_t out[8])
+    {
+        float lo = 255.f, hi = 0.f;
+        for (int t = 0; t < 16; ++t) {
+            lo = std::min(lo, b.v[0][t]);
+            hi = std::max(hi, b.v[0][t]);
+        }
+
+        // eight values between the extremes; equal ones decode the same in either mode
+        int best0 = int(hi), best1 = int(lo);
+        uint8_t bestIdx[16], idx[16];
+        float bestErr = EvalBc4(b, best0, best1, bestIdx, simd);
+
+        if (quality == Quality::High && bestErr > 0.f) {
+            auto consider = [&](int r0, int r1) {
+                const float err = EvalBc4(b, r0, r1, idx, simd);
+                if (err < bestErr) {
+                    bestErr = err;
+                    best0 = r0;
+                    best1 = r1;
+                    std::memcpy(bestIdx, idx, 16);
+                }
+            };
+
+            // refine the eight value mode
+            for (int iter = 0; iter < 4 && best0 > best1; ++iter) {
+                float w[16], e0[4], e1[4];
+                for (int t = 0; t < 16; ++t)
+                    w[t] = bestIdx[t] == 0 ? 0.f : bestIdx[t] == 1 ? 1.f : (bestIdx[t] - 1) / 7.f;
+                if (!LeastSquares(b, w, e0, e1))
+                    break;
+                int r0 = int(e0[0] + 0.5f), r1 = int(e1[0] + 0.5f);
+                if (r0 < r1) std::swap(r0, r1);
+                if (r0 == r1) {
+                    if (r0 < 255) ++r0;
+                    else --r1;
+                }
+                const float before = bestErr;
+                consider(r0, r1);
+                if (bestErr >= before)
+                    break;
+            }
+
+            // six values between the texels that are not exactly 0 or 255
+            float innerLo = 255.f, innerHi = 0.f;
+            uint32_t inner = 0;
+            for (int t = 0; t < 16; ++t) {
+                const float v = b.v[0][t];
+                if (v <= 0.f || v >= 255.f) continue;
+                inner |= 1u << t;
+                innerLo = std::min(innerLo, v);
+                innerHi = std::max(innerHi, v);
+            }
+            if (inner) {
+                int r0 = int(innerLo), r1 = int(innerHi);
+                consider(r0, r1);
+                for (int iter = 0; iter < 4 && best0 <= best1; ++iter) {
+                    float w[16], e0[4], e1[4];
+                    uint32_t mask = 0;
+                    for (int t = 0; t < 16; ++t) {
+                        w[t] = bestIdx[t] == 0 ? 0.f : bestIdx[t] == 1 ? 1.f : (bestIdx[t] - 1) / 5.f;
+                        if (bestIdx[t] < 6) mask |= 1u << t;
+                    }
+                    if (!LeastSquares(b, w, e0, e1, mask))
+                        break;
+                    r0 = int(e0[0] + 0.5f);
+                    r1 = int(e1[0] + 0.5f);
+                    if (r0 > r1) std::swap(r0, r1);
+                    const float before = bestErr;
+                    consider(r0, r1);
+                    if (bestErr >= before)
+                        break;
+                }
+            }
+        }
+
+        out[0] = uint8_t(best0);
+        out[1] = uint8_t(best1);
+        uint64_t bits = 0;
+        for (int t = 0; t < 16; ++t) bits |= uint64_t(bestIdx[t]) << (3 * t);
+        for (int i = 0; i < 6; ++i) out[2 + i] = uint8_t(bits >> (8 * i));
+    }
+
+    // --- BC7 mode 6 ----------------------------------------------------------
+
+    const int kBc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // entry of kBc7Weights4 nearest each weight out of 64
+    struct Bc7Nearest
+    {
+        uint8_t index[65];
+
+        Bc7Nearest()
+        {
+            for (int w = 0; w <= 64; ++w) {
+                int best = 0;
+                for (int i = 1; i < 16; ++i)
+                    if (std::abs(kBc7Weights4[i] - w) < std::abs(kBc7Weights4[best] - w)) best = i;
+                index[w] = uint8_t(best);
+            }
+        }
+    };
+
+    // 7 bits per channel and a p-bit per endpoint
+    struct Bc7Endpoints
+    {
+        int q[2][4];
+        int p[2];
+    };
+
+    void Bc7Quantize(const float e[4], int p, int q[4])
+    {
+        for (int c = 0; c < 4; ++c)
+            q[c] = std::clamp(int(std::floor((e[c] - p) * 0.5f + 0.5f)), 0, 127);
+    }
+
+    void Bc7Palette(const Bc7Endpoints& ep, Palette& pal)
+    {
+        pal.count = 16;
+        for (int c = 0; c < 4; ++c) {
+            const int a = ep.q[0][c] << 1 | ep.p[0];
+            const int b = ep.q[1][c] << 1 | ep.p[1];
+            for (int i = 0; i < 16; ++i)
+                pal.e[i][c] = float(((64 - kBc7Weights4[i]) * a + kBc7Weights4[i] * b + 32) >> 6);
+        }
+    }
+
+    // the p-bit that quantizes e closer
+    int Bc7BestPBit(const float e[4])
+    {
+        float err[2] = { 0.f, 0.f };
+        for (int p = 0; p < 2; ++p) {
+            int q[4];
+            Bc7Quantize(e, p, q);
+            for (int c = 0; c < 4; ++c) {
+                const float d = float(q[c] << 1 | p) - e[c];
+                err[p] += d * d;
+            }
+        }
+        return err[1] < err[0] ? 1 : 0;
+    }
+
+    struct BitWriter
+    {
+        uint8_t* out;
+        uint32_t pos = 0;
+
+        void Put(uint32_t value, int bits)
+        {
+            for (int i = 0; i < bits; ++i, ++pos)
+                if (value >> i & 1) out[pos >> 3] |= uint8_t(1u << (pos & 7));
+        }
+    };
+
+    void EncodeBc7(const Block& b, Quality quality, bool simd, uint8_t out[16])
+    {
+        static const Bc7Nearest nearest;
+        float e0[4], e1[4];
+        Extents(b, e0, e1);
+
+        float bestErr = FLT_MAX;
+        Bc7Endpoints best{};
+        uint8_t bestIdx[16]{};
+        const int rounds = quality == Quality::Fast ? 2 : 5;
+        for (int round = 0; round < rounds; ++round) {
+            int pairs[4][2] = { { Bc7BestPBit(e0), Bc7BestPBit(e1) }, { 0, 0 }, { 0, 1 }, { 1, 0 } };
+            int pairCount = 1;
+            if (quality == Quality::High) {
+                pairs[0][0] = 1; pairs[0][1] = 1;
+                pairCount = 4;
+            }
+            for (int i = 0; i < pairCount; ++i) {
+                Bc7Endpoints ep;
+                ep.p[0] = pairs[i][0];
+                ep.p[1] = pairs[i][1];
+                Bc7Quantize(e0, ep.p[0], ep.q[0]);
+                Bc7Quantize(e1, ep.p[1], ep.q[1]);
+                Palette pal;
+                Bc7Palette(ep, pal);
+                uint8_t idx[16];
+                const float err = quality == Quality::Fast
+                    ? ProjectIndices(b, pal, nearest.index, idx, simd)
+                    : FitIndices(b, pal, idx, simd);
+                if (err < bestErr) {
+                    bestErr = err;
+                    best = ep;
+                    std::memcpy(bestIdx, idx, 16);
+                }
+            }
+            if (bestErr == 0.f)
+                break;
+
+            float w[16];
+            for (int t = 0; t < 16; ++t) w[t] = kBc7Weights4[bestIdx[t]] / 64.f;
+            if (!LeastSquares(b, w, e0, e1))
+                break;
+        }
+
+        // the first texel's index drops its top bit, it must be below 8
+        if (bestIdx[0] >= 8) {
+            std::swap(best.q[0], best.q[1]);
+            std::swap(best.p[0], best.p[1]);
+            for (int t = 0; t < 16; ++t) bestIdx[t] = uint8_t(15 - bestIdx[t]);
+        }
+
+        std::memset(out, 0, 16);
+        BitWriter bits{ out };
+        bits.Put(1u << 6, 7);
+        for (int c = 0; c < 4; ++c) {
+            bits.Put(uint32_t(best.q[0][c]), 7);
+            bits.Put(uint32_t(best.q[1][c]), 7);
+        }
+        bits.Put(uint32_t(best.p[0]), 1);
+        bits.Put(uint32_t(best.p[1]), 1);
+        bits.Put(bestIdx[0], 3);
+        for (int t = 1; t < 16; ++t) bits.Put(bestIdx[t], 4);
+    }
+
+    // --- decoding ------------------------------------------------------------
+
+    void DecodeColor(const uint8_t* in, bool fourColors, uint8_t rgba[64])
+    {
+        const uint16_t c0 = uint16_t(in[0] | in[1] << 8), c1 = uint16_t(in[2] | in[3] << 8);
+        Palette p;
+        Bc1Palette(c0, c1, fourColors, p);
+        const uint32_t bits = uint32_t(in[4]) | uint32_t(in[5]) << 8 | uint32_t(in[6]) << 16 | uint32_t(in[7]) << 24;
+        for (int t = 0; t < 16; ++t) {
+            const int i = bits >> (2 * t) & 3;
+            for (int c = 0; c < 3; ++c) rgba[t * 4 + c] = uint8_t(p.e[i][c]);
+            rgba[t * 4 + 3] = !fourColors && c0 <= c1 && i == 3 ? 0 : 255;
+        }
+    }
+
+    void DecodeBc4(const uint8_t* in, uint8_t out[16])
+    {
+        Palette p;
+        Bc4Palette(in[0], in[1], p);
+        uint64_t bits = 0;
+        for (int i = 0; i < 6; ++i) bits |= uint64_t(in[2 + i]) << (8 * i);
+        for (int t = 0; t < 16; ++t) out[t] = uint8_t(p.e[bits >> (3 * t) & 7][0]);
+    }
+
+    // mode 6, the only one Compress writes; other modes decode black
+    void DecodeBc7(const uint8_t* in, uint8_t rgba[64])
+    {
+        std::memset(rgba, 0, 64);
+        if ((in[0] & 0x7F) != 1u << 6)
+            return;
+        uint32_t pos = 7;
+        auto get = [&](int count) {
+            uint32_t v = 0;
+            for (int i = 0; i < count; ++i, ++pos) v |= uint32_t(in[pos >> 3] >> (pos & 7) & 1) << i;
+            return v;
+        };
+        Bc7Endpoints ep;
+        for (int c = 0; c < 4; ++c) {
+            ep.q[0][c] = int(get(7));
+            ep.q[1][c] = int(get(7));
+        }
+        ep.p[0] = int(get(1));
+        ep.p[1] = int(get(1));
+        Palette pal;
+        Bc7Palette(ep, pal);
+        for (int t = 0; t < 16; ++t) {
+            const uint32_t i = get(t == 0 ? 3 : 4);
+            for (int c = 0; c < 4; ++c) rgba[t * 4 + c] = uint8_t(pal.e[i][c]);
+        }
+    }
+
+    void EncodeBlock(const BlockCompress::Settings& settings, const uint8_t* level, uint32_t w, uint32_t h,
+        uint32_t bx, uint32_t by, uint8_t* out)
+    {
+        static const int kRgba[4] = { 0, 1, 2, 3 };
+        const int alpha = 3, first = settings.channels[0], second = settings.channels[1];
+        Block b;
+        switch (settings.format) {
+        case Format::BC1:
+            LoadBlock(level, w, h, bx, by, kRgba, 3, b);
+            EncodeColor(b, settings.quality, settings.simd, out);
+            break;
+        case Format::BC3:
+            LoadBlock(level, w, h, bx, by, &alpha, 1, b);
+            EncodeBc4(b, settings.quality, settings.simd, out);
+            LoadBlock(level, w, h, bx, by, kRgba, 3, b);
+            EncodeColor(b, settings.quality, settings.simd, out + 8);
+            break;
+        case Format::BC4:
+            LoadBlock(level, w, h, bx, by, &first, 1, b);
+            EncodeBc4(b, settings.quality, settings.simd, out);
+            break;
+        case Format::BC5:
+            LoadBlock(level, w, h, bx, by, &first, 1, b);
+            EncodeBc4(b, settings.quality, settings.simd, out);
+            LoadBlock(level, w, h, bx, by, &second, 1, b);
+            EncodeBc4(b, settings.quality, settings.simd, out + 8);
+            break;
+        case Format::BC7:
+            LoadBlock(level, w, h, bx, by, kRgba, 4, b);
+            EncodeBc7(b, settings.quality, settings.simd, out);
+            break;
+        }
+    }
+}
+
+uint32_t BlockCompress::BlockBytes(Format format)
+{
+    return format == Format::BC1 || format == Format::BC4 ? 8 : 16;
+}
+
+const char* BlockCompress::FormatName(Format format)
+{
+    switch (format) {
+    case Format::BC1: return "BC1";
+    case Format::BC3: return "BC3";
+    case Format::BC4: return "BC4";
+    case Format::BC5: return "BC5";
+    case Format::BC7: return "BC7";
+    }
+    return "?";
+}
+
+std::vector<const void*> BlockCompress::Chain::LevelPointers() const
+{
+    std::vector<const void*> levels(offsets.size());
+    for (size_t i = 0; i < offsets.size(); ++i)
+        levels[i] = data.data() + offsets[i];
+    return levels;
+}
+
+BlockCompress::Settings BlockCompress::SettingsFor(MipGenerator::Content content, Quality quality)
+{
+    Settings settings;
+    settings.quality = quality;
+    switch (content) {
+    case MipGenerator::Content::Color:
+        settings.format = Format::BC7;
+        break;
+    case MipGenerator::Content::NormalMap:
+        settings.format = Format::BC5;
+        settings.channels[0] = 0;
+        settings.channels[1] = 1;
+        break;
+    case MipGenerator::Content::Linear:
+        // the metal/rough maps, what the shader reads of them
+        settings.format = Format::BC5;
+        settings.channels[0] = 1;
+        settings.channels[1] = 2;
+        break;
+    }
+    return settings;
+}
+
+BlockCompress::Chain BlockCompress::Compress(const MipGenerator::Chain& mips, const Settings& settings, Stats* stats)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+
+    Chain chain;
+    chain.format = settings.format;
+    chain.channels[0] = settings.channels[0];
+    chain.channels[1] = settings.channels[1];
+    chain.width = mips.width;
+    chain.height = mips.height;
+
+    const uint32_t blockBytes = BlockBytes(settings.format);
+    size_t bytes = 0;
+    uint64_t blocks = 0;
+    for (uint32_t l = 0; l < mips.LevelCount(); ++l) {
+        chain.offsets.push_back(bytes);
+        const uint64_t levelBlocks = uint64_t((mips.LevelWidth(l) + 3) / 4) * ((mips.LevelHeight(l) + 3) / 4);
+        bytes += size_t(levelBlocks) * blockBytes;
+        blocks += levelBlocks;
+    }
+    chain.data.resize(bytes);
+
+    for (uint32_t l = 0; l < mips.LevelCount(); ++l) {
+        const uint32_t w = mips.LevelWidth(l), h = mips.LevelHeight(l);
+        const uint32_t blocksWide = (w + 3) / 4, blocksHigh = (h + 3) / 4;
+        const uint8_t* level = mips.Level(l);
+        uint8_t* out = chain.data.data() + chain.offsets[l];
+        JobSystem::I().ParallelFor(blocksHigh, std::max<size_t>(1, 64 / blocksWide), [&](size_t begin, size_t end) {
+            for (size_t by = begin; by < end; ++by)
+                for (uint32_t bx = 0; bx < blocksWide; ++bx)
+                    EncodeBlock(settings, level, w, h, bx, uint32_t(by), out + (by * blocksWide + bx) * blockBytes);
+        });
+    }
+
+    if (stats) {
+        stats->blocks = blocks;
+        stats->bytesIn = mips.pixels.size();
+        stats->bytesOut = bytes;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    return chain;
+}
+
+std::vector<uint8_t> BlockCompress::Decompress(const Chain& chain, uint32_t level)
+{
+    const uint32_t w = chain.LevelWidth(level), h = chain.LevelHeight(level);
+    const uint32_t blocksWide = (w + 3) / 4, blocksHigh = (h + 3) / 4;
+    const uint32_t blockBytes = BlockBytes(chain.format);
+    std::vector<uint8_t> out(size_t(w) * h * 4, 0);
+    for (size_t t = 3; t < out.size(); t += 4) out[t] = 255;
+
+    uint8_t rgba[64], a[16], b[16];
+    for (uint32_t by = 0; by < blocksHigh; ++by) {
+        for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+            const uint8_t* in = chain.Level(level) + (size_t(by) * blocksWide + bx) * blockBytes;
+            switch (chain.format) {
+            case Format::BC1: DecodeColor(in, false, rgba); break;
+            case Format::BC3: DecodeBc4(in, a); DecodeColor(in + 8, true, rgba); break;
+            case Format::BC4: DecodeBc4(in, a); break;
+            case Format::BC5: DecodeBc4(in, a); DecodeBc4(in + 8, b); break;
+            case Format::BC7: DecodeBc7(in, rgba); break;
+            }
+            for (uint32_t py = 0; py < 4 && by * 4 + py < h; ++py) {
+                for (uint32_t px = 0; px < 4 && bx * 4 + px < w; ++px) {
+                    const int t = int(py * 4 + px);
+                    uint8_t* texel = &out[(size_t(by * 4 + py) * w + bx * 4 + px) * 4];
+                    switch (chain.format) {
+                    case Format::BC1:
+                    case Format::BC7:
+                        std::memcpy(texel, rgba + t * 4, 4);
+                        break;
+                    case Format::BC3:
+                        std::memcpy(texel, rgba + t * 4, 3);
+                        texel[3] = a[t];
+                        break;
+                    case Format::BC4:
+                        texel[chain.channels[0]] = a[t];
+                        break;
+                    case Format::BC5:
+                        texel[chain.channels[0]] = a[t];
+                        texel[chain.channels[1]] = b[t];
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return out;
+}
+
+uint32_t BlockCompress::ChannelMask(const Chain& chain)
+{
+    switch (chain.format) {
+    case Format::BC1: return 0x7;
+    case Format::BC4: return 1u << chain.channels[0];
+    case Format::BC5: return 1u << chain.channels[0] | 1u << chain.channels[1];
+    default: return 0xF;
+    }
+}
+
+double BlockCompress::Psnr(const uint8_t* a, const uint8_t* b, size_t texels, uint32_t channelMask)
+{
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t t = 0; t < texels; ++t)
+        for (int c = 0; c < 4; ++c) {
+            if (!(channelMask >> c & 1)) continue;
+            const double d = double(a[t * 4 + c]) - double(b[t * 4 + c]);
+            sum += d * d;
+            ++count;
+        }
+    if (count == 0 || sum == 0.0)
+        return 99.0;
+    return 10.0 * std::log10(255.0 * 255.0 / (sum / double(count)));
+}
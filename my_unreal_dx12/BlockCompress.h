@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MipGenerator.h"
+
+// GPU-free block compression of RGBA8 mip chains into the BCn formats the
+// GPU samples directly: 4x4 texel blocks of 8 or 16 bytes. Blocks are fitted
+// along the principal axis of their texels and refined by least squares;
+// the nearest palette entry search is SSE2, block rows run on the JobSystem.
+namespace BlockCompress
+{
+    enum class Format : uint8_t
+    {
+        BC1,    // RGB, 4 bits per texel, alpha ignored
+        BC3,    // BC1 colour with a BC4 alpha, 8 bits per texel
+        BC4,    // one channel, 4 bits per texel
+        BC5,    // two channels, 8 bits per texel
+        BC7,    // RGBA, 8 bits per texel; mode 6 blocks only
+    };
+
+    enum class Quality : uint8_t
+    {
+        Fast,   // one refinement, the p-bits of BC7 picked per endpoint
+        High,   // iterated refinement, every p-bit pair, both BC4 modes
+    };
+
+    struct Settings
+    {
+        Format format = Format::BC7;
+        Quality quality = Quality::Fast;
+        // source channels BC4 (the first) and BC5 (both) store
+        uint8_t channels[2] = { 0, 1 };
+        // false takes the scalar path, for comparison; the output is the same
+        bool simd = true;
+    };
+
+    struct Stats
+    {
+        uint64_t blocks = 0;
+        size_t bytesIn = 0;     // the RGBA8 chain
+        size_t bytesOut = 0;
+        double seconds = 0.0;
+    };
+
+    struct Chain
+    {
+        Format format = Format::BC7;
+        uint8_t channels[2] = { 0, 1 };
+        uint32_t width = 0, height = 0;
+        std::vector<uint8_t> data;      // all levels, rows of blocks
+        std::vector<size_t> offsets;    // per level, in bytes
+
+        uint32_t LevelCount() const { return uint32_t(offsets.size()); }
+        uint32_t LevelWidth(uint32_t level) const { return width >> level ? width >> level : 1; }
+        uint32_t LevelHeight(uint32_t level) const { return height >> level ? height >> level : 1; }
+        const uint8_t* Level(uint32_t level) const { return data.data() + offsets[level]; }
+        std::vector<const void*> LevelPointers() const;
+    };
+
+    // bump when the output of Compress changes
+    constexpr uint32_t kVersion = 1;
+
+    uint32_t BlockBytes(Format format);
+    const char* FormatName(Format format);
+    // Level 0 of a block compressed texture must be whole blocks.
+    inline bool CanCompress(uint32_t width, uint32_t height) { return width && height && width % 4 == 0 && height % 4 == 0; }
+
+    // What the texture loader and the cooker store each content as: BC7
+    // colour, BC5 normal maps (x, y) and BC5 metal/rough maps (g, b).
+    Settings SettingsFor(MipGenerator::Content content, Quality quality = Quality::Fast);
+
+    // Partial blocks at the edges of the small levels repeat their last texel.
+    Chain Compress(const MipGenerator::Chain& mips, const Settings& settings = {}, Stats* stats = nullptr);
+
+    // Level back to RGBA8, the stored channels where Compress read them,
+    // the others 0 and alpha 255.
+    std::vector<uint8_t> Decompress(const Chain& chain, uint32_t level);
+
+    // Peak signal to noise ratio in dB over the channels of mask (bit c for
+    // channel c) of two RGBA8 images; 99 when they are equal.
+    double Psnr(const uint8_t* a, const uint8_t* b, size_t texels, uint32_t channelMask);
+    // the channels Decompress fills from the blocks
+    uint32_t ChannelMask(const Chain& chain);
+}
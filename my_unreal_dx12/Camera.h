@@ -22,6 +22,19 @@ public:
 	DirectX::XMMATRIX View() const { return m_view; }
 	DirectX::XMMATRIX Proj() const { return m_proj; }
 
+	// world space ray through a pixel, dir spans the near to far plane
+	void ScreenRay(float x, float y, float width, float height,
+		DirectX::XMVECTOR& origin, DirectX::XMVECTOR& dir) const
+	{
+		using namespace DirectX;
+		const XMVECTOR nearP = XMVector3Unproject(XMVectorSet(x, y, 0.f, 0.f),
+			0.f, 0.f, width, height, 0.f, 1.f, m_proj, m_view, XMMatrixIdentity());
+		const XMVECTOR farP = XMVector3Unproject(XMVectorSet(x, y, 1.f, 0.f),
+			0.f, 0.f, width, height, 0.f, 1.f, m_proj, m_view, XMMatrixIdentity());
+		origin = nearP;
+		dir = XMVectorSubtract(farP, nearP);
+	}
+
 	DirectX::XMFLOAT3 getPosition() const
 	{
 		using namespace DirectX;
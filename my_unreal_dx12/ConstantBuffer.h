@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <DirectXMath.h>
 #include "Utils.h"
+#include "MemoryLedger.h"
 #include <memory>
 #include <cstring>
 
@@ -26,6 +27,27 @@ struct alignas(16) SceneCB
 
     DirectX::XMFLOAT3 uKe;
     float _pad1;
+
+    // TerrainVertex.hlsl only
+    DirectX::XMFLOAT4 uTerrainNode;   // node x, node z, node size, patch dim
+    DirectX::XMFLOAT4 uTerrainMorph;  // morph start, morph end, height scale, base height
+    DirectX::XMFLOAT4 uTerrainMap;    // origin x, origin z, 1 / texel spacing, unused
+    DirectX::XMFLOAT4 uTerrainColor;
+    DirectX::XMFLOAT4 uTerrainTile;   // tile slice, texel stride, last texel x, last texel z
+
+    // PixelShader.hlsl irradiance probes, see IrradianceVolume
+    DirectX::XMFLOAT4 uProbeOrigin;   // first probe xyz, 1 / spacing
+    DirectX::XMFLOAT4 uProbeDims;     // probe counts x, y, z, unused
+
+    // PixelShader.hlsl image-based specular, see EnvironmentMap
+    DirectX::XMFLOAT4 uEnvParams;     // last specular mip, intensity, 1 with a metal/rough map, unused
+
+    // PixelShader.hlsl atlas rectangles of the maps, see Submesh
+    DirectX::XMFLOAT4 uTextureRect;
+    DirectX::XMFLOAT4 uNormalRect;
+    DirectX::XMFLOAT4 uMetalRoughRect;
+    // PixelShader.hlsl array slices of the maps, see Submesh
+    DirectX::XMUINT4 uSlices;
 };
 
 static_assert(sizeof(SceneCB) % 16 == 0, "SceneCB must be 16-byte aligned");
@@ -54,6 +76,8 @@ public:
             &heap, D3D12_HEAP_FLAG_NONE,
             &buf, D3D12_RESOURCE_STATE_GENERIC_READ,
             nullptr, IID_PPV_ARGS(&m_resource)));
+        m_ledger = MemoryLedger::I().Track(MemoryCategory::ConstantBuffer, "scene constants",
+            0, MemoryLedger::ResourceBytes(device, buf));
 
         D3D12_RANGE r{ 0, 0 };
         DXThrow(m_resource->Map(0, &r, reinterpret_cast<void**>(&m_mapped)));
@@ -72,4 +96,5 @@ private:
     UINT m_sliceSize = 0;
     UINT m_totalSize = 0;
     uint8_t* m_mapped = nullptr;
+    MemoryLedger::Handle m_ledger;
 };
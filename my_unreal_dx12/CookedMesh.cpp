@@ -0,0 +1,231 @@
+#include "CookedMesh.h"
+#include "GeometryCodec.h"
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct Writer {
+        std::vector<uint8_t> buf;
+        void Raw(const void* p, size_t n) {
+            const uint8_t* b = static_cast<const uint8_t*>(p);
+            buf.insert(buf.end(), b, b + n);
+        }
+        void U32(uint32_t v) { Raw(&v, 4); }
+        void F32(float v) { Raw(&v, 4); }
+        void I64(int64_t v) { Raw(&v, 8); }
+        void Str(const std::string& s) { U32(uint32_t(s.size())); Raw(s.data(), s.size()); }
+        void Blob(const std::vector<uint8_t>& b) { U32(uint32_t(b.size())); Raw(b.data(), b.size()); }
+    };
+
+    struct Reader {
+        const uint8_t* p;
+        const uint8_t* end;
+        bool ok = true;
+        void Raw(void* dst, size_t n) {
+            if (!ok || size_t(end - p) < n) { ok = false; return; }
+            memcpy(dst, p, n);
+            p += n;
+        }
+        uint32_t U32() { uint32_t v = 0; Raw(&v, 4); return v; }
+        float F32() { float v = 0; Raw(&v, 4); return v; }
+        int64_t I64() { int64_t v = 0; Raw(&v, 8); return v; }
+        std::string Str() {
+            const uint32_t n = U32();
+            if (!ok || size_t(end - p) < n) { ok = false; return {}; }
+            std::string s(reinterpret_cast<const char*>(p), n);
+            p += n;
+            return s;
+        }
+        std::vector<uint8_t> Blob() {
+            const uint32_t n = U32();
+            if (!ok || size_t(end - p) < n) { ok = false; return {}; }
+            std::vector<uint8_t> b(p, p + n);
+            p += n;
+            return b;
+        }
+    };
+
+    void Stat(const std::string& path, int64_t& size, int64_t& mtime)
+    {
+        std::error_code ec;
+        const auto bytes = fs::file_size(path, ec);
+        const auto time = ec ? fs::file_time_type{} : fs::last_write_time(path, ec);
+        size = ec ? -1 : int64_t(bytes);
+        mtime = ec ? 0 : int64_t(time.time_since_epoch().count());
+    }
+
+    // relative to the cooked file, so that the asset directory can move
+    std::string RelativeTo(const std::string& file, const fs::path& dir)
+    {
+        std::error_code ec;
+        const fs::path absFile = fs::absolute(file, ec);
+        const fs::path absDir = fs::absolute(dir, ec);
+        const fs::path rel = absFile.lexically_normal().lexically_relative(absDir.lexically_normal());
+        return rel.empty() ? file : rel.generic_string();
+    }
+
+    void WriteMaterial(Writer& w, const MaterialDesc& m)
+    {
+        w.Raw(m.kd, sizeof(m.kd));
+        w.Raw(m.ks, sizeof(m.ks));
+        w.Raw(m.ke, sizeof(m.ke));
+        w.F32(m.shininess);
+        w.F32(m.opacity);
+        w.Str(m.texture);
+        w.Str(m.normalMap);
+        w.Str(m.metalRoughMap);
+    }
+
+    void ReadMaterial(Reader& r, MaterialDesc& m)
+    {
+        r.Raw(m.kd, sizeof(m.kd));
+        r.Raw(m.ks, sizeof(m.ks));
+        r.Raw(m.ke, sizeof(m.ke));
+        m.shininess = r.F32();
+        m.opacity = r.F32();
+        m.texture = r.Str();
+        m.normalMap = r.Str();
+        m.metalRoughMap = r.Str();
+    }
+}
+
+bool CookedMesh::Save(const std::string& path, const MeshData& mesh, const std::vector<std::string>& dependencies)
+{
+    if (mesh.indices.size() % 3 != 0) return false;
+
+    Writer w;
+    w.U32(kMagic);
+    w.U32(kVersion);
+    w.U32(uint32_t(sizeof(Vertex)));
+    w.U32(uint32_t(mesh.vertices.size()));
+    w.U32(uint32_t(mesh.indices.size()));
+    const Hash128 hash = HashGeometry(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size());
+    w.Raw(&hash, sizeof(hash));
+
+    const fs::path dir = fs::path(path).parent_path();
+    w.U32(uint32_t(dependencies.size()));
+    for (const std::string& d : dependencies) {
+        int64_t size, mtime;
+        Stat(d, size, mtime);
+        w.Str(RelativeTo(d, dir));
+        w.I64(size);
+        w.I64(mtime);
+    }
+
+    w.F32(mesh.shininess);
+    w.Str(mesh.texture);
+
+    w.U32(uint32_t(mesh.submeshes.size()));
+    for (const auto& sm : mesh.submeshes) {
+        w.U32(sm.indexStart);
+        w.U32(sm.indexCount);
+        w.U32(sm.hasMaterial ? 1u : 0u);
+        WriteMaterial(w, sm.material);
+        w.Raw(sm.bounds, sizeof(sm.bounds));
+        w.F32(sm.uvDensity);
+    }
+
+    w.Blob(GeometryCodec::EncodeVertices(mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex)));
+    w.Blob(GeometryCodec::EncodeIndices(mesh.indices.data(), mesh.indices.size()));
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.is_open()) return false;
+        f.write(reinterpret_cast<const char*>(w.buf.data()), std::streamsize(w.buf.size()));
+        if (!f.good()) return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool CookedMesh::Open(const std::string& path)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f.is_open()) return false;
+    const std::streamsize size = f.tellg();
+    f.seekg(0, std::ios::beg);
+    std::vector<uint8_t> data(size_t(size > 0 ? size : 0));
+    if (!f.read(reinterpret_cast<char*>(data.data()), size)) return false;
+
+    Reader r{ data.data(), data.data() + data.size() };
+    if (r.U32() != kMagic || r.U32() != kVersion || r.U32() != sizeof(Vertex))
+        return false;
+
+    m_path = path;
+    m_header = MeshData{};
+    m_vertexCount = r.U32();
+    m_indexCount = r.U32();
+    r.Raw(&m_contentHash, sizeof(m_contentHash));
+
+    const fs::path dir = fs::path(path).parent_path();
+    const uint32_t dependencyCount = r.U32();
+    if (!r.ok || dependencyCount > data.size() / 20) return false;
+    m_dependencies.resize(dependencyCount);
+    for (Dependency& d : m_dependencies) {
+        const fs::path p(r.Str());
+        d.path = (p.is_relative() ? dir / p : p).generic_string();
+        d.size = r.I64();
+        d.mtime = r.I64();
+    }
+
+    m_header.shininess = r.F32();
+    m_header.texture = r.Str();
+
+    const uint32_t submeshCount = r.U32();
+    if (!r.ok || m_indexCount % 3 != 0 || submeshCount > m_indexCount / 3 + 1) return false;
+    m_header.submeshes.resize(submeshCount);
+    for (auto& sm : m_header.submeshes) {
+        sm.indexStart = r.U32();
+        sm.indexCount = r.U32();
+        sm.hasMaterial = r.U32() != 0;
+        ReadMaterial(r, sm.material);
+        r.Raw(sm.bounds, sizeof(sm.bounds));
+        sm.uvDensity = r.F32();
+        // the draws and the CPU consumers index by these without checking
+        if (uint64_t(sm.indexStart) + sm.indexCount > m_indexCount) return false;
+    }
+
+    m_vertexStream = r.Blob();
+    m_indexStream = r.Blob();
+    return r.ok;
+}
+
+bool CookedMesh::DependenciesCurrent() const
+{
+    for (const Dependency& d : m_dependencies) {
+        int64_t size, mtime;
+        Stat(d.path, size, mtime);
+        if (size != d.size || mtime != d.mtime)
+            return false;
+    }
+    return true;
+}
+
+bool CookedMesh::DecodeVertices(Vertex* dst) const
+{
+    return GeometryCodec::DecodeVertices(dst, m_vertexCount, sizeof(Vertex),
+        m_vertexStream.data(), m_vertexStream.size());
+}
+
+bool CookedMesh::DecodeIndices(uint32_t* dst) const
+{
+    return GeometryCodec::DecodeIndices(dst, m_indexCount, m_vertexCount,
+        m_indexStream.data(), m_indexStream.size());
+}
+
+bool CookedMesh::Load(const std::string& path, MeshData& out)
+{
+    CookedMesh file;
+    if (!file.Open(path)) return false;
+
+    out = file.Header();
+    out.vertices.resize(file.VertexCount());
+    out.indices.resize(file.IndexCount());
+    return file.DecodeVertices(out.vertices.data()) && file.DecodeIndices(out.indices.data());
+}
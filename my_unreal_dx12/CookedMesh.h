@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// On-disk cooked mesh: the files it was built from, submesh/material table
+// followed by the compressed vertex and index streams (see GeometryCodec).
+// The streams stay encoded after Open so they can be decoded straight into
+// their final destination.
+class CookedMesh
+{
+public:
+    static constexpr uint32_t kMagic = 0x48534D43; // "CMSH"
+    static constexpr uint32_t kVersion = 5;
+
+    static std::string PathFor(const std::string& sourcePath) { return sourcePath + ".cmesh"; }
+
+    // dependencies are the files the mesh was imported from (OBJ, MTL
+    // libraries, the textures they name), stored with their size and mtime
+    static bool Save(const std::string& path, const MeshData& mesh,
+        const std::vector<std::string>& dependencies = {});
+    static bool Load(const std::string& path, MeshData& out);
+
+    bool Open(const std::string& path);
+    const std::string& Path() const { return m_path; }
+
+    // mesh description without vertices/indices
+    const MeshData& Header() const { return m_header; }
+    uint32_t VertexCount() const { return m_vertexCount; }
+    uint32_t IndexCount() const { return m_indexCount; }
+    // HashGeometry of the decoded streams, computed when the file was cooked
+    const Hash128& ContentHash() const { return m_contentHash; }
+    // false when a dependency changed size or mtime, or appeared or went
+    // away since the file was cooked
+    bool DependenciesCurrent() const;
+
+    bool DecodeVertices(Vertex* dst) const;
+    // fails on an index that is not below VertexCount
+    bool DecodeIndices(uint32_t* dst) const;
+
+private:
+    struct Dependency
+    {
+        std::string path;           // resolved against the cooked file's directory
+        int64_t size = -1;          // -1: the file did not exist
+        int64_t mtime = 0;
+    };
+
+    std::string m_path;
+    MeshData m_header;
+    uint32_t m_vertexCount = 0;
+    uint32_t m_indexCount = 0;
+    Hash128 m_contentHash;
+    std::vector<Dependency> m_dependencies;
+    std::vector<uint8_t> m_vertexStream;
+    std::vector<uint8_t> m_indexStream;
+};
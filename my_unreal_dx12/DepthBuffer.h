@@ -3,6 +3,7 @@
 #include <d3d12.h>
 #include "Utils.h"
 #include "GraphicsDevice.h"
+#include "MemoryLedger.h"
 
 
 class DepthBuffer
@@ -26,6 +27,8 @@ public:
 
 		DXThrow(gd.Device()->CreateCommittedResource(&heap, D3D12_HEAP_FLAG_NONE, &d,
 			D3D12_RESOURCE_STATE_DEPTH_WRITE, &clear, IID_PPV_ARGS(&m_tex)));
+		m_ledger = MemoryLedger::I().Track(MemoryCategory::RenderTarget, "depth buffer",
+			0, MemoryLedger::ResourceBytes(gd.Device(), d));
 
 
 		D3D12_DESCRIPTOR_HEAP_DESC desc{}; desc.NumDescriptors = 1; desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
@@ -51,4 +54,5 @@ public:
 private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_tex;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_heap;
+	MemoryLedger::Handle m_ledger;
 };
\ No newline at end of file
@@ -0,0 +1,627 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "EnvironmentMap.h"
+#include "HalfFloat.h"
+#include "JobSystem.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define ENVIRONMENT_SSE2 1
+#endif
+
+namespace
+{
+    constexpr float kPi = 3.14159265359f;
+    constexpr uint32_t kMaxSourceSize = 512;
+
+    // clamped cosine convolution per band (pi, 2pi/3, pi/4), divided by pi,
+    // the convention of IrradianceVolume
+    constexpr float kBand[9] = { 1.f, 2.f / 3.f, 2.f / 3.f, 2.f / 3.f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+    void EvalBasis(const float d[3], float y[9])
+    {
+        const float x = d[0], yy = d[1], z = d[2];
+        y[0] = 0.282095f;
+        y[1] = 0.488603f * yy;
+        y[2] = 0.488603f * z;
+        y[3] = 0.488603f * x;
+        y[4] = 1.092548f * x * yy;
+        y[5] = 1.092548f * yy * z;
+        y[6] = 0.315392f * (3.f * z * z - 1.f);
+        y[7] = 1.092548f * x * z;
+        y[8] = 0.546274f * (x * x - yy * yy);
+    }
+
+    uint32_t NextPow2(uint32_t v)
+    {
+        uint32_t p = 1;
+        while (p < v) p <<= 1;
+        return p;
+    }
+
+    // D3D cube layout, u and v in [-1, 1] with v growing down the face
+    void FaceDirection(uint32_t face, float u, float v, float d[3])
+    {
+        switch (face) {
+        case 0: d[0] = 1.f; d[1] = -v; d[2] = -u; break;
+        case 1: d[0] = -1.f; d[1] = -v; d[2] = u; break;
+        case 2: d[0] = u; d[1] = 1.f; d[2] = v; break;
+        case 3: d[0] = u; d[1] = -1.f; d[2] = -v; break;
+        case 4: d[0] = u; d[1] = -v; d[2] = 1.f; break;
+        default: d[0] = -u; d[1] = -v; d[2] = -1.f; break;
+        }
+        const float inv = 1.f / std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        d[0] *= inv; d[1] *= inv; d[2] *= inv;
+    }
+
+    void DirectionToFace(const float d[3], uint32_t& face, float& u, float& v)
+    {
+        const float ax = std::fabs(d[0]), ay = std::fabs(d[1]), az = std::fabs(d[2]);
+        if (ax >= ay && ax >= az) {
+            const float inv = 1.f / ax;
+            face = d[0] > 0.f ? 0 : 1;
+            u = (d[0] > 0.f ? -d[2] : d[2]) * inv;
+            v = -d[1] * inv;
+        }
+        else if (ay >= az) {
+            const float inv = 1.f / ay;
+            face = d[1] > 0.f ? 2 : 3;
+            u = d[0] * inv;
+            v = (d[1] > 0.f ? d[2] : -d[2]) * inv;
+        }
+        else {
+            const float inv = 1.f / az;
+            face = d[2] > 0.f ? 4 : 5;
+            u = (d[2] > 0.f ? d[0] : -d[0]) * inv;
+            v = -d[1] * inv;
+        }
+    }
+
+    // any vector perpendicular to n, then the third axis
+    void TangentFrame(const float n[3], float t[3], float b[3])
+    {
+        const float up[3] = { std::fabs(n[2]) < 0.999f ? 0.f : 1.f, 0.f, std::fabs(n[2]) < 0.999f ? 1.f : 0.f };
+        t[0] = up[1] * n[2] - up[2] * n[1];
+        t[1] = up[2] * n[0] - up[0] * n[2];
+        t[2] = up[0] * n[1] - up[1] * n[0];
+        const float inv = 1.f / std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+        t[0] *= inv; t[1] *= inv; t[2] *= inv;
+        b[0] = n[1] * t[2] - n[2] * t[1];
+        b[1] = n[2] * t[0] - n[0] * t[2];
+        b[2] = n[0] * t[1] - n[1] * t[0];
+    }
+
+    float RadicalInverse(uint32_t bits)
+    {
+        bits = (bits << 16) | (bits >> 16);
+        bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+        bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+        bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+        bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+        return float(bits) * 2.3283064365386963e-10f;
+    }
+
+    // GGX half vector around +Z for the i-th of n Hammersley points
+    void SampleGGX(uint32_t i, uint32_t n, float alpha, float h[3])
+    {
+        const float phi = 2.f * kPi * (float(i) + 0.5f) / float(n);
+        const float e = RadicalInverse(i);
+        const float cosTheta = std::sqrt((1.f - e) / (1.f + (alpha * alpha - 1.f) * e));
+        const float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+        h[0] = sinTheta * std::cos(phi);
+        h[1] = sinTheta * std::sin(phi);
+        h[2] = cosTheta;
+    }
+
+#if ENVIRONMENT_SSE2
+    using Rgba = __m128;
+    Rgba Load(const float* p) { return _mm_loadu_ps(p); }
+    Rgba Zero() { return _mm_setzero_ps(); }
+    Rgba Lerp(Rgba a, Rgba b, float t) { return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t))); }
+    Rgba MulAdd(Rgba acc, Rgba a, float w) { return _mm_add_ps(acc, _mm_mul_ps(a, _mm_set1_ps(w))); }
+    void Store(float* p, Rgba v) { _mm_storeu_ps(p, v); }
+#else
+    struct Rgba { float v[4]; };
+    Rgba Load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+    Rgba Zero() { return {}; }
+    Rgba Lerp(Rgba a, Rgba b, float t)
+    {
+        for (int c = 0; c < 4; ++c) a.v[c] += (b.v[c] - a.v[c]) * t;
+        return a;
+    }
+    Rgba MulAdd(Rgba acc, Rgba a, float w)
+    {
+        for (int c = 0; c < 4; ++c) acc.v[c] += a.v[c] * w;
+        return acc;
+    }
+    void Store(float* p, Rgba v) { for (int c = 0; c < 4; ++c) p[c] = v.v[c]; }
+#endif
+
+    // six faces of size x size RGBA floats, clamped at the face edges
+    Rgba Bilinear(const float* faces, uint32_t size, uint32_t face, float u, float v)
+    {
+        const float fx = std::clamp((u * 0.5f + 0.5f) * size - 0.5f, 0.f, float(size - 1));
+        const float fy = std::clamp((v * 0.5f + 0.5f) * size - 0.5f, 0.f, float(size - 1));
+        const uint32_t x0 = uint32_t(fx), y0 = uint32_t(fy);
+        const uint32_t x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+        const float tx = fx - float(x0), ty = fy - float(y0);
+        const float* base = faces + size_t(face) * size * size * 4;
+        const Rgba top = Lerp(Load(base + (size_t(y0) * size + x0) * 4), Load(base + (size_t(y0) * size + x1) * 4), tx);
+        const Rgba bottom = Lerp(Load(base + (size_t(y1) * size + x0) * 4), Load(base + (size_t(y1) * size + x1) * 4), tx);
+        return Lerp(top, bottom, ty);
+    }
+
+    // per mip, the reflected directions around +Z with their N.L weight and
+    // the source mip matching their share of the lobe; padded to four
+    struct Kernel
+    {
+        std::vector<float> x, y, z, weight, lod;
+        float weightSum = 0.f;
+
+        void Add(float lx, float ly, float lz, float w, float l)
+        {
+            x.push_back(lx); y.push_back(ly); z.push_back(lz);
+            weight.push_back(w); lod.push_back(l);
+            weightSum += w;
+        }
+        void Pad()
+        {
+            while (x.size() % 4) Add(0.f, 0.f, 1.f, 0.f, 0.f);
+        }
+    };
+
+    Kernel BuildKernel(float roughness, uint32_t samples, uint32_t faceSize, uint32_t sourceSize, uint32_t sourceLevels)
+    {
+        Kernel k;
+        const float maxLod = float(sourceLevels - 1);
+        if (roughness <= 0.f) {
+            // a mirror: one tap at the source mip of the same resolution
+            k.Add(0.f, 0.f, 1.f, 1.f, std::clamp(std::log2(float(sourceSize) / float(faceSize)), 0.f, maxLod));
+            k.Pad();
+            return k;
+        }
+
+        // Karis' filtered importance sampling: each tap reads the mip whose
+        // texels cover the solid angle the sample stands for
+        const float alpha = roughness * roughness;
+        const float texelSolidAngle = 4.f * kPi / (6.f * float(sourceSize) * float(sourceSize));
+        for (uint32_t i = 0; i < samples; ++i) {
+            float h[3];
+            SampleGGX(i, samples, alpha, h);
+            // L = reflect(-V, H) with V = N = +Z
+            const float l[3] = { 2.f * h[2] * h[0], 2.f * h[2] * h[1], 2.f * h[2] * h[2] - 1.f };
+            if (l[2] <= 0.f) continue;
+
+            const float a2 = alpha * alpha;
+            const float denom = h[2] * h[2] * (a2 - 1.f) + 1.f;
+            const float pdf = a2 / (kPi * denom * denom) * 0.25f;    // D * N.H / (4 V.H), N.H = V.H
+            const float sampleSolidAngle = 1.f / (float(samples) * pdf + 1e-6f);
+            const float lod = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.f;
+            k.Add(l[0], l[1], l[2], l[2], std::clamp(lod, 0.f, maxLod));
+        }
+        k.Pad();
+        return k;
+    }
+
+    float SmithG1(float nDotX, float k) { return nDotX / (nDotX * (1.f - k) + k); }
+}
+
+EnvironmentMap::Settings EnvironmentMap::Effective(const Settings& settings)
+{
+    Settings s = settings;
+    s.faceSize = NextPow2(std::clamp(s.faceSize, 1u, 2048u));
+    uint32_t levels = 1;
+    while ((s.faceSize >> levels) > 0) ++levels;
+    s.mipCount = std::clamp(s.mipCount, 1u, levels);
+    s.samples = std::max(s.samples, 1u);
+    s.lutSize = std::clamp(s.lutSize, 1u, 1024u);
+    s.lutSamples = std::max(s.lutSamples, 1u);
+    return s;
+}
+
+void EnvironmentMap::BuildSourceMips()
+{
+    m_source.resize(1);
+    uint32_t size = m_sourceSize;
+    while (size > 1) {
+        const uint32_t next = std::max(1u, size / 2);
+        const std::vector<float>& src = m_source.back();
+        std::vector<float> dst(size_t(6) * next * next * 4);
+        for (uint32_t face = 0; face < 6; ++face) {
+            const float* s = src.data() + size_t(face) * size * size * 4;
+            float* d = dst.data() + size_t(face) * next * next * 4;
+            for (uint32_t y = 0; y < next; ++y)
+                for (uint32_t x = 0; x < next; ++x) {
+                    const uint32_t x0 = std::min(2 * x, size - 1), x1 = std::min(2 * x + 1, size - 1);
+                    const uint32_t y0 = std::min(2 * y, size - 1), y1 = std::min(2 * y + 1, size - 1);
+                    for (int c = 0; c < 4; ++c)
+                        d[(size_t(y) * next + x) * 4 + c] = 0.25f * (
+                            s[(size_t(y0) * size + x0) * 4 + c] + s[(size_t(y0) * size + x1) * 4 + c] +
+                            s[(size_t(y1) * size + x0) * 4 + c] + s[(size_t(y1) * size + x1) * 4 + c]);
+                }
+        }
+        m_source.push_back(std::move(dst));
+        size = next;
+    }
+}
+
+bool EnvironmentMap::LoadSource(const std::string& path)
+{
+    int w = 0, h = 0, comp = 0;
+    std::unique_ptr<float, void(*)(void*)> pixels(stbi_loadf(path.c_str(), &w, &h, &comp, 3), stbi_image_free);
+    if (!pixels || w <= 0 || h <= 0)
+        return false;
+    const float* src = pixels.get();
+
+    m_source.clear();
+    if (w == 6 * h) {
+        m_sourceSize = uint32_t(h);
+        std::vector<float> faces(size_t(6) * h * h * 4);
+        for (uint32_t face = 0; face < 6; ++face)
+            for (int y = 0; y < h; ++y)
+                for (int x = 0; x < h; ++x) {
+                    const float* p = src + (size_t(y) * w + size_t(face) * h + x) * 3;
+                    float* q = faces.data() + ((size_t(face) * h + y) * h + x) * 4;
+                    q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = 1.f;
+                }
+        m_source.push_back(std::move(faces));
+    }
+    else {
+        const uint32_t size = std::clamp(NextPow2(uint32_t(w) / 4), 16u, kMaxSourceSize);
+        m_sourceSize = size;
+        std::vector<float> faces(size_t(6) * size * size * 4);
+        JobSystem::I().ParallelFor(size_t(6) * size, 4, [&](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; ++row) {
+                const uint32_t face = uint32_t(row / size), y = uint32_t(row % size);
+                for (uint32_t x = 0; x < size; ++x) {
+                    float d[3];
+                    FaceDirection(face, (x + 0.5f) / size * 2.f - 1.f, (y + 0.5f) / size * 2.f - 1.f, d);
+                    const float ex = (0.5f + std::atan2(d[0], -d[2]) / (2.f * kPi)) * w - 0.5f;
+                    const float ey = std::clamp(std::acos(std::clamp(d[1], -1.f, 1.f)) / kPi * h - 0.5f, 0.f, float(h - 1));
+                    const float fx = std::floor(ex);
+                    const int x0 = (int(fx) % w + w) % w, x1 = (x0 + 1) % w;
+                    const int y0 = int(ey), y1 = std::min(y0 + 1, h - 1);
+                    const float tx = ex - fx, ty = ey - float(y0);
+                    float* q = faces.data() + ((size_t(face) * size + y) * size + x) * 4;
+                    for (int c = 0; c < 3; ++c) {
+                        const float top = src[(size_t(y0) * w + x0) * 3 + c] * (1.f - tx) + src[(size_t(y0) * w + x1) * 3 + c] * tx;
+                        const float bottom = src[(size_t(y1) * w + x0) * 3 + c] * (1.f - tx) + src[(size_t(y1) * w + x1) * 3 + c] * tx;
+                        q[c] = top * (1.f - ty) + bottom * ty;
+                    }
+                    q[3] = 1.f;
+                }
+            }
+        });
+        m_source.push_back(std::move(faces));
+    }
+    BuildSourceMips();
+    return true;
+}
+
+void EnvironmentMap::SetSky(const float sunDirection[3], uint32_t faceSize)
+{
+    const float len = std::sqrt(sunDirection[0] * sunDirection[0] + sunDirection[1] * sunDirection[1] + sunDirection[2] * sunDirection[2]);
+    const float sun[3] = { sunDirection[0] / len, sunDirection[1] / len, sunDirection[2] / len };
+    const float zenith[3] = { 0.10f, 0.20f, 0.42f }, horizon[3] = { 0.45f, 0.48f, 0.52f };
+    const float ground[3] = { 0.08f, 0.07f, 0.06f }, glow[3] = { 1.6f, 1.4f, 1.0f };
+
+    const uint32_t size = NextPow2(std::clamp(faceSize, 4u, kMaxSourceSize));
+    m_sourceSize = size;
+    m_source.assign(1, std::vector<float>(size_t(6) * size * size * 4));
+    for (uint32_t face = 0; face < 6; ++face)
+        for (uint32_t y = 0; y < size; ++y)
+            for (uint32_t x = 0; x < size; ++x) {
+                float d[3];
+                FaceDirection(face, (x + 0.5f) / size * 2.f - 1.f, (y + 0.5f) / size * 2.f - 1.f, d);
+                float* q = m_source[0].data() + ((size_t(face) * size + y) * size + x) * 4;
+                const float up = std::sqrt(std::max(d[1], 0.f));
+                const float down = std::min(-d[1] * 4.f, 1.f);
+                const float sunCos = std::max(0.f, d[0] * sun[0] + d[1] * sun[1] + d[2] * sun[2]);
+                const float halo = std::pow(sunCos, 32.f) * (d[1] > -0.05f ? 1.f : 0.f);
+                for (int c = 0; c < 3; ++c)
+                    q[c] = d[1] >= 0.f ? horizon[c] + (zenith[c] - horizon[c]) * up + glow[c] * halo
+                                       : horizon[c] * 0.5f + (ground[c] - horizon[c] * 0.5f) * down;
+                q[3] = 1.f;
+            }
+    BuildSourceMips();
+}
+
+EnvironmentMap::Stats EnvironmentMap::Prefilter(const Settings& requested)
+{
+    Stats stats;
+    if (m_source.empty()) return stats;
+    const Settings s = Effective(requested);
+    m_settings = s;
+    const uint32_t levels = uint32_t(m_source.size());
+
+    // ---- specular chain ------------------------------------------------------
+
+    auto t0 = std::chrono::steady_clock::now();
+    m_specularOffsets.assign(size_t(6) * s.mipCount, 0);
+    size_t total = 0;
+    for (uint32_t face = 0; face < 6; ++face)
+        for (uint32_t mip = 0; mip < s.mipCount; ++mip) {
+            const uint32_t size = std::max(1u, s.faceSize >> mip);
+            m_specularOffsets[size_t(face) * s.mipCount + mip] = total;
+            total += size_t(size) * size * 4;
+        }
+    m_specular.assign(total, 0);
+
+    std::atomic<uint64_t> taps{ 0 };
+    for (uint32_t mip = 0; mip < s.mipCount; ++mip) {
+        const uint32_t size = std::max(1u, s.faceSize >> mip);
+        const float roughness = s.mipCount > 1 ? float(mip) / float(s.mipCount - 1) : 0.f;
+        const Kernel k = BuildKernel(roughness, s.samples, size, m_sourceSize, levels);
+        const float invWeight = 1.f / std::max(k.weightSum, 1e-6f);
+        const size_t count = k.x.size();
+
+        JobSystem::I().ParallelFor(size_t(6) * size, 1, [&](size_t begin, size_t end) {
+            alignas(16) float dir[3][4];
+            uint64_t fetched = 0;
+            for (size_t row = begin; row < end; ++row) {
+                const uint32_t face = uint32_t(row / size), y = uint32_t(row % size);
+                uint16_t* out = m_specular.data() + m_specularOffsets[size_t(face) * s.mipCount + mip] + size_t(y) * size * 4;
+                for (uint32_t x = 0; x < size; ++x) {
+                    float n[3], t[3], b[3];
+                    FaceDirection(face, (x + 0.5f) / size * 2.f - 1.f, (y + 0.5f) / size * 2.f - 1.f, n);
+                    TangentFrame(n, t, b);
+
+                    Rgba acc = Zero();
+#if ENVIRONMENT_SSE2
+                    const __m128 tx = _mm_set1_ps(t[0]), ty = _mm_set1_ps(t[1]), tz = _mm_set1_ps(t[2]);
+                    const __m128 bx = _mm_set1_ps(b[0]), by = _mm_set1_ps(b[1]), bz = _mm_set1_ps(b[2]);
+                    const __m128 nx = _mm_set1_ps(n[0]), ny = _mm_set1_ps(n[1]), nz = _mm_set1_ps(n[2]);
+#endif
+                    for (size_t i = 0; i < count; i += 4) {
+                        // four taps from tangent to world space at once
+#if ENVIRONMENT_SSE2
+                        const __m128 lx = _mm_loadu_ps(&k.x[i]), ly = _mm_loadu_ps(&k.y[i]), lz = _mm_loadu_ps(&k.z[i]);
+                        _mm_store_ps(dir[0], _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, lx), _mm_mul_ps(bx, ly)), _mm_mul_ps(nx, lz)));
+                        _mm_store_ps(dir[1], _mm_add_ps(_mm_add_ps(_mm_mul_ps(ty, lx), _mm_mul_ps(by, ly)), _mm_mul_ps(ny, lz)));
+                        _mm_store_ps(dir[2], _mm_add_ps(_mm_add_ps(_mm_mul_ps(tz, lx), _mm_mul_ps(bz, ly)), _mm_mul_ps(nz, lz)));
+#else
+                        for (int lane = 0; lane < 4; ++lane)
+                            for (int a = 0; a < 3; ++a)
+                                dir[a][lane] = t[a] * k.x[i + lane] + b[a] * k.y[i + lane] + n[a] * k.z[i + lane];
+#endif
+                        for (int lane = 0; lane < 4; ++lane) {
+                            const float w = k.weight[i + lane];
+                            if (w <= 0.f) continue;
+                            const float d[3] = { dir[0][lane], dir[1][lane], dir[2][lane] };
+                            uint32_t f;
+                            float u, v;
+                            DirectionToFace(d, f, u, v);
+
+                            const float lod = k.lod[i + lane];
+                            const uint32_t l0 = uint32_t(lod), l1 = std::min(l0 + 1, levels - 1);
+                            Rgba c = Bilinear(m_source[l0].data(), std::max(1u, m_sourceSize >> l0), f, u, v);
+                            if (l1 != l0 && lod > float(l0))
+                                c = Lerp(c, Bilinear(m_source[l1].data(), std::max(1u, m_sourceSize >> l1), f, u, v), lod - float(l0));
+                            acc = MulAdd(acc, c, w);
+                            ++fetched;
+                        }
+                    }
+
+                    alignas(16) float rgba[4];
+                    Store(rgba, acc);
+                    for (int c = 0; c < 3; ++c)
+                        out[x * 4 + c] = FloatToHalf(rgba[c] * invWeight);
+                    out[x * 4 + 3] = FloatToHalf(1.f);
+                }
+            }
+            taps.fetch_add(fetched, std::memory_order_relaxed);
+        });
+    }
+    stats.taps = taps.load();
+    auto t1 = std::chrono::steady_clock::now();
+    stats.specularSeconds = std::chrono::duration<double>(t1 - t0).count();
+
+    // ---- diffuse irradiance -----------------------------------------------------
+
+    // projected from the first source mip of at most 32 texels a side
+    uint32_t level = 0;
+    while (level + 1 < levels && (m_sourceSize >> level) > 32) ++level;
+    const uint32_t size = std::max(1u, m_sourceSize >> level);
+    double sh[9][3] = {};
+    double solidAngle = 0.0;
+    for (uint32_t face = 0; face < 6; ++face)
+        for (uint32_t y = 0; y < size; ++y)
+            for (uint32_t x = 0; x < size; ++x) {
+                const float u = (x + 0.5f) / size * 2.f - 1.f, v = (y + 0.5f) / size * 2.f - 1.f;
+                float d[3], basis[9];
+                FaceDirection(face, u, v, d);
+                EvalBasis(d, basis);
+                // texel solid angle on the unit cube face
+                const float r2 = 1.f + u * u + v * v;
+                const double dw = (4.0 / (double(size) * size)) / (r2 * std::sqrt(r2));
+                const float* c = m_source[level].data() + ((size_t(face) * size + y) * size + x) * 4;
+                for (int k = 0; k < 9; ++k)
+                    for (int ch = 0; ch < 3; ++ch)
+                        sh[k][ch] += basis[k] * c[ch] * dw;
+                solidAngle += dw;
+            }
+    const double norm = 4.0 * kPi / solidAngle;
+    for (int k = 0; k < 9; ++k)
+        for (int ch = 0; ch < 3; ++ch)
+            m_irradiance[k][ch] = float(sh[k][ch] * norm * kBand[k]);
+    auto t2 = std::chrono::steady_clock::now();
+    stats.irradianceSeconds = std::chrono::duration<double>(t2 - t1).count();
+
+    // ---- BRDF table -------------------------------------------------------------
+
+    m_lut.assign(size_t(s.lutSize) * s.lutSize * 2, 0);
+    JobSystem::I().ParallelFor(s.lutSize, 1, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            const float roughness = (float(y) + 0.5f) / float(s.lutSize);
+            const float alpha = roughness * roughness;
+            const float k = alpha * 0.5f;   // Smith-Schlick for image-based lighting
+            for (uint32_t x = 0; x < s.lutSize; ++x) {
+                const float nDotV = (float(x) + 0.5f) / float(s.lutSize);
+                const float view[3] = { std::sqrt(1.f - nDotV * nDotV), 0.f, nDotV };
+                float scale = 0.f, bias = 0.f;
+                for (uint32_t i = 0; i < s.lutSamples; ++i) {
+                    float h[3];
+                    SampleGGX(i, s.lutSamples, alpha, h);
+                    const float vDotH = view[0] * h[0] + view[2] * h[2];
+                    const float nDotL = 2.f * vDotH * h[2] - view[2];
+                    if (nDotL <= 0.f) continue;
+                    const float g = SmithG1(nDotV, k) * SmithG1(nDotL, k);
+                    const float gVis = g * std::max(vDotH, 0.f) / (h[2] * nDotV);
+                    const float fc = std::pow(1.f - std::max(vDotH, 0.f), 5.f);
+                    scale += (1.f - fc) * gVis;
+                    bias += fc * gVis;
+                }
+                uint16_t* out = m_lut.data() + (y * s.lutSize + x) * 2;
+                out[0] = FloatToHalf(scale / float(s.lutSamples));
+                out[1] = FloatToHalf(bias / float(s.lutSamples));
+            }
+        }
+    });
+    stats.lutSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t2).count();
+    stats.bytes = (m_specular.size() + m_lut.size()) * sizeof(uint16_t);
+    return stats;
+}
+
+const uint16_t* EnvironmentMap::Specular(uint32_t face, uint32_t mip) const
+{
+    if (face >= 6 || mip >= m_settings.mipCount || m_specular.empty()) return nullptr;
+    return m_specular.data() + m_specularOffsets[size_t(face) * m_settings.mipCount + mip];
+}
+
+void EnvironmentMap::SampleSpecular(const float d[3], float mip, float out[3]) const
+{
+    out[0] = out[1] = out[2] = 0.f;
+    if (m_specular.empty()) return;
+
+    uint32_t face;
+    float u, v;
+    DirectionToFace(d, face, u, v);
+    mip = std::clamp(mip, 0.f, float(m_settings.mipCount - 1));
+    const uint32_t m0 = uint32_t(mip), m1 = std::min(m0 + 1, m_settings.mipCount - 1);
+    const float tm = mip - float(m0);
+
+    for (uint32_t m : { m0, m1 }) {
+        const float weight = m == m0 ? (m0 == m1 ? 1.f : 1.f - tm) : tm;
+        if (weight <= 0.f) continue;
+        const uint32_t size = std::max(1u, m_settings.faceSize >> m);
+        const uint16_t* texels = Specular(face, m);
+        const float fx = std::clamp((u * 0.5f + 0.5f) * size - 0.5f, 0.f, float(size - 1));
+        const float fy = std::clamp((v * 0.5f + 0.5f) * size - 0.5f, 0.f, float(size - 1));
+        const uint32_t x0 = uint32_t(fx), y0 = uint32_t(fy);
+        const uint32_t x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+        const float tx = fx - float(x0), ty = fy - float(y0);
+        for (int c = 0; c < 3; ++c) {
+            auto at = [&](uint32_t x, uint32_t y) { return HalfToFloat(texels[(size_t(y) * size + x) * 4 + c]); };
+            const float top = at(x0, y0) * (1.f - tx) + at(x1, y0) * tx;
+            const float bottom = at(x0, y1) * (1.f - tx) + at(x1, y1) * tx;
+            out[c] += weight * (top * (1.f - ty) + bottom * ty);
+        }
+    }
+}
+
+bool EnvironmentMap::Save(const std::string& path) const
+{
+    if (m_specular.empty()) return false;
+    const uint32_t header[9] = { kMagic, kVersion, m_settings.faceSize, m_settings.mipCount, m_settings.samples,
+        m_settings.lutSize, m_settings.lutSamples, uint32_t(m_specular.size()), uint32_t(m_lut.size()) };
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.is_open()) return false;
+        f.write(reinterpret_cast<const char*>(header), sizeof(header));
+        f.write(reinterpret_cast<const char*>(m_irradiance), sizeof(m_irradiance));
+        f.write(reinterpret_cast<const char*>(m_specular.data()), std::streamsize(m_specular.size() * sizeof(uint16_t)));
+        f.write(reinterpret_cast<const char*>(m_lut.data()), std::streamsize(m_lut.size() * sizeof(uint16_t)));
+        if (!f.good()) return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool EnvironmentMap::Load(const std::string& path)
+{
+    m_specular.clear();
+    m_specularOffsets.clear();
+    m_lut.clear();
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open()) return false;
+
+    uint32_t header[9];
+    if (!f.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != kMagic || header[1] != kVersion)
+        return false;
+    Settings s;
+    s.faceSize = header[2]; s.mipCount = header[3]; s.samples = header[4];
+    s.lutSize = header[5]; s.lutSamples = header[6];
+    const Settings e = Effective(s);
+    if (e.faceSize != s.faceSize || e.mipCount != s.mipCount || e.lutSize != s.lutSize)
+        return false;
+
+    std::vector<size_t> offsets(size_t(6) * s.mipCount);
+    size_t total = 0;
+    for (uint32_t face = 0; face < 6; ++face)
+        for (uint32_t mip = 0; mip < s.mipCount; ++mip) {
+            const uint32_t size = std::max(1u, s.faceSize >> mip);
+            offsets[size_t(face) * s.mipCount + mip] = total;
+            total += size_t(size) * size * 4;
+        }
+    if (header[7] != total || header[8] != size_t(s.lutSize) * s.lutSize * 2)
+        return false;
+
+    std::vector<uint16_t> specular(total), lut(header[8]);
+    if (!f.read(reinterpret_cast<char*>(m_irradiance), sizeof(m_irradiance)) ||
+        !f.read(reinterpret_cast<char*>(specular.data()), std::streamsize(total * sizeof(uint16_t))) ||
+        !f.read(reinterpret_cast<char*>(lut.data()), std::streamsize(lut.size() * sizeof(uint16_t))))
+        return false;
+
+    m_settings = s;
+    m_specular = std::move(specular);
+    m_specularOffsets = std::move(offsets);
+    m_lut = std::move(lut);
+    return true;
+}
+
+bool EnvironmentMap::LoadOrBuild(const std::string& path, const Settings& settings, Stats* stats)
+{
+    Stats local;
+    Stats& out = stats ? *stats : local;
+    out = Stats{};
+    const auto t0 = std::chrono::steady_clock::now();
+    const Settings want = Effective(settings);
+    const std::string cache = CachePathFor(path);
+
+    std::error_code ec, ecCache;
+    const auto srcTime = std::filesystem::last_write_time(path, ec);
+    const auto cacheTime = std::filesystem::last_write_time(cache, ecCache);
+    if (!ecCache && (ec || cacheTime >= srcTime) && Load(cache) &&
+        m_settings.faceSize == want.faceSize && m_settings.mipCount == want.mipCount &&
+        m_settings.samples == want.samples && m_settings.lutSize == want.lutSize && m_settings.lutSamples == want.lutSamples) {
+        out.cached = true;
+        out.loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        out.bytes = (m_specular.size() + m_lut.size()) * sizeof(uint16_t);
+        return true;
+    }
+
+    if (!LoadSource(path))
+        return false;
+    const double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    out = Prefilter(want);
+    out.loadSeconds = loadSeconds;
+    if (!Save(cache))
+        std::fprintf(stderr, "Warning: unable to write %s\n", cache.c_str());
+
+    m_source.clear();
+    m_source.shrink_to_fit();
+    m_sourceSize = 0;
+    return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GPU-free image-based lighting prefiltered from an HDR environment:
+//  - a GGX specular cube, mip m convolved for roughness m / (MipCount - 1)
+//    and sampled along the reflection vector (split-sum, N = V = R);
+//  - the diffuse irradiance as L2 SH, convolved and divided by pi the way
+//    IrradianceVolume stores its probes;
+//  - the split-sum BRDF table: x = N.V, y = roughness, scale and bias of F0.
+// Prefiltering runs on the JobSystem. LoadOrBuild caches the result next to
+// the source, so an environment is only prefiltered once per settings.
+class EnvironmentMap
+{
+public:
+    static constexpr uint32_t kMagic = 0x31564E45; // "ENV1"
+    static constexpr uint32_t kVersion = 1;
+
+    struct Settings
+    {
+        uint32_t faceSize = 128;    // specular mip 0, rounded up to a power of two
+        uint32_t mipCount = 6;      // clamped to the chain of faceSize
+        uint32_t samples = 128;     // GGX samples per texel of the rough mips
+        uint32_t lutSize = 64;
+        uint32_t lutSamples = 512;
+    };
+
+    struct Stats
+    {
+        bool cached = false;
+        double loadSeconds = 0.0;       // decode and resample to the source cube
+        double specularSeconds = 0.0;
+        double irradianceSeconds = 0.0;
+        double lutSeconds = 0.0;
+        uint64_t taps = 0;              // source fetches of the specular chain
+        size_t bytes = 0;               // cube and table as the GPU holds them
+    };
+
+    // Equirectangular (2:1, +Y up, the centre looking down -Z) or a
+    // horizontal strip of six faces (6:1) in +X -X +Y -Y +Z -Z order.
+    // Anything stb_image reads; .hdr keeps its range.
+    bool LoadSource(const std::string& path);
+    // Procedural sky for scenes without an HDR: a zenith to horizon
+    // gradient, a glow around the sun and a dark ground.
+    void SetSky(const float sunDirection[3], uint32_t faceSize);
+
+    // Needs a source; keeps it for further calls.
+    Stats Prefilter(const Settings& settings);
+    Stats Prefilter() { return Prefilter(Settings()); }
+
+    // The cache of path when it is newer and matches settings, otherwise
+    // LoadSource, Prefilter and a new cache. Drops the source.
+    bool LoadOrBuild(const std::string& path, const Settings& settings, Stats* stats);
+    static std::string CachePathFor(const std::string& path) { return path + ".envc"; }
+
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+
+    bool Empty() const { return m_specular.empty(); }
+    uint32_t FaceSize() const { return m_settings.faceSize; }
+    uint32_t MipCount() const { return m_settings.mipCount; }
+    // RGBA halves, tightly packed rows; faces in +X -X +Y -Y +Z -Z order
+    const uint16_t* Specular(uint32_t face, uint32_t mip) const;
+    const float (*Irradiance() const)[3] { return m_irradiance; }
+    uint32_t LutSize() const { return m_settings.lutSize; }
+    // RG halves, row y holds roughness (y + 0.5) / LutSize
+    const std::vector<uint16_t>& BrdfLut() const { return m_lut; }
+
+    // What the shader's SampleLevel returns along unit direction d, bilinear
+    // within a face and linear between mips.
+    void SampleSpecular(const float d[3], float mip, float out[3]) const;
+
+private:
+    static Settings Effective(const Settings& settings);
+    void BuildSourceMips();
+
+    // source radiance, RGBA floats, six faces per mip
+    uint32_t m_sourceSize = 0;
+    std::vector<std::vector<float>> m_source;
+
+    Settings m_settings;
+    std::vector<uint16_t> m_specular;       // face major, then mip
+    std::vector<size_t> m_specularOffsets;  // per face and mip, in halves
+    float m_irradiance[9][3]{};
+    std::vector<uint16_t> m_lut;
+};
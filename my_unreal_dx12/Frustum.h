@@ -0,0 +1,38 @@
+#pragma once
+
+// GPU-free view frustum as six inward facing planes (a, b, c, d), a point p is
+// inside a plane when a*p.x + b*p.y + c*p.z + d >= 0.
+struct Frustum
+{
+    float planes[6][4]{};
+
+    // m is a row-major view-projection matrix for row vectors (clip = v * m)
+    // with D3D clip depth in [0, w], as produced by DirectXMath.
+    static Frustum FromViewProj(const float m[4][4])
+    {
+        Frustum f;
+        for (int i = 0; i < 4; ++i) {
+            const float c0 = m[i][0], c1 = m[i][1], c2 = m[i][2], c3 = m[i][3];
+            f.planes[0][i] = c3 + c0;   // left
+            f.planes[1][i] = c3 - c0;   // right
+            f.planes[2][i] = c3 + c1;   // bottom
+            f.planes[3][i] = c3 - c1;   // top
+            f.planes[4][i] = c2;        // near
+            f.planes[5][i] = c3 - c2;   // far
+        }
+        return f;
+    }
+
+    bool IntersectsBox(const float mn[3], const float mx[3]) const
+    {
+        for (const auto& p : planes) {
+            // corner furthest along the plane normal
+            const float x = p[0] >= 0.f ? mx[0] : mn[0];
+            const float y = p[1] >= 0.f ? mx[1] : mn[1];
+            const float z = p[2] >= 0.f ? mx[2] : mn[2];
+            if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.f)
+                return false;
+        }
+        return true;
+    }
+};
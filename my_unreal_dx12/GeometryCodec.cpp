@@ -0,0 +1,431 @@
+#include "GeometryCodec.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define GEOMETRY_CODEC_SSE2 1
+#endif
+
+namespace
+{
+    constexpr uint32_t kInvalid = 0xFFFFFFFFu;
+    constexpr size_t kBlockVertices = 256;
+    constexpr size_t kGroup = 16;
+
+    // ---- indices -----------------------------------------------------------
+
+    struct EdgeFifo {
+        uint32_t a[16], b[16];
+        uint32_t head = 0;
+        EdgeFifo() { for (int i = 0; i < 16; ++i) a[i] = b[i] = kInvalid; }
+        void Push(uint32_t x, uint32_t y) { a[head & 15] = x; b[head & 15] = y; ++head; }
+        int Find(uint32_t x, uint32_t y) const {
+            for (int i = 0; i < 15; ++i) {
+                const uint32_t slot = (head - 1 - i) & 15;
+                if (a[slot] == x && b[slot] == y) return i;
+            }
+            return -1;
+        }
+        void Get(int i, uint32_t& x, uint32_t& y) const {
+            const uint32_t slot = (head - 1 - i) & 15;
+            x = a[slot]; y = b[slot];
+        }
+    };
+
+    struct VertexFifo {
+        uint32_t v[16];
+        uint32_t head = 0;
+        VertexFifo() { for (auto& x : v) x = kInvalid; }
+        void Push(uint32_t x) { v[head & 15] = x; ++head; }
+        int Find(uint32_t x) const {
+            for (int i = 0; i < 14; ++i)
+                if (v[(head - 1 - i) & 15] == x) return i;
+            return -1;
+        }
+        uint32_t Get(int i) const { return v[(head - 1 - i) & 15]; }
+    };
+
+    // Per-vertex code: 0 = next unseen vertex, 1..14 = vertex FIFO, 15 = explicit.
+    struct IndexState {
+        EdgeFifo edges;
+        VertexFifo verts;
+        uint32_t next = 0;
+        uint32_t last = 0;
+        uint64_t vertexCount = 0;   // decoding: every new index is below it
+    };
+
+    void WriteVarint(std::vector<uint8_t>& out, uint32_t v)
+    {
+        while (v >= 0x80) { out.push_back(uint8_t(v | 0x80)); v >>= 7; }
+        out.push_back(uint8_t(v));
+    }
+
+    bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v)
+    {
+        v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (p >= end) return false;
+            const uint8_t b = *p++;
+            v |= uint32_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    uint32_t ZigZag32(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+    int32_t UnZigZag32(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+    uint32_t EncodeVertex(IndexState& s, uint32_t v, std::vector<uint8_t>& extra)
+    {
+        if (v == s.next) {
+            ++s.next;
+            s.verts.Push(v);
+            return 0;
+        }
+        const int f = s.verts.Find(v);
+        if (f >= 0) return uint32_t(f + 1);
+
+        WriteVarint(extra, ZigZag32(int32_t(v - s.last)));
+        s.last = v;
+        if (v >= s.next) s.next = v + 1;
+        s.verts.Push(v);
+        return 15;
+    }
+
+    bool DecodeVertex(IndexState& s, uint32_t code, const uint8_t*& extra, const uint8_t* end, uint32_t& v)
+    {
+        // FIFO entries were checked when they came in
+        if (code == 0) {
+            v = s.next++;
+            s.verts.Push(v);
+            return v < s.vertexCount;
+        }
+        if (code < 15) {
+            v = s.verts.Get(int(code - 1));
+            return v != kInvalid;
+        }
+        uint32_t z;
+        if (!ReadVarint(extra, end, z)) return false;
+        v = s.last + uint32_t(UnZigZag32(z));
+        if (v >= s.vertexCount) return false;
+        s.last = v;
+        if (v >= s.next) s.next = v + 1;
+        s.verts.Push(v);
+        return true;
+    }
+
+    void PutU32(std::vector<uint8_t>& out, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i) out.push_back(uint8_t(v >> (8 * i)));
+    }
+
+    uint32_t GetU32(const uint8_t* p)
+    {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    // ---- vertices ----------------------------------------------------------
+
+    inline uint8_t ZigZag8(uint8_t d) { return uint8_t((d << 1) ^ uint8_t(int8_t(d) >> 7)); }
+    inline uint8_t UnZigZag8(uint8_t z) { return uint8_t((z >> 1) ^ uint8_t(-int(z & 1))); }
+
+    inline uint32_t WidthSelector(const uint8_t* z)
+    {
+        uint8_t m = 0;
+        for (size_t i = 0; i < kGroup; ++i) m |= z[i];
+        if (m == 0) return 0;
+        if (m < 4) return 1;
+        if (m < 16) return 2;
+        return 3;
+    }
+
+    struct Unpack2Table {
+        uint32_t v[256];
+        Unpack2Table() {
+            for (uint32_t b = 0; b < 256; ++b)
+                v[b] = (b & 3) | (((b >> 2) & 3) << 8) | (((b >> 4) & 3) << 16) | (((b >> 6) & 3) << 24);
+        }
+    };
+    const Unpack2Table kUnpack2;
+
+    // Decodes one group of 16 zigzagged deltas and integrates them on top of prev.
+    inline bool DecodeGroup(uint32_t sel, const uint8_t*& p, const uint8_t* end, uint8_t* out, uint8_t& prev)
+    {
+        static const size_t kBytes[4] = { 0, 4, 8, 16 };
+        if (size_t(end - p) < kBytes[sel]) return false;
+
+#if GEOMETRY_CODEC_SSE2
+        __m128i z;
+        switch (sel) {
+        case 0:
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_set1_epi8(char(prev)));
+            return true;
+        case 1: {
+            const uint32_t w[4] = { kUnpack2.v[p[0]], kUnpack2.v[p[1]], kUnpack2.v[p[2]], kUnpack2.v[p[3]] };
+            z = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w));
+            break;
+        }
+        case 2: {
+            const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+            const __m128i mask = _mm_set1_epi8(0x0F);
+            z = _mm_unpacklo_epi8(_mm_and_si128(x, mask), _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+            break;
+        }
+        default:
+            z = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            break;
+        }
+        p += kBytes[sel];
+
+        const __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(z, _mm_set1_epi8(1)));
+        const __m128i half = _mm_and_si128(_mm_srli_epi16(z, 1), _mm_set1_epi8(0x7F));
+        __m128i d = _mm_xor_si128(half, sign);
+
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+        d = _mm_add_epi8(d, _mm_set1_epi8(char(prev)));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), d);
+        prev = uint8_t(_mm_extract_epi16(d, 7) >> 8);
+#else
+        uint8_t z[kGroup];
+        switch (sel) {
+        case 0: memset(z, 0, kGroup); break;
+        case 1:
+            for (int j = 0; j < 4; ++j) memcpy(z + 4 * j, &kUnpack2.v[p[j]], 4);
+            break;
+        case 2:
+            for (int j = 0; j < 8; ++j) { z[2 * j] = p[j] & 15; z[2 * j + 1] = p[j] >> 4; }
+            break;
+        default: memcpy(z, p, kGroup); break;
+        }
+        p += kBytes[sel];
+        for (size_t i = 0; i < kGroup; ++i) {
+            prev = uint8_t(prev + UnZigZag8(z[i]));
+            out[i] = prev;
+        }
+#endif
+        return true;
+    }
+
+    // planes[k * kBlockVertices + i] -> interleaved vertices, 16 at a time
+    // through a small staging buffer so dst only sees sequential writes.
+    void TransposeBlock(const uint8_t* planes, size_t count, size_t stride, uint8_t* dst, uint8_t* staging)
+    {
+        for (size_t i = 0; i < count; i += kGroup) {
+            const size_t n = (count - i < kGroup) ? count - i : kGroup;
+#if GEOMETRY_CODEC_SSE2
+            for (size_t k = 0; k < stride; k += 4) {
+                const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + (k + 0) * kBlockVertices + i));
+                const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + (k + 1) * kBlockVertices + i));
+                const __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + (k + 2) * kBlockVertices + i));
+                const __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + (k + 3) * kBlockVertices + i));
+
+                const __m128i t01l = _mm_unpacklo_epi8(p0, p1);
+                const __m128i t01h = _mm_unpackhi_epi8(p0, p1);
+                const __m128i t23l = _mm_unpacklo_epi8(p2, p3);
+                const __m128i t23h = _mm_unpackhi_epi8(p2, p3);
+
+                __m128i r[4] = {
+                    _mm_unpacklo_epi16(t01l, t23l),
+                    _mm_unpackhi_epi16(t01l, t23l),
+                    _mm_unpacklo_epi16(t01h, t23h),
+                    _mm_unpackhi_epi16(t01h, t23h),
+                };
+                for (int q = 0; q < 4; ++q) {
+                    for (int j = 0; j < 4; ++j) {
+                        const int32_t v = _mm_cvtsi128_si32(r[q]);
+                        memcpy(staging + size_t(q * 4 + j) * stride + k, &v, 4);
+                        r[q] = _mm_srli_si128(r[q], 4);
+                    }
+                }
+            }
+#else
+            for (size_t j = 0; j < kGroup; ++j)
+                for (size_t k = 0; k < stride; ++k)
+                    staging[j * stride + k] = planes[k * kBlockVertices + i + j];
+#endif
+            memcpy(dst + i * stride, staging, n * stride);
+        }
+    }
+}
+
+namespace GeometryCodec
+{
+    std::vector<uint8_t> EncodeIndices(const uint32_t* indices, size_t indexCount)
+    {
+        std::vector<uint8_t> codes, extra;
+        codes.reserve(indexCount / 3 + 16);
+
+        IndexState s;
+        for (size_t t = 0; t + 2 < indexCount; t += 3) {
+            const uint32_t tri[3] = { indices[t], indices[t + 1], indices[t + 2] };
+
+            int fe = -1, rot = 0;
+            for (int r = 0; r < 3 && fe < 0; ++r) {
+                fe = s.edges.Find(tri[r], tri[(r + 1) % 3]);
+                rot = r;
+            }
+
+            if (fe >= 0) {
+                const uint32_t a = tri[rot], b = tri[(rot + 1) % 3], c = tri[(rot + 2) % 3];
+                const uint32_t cc = EncodeVertex(s, c, extra);
+                codes.push_back(uint8_t((fe << 4) | cc));
+                s.edges.Push(c, b);
+                s.edges.Push(a, c);
+            }
+            else {
+                const uint32_t a = tri[0], b = tri[1], c = tri[2];
+                const uint32_t ca = EncodeVertex(s, a, extra);
+                const uint32_t cb = EncodeVertex(s, b, extra);
+                const uint32_t cc = EncodeVertex(s, c, extra);
+                codes.push_back(uint8_t(0xF0 | ca));
+                codes.push_back(uint8_t((cb << 4) | cc));
+                s.edges.Push(b, a);
+                s.edges.Push(c, b);
+                s.edges.Push(a, c);
+            }
+        }
+
+        std::vector<uint8_t> out;
+        out.reserve(8 + codes.size() + extra.size());
+        PutU32(out, uint32_t(indexCount));
+        PutU32(out, uint32_t(codes.size()));
+        out.insert(out.end(), codes.begin(), codes.end());
+        out.insert(out.end(), extra.begin(), extra.end());
+        return out;
+    }
+
+    bool DecodeIndices(uint32_t* dst, size_t indexCount, size_t vertexCount, const uint8_t* src, size_t srcSize)
+    {
+        if (srcSize < 8 || indexCount % 3 != 0) return false;
+        if (GetU32(src) != indexCount) return false;
+        const uint32_t codeBytes = GetU32(src + 4);
+        if (srcSize - 8 < codeBytes) return false;
+
+        const uint8_t* code = src + 8;
+        const uint8_t* codeEnd = code + codeBytes;
+        const uint8_t* extra = codeEnd;
+        const uint8_t* end = src + srcSize;
+
+        IndexState s;
+        s.vertexCount = vertexCount;
+        for (size_t t = 0; t < indexCount; t += 3) {
+            if (code >= codeEnd) return false;
+            const uint8_t c0 = *code++;
+            const uint32_t fe = c0 >> 4;
+            uint32_t a, b, c;
+
+            if (fe < 15) {
+                s.edges.Get(int(fe), a, b);
+                if (a == kInvalid) return false;
+                if (!DecodeVertex(s, c0 & 15, extra, end, c)) return false;
+                s.edges.Push(c, b);
+                s.edges.Push(a, c);
+            }
+            else {
+                if (code >= codeEnd) return false;
+                const uint8_t c1 = *code++;
+                if (!DecodeVertex(s, c0 & 15, extra, end, a)) return false;
+                if (!DecodeVertex(s, c1 >> 4, extra, end, b)) return false;
+                if (!DecodeVertex(s, c1 & 15, extra, end, c)) return false;
+                s.edges.Push(b, a);
+                s.edges.Push(c, b);
+                s.edges.Push(a, c);
+            }
+
+            dst[t] = a;
+            dst[t + 1] = b;
+            dst[t + 2] = c;
+        }
+        return true;
+    }
+
+    std::vector<uint8_t> EncodeVertices(const void* vertices, size_t count, size_t stride)
+    {
+        std::vector<uint8_t> out;
+        if (stride == 0 || stride % 4 != 0) return out;
+
+        const uint8_t* src = static_cast<const uint8_t*>(vertices);
+        std::vector<uint8_t> prev(stride, 0);
+        uint8_t z[kBlockVertices];
+
+        out.reserve(count * stride / 2);
+        for (size_t base = 0; base < count; base += kBlockVertices) {
+            const size_t n = (count - base < kBlockVertices) ? count - base : kBlockVertices;
+            const size_t groups = (n + kGroup - 1) / kGroup;
+
+            for (size_t k = 0; k < stride; ++k) {
+                memset(z, 0, sizeof(z));
+                for (size_t i = 0; i < n; ++i) {
+                    const uint8_t v = src[(base + i) * stride + k];
+                    z[i] = ZigZag8(uint8_t(v - prev[k]));
+                    prev[k] = v;
+                }
+
+                const size_t headerPos = out.size();
+                out.resize(out.size() + (groups + 3) / 4, 0);
+                for (size_t g = 0; g < groups; ++g) {
+                    const uint8_t* gz = z + g * kGroup;
+                    const uint32_t sel = WidthSelector(gz);
+                    out[headerPos + g / 4] |= uint8_t(sel << (2 * (g % 4)));
+                    switch (sel) {
+                    case 1:
+                        for (int j = 0; j < 4; ++j)
+                            out.push_back(uint8_t(gz[4 * j] | (gz[4 * j + 1] << 2) | (gz[4 * j + 2] << 4) | (gz[4 * j + 3] << 6)));
+                        break;
+                    case 2:
+                        for (int j = 0; j < 8; ++j)
+                            out.push_back(uint8_t(gz[2 * j] | (gz[2 * j + 1] << 4)));
+                        break;
+                    case 3:
+                        out.insert(out.end(), gz, gz + kGroup);
+                        break;
+                    default:
+                        break;
+                    }
+                }
+            }
+        }
+        return out;
+    }
+
+    bool DecodeVertices(void* dst, size_t count, size_t stride, const uint8_t* src, size_t srcSize)
+    {
+        if (stride == 0 || stride % 4 != 0) return false;
+
+        std::vector<uint8_t> planes(stride * kBlockVertices);
+        std::vector<uint8_t> staging(stride * kGroup);
+        std::vector<uint8_t> prev(stride, 0);
+
+        const uint8_t* p = src;
+        const uint8_t* end = src + srcSize;
+        uint8_t* out = static_cast<uint8_t*>(dst);
+
+        for (size_t base = 0; base < count; base += kBlockVertices) {
+            const size_t n = (count - base < kBlockVertices) ? count - base : kBlockVertices;
+            const size_t groups = (n + kGroup - 1) / kGroup;
+            const size_t headerBytes = (groups + 3) / 4;
+
+            for (size_t k = 0; k < stride; ++k) {
+                if (size_t(end - p) < headerBytes) return false;
+                const uint8_t* header = p;
+                p += headerBytes;
+
+                uint8_t* plane = planes.data() + k * kBlockVertices;
+                for (size_t g = 0; g < groups; ++g) {
+                    const uint32_t sel = (header[g / 4] >> (2 * (g % 4))) & 3;
+                    if (!DecodeGroup(sel, p, end, plane + g * kGroup, prev[k])) return false;
+                }
+                // the padding lanes of the last group must not leak into the next block
+                if (n % kGroup)
+                    prev[k] = plane[n - 1];
+            }
+
+            TransposeBlock(planes.data(), n, stride, out + base * stride, staging.data());
+        }
+        return p == end;
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless compression of the vertex and index streams of cooked meshes.
+// Both decoders write their output strictly front to back, so the
+// destination can be mapped upload memory.
+namespace GeometryCodec
+{
+    // Edge/vertex FIFO triangle codec. Triangle order and winding are kept,
+    // the first corner of a triangle may be rotated. Decoding fails on any
+    // index not below vertexCount, so a damaged stream never yields one.
+    // The decoder is scalar: every triangle depends on the FIFO state the
+    // previous one left, so it decodes about 1.1-1.7 GB/s of indices per
+    // core, short of multi-GB/s (measured by tools/GeometryCodecBench).
+    std::vector<uint8_t> EncodeIndices(const uint32_t* indices, size_t indexCount);
+    bool DecodeIndices(uint32_t* dst, size_t indexCount, size_t vertexCount, const uint8_t* src, size_t srcSize);
+
+    // Byte-wise delta against the previous vertex, transposed into one byte
+    // plane per attribute byte and bit-packed (0/2/4/8 bits) in groups of 16.
+    // stride must be a multiple of 4. Decoding uses SSE2 where available.
+    std::vector<uint8_t> EncodeVertices(const void* vertices, size_t count, size_t stride);
+    bool DecodeVertices(void* dst, size_t count, size_t stride, const uint8_t* src, size_t srcSize);
+}
@@ -0,0 +1,127 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "GeometryPool.h"
+#include "MeshAsset.h"
+#include "Utils.h"
+#include <stdexcept>
+#include <algorithm>
+
+static Microsoft::WRL::ComPtr<ID3D12Resource> CreateUploadBuffer(ID3D12Device* device, UINT64 bytes, uint8_t*& mapped)
+{
+    Microsoft::WRL::ComPtr<ID3D12Resource> res;
+    D3D12_HEAP_PROPERTIES hp{}; hp.Type = D3D12_HEAP_TYPE_UPLOAD;
+    D3D12_RESOURCE_DESC rd{}; rd.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    rd.Width = bytes ? bytes : 1; rd.Height = 1; rd.DepthOrArraySize = 1;
+    rd.MipLevels = 1; rd.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR; rd.SampleDesc = { 1,0 };
+    DXThrow(device->CreateCommittedResource(&hp, D3D12_HEAP_FLAG_NONE, &rd,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&res)));
+
+    D3D12_RANGE r{ 0,0 };
+    DXThrow(res->Map(0, &r, reinterpret_cast<void**>(&mapped)));
+    return res;
+}
+
+GeometryBlock::~GeometryBlock()
+{
+    GeometryPool::I().Release(*this);
+}
+
+uint32_t GeometryPool::CreatePage(ID3D12Device* device, uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    auto page = std::make_unique<Page>();
+
+    const UINT64 vbBytes = UINT64(vertexCapacity) * sizeof(Vertex);
+    const UINT64 ibBytes = UINT64(indexCapacity) * sizeof(uint32_t);
+    page->vb = CreateUploadBuffer(device, vbBytes, page->vbMapped);
+    page->ib = CreateUploadBuffer(device, ibBytes, page->ibMapped);
+
+    page->vbv.BufferLocation = page->vb->GetGPUVirtualAddress();
+    page->vbv.StrideInBytes = sizeof(Vertex);
+    page->vbv.SizeInBytes = UINT(vbBytes);
+
+    page->ibv.BufferLocation = page->ib->GetGPUVirtualAddress();
+    page->ibv.Format = DXGI_FORMAT_R32_UINT;
+    page->ibv.SizeInBytes = UINT(ibBytes);
+
+    page->vertices.Reset(vertexCapacity);
+    page->indices.Reset(indexCapacity);
+
+    page->ledger = MemoryLedger::I().Track(MemoryCategory::GeometryPool,
+        "page " + std::to_string(pages_.size()), 0,
+        MemoryLedger::ResourceBytes(device, page->vb->GetDesc()) +
+        MemoryLedger::ResourceBytes(device, page->ib->GetDesc()));
+
+    pages_.push_back(std::move(page));
+    return uint32_t(pages_.size() - 1);
+}
+
+std::shared_ptr<GeometryBlock> GeometryPool::Allocate(ID3D12Device* device, uint32_t vertexCount, uint32_t indexCount)
+{
+    if (vertexCount == 0 && indexCount == 0) return {};
+
+    std::lock_guard<std::mutex> lk(mu_);
+
+    auto tryPage = [&](uint32_t p, uint32_t& vOff, uint32_t& iOff) {
+        Page& page = *pages_[p];
+        if (page.vertices.LargestFree() < vertexCount || page.indices.LargestFree() < indexCount)
+            return false;
+        vOff = vertexCount ? page.vertices.Allocate(vertexCount) : 0;
+        iOff = indexCount ? page.indices.Allocate(indexCount) : 0;
+        return true;
+        };
+
+    uint32_t page = RangeAllocator::kInvalid, vOff = 0, iOff = 0;
+    for (uint32_t p = 0; p < pages_.size(); ++p) {
+        if (tryPage(p, vOff, iOff)) { page = p; break; }
+    }
+    if (page == RangeAllocator::kInvalid) {
+        page = CreatePage(device,
+            std::max(kPageVertices, vertexCount),
+            std::max(kPageIndices, indexCount));
+        if (!tryPage(page, vOff, iOff))
+            throw std::runtime_error("GeometryPool: allocation failed");
+    }
+
+    const Page& pg = *pages_[page];
+    auto block = std::shared_ptr<GeometryBlock>(new GeometryBlock());
+    block->m_page = page;
+    block->m_vertexOffset = vOff;
+    block->m_vertexCount = vertexCount;
+    block->m_indexOffset = iOff;
+    block->m_indexCount = indexCount;
+    block->m_vertices = reinterpret_cast<Vertex*>(pg.vbMapped) + vOff;
+    block->m_indices = reinterpret_cast<uint32_t*>(pg.ibMapped) + iOff;
+    block->m_vbv = pg.vbv;
+    block->m_ibv = pg.ibv;
+    return block;
+}
+
+void GeometryPool::Release(const GeometryBlock& block)
+{
+    std::lock_guard<std::mutex> lk(mu_);
+    pending_.push_back({ block.m_page,
+        block.m_vertexOffset, block.m_vertexCount,
+        block.m_indexOffset, block.m_indexCount });
+}
+
+void GeometryPool::CollectGarbage()
+{
+    std::lock_guard<std::mutex> lk(mu_);
+    for (const auto& f : pending_) {
+        Page& page = *pages_[f.page];
+        if (f.vertexCount) page.vertices.Free(f.vertexOffset, f.vertexCount);
+        if (f.indexCount) page.indices.Free(f.indexOffset, f.indexCount);
+    }
+    pending_.clear();
+}
+
+std::vector<GeometryPool::PageStats> GeometryPool::GetStats()
+{
+    std::lock_guard<std::mutex> lk(mu_);
+    std::vector<PageStats> out;
+    out.reserve(pages_.size());
+    for (const auto& p : pages_)
+        out.push_back({ p->vertices.GetStats(), p->indices.GetStats() });
+    return out;
+}
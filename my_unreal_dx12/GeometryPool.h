@@ -0,0 +1,103 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <wrl.h>
+#include <d3d12.h>
+#include "MemoryLedger.h"
+#include "RangeAllocator.h"
+
+struct Vertex;
+
+// One suballocation inside a GeometryPool page. Releases its ranges when the
+// last owner drops it; the ranges are only recycled after the GPU is done.
+class GeometryBlock
+{
+public:
+    ~GeometryBlock();
+
+    GeometryBlock(const GeometryBlock&) = delete;
+    GeometryBlock& operator=(const GeometryBlock&) = delete;
+
+    uint32_t Page() const { return m_page; }
+    uint32_t BaseVertex() const { return m_vertexOffset; }
+    uint32_t StartIndex() const { return m_indexOffset; }
+    uint32_t VertexCount() const { return m_vertexCount; }
+    uint32_t IndexCount() const { return m_indexCount; }
+
+    // Persistently mapped upload memory backing this block.
+    Vertex* Vertices() const { return m_vertices; }
+    uint32_t* Indices() const { return m_indices; }
+
+    // Views over the whole page, use BaseVertex/StartIndex when drawing.
+    const D3D12_VERTEX_BUFFER_VIEW& VBV() const { return m_vbv; }
+    const D3D12_INDEX_BUFFER_VIEW& IBV() const { return m_ibv; }
+
+private:
+    friend class GeometryPool;
+    GeometryBlock() = default;
+
+    uint32_t m_page = 0;
+    uint32_t m_vertexOffset = 0;
+    uint32_t m_vertexCount = 0;
+    uint32_t m_indexOffset = 0;
+    uint32_t m_indexCount = 0;
+
+    Vertex* m_vertices = nullptr;
+    uint32_t* m_indices = nullptr;
+    D3D12_VERTEX_BUFFER_VIEW m_vbv{};
+    D3D12_INDEX_BUFFER_VIEW m_ibv{};
+};
+
+// Shared vertex/index buffers for every MeshAsset. Meshes live at an offset
+// inside a few large pages and are drawn with BaseVertexLocation and
+// StartIndexLocation, so consecutive draws from one page need no IA rebind.
+class GeometryPool
+{
+public:
+    static GeometryPool& I() { static GeometryPool s; return s; }
+
+    static constexpr uint32_t kPageVertices = 1u << 19;
+    static constexpr uint32_t kPageIndices = 1u << 21;
+
+    std::shared_ptr<GeometryBlock> Allocate(ID3D12Device* device, uint32_t vertexCount, uint32_t indexCount);
+
+    // Called once the GPU has finished the frame: returns released ranges
+    // to the allocators.
+    void CollectGarbage();
+
+    struct PageStats {
+        RangeAllocator::Stats vertices;
+        RangeAllocator::Stats indices;
+    };
+    std::vector<PageStats> GetStats();
+
+private:
+    friend class GeometryBlock;
+
+    struct Page {
+        Microsoft::WRL::ComPtr<ID3D12Resource> vb, ib;
+        uint8_t* vbMapped = nullptr;
+        uint8_t* ibMapped = nullptr;
+        D3D12_VERTEX_BUFFER_VIEW vbv{};
+        D3D12_INDEX_BUFFER_VIEW ibv{};
+        RangeAllocator vertices;
+        RangeAllocator indices;
+        MemoryLedger::Handle ledger;
+    };
+
+    struct PendingFree {
+        uint32_t page;
+        uint32_t vertexOffset, vertexCount;
+        uint32_t indexOffset, indexCount;
+    };
+
+    GeometryPool() = default;
+
+    uint32_t CreatePage(ID3D12Device* device, uint32_t vertexCapacity, uint32_t indexCapacity);
+    void Release(const GeometryBlock& block);
+
+    std::mutex mu_;
+    std::vector<std::unique_ptr<Page>> pages_;
+    std::vector<PendingFree> pending_;
+};
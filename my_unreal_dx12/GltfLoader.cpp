@@ -0,0 +1,733 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "GltfLoader.h"
+#include "Json.h"
+#include "ObjImporter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    constexpr uint32_t kGlbMagic = 0x46546C67;     // "glTF"
+    constexpr uint32_t kGlbJson = 0x4E4F534A;      // "JSON"
+    constexpr uint32_t kGlbBin = 0x004E4942;       // "BIN\0"
+
+    struct Document
+    {
+        JsonValue json;
+        std::vector<std::vector<uint8_t>> buffers;
+        std::string dir;
+    };
+
+    struct Node
+    {
+        int parent = -1;
+        JointTransform local;
+        int mesh = -1;
+        int skin = -1;
+    };
+
+    bool ReadFile(const std::string& path, std::vector<uint8_t>& out)
+    {
+        std::ifstream f(path, std::ios::binary | std::ios::ate);
+        if (!f.is_open()) return false;
+        const std::streamsize size = f.tellg();
+        f.seekg(0, std::ios::beg);
+        out.resize(size_t(size > 0 ? size : 0));
+        return out.empty() || bool(f.read(reinterpret_cast<char*>(out.data()), size));
+    }
+
+    bool DecodeBase64(const char* s, size_t n, std::vector<uint8_t>& out)
+    {
+        auto value = [](char c) -> int {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+' || c == '-') return 62;
+            if (c == '/' || c == '_') return 63;
+            return -1;
+        };
+        out.clear();
+        out.reserve(n / 4 * 3);
+        uint32_t acc = 0;
+        int bits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (s[i] == '=') break;
+            const int v = value(s[i]);
+            if (v < 0) return false;
+            acc = (acc << 6) | uint32_t(v);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out.push_back(uint8_t(acc >> bits));
+            }
+        }
+        return true;
+    }
+
+    std::string DecodeUri(const std::string& uri)
+    {
+        std::string out;
+        for (size_t i = 0; i < uri.size(); ++i) {
+            if (uri[i] == '%' && i + 2 < uri.size()) {
+                out += char(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            }
+            else out += uri[i];
+        }
+        return out;
+    }
+
+    bool LoadDocument(const std::string& path, Document& doc)
+    {
+        std::vector<uint8_t> file;
+        if (!ReadFile(path, file)) {
+            std::cerr << "glTF: cannot read " << path << "\n";
+            return false;
+        }
+
+        const size_t slash = path.find_last_of("/\\");
+        doc.dir = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+        const char* json = reinterpret_cast<const char*>(file.data());
+        size_t jsonSize = file.size();
+        std::vector<uint8_t> glbBin;
+        bool hasGlbBin = false;
+
+        uint32_t magic = 0;
+        if (file.size() >= 12) memcpy(&magic, file.data(), 4);
+        if (magic == kGlbMagic) {
+            size_t p = 12;
+            json = nullptr;
+            while (p + 8 <= file.size()) {
+                uint32_t len, type;
+                memcpy(&len, &file[p], 4);
+                memcpy(&type, &file[p + 4], 4);
+                p += 8;
+                if (len > file.size() - p) break;
+                if (type == kGlbJson && !json) {
+                    json = reinterpret_cast<const char*>(&file[p]);
+                    jsonSize = len;
+                }
+                else if (type == kGlbBin && !hasGlbBin) {
+                    glbBin.assign(file.begin() + p, file.begin() + p + len);
+                    hasGlbBin = true;
+                }
+                p += (len + 3) & ~3u;
+            }
+            if (!json) {
+                std::cerr << "glTF: " << path << " has no JSON chunk\n";
+                return false;
+            }
+        }
+
+        std::string error;
+        if (!JsonValue::Parse(json, jsonSize, doc.json, &error)) {
+            std::cerr << "glTF: " << path << ": " << error << "\n";
+            return false;
+        }
+
+        if (const JsonValue* buffers = doc.json.Find("buffers")) {
+            doc.buffers.resize(buffers->Size());
+            for (size_t i = 0; i < buffers->Size(); ++i) {
+                const std::string uri = (*buffers)[i].String("uri");
+                auto& data = doc.buffers[i];
+                if (uri.empty()) {
+                    if (i == 0 && hasGlbBin) data = std::move(glbBin);
+                }
+                else if (uri.compare(0, 5, "data:") == 0) {
+                    const size_t comma = uri.find(',');
+                    if (comma == std::string::npos || uri.find(";base64") > comma ||
+                        !DecodeBase64(uri.data() + comma + 1, uri.size() - comma - 1, data)) {
+                        std::cerr << "glTF: unsupported data URI in buffer " << i << "\n";
+                        return false;
+                    }
+                }
+                else if (!ReadFile(ObjImporter::JoinPath(doc.dir, DecodeUri(uri)), data)) {
+                    std::cerr << "glTF: cannot read buffer " << uri << "\n";
+                    return false;
+                }
+                const size_t declared = size_t((*buffers)[i].Number("byteLength", 0));
+                if (data.size() < declared) {
+                    std::cerr << "glTF: buffer " << i << " is shorter than its byteLength\n";
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    const JsonValue* Element(const JsonValue& doc, const char* array, int index)
+    {
+        const JsonValue* a = doc.Find(array);
+        if (!a || index < 0 || size_t(index) >= a->Size()) return nullptr;
+        return &(*a)[size_t(index)];
+    }
+
+    int ComponentCount(const std::string& type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        if (type == "MAT4") return 16;
+        return 0;
+    }
+
+    // Reads any accessor as floats, applying normalization; integer
+    // components come through unchanged when they are not normalized.
+    bool ReadAccessor(const Document& doc, int index, std::vector<float>& out, int& comps)
+    {
+        const JsonValue* acc = Element(doc.json, "accessors", index);
+        if (!acc) return false;
+        comps = ComponentCount(acc->String("type"));
+        const int componentType = acc->Int("componentType", 0);
+        const size_t count = size_t(acc->Number("count", 0));
+        const bool normalized = acc->Find("normalized") && acc->Find("normalized")->Bool();
+        if (comps == 0) return false;
+        if (acc->Find("sparse"))
+            std::cerr << "glTF: sparse accessors are not supported, using the base values\n";
+
+        size_t componentSize = 0;
+        switch (componentType) {
+        case 5120: case 5121: componentSize = 1; break;
+        case 5122: case 5123: componentSize = 2; break;
+        case 5125: case 5126: componentSize = 4; break;
+        default: return false;
+        }
+
+        out.assign(count * comps, 0.f);
+        const JsonValue* view = Element(doc.json, "bufferViews", acc->Int("bufferView", -1));
+        if (!view) return true; // all zeros
+
+        const int buffer = view->Int("buffer", -1);
+        if (buffer < 0 || size_t(buffer) >= doc.buffers.size()) return false;
+        const auto& data = doc.buffers[buffer];
+        const size_t offset = size_t(view->Number("byteOffset", 0)) + size_t(acc->Number("byteOffset", 0));
+        const size_t elementSize = componentSize * comps;
+        const size_t stride = view->Find("byteStride") ? size_t(view->Number("byteStride", 0)) : elementSize;
+        if (count && offset + stride * (count - 1) + elementSize > data.size()) return false;
+
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t* e = data.data() + offset + stride * i;
+            for (int c = 0; c < comps; ++c) {
+                const uint8_t* p = e + componentSize * c;
+                float v = 0.f;
+                switch (componentType) {
+                case 5120: { int8_t x; memcpy(&x, p, 1); v = normalized ? std::max(x / 127.f, -1.f) : float(x); break; }
+                case 5121: { uint8_t x = *p; v = normalized ? x / 255.f : float(x); break; }
+                case 5122: { int16_t x; memcpy(&x, p, 2); v = normalized ? std::max(x / 32767.f, -1.f) : float(x); break; }
+                case 5123: { uint16_t x; memcpy(&x, p, 2); v = normalized ? x / 65535.f : float(x); break; }
+                case 5125: { uint32_t x; memcpy(&x, p, 4); v = float(x); break; }
+                case 5126: memcpy(&v, p, 4); break;
+                }
+                out[i * comps + c] = v;
+            }
+        }
+        return true;
+    }
+
+    bool ReadIndices(const Document& doc, int index, std::vector<uint32_t>& out)
+    {
+        const JsonValue* acc = Element(doc.json, "accessors", index);
+        const JsonValue* view = acc ? Element(doc.json, "bufferViews", acc->Int("bufferView", -1)) : nullptr;
+        if (!view) return false;
+        const int componentType = acc->Int("componentType", 0);
+        const size_t size = componentType == 5121 ? 1 : componentType == 5123 ? 2 : componentType == 5125 ? 4 : 0;
+        const int buffer = view->Int("buffer", -1);
+        if (!size || buffer < 0 || size_t(buffer) >= doc.buffers.size()) return false;
+
+        const auto& data = doc.buffers[buffer];
+        const size_t count = size_t(acc->Number("count", 0));
+        const size_t offset = size_t(view->Number("byteOffset", 0)) + size_t(acc->Number("byteOffset", 0));
+        const size_t stride = view->Find("byteStride") ? size_t(view->Number("byteStride", 0)) : size;
+        if (count && offset + stride * (count - 1) + size > data.size()) return false;
+
+        out.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t v = 0;
+            memcpy(&v, data.data() + offset + stride * i, size);  // little endian
+            out[i] = v;
+        }
+        return true;
+    }
+
+    void ReadFloats(const JsonValue* a, float* out, int n)
+    {
+        if (!a) return;
+        for (int i = 0; i < n && size_t(i) < a->Size(); ++i)
+            out[i] = float((*a)[i].Number());
+    }
+
+    void NormalizeQuat(float* q)
+    {
+        const float len = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        if (len <= 0.f) { q[0] = q[1] = q[2] = 0.f; q[3] = 1.f; return; }
+        for (int i = 0; i < 4; ++i) q[i] /= len;
+    }
+
+    // column-major 4x4 without shear into translation, rotation and scale
+    JointTransform Decompose(const float m[16])
+    {
+        JointTransform x;
+        x.t[0] = m[12]; x.t[1] = m[13]; x.t[2] = m[14];
+        float r[3][3];
+        for (int c = 0; c < 3; ++c) {
+            const float len = std::sqrt(m[c * 4] * m[c * 4] + m[c * 4 + 1] * m[c * 4 + 1] + m[c * 4 + 2] * m[c * 4 + 2]);
+            x.s[c] = len;
+            for (int k = 0; k < 3; ++k) r[c][k] = len > 0.f ? m[c * 4 + k] / len : 0.f;
+        }
+        // r[c][k]: column c, row k
+        const float trace = r[0][0] + r[1][1] + r[2][2];
+        float* q = x.r;
+        if (trace > 0.f) {
+            const float s = std::sqrt(trace + 1.f) * 2.f;
+            q[3] = 0.25f * s;
+            q[0] = (r[1][2] - r[2][1]) / s;
+            q[1] = (r[2][0] - r[0][2]) / s;
+            q[2] = (r[0][1] - r[1][0]) / s;
+        }
+        else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+            const float s = std::sqrt(1.f + r[0][0] - r[1][1] - r[2][2]) * 2.f;
+            q[3] = (r[1][2] - r[2][1]) / s;
+            q[0] = 0.25f * s;
+            q[1] = (r[1][0] + r[0][1]) / s;
+            q[2] = (r[2][0] + r[0][2]) / s;
+        }
+        else if (r[1][1] > r[2][2]) {
+            const float s = std::sqrt(1.f + r[1][1] - r[0][0] - r[2][2]) * 2.f;
+            q[3] = (r[2][0] - r[0][2]) / s;
+            q[0] = (r[1][0] + r[0][1]) / s;
+            q[1] = 0.25f * s;
+            q[2] = (r[2][1] + r[1][2]) / s;
+        }
+        else {
+            const float s = std::sqrt(1.f + r[2][2] - r[0][0] - r[1][1]) * 2.f;
+            q[3] = (r[0][1] - r[1][0]) / s;
+            q[0] = (r[2][0] + r[0][2]) / s;
+            q[1] = (r[2][1] + r[1][2]) / s;
+            q[2] = 0.25f * s;
+        }
+        NormalizeQuat(q);
+        return x;
+    }
+
+    JointMatrix ToMatrix(const JointTransform& x)
+    {
+        const float* q = x.r;
+        const float xx = 2 * q[0] * q[0], yy = 2 * q[1] * q[1], zz = 2 * q[2] * q[2];
+        const float xy = 2 * q[0] * q[1], xz = 2 * q[0] * q[2], yz = 2 * q[1] * q[2];
+        const float wx = 2 * q[3] * q[0], wy = 2 * q[3] * q[1], wz = 2 * q[3] * q[2];
+        JointMatrix m = JointMatrix::Identity();
+        m.c[0][0] = (1 - yy - zz) * x.s[0]; m.c[0][1] = (xy + wz) * x.s[0]; m.c[0][2] = (xz - wy) * x.s[0];
+        m.c[1][0] = (xy - wz) * x.s[1]; m.c[1][1] = (1 - xx - zz) * x.s[1]; m.c[1][2] = (yz + wx) * x.s[1];
+        m.c[2][0] = (xz + wy) * x.s[2]; m.c[2][1] = (yz - wx) * x.s[2]; m.c[2][2] = (1 - xx - yy) * x.s[2];
+        m.c[3][0] = x.t[0]; m.c[3][1] = x.t[1]; m.c[3][2] = x.t[2];
+        return m;
+    }
+
+    JointMatrix Mul(const JointMatrix& a, const JointMatrix& b)
+    {
+        JointMatrix r = JointMatrix::Identity();
+        for (int k = 0; k < 4; ++k)
+            for (int i = 0; i < 3; ++i)
+                r.c[k][i] = a.c[0][i] * b.c[k][0] + a.c[1][i] * b.c[k][1] + a.c[2][i] * b.c[k][2] + (k == 3 ? a.c[3][i] : 0.f);
+        return r;
+    }
+
+    std::vector<Node> ReadNodes(const JsonValue& doc)
+    {
+        std::vector<Node> nodes;
+        const JsonValue* arr = doc.Find("nodes");
+        if (!arr) return nodes;
+        nodes.resize(arr->Size());
+        for (size_t i = 0; i < arr->Size(); ++i) {
+            const JsonValue& n = (*arr)[i];
+            Node& node = nodes[i];
+            node.mesh = n.Int("mesh", -1);
+            node.skin = n.Int("skin", -1);
+            if (const JsonValue* m = n.Find("matrix"); m && m->Size() == 16) {
+                float f[16];
+                ReadFloats(m, f, 16);
+                node.local = Decompose(f);
+            }
+            else {
+                ReadFloats(n.Find("translation"), node.local.t, 3);
+                ReadFloats(n.Find("rotation"), node.local.r, 4);
+                ReadFloats(n.Find("scale"), node.local.s, 3);
+                NormalizeQuat(node.local.r);
+            }
+        }
+        for (size_t i = 0; i < arr->Size(); ++i)
+            if (const JsonValue* children = (*arr)[i].Find("children"))
+                for (size_t c = 0; c < children->Size(); ++c) {
+                    const int child = (*children)[c].Int();
+                    if (child >= 0 && size_t(child) < nodes.size()) nodes[child].parent = int(i);
+                }
+        return nodes;
+    }
+
+    std::string TexturePath(const JsonValue& doc, const JsonValue* textureInfo)
+    {
+        if (!textureInfo) return {};
+        const JsonValue* tex = Element(doc, "textures", textureInfo->Int("index", -1));
+        const JsonValue* image = tex ? Element(doc, "images", tex->Int("source", -1)) : nullptr;
+        if (!image) return {};
+        const std::string uri = image->String("uri");
+        if (uri.empty() || uri.compare(0, 5, "data:") == 0) {
+            std::cerr << "glTF: embedded images are not supported, the texture is skipped\n";
+            return {};
+        }
+        return DecodeUri(uri);
+    }
+
+    bool ReadMaterial(const JsonValue& doc, int index, MaterialDesc& out)
+    {
+        const JsonValue* m = Element(doc, "materials", index);
+        if (!m) return false;
+        float base[4] = { 1.f, 1.f, 1.f, 1.f };
+        if (const JsonValue* pbr = m->Find("pbrMetallicRoughness")) {
+            ReadFloats(pbr->Find("baseColorFactor"), base, 4);
+            out.texture = TexturePath(doc, pbr->Find("baseColorTexture"));
+            out.metalRoughMap = TexturePath(doc, pbr->Find("metallicRoughnessTexture"));
+        }
+        out.normalMap = TexturePath(doc, m->Find("normalTexture"));
+        ReadFloats(m->Find("emissiveFactor"), out.ke, 3);
+        for (int i = 0; i < 3; ++i) out.kd[i] = base[i];
+        out.opacity = m->String("alphaMode") == "BLEND" ? base[3] : 1.f;
+        return true;
+    }
+
+    float Slerp(const float* a, const float* b, float t, float* out)
+    {
+        float d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        float sb = 1.f;
+        if (d < 0.f) { d = -d; sb = -1.f; }
+        float wa = 1.f - t, wb = t;
+        if (d < 0.9995f) {
+            const float angle = std::acos(d);
+            const float s = std::sin(angle);
+            wa = std::sin((1.f - t) * angle) / s;
+            wb = std::sin(t * angle) / s;
+        }
+        for (int i = 0; i < 4; ++i) out[i] = a[i] * wa + b[i] * wb * sb;
+        NormalizeQuat(out);
+        return d;
+    }
+
+    struct Channel
+    {
+        int joint = -1;
+        int path = 0;               // 0 translation, 1 rotation, 2 scale
+        int interpolation = 0;      // 0 linear, 1 step, 2 cubic spline
+        std::vector<float> times;
+        std::vector<float> values;
+        int comps = 0;
+    };
+
+    void EvaluateChannel(const Channel& ch, float t, float* out)
+    {
+        const int n = int(ch.times.size());
+        const int comps = ch.comps;
+        const int stride = ch.interpolation == 2 ? comps * 3 : comps;
+        const int valueOffset = ch.interpolation == 2 ? comps : 0;
+        auto value = [&](int k) { return &ch.values[size_t(k) * stride + valueOffset]; };
+
+        if (t <= ch.times[0] || n == 1) { memcpy(out, value(0), comps * sizeof(float)); return; }
+        if (t >= ch.times[n - 1]) { memcpy(out, value(n - 1), comps * sizeof(float)); return; }
+
+        const int k = int(std::upper_bound(ch.times.begin(), ch.times.end(), t) - ch.times.begin()) - 1;
+        const float t0 = ch.times[k], t1 = ch.times[k + 1];
+        const float dt = t1 - t0;
+        const float u = dt > 0.f ? (t - t0) / dt : 0.f;
+
+        if (ch.interpolation == 1) {
+            memcpy(out, value(k), comps * sizeof(float));
+        }
+        else if (ch.interpolation == 2) {
+            const float* v0 = value(k);
+            const float* v1 = value(k + 1);
+            const float* outTangent = &ch.values[size_t(k) * stride + 2 * comps];
+            const float* inTangent = &ch.values[size_t(k + 1) * stride];
+            const float u2 = u * u, u3 = u2 * u;
+            const float h00 = 2 * u3 - 3 * u2 + 1, h10 = u3 - 2 * u2 + u, h01 = -2 * u3 + 3 * u2, h11 = u3 - u2;
+            for (int c = 0; c < comps; ++c)
+                out[c] = h00 * v0[c] + h10 * dt * outTangent[c] + h01 * v1[c] + h11 * dt * inTangent[c];
+            if (comps == 4) NormalizeQuat(out);
+        }
+        else if (comps == 4) {
+            Slerp(value(k), value(k + 1), u, out);
+        }
+        else {
+            const float* v0 = value(k);
+            const float* v1 = value(k + 1);
+            for (int c = 0; c < comps; ++c) out[c] = v0[c] + (v1[c] - v0[c]) * u;
+        }
+    }
+
+    void ReadAnimations(const Document& doc, const std::vector<int>& nodeToJoint, const Skeleton& skeleton,
+        float sampleRate, std::vector<RawClip>& clips)
+    {
+        const JsonValue* anims = doc.json.Find("animations");
+        if (!anims) return;
+
+        for (size_t a = 0; a < anims->Size(); ++a) {
+            const JsonValue& anim = (*anims)[a];
+            const JsonValue* samplers = anim.Find("samplers");
+            const JsonValue* channels = anim.Find("channels");
+            if (!samplers || !channels) continue;
+
+            std::vector<Channel> used;
+            float duration = 0.f;
+            for (size_t c = 0; c < channels->Size(); ++c) {
+                const JsonValue& chj = (*channels)[c];
+                const JsonValue* target = chj.Find("target");
+                if (!target) continue;
+                const int node = target->Int("node", -1);
+                if (node < 0 || size_t(node) >= nodeToJoint.size() || nodeToJoint[node] < 0) continue;
+                const std::string path = target->String("path");
+                const int p = path == "translation" ? 0 : path == "rotation" ? 1 : path == "scale" ? 2 : -1;
+                if (p < 0) continue;    // morph weights
+
+                const int s = chj.Int("sampler", -1);
+                if (s < 0 || size_t(s) >= samplers->Size()) continue;
+                const JsonValue& sampler = (*samplers)[size_t(s)];
+
+                Channel ch;
+                ch.joint = nodeToJoint[node];
+                ch.path = p;
+                const std::string interp = sampler.String("interpolation", "LINEAR");
+                ch.interpolation = interp == "STEP" ? 1 : interp == "CUBICSPLINE" ? 2 : 0;
+                int timeComps = 0;
+                if (!ReadAccessor(doc, sampler.Int("input", -1), ch.times, timeComps) || timeComps != 1 || ch.times.empty())
+                    continue;
+                if (!ReadAccessor(doc, sampler.Int("output", -1), ch.values, ch.comps) || ch.comps != (p == 1 ? 4 : 3))
+                    continue;
+                const size_t perKey = size_t(ch.comps) * (ch.interpolation == 2 ? 3 : 1);
+                if (ch.values.size() < ch.times.size() * perKey) continue;
+                duration = std::max(duration, ch.times.back());
+                used.push_back(std::move(ch));
+            }
+            if (used.empty()) continue;
+
+            RawClip clip;
+            clip.name = anim.String("name", "animation " + std::to_string(a));
+            clip.sampleRate = sampleRate;
+            clip.frameCount = uint32_t(std::floor(duration * sampleRate + 0.5f)) + 1;
+
+            const size_t joints = skeleton.JointCount();
+            clip.frames.resize(size_t(clip.frameCount) * joints);
+            for (uint32_t f = 0; f < clip.frameCount; ++f) {
+                JointTransform* frame = &clip.frames[size_t(f) * joints];
+                std::copy(skeleton.bindPose.begin(), skeleton.bindPose.end(), frame);
+                const float t = std::min(float(f) / sampleRate, duration);
+                for (const auto& ch : used) {
+                    JointTransform& x = frame[ch.joint];
+                    EvaluateChannel(ch, t, ch.path == 0 ? x.t : ch.path == 1 ? x.r : x.s);
+                }
+            }
+            clips.push_back(std::move(clip));
+        }
+    }
+}
+
+bool GltfLoader::LoadSkinned(const std::string& path, SkinnedMeshData& out,
+    const ClipCompression& compression, float sampleRate, std::vector<RawClip>* rawClips)
+{
+    out = SkinnedMeshData{};
+    Document doc;
+    if (!LoadDocument(path, doc)) return false;
+
+    const std::vector<Node> nodes = ReadNodes(doc.json);
+    int meshNode = -1;
+    for (size_t i = 0; i < nodes.size() && meshNode < 0; ++i)
+        if (nodes[i].mesh >= 0 && nodes[i].skin >= 0) meshNode = int(i);
+    if (meshNode < 0) {
+        std::cerr << "glTF: " << path << " has no skinned mesh\n";
+        return false;
+    }
+
+    // ---- skeleton ------------------------------------------------------------
+
+    const JsonValue* skin = Element(doc.json, "skins", nodes[meshNode].skin);
+    const JsonValue* jointList = skin ? skin->Find("joints") : nullptr;
+    if (!jointList || jointList->Size() == 0 || jointList->Size() > 65535) {
+        std::cerr << "glTF: " << path << " has an invalid skin\n";
+        return false;
+    }
+
+    const size_t jointCount = jointList->Size();
+    std::vector<int> skinJointNode(jointCount);
+    std::vector<int> nodeToSkinJoint(nodes.size(), -1);
+    for (size_t j = 0; j < jointCount; ++j) {
+        const int n = (*jointList)[j].Int();
+        if (n < 0 || size_t(n) >= nodes.size()) return false;
+        skinJointNode[j] = n;
+        nodeToSkinJoint[n] = int(j);
+    }
+
+    std::vector<float> ibm;
+    int ibmComps = 0;
+    const bool hasIbm = skin->Find("inverseBindMatrices") &&
+        ReadAccessor(doc, skin->Int("inverseBindMatrices", -1), ibm, ibmComps) &&
+        ibmComps == 16 && ibm.size() >= jointCount * 16;
+
+    // nearest ancestor that is a joint, and the depth in joints
+    std::vector<int> parentJoint(jointCount, -1), depth(jointCount, 0);
+    for (size_t j = 0; j < jointCount; ++j) {
+        for (int p = nodes[skinJointNode[j]].parent; p >= 0; p = nodes[p].parent)
+            if (nodeToSkinJoint[p] >= 0) { parentJoint[j] = nodeToSkinJoint[p]; break; }
+    }
+    for (size_t j = 0; j < jointCount; ++j)
+        for (int p = parentJoint[j]; p >= 0 && depth[j] <= int(jointCount); p = parentJoint[p]) ++depth[j];
+
+    // parents first
+    std::vector<int> order(jointCount);
+    for (size_t j = 0; j < jointCount; ++j) order[j] = int(j);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return depth[a] < depth[b]; });
+    std::vector<uint16_t> remap(jointCount);
+    for (size_t i = 0; i < jointCount; ++i) remap[order[i]] = uint16_t(i);
+
+    const JsonValue* nodeArray = doc.json.Find("nodes");
+    Skeleton& sk = out.skeleton;
+    sk.joints.resize(jointCount);
+    sk.bindPose.resize(jointCount);
+    sk.inverseBind.resize(jointCount);
+    std::vector<int> nodeToJoint(nodes.size(), -1);
+    for (size_t i = 0; i < jointCount; ++i) {
+        const int src = order[i];
+        const int node = skinJointNode[src];
+        sk.joints[i].name = (*nodeArray)[size_t(node)].String("name", "joint " + std::to_string(src));
+        sk.joints[i].parent = parentJoint[src] >= 0 ? int32_t(remap[parentJoint[src]]) : -1;
+        sk.bindPose[i] = nodes[node].local;
+        sk.inverseBind[i] = hasIbm ? JointMatrix::FromColumnMajor4x4(&ibm[size_t(src) * 16]) : JointMatrix::Identity();
+        nodeToJoint[node] = int(i);
+    }
+
+    // nodes above the root joints are not animated here
+    for (size_t i = 0; i < jointCount; ++i) {
+        if (sk.joints[i].parent >= 0) continue;
+        JointMatrix m = JointMatrix::Identity();
+        for (int p = nodes[skinJointNode[order[i]]].parent; p >= 0; p = nodes[p].parent)
+            m = Mul(ToMatrix(nodes[p].local), m);
+        sk.root = m;
+        break;
+    }
+
+    // ---- geometry ------------------------------------------------------------
+
+    const JsonValue* mesh = Element(doc.json, "meshes", nodes[meshNode].mesh);
+    const JsonValue* primitives = mesh ? mesh->Find("primitives") : nullptr;
+    if (!primitives) return false;
+
+    MeshData& md = out.mesh;
+    bool missingNormals = false, missingTangents = false;
+    for (size_t p = 0; p < primitives->Size(); ++p) {
+        const JsonValue& prim = (*primitives)[p];
+        if (prim.Int("mode", 4) != 4) {
+            std::cerr << "glTF: skipping non-triangle primitive " << p << "\n";
+            continue;
+        }
+        const JsonValue* attrs = prim.Find("attributes");
+        if (!attrs) continue;
+
+        std::vector<float> pos, nrm, uv, tan, col, jnt, wgt;
+        int cp = 0, cn = 0, cu = 0, ct = 0, cc = 0, cj = 0, cw = 0;
+        if (!ReadAccessor(doc, attrs->Int("POSITION", -1), pos, cp) || cp != 3) continue;
+        if (!ReadAccessor(doc, attrs->Int("JOINTS_0", -1), jnt, cj) || cj != 4 ||
+            !ReadAccessor(doc, attrs->Int("WEIGHTS_0", -1), wgt, cw) || cw != 4) {
+            std::cerr << "glTF: primitive " << p << " has no JOINTS_0/WEIGHTS_0, skipped\n";
+            continue;
+        }
+        const size_t count = pos.size() / 3;
+        const bool hasN = ReadAccessor(doc, attrs->Int("NORMAL", -1), nrm, cn) && cn == 3 && nrm.size() >= count * 3;
+        const bool hasUV = ReadAccessor(doc, attrs->Int("TEXCOORD_0", -1), uv, cu) && cu == 2 && uv.size() >= count * 2;
+        const bool hasT = ReadAccessor(doc, attrs->Int("TANGENT", -1), tan, ct) && ct == 4 && tan.size() >= count * 4;
+        const bool hasC = ReadAccessor(doc, attrs->Int("COLOR_0", -1), col, cc) && (cc == 3 || cc == 4) && col.size() >= count * cc;
+        if (jnt.size() < count * 4 || wgt.size() < count * 4) continue;
+        missingNormals |= !hasN;
+        missingTangents |= !hasT;
+
+        SubmeshDesc sub;
+        sub.hasMaterial = ReadMaterial(doc.json, prim.Int("material", -1), sub.material);
+
+        const uint32_t base = uint32_t(md.vertices.size());
+        for (size_t i = 0; i < count; ++i) {
+            Vertex v{};
+            v.px = pos[i * 3]; v.py = pos[i * 3 + 1]; v.pz = pos[i * 3 + 2];
+            if (hasN) { v.nx = nrm[i * 3]; v.ny = nrm[i * 3 + 1]; v.nz = nrm[i * 3 + 2]; }
+            else v.ny = 1.f;
+            if (hasUV) { v.u = uv[i * 2]; v.v = uv[i * 2 + 1]; }   // already top-left origin
+            v.r = sub.material.kd[0]; v.g = sub.material.kd[1]; v.b = sub.material.kd[2];
+            if (hasC) { v.r *= col[i * cc]; v.g *= col[i * cc + 1]; v.b *= col[i * cc + 2]; }
+            if (hasT) {
+                const float* t = &tan[i * 4];
+                v.tx = t[0]; v.ty = t[1]; v.tz = t[2];
+                v.bx = (v.ny * t[2] - v.nz * t[1]) * t[3];
+                v.by = (v.nz * t[0] - v.nx * t[2]) * t[3];
+                v.bz = (v.nx * t[1] - v.ny * t[0]) * t[3];
+            }
+            md.vertices.push_back(v);
+
+            // strongest four, renormalized
+            SkinInfluence inf;
+            float sum = 0.f;
+            for (int k = 0; k < 4; ++k) {
+                const int j = int(jnt[i * 4 + k]);
+                const float w = std::max(wgt[i * 4 + k], 0.f);
+                inf.joint[k] = j >= 0 && size_t(j) < jointCount ? remap[j] : 0;
+                inf.weight[k] = j >= 0 && size_t(j) < jointCount ? w : 0.f;
+                sum += inf.weight[k];
+            }
+            if (sum > 0.f) for (float& w : inf.weight) w /= sum;
+            else { inf.weight[0] = 1.f; }
+            // zero weights last so the skinning loop can skip them
+            for (int a = 0; a < 3; ++a)
+                for (int b = a + 1; b < 4; ++b)
+                    if (inf.weight[b] > inf.weight[a]) {
+                        std::swap(inf.weight[a], inf.weight[b]);
+                        std::swap(inf.joint[a], inf.joint[b]);
+                    }
+            out.influences.push_back(inf);
+        }
+
+        std::vector<uint32_t> idx;
+        if (prim.Find("indices")) {
+            if (!ReadIndices(doc, prim.Int("indices", -1), idx)) continue;
+        }
+        else {
+            idx.resize(count);
+            for (size_t i = 0; i < count; ++i) idx[i] = uint32_t(i);
+        }
+
+        sub.indexStart = uint32_t(md.indices.size());
+        for (size_t i = 0; i + 2 < idx.size(); i += 3) {
+            if (idx[i] >= count || idx[i + 1] >= count || idx[i + 2] >= count) continue;
+            md.indices.push_back(base + idx[i]);
+            md.indices.push_back(base + idx[i + 1]);
+            md.indices.push_back(base + idx[i + 2]);
+        }
+        sub.indexCount = uint32_t(md.indices.size()) - sub.indexStart;
+        md.submeshes.push_back(std::move(sub));
+    }
+
+    if (md.vertices.empty() || md.indices.empty()) {
+        std::cerr << "glTF: " << path << " has no skinned triangles\n";
+        return false;
+    }
+    if (missingNormals) ObjImporter::RecomputeSmoothNormals(md.vertices, md.indices);
+    if (missingTangents) ObjImporter::ComputeTangents(md.vertices, md.indices);
+
+    // ---- animations ----------------------------------------------------------
+
+    std::vector<RawClip> raw;
+    ReadAnimations(doc, nodeToJoint, sk, sampleRate, raw);
+    for (const auto& r : raw)
+        out.clips.push_back(AnimationClip::Compress(r, jointCount, compression));
+    if (rawClips) *rawClips = std::move(raw);
+    return true;
+}
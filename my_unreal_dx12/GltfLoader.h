@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Animation.h"
+#include "MeshData.h"
+
+struct SkinnedMeshData
+{
+    MeshData mesh;                          // bind pose, one submesh per primitive
+    std::vector<SkinInfluence> influences;  // one per vertex
+    Skeleton skeleton;
+    std::vector<AnimationClip> clips;
+};
+
+// GPU-free glTF 2.0 import of skinned meshes. Reads .gltf with external or
+// data: URI buffers and binary .glb. Textures must be external image files.
+namespace GltfLoader
+{
+    // The first node with both a mesh and a skin, the skin's joints and every
+    // animation driving them. Animations are resampled at sampleRate and
+    // compressed; rawClips, when given, receives the uncompressed samples.
+    bool LoadSkinned(const std::string& path, SkinnedMeshData& out,
+        const ClipCompression& compression = {}, float sampleRate = 30.f,
+        std::vector<RawClip>* rawClips = nullptr);
+}
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <array>
 #include "Utils.h"
+#include "UploadManager.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -15,8 +16,9 @@ public:
     GraphicsDevice() = default;
     GraphicsDevice(const GraphicsDevice&) = delete;
     GraphicsDevice& operator=(const GraphicsDevice&) = delete;
-    GraphicsDevice(GraphicsDevice&&) = default;
-    GraphicsDevice& operator=(GraphicsDevice&&) = default;
+    // the upload manager records against this device and queue
+    GraphicsDevice(GraphicsDevice&&) = delete;
+    GraphicsDevice& operator=(GraphicsDevice&&) = delete;
 
     ~GraphicsDevice() noexcept {
         if (m_queue && m_fence) {
@@ -67,11 +69,15 @@ public:
 
         m_fenceEvent.reset(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
         if (!m_fenceEvent) throw std::runtime_error("CreateEventEx failed");
+
+        m_uploads.Initialize(m_device.Get(), m_queue.Get());
     }
 
     IDXGIFactory7* Factory() const noexcept { return m_factory.Get(); }
     ID3D12Device* Device()  const noexcept { return m_device.Get(); }
     ID3D12CommandQueue* Queue()   const noexcept { return m_queue.Get(); }
+    // texture and buffer copies, submitted with the next frame
+    UploadManager& Uploads() noexcept { return m_uploads; }
 
     void WaitGPU() {
         const UINT64 v = ++m_fenceValue;
@@ -155,4 +161,6 @@ private:
     ComPtr<ID3D12Fence>     m_fence;
     UINT64                  m_fenceValue = 0;
     unique_handle           m_fenceEvent;
+    // after the device and queue, so it is destroyed first
+    UploadManager           m_uploads;
 };
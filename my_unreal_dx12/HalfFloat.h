@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// IEEE binary16 conversions, round to nearest even, for data the shaders
+// read as halves (DXGI_FORMAT_*16_FLOAT, f16tof32).
+
+inline uint16_t FloatToHalf(float f)
+{
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    x &= 0x7FFFFFFFu;
+    if (x >= 0x7F800000u) return uint16_t(sign | 0x7C00u | (x > 0x7F800000u ? 0x200u : 0u));
+    if (x >= 0x477FF000u) return uint16_t(sign | 0x7BFFu); // clamp to the largest finite half
+    if (x < 0x38800000u) {
+        // subnormal half, rounded to nearest even
+        if (x < 0x33000000u) return uint16_t(sign);
+        const uint32_t mant = (x & 0x7FFFFFu) | 0x800000u;
+        const uint32_t shift = 126u - (x >> 23);
+        uint32_t h = mant >> shift;
+        const uint32_t rest = mant & ((1u << shift) - 1u), halfway = 1u << (shift - 1u);
+        if (rest > halfway || (rest == halfway && (h & 1u))) ++h;
+        return uint16_t(sign | h);
+    }
+    uint32_t h = ((x - 0x38000000u) >> 13);
+    const uint32_t rest = x & 0x1FFFu;
+    if (rest > 0x1000u || (rest == 0x1000u && (h & 1u))) ++h;
+    return uint16_t(sign | h);
+}
+
+inline float HalfToFloat(uint16_t h)
+{
+    const uint32_t sign = uint32_t(h & 0x8000u) << 16;
+    const uint32_t exp = (h >> 10) & 0x1Fu, mant = h & 0x3FFu;
+    uint32_t x;
+    if (exp == 0) {
+        const float f = float(mant) * (1.f / 16777216.f);
+        std::memcpy(&x, &f, 4);
+        x |= sign;
+    }
+    else if (exp == 31) x = sign | 0x7F800000u | (mant << 13);
+    else x = sign | ((exp + 112u) << 23) | (mant << 13);
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
@@ -0,0 +1,83 @@
+#include "Hash128.h"
+#include <cstring>
+
+namespace
+{
+    constexpr uint64_t kC1 = 0x87c37b91114253d5ull;
+    constexpr uint64_t kC2 = 0x4cf5ad432745937full;
+
+    inline uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    inline uint64_t Fmix(uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return k;
+    }
+
+    inline uint64_t Load64(const uint8_t* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return v;
+    }
+}
+
+Hash128 HashBytes(const void* data, size_t size, Hash128 seed)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const size_t blocks = size / 16;
+
+    uint64_t h1 = seed.lo;
+    uint64_t h2 = seed.hi;
+
+    for (size_t i = 0; i < blocks; ++i, p += 16) {
+        uint64_t k1 = Load64(p);
+        uint64_t k2 = Load64(p + 8);
+
+        k1 *= kC1; k1 = Rotl(k1, 31); k1 *= kC2; h1 ^= k1;
+        h1 = Rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= kC2; k2 = Rotl(k2, 33); k2 *= kC1; h2 ^= k2;
+        h2 = Rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    uint64_t k1 = 0, k2 = 0;
+    switch (size & 15) {
+    case 15: k2 ^= uint64_t(p[14]) << 48; [[fallthrough]];
+    case 14: k2 ^= uint64_t(p[13]) << 40; [[fallthrough]];
+    case 13: k2 ^= uint64_t(p[12]) << 32; [[fallthrough]];
+    case 12: k2 ^= uint64_t(p[11]) << 24; [[fallthrough]];
+    case 11: k2 ^= uint64_t(p[10]) << 16; [[fallthrough]];
+    case 10: k2 ^= uint64_t(p[9]) << 8; [[fallthrough]];
+    case 9:  k2 ^= uint64_t(p[8]);
+        k2 *= kC2; k2 = Rotl(k2, 33); k2 *= kC1; h2 ^= k2;
+        [[fallthrough]];
+    case 8: k1 ^= uint64_t(p[7]) << 56; [[fallthrough]];
+    case 7: k1 ^= uint64_t(p[6]) << 48; [[fallthrough]];
+    case 6: k1 ^= uint64_t(p[5]) << 40; [[fallthrough]];
+    case 5: k1 ^= uint64_t(p[4]) << 32; [[fallthrough]];
+    case 4: k1 ^= uint64_t(p[3]) << 24; [[fallthrough]];
+    case 3: k1 ^= uint64_t(p[2]) << 16; [[fallthrough]];
+    case 2: k1 ^= uint64_t(p[1]) << 8; [[fallthrough]];
+    case 1: k1 ^= uint64_t(p[0]);
+        k1 *= kC1; k1 = Rotl(k1, 31); k1 *= kC2; h1 ^= k1;
+        break;
+    default:
+        break;
+    }
+
+    h1 ^= uint64_t(size);
+    h2 ^= uint64_t(size);
+    h1 += h2;
+    h2 += h1;
+    h1 = Fmix(h1);
+    h2 = Fmix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    return { h1, h2 };
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 128-bit content hash (MurmurHash3 x64_128). Used as a content address, not
+// for security: equal hashes are trusted to mean equal data.
+struct Hash128
+{
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool operator==(const Hash128& o) const { return lo == o.lo && hi == o.hi; }
+    bool operator!=(const Hash128& o) const { return !(*this == o); }
+    bool IsZero() const { return (lo | hi) == 0; }
+};
+
+// buffers hashed in sequence: HashBytes(b, nb, HashBytes(a, na))
+Hash128 HashBytes(const void* data, size_t size, Hash128 seed = {});
+
+struct Hash128Hasher
+{
+    size_t operator()(const Hash128& h) const { return size_t(h.lo ^ (h.hi * 0x9E3779B97F4A7C15ull)); }
+};
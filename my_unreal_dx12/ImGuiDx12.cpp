@@ -18,3 +18,95 @@ void ImGuiDx12::Draw(Renderer &r)
     ImGui::End();
     m_imgui.Render(r.GetCommandList());
 }
+
+void MemoryLedgerItem::DrawImGui()
+{
+    if (!ImGui::CollapsingHeader("Memory"))
+        return;
+
+    auto& ledger = MemoryLedger::I();
+    const auto total = ledger.GetTotals();
+    ImGui::Text("CPU %.1f MB  GPU %.1f MB  (%u allocations)",
+        total.cpuBytes / 1048576.0, total.gpuBytes / 1048576.0, total.count);
+    for (int c = 0; c < int(MemoryCategory::Count); ++c) {
+        const auto t = ledger.GetTotals(MemoryCategory(c));
+        if (!t.count) continue;
+        ImGui::BulletText("%-14s %5u  CPU %8.1f KB  GPU %8.1f KB",
+            MemoryLedger::CategoryName(MemoryCategory(c)), t.count,
+            t.cpuBytes / 1024.0, t.gpuBytes / 1024.0);
+    }
+
+    if (ImGui::Button("Export CSV")) {
+        if (ledger.WriteCSV(csvPath))
+            snprintf(status, sizeof(status), "wrote %s", csvPath);
+        else
+            snprintf(status, sizeof(status), "cannot write %s", csvPath);
+    }
+    if (status[0]) {
+        ImGui::SameLine();
+        ImGui::TextUnformatted(status);
+    }
+    filter.Draw("Filter", 200.f);
+
+    enum Column { ColCategory, ColName, ColCpu, ColGpu };
+    const ImGuiTableFlags flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_Resizable
+        | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_ScrollY
+        | ImGuiTableFlags_SizingFixedFit;
+    if (!ImGui::BeginTable("ledger", 4, flags, ImVec2(560.f, 260.f)))
+        return;
+
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Category", 0, 0.f, ColCategory);
+    ImGui::TableSetupColumn("Asset", ImGuiTableColumnFlags_WidthStretch, 0.f, ColName);
+    ImGui::TableSetupColumn("CPU KB", ImGuiTableColumnFlags_PreferSortDescending, 0.f, ColCpu);
+    ImGui::TableSetupColumn("GPU KB", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending, 0.f, ColGpu);
+    ImGui::TableHeadersRow();
+
+    // entries come and go every frame, so the rows are rebuilt and re-sorted
+    rows = ledger.Snapshot();
+    if (filter.IsActive()) {
+        rows.erase(std::remove_if(rows.begin(), rows.end(), [&](const MemoryLedger::Allocation& a) {
+            return !filter.PassFilter(a.name.c_str()) && !filter.PassFilter(MemoryLedger::CategoryName(a.category));
+        }), rows.end());
+    }
+
+    if (const ImGuiTableSortSpecs* sort = ImGui::TableGetSortSpecs(); sort && sort->SpecsCount > 0) {
+        std::stable_sort(rows.begin(), rows.end(), [sort](const MemoryLedger::Allocation& a, const MemoryLedger::Allocation& b) {
+            for (int i = 0; i < sort->SpecsCount; ++i) {
+                const ImGuiTableColumnSortSpecs& spec = sort->Specs[i];
+                int cmp = 0;
+                switch (spec.ColumnUserID) {
+                case ColCategory: cmp = int(a.category) - int(b.category); break;
+                case ColName: cmp = a.name.compare(b.name); break;
+                case ColCpu: cmp = (a.cpuBytes > b.cpuBytes) - (a.cpuBytes < b.cpuBytes); break;
+                case ColGpu: cmp = (a.gpuBytes > b.gpuBytes) - (a.gpuBytes < b.gpuBytes); break;
+                }
+                if (cmp != 0)
+                    return spec.SortDirection == ImGuiSortDirection_Ascending ? cmp < 0 : cmp > 0;
+            }
+            return a.id < b.id;
+        });
+    }
+
+    ImGuiListClipper clipper;
+    clipper.Begin(int(rows.size()));
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const auto& a = rows[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(MemoryLedger::CategoryName(a.category));
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(a.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", a.cpuBytes / 1024.0);
+            ImGui::TableNextColumn();
+            // already counted by the pool page holding it
+            if (a.suballocated)
+                ImGui::TextDisabled("%.1f", a.gpuBytes / 1024.0);
+            else
+                ImGui::Text("%.1f", a.gpuBytes / 1024.0);
+        }
+    }
+    ImGui::EndTable();
+}
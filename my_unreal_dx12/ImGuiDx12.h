@@ -6,6 +6,7 @@
 #include "ImGuiLayer.h"
 #include "Renderer.h"
 #include "ImGuiItem.h"
+#include "MemoryLedger.h"
 #include <vector>
 #include <functional>
 #include <iostream>
@@ -84,6 +85,18 @@ private:
 	float max;
 };
 
+// MemoryLedger contents as a sortable, filterable table with CSV export.
+class MemoryLedgerItem : public ImGuiItem {
+public:
+	explicit MemoryLedgerItem(const char* csvPath) : csvPath(csvPath) {}
+	void DrawImGui() override;
+private:
+	const char* csvPath;
+	ImGuiTextFilter filter;
+	std::vector<MemoryLedger::Allocation> rows;
+	char status[128] = {};
+};
+
 class ImGuiDx12
 {
 public:
@@ -127,6 +140,12 @@ public:
 		return t;
 	}
 
+	std::shared_ptr<MemoryLedgerItem> addMemoryLedger(const char* csvPath = "memory_ledger.csv") {
+
+		auto t = AddItem<MemoryLedgerItem>(csvPath);
+		return t;
+	}
+
 	template<typename T, typename... Args>
 	std::shared_ptr<T> AddItem(Args&&... args) {
 		assert((std::is_base_of_v<ImGuiItem, T>));
@@ -0,0 +1,656 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "ImageCodec.h"
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <emmintrin.h>
+#include "MappedFile.h"
+#include "stb_image.h"
+
+namespace
+{
+    // ---- inflate, RFC 1950/1951 ----
+
+    constexpr int kFastBits = 11;
+    constexpr int kMaxBits = 15;
+
+    const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    // Little-endian bit reader over the whole stream. Refill leaves at least
+    // 56 bits in the buffer, enough for a length and distance pair with
+    // their extra bits; past the end it reads zeros and counts them.
+    struct BitReader
+    {
+        const uint8_t* p = nullptr;
+        const uint8_t* end = nullptr;
+        uint64_t buf = 0;
+        int count = 0;
+        size_t padding = 0;
+
+        void Refill()
+        {
+            if (end - p >= 8) {
+                // the bits above count are those of the next bytes already,
+                // or'ing them in again leaves them as they are
+                uint64_t v;
+                std::memcpy(&v, p, 8);
+                buf |= v << count;
+                p += (63 - count) >> 3;
+                count |= 56;
+                return;
+            }
+            while (count <= 56) {
+                if (p < end)
+                    buf |= uint64_t(*p++) << count;
+                else
+                    ++padding;
+                count += 8;
+            }
+        }
+        uint32_t Peek(int n) const { return uint32_t(buf & ((uint64_t(1) << n) - 1)); }
+        void Drop(int n) { buf >>= n; count -= n; }
+        uint32_t Take(int n) { const uint32_t v = Peek(n); Drop(n); return v; }
+        // consumed some of the zeros read past the end
+        bool Overrun() const { return padding * 8 > size_t(count); }
+    };
+
+    uint32_t Reverse(uint32_t code, int length)
+    {
+        uint32_t r = 0;
+        for (int i = 0; i < length; ++i, code >>= 1)
+            r = (r << 1) | (code & 1);
+        return r;
+    }
+
+    struct Huffman
+    {
+        // the next kFastBits bits of the stream to symbol | length << 9, 0
+        // for a longer code
+        uint16_t fast[1 << kFastBits];
+        uint16_t count[kMaxBits + 1];   // codes per length
+        uint16_t symbols[288];          // in canonical order
+
+        bool Build(const uint8_t* lengths, int n)
+        {
+            std::memset(fast, 0, sizeof(fast));
+            std::memset(count, 0, sizeof(count));
+            for (int i = 0; i < n; ++i)
+                ++count[lengths[i]];
+            count[0] = 0;
+            // over-subscribed is corrupt; incomplete occurs, a lone distance code
+            int left = 1;
+            for (int len = 1; len <= kMaxBits; ++len) {
+                left = (left << 1) - count[len];
+                if (left < 0)
+                    return false;
+            }
+
+            uint16_t offsets[kMaxBits + 1];
+            uint32_t next[kMaxBits + 1];
+            offsets[1] = 0;
+            next[1] = 0;
+            for (int len = 2; len <= kMaxBits; ++len) {
+                offsets[len] = uint16_t(offsets[len - 1] + count[len - 1]);
+                next[len] = (next[len - 1] + count[len - 1]) << 1;
+            }
+            for (int sym = 0; sym < n; ++sym) {
+                const int len = lengths[sym];
+                if (!len)
+                    continue;
+                symbols[offsets[len]++] = uint16_t(sym);
+                const uint32_t code = next[len]++;
+                if (len <= kFastBits)
+                    for (uint32_t r = Reverse(code, len); r < (1u << kFastBits); r += 1u << len)
+                        fast[r] = uint16_t(sym | len << 9);
+            }
+            return true;
+        }
+    };
+
+    // codes longer than the table, bit by bit, first bit highest
+    int DecodeLong(BitReader& in, const Huffman& h)
+    {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= kMaxBits; ++len) {
+            code |= int((in.buf >> (len - 1)) & 1);
+            const int n = h.count[len];
+            if (code - n < first) {
+                in.Drop(len);
+                return h.symbols[index + (code - first)];
+            }
+            index += n;
+            first = (first + n) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    // -1 for a code the table does not have
+    inline int DecodeSymbol(BitReader& in, const Huffman& h)
+    {
+        const uint16_t e = h.fast[in.Peek(kFastBits)];
+        if (!e)
+            return DecodeLong(in, h);
+        in.Drop(e >> 9);
+        return e & 511;
+    }
+
+    struct FixedCodes
+    {
+        Huffman litlen, distance;
+        FixedCodes()
+        {
+            uint8_t lengths[288];
+            std::memset(lengths, 8, 144);
+            std::memset(lengths + 144, 9, 112);
+            std::memset(lengths + 256, 7, 24);
+            std::memset(lengths + 280, 8, 8);
+            litlen.Build(lengths, 288);
+            std::memset(lengths, 5, 32);
+            distance.Build(lengths, 32);
+        }
+    };
+
+    const FixedCodes& Fixed()
+    {
+        static const FixedCodes codes;
+        return codes;
+    }
+
+    bool ReadCodes(BitReader& in, Huffman& litlen, Huffman& distance)
+    {
+        static const uint8_t kOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        in.Refill();
+        const int hlit = int(in.Take(5)) + 257;
+        const int hdist = int(in.Take(5)) + 1;
+        const int hclen = int(in.Take(4)) + 4;
+        uint8_t codeLengths[19] = {};
+        for (int i = 0; i < hclen; ++i) {
+            in.Refill();
+            codeLengths[kOrder[i]] = uint8_t(in.Take(3));
+        }
+        Huffman lengthCode;
+        if (!lengthCode.Build(codeLengths, 19))
+            return false;
+
+        uint8_t lengths[288 + 32];
+        const int total = hlit + hdist;
+        int n = 0;
+        while (n < total) {
+            in.Refill();
+            const int sym = DecodeSymbol(in, lengthCode);
+            if (sym < 0)
+                return false;
+            if (sym < 16) {
+                lengths[n++] = uint8_t(sym);
+                continue;
+            }
+            uint8_t value = 0;
+            int repeat;
+            if (sym == 16) {
+                if (!n)
+                    return false;
+                value = lengths[n - 1];
+                repeat = 3 + int(in.Take(2));
+            }
+            else if (sym == 17)
+                repeat = 3 + int(in.Take(3));
+            else
+                repeat = 11 + int(in.Take(7));
+            if (n + repeat > total)
+                return false;
+            std::memset(lengths + n, value, size_t(repeat));
+            n += repeat;
+        }
+        // a block needs its end code
+        if (!lengths[256])
+            return false;
+        return litlen.Build(lengths, hlit) && distance.Build(lengths + hlit, hdist);
+    }
+
+    // A zlib stream that inflates to exactly size bytes; out has 8 more for
+    // the match copies, which move 8 bytes at a time.
+    bool Inflate(const uint8_t* data, size_t size, uint8_t* out, size_t outSize)
+    {
+        if (size < 2)
+            return false;
+        const uint32_t cmf = data[0], flg = data[1];
+        if ((cmf & 15) != 8 || (cmf * 256 + flg) % 31 || (flg & 32))
+            return false;
+
+        BitReader in;
+        in.p = data + 2;
+        in.end = data + size;
+        uint8_t* const start = out;
+        uint8_t* const end = out + outSize;
+        Huffman litlen, distance;
+
+        bool last = false;
+        while (!last) {
+            in.Refill();
+            last = in.Take(1) != 0;
+            const uint32_t type = in.Take(2);
+            if (type == 0) {
+                // stored: the rest of the byte goes, then LEN and NLEN, and
+                // the whole bytes left in the buffer are handed back
+                in.Drop(in.count & 7);
+                const uint32_t len = in.Take(16), nlen = in.Take(16);
+                if ((len ^ 0xFFFF) != nlen)
+                    return false;
+                const size_t buffered = size_t(in.count >> 3);
+                if (in.padding > buffered)
+                    return false;
+                in.p -= buffered - in.padding;
+                in.buf = 0;
+                in.count = 0;
+                in.padding = 0;
+                if (size_t(in.end - in.p) < len || size_t(end - out) < len)
+                    return false;
+                std::memcpy(out, in.p, len);
+                out += len;
+                in.p += len;
+                continue;
+            }
+
+            const Huffman* ll = &Fixed().litlen;
+            const Huffman* dd = &Fixed().distance;
+            if (type == 2) {
+                if (!ReadCodes(in, litlen, distance))
+                    return false;
+                ll = &litlen;
+                dd = &distance;
+            }
+            else if (type != 1)
+                return false;
+
+            for (;;) {
+                in.Refill();
+                int sym = DecodeSymbol(in, *ll);
+                if (sym < 256) {
+                    if (sym < 0 || out == end)
+                        return false;
+                    *out++ = uint8_t(sym);
+                    // a refill holds two codes of up to 15 bits and more
+                    sym = DecodeSymbol(in, *ll);
+                    if (sym < 256) {
+                        if (sym < 0 || out == end)
+                            return false;
+                        *out++ = uint8_t(sym);
+                        continue;
+                    }
+                }
+                if (sym == 256)
+                    break;
+                sym -= 257;
+                if (sym >= 29)
+                    return false;
+                const size_t length = kLengthBase[sym] + in.Take(kLengthExtra[sym]);
+                const int d = DecodeSymbol(in, *dd);
+                if (d < 0 || d >= 30)
+                    return false;
+                const size_t dist = kDistanceBase[d] + in.Take(kDistanceExtra[d]);
+                if (dist > size_t(out - start) || length > size_t(end - out))
+                    return false;
+
+                const uint8_t* src = out - dist;
+                if (dist >= 8) {
+                    uint8_t* const stop = out + length;
+                    do {
+                        std::memcpy(out, src, 8);
+                        out += 8;
+                        src += 8;
+                    } while (out < stop);
+                    out = stop;
+                }
+                else if (dist == 1) {
+                    std::memset(out, *src, length);
+                    out += length;
+                }
+                else {
+                    for (size_t i = 0; i < length; ++i)
+                        out[i] = src[i];
+                    out += length;
+                }
+            }
+            if (in.Overrun())
+                return false;
+        }
+        return out == end;
+    }
+
+    // ---- PNG rows ----
+
+    inline uint8_t Paeth(int a, int b, int c)
+    {
+        const int p = a + b - c;
+        const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return uint8_t(a);
+        return uint8_t(pb <= pc ? b : c);
+    }
+
+    // dst may be src; prev is the unfiltered row above, zeros for the first
+    void UnfilterScalar(uint8_t* dst, const uint8_t* src, const uint8_t* prev, size_t n, uint32_t bpp, uint8_t filter)
+    {
+        switch (filter) {
+        case 0:
+            std::memmove(dst, src, n);
+            break;
+        case 1:
+            for (size_t i = 0; i < n; ++i)
+                dst[i] = uint8_t(src[i] + (i >= bpp ? dst[i - bpp] : 0));
+            break;
+        case 2:
+            for (size_t i = 0; i < n; ++i)
+                dst[i] = uint8_t(src[i] + prev[i]);
+            break;
+        case 3:
+            for (size_t i = 0; i < n; ++i)
+                dst[i] = uint8_t(src[i] + (((i >= bpp ? dst[i - bpp] : 0) + prev[i]) >> 1));
+            break;
+        case 4:
+            for (size_t i = 0; i < n; ++i)
+                dst[i] = uint8_t(src[i] + (i >= bpp ? Paeth(dst[i - bpp], prev[i], prev[i - bpp]) : prev[i]));
+            break;
+        }
+    }
+
+    // RGBA: Sub, Average and Paeth a pixel per step in the low lanes, Up 16
+    // bytes. Three-byte pixels stay scalar, their partial loads and stores
+    // cost more than the lanes save.
+    void UnfilterRgbaSse2(uint8_t* dst, const uint8_t* src, const uint8_t* prev, size_t n, uint8_t filter)
+    {
+        const auto load = [](const uint8_t* p) {
+            int v;
+            std::memcpy(&v, p, 4);
+            return _mm_cvtsi32_si128(v);
+        };
+        const auto store = [](uint8_t* p, __m128i v) {
+            const int x = _mm_cvtsi128_si32(v);
+            std::memcpy(p, &x, 4);
+        };
+        const __m128i zero = _mm_setzero_si128();
+
+        switch (filter) {
+        case 0:
+            std::memmove(dst, src, n);
+            break;
+        case 1: {
+            __m128i a = zero;
+            for (size_t i = 0; i < n; i += 4) {
+                a = _mm_add_epi8(a, load(src + i));
+                store(dst + i, a);
+            }
+            break;
+        }
+        case 2: {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(
+                    _mm_loadu_si128((const __m128i*)(src + i)), _mm_loadu_si128((const __m128i*)(prev + i))));
+            for (; i < n; ++i)
+                dst[i] = uint8_t(src[i] + prev[i]);
+            break;
+        }
+        case 3: {
+            // pavgb rounds up, less the low bit both odd sums carry
+            const __m128i one = _mm_set1_epi8(1);
+            __m128i a = zero;
+            for (size_t i = 0; i < n; i += 4) {
+                const __m128i b = load(prev + i);
+                const __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+                a = _mm_add_epi8(avg, load(src + i));
+                store(dst + i, a);
+            }
+            break;
+        }
+        case 4: {
+            // in 16 bits: pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|, ties to a, then b
+            __m128i a = zero, c = zero;
+            for (size_t i = 0; i < n; i += 4) {
+                const __m128i b = _mm_unpacklo_epi8(load(prev + i), zero);
+                __m128i pa = _mm_sub_epi16(b, c);
+                __m128i pb = _mm_sub_epi16(a, c);
+                __m128i pc = _mm_add_epi16(pa, pb);
+                pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+                pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+                pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+                const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+                const __m128i isA = _mm_cmpeq_epi16(pa, smallest);
+                const __m128i isB = _mm_cmpeq_epi16(pb, smallest);
+                const __m128i bc = _mm_or_si128(_mm_and_si128(isB, b), _mm_andnot_si128(isB, c));
+                const __m128i nearest = _mm_or_si128(_mm_and_si128(isA, a), _mm_andnot_si128(isA, bc));
+                const __m128i x = _mm_add_epi8(_mm_packus_epi16(nearest, nearest), load(src + i));
+                store(dst + i, x);
+                a = _mm_unpacklo_epi8(x, zero);
+                c = b;
+            }
+            break;
+        }
+        }
+    }
+
+    void Unfilter(uint8_t* dst, const uint8_t* src, const uint8_t* prev, size_t n, uint32_t bpp, uint8_t filter, bool simd)
+    {
+        if (simd && bpp == 4)
+            UnfilterRgbaSse2(dst, src, prev, n, filter);
+        else
+            UnfilterScalar(dst, src, prev, n, bpp, filter);
+    }
+
+    inline uint32_t Be32(const uint8_t* p)
+    {
+        return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+    }
+
+    constexpr uint32_t Tag(const char (&s)[5])
+    {
+        return uint32_t(uint8_t(s[0])) << 24 | uint32_t(uint8_t(s[1])) << 16 | uint32_t(uint8_t(s[2])) << 8 | uint8_t(s[3]);
+    }
+}
+
+bool ImageCodec::IsPng(const uint8_t* data, size_t size)
+{
+    static const uint8_t kSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    return size >= 8 && std::memcmp(data, kSignature, 8) == 0;
+}
+
+uint8_t* ImageCodec::DecodePng(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height, bool simd)
+{
+    if (!IsPng(data, size))
+        return nullptr;
+
+    uint32_t w = 0, h = 0, channels = 0;
+    uint8_t type = 0;
+    uint8_t palette[256 * 4] = {};
+    uint32_t paletteSize = 0;
+    bool keyed = false;
+    uint8_t key[3] = {};        // the tRNS colour of grey and RGB images
+    const uint8_t* idat = nullptr;
+    size_t idatSize = 0;
+    std::vector<uint8_t> joined;    // when the stream spans several IDATs
+
+    const uint8_t* p = data + 8;
+    const uint8_t* const end = data + size;
+    for (bool done = false; !done;) {
+        if (end - p < 12)
+            return nullptr;
+        const uint32_t length = Be32(p);
+        const uint32_t tag = Be32(p + 4);
+        const uint8_t* chunk = p + 8;
+        if (length > size_t(end - chunk) - 4)
+            return nullptr;
+        p = chunk + length + 4;
+
+        switch (tag) {
+        case Tag("IHDR"): {
+            if (length != 13 || channels)
+                return nullptr;
+            w = Be32(chunk);
+            h = Be32(chunk + 4);
+            type = chunk[9];
+            static const uint8_t kChannels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+            // 8 bits, not interlaced; the rest goes to stb_image
+            if (chunk[8] != 8 || type > 6 || !kChannels[type] || chunk[10] || chunk[11] || chunk[12])
+                return nullptr;
+            if (!w || !h || w > (1u << 24) || h > (1u << 24) || uint64_t(w) * h * 4 > INT_MAX)
+                return nullptr;
+            channels = kChannels[type];
+            break;
+        }
+        case Tag("PLTE"):
+            if (length % 3 || length > 768)
+                return nullptr;
+            paletteSize = length / 3;
+            for (uint32_t i = 0; i < paletteSize; ++i) {
+                std::memcpy(palette + i * 4, chunk + i * 3, 3);
+                palette[i * 4 + 3] = 255;
+            }
+            break;
+        case Tag("tRNS"):
+            // 8-bit keys are the low byte of the stored 16
+            if (type == 3) {
+                if (!paletteSize || length > paletteSize)
+                    return nullptr;
+                for (uint32_t i = 0; i < length; ++i)
+                    palette[i * 4 + 3] = chunk[i];
+            }
+            else if (type == 0 && length == 2) {
+                key[0] = chunk[1];
+                keyed = true;
+            }
+            else if (type == 2 && length == 6) {
+                key[0] = chunk[1];
+                key[1] = chunk[3];
+                key[2] = chunk[5];
+                keyed = true;
+            }
+            else
+                return nullptr;
+            break;
+        case Tag("IDAT"):
+            if (!channels)
+                return nullptr;
+            if (!idat) {
+                idat = chunk;
+                idatSize = length;
+            }
+            else {
+                if (joined.empty())
+                    joined.assign(idat, idat + idatSize);
+                joined.insert(joined.end(), chunk, chunk + length);
+            }
+            break;
+        case Tag("IEND"):
+            done = true;
+            break;
+        case Tag("CgBI"):
+            return nullptr;
+        default:
+            // an unknown critical chunk
+            if (!(tag & (32u << 24)))
+                return nullptr;
+            break;
+        }
+    }
+    if (!idat || (type == 3 && !paletteSize))
+        return nullptr;
+    if (!joined.empty()) {
+        idat = joined.data();
+        idatSize = joined.size();
+    }
+
+    const size_t rowBytes = size_t(w) * channels;
+    const size_t stride = rowBytes + 1;
+    const size_t rawSize = stride * h;
+    std::unique_ptr<uint8_t[]> raw(new uint8_t[rawSize + 8]);
+    if (!Inflate(idat, idatSize, raw.get(), rawSize))
+        return nullptr;
+
+    uint8_t* rgba = static_cast<uint8_t*>(std::malloc(size_t(w) * h * 4));
+    if (!rgba)
+        return nullptr;
+    const std::vector<uint8_t> zeros(rowBytes, 0);
+    for (uint32_t y = 0; y < h; ++y) {
+        uint8_t* row = raw.get() + y * stride;
+        const uint8_t filter = row[0];
+        if (filter > 4) {
+            std::free(rgba);
+            return nullptr;
+        }
+        uint8_t* out = rgba + size_t(y) * w * 4;
+        // RGBA rows unfilter straight into the image, the others in place
+        if (type == 6) {
+            Unfilter(out, row + 1, y ? out - size_t(w) * 4 : zeros.data(), rowBytes, 4, filter, simd);
+            continue;
+        }
+        Unfilter(row + 1, row + 1, y ? row + 1 - stride : zeros.data(), rowBytes, channels, filter, simd);
+        const uint8_t* in = row + 1;
+        switch (type) {
+        case 0:
+            for (uint32_t x = 0; x < w; ++x, out += 4) {
+                out[0] = out[1] = out[2] = in[x];
+                out[3] = keyed && in[x] == key[0] ? 0 : 255;
+            }
+            break;
+        case 2:
+            for (uint32_t x = 0; x < w; ++x, in += 3, out += 4) {
+                out[0] = in[0];
+                out[1] = in[1];
+                out[2] = in[2];
+                out[3] = keyed && in[0] == key[0] && in[1] == key[1] && in[2] == key[2] ? 0 : 255;
+            }
+            break;
+        case 3:
+            for (uint32_t x = 0; x < w; ++x, out += 4)
+                std::memcpy(out, palette + in[x] * 4, 4);
+            break;
+        case 4:
+            for (uint32_t x = 0; x < w; ++x, in += 2, out += 4) {
+                out[0] = out[1] = out[2] = in[0];
+                out[3] = in[1];
+            }
+            break;
+        }
+    }
+    width = w;
+    height = h;
+    return rgba;
+}
+
+uint8_t* ImageCodec::LoadFromMemory(const uint8_t* data, size_t size, int* width, int* height)
+{
+    uint32_t w = 0, h = 0;
+    if (IsPng(data, size)) {
+        if (uint8_t* pixels = DecodePng(data, size, w, h)) {
+            *width = int(w);
+            *height = int(h);
+            return pixels;
+        }
+    }
+    if (size > size_t(INT_MAX))
+        return nullptr;
+    int comp = 0;
+    return stbi_load_from_memory(data, int(size), width, height, &comp, 4);
+}
+
+uint8_t* ImageCodec::Load(const char* path, int* width, int* height)
+{
+    MappedFile file;
+    if (!file.Open(path)) {
+        int comp = 0;
+        return stbi_load(path, width, height, &comp, 4);
+    }
+    return LoadFromMemory(file.Data(), file.Size(), width, height);
+}
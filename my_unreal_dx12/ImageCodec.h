@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Image files to RGBA8 the way stbi_load(..., 4) decodes them, with a fast
+// path for the PNGs textures mostly are: 8-bit grey, grey and alpha, RGB,
+// RGBA or palette, not interlaced. Their zlib stream is inflated with a
+// 64-bit bit buffer and table lookups of up to 11 bits per code, and RGBA
+// rows are unfiltered with SSE2, a pixel per step for the filters that
+// depend on their left neighbour. The output is the same bytes stb_image gives.
+// Everything else, JPEG included, goes to stb_image, whose baseline JPEG
+// path already runs its IDCT, upsampling and colour conversion in SSE2.
+//
+// Pixels are malloc'd like stb_image's: free them with stbi_image_free.
+namespace ImageCodec
+{
+    // nullptr on failure, the reason in stbi_failure_reason()
+    uint8_t* Load(const char* path, int* width, int* height);
+    uint8_t* LoadFromMemory(const uint8_t* data, size_t size, int* width, int* height);
+
+    // The fast path alone: nullptr for anything it does not take, or a
+    // stream it finds corrupt. simd false unfilters with the scalar loops,
+    // for comparison; the output is the same.
+    uint8_t* DecodePng(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height, bool simd = true);
+    bool IsPng(const uint8_t* data, size_t size);
+}
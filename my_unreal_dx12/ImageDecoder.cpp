@@ -0,0 +1,251 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "ImageDecoder.h"
+#include "ImageCodec.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+struct ImageDecoderState
+{
+    ImageDecoder::Request request;
+    ImageDecoder::Result result;
+    uint64_t reserved = 0;
+    bool abandoned = false;     // the ticket is gone, under the decoder's mutex
+    JobCounter job;
+    // whoever claims the request runs it: its job, or a waiter that got there first
+    std::atomic<bool> claimed{ false };
+    std::atomic<bool> done{ false };
+};
+
+bool ImageDecoder::Ticket::Ready() const
+{
+    return m_state && m_state->done.load(std::memory_order_acquire);
+}
+
+const ImageDecoder::Result& ImageDecoder::Ticket::Wait()
+{
+    ImageDecoder::I().WaitFor(m_state);
+    return m_state->result;
+}
+
+ImageDecoder::Result ImageDecoder::Ticket::Take()
+{
+    Wait();
+    Result r = std::move(m_state->result);
+    Release();
+    return r;
+}
+
+ImageDecoder::Ticket& ImageDecoder::Ticket::operator=(Ticket&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        m_state = std::move(other.m_state);
+    }
+    return *this;
+}
+
+void ImageDecoder::Ticket::Release()
+{
+    if (!m_state) return;
+    ImageDecoder::I().Abandon(*m_state);
+    m_state.reset();
+}
+
+uint64_t ImageDecoder::EstimateBytes(uint32_t width, uint32_t height, Stage stage)
+{
+    const uint64_t rgba = uint64_t(width) * height * 4;
+    switch (stage) {
+    case Stage::Decode: return rgba;
+    // the decode is freed once the chain, a third larger, is built
+    case Stage::Mips: return rgba + rgba * 4 / 3;
+    // BC7 and BC5 are a quarter of RGBA8
+    default: return rgba + rgba * 4 / 3 + rgba / 3;
+    }
+}
+
+Hash128 ImageDecoder::HashPixels(const uint8_t* rgba, uint32_t width, uint32_t height, Hash128 seed)
+{
+    const uint32_t size[2] = { width, height };
+    return HashBytes(rgba, size_t(width) * height * 4, HashBytes(size, sizeof(size), seed));
+}
+
+ImageDecoder::Ticket ImageDecoder::Submit(Request request)
+{
+    auto state = std::make_shared<ImageDecoderState>();
+
+    // the header is enough for the size; a file that does not parse fails later
+    int w = 0, h = 0, comp = 0;
+    const bool known = request.encoded.empty()
+        ? stbi_info(request.path.c_str(), &w, &h, &comp) != 0
+        : stbi_info_from_memory(request.encoded.data(), int(request.encoded.size()), &w, &h, &comp) != 0;
+    state->reserved = (known ? EstimateBytes(uint32_t(w), uint32_t(h), request.stage) : 0) + request.encoded.size();
+    state->request = std::move(request);
+
+    bool throttled = false;
+    for (;;) {
+        StatePtr oldest;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            // one request always goes, however large, when none is left to finish
+            if (m_inFlight.empty() || m_stats.bytesInFlight + state->reserved <= m_budget) {
+                m_stats.bytesInFlight += state->reserved;
+                m_stats.peakBytesInFlight = std::max(m_stats.peakBytesInFlight, m_stats.bytesInFlight);
+                ++m_stats.submitted;
+                m_inFlight.push_back(state);
+                m_queue.push_back(state);
+                break;
+            }
+            if (!throttled) {
+                throttled = true;
+                ++m_stats.throttled;
+            }
+            oldest = m_inFlight.front();
+        }
+        // help with the oldest request; a result nobody takes keeps its
+        // reservation, but then there is one fewer request in flight
+        WaitFor(oldest);
+    }
+
+    Dispatch();
+    Ticket ticket;
+    ticket.m_state = std::move(state);
+    return ticket;
+}
+
+void ImageDecoder::Dispatch()
+{
+    for (;;) {
+        StatePtr next;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            const unsigned limit = m_maxConcurrent ? m_maxConcurrent : JobSystem::I().WorkerCount() + 1;
+            // requests a waiter ran itself leave the queue here
+            while (!m_queue.empty() && m_queue.front()->claimed.load(std::memory_order_acquire))
+                m_queue.pop_front();
+            if (m_queue.empty() || m_running >= limit)
+                return;
+            next = std::move(m_queue.front());
+            m_queue.pop_front();
+            ++m_running;
+        }
+        ImageDecoderState* raw = next.get();
+        JobSystem::I().Run(raw->job, [this, next] {
+            if (!Execute(next, true)) {
+                std::lock_guard<std::mutex> lk(m_mutex);
+                --m_running;
+            }
+            Dispatch();
+        });
+    }
+}
+
+bool ImageDecoder::Execute(const StatePtr& state, bool counted)
+{
+    if (state->claimed.exchange(true, std::memory_order_acq_rel))
+        return false;
+    Decode(*state);
+    Finish(*state, counted);
+    return true;
+}
+
+void ImageDecoder::Finish(ImageDecoderState& state, bool counted)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (counted) --m_running;
+    if (state.abandoned) Unreserve(state);
+    ++(state.result.ok ? m_stats.completed : m_stats.failed);
+    m_stats.bytesDecoded += uint64_t(state.result.width) * state.result.height * 4;
+    auto it = std::find_if(m_inFlight.begin(), m_inFlight.end(), [&](const StatePtr& p) { return p.get() == &state; });
+    if (it != m_inFlight.end()) m_inFlight.erase(it);
+    state.done.store(true, std::memory_order_release);
+}
+
+void ImageDecoder::WaitFor(const StatePtr& state)
+{
+    ImageDecoderState& s = *state;
+    if (s.done.load(std::memory_order_acquire) || Execute(state, false))
+        return;
+    while (!s.done.load(std::memory_order_acquire)) {
+        JobSystem::I().Wait(s.job);
+        if (!s.done.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+}
+
+void ImageDecoder::Abandon(ImageDecoderState& state)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    state.abandoned = true;
+    if (state.done.load(std::memory_order_relaxed)) Unreserve(state);
+}
+
+void ImageDecoder::Unreserve(ImageDecoderState& state)
+{
+    m_stats.bytesInFlight -= state.reserved;
+    state.reserved = 0;
+}
+
+void ImageDecoder::Decode(ImageDecoderState& state)
+{
+    Request& rq = state.request;
+    Result& r = state.result;
+
+    auto t0 = std::chrono::steady_clock::now();
+    int w = 0, h = 0;
+    std::unique_ptr<uint8_t, void(*)(void*)> pixels{ rq.encoded.empty()
+        ? ImageCodec::Load(rq.path.c_str(), &w, &h)
+        : ImageCodec::LoadFromMemory(rq.encoded.data(), rq.encoded.size(), &w, &h), stbi_image_free };
+    std::vector<uint8_t>().swap(rq.encoded);
+    if (!pixels) {
+        const char* reason = stbi_failure_reason();
+        r.error = reason ? reason : "decode failed";
+        return;
+    }
+    r.width = uint32_t(w);
+    r.height = uint32_t(h);
+    r.pixelHash = HashPixels(pixels.get(), r.width, r.height);
+    r.decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    if (rq.stage == Stage::Decode) {
+        r.rgba = std::move(pixels);
+        r.ok = true;
+        return;
+    }
+
+    MipGenerator::Stats mipStats;
+    r.mips = MipGenerator::Generate(pixels.get(), r.width, r.height, rq.mips, &mipStats);
+    pixels.reset();
+    r.mipSeconds = mipStats.seconds;
+    r.chainBytes = r.mips.pixels.size();
+
+    const bool mipsOnly = r.width <= rq.mipsOnlyUpTo && r.height <= rq.mipsOnlyUpTo;
+    if (rq.stage == Stage::Compress && BlockCompress::CanCompress(r.width, r.height) && !mipsOnly) {
+        BlockCompress::Stats bcStats;
+        r.blocks = BlockCompress::Compress(r.mips, rq.compress, &bcStats);
+        r.mips = MipGenerator::Chain{};
+        r.compressed = true;
+        r.compressSeconds = bcStats.seconds;
+    }
+    r.ok = true;
+}
+
+void ImageDecoder::SetLimits(uint64_t memoryBudget, unsigned maxConcurrent)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_budget = memoryBudget;
+        m_maxConcurrent = maxConcurrent;
+    }
+    Dispatch();
+}
+
+ImageDecoder::Stats ImageDecoder::GetStats() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_stats;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "BlockCompress.h"
+#include "Hash128.h"
+#include "JobSystem.h"
+#include "MipGenerator.h"
+
+struct ImageDecoderState;
+
+// Decode service on the JobSystem: image files or encoded bytes in, RGBA8
+// out, optionally carried on through mips and block compression so that
+// the result only needs uploading. Every request returns a Ticket, a future
+// whose Wait runs other jobs (or the request itself, when no worker has
+// started it) instead of sleeping, so it is safe to wait from inside a job.
+//
+// Back-pressure: a request reserves an estimate of the memory it peaks at,
+// from the image header, until its result is taken or its ticket destroyed,
+// so finished results nobody collected still count. Submit blocks, helping,
+// while the reservations would pass the budget; at most maxConcurrent
+// requests run at once, the rest wait in submission order.
+class ImageDecoder
+{
+public:
+    static ImageDecoder& I() { static ImageDecoder s; return s; }
+
+    enum class Stage : uint8_t
+    {
+        Decode,     // RGBA8
+        Mips,       // the mip chain
+        Compress,   // block compressed chain; sizes BC cannot take stay mips
+    };
+
+    struct Request
+    {
+        std::string path;                   // read when encoded is empty
+        std::vector<uint8_t> encoded;       // file contents already in memory
+        Stage stage = Stage::Decode;
+        MipGenerator::Settings mips;
+        BlockCompress::Settings compress;
+        // Stage::Compress stops at the mips for images no larger than this
+        // on both sides; the texture atlas compresses what it packs itself
+        uint32_t mipsOnlyUpTo = 0;
+    };
+
+    struct Result
+    {
+        bool ok = false;
+        std::string error;
+        uint32_t width = 0, height = 0;
+        // Stage::Decode, tightly packed rows as stb_image returns them
+        std::unique_ptr<uint8_t, void(*)(void*)> rgba{ nullptr, nullptr };
+        MipGenerator::Chain mips;           // Stage::Mips, or Compress that could not
+        BlockCompress::Chain blocks;        // Stage::Compress
+        bool compressed = false;
+        uint64_t chainBytes = 0;            // the mip chain as RGBA8
+        Hash128 pixelHash;                  // HashPixels of the decode
+        double decodeSeconds = 0.0;
+        double mipSeconds = 0.0;
+        double compressSeconds = 0.0;
+    };
+
+    // move-only; dropping a ticket gives up its result and its reservation
+    class Ticket
+    {
+    public:
+        Ticket() = default;
+        Ticket(Ticket&&) noexcept = default;
+        Ticket& operator=(Ticket&& other) noexcept;
+        ~Ticket() { Release(); }
+        bool Valid() const { return m_state != nullptr; }
+        bool Ready() const;
+        // the result stays in the ticket
+        const Result& Wait();
+        // moves the result out, leaving the ticket empty
+        Result Take();
+
+    private:
+        friend class ImageDecoder;
+        void Release();
+        std::shared_ptr<ImageDecoderState> m_state;
+    };
+
+    struct Stats
+    {
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        uint64_t throttled = 0;     // Submit calls that had to wait for memory
+        uint64_t bytesInFlight = 0; // reserved by requests and results not taken yet
+        uint64_t peakBytesInFlight = 0;
+        uint64_t bytesDecoded = 0;  // RGBA8 produced
+    };
+
+    Ticket Submit(Request request);
+
+    // 0 concurrency means one per JobSystem thread
+    void SetLimits(uint64_t memoryBudget, unsigned maxConcurrent = 0);
+    Stats GetStats() const;
+
+    // peak bytes a request is expected to hold, from the image size
+    static uint64_t EstimateBytes(uint32_t width, uint32_t height, Stage stage);
+    // Content address of decoded RGBA8 and its size, equal for every file
+    // that decodes to the same pixels whatever its encoding.
+    static Hash128 HashPixels(const uint8_t* rgba, uint32_t width, uint32_t height, Hash128 seed = {});
+
+    ImageDecoder(const ImageDecoder&) = delete;
+    ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+private:
+    ImageDecoder() = default;
+
+    using StatePtr = std::shared_ptr<ImageDecoderState>;
+    // starts queued requests while there are free slots
+    void Dispatch();
+    // runs the request if nobody claimed it yet; true when it ran here
+    bool Execute(const StatePtr& state, bool counted);
+    void Finish(ImageDecoderState& state, bool counted);
+    void WaitFor(const StatePtr& state);
+    // the ticket let go of the request; its reservation ends once it finished
+    void Abandon(ImageDecoderState& state);
+    void Unreserve(ImageDecoderState& state);
+    static void Decode(ImageDecoderState& state);
+
+    mutable std::mutex m_mutex;
+    std::deque<StatePtr> m_queue;       // submitted, not started
+    std::deque<StatePtr> m_inFlight;    // queued or running, oldest first
+    uint64_t m_budget = 256ull << 20;
+    unsigned m_maxConcurrent = 0;
+    unsigned m_running = 0;
+    Stats m_stats;
+};
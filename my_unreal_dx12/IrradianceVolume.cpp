@@ -0,0 +1,378 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "IrradianceVolume.h"
+#include "HalfFloat.h"
+#include "JobSystem.h"
+#include "MeshBVH.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    constexpr float kPi = 3.14159265359f;
+    constexpr uint32_t kFloats = IrradianceVolume::kCoefficients * 3;
+
+    // real spherical harmonics up to l = 2, d unit length
+    void EvalBasis(const float d[3], float y[9])
+    {
+        const float x = d[0], yy = d[1], z = d[2];
+        y[0] = 0.282095f;
+        y[1] = 0.488603f * yy;
+        y[2] = 0.488603f * z;
+        y[3] = 0.488603f * x;
+        y[4] = 1.092548f * x * yy;
+        y[5] = 1.092548f * yy * z;
+        y[6] = 0.315392f * (3.f * z * z - 1.f);
+        y[7] = 1.092548f * x * z;
+        y[8] = 0.546274f * (x * x - yy * yy);
+    }
+
+    // clamped cosine convolution per band (pi, 2pi/3, pi/4), divided by pi
+    constexpr float kBand[9] = { 1.f, 2.f / 3.f, 2.f / 3.f, 2.f / 3.f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+    void PackProbe(const float c[kFloats], uint32_t* out)
+    {
+        for (uint32_t w = 0; w < IrradianceVolume::kProbeWords; ++w) {
+            const uint16_t lo = 2 * w < kFloats ? FloatToHalf(c[2 * w]) : 0;
+            const uint16_t hi = 2 * w + 1 < kFloats ? FloatToHalf(c[2 * w + 1]) : 0;
+            out[w] = uint32_t(lo) | (uint32_t(hi) << 16);
+        }
+    }
+
+    void UnpackProbe(const uint32_t* in, float c[kFloats])
+    {
+        for (uint32_t i = 0; i < kFloats; ++i)
+            c[i] = HalfToFloat(uint16_t(in[i >> 1] >> ((i & 1) * 16)));
+    }
+
+    // coefficients of a constant radiance
+    void UniformProbe(const float radiance[3], float c[kFloats])
+    {
+        std::fill(c, c + kFloats, 0.f);
+        for (int ch = 0; ch < 3; ++ch) c[ch] = radiance[ch] * 0.282095f * 4.f * kPi;
+    }
+}
+
+IrradianceVolume::Stats IrradianceVolume::Bake(const std::vector<Object>& objects, const Lighting& lighting, const Settings& settings)
+{
+    Stats stats;
+    const auto t0 = std::chrono::steady_clock::now();
+    *this = IrradianceVolume{};
+
+    // ---- world space scene ----------------------------------------------------
+
+    std::vector<Vertex> world;
+    std::vector<uint32_t> indices;
+    float mn[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, mx[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (const Object& obj : objects) {
+        const auto& m = obj.world;
+        // cofactors of the upper 3x3: normals stay perpendicular under non-uniform scale
+        float cof[3][3];
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c) {
+                const int r1 = (r + 1) % 3, r2 = (r + 2) % 3, c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+                cof[r][c] = m[r1][c1] * m[r2][c2] - m[r1][c2] * m[r2][c1];
+            }
+        const uint32_t base = uint32_t(world.size());
+        for (size_t i = 0; i < obj.vertexCount; ++i) {
+            const Vertex& s = obj.vertices[i];
+            Vertex v = s;
+            v.px = s.px * m[0][0] + s.py * m[1][0] + s.pz * m[2][0] + m[3][0];
+            v.py = s.px * m[0][1] + s.py * m[1][1] + s.pz * m[2][1] + m[3][1];
+            v.pz = s.px * m[0][2] + s.py * m[1][2] + s.pz * m[2][2] + m[3][2];
+            float n[3];
+            for (int c = 0; c < 3; ++c) n[c] = s.nx * cof[0][c] + s.ny * cof[1][c] + s.nz * cof[2][c];
+            const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            const float inv = len > 0.f ? 1.f / len : 0.f;
+            v.nx = n[0] * inv; v.ny = n[1] * inv; v.nz = n[2] * inv;
+            const float p[3] = { v.px, v.py, v.pz };
+            for (int a = 0; a < 3; ++a) { mn[a] = std::min(mn[a], p[a]); mx[a] = std::max(mx[a], p[a]); }
+            world.push_back(v);
+        }
+        for (size_t i = 0; i + 2 < obj.indexCount; i += 3) {
+            if (obj.indices[i] >= obj.vertexCount || obj.indices[i + 1] >= obj.vertexCount || obj.indices[i + 2] >= obj.vertexCount)
+                continue;
+            for (int k = 0; k < 3; ++k) indices.push_back(base + obj.indices[i + k]);
+        }
+    }
+    if (indices.empty()) {
+        SetUniform(lighting.sky);
+        stats.probes = 1;
+        stats.bytes = m_packed.size() * sizeof(uint32_t);
+        stats.floatBytes = kFloats * sizeof(float);
+        return stats;
+    }
+
+    MeshBVH bvh;
+    bvh.Build(world.data(), indices.data(), indices.size());
+
+    // ---- grid -----------------------------------------------------------------
+
+    float extent[3];
+    for (int a = 0; a < 3; ++a) extent[a] = mx[a] - mn[a];
+    const float diag = std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+    const float bias = std::max(diag * 1e-5f, 1e-6f);
+    m_spacing = std::max(settings.spacing, 1e-3f);
+    for (;;) {
+        uint64_t total = 1;
+        for (int a = 0; a < 3; ++a) {
+            m_dims[a] = std::max(1u, uint32_t(std::ceil(extent[a] / m_spacing)));
+            total *= m_dims[a];
+        }
+        if (total <= std::max(1u, settings.maxProbes)) break;
+        m_spacing *= 1.25f;
+    }
+    // probes at cell centres of a grid centred on the scene
+    for (int a = 0; a < 3; ++a)
+        m_origin[a] = 0.5f * (mn[a] + mx[a]) - 0.5f * float(m_dims[a] - 1) * m_spacing;
+
+    // ---- tracing --------------------------------------------------------------
+
+    // Fibonacci sphere, shared by all probes; basis values precomputed
+    const uint32_t rays = std::max(1u, settings.raysPerProbe);
+    std::vector<float> dirs(size_t(rays) * 3), basis(size_t(rays) * kCoefficients);
+    for (uint32_t r = 0; r < rays; ++r) {
+        const float z = 1.f - (2.f * r + 1.f) / float(rays);
+        const float s = std::sqrt(std::max(0.f, 1.f - z * z));
+        const float phi = 2.39996323f * float(r);
+        float* d = &dirs[size_t(r) * 3];
+        d[0] = s * std::cos(phi); d[1] = s * std::sin(phi); d[2] = z;
+        EvalBasis(d, &basis[size_t(r) * kCoefficients]);
+    }
+
+    float sun[3];
+    {
+        const float* s = lighting.sunDirection;
+        const float len = std::sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+        for (int a = 0; a < 3; ++a) sun[a] = len > 0.f ? s[a] / len : 0.f;
+    }
+
+    const uint32_t count = ProbeCount();
+    std::vector<float> coeffs(size_t(count) * kFloats, 0.f);
+    std::vector<uint8_t> valid(count, 1);
+    std::atomic<uint64_t> traced{ 0 };
+
+    JobSystem::I().ParallelFor(count, 4, [&](size_t begin, size_t end) {
+        uint64_t local = 0;
+        for (size_t probe = begin; probe < end; ++probe) {
+            const uint32_t c[3] = {
+                uint32_t(probe % m_dims[0]), uint32_t(probe / m_dims[0] % m_dims[1]), uint32_t(probe / (size_t(m_dims[0]) * m_dims[1])) };
+            float* out = &coeffs[probe * kFloats];
+            uint32_t backfaces = 0;
+
+            BVHRay ray;
+            for (int a = 0; a < 3; ++a) ray.origin[a] = m_origin[a] + float(c[a]) * m_spacing;
+            for (uint32_t r = 0; r < rays; ++r) {
+                const float* d = &dirs[size_t(r) * 3];
+                std::memcpy(ray.dir, d, sizeof(ray.dir));
+                ray.tMax = FLT_MAX;
+                ++local;
+
+                float radiance[3];
+                BVHHit hit;
+                if (!bvh.Intersect(ray, hit)) {
+                    std::memcpy(radiance, lighting.sky, sizeof(radiance));
+                }
+                else {
+                    const Vertex& v0 = world[indices[hit.triangle * 3]];
+                    const Vertex& v1 = world[indices[hit.triangle * 3 + 1]];
+                    const Vertex& v2 = world[indices[hit.triangle * 3 + 2]];
+                    const float w0 = 1.f - hit.u - hit.v;
+                    float n[3] = {
+                        v0.nx * w0 + v1.nx * hit.u + v2.nx * hit.v,
+                        v0.ny * w0 + v1.ny * hit.u + v2.ny * hit.v,
+                        v0.nz * w0 + v1.nz * hit.u + v2.nz * hit.v };
+                    const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    if (!(len > 0.f) || n[0] * d[0] + n[1] * d[1] + n[2] * d[2] > 0.f) {
+                        ++backfaces;
+                        continue;
+                    }
+                    for (float& x : n) x /= len;
+                    const float albedo[3] = {
+                        v0.r * w0 + v1.r * hit.u + v2.r * hit.v,
+                        v0.g * w0 + v1.g * hit.u + v2.g * hit.v,
+                        v0.b * w0 + v1.b * hit.u + v2.b * hit.v };
+
+                    float lit = std::max(0.f, n[0] * sun[0] + n[1] * sun[1] + n[2] * sun[2]);
+                    if (lit > 0.f) {
+                        BVHRay shadow;
+                        for (int a = 0; a < 3; ++a) {
+                            shadow.origin[a] = ray.origin[a] + d[a] * hit.t + n[a] * bias;
+                            shadow.dir[a] = sun[a];
+                        }
+                        if (bvh.Occluded(shadow)) lit = 0.f;
+                        ++local;
+                    }
+                    for (int ch = 0; ch < 3; ++ch)
+                        radiance[ch] = albedo[ch] * (lighting.sunColor[ch] * lit + lighting.sky[ch]);
+                }
+
+                const float* y = &basis[size_t(r) * kCoefficients];
+                for (uint32_t i = 0; i < kCoefficients; ++i)
+                    for (int ch = 0; ch < 3; ++ch) out[i * 3 + ch] += radiance[ch] * y[i];
+            }
+
+            const float scale = 4.f * kPi / float(rays);
+            for (uint32_t i = 0; i < kCoefficients; ++i)
+                for (int ch = 0; ch < 3; ++ch) out[i * 3 + ch] *= scale * kBand[i];
+            if (float(backfaces) > settings.maxBackfaceFraction * float(rays)) valid[probe] = 0;
+        }
+        traced.fetch_add(local, std::memory_order_relaxed);
+    });
+
+    // ---- probes inside geometry -----------------------------------------------
+
+    // grow the valid region one ring at a time, averaging valid neighbours
+    for (uint32_t i = 0; i < count; ++i) stats.invalidProbes += !valid[i];
+    for (bool changed = stats.invalidProbes > 0; changed;) {
+        changed = false;
+        std::vector<uint8_t> next = valid;
+        for (uint32_t probe = 0; probe < count; ++probe) {
+            if (valid[probe]) continue;
+            const int c[3] = { int(probe % m_dims[0]), int(probe / m_dims[0] % m_dims[1]), int(probe / (m_dims[0] * m_dims[1])) };
+            float sum[kFloats] = {};
+            uint32_t n = 0;
+            for (int a = 0; a < 3; ++a)
+                for (int step = -1; step <= 1; step += 2) {
+                    int o[3] = { c[0], c[1], c[2] };
+                    o[a] += step;
+                    if (o[a] < 0 || o[a] >= int(m_dims[a])) continue;
+                    const uint32_t other = uint32_t(o[0]) + m_dims[0] * (uint32_t(o[1]) + m_dims[1] * uint32_t(o[2]));
+                    if (!valid[other]) continue;
+                    for (uint32_t k = 0; k < kFloats; ++k) sum[k] += coeffs[size_t(other) * kFloats + k];
+                    ++n;
+                }
+            if (n == 0) continue;
+            for (uint32_t k = 0; k < kFloats; ++k) coeffs[size_t(probe) * kFloats + k] = sum[k] / float(n);
+            next[probe] = 1;
+            changed = true;
+        }
+        valid.swap(next);
+    }
+    // all probes inside: nothing better than the sky
+    for (uint32_t probe = 0; probe < count; ++probe)
+        if (!valid[probe]) UniformProbe(lighting.sky, &coeffs[size_t(probe) * kFloats]);
+
+    // ---- packing --------------------------------------------------------------
+
+    m_packed.resize(size_t(count) * kProbeWords);
+    float unpacked[kFloats];
+    for (uint32_t probe = 0; probe < count; ++probe) {
+        const float* c = &coeffs[size_t(probe) * kFloats];
+        PackProbe(c, &m_packed[size_t(probe) * kProbeWords]);
+        UnpackProbe(&m_packed[size_t(probe) * kProbeWords], unpacked);
+        for (uint32_t k = 0; k < kFloats; ++k)
+            stats.maxPackError = std::max(stats.maxPackError, std::fabs(unpacked[k] - c[k]));
+    }
+
+    stats.probes = count;
+    stats.rays = traced.load();
+    stats.bytes = m_packed.size() * sizeof(uint32_t);
+    stats.floatBytes = size_t(count) * kFloats * sizeof(float);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return stats;
+}
+
+void IrradianceVolume::SetUniform(const float radiance[3])
+{
+    *this = IrradianceVolume{};
+    m_dims[0] = m_dims[1] = m_dims[2] = 1;
+    float c[kFloats];
+    UniformProbe(radiance, c);
+    m_packed.resize(kProbeWords);
+    PackProbe(c, m_packed.data());
+}
+
+void IrradianceVolume::SetProbe(const float coefficients[kCoefficients][3])
+{
+    *this = IrradianceVolume{};
+    m_dims[0] = m_dims[1] = m_dims[2] = 1;
+    m_packed.resize(kProbeWords);
+    PackProbe(&coefficients[0][0], m_packed.data());
+}
+
+void IrradianceVolume::Sample(const float p[3], const float n[3], float out[3]) const
+{
+    out[0] = out[1] = out[2] = 0.f;
+    if (m_packed.empty()) return;
+
+    // trilinear weights, clamped to the grid like the shader does
+    uint32_t i0[3], i1[3];
+    float t[3];
+    for (int a = 0; a < 3; ++a) {
+        const float f = std::clamp((p[a] - m_origin[a]) / m_spacing, 0.f, float(m_dims[a] - 1));
+        i0[a] = std::min(uint32_t(f), m_dims[a] - 1);
+        i1[a] = std::min(i0[a] + 1, m_dims[a] - 1);
+        t[a] = f - float(i0[a]);
+    }
+
+    float blended[kFloats] = {}, probe[kFloats];
+    for (int corner = 0; corner < 8; ++corner) {
+        float w = 1.f;
+        uint32_t c[3];
+        for (int a = 0; a < 3; ++a) {
+            const bool upper = (corner >> a) & 1;
+            c[a] = upper ? i1[a] : i0[a];
+            w *= upper ? t[a] : 1.f - t[a];
+        }
+        if (w == 0.f) continue;
+        UnpackProbe(&m_packed[(size_t(c[0]) + m_dims[0] * (size_t(c[1]) + size_t(m_dims[1]) * c[2])) * kProbeWords], probe);
+        for (uint32_t k = 0; k < kFloats; ++k) blended[k] += w * probe[k];
+    }
+
+    float y[kCoefficients];
+    EvalBasis(n, y);
+    for (uint32_t i = 0; i < kCoefficients; ++i)
+        for (int ch = 0; ch < 3; ++ch) out[ch] += blended[i * 3 + ch] * y[i];
+    for (int ch = 0; ch < 3; ++ch) out[ch] = std::max(out[ch], 0.f);
+}
+
+bool IrradianceVolume::Save(const std::string& path) const
+{
+    const uint32_t header[6] = { kMagic, kVersion, m_dims[0], m_dims[1], m_dims[2], uint32_t(m_packed.size()) };
+    const float grid[4] = { m_origin[0], m_origin[1], m_origin[2], m_spacing };
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.is_open()) return false;
+        f.write(reinterpret_cast<const char*>(header), sizeof(header));
+        f.write(reinterpret_cast<const char*>(grid), sizeof(grid));
+        f.write(reinterpret_cast<const char*>(m_packed.data()), std::streamsize(m_packed.size() * sizeof(uint32_t)));
+        if (!f.good()) return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool IrradianceVolume::Load(const std::string& path)
+{
+    *this = IrradianceVolume{};
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open()) return false;
+
+    uint32_t header[6];
+    float grid[4];
+    if (!f.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != kMagic || header[1] != kVersion)
+        return false;
+    if (!f.read(reinterpret_cast<char*>(grid), sizeof(grid)))
+        return false;
+    const uint64_t probes = uint64_t(header[2]) * header[3] * header[4];
+    if (probes == 0 || probes * kProbeWords != header[5] || !(grid[3] > 0.f)) return false;
+
+    IrradianceVolume volume;
+    for (int a = 0; a < 3; ++a) { volume.m_dims[a] = header[2 + a]; volume.m_origin[a] = grid[a]; }
+    volume.m_spacing = grid[3];
+    volume.m_packed.resize(header[5]);
+    if (!f.read(reinterpret_cast<char*>(volume.m_packed.data()), std::streamsize(volume.m_packed.size() * sizeof(uint32_t))))
+        return false;
+
+    *this = std::move(volume);
+    return true;
+}
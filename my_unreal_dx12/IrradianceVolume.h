@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// GPU-free irradiance volume: a 3D grid of L2 spherical-harmonic probes
+// baked by tracing rays against the static scene. Each probe stores the
+// cosine-convolved SH of the light reaching it divided by pi, so the pixel
+// shader gets the ambient term for a normal as a plain SH evaluation after
+// blending the eight surrounding probes.
+//
+// Rays that escape see the sky; rays that hit a surface see its vertex
+// colour lit the way the renderer lights it without the volume: the sun
+// (shadowed) plus the flat sky ambient. Direct sunlight is not stored, the
+// shader adds it.
+class IrradianceVolume
+{
+public:
+    static constexpr uint32_t kMagic = 0x31565249; // "IRV1"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kCoefficients = 9;
+    // 27 halves (RGB per coefficient, coefficient major) and one pad
+    static constexpr uint32_t kProbeWords = 14;
+
+    struct Object
+    {
+        const Vertex* vertices = nullptr;
+        size_t vertexCount = 0;
+        const uint32_t* indices = nullptr;
+        size_t indexCount = 0;
+        // row-vector world matrix (p' = p * world), as XMFLOAT4X4 stores it
+        float world[4][4]{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+    };
+
+    struct Lighting
+    {
+        float sunDirection[3] = { -0.2762f, 0.9206f, -0.2762f }; // towards the sun, like uLightDir
+        float sunColor[3] = { 1.f, 0.98f, 0.90f };
+        float sky[3] = { 0.25f, 0.25f, 0.25f };
+    };
+
+    struct Settings
+    {
+        float spacing = 2.f;
+        uint32_t raysPerProbe = 256;
+        // the spacing grows until the grid fits
+        uint32_t maxProbes = 1u << 16;
+        // probes seeing more back faces than this are inside geometry and
+        // take the average of their valid neighbours instead
+        float maxBackfaceFraction = 0.1f;
+    };
+
+    struct Stats
+    {
+        uint32_t probes = 0;
+        uint32_t invalidProbes = 0;
+        uint64_t rays = 0;
+        double seconds = 0.0;
+        size_t bytes = 0;           // Packed, what the GPU holds
+        size_t floatBytes = 0;      // the same coefficients as floats
+        float maxPackError = 0.f;   // largest coefficient change from packing
+    };
+
+    Stats Bake(const std::vector<Object>& objects, const Lighting& lighting, const Settings& settings);
+    Stats Bake(const std::vector<Object>& objects, const Lighting& lighting) { return Bake(objects, lighting, Settings()); }
+
+    // One probe of constant radiance: the flat ambient term.
+    void SetUniform(const float radiance[3]);
+    // One probe with the given coefficients, convolved and divided by pi
+    // like Bake stores them (EnvironmentMap::Irradiance).
+    void SetProbe(const float coefficients[kCoefficients][3]);
+
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+
+    bool Empty() const { return m_packed.empty(); }
+    uint32_t ProbeCount() const { return m_dims[0] * m_dims[1] * m_dims[2]; }
+    const uint32_t* Dims() const { return m_dims; }
+    const float* Origin() const { return m_origin; }
+    float Spacing() const { return m_spacing; }
+
+    // kProbeWords per probe, x fastest; the layout PixelShader.hlsl reads
+    const std::vector<uint32_t>& Packed() const { return m_packed; }
+
+    // What the shader computes for a surface at p with unit normal n.
+    void Sample(const float p[3], const float n[3], float out[3]) const;
+
+private:
+    float m_origin[3]{};
+    float m_spacing = 1.f;
+    uint32_t m_dims[3]{};
+    std::vector<uint32_t> m_packed;
+};
@@ -0,0 +1,150 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace
+{
+    // queue index of the calling thread, the shared queue for non-workers
+    thread_local int t_worker = -1;
+}
+
+JobSystem::JobSystem()
+{
+    const unsigned hw = std::max(2u, std::thread::hardware_concurrency());
+    const unsigned workers = hw - 1;
+    for (unsigned i = 0; i <= workers; ++i)
+        queues_.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < workers; ++i)
+        workers_.emplace_back([this, i] { WorkerLoop(i); });
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        quit_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+void JobSystem::Run(JobCounter& counter, Job job)
+{
+    counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+
+    const unsigned self = t_worker >= 0 ? unsigned(t_worker) : WorkerCount();
+    Queue& q = *queues_[self];
+    {
+        std::lock_guard<std::mutex> lk(q.mu);
+        q.jobs.push_back({ &counter, std::move(job) });
+    }
+    queued_.fetch_add(1);
+
+    // pairs with the sleepers_ increment in WorkerLoop, one side always sees the other
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> lk(mu_);
+        cv_.notify_one();
+    }
+}
+
+bool JobSystem::TryRunOne(unsigned self)
+{
+    if (queued_.load(std::memory_order_relaxed) == 0) return false;
+
+    Entry e{};
+    bool found = false;
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lk(own.mu);
+        if (!own.jobs.empty()) {
+            e = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            found = true;
+        }
+    }
+
+    const unsigned n = unsigned(queues_.size());
+    for (unsigned k = 1; k < n && !found; ++k) {
+        Queue& victim = *queues_[(self + k) % n];
+        std::unique_lock<std::mutex> lk(victim.mu, std::try_to_lock);
+        if (!lk.owns_lock() || victim.jobs.empty()) continue;
+        e = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        found = true;
+    }
+    if (!found) return false;
+
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+
+    // the counter drops however the job ends, or its waiters spin forever
+    struct Release {
+        JobCounter& counter;
+        ~Release() { counter.m_pending.fetch_sub(1, std::memory_order_acq_rel); }
+    } release{ *e.counter };
+    try {
+        e.job();
+    }
+    catch (...) {
+        if (!e.counter->m_failed.exchange(true))
+            e.counter->m_error = std::current_exception();
+    }
+    return true;
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    const unsigned self = t_worker >= 0 ? unsigned(t_worker) : WorkerCount();
+    while (!counter.Done()) {
+        if (!TryRunOne(self))
+            std::this_thread::yield();
+    }
+    if (counter.m_failed.load(std::memory_order_acquire))
+        std::rethrow_exception(counter.m_error);
+}
+
+void JobSystem::WorkerLoop(unsigned index)
+{
+    t_worker = int(index);
+    for (;;) {
+        if (TryRunOne(index)) continue;
+        // a try_lock miss can leave jobs behind, spin once more before sleeping
+        if (queued_.load() > 0) { std::this_thread::yield(); continue; }
+
+        std::unique_lock<std::mutex> lk(mu_);
+        sleepers_.fetch_add(1);
+        cv_.wait(lk, [this] { return quit_ || queued_.load() > 0; });
+        sleepers_.fetch_sub(1);
+        if (quit_) return;
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    const size_t maxChunks = size_t(WorkerCount() + 1) * 4;
+    const size_t chunk = std::max(grain, (count + maxChunks - 1) / maxChunks);
+    if (chunk >= count) { fn(0, count); return; }
+
+    // pushed back to front, so the owner pops chunks in order while thieves
+    // take the far end of the range
+    JobCounter counter;
+    size_t last = ((count - 1) / chunk) * chunk;
+    for (size_t begin = last; begin >= chunk; begin -= chunk) {
+        const size_t end = std::min(count, begin + chunk);
+        Run(counter, [&fn, begin, end] { fn(begin, end); });
+    }
+    // the queued chunks point at counter and fn, they must finish before
+    // an exception from the first one leaves
+    std::exception_ptr first;
+    try {
+        fn(0, chunk);
+    }
+    catch (...) {
+        first = std::current_exception();
+    }
+    Wait(counter);
+    if (first) std::rethrow_exception(first);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads for CPU-side batch work (BVH builds, bakes).
+// Jobs are fire-and-forget closures grouped by a JobCounter; Wait runs queued
+// jobs on the calling thread until the counter drains, so jobs may spawn and
+// wait for children without deadlocking the pool.
+//
+// Work stealing: every worker owns a deque and runs its newest job first,
+// idle threads take the oldest job of another deque. Jobs submitted from
+// outside the pool go to a shared deque that everyone steals from.
+//
+// A job that throws still counts as finished. The first exception per
+// counter is kept and Wait rethrows it once the counter drains; a worker
+// thread never lets one escape.
+class JobCounter
+{
+public:
+    bool Done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> m_pending{ 0 };
+    std::atomic<bool> m_failed{ false };
+    std::exception_ptr m_error;     // written before the job's decrement, read after Done
+};
+
+class JobSystem
+{
+public:
+    static JobSystem& I() { static JobSystem s; return s; }
+
+    using Job = std::function<void()>;
+
+    void Run(JobCounter& counter, Job job);
+    // Rethrows the first exception a job of the counter threw.
+    void Wait(JobCounter& counter);
+
+    // Splits [0, count) into chunks of at least grain items. If fn throws,
+    // every chunk still finishes before the first exception is rethrown.
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn);
+
+    unsigned WorkerCount() const { return unsigned(workers_.size()); }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+private:
+    JobSystem();
+    ~JobSystem();
+
+    struct Entry {
+        JobCounter* counter;
+        Job job;
+    };
+
+    // one per worker plus the shared one at the end, on separate cache lines
+    struct alignas(64) Queue {
+        std::mutex mu;
+        std::deque<Entry> jobs;
+    };
+
+    // own queue from the back, then the others from the front
+    bool TryRunOne(unsigned self);
+    void WorkerLoop(unsigned index);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::atomic<size_t> queued_{ 0 };
+    std::atomic<unsigned> sleepers_{ 0 };
+
+    std::mutex mu_;             // sleeping only
+    std::condition_variable cv_;
+    std::vector<std::thread> workers_;
+    std::atomic<bool> quit_{ false };
+};
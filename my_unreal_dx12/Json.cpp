@@ -0,0 +1,222 @@
+#include "Json.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+class JsonParser
+{
+public:
+    JsonParser(const char* text, size_t size) : m_p(text), m_end(text + size) {}
+
+    bool ParseDocument(JsonValue& out)
+    {
+        if (!ParseValue(out, 0)) return false;
+        SkipSpace();
+        return m_p == m_end || Fail("trailing characters");
+    }
+
+    std::string error;
+    size_t Offset(const char* begin) const { return size_t(m_p - begin); }
+
+private:
+    static constexpr int kMaxDepth = 256;
+
+    bool Fail(const char* what)
+    {
+        if (error.empty()) error = what;
+        return false;
+    }
+
+    void SkipSpace()
+    {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+            ++m_p;
+    }
+
+    bool Literal(const char* word)
+    {
+        const size_t n = strlen(word);
+        if (size_t(m_end - m_p) < n || memcmp(m_p, word, n) != 0) return Fail("invalid literal");
+        m_p += n;
+        return true;
+    }
+
+    static void AppendUtf8(std::string& s, uint32_t cp)
+    {
+        if (cp < 0x80) s += char(cp);
+        else if (cp < 0x800) { s += char(0xC0 | (cp >> 6)); s += char(0x80 | (cp & 0x3F)); }
+        else if (cp < 0x10000) { s += char(0xE0 | (cp >> 12)); s += char(0x80 | ((cp >> 6) & 0x3F)); s += char(0x80 | (cp & 0x3F)); }
+        else { s += char(0xF0 | (cp >> 18)); s += char(0x80 | ((cp >> 12) & 0x3F)); s += char(0x80 | ((cp >> 6) & 0x3F)); s += char(0x80 | (cp & 0x3F)); }
+    }
+
+    bool Hex4(uint32_t& v)
+    {
+        if (m_end - m_p < 4) return Fail("truncated \\u escape");
+        v = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char c = *m_p++;
+            v <<= 4;
+            if (c >= '0' && c <= '9') v |= uint32_t(c - '0');
+            else if (c >= 'a' && c <= 'f') v |= uint32_t(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') v |= uint32_t(c - 'A' + 10);
+            else return Fail("invalid \\u escape");
+        }
+        return true;
+    }
+
+    bool ParseString(std::string& out)
+    {
+        ++m_p; // opening quote
+        out.clear();
+        while (m_p < m_end) {
+            const char c = *m_p++;
+            if (c == '"') return true;
+            if (c != '\\') { out += c; continue; }
+            if (m_p == m_end) break;
+            switch (*m_p++) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t cp;
+                if (!Hex4(cp)) return false;
+                if (cp >= 0xD800 && cp < 0xDC00 && m_end - m_p >= 6 && m_p[0] == '\\' && m_p[1] == 'u') {
+                    m_p += 2;
+                    uint32_t lo;
+                    if (!Hex4(lo)) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                AppendUtf8(out, cp);
+                break;
+            }
+            default: return Fail("invalid escape");
+            }
+        }
+        return Fail("unterminated string");
+    }
+
+    bool ParseNumber(double& out)
+    {
+        const char* start = m_p;
+        if (m_p < m_end && (*m_p == '-' || *m_p == '+')) ++m_p;
+        while (m_p < m_end && ((*m_p >= '0' && *m_p <= '9') || *m_p == '.' || *m_p == 'e' || *m_p == 'E' || *m_p == '-' || *m_p == '+'))
+            ++m_p;
+        // strtod needs a terminated copy, numbers are short
+        char buf[64];
+        const size_t n = size_t(m_p - start);
+        if (n == 0 || n >= sizeof(buf)) return Fail("invalid number");
+        memcpy(buf, start, n);
+        buf[n] = 0;
+        char* endp = nullptr;
+        out = strtod(buf, &endp);
+        return endp == buf + n || Fail("invalid number");
+    }
+
+    bool ParseValue(JsonValue& v, int depth)
+    {
+        if (depth > kMaxDepth) return Fail("nesting too deep");
+        SkipSpace();
+        if (m_p == m_end) return Fail("unexpected end");
+
+        switch (*m_p) {
+        case '{': {
+            v.m_type = JsonValue::Type::Object;
+            ++m_p;
+            SkipSpace();
+            if (m_p < m_end && *m_p == '}') { ++m_p; return true; }
+            for (;;) {
+                SkipSpace();
+                if (m_p == m_end || *m_p != '"') return Fail("expected member name");
+                v.m_members.emplace_back();
+                if (!ParseString(v.m_members.back().first)) return false;
+                SkipSpace();
+                if (m_p == m_end || *m_p++ != ':') return Fail("expected ':'");
+                if (!ParseValue(v.m_members.back().second, depth + 1)) return false;
+                SkipSpace();
+                if (m_p == m_end) return Fail("unterminated object");
+                if (*m_p == ',') { ++m_p; continue; }
+                if (*m_p == '}') { ++m_p; return true; }
+                return Fail("expected ',' or '}'");
+            }
+        }
+        case '[': {
+            v.m_type = JsonValue::Type::Array;
+            ++m_p;
+            SkipSpace();
+            if (m_p < m_end && *m_p == ']') { ++m_p; return true; }
+            for (;;) {
+                v.m_items.emplace_back();
+                if (!ParseValue(v.m_items.back(), depth + 1)) return false;
+                SkipSpace();
+                if (m_p == m_end) return Fail("unterminated array");
+                if (*m_p == ',') { ++m_p; continue; }
+                if (*m_p == ']') { ++m_p; return true; }
+                return Fail("expected ',' or ']'");
+            }
+        }
+        case '"':
+            v.m_type = JsonValue::Type::String;
+            return ParseString(v.m_string);
+        case 't':
+            v.m_type = JsonValue::Type::Bool;
+            v.m_bool = true;
+            return Literal("true");
+        case 'f':
+            v.m_type = JsonValue::Type::Bool;
+            v.m_bool = false;
+            return Literal("false");
+        case 'n':
+            v.m_type = JsonValue::Type::Null;
+            return Literal("null");
+        default:
+            v.m_type = JsonValue::Type::Number;
+            return ParseNumber(v.m_number);
+        }
+    }
+
+    const char* m_p;
+    const char* m_end;
+};
+
+bool JsonValue::Parse(const char* text, size_t size, JsonValue& out, std::string* error)
+{
+    out = JsonValue{};
+    JsonParser parser(text, size);
+    if (parser.ParseDocument(out))
+        return true;
+    if (error)
+        *error = parser.error + " at offset " + std::to_string(parser.Offset(text));
+    out = JsonValue{};
+    return false;
+}
+
+const JsonValue* JsonValue::Find(const char* key) const
+{
+    if (m_type != Type::Object) return nullptr;
+    for (const auto& [name, value] : m_members)
+        if (name == key) return &value;
+    return nullptr;
+}
+
+double JsonValue::Number(const char* key, double fallback) const
+{
+    const JsonValue* v = Find(key);
+    return v ? v->Number(fallback) : fallback;
+}
+
+int JsonValue::Int(const char* key, int fallback) const
+{
+    const JsonValue* v = Find(key);
+    return v ? v->Int(fallback) : fallback;
+}
+
+std::string JsonValue::String(const char* key, const std::string& fallback) const
+{
+    const JsonValue* v = Find(key);
+    return v && v->IsString() ? v->m_string : fallback;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Small read-only JSON DOM, enough for glTF. Objects keep their members in
+// file order and are searched linearly; numbers are doubles.
+class JsonValue
+{
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    static bool Parse(const char* text, size_t size, JsonValue& out, std::string* error = nullptr);
+
+    Type GetType() const { return m_type; }
+    bool IsNull() const { return m_type == Type::Null; }
+    bool IsNumber() const { return m_type == Type::Number; }
+    bool IsString() const { return m_type == Type::String; }
+    bool IsArray() const { return m_type == Type::Array; }
+    bool IsObject() const { return m_type == Type::Object; }
+
+    // nullptr when this is not an object or has no such member
+    const JsonValue* Find(const char* key) const;
+
+    size_t Size() const { return m_type == Type::Array ? m_items.size() : 0; }
+    const JsonValue& operator[](size_t i) const { return m_items[i]; }
+    const std::vector<std::pair<std::string, JsonValue>>& Members() const { return m_members; }
+
+    double Number(double fallback = 0.0) const { return m_type == Type::Number ? m_number : fallback; }
+    int Int(int fallback = -1) const { return m_type == Type::Number ? int(m_number) : fallback; }
+    bool Bool(bool fallback = false) const { return m_type == Type::Bool ? m_bool : fallback; }
+    const std::string& String() const { return m_string; }
+
+    // member shortcuts with a fallback for missing or mistyped values
+    double Number(const char* key, double fallback) const;
+    int Int(const char* key, int fallback) const;
+    std::string String(const char* key, const std::string& fallback = {}) const;
+
+private:
+    friend class JsonParser;
+
+    Type m_type = Type::Null;
+    bool m_bool = false;
+    double m_number = 0.0;
+    std::string m_string;
+    std::vector<JsonValue> m_items;
+    std::vector<std::pair<std::string, JsonValue>> m_members;
+};
@@ -0,0 +1,113 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        Close();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        other.m_data = nullptr;
+        other.m_size = 0;
+#ifdef _WIN32
+        m_file = other.m_file;
+        m_mapping = other.m_mapping;
+        other.m_file = nullptr;
+        other.m_mapping = nullptr;
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = size_t(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file) CloseHandle(m_file);
+    m_data = nullptr;
+    m_size = 0;
+    m_file = m_mapping = nullptr;
+}
+#else
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = size_t(st.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+#endif
+
+void MappedFile::Prefault(size_t offset, size_t size) const
+{
+    if (offset >= m_size) return;
+    const size_t end = size > m_size - offset ? m_size : offset + size;
+    constexpr size_t kPage = 4096;
+    volatile uint8_t sink = 0;
+    for (size_t i = offset; i < end; i += kPage)
+        sink = sink + m_data[i];
+    sink = sink + m_data[end - 1];
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages come in from the OS file
+// cache on first touch, so readers use the bytes in place instead of
+// copying them into a buffer first. Move-only; the view is closed with it.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+    MappedFile(MappedFile&& other) noexcept { *this = static_cast<MappedFile&&>(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false for a missing, unreadable or empty file
+    bool Open(const std::string& path);
+    void Close();
+
+    const uint8_t* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+    bool IsOpen() const { return m_data != nullptr; }
+
+    // Touches every page of [offset, offset + size) so a later copy does
+    // not stall on the disk; meant for worker threads loading ahead.
+    void Prefault(size_t offset = 0, size_t size = SIZE_MAX) const;
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
@@ -0,0 +1,168 @@
+#include "MemoryLedger.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+MemoryLedger::Handle& MemoryLedger::Handle::operator=(Handle&& o) noexcept
+{
+    if (this != &o) {
+        Reset();
+        m_id = o.m_id;
+        o.m_id = 0;
+    }
+    return *this;
+}
+
+MemoryLedger::Handle::Handle(const Handle& o)
+    : m_id(o.m_id ? MemoryLedger::I().Duplicate(o.m_id) : 0)
+{
+}
+
+MemoryLedger::Handle& MemoryLedger::Handle::operator=(const Handle& o)
+{
+    if (this != &o) {
+        Reset();
+        m_id = o.m_id ? MemoryLedger::I().Duplicate(o.m_id) : 0;
+    }
+    return *this;
+}
+
+void MemoryLedger::Handle::Update(uint64_t cpuBytes, uint64_t gpuBytes)
+{
+    if (m_id) MemoryLedger::I().Update(m_id, cpuBytes, gpuBytes);
+}
+
+void MemoryLedger::Handle::Reset()
+{
+    if (m_id) MemoryLedger::I().Release(m_id);
+    m_id = 0;
+}
+
+MemoryLedger::Handle MemoryLedger::Track(MemoryCategory category, std::string name,
+    uint64_t cpuBytes, uint64_t gpuBytes, bool suballocated)
+{
+    std::lock_guard<std::mutex> lk(mu_);
+    const Id id = nextId_++;
+    Allocation& a = entries_[id];
+    a.id = id;
+    a.category = category;
+    a.name = std::move(name);
+    a.cpuBytes = cpuBytes;
+    a.gpuBytes = gpuBytes;
+    a.suballocated = suballocated;
+    return Handle(id);
+}
+
+void MemoryLedger::Update(Id id, uint64_t cpuBytes, uint64_t gpuBytes)
+{
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = entries_.find(id);
+    if (it == entries_.end()) return;
+    it->second.cpuBytes = cpuBytes;
+    it->second.gpuBytes = gpuBytes;
+}
+
+MemoryLedger::Id MemoryLedger::Duplicate(Id id)
+{
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = entries_.find(id);
+    if (it == entries_.end()) return 0;
+    const Id copy = nextId_++;
+    Allocation a = it->second;
+    a.id = copy;
+    entries_.emplace(copy, std::move(a));
+    return copy;
+}
+
+void MemoryLedger::Release(Id id)
+{
+    std::lock_guard<std::mutex> lk(mu_);
+    entries_.erase(id);
+}
+
+MemoryLedger::Totals MemoryLedger::GetTotals(MemoryCategory category) const
+{
+    std::lock_guard<std::mutex> lk(mu_);
+    Totals t;
+    for (const auto& [id, a] : entries_) {
+        if (a.category != category) continue;
+        t.cpuBytes += a.cpuBytes;
+        if (!a.suballocated) t.gpuBytes += a.gpuBytes;
+        ++t.count;
+    }
+    return t;
+}
+
+MemoryLedger::Totals MemoryLedger::GetTotals() const
+{
+    std::lock_guard<std::mutex> lk(mu_);
+    Totals t;
+    for (const auto& [id, a] : entries_) {
+        t.cpuBytes += a.cpuBytes;
+        if (!a.suballocated) t.gpuBytes += a.gpuBytes;
+        ++t.count;
+    }
+    return t;
+}
+
+std::vector<MemoryLedger::Allocation> MemoryLedger::Snapshot() const
+{
+    std::vector<Allocation> out;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        out.reserve(entries_.size());
+        for (const auto& [id, a] : entries_)
+            out.push_back(a);
+    }
+    std::sort(out.begin(), out.end(), [](const Allocation& a, const Allocation& b) { return a.id < b.id; });
+    return out;
+}
+
+bool MemoryLedger::WriteCSV(const std::string& path) const
+{
+    const auto rows = Snapshot();
+
+    FILE* f = nullptr;
+    if (fopen_s(&f, path.c_str(), "wb") != 0 || !f)
+        return false;
+
+    fprintf(f, "category,name,cpu_bytes,gpu_bytes,suballocated\n");
+    for (const auto& a : rows) {
+        // quote the name, doubling embedded quotes
+        std::string name;
+        name.reserve(a.name.size() + 2);
+        name += '"';
+        for (char c : a.name) {
+            if (c == '"') name += '"';
+            name += c;
+        }
+        name += '"';
+        fprintf(f, "%s,%s,%" PRIu64 ",%" PRIu64 ",%d\n",
+            CategoryName(a.category), name.c_str(), a.cpuBytes, a.gpuBytes, a.suballocated ? 1 : 0);
+    }
+    const bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+const char* MemoryLedger::CategoryName(MemoryCategory category)
+{
+    switch (category) {
+    case MemoryCategory::Mesh: return "Mesh";
+    case MemoryCategory::Texture: return "Texture";
+    case MemoryCategory::RenderTarget: return "RenderTarget";
+    case MemoryCategory::ConstantBuffer: return "ConstantBuffer";
+    case MemoryCategory::GeometryPool: return "GeometryPool";
+    case MemoryCategory::Terrain: return "Terrain";
+    case MemoryCategory::Lighting: return "Lighting";
+    case MemoryCategory::Upload: return "Upload";
+    default: return "Other";
+    }
+}
+
+uint64_t MemoryLedger::ResourceBytes(ID3D12Device* device, const D3D12_RESOURCE_DESC& desc)
+{
+    const D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &desc);
+    // UINT64_MAX signals an invalid description
+    return info.SizeInBytes == UINT64_MAX ? 0 : info.SizeInBytes;
+}
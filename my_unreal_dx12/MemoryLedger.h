@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <d3d12.h>
+
+enum class MemoryCategory : uint8_t
+{
+    Mesh,
+    Texture,
+    RenderTarget,
+    ConstantBuffer,
+    GeometryPool,
+    Terrain,
+    Lighting,
+    Upload,
+    Count
+};
+
+// Central record of what every asset and engine system holds in CPU and GPU
+// memory. Owners keep a Handle next to the memory it describes, update it
+// when the memory changes size and drop it with the memory.
+//
+// Suballocated entries (meshes inside GeometryPool pages) show where a
+// committed resource is spent; their GPU bytes are already counted by the
+// entry owning the resource and are left out of the totals.
+class MemoryLedger
+{
+public:
+    // never destroyed: handles inside other singletons outlive static teardown
+    static MemoryLedger& I() { static MemoryLedger* s = new MemoryLedger; return *s; }
+
+    using Id = uint64_t;
+
+    struct Allocation
+    {
+        Id id = 0;
+        MemoryCategory category = MemoryCategory::Mesh;
+        std::string name;
+        uint64_t cpuBytes = 0;
+        uint64_t gpuBytes = 0;
+        bool suballocated = false;
+    };
+
+    // Releases its entry when destroyed. A copy tracks a new entry with the
+    // same contents, so copied owners are listed separately.
+    class Handle
+    {
+    public:
+        Handle() = default;
+        ~Handle() { Reset(); }
+
+        Handle(Handle&& o) noexcept : m_id(o.m_id) { o.m_id = 0; }
+        Handle& operator=(Handle&& o) noexcept;
+        Handle(const Handle& o);
+        Handle& operator=(const Handle& o);
+
+        void Update(uint64_t cpuBytes, uint64_t gpuBytes);
+        void Reset();
+
+        Id GetId() const { return m_id; }
+        explicit operator bool() const { return m_id != 0; }
+
+    private:
+        friend class MemoryLedger;
+        explicit Handle(Id id) : m_id(id) {}
+        Id m_id = 0;
+    };
+
+    Handle Track(MemoryCategory category, std::string name,
+        uint64_t cpuBytes, uint64_t gpuBytes, bool suballocated = false);
+
+    struct Totals
+    {
+        uint64_t cpuBytes = 0;
+        uint64_t gpuBytes = 0;
+        uint32_t count = 0;
+    };
+    Totals GetTotals(MemoryCategory category) const;
+    Totals GetTotals() const;
+
+    // every live entry, in allocation order
+    std::vector<Allocation> Snapshot() const;
+
+    // category,name,cpu_bytes,gpu_bytes,suballocated; one line per entry
+    bool WriteCSV(const std::string& path) const;
+
+    static const char* CategoryName(MemoryCategory category);
+
+    // what the device reserves for a committed resource of this description
+    static uint64_t ResourceBytes(ID3D12Device* device, const D3D12_RESOURCE_DESC& desc);
+
+    MemoryLedger(const MemoryLedger&) = delete;
+    MemoryLedger& operator=(const MemoryLedger&) = delete;
+
+private:
+    MemoryLedger() = default;
+
+    void Update(Id id, uint64_t cpuBytes, uint64_t gpuBytes);
+    Id Duplicate(Id id);
+    void Release(Id id);
+
+    mutable std::mutex mu_;
+    std::unordered_map<Id, Allocation> entries_;
+    Id nextId_ = 1;
+};
@@ -1,5 +1,7 @@
 ﻿#include "Mesh.h"
 #include "WindowDX12.h"
+#include "Primitives.h"
+#include <cstdio>
 using namespace DirectX;
 
 static inline void NormalizeSafe(XMVECTOR& q) {
@@ -35,293 +37,138 @@ Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& ind
     RecomputeRotationFromAbsoluteEuler();
 }
 
+Mesh::Mesh(std::shared_ptr<MeshAsset> asset) {
+    m_asset = std::move(asset);
+    RecomputeRotationFromAbsoluteEuler();
+}
+
 Mesh::Mesh(const std::string& filename) {
     m_asset = ResourceCache::I().getMeshFromOBJ(filename);
     if (!m_asset->texture) m_asset->texture = ResourceCache::I().defaultWhite();
     RecomputeRotationFromAbsoluteEuler();
 }
 
+// Meshes loaded from the same file or primitive share one asset until one of
+// them modifies it. The copy keeps the geometry block until its next Upload.
+MeshAsset& Mesh::MutableAsset() {
+    if (m_asset->cached || m_asset.use_count() > 1) {
+        m_asset = std::make_shared<MeshAsset>(*m_asset);
+        m_asset->cached = false;
+    }
+    return *m_asset;
+}
+
 void Mesh::SetColor(float r, float g, float b) {
-    for (auto& v : m_asset->vertices) { v.r = r; v.g = g; v.b = b; }
-    m_asset->Upload(nullptr);
+    MeshAsset& asset = MutableAsset();
+    if (!asset.EnsureCpuData()) return;
+    for (auto& v : asset.vertices) { v.r = r; v.g = g; v.b = b; }
+    asset.Upload(nullptr);
+}
+bool Mesh::CopyGeometry(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) const {
+    if (!m_asset) return false;
+    const bool resident = m_asset->HasCpuData();
+    if (!m_asset->EnsureCpuData()) return false;
+    vertices = m_asset->vertices;
+    indices = m_asset->indices;
+    if (!resident && m_asset->residency == CpuResidency::Discard)
+        m_asset->ReleaseCpuData();
+    return true;
 }
+
 std::tuple<float, float, float> Mesh::getColor() const {
-    if (m_asset->vertices.empty()) return { 1.f,1.f,1.f };
-    const auto& v = m_asset->vertices[0];
+    Vertex v;
+    if (!m_asset->ReadVertex(0, v)) return { 1.f,1.f,1.f };
     return { v.r, v.g, v.b };
 }
 
-// for revert triangle winding order (ABC -> ACB) useful for backface culling
-inline static void MakeCW(std::vector<uint32_t>& idx)
+static BVHRay ToLocalRay(const XMMATRIX& invWorld, FXMVECTOR origin, FXMVECTOR dir, float maxDistance) {
+    // the direction keeps the scale of the transform, so t is the same in both spaces
+    BVHRay ray;
+    XMFLOAT3 o, d;
+    XMStoreFloat3(&o, XMVector3TransformCoord(origin, invWorld));
+    XMStoreFloat3(&d, XMVector3TransformNormal(dir, invWorld));
+    ray.origin[0] = o.x; ray.origin[1] = o.y; ray.origin[2] = o.z;
+    ray.dir[0] = d.x; ray.dir[1] = d.y; ray.dir[2] = d.z;
+    ray.tMax = maxDistance;
+    return ray;
+}
+
+bool Mesh::Raycast(FXMVECTOR origin, FXMVECTOR dir, float maxDistance, MeshRayHit& hit) const {
+    if (!m_asset) return false;
+
+    const XMMATRIX invWorld = XMMatrixInverse(nullptr, m_transform);
+    BVHHit h;
+    if (!m_asset->BVH().Intersect(ToLocalRay(invWorld, origin, dir, maxDistance), h))
+        return false;
+
+    const XMVECTOR n = XMVectorSet(h.normal[0], h.normal[1], h.normal[2], 0.f);
+    hit.distance = h.t;
+    hit.triangle = h.triangle;
+    XMStoreFloat3(&hit.position, XMVectorMultiplyAdd(dir, XMVectorReplicate(h.t), origin));
+    XMStoreFloat3(&hit.normal, XMVector3Normalize(XMVector3TransformNormal(n, XMMatrixTranspose(invWorld))));
+    return true;
+}
+
+bool Mesh::Occludes(FXMVECTOR from, FXMVECTOR to) const {
+    if (!m_asset) return false;
+
+    const XMMATRIX invWorld = XMMatrixInverse(nullptr, m_transform);
+    return m_asset->BVH().Occluded(ToLocalRay(invWorld, from, XMVectorSubtract(to, from), 1.f));
+}
+
+static std::string PrimitiveKey(const char* kind, std::initializer_list<float> params)
 {
-    for (size_t i = 0; i + 2 < idx.size(); i += 3)
-        std::swap(idx[i + 1], idx[i + 2]);
+    std::string key = kind;
+    char buf[32];
+    for (float p : params) {
+        snprintf(buf, sizeof(buf), "|%a", p);
+        key += buf;
+    }
+    return key;
 }
 
 Mesh Mesh::CreatePlane(float width, float depth, uint32_t m, uint32_t n)
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
-    vertices.resize(m * n);
-    for (uint32_t i = 0; i < m; ++i) {
-        float x = -0.5f * width + i * (width / (m - 1));
-        for (uint32_t j = 0; j < n; ++j) {
-            float z = -0.5f * depth + j * (depth / (n - 1));
-            Vertex& v = vertices[i * n + j];
-            v.px = x;
-            v.py = 0.0f;
-            v.pz = z;
-            v.nx = 0.0f;
-            v.ny = 1.0f;
-            v.nz = 0.0f;
-            v.r = 1.0f;
-            v.g = 1.0f;
-            v.b = 1.0f;
-            v.u = static_cast<float>(i) / (m - 1);
-            v.v = static_cast<float>(j) / (n - 1);
-        }
-    }
-    for (uint32_t i = 0; i < m - 1; ++i) {
-        for (uint32_t j = 0; j < n - 1; ++j) {
-            indices.push_back(i * n + j);
-            indices.push_back((i + 1) * n + (j + 1));
-            indices.push_back((i + 1) * n + j);
-            indices.push_back(i * n + j);
-            indices.push_back(i * n + (j + 1));
-            indices.push_back((i + 1) * n + (j + 1));
-        }
-    }
-	return Mesh(vertices, indices);
+    return Mesh(ResourceCache::I().getPrimitive(PrimitiveKey("plane", { width, depth, float(m), float(n) }),
+        [&](MeshData& d) { Primitives::Plane(d, width, depth, m, n); }));
 }
 
 Mesh Mesh::CreateCube(float size)
 {
-    const float s = size * 0.5f;
-
-    std::vector<Vertex> vertices = {
-        { -s, -s,  s,  0, 0, 1,  1, 1, 1,  0, 0 },
-        {  s, -s,  s,  0, 0, 1,  1, 1, 1,  1, 0 },
-        {  s,  s,  s,  0, 0, 1,  1, 1, 1,  1, 1 },
-        { -s,  s,  s,  0, 0, 1,  1, 1, 1,  0, 1 },
-
-        {  s, -s, -s,  0, 0,-1,  1, 1, 1,  0, 0 },
-        { -s, -s, -s,  0, 0,-1,  1, 1, 1,  1, 0 },
-        { -s,  s, -s,  0, 0,-1,  1, 1, 1,  1, 1 },
-        {  s,  s, -s,  0, 0,-1,  1, 1, 1,  0, 1 },
-
-        { -s,  s,  s,  0, 1, 0,  1, 1, 1,  0, 0 },
-        {  s,  s,  s,  0, 1, 0,  1, 1, 1,  1, 0 },
-        {  s,  s, -s,  0, 1, 0,  1, 1, 1,  1, 1 },
-        { -s,  s, -s,  0, 1, 0,  1, 1, 1,  0, 1 },
-
-        { -s, -s, -s,  0,-1, 0,  1, 1, 1,  0, 0 },
-        {  s, -s, -s,  0,-1, 0,  1, 1, 1,  1, 0 },
-        {  s, -s,  s,  0,-1, 0,  1, 1, 1,  1, 1 },
-        { -s, -s,  s,  0,-1, 0,  1, 1, 1,  0, 1 },
-
-        {  s, -s,  s,  1, 0, 0,  1, 1, 1,  0, 0 },
-        {  s, -s, -s,  1, 0, 0,  1, 1, 1,  1, 0 },
-        {  s,  s, -s,  1, 0, 0,  1, 1, 1,  1, 1 },
-        {  s,  s,  s,  1, 0, 0,  1, 1, 1,  0, 1 },
-
-        { -s, -s, -s, -1, 0, 0,  1, 1, 1,  0, 0 },
-        { -s, -s,  s, -1, 0, 0,  1, 1, 1,  1, 0 },
-        { -s,  s,  s, -1, 0, 0,  1, 1, 1,  1, 1 },
-        { -s,  s, -s, -1, 0, 0,  1, 1, 1,  0, 1 },
-    };
-
-    std::vector<uint32_t> indices;
-    for (uint32_t f = 0; f < 6; ++f) {
-        uint32_t i = f * 4;
-        indices.push_back(i + 0);
-        indices.push_back(i + 1);
-        indices.push_back(i + 2);
-        indices.push_back(i + 0);
-        indices.push_back(i + 2);
-        indices.push_back(i + 3);
-    }
-
-    return Mesh(vertices, indices);
+    return Mesh(ResourceCache::I().getPrimitive(PrimitiveKey("cube", { size }),
+        [&](MeshData& d) { Primitives::Cube(d, size); }));
 }
 
 Mesh Mesh::CreateSphere(float diameter, uint16_t slices, uint16_t stacks)
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
-    float r = diameter * 0.5f;
-
-    for (uint32_t i = 0; i <= stacks; ++i) {
-        float phi = M_PI * i / stacks;
-        for (uint32_t j = 0; j <= slices; ++j) {
-            float theta = 2 * M_PI * j / slices;
-            float x = sinf(phi) * cosf(theta);
-            float y = cosf(phi);
-            float z = sinf(phi) * sinf(theta);
-            vertices.push_back({ x * r, y * r, z * r, x, y, z, 1, 1, 1, (float)j / slices, (float)i / stacks });
-        }
-    }
-
-    for (uint32_t i = 0; i < stacks; ++i) {
-        for (uint32_t j = 0; j < slices; ++j) {
-            uint32_t a = i * (slices + 1) + j;
-            uint32_t b = a + slices + 1;
-            indices.push_back(a);
-            indices.push_back(b);
-            indices.push_back(a + 1);
-            indices.push_back(a + 1);
-            indices.push_back(b);
-            indices.push_back(b + 1);
-        }
-    }
-    MakeCW(indices);
+    return Mesh(ResourceCache::I().getPrimitive(PrimitiveKey("sphere", { diameter, float(slices), float(stacks) }),
+        [&](MeshData& d) { Primitives::Sphere(d, diameter, slices, stacks); }));
+}
 
-    return Mesh(vertices, indices);
+Mesh Mesh::CreateIcosphere(float diameter, uint32_t subdivisions)
+{
+    return Mesh(ResourceCache::I().getPrimitive(PrimitiveKey("icosphere", { diameter, float(subdivisions) }),
+        [&](MeshData& d) { Primitives::Icosphere(d, diameter, subdivisions); }));
 }
 
 Mesh Mesh::CreateCylinder(float radius, float height, uint32_t slices, bool withCaps)
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
-
-    const float h = height * 0.5f;
-    const float invS = 1.0f / slices;
-
-    for (uint32_t i = 0; i <= slices; ++i) {
-        float t = i * invS;
-        float th = 2.0f * float(M_PI) * t;
-        float x = std::cos(th), z = std::sin(th);
-
-        Vertex vb{ radius * x, -h, radius * z,  x, 0, z,  1,1,1,  t, 0.0f };
-        Vertex vt{ radius * x,  h, radius * z,  x, 0, z,  1,1,1,  t, 1.0f };
-        vertices.push_back(vb);
-        vertices.push_back(vt);
-    }
-
-    for (uint32_t i = 0; i < slices; ++i) {
-        uint32_t bi = 2 * i;
-        uint32_t ti = 2 * i + 1;
-        uint32_t bn = 2 * (i + 1);
-        uint32_t tn = 2 * (i + 1) + 1;
-        
-        indices.push_back(bi); indices.push_back(ti); indices.push_back(tn);
-        indices.push_back(bi); indices.push_back(tn); indices.push_back(bn);
-    }
-
-    if (withCaps) {
-        uint32_t baseCenter = (uint32_t)vertices.size();
-        vertices.push_back({0,-h,0,0,-1,0,1,1,1,0.5f,0.5f});
-
-        uint32_t baseStart = (uint32_t)vertices.size();
-        for (uint32_t i = 0; i <= slices; ++i) {
-            float t = i * invS;
-            float th = 2.0f * float(M_PI) * t;
-            float x = std::cos(th), z = std::sin(th);
-            vertices.push_back({ radius * x, -h, radius * z,  0,-1,0,  1,1,1,  0.5f * (x + 1), 0.5f * (z + 1) });
-        }
-        for (uint32_t i = 0; i < slices; ++i) {
-            indices.push_back(baseCenter);
-            indices.push_back(baseStart + i);
-            indices.push_back(baseStart + i + 1);
-        }
-
-        uint32_t topCenter = (uint32_t)vertices.size();
-        vertices.push_back({0,h,0,0,1,0,1,1,1,0.5f,0.5f});
-
-        uint32_t topStart = (uint32_t)vertices.size();
-        for (uint32_t i = 0; i <= slices; ++i) {
-            float t = i * invS;
-            float th = 2.0f * float(M_PI) * t;
-            float x = std::cos(th), z = std::sin(th);
-            vertices.push_back({ radius * x,  h, radius * z,  0, 1,0,  1,1,1,  0.5f * (x + 1), 0.5f * (z + 1) });
-        }
-        for (uint32_t i = 0; i < slices; ++i) {
-            indices.push_back(topCenter);
-            indices.push_back(topStart + i + 1);
-            indices.push_back(topStart + i);
-        }
-    }
-
-    return Mesh(vertices, indices);
+    return Mesh(ResourceCache::I().getPrimitive(PrimitiveKey("cylinder", { radius, height, float(slices), withCaps ? 1.f : 0.f }),
+        [&](MeshData& d) { Primitives::Cylinder(d, radius, height, slices, withCaps); }));
 }
 
 Mesh Mesh::CreateCone(float radius, float height, uint32_t slices, bool withBase)
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
-
-    const float h = height * 0.5f;
-    const float invSlices = 1.0f / slices;
-
-    const float denom = std::sqrt(radius * radius + height * height);
-    const float ny_side = radius / denom;
-    const float k_rad = height / denom;
-
-    for (uint32_t i = 0; i <= slices; ++i) {
-        float t = i * invSlices;
-        float theta = 2.0f * float(M_PI) * t;
-        float x = std::cos(theta);
-        float z = std::sin(theta);
-        
-        float nx = x * k_rad;
-        float nz = z * k_rad;
-
-        vertices.push_back({
-            radius * x, -h, radius * z,
-            nx, ny_side, nz,
-            1,1,1,
-            t, 0.0f
-        });
-
-        vertices.push_back({
-            0.0f, +h, 0.0f,
-            nx, ny_side, nz,
-            1,1,1,
-            t, 1.0f
-        });
-    }
-
-    for (uint32_t i = 0; i < slices; ++i) {
-        uint32_t bottom_i = 2 * i;
-        uint32_t apex_i = 2 * i + 1;
-        uint32_t bottom_n = 2 * (i + 1);
-        indices.push_back(apex_i);
-        indices.push_back(bottom_i);
-        indices.push_back(bottom_n);
-    }
-
-    if (withBase) {
-        uint32_t baseCenter = (uint32_t)vertices.size();
-        vertices.push_back({
-            0.0f, -h, 0.0f,
-            0.0f,-1.0f,0.0f,
-            1,1,1,
-            0.5f, 0.5f
-         });
-
-        uint32_t baseStart = (uint32_t)vertices.size();
-        for (uint32_t i = 0; i <= slices; ++i) {
-            float t = i * invSlices;
-            float theta = 2.0f * float(M_PI) * t;
-            float x = std::cos(theta);
-            float z = std::sin(theta);
-            vertices.push_back({
-                radius * x, -h, radius * z,
-                0.0f,-1.0f,0.0f,
-                1,1,1,
-                0.5f * (x + 1.0f), 0.5f * (z + 1.0f)
-            });
-        }
-
-        for (uint32_t i = 0; i < slices; ++i) {
-            indices.push_back(baseCenter);
-            indices.push_back(baseStart + i + 1);
-            indices.push_back(baseStart + i);
-        }
-    }
+    return Mesh(ResourceCache::I().getPrimitive(PrimitiveKey("cone", { radius, height, float(slices), withBase ? 1.f : 0.f }),
+        [&](MeshData& d) { Primitives::Cone(d, radius, height, slices, withBase); }));
+}
 
-	MakeCW(indices);
-    return Mesh(vertices, indices);
+Mesh Mesh::CreateGridPatch(uint32_t dim)
+{
+    return Mesh(ResourceCache::I().getPrimitive(PrimitiveKey("gridpatch", { float(dim) }),
+        [&](MeshData& d) { Primitives::GridPatch(d, dim); }));
 }
+
 void Mesh::SetPosition(float x, float y, float z) {
     m_position = XMVectorSet(x, y, z, 0.0f);
     UpdateMatrix();
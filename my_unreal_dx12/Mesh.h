@@ -8,10 +8,18 @@
 
 constexpr auto M_PI = 3.14159265358979323846f;
 
+struct MeshRayHit {
+    float distance = 0.f;           // along the world ray, in units of its direction
+    DirectX::XMFLOAT3 position{};   // world space
+    DirectX::XMFLOAT3 normal{};     // world space face normal
+    uint32_t triangle = 0;
+};
+
 class Mesh {
 public:
     Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
     Mesh(const std::string& filename);
+    explicit Mesh(std::shared_ptr<MeshAsset> asset);
 
     Mesh(const Mesh&) = default;
     Mesh& operator=(const Mesh&) = default;
@@ -21,8 +29,11 @@ public:
 	static Mesh CreatePlane(float width, float depth, uint32_t m = 2, uint32_t n = 2);
 	static Mesh CreateCube(float size = 1);
 	static Mesh CreateSphere(float diameter = 1, uint16_t sliceCount = 16, uint16_t stackCount = 16);
+	static Mesh CreateIcosphere(float diameter = 1, uint32_t subdivisions = 3);
     static Mesh CreateCylinder(float radius = 1, float height = 1, uint32_t slices = 16, bool withCaps = true);
 	static Mesh CreateCone(    float radius = 1, float height = 1, uint32_t slices = 32, bool withBase = true);
+    // unit terrain patch, see Primitives::GridPatch
+    static Mesh CreateGridPatch(uint32_t dim);
 
     void SetPosition(float x, float y, float z);
 	void SetPositionX(float x);
@@ -55,7 +66,7 @@ public:
 
     const DirectX::XMMATRIX& Transform() const { return m_transform; }
 
-    void SetTexture(std::shared_ptr<Texture> t) { if (m_asset) m_asset->texture = std::move(t); }
+    void SetTexture(std::shared_ptr<Texture> t) { if (m_asset) MutableAsset().texture = std::move(t); }
     Texture* GetTexture() const {
         if (!m_asset) return nullptr;
         auto t = m_asset->texture ? m_asset->texture : ResourceCache::I().defaultWhite();
@@ -69,11 +80,27 @@ public:
     void SetColor(float r, float g, float b);
     std::tuple<float, float, float> getColor() const;
 
+    // Object index of the mesh in the PotentiallyVisibleSet given to the
+    // window; meshes without one are always drawn.
+    void SetVisibilityIndex(uint32_t index) { m_visibilityIndex = index; }
+    uint32_t VisibilityIndex() const { return m_visibilityIndex; }
+
     void BindTexture(ID3D12GraphicsCommandList* cmdList, UINT rootParamIndex) const;
 
+    // World space queries against the triangles of the asset (its BVH is
+    // built on first use). dir need not be normalized.
+    bool Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDistance, MeshRayHit& hit) const;
+    bool Occludes(DirectX::FXMVECTOR from, DirectX::FXMVECTOR to) const;
+
+    // Local space copy of the asset's triangles for offline bakes, fetched
+    // back if the asset discarded them.
+    bool CopyGeometry(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) const;
+
     const D3D12_VERTEX_BUFFER_VIEW& VBV() const { return m_asset->vbv; }
     const D3D12_INDEX_BUFFER_VIEW& IBV() const { return m_asset->ibv; }
     UINT IndexCount() const { return m_asset->indexCount; }
+    UINT BaseVertex() const { return m_asset->baseVertex; }
+    UINT StartIndex() const { return m_asset->startIndex; }
 
 	void setShininess(float s) {
         if (s < 16.f) {
@@ -82,7 +109,7 @@ public:
 		else if (s > 256.f) {
             std::cout << "[Warning]: shininess too high, Object may appear too shiny." << std::endl;
 		}
-        for (auto & sm : m_asset->submeshes) {
+        for (auto & sm : MutableAsset().submeshes) {
             sm.shininess = s;
 		}
     }
@@ -90,6 +117,7 @@ public:
 
 private:
     void UpdateMatrix();
+    MeshAsset& MutableAsset();
     std::shared_ptr<MeshAsset> m_asset;
 
     DirectX::XMVECTOR m_position{ DirectX::XMVectorZero() };
@@ -102,5 +130,7 @@ private:
     float m_pitchDeg = 0.f;
     float m_rollDeg = 0.f;
 
+    uint32_t m_visibilityIndex = ~0u;
+
     void RecomputeRotationFromAbsoluteEuler();
 };
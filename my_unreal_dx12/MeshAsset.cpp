@@ -1,46 +1,147 @@
 #include "MeshAsset.h"
+#include "CookedMesh.h"
 #include "WindowDX12.h"
 #include "Utils.h"
 
+void MeshAsset::SetGeometry(std::shared_ptr<GeometryBlock> block) {
+    geometry = std::move(block);
+
+    if (geometry) {
+        vbv = geometry->VBV();
+        ibv = geometry->IBV();
+        baseVertex = geometry->BaseVertex();
+        startIndex = geometry->StartIndex();
+        vertexCount = geometry->VertexCount();
+        indexCount = geometry->IndexCount();
+    }
+    else {
+        vbv = {};
+        ibv = {};
+        baseVertex = 0;
+        startIndex = 0;
+        vertexCount = 0;
+        indexCount = 0;
+    }
+}
+
+void MeshAsset::UpdateLedger() {
+    uint64_t cpu = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(uint32_t);
+    if (bvh) cpu += bvh->MemoryBytes();
+    const uint64_t gpu = geometry ?
+        uint64_t(vertexCount) * sizeof(Vertex) + uint64_t(indexCount) * sizeof(uint32_t) : 0;
+
+    if (m_ledger)
+        m_ledger.Update(cpu, gpu);
+    else
+        m_ledger = MemoryLedger::I().Track(MemoryCategory::Mesh, name.empty() ? "mesh" : name, cpu, gpu, true);
+}
+
 void MeshAsset::Upload(ID3D12Device* device) {
     if (!device) device = WindowDX12::Get().GetDevice();
 
-    const UINT vbBytes = UINT(vertices.size() * sizeof(Vertex));
-    const UINT ibBytes = UINT(indices.size() * sizeof(uint32_t));
-
-    auto makeBuf = [&](Microsoft::WRL::ComPtr<ID3D12Resource>& res, UINT bytes) {
-        if (res && res->GetDesc().Width >= bytes) return;
-        D3D12_HEAP_PROPERTIES hp{}; hp.Type = D3D12_HEAP_TYPE_UPLOAD;
-        D3D12_RESOURCE_DESC rd{}; rd.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        rd.Width = bytes ? bytes : 1; rd.Height = 1; rd.DepthOrArraySize = 1;
-        rd.MipLevels = 1; rd.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR; rd.SampleDesc = { 1,0 };
-        DXThrow(device->CreateCommittedResource(&hp, D3D12_HEAP_FLAG_NONE, &rd,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&res)));
-        };
-
-    makeBuf(vb, vbBytes);
-    makeBuf(ib, ibBytes);
-
-    if (vbBytes) {
-        void* p = nullptr; D3D12_RANGE r{ 0,0 };
-        vb->Map(0, &r, &p);
-        memcpy(p, vertices.data(), vbBytes);
-        D3D12_RANGE w{ 0, vbBytes }; vb->Unmap(0, &w);
+    // discarded and not re-fetched: the pool still holds the geometry
+    if (vertices.empty() && indices.empty() && geometry && residency == CpuResidency::Discard)
+        return;
+
+    const uint32_t vCount = uint32_t(vertices.size());
+    const uint32_t iCount = uint32_t(indices.size());
+
+    // a block still shared with the asset this one was copied from is never written
+    if (!geometry || geometry.use_count() > 1 ||
+        geometry->VertexCount() != vCount || geometry->IndexCount() != iCount)
+        SetGeometry(GeometryPool::I().Allocate(device, vCount, iCount));
+
+    if (geometry) {
+        if (vCount) memcpy(geometry->Vertices(), vertices.data(), vCount * sizeof(Vertex));
+        if (iCount) memcpy(geometry->Indices(), indices.data(), iCount * sizeof(uint32_t));
+    }
+
+    cookedPath.clear();
+    contentHash = {};
+    bvh.reset();
+    if (residency == CpuResidency::Discard)
+        ReleaseCpuData();
+    UpdateLedger();
+}
+
+void MeshAsset::AdoptGeometry(std::shared_ptr<GeometryBlock> block, const Hash128& hash) {
+    SetGeometry(std::move(block));
+    cookedPath.clear();
+    contentHash = hash;
+    bvh.reset();
+    if (residency == CpuResidency::Discard)
+        ReleaseCpuData();
+    UpdateLedger();
+}
+
+bool MeshAsset::UploadCooked(ID3D12Device* device, const CookedMesh& file) {
+    if (!device) device = WindowDX12::Get().GetDevice();
+
+    auto block = GeometryPool::I().Allocate(device, file.VertexCount(), file.IndexCount());
+    if (block) {
+        if (block->VertexCount() && !file.DecodeVertices(block->Vertices())) return false;
+        if (block->IndexCount() && !file.DecodeIndices(block->Indices())) return false;
     }
-    if (ibBytes) {
-        void* p = nullptr; D3D12_RANGE r{ 0,0 };
-        ib->Map(0, &r, &p);
-        memcpy(p, indices.data(), ibBytes);
-        D3D12_RANGE w{ 0, ibBytes }; ib->Unmap(0, &w);
+
+    SetGeometry(std::move(block));
+    cookedPath = file.Path();
+    contentHash = file.ContentHash();
+    bvh.reset();
+    ReleaseCpuData();
+    if (residency == CpuResidency::Keep && geometry) {
+        vertices.assign(geometry->Vertices(), geometry->Vertices() + vertexCount);
+        indices.assign(geometry->Indices(), geometry->Indices() + indexCount);
     }
+    UpdateLedger();
+    return true;
+}
 
-    vbv.BufferLocation = vb->GetGPUVirtualAddress();
-    vbv.StrideInBytes = sizeof(Vertex);
-    vbv.SizeInBytes = vbBytes;
+void MeshAsset::ReleaseCpuData() {
+    std::vector<Vertex>().swap(vertices);
+    std::vector<uint32_t>().swap(indices);
+    if (m_ledger) UpdateLedger();
+}
 
-    ibv.BufferLocation = ib->GetGPUVirtualAddress();
-    ibv.Format = DXGI_FORMAT_R32_UINT;
-    ibv.SizeInBytes = ibBytes;
+bool MeshAsset::EnsureCpuData() {
+    if (HasCpuData()) return true;
 
-    indexCount = UINT(indices.size());
-}
\ No newline at end of file
+    if (!cookedPath.empty()) {
+        MeshData data;
+        if (CookedMesh::Load(cookedPath, data) &&
+            data.vertices.size() == vertexCount && data.indices.size() == indexCount) {
+            vertices = std::move(data.vertices);
+            indices = std::move(data.indices);
+            UpdateLedger();
+            return true;
+        }
+        cookedPath.clear();
+    }
+
+    if (!geometry) return false;
+
+    // upload heap memory stays mapped and is the current GPU copy
+    vertices.assign(geometry->Vertices(), geometry->Vertices() + vertexCount);
+    indices.assign(geometry->Indices(), geometry->Indices() + indexCount);
+    UpdateLedger();
+    return true;
+}
+
+bool MeshAsset::ReadVertex(uint32_t i, Vertex& out) const {
+    if (i >= vertexCount) return false;
+    out = HasCpuData() ? vertices[i] : geometry->Vertices()[i];
+    return true;
+}
+
+const MeshBVH& MeshAsset::BVH() {
+    if (!bvh) {
+        const bool resident = HasCpuData();
+        auto built = std::make_shared<MeshBVH>();
+        if (EnsureCpuData())
+            built->Build(vertices.data(), indices.data(), indices.size());
+        if (!resident && residency == CpuResidency::Discard)
+            ReleaseCpuData();
+        bvh = std::move(built);
+        UpdateLedger();
+    }
+    return *bvh;
+}
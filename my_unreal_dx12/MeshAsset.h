@@ -1,19 +1,17 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <string>
 #include <wrl.h>
 #include <d3d12.h>
 #include <DirectXMath.h>
 #include "Texture.h"
+#include "GeometryPool.h"
+#include "MeshData.h"
+#include "MeshBVH.h"
+#include "MemoryLedger.h"
 
-struct Vertex {
-    float px, py, pz;
-    float nx, ny, nz;
-    float r, g, b;
-    float u, v;
-    float tx, ty, tz;
-    float bx, by, bz;
-};
+class CookedMesh;
 
 struct Submesh
 {
@@ -32,6 +30,26 @@ struct Submesh
 
     std::shared_ptr<Texture> metalRoughMap;
     bool hasMetalRoughMap = false;
+
+    // where a map packed by the TextureAtlas sits on its page, the texture
+    // above: scale xy, offset zw; zero scale for a texture of its own
+    DirectX::XMFLOAT4 textureRect{};
+    DirectX::XMFLOAT4 normalRect{};
+    DirectX::XMFLOAT4 metalRoughRect{};
+    // the slice of each map's texture when it is a TextureArrayPool array
+    uint32_t textureSlice = 0;
+    uint32_t normalSlice = 0;
+    uint32_t metalRoughSlice = 0;
+
+    // object space, for texture streaming; see SubmeshDesc
+    float bounds[4]{};
+    float uvDensity = 0.f;
+};
+
+enum class CpuResidency
+{
+    Keep,       // vertices/indices stay in memory after Upload
+    Discard     // freed after Upload, re-fetched on demand by EnsureCpuData
 };
 
 class MeshAsset
@@ -42,11 +60,28 @@ public:
 
     float shininess = 128.f;
 
-    Microsoft::WRL::ComPtr<ID3D12Resource> vb, ib;
+    std::shared_ptr<GeometryBlock> geometry;
     D3D12_VERTEX_BUFFER_VIEW vbv{};
     D3D12_INDEX_BUFFER_VIEW ibv{};
+    UINT baseVertex = 0;
+    UINT startIndex = 0;
+    UINT vertexCount = 0;
     UINT indexCount = 0;
 
+    // source path or primitive key, labels the asset in the MemoryLedger
+    std::string name;
+
+    CpuResidency residency = CpuResidency::Keep;
+    // handed out by ResourceCache, copied before a Mesh modifies it
+    bool cached = false;
+    // cooked file holding the current GPU contents, cleared by Upload
+    std::string cookedPath;
+    // HashGeometry of the GPU contents when known, zero otherwise
+    Hash128 contentHash;
+
+    // built on the first spatial query, dropped by Upload
+    std::shared_ptr<const MeshBVH> bvh;
+
     std::shared_ptr<Texture> texture;
 
     std::vector<Submesh> submeshes;
@@ -54,4 +89,27 @@ public:
 	void setShininess(float s) { shininess = s; }
 
     void Upload(ID3D12Device* device);
+    // Decodes the streams of an opened cooked file straight into pool memory,
+    // the CPU arrays are never filled.
+    bool UploadCooked(ID3D12Device* device, const CookedMesh& file);
+    // Upload without the copy: block already holds this asset's vertices and
+    // indices (ResourceCache content dedup). Materials stay per asset.
+    void AdoptGeometry(std::shared_ptr<GeometryBlock> block, const Hash128& hash);
+
+    bool HasCpuData() const { return vertices.size() == vertexCount && indices.size() == indexCount; }
+    // Restores vertices/indices after a discard, from cookedPath when it is
+    // still current, otherwise by reading back the mapped pool memory.
+    bool EnsureCpuData();
+    void ReleaseCpuData();
+
+    bool ReadVertex(uint32_t i, Vertex& out) const;
+
+    const MeshBVH& BVH();
+
+private:
+    void SetGeometry(std::shared_ptr<GeometryBlock> block);
+    // CPU arrays + BVH, and the pool memory of the block (suballocated)
+    void UpdateLedger();
+
+    MemoryLedger::Handle m_ledger;
 };
\ No newline at end of file
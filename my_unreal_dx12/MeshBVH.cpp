@@ -0,0 +1,489 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "MeshBVH.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MESH_BVH_SSE2 1
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t kMaxDepth = 64;
+    constexpr uint32_t kParallelThreshold = 8192;
+    // relative to one triangle test; leaves are tested several triangles at
+    // a time so a node visit costs about as much as two of them
+    constexpr float kTraversalCost = 2.f;
+    constexpr float kMiss = FLT_MAX;
+
+    struct AABB
+    {
+        float mn[3]{ FLT_MAX, FLT_MAX, FLT_MAX };
+        float mx[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        void Grow(const float p[3]) {
+            for (int a = 0; a < 3; ++a) { mn[a] = std::min(mn[a], p[a]); mx[a] = std::max(mx[a], p[a]); }
+        }
+        void Grow(const AABB& b) {
+            for (int a = 0; a < 3; ++a) { mn[a] = std::min(mn[a], b.mn[a]); mx[a] = std::max(mx[a], b.mx[a]); }
+        }
+        float Area() const {
+            const float ex = mx[0] - mn[0], ey = mx[1] - mn[1], ez = mx[2] - mn[2];
+            if (ex < 0.f) return 0.f;
+            return ex * ey + ey * ez + ez * ex;
+        }
+    };
+
+    inline int LowestBit(int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long i;
+        _BitScanForward(&i, static_cast<unsigned long>(mask));
+        return int(i);
+#else
+        return __builtin_ctz(unsigned(mask));
+#endif
+    }
+
+    struct TriRef
+    {
+        AABB box;
+        float c[3];
+    };
+
+    struct Builder
+    {
+        const std::vector<TriRef>& refs;
+        std::vector<uint32_t>& ids;
+        std::vector<BVHNode>& nodes;
+        std::atomic<uint32_t> used{ 1 };
+
+        uint32_t BinOf(const TriRef& r, int axis, float mn, float scale) const {
+            const float f = (r.c[axis] - mn) * scale;
+            return std::min(MeshBVH::kBins - 1, uint32_t(std::max(f, 0.f)));
+        }
+
+        void Subdivide(uint32_t nodeIdx, uint32_t depth)
+        {
+            BVHNode& node = nodes[nodeIdx];
+            const uint32_t first = node.leftFirst;
+            const uint32_t count = node.triCount;
+
+            AABB bounds, centroids;
+            for (uint32_t i = first; i < first + count; ++i) {
+                const TriRef& r = refs[ids[i]];
+                bounds.Grow(r.box);
+                centroids.Grow(r.c);
+            }
+            for (int a = 0; a < 3; ++a) { node.bmin[a] = bounds.mn[a]; node.bmax[a] = bounds.mx[a]; }
+
+            if (count <= 1 || depth + 1 >= kMaxDepth) return;
+
+            struct Bin { AABB box; uint32_t count = 0; };
+
+            float bestCost = FLT_MAX;
+            int bestAxis = -1;
+            uint32_t bestSplit = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                const float extent = centroids.mx[axis] - centroids.mn[axis];
+                if (extent <= 0.f) continue;
+                const float scale = float(MeshBVH::kBins) / extent;
+
+                Bin bins[MeshBVH::kBins];
+                for (uint32_t i = first; i < first + count; ++i) {
+                    const TriRef& r = refs[ids[i]];
+                    Bin& b = bins[BinOf(r, axis, centroids.mn[axis], scale)];
+                    b.box.Grow(r.box);
+                    ++b.count;
+                }
+
+                float leftArea[MeshBVH::kBins - 1];
+                uint32_t leftCount[MeshBVH::kBins - 1];
+                AABB acc;
+                uint32_t n = 0;
+                for (uint32_t s = 0; s + 1 < MeshBVH::kBins; ++s) {
+                    acc.Grow(bins[s].box);
+                    n += bins[s].count;
+                    leftArea[s] = acc.Area();
+                    leftCount[s] = n;
+                }
+                acc = AABB{};
+                n = 0;
+                for (uint32_t s = MeshBVH::kBins - 1; s > 0; --s) {
+                    acc.Grow(bins[s].box);
+                    n += bins[s].count;
+                    if (n == 0 || leftCount[s - 1] == 0) continue;
+                    const float cost = leftCount[s - 1] * leftArea[s - 1] + n * acc.Area();
+                    if (cost < bestCost) { bestCost = cost; bestAxis = axis; bestSplit = s; }
+                }
+            }
+
+            if (bestAxis < 0) return;
+            const float leafCost = float(count) * bounds.Area();
+            const float splitCost = kTraversalCost * bounds.Area() + bestCost;
+            if (splitCost >= leafCost && count <= MeshBVH::kMaxLeafTriangles) return;
+
+            const float mn = centroids.mn[bestAxis];
+            const float scale = float(MeshBVH::kBins) / (centroids.mx[bestAxis] - mn);
+            auto mid = std::partition(ids.begin() + first, ids.begin() + first + count,
+                [&](uint32_t id) { return BinOf(refs[id], bestAxis, mn, scale) < bestSplit; });
+            const uint32_t leftTris = uint32_t(mid - (ids.begin() + first));
+            if (leftTris == 0 || leftTris == count) return;
+
+            const uint32_t children = used.fetch_add(2, std::memory_order_relaxed);
+            nodes[children].leftFirst = first;
+            nodes[children].triCount = leftTris;
+            nodes[children + 1].leftFirst = first + leftTris;
+            nodes[children + 1].triCount = count - leftTris;
+            node.leftFirst = children;
+            node.triCount = 0;
+
+            if (count >= kParallelThreshold) {
+                JobCounter counter;
+                JobSystem::I().Run(counter, [this, children, depth] { Subdivide(children, depth + 1); });
+                Subdivide(children + 1, depth + 1);
+                JobSystem::I().Wait(counter);
+            }
+            else {
+                Subdivide(children, depth + 1);
+                Subdivide(children + 1, depth + 1);
+            }
+        }
+    };
+
+#if MESH_BVH_SSE2
+    struct F4
+    {
+        __m128 v;
+        static constexpr uint32_t W = 4;
+        static F4 Load(const float* p) { return { _mm_loadu_ps(p) }; }
+        static F4 Set1(float f) { return { _mm_set1_ps(f) }; }
+        static F4 Lanes() { return { _mm_setr_ps(0.f, 1.f, 2.f, 3.f) }; }
+        void Store(float* p) const { _mm_storeu_ps(p, v); }
+        int Mask() const { return _mm_movemask_ps(v); }
+    };
+    inline F4 operator+(F4 a, F4 b) { return { _mm_add_ps(a.v, b.v) }; }
+    inline F4 operator-(F4 a, F4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+    inline F4 operator*(F4 a, F4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+    inline F4 operator/(F4 a, F4 b) { return { _mm_div_ps(a.v, b.v) }; }
+    inline F4 operator&(F4 a, F4 b) { return { _mm_and_ps(a.v, b.v) }; }
+    inline F4 operator|(F4 a, F4 b) { return { _mm_or_ps(a.v, b.v) }; }
+    inline F4 operator<(F4 a, F4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+    inline F4 operator>(F4 a, F4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+    inline F4 operator<=(F4 a, F4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+    inline F4 operator>=(F4 a, F4 b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+#endif
+
+#if defined(__AVX__)
+    struct F8
+    {
+        __m256 v;
+        static constexpr uint32_t W = 8;
+        static F8 Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+        static F8 Set1(float f) { return { _mm256_set1_ps(f) }; }
+        static F8 Lanes() { return { _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f) }; }
+        void Store(float* p) const { _mm256_storeu_ps(p, v); }
+        int Mask() const { return _mm256_movemask_ps(v); }
+    };
+    inline F8 operator+(F8 a, F8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+    inline F8 operator-(F8 a, F8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    inline F8 operator*(F8 a, F8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    inline F8 operator/(F8 a, F8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+    inline F8 operator&(F8 a, F8 b) { return { _mm256_and_ps(a.v, b.v) }; }
+    inline F8 operator|(F8 a, F8 b) { return { _mm256_or_ps(a.v, b.v) }; }
+    inline F8 operator<(F8 a, F8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+    inline F8 operator>(F8 a, F8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+    inline F8 operator<=(F8 a, F8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+    inline F8 operator>=(F8 a, F8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+    using Lane = F8;
+#elif MESH_BVH_SSE2
+    using Lane = F4;
+#endif
+
+    struct LeafHit
+    {
+        float t;
+        uint32_t index;     // leaf-order triangle
+        float u, v;
+    };
+
+#if MESH_BVH_SSE2
+    // Moller-Trumbore against Lane::W triangles at once, double sided.
+    template<bool AnyHit>
+    bool IntersectLeaf(const float* const planes[9], uint32_t first, uint32_t count,
+        const BVHRay& ray, float& tBest, LeafHit& best)
+    {
+        const Lane ox = Lane::Set1(ray.origin[0]), oy = Lane::Set1(ray.origin[1]), oz = Lane::Set1(ray.origin[2]);
+        const Lane dx = Lane::Set1(ray.dir[0]), dy = Lane::Set1(ray.dir[1]), dz = Lane::Set1(ray.dir[2]);
+        const Lane zero = Lane::Set1(0.f), one = Lane::Set1(1.f);
+        const Lane eps = Lane::Set1(1e-20f), negEps = Lane::Set1(-1e-20f);
+
+        bool found = false;
+        const uint32_t end = first + count;
+        for (uint32_t i = first; i < end; i += Lane::W) {
+            const Lane v0x = Lane::Load(planes[0] + i), v0y = Lane::Load(planes[1] + i), v0z = Lane::Load(planes[2] + i);
+            const Lane e1x = Lane::Load(planes[3] + i), e1y = Lane::Load(planes[4] + i), e1z = Lane::Load(planes[5] + i);
+            const Lane e2x = Lane::Load(planes[6] + i), e2y = Lane::Load(planes[7] + i), e2z = Lane::Load(planes[8] + i);
+
+            const Lane px = dy * e2z - dz * e2y;
+            const Lane py = dz * e2x - dx * e2z;
+            const Lane pz = dx * e2y - dy * e2x;
+            const Lane det = e1x * px + e1y * py + e1z * pz;
+            const Lane inv = one / det;
+
+            const Lane sx = ox - v0x, sy = oy - v0y, sz = oz - v0z;
+            const Lane u = (sx * px + sy * py + sz * pz) * inv;
+            const Lane qx = sy * e1z - sz * e1y;
+            const Lane qy = sz * e1x - sx * e1z;
+            const Lane qz = sx * e1y - sy * e1x;
+            const Lane v = (dx * qx + dy * qy + dz * qz) * inv;
+            const Lane t = (e2x * qx + e2y * qy + e2z * qz) * inv;
+
+            const Lane hit = ((det > eps) | (det < negEps)) & (u >= zero) & (v >= zero) & (u + v <= one)
+                & (t > zero) & (t < Lane::Set1(tBest)) & (Lane::Lanes() < Lane::Set1(float(end - i)));
+            int mask = hit.Mask();
+            if (!mask) continue;
+
+            float ts[Lane::W], us[Lane::W], vs[Lane::W];
+            t.Store(ts); u.Store(us); v.Store(vs);
+            while (mask) {
+                const int k = LowestBit(mask);
+                mask &= mask - 1;
+                if (ts[k] < tBest) {
+                    tBest = ts[k];
+                    best = { ts[k], i + uint32_t(k), us[k], vs[k] };
+                    found = true;
+                    if (AnyHit) return true;
+                }
+            }
+        }
+        return found;
+    }
+#else
+    template<bool AnyHit>
+    bool IntersectLeaf(const float* const planes[9], uint32_t first, uint32_t count,
+        const BVHRay& ray, float& tBest, LeafHit& best)
+    {
+        const float* o = ray.origin;
+        const float* d = ray.dir;
+        bool found = false;
+        for (uint32_t i = first; i < first + count; ++i) {
+            const float e1[3] = { planes[3][i], planes[4][i], planes[5][i] };
+            const float e2[3] = { planes[6][i], planes[7][i], planes[8][i] };
+            const float p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+            const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+            if (det > -1e-20f && det < 1e-20f) continue;
+            const float inv = 1.f / det;
+            const float s[3] = { o[0] - planes[0][i], o[1] - planes[1][i], o[2] - planes[2][i] };
+            const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+            if (u < 0.f || u > 1.f) continue;
+            const float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+            const float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+            if (v < 0.f || u + v > 1.f) continue;
+            const float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+            if (t <= 0.f || t >= tBest) continue;
+            tBest = t;
+            best = { t, i, u, v };
+            found = true;
+            if (AnyHit) return true;
+        }
+        return found;
+    }
+#endif
+
+    struct RaySlab
+    {
+#if MESH_BVH_SSE2
+        __m128 origin, invDir, xyzMask;
+
+        explicit RaySlab(const BVHRay& r)
+            : origin(_mm_setr_ps(r.origin[0], r.origin[1], r.origin[2], 0.f))
+            , invDir(_mm_setr_ps(1.f / r.dir[0], 1.f / r.dir[1], 1.f / r.dir[2], 0.f))
+            , xyzMask(_mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0))) {}
+
+        // entry distance or kMiss; the 4th lane of each load is the node's
+        // index field and is masked out
+        float Enter(const BVHNode& n, float tMax) const {
+            const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.bmin), origin), invDir);
+            const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.bmax), origin), invDir);
+            __m128 tn = _mm_min_ps(t1, t2);
+            __m128 tf = _mm_max_ps(t1, t2);
+            tn = _mm_or_ps(_mm_and_ps(xyzMask, tn), _mm_andnot_ps(xyzMask, _mm_setzero_ps()));
+            tf = _mm_or_ps(_mm_and_ps(xyzMask, tf), _mm_andnot_ps(xyzMask, _mm_set1_ps(tMax)));
+            tn = _mm_max_ps(tn, _mm_shuffle_ps(tn, tn, _MM_SHUFFLE(2, 3, 0, 1)));
+            tn = _mm_max_ps(tn, _mm_shuffle_ps(tn, tn, _MM_SHUFFLE(1, 0, 3, 2)));
+            tf = _mm_min_ps(tf, _mm_shuffle_ps(tf, tf, _MM_SHUFFLE(2, 3, 0, 1)));
+            tf = _mm_min_ps(tf, _mm_shuffle_ps(tf, tf, _MM_SHUFFLE(1, 0, 3, 2)));
+            const float tNear = _mm_cvtss_f32(tn);
+            return tNear <= _mm_cvtss_f32(tf) ? tNear : kMiss;
+        }
+#else
+        float o[3], inv[3];
+
+        explicit RaySlab(const BVHRay& r) {
+            for (int a = 0; a < 3; ++a) { o[a] = r.origin[a]; inv[a] = 1.f / r.dir[a]; }
+        }
+
+        float Enter(const BVHNode& n, float tMax) const {
+            float tNear = 0.f, tFar = tMax;
+            for (int a = 0; a < 3; ++a) {
+                const float t1 = (n.bmin[a] - o[a]) * inv[a];
+                const float t2 = (n.bmax[a] - o[a]) * inv[a];
+                tNear = std::max(tNear, std::min(t1, t2));
+                tFar = std::min(tFar, std::max(t1, t2));
+            }
+            return tNear <= tFar ? tNear : kMiss;
+        }
+#endif
+    };
+}
+
+void MeshBVH::Build(const Vertex* vertices, const uint32_t* indices, size_t indexCount)
+{
+    m_nodes.clear();
+    m_triIds.clear();
+    m_tris.clear();
+    m_planeStride = 0;
+
+    const uint32_t triCount = uint32_t(indexCount / 3);
+    if (triCount == 0) return;
+
+    auto& jobs = JobSystem::I();
+
+    std::vector<TriRef> refs(triCount);
+    jobs.ParallelFor(triCount, 4096, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            TriRef& r = refs[t];
+            r = TriRef{};
+            for (int k = 0; k < 3; ++k) {
+                const Vertex& v = vertices[indices[t * 3 + k]];
+                const float p[3] = { v.px, v.py, v.pz };
+                r.box.Grow(p);
+            }
+            for (int a = 0; a < 3; ++a) r.c[a] = 0.5f * (r.box.mn[a] + r.box.mx[a]);
+        }
+        });
+
+    m_triIds.resize(triCount);
+    std::iota(m_triIds.begin(), m_triIds.end(), 0u);
+    m_nodes.resize(size_t(triCount) * 2);
+    m_nodes[0].leftFirst = 0;
+    m_nodes[0].triCount = triCount;
+
+    Builder builder{ refs, m_triIds, m_nodes };
+    builder.Subdivide(0, 0);
+    m_nodes.resize(builder.used.load());
+    m_nodes.shrink_to_fit();
+
+    // padded so a SIMD leaf test may read past the last triangle
+    m_planeStride = triCount + kSimdWidth;
+    m_tris.assign(m_planeStride * PlaneCount, 0.f);
+    float* planes[PlaneCount];
+    for (int p = 0; p < PlaneCount; ++p) planes[p] = m_tris.data() + size_t(p) * m_planeStride;
+
+    jobs.ParallelFor(triCount, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t* tri = indices + size_t(m_triIds[i]) * 3;
+            const Vertex& a = vertices[tri[0]];
+            const Vertex& b = vertices[tri[1]];
+            const Vertex& c = vertices[tri[2]];
+            planes[V0X][i] = a.px;        planes[V0Y][i] = a.py;        planes[V0Z][i] = a.pz;
+            planes[E1X][i] = b.px - a.px; planes[E1Y][i] = b.py - a.py; planes[E1Z][i] = b.pz - a.pz;
+            planes[E2X][i] = c.px - a.px; planes[E2Y][i] = c.py - a.py; planes[E2Z][i] = c.pz - a.pz;
+        }
+        });
+}
+
+template<bool AnyHit>
+bool MeshBVH::Traverse(const BVHRay& ray, BVHHit& hit) const
+{
+    if (m_nodes.empty()) return false;
+
+    const float* const planes[PlaneCount] = {
+        PlaneData(V0X), PlaneData(V0Y), PlaneData(V0Z),
+        PlaneData(E1X), PlaneData(E1Y), PlaneData(E1Z),
+        PlaneData(E2X), PlaneData(E2Y), PlaneData(E2Z) };
+
+    const RaySlab slab(ray);
+    float tBest = ray.tMax;
+    if (slab.Enter(m_nodes[0], tBest) == kMiss) return false;
+
+    struct Entry { uint32_t node; float t; };
+    Entry stack[kMaxDepth];
+    uint32_t sp = 0;
+    uint32_t nodeIdx = 0;
+
+    LeafHit best{};
+    bool found = false;
+    for (;;) {
+        const BVHNode& n = m_nodes[nodeIdx];
+        if (n.IsLeaf()) {
+            if (IntersectLeaf<AnyHit>(planes, n.leftFirst, n.triCount, ray, tBest, best)) {
+                found = true;
+                if (AnyHit) break;
+            }
+        }
+        else {
+            uint32_t a = n.leftFirst, b = n.leftFirst + 1;
+            float ta = slab.Enter(m_nodes[a], tBest);
+            float tb = slab.Enter(m_nodes[b], tBest);
+            if (ta > tb) { std::swap(a, b); std::swap(ta, tb); }
+            if (ta != kMiss) {
+                if (tb != kMiss) stack[sp++] = { b, tb };
+                nodeIdx = a;
+                continue;
+            }
+        }
+
+        bool next = false;
+        while (sp > 0) {
+            const Entry e = stack[--sp];
+            if (e.t < tBest) { nodeIdx = e.node; next = true; break; }
+        }
+        if (!next) break;
+    }
+
+    if (found) {
+        hit.t = best.t;
+        hit.triangle = m_triIds[best.index];
+        hit.u = best.u;
+        hit.v = best.v;
+
+        const uint32_t i = best.index;
+        const float e1[3] = { planes[E1X][i], planes[E1Y][i], planes[E1Z][i] };
+        const float e2[3] = { planes[E2X][i], planes[E2Y][i], planes[E2Z][i] };
+        hit.normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        hit.normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        hit.normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+    return found;
+}
+
+bool MeshBVH::Intersect(const BVHRay& ray, BVHHit& hit) const
+{
+    return Traverse<false>(ray, hit);
+}
+
+bool MeshBVH::Occluded(const BVHRay& ray) const
+{
+    BVHHit hit;
+    return Traverse<true>(ray, hit);
+}
+
+size_t MeshBVH::MemoryBytes() const
+{
+    return m_nodes.capacity() * sizeof(BVHNode)
+        + m_triIds.capacity() * sizeof(uint32_t)
+        + m_tris.capacity() * sizeof(float);
+}
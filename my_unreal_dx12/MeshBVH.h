@@ -0,0 +1,79 @@
+#pragma once
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MeshData.h"
+
+// 32-byte node: the bounds are laid out so that bmin/bmax load as one SIMD
+// register each. Children of an interior node are stored next to each other.
+struct BVHNode
+{
+    float bmin[3];
+    uint32_t leftFirst;     // first child (interior) or first triangle (leaf)
+    float bmax[3];
+    uint32_t triCount;      // 0 for interior nodes
+
+    bool IsLeaf() const { return triCount != 0; }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode must stay 32 bytes");
+
+struct BVHRay
+{
+    float origin[3];
+    float dir[3];           // need not be normalized, t is in units of dir
+    float tMax = FLT_MAX;
+};
+
+struct BVHHit
+{
+    static constexpr uint32_t kNone = ~0u;
+
+    float t = FLT_MAX;
+    uint32_t triangle = kNone;  // index of the triangle in the source index buffer
+    float u = 0.f, v = 0.f;     // barycentric weights of the 2nd and 3rd vertex
+    float normal[3]{};          // (v1 - v0) x (v2 - v0), not normalized
+
+    bool Valid() const { return triangle != kNone; }
+};
+
+// Triangle BVH built with binned SAH. Triangles are copied into SoA arrays in
+// leaf order, so a leaf is tested kSimdWidth triangles at a time and the source
+// vertex data is not needed after Build.
+class MeshBVH
+{
+public:
+    static constexpr uint32_t kBins = 16;
+    static constexpr uint32_t kMaxLeafTriangles = 8;
+#if defined(__AVX__)
+    static constexpr uint32_t kSimdWidth = 8;
+#else
+    static constexpr uint32_t kSimdWidth = 4;
+#endif
+
+    void Build(const Vertex* vertices, const uint32_t* indices, size_t indexCount);
+
+    // closest hit with 0 < t < ray.tMax
+    bool Intersect(const BVHRay& ray, BVHHit& hit) const;
+    // any hit with 0 < t < ray.tMax, for line of sight queries
+    bool Occluded(const BVHRay& ray) const;
+
+    bool Empty() const { return m_nodes.empty(); }
+    size_t NodeCount() const { return m_nodes.size(); }
+    size_t TriangleCount() const { return m_triIds.size(); }
+    size_t MemoryBytes() const;
+    const std::vector<BVHNode>& Nodes() const { return m_nodes; }
+
+private:
+    enum Plane { V0X, V0Y, V0Z, E1X, E1Y, E1Z, E2X, E2Y, E2Z, PlaneCount };
+
+    const float* PlaneData(Plane p) const { return m_tris.data() + size_t(p) * m_planeStride; }
+
+    template<bool AnyHit>
+    bool Traverse(const BVHRay& ray, BVHHit& hit) const;
+
+    std::vector<BVHNode> m_nodes;
+    std::vector<uint32_t> m_triIds;     // leaf order -> source triangle
+    std::vector<float> m_tris;          // PlaneCount planes of m_planeStride floats
+    size_t m_planeStride = 0;
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Hash128.h"
+
+// GPU-free mesh description shared by the importers, the cooked mesh format
+// and MeshAsset.
+
+struct Vertex {
+    float px, py, pz;
+    float nx, ny, nz;
+    float r, g, b;
+    float u, v;
+    float tx, ty, tz;
+    float bx, by, bz;
+    float ao = 1.f;     // baked ambient occlusion, scales the ambient term
+};
+
+struct MaterialDesc
+{
+    float kd[3]{ 1.f, 1.f, 1.f };
+    float ks[3]{ 1.f, 1.f, 1.f };
+    float ke[3]{ 0.f, 0.f, 0.f };
+    float shininess = 128.f;
+    float opacity = 1.f;
+
+    // relative to the directory of the mesh file
+    std::string texture;
+    std::string normalMap;
+    std::string metalRoughMap;
+};
+
+struct SubmeshDesc
+{
+    uint32_t indexStart = 0;
+    uint32_t indexCount = 0;
+    bool hasMaterial = false;
+    MaterialDesc material;
+
+    // For texture streaming, see MeshOptimize::MeasureSubmeshes: object
+    // space bounding sphere (centre, radius) of the triangles, and texture
+    // coordinate units per object space unit across them. Zero when unknown.
+    float bounds[4]{};
+    float uvDensity = 0.f;
+};
+
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<SubmeshDesc> submeshes;
+
+    float shininess = 128.f;
+    std::string texture;
+};
+
+// content address of a vertex and index stream pair
+inline Hash128 HashGeometry(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+{
+    const Hash128 v = HashBytes(vertices, vertexCount * sizeof(Vertex));
+    return HashBytes(indices, indexCount * sizeof(uint32_t), v);
+}
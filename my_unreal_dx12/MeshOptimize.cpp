@@ -0,0 +1,401 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "MeshOptimize.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    struct Range { uint32_t start, count; };
+
+    // triangle ranges the passes must not mix, one per submesh
+    std::vector<Range> Ranges(const MeshData& mesh)
+    {
+        std::vector<Range> ranges;
+        if (mesh.submeshes.empty()) {
+            ranges.push_back({ 0, uint32_t(mesh.indices.size()) });
+            return ranges;
+        }
+        for (const auto& sm : mesh.submeshes)
+            ranges.push_back({ sm.indexStart, sm.indexCount });
+        return ranges;
+    }
+
+    constexpr int kFloats = sizeof(Vertex) / sizeof(float);
+
+    inline int64_t Cell(float v, float inv) { return int64_t(std::floor(v * inv)); }
+
+    inline uint32_t HashCell(int64_t x, int64_t y, int64_t z)
+    {
+        uint64_t h = uint64_t(x) * 0x9E3779B185EBCA87ull;
+        h ^= uint64_t(y) * 0xC2B2AE3D27D4EB4Full;
+        h ^= uint64_t(z) * 0x165667B19E3779F9ull;
+        h ^= h >> 29;
+        return uint32_t(h);
+    }
+
+    // Forsyth's scoring
+    constexpr float kCacheDecayPower = 1.5f;
+    constexpr float kLastTriScore = 0.75f;
+    constexpr float kValenceBoostScale = 2.0f;
+    constexpr float kValenceBoostPower = 0.5f;
+    constexpr uint32_t kMaxValence = 64;
+
+    struct ScoreTables
+    {
+        float cache[MeshOptimize::kCacheSize];
+        float valence[kMaxValence];
+
+        ScoreTables()
+        {
+            for (uint32_t i = 0; i < MeshOptimize::kCacheSize; ++i) {
+                if (i < 3) {
+                    cache[i] = kLastTriScore;
+                }
+                else {
+                    const float scaler = 1.0f / (MeshOptimize::kCacheSize - 3);
+                    cache[i] = std::pow(1.0f - (i - 3) * scaler, kCacheDecayPower);
+                }
+            }
+            valence[0] = 0.f;
+            for (uint32_t i = 1; i < kMaxValence; ++i)
+                valence[i] = kValenceBoostScale * std::pow(float(i), -kValenceBoostPower);
+        }
+
+        float Score(int cachePos, uint32_t remaining) const
+        {
+            if (remaining == 0) return -1.0f;
+            float s = cachePos >= 0 ? cache[cachePos] : 0.f;
+            s += remaining < kMaxValence ? valence[remaining]
+                : kValenceBoostScale * std::pow(float(remaining), -kValenceBoostPower);
+            return s;
+        }
+    };
+}
+
+size_t MeshOptimize::WeldVertices(MeshData& mesh, float positionTolerance, float attributeTolerance)
+{
+    const size_t n = mesh.vertices.size();
+    if (n < 2) return 0;
+
+    float mn[3] = { mesh.vertices[0].px, mesh.vertices[0].py, mesh.vertices[0].pz };
+    float mx[3] = { mn[0], mn[1], mn[2] };
+    for (const auto& v : mesh.vertices) {
+        mn[0] = std::min(mn[0], v.px); mx[0] = std::max(mx[0], v.px);
+        mn[1] = std::min(mn[1], v.py); mx[1] = std::max(mx[1], v.py);
+        mn[2] = std::min(mn[2], v.pz); mx[2] = std::max(mx[2], v.pz);
+    }
+    const float extent = std::max({ mx[0] - mn[0], mx[1] - mn[1], mx[2] - mn[2], 1e-20f });
+    const float eps = positionTolerance * extent;
+    // a cell of 2 * eps keeps every match within the 27 neighbouring cells
+    const float inv = 1.0f / std::max(2.0f * eps, 1e-30f);
+
+    uint32_t buckets = 1;
+    while (buckets < n * 2) buckets <<= 1;
+    std::vector<uint32_t> head(buckets, UINT32_MAX);
+    std::vector<uint32_t> next(n, UINT32_MAX);
+    std::vector<int64_t> cells(n * 3);
+    std::vector<uint32_t> remap(n);
+
+    auto equal = [&](const Vertex& a, const Vertex& b) {
+        float fa[kFloats], fb[kFloats];
+        memcpy(fa, &a, sizeof(Vertex));
+        memcpy(fb, &b, sizeof(Vertex));
+        for (int k = 0; k < 3; ++k)
+            if (!(std::fabs(fa[k] - fb[k]) <= eps)) return false;
+        for (int k = 3; k < kFloats; ++k)
+            if (!(std::fabs(fa[k] - fb[k]) <= attributeTolerance)) return false;
+        return true;
+    };
+
+    size_t welded = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        const Vertex& v = mesh.vertices[i];
+        const int64_t cx = Cell(v.px, inv), cy = Cell(v.py, inv), cz = Cell(v.pz, inv);
+
+        uint32_t match = UINT32_MAX;
+        for (int dz = -1; dz <= 1 && match == UINT32_MAX; ++dz) {
+            for (int dy = -1; dy <= 1 && match == UINT32_MAX; ++dy) {
+                for (int dx = -1; dx <= 1 && match == UINT32_MAX; ++dx) {
+                    const int64_t x = cx + dx, y = cy + dy, z = cz + dz;
+                    for (uint32_t j = head[HashCell(x, y, z) & (buckets - 1)]; j != UINT32_MAX; j = next[j]) {
+                        if (cells[j * 3] != x || cells[j * 3 + 1] != y || cells[j * 3 + 2] != z) continue;
+                        if (equal(mesh.vertices[j], v)) { match = j; break; }
+                    }
+                }
+            }
+        }
+
+        if (match != UINT32_MAX) {
+            remap[i] = match;
+            ++welded;
+            continue;
+        }
+        remap[i] = i;
+        cells[i * 3] = cx; cells[i * 3 + 1] = cy; cells[i * 3 + 2] = cz;
+        uint32_t& h = head[HashCell(cx, cy, cz) & (buckets - 1)];
+        next[i] = h;
+        h = i;
+    }
+
+    if (welded)
+        for (auto& idx : mesh.indices)
+            idx = remap[idx];
+    return welded;
+}
+
+size_t MeshOptimize::RemoveDegenerates(MeshData& mesh)
+{
+    const std::vector<Range> ranges = Ranges(mesh);
+    std::vector<uint32_t> out;
+    out.reserve(mesh.indices.size());
+    size_t removed = 0;
+
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        const uint32_t start = uint32_t(out.size());
+        const uint32_t* idx = mesh.indices.data() + ranges[r].start;
+        for (uint32_t t = 0; t + 2 < ranges[r].count; t += 3) {
+            const uint32_t a = idx[t], b = idx[t + 1], c = idx[t + 2];
+            bool degenerate = a == b || b == c || a == c;
+            if (!degenerate) {
+                const Vertex& A = mesh.vertices[a];
+                const Vertex& B = mesh.vertices[b];
+                const Vertex& C = mesh.vertices[c];
+                const float e1[3] = { B.px - A.px, B.py - A.py, B.pz - A.pz };
+                const float e2[3] = { C.px - A.px, C.py - A.py, C.pz - A.pz };
+                const float e3[3] = { C.px - B.px, C.py - B.py, C.pz - B.pz };
+                const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                const float area2 = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+                const float longest = std::max({ e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2],
+                    e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2], e3[0] * e3[0] + e3[1] * e3[1] + e3[2] * e3[2] });
+                // |e1 x e2| / longest^2 bounds the sine of the smallest angle
+                degenerate = !(area2 > 1e-12f * longest * longest);
+            }
+            if (degenerate) { ++removed; continue; }
+            out.push_back(a); out.push_back(b); out.push_back(c);
+        }
+        if (!mesh.submeshes.empty()) {
+            mesh.submeshes[r].indexStart = start;
+            mesh.submeshes[r].indexCount = uint32_t(out.size()) - start;
+        }
+    }
+
+    mesh.indices.swap(out);
+    return removed;
+}
+
+void MeshOptimize::OptimizeVertexCache(MeshData& mesh)
+{
+    static const ScoreTables tables;
+    const size_t vertexCount = mesh.vertices.size();
+
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    std::vector<uint32_t> adjOffset(vertexCount, 0);
+    std::vector<uint32_t> fillPos(vertexCount, 0);
+    std::vector<uint32_t> mark(vertexCount, 0);
+    uint32_t rangeId = 0;
+    std::vector<uint32_t> adjacency;
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount, 0.f);
+    std::vector<float> triScore;
+    std::vector<uint8_t> emitted;
+    std::vector<uint32_t> out;
+
+    for (const Range& range : Ranges(mesh)) {
+        const uint32_t triCount = range.count / 3;
+        if (triCount < 2) continue;
+        uint32_t* idx = mesh.indices.data() + range.start;
+
+        for (uint32_t i = 0; i < triCount * 3; ++i) remaining[idx[i]] = 0;
+        for (uint32_t i = 0; i < triCount * 3; ++i) ++remaining[idx[i]];
+
+        // CSR adjacency over the vertices of this range
+        ++rangeId;
+        uint32_t total = 0;
+        for (uint32_t i = 0; i < triCount * 3; ++i) {
+            const uint32_t v = idx[i];
+            if (mark[v] == rangeId) continue;
+            mark[v] = rangeId;
+            adjOffset[v] = total;
+            fillPos[v] = total;
+            total += remaining[v];
+            cachePos[v] = -1;
+            vertexScore[v] = tables.Score(-1, remaining[v]);
+        }
+        adjacency.resize(total);
+        for (uint32_t t = 0; t < triCount; ++t)
+            for (int k = 0; k < 3; ++k)
+                adjacency[fillPos[idx[t * 3 + k]]++] = t;
+
+        triScore.assign(triCount, 0.f);
+        emitted.assign(triCount, 0);
+        uint32_t best = 0;
+        for (uint32_t t = 0; t < triCount; ++t) {
+            triScore[t] = vertexScore[idx[t * 3]] + vertexScore[idx[t * 3 + 1]] + vertexScore[idx[t * 3 + 2]];
+            if (triScore[t] > triScore[best]) best = t;
+        }
+
+        out.clear();
+        out.reserve(triCount * 3);
+        uint32_t cache[kCacheSize + 3];
+        uint32_t cacheSize = 0;
+        uint32_t scanCursor = 0;
+
+        while (out.size() < size_t(triCount) * 3) {
+            if (best == UINT32_MAX) {
+                while (emitted[scanCursor]) ++scanCursor;
+                best = scanCursor;
+            }
+
+            const uint32_t tri[3] = { idx[best * 3], idx[best * 3 + 1], idx[best * 3 + 2] };
+            out.insert(out.end(), tri, tri + 3);
+            emitted[best] = 1;
+
+            for (uint32_t v : tri) {
+                // drop the triangle from the live part of the adjacency list
+                uint32_t* adj = adjacency.data() + adjOffset[v];
+                for (uint32_t k = 0; k < remaining[v]; ++k) {
+                    if (adj[k] == best) { adj[k] = adj[remaining[v] - 1]; break; }
+                }
+                --remaining[v];
+            }
+
+            // most recent first, older entries shift down
+            uint32_t newCache[kCacheSize + 3];
+            uint32_t newSize = 0;
+            for (uint32_t v : tri) newCache[newSize++] = v;
+            for (uint32_t i = 0; i < cacheSize; ++i) {
+                const uint32_t v = cache[i];
+                if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                    if (newSize < kCacheSize + 3) newCache[newSize++] = v;
+                    else cachePos[v] = -1;
+                }
+            }
+            for (uint32_t i = 0; i < newSize; ++i) {
+                const uint32_t v = newCache[i];
+                cachePos[v] = i < kCacheSize ? int(i) : -1;
+                vertexScore[v] = tables.Score(cachePos[v], remaining[v]);
+            }
+
+            best = UINT32_MAX;
+            float bestScore = -1.f;
+            for (uint32_t i = 0; i < newSize; ++i) {
+                const uint32_t v = newCache[i];
+                const uint32_t* adj = adjacency.data() + adjOffset[v];
+                for (uint32_t k = 0; k < remaining[v]; ++k) {
+                    const uint32_t t = adj[k];
+                    const float s = vertexScore[idx[t * 3]] + vertexScore[idx[t * 3 + 1]] + vertexScore[idx[t * 3 + 2]];
+                    triScore[t] = s;
+                    if (s > bestScore) { bestScore = s; best = t; }
+                }
+            }
+
+            // entries past the cache size are only kept to score their triangles once more
+            cacheSize = std::min(newSize, kCacheSize);
+            for (uint32_t i = cacheSize; i < newSize; ++i) cachePos[newCache[i]] = -1;
+            memcpy(cache, newCache, cacheSize * sizeof(uint32_t));
+        }
+
+        for (uint32_t i = 0; i < cacheSize; ++i) cachePos[cache[i]] = -1;
+        memcpy(idx, out.data(), out.size() * sizeof(uint32_t));
+    }
+}
+
+void MeshOptimize::OptimizeVertexFetch(MeshData& mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (auto& idx : mesh.indices) {
+        uint32_t& r = remap[idx];
+        if (r == UINT32_MAX) {
+            r = uint32_t(vertices.size());
+            vertices.push_back(mesh.vertices[idx]);
+        }
+        idx = r;
+    }
+    mesh.vertices.swap(vertices);
+}
+
+float MeshOptimize::ACMR(const uint32_t* indices, size_t indexCount, uint32_t cacheSize)
+{
+    if (indexCount < 3) return 0.f;
+    uint32_t maxIndex = 0;
+    for (size_t i = 0; i < indexCount; ++i) maxIndex = std::max(maxIndex, indices[i]);
+
+    // FIFO: a vertex is resident while fewer than cacheSize misses happened since it was loaded
+    std::vector<uint32_t> loadedAt(size_t(maxIndex) + 1, UINT32_MAX);
+    uint32_t misses = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t& at = loadedAt[indices[i]];
+        if (at == UINT32_MAX || misses - at >= cacheSize) {
+            at = misses;
+            ++misses;
+        }
+    }
+    return float(misses) / float(indexCount / 3);
+}
+
+void MeshOptimize::MeasureSubmeshes(MeshData& mesh)
+{
+    for (auto& sm : mesh.submeshes) {
+        const uint32_t end = std::min(sm.indexStart + sm.indexCount, uint32_t(mesh.indices.size()));
+        float mn[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, mx[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        double area = 0.0, uvArea = 0.0;
+        for (uint32_t i = sm.indexStart; i + 3 <= end; i += 3) {
+            const Vertex& a = mesh.vertices[mesh.indices[i]];
+            const Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+            const Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+            for (const Vertex* v : { &a, &b, &c }) {
+                mn[0] = std::min(mn[0], v->px); mx[0] = std::max(mx[0], v->px);
+                mn[1] = std::min(mn[1], v->py); mx[1] = std::max(mx[1], v->py);
+                mn[2] = std::min(mn[2], v->pz); mx[2] = std::max(mx[2], v->pz);
+            }
+            const float e1[3] = { b.px - a.px, b.py - a.py, b.pz - a.pz };
+            const float e2[3] = { c.px - a.px, c.py - a.py, c.pz - a.pz };
+            const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            area += 0.5 * std::sqrt(double(n[0]) * n[0] + double(n[1]) * n[1] + double(n[2]) * n[2]);
+            uvArea += 0.5 * std::fabs(double(b.u - a.u) * (c.v - a.v) - double(c.u - a.u) * (b.v - a.v));
+        }
+        if (mn[0] > mx[0]) {
+            std::fill(sm.bounds, sm.bounds + 4, 0.f);
+            sm.uvDensity = 0.f;
+            continue;
+        }
+
+        for (int k = 0; k < 3; ++k)
+            sm.bounds[k] = 0.5f * (mn[k] + mx[k]);
+        float r2 = 0.f;
+        for (uint32_t i = sm.indexStart; i < end; ++i) {
+            const Vertex& v = mesh.vertices[mesh.indices[i]];
+            const float d[3] = { v.px - sm.bounds[0], v.py - sm.bounds[1], v.pz - sm.bounds[2] };
+            r2 = std::max(r2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        }
+        sm.bounds[3] = std::sqrt(r2);
+        sm.uvDensity = area > 0.0 ? float(std::sqrt(uvArea / area)) : 0.f;
+    }
+}
+
+MeshOptimize::Stats MeshOptimize::Optimize(MeshData& mesh)
+{
+    Stats stats;
+    stats.verticesIn = mesh.vertices.size();
+    stats.trianglesIn = mesh.indices.size() / 3;
+    stats.acmrIn = ACMR(mesh.indices.data(), mesh.indices.size());
+
+    stats.welded = WeldVertices(mesh);
+    stats.degenerate = RemoveDegenerates(mesh);
+    OptimizeVertexCache(mesh);
+    OptimizeVertexFetch(mesh);
+    MeasureSubmeshes(mesh);
+
+    stats.verticesOut = mesh.vertices.size();
+    stats.trianglesOut = mesh.indices.size() / 3;
+    stats.acmrOut = ACMR(mesh.indices.data(), mesh.indices.size());
+    return stats;
+}
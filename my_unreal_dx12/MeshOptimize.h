@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "MeshData.h"
+
+// GPU-free cleanup and reordering run on imported meshes before they are
+// cooked. Every pass keeps triangles inside their submesh, updating the
+// submesh ranges when triangles are removed, and keeps winding.
+namespace MeshOptimize
+{
+    struct Stats
+    {
+        size_t verticesIn = 0, verticesOut = 0;
+        size_t trianglesIn = 0, trianglesOut = 0;
+        size_t welded = 0;          // vertices merged into an equal neighbour
+        size_t degenerate = 0;      // triangles removed
+        float acmrIn = 0.f;         // average cache miss ratio, FIFO of kCacheSize
+        float acmrOut = 0.f;
+    };
+
+    constexpr uint32_t kCacheSize = 32;
+    // bump when the output of Optimize changes, cooked files are rebuilt
+    constexpr uint32_t kVersion = 2;
+
+    // Merges vertices closer than positionTolerance (relative to the bounding
+    // box size) whose other attributes all differ by less than attributeTolerance.
+    // Candidates come from a spatial hash of the positions. Returns the number
+    // of vertices merged; unreferenced vertices are left for OptimizeVertexFetch.
+    size_t WeldVertices(MeshData& mesh, float positionTolerance = 1e-6f, float attributeTolerance = 1e-4f);
+
+    // Drops triangles with repeated indices or with no area.
+    size_t RemoveDegenerates(MeshData& mesh);
+
+    // Forsyth's linear-speed vertex cache optimisation, per submesh.
+    void OptimizeVertexCache(MeshData& mesh);
+
+    // Renumbers vertices in first-use order and drops unreferenced ones.
+    void OptimizeVertexFetch(MeshData& mesh);
+
+    float ACMR(const uint32_t* indices, size_t indexCount, uint32_t cacheSize = kCacheSize);
+
+    // Fills bounds and uvDensity of every submesh; the density is the square
+    // root of the texture coordinate area over the object space area.
+    void MeasureSubmeshes(MeshData& mesh);
+
+    // All of the above in order.
+    Stats Optimize(MeshData& mesh);
+}
@@ -0,0 +1,371 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "MipGenerator.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIPGEN_SSE2 1
+#endif
+
+namespace
+{
+    constexpr float kPi = 3.14159265358979f;
+    // linear values are looked up at this resolution when encoded to sRGB
+    constexpr uint32_t kSrgbSteps = 65535;
+
+    struct SrgbTables
+    {
+        float toLinear[256];
+        uint8_t fromLinear[kSrgbSteps + 1];
+
+        SrgbTables()
+        {
+            for (int i = 0; i < 256; ++i) {
+                const double c = i / 255.0;
+                toLinear[i] = float(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+            }
+            for (uint32_t i = 0; i <= kSrgbSteps; ++i) {
+                const double l = double(i) / kSrgbSteps;
+                const double s = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+                fromLinear[i] = uint8_t(std::clamp(s * 255.0 + 0.5, 0.0, 255.0));
+            }
+        }
+    };
+
+    const SrgbTables& Srgb()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    // How one Content maps bytes to filtered floats and back. A channel is
+    // decoded through its table and encoded as clamp(v * scale + bias, 0, 1),
+    // either through the sRGB table or rounded to 8 bits.
+    struct Codec
+    {
+        float decode[4][256];
+        float scale[4], bias[4];
+        bool srgb[4];
+        bool normalize;
+
+        explicit Codec(MipGenerator::Content content)
+        {
+            using MipGenerator::Content;
+            const SrgbTables& tables = Srgb();
+            normalize = content == Content::NormalMap;
+            for (int c = 0; c < 4; ++c) {
+                const bool signedChannel = normalize && c < 3;
+                srgb[c] = content == Content::Color && c < 3;
+                scale[c] = signedChannel ? 0.5f : 1.f;
+                bias[c] = signedChannel ? 0.5f : 0.f;
+                for (int v = 0; v < 256; ++v) {
+                    if (srgb[c]) decode[c][v] = tables.toLinear[v];
+                    else if (signedChannel) decode[c][v] = v / 255.f * 2.f - 1.f;
+                    else decode[c][v] = v / 255.f;
+                }
+            }
+        }
+
+        void DecodeRow(const uint8_t* in, uint32_t count, float* out) const
+        {
+            for (uint32_t i = 0; i < count * 4; i += 4)
+                for (int c = 0; c < 4; ++c)
+                    out[i + c] = decode[c][in[i + c]];
+        }
+
+        void EncodeRow(const float* in, uint32_t count, uint8_t* out, bool simd) const
+        {
+            const uint8_t* fromLinear = Srgb().fromLinear;
+            uint32_t i = 0;
+#if MIPGEN_SSE2
+            if (simd) {
+                const __m128 vScale = _mm_loadu_ps(scale);
+                const __m128 vBias = _mm_loadu_ps(bias);
+                const __m128 vSteps = _mm_setr_ps(
+                    srgb[0] ? float(kSrgbSteps) : 255.f, srgb[1] ? float(kSrgbSteps) : 255.f,
+                    srgb[2] ? float(kSrgbSteps) : 255.f, srgb[3] ? float(kSrgbSteps) : 255.f);
+                const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), half = _mm_set1_ps(0.5f);
+                alignas(16) int32_t q[4];
+                for (; i < count; ++i) {
+                    __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i * 4), vScale), vBias);
+                    v = _mm_min_ps(_mm_max_ps(v, zero), one);
+                    _mm_store_si128(reinterpret_cast<__m128i*>(q), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, vSteps), half)));
+                    for (int c = 0; c < 4; ++c)
+                        out[i * 4 + c] = srgb[c] ? fromLinear[q[c]] : uint8_t(q[c]);
+                }
+            }
+#endif
+            for (; i < count; ++i) {
+                for (int c = 0; c < 4; ++c) {
+                    const float v = std::min(std::max(in[i * 4 + c] * scale[c] + bias[c], 0.f), 1.f);
+                    const float steps = srgb[c] ? float(kSrgbSteps) : 255.f;
+                    const int32_t q = int32_t(v * steps + 0.5f);
+                    out[i * 4 + c] = srgb[c] ? fromLinear[q] : uint8_t(q);
+                }
+            }
+        }
+
+        void NormalizeRow(float* texels, uint32_t count) const
+        {
+            if (!normalize)
+                return;
+            for (uint32_t i = 0; i < count * 4; i += 4) {
+                const float len = std::sqrt(texels[i] * texels[i] + texels[i + 1] * texels[i + 1] + texels[i + 2] * texels[i + 2]);
+                if (len > 0.f) {
+                    texels[i] = texels[i] / len;
+                    texels[i + 1] = texels[i + 1] / len;
+                    texels[i + 2] = texels[i + 2] / len;
+                }
+            }
+        }
+    };
+
+    // zeroth order modified Bessel function of the first kind
+    double BesselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 64 && term > sum * 1e-12; ++k) {
+            const double f = x / (2.0 * k);
+            term *= f * f;
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Source texels and weights for every destination texel along one axis,
+    // taps entries each; unused taps have weight 0.
+    struct Axis
+    {
+        uint32_t taps = 0;
+        std::vector<uint32_t> index;
+        std::vector<float> weight;
+    };
+
+    Axis BuildAxis(uint32_t src, uint32_t dst, const MipGenerator::Settings& settings)
+    {
+        const float scale = float(src) / float(dst);
+        const bool box = settings.filter == MipGenerator::Filter::Box;
+        const float halfWidth = box ? 0.5f : 0.5f * settings.kaiserWidth;   // destination texels
+        const float radius = halfWidth * scale;                             // source texels
+        const double i0Alpha = BesselI0(settings.kaiserAlpha);
+
+        Axis axis;
+        axis.taps = uint32_t(std::ceil(2.f * radius)) + 1;
+        axis.index.assign(size_t(dst) * axis.taps, 0);
+        axis.weight.assign(size_t(dst) * axis.taps, 0.f);
+
+        for (uint32_t x = 0; x < dst; ++x) {
+            const float center = (x + 0.5f) * scale;
+            const int first = int(std::floor(center - radius));
+            float* w = &axis.weight[size_t(x) * axis.taps];
+            uint32_t* idx = &axis.index[size_t(x) * axis.taps];
+            float sum = 0.f;
+            for (uint32_t k = 0; k < axis.taps; ++k) {
+                const int i = first + int(k);
+                float weight;
+                if (box) {
+                    weight = std::max(0.f, std::min(float(i + 1), center + radius) - std::max(float(i), center - radius));
+                }
+                else {
+                    const float t = (i + 0.5f - center) / scale;
+                    if (std::fabs(t) >= halfWidth) {
+                        weight = 0.f;
+                    }
+                    else {
+                        const float sinc = t == 0.f ? 1.f : std::sin(kPi * t) / (kPi * t);
+                        const float r = t / halfWidth;
+                        weight = sinc * float(BesselI0(settings.kaiserAlpha * std::sqrt(1.0 - r * r)) / i0Alpha);
+                    }
+                }
+                w[k] = weight;
+                sum += weight;
+                idx[k] = settings.wrap
+                    ? uint32_t(((i % int(src)) + int(src)) % int(src))
+                    : uint32_t(std::clamp(i, 0, int(src) - 1));
+            }
+            for (uint32_t k = 0; k < axis.taps; ++k)
+                w[k] = sum != 0.f ? w[k] / sum : (k == 0 ? 1.f : 0.f);
+        }
+
+        // drop the leading and trailing taps that are zero for every texel,
+        // a box halving a power of two needs 2 of its 3
+        uint32_t lead = axis.taps, used = 0;
+        for (uint32_t x = 0; x < dst; ++x) {
+            const float* w = &axis.weight[size_t(x) * axis.taps];
+            uint32_t first = axis.taps, last = 0;
+            for (uint32_t k = 0; k < axis.taps; ++k) {
+                if (w[k] == 0.f) continue;
+                first = std::min(first, k);
+                last = k;
+            }
+            if (first == axis.taps) first = last = 0;
+            lead = std::min(lead, first);
+            used = std::max(used, last + 1);
+        }
+        if (lead > 0 || used < axis.taps) {
+            const uint32_t taps = used - lead;
+            for (uint32_t x = 0; x < dst; ++x) {
+                for (uint32_t k = 0; k < taps; ++k) {
+                    axis.weight[size_t(x) * taps + k] = axis.weight[size_t(x) * axis.taps + lead + k];
+                    axis.index[size_t(x) * taps + k] = axis.index[size_t(x) * axis.taps + lead + k];
+                }
+            }
+            axis.taps = taps;
+            axis.weight.resize(size_t(dst) * taps);
+            axis.index.resize(size_t(dst) * taps);
+        }
+        return axis;
+    }
+
+    // out[x] = sum of weight * in[index] over the taps of x, four floats per texel
+    void FilterRowHorizontal(const float* in, const Axis& axis, uint32_t count, float* out, bool simd)
+    {
+        const uint32_t taps = axis.taps;
+        uint32_t x = 0;
+#if MIPGEN_SSE2
+        if (simd) {
+            for (; x < count; ++x) {
+                const float* w = &axis.weight[size_t(x) * taps];
+                const uint32_t* idx = &axis.index[size_t(x) * taps];
+                __m128 acc = _mm_setzero_ps();
+                for (uint32_t k = 0; k < taps; ++k)
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(in + size_t(idx[k]) * 4)));
+                _mm_storeu_ps(out + size_t(x) * 4, acc);
+            }
+        }
+#endif
+        for (; x < count; ++x) {
+            const float* w = &axis.weight[size_t(x) * taps];
+            const uint32_t* idx = &axis.index[size_t(x) * taps];
+            float acc[4] = { 0.f, 0.f, 0.f, 0.f };
+            for (uint32_t k = 0; k < taps; ++k)
+                for (int c = 0; c < 4; ++c)
+                    acc[c] = acc[c] + w[k] * in[size_t(idx[k]) * 4 + c];
+            std::memcpy(out + size_t(x) * 4, acc, sizeof(acc));
+        }
+    }
+
+    // out += weight * row, count floats
+    void AccumulateRow(const float* row, float weight, size_t count, float* out, bool simd)
+    {
+        size_t i = 0;
+#if MIPGEN_SSE2
+        if (simd) {
+            const __m128 w = _mm_set1_ps(weight);
+            for (; i + 4 <= count; i += 4)
+                _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(w, _mm_loadu_ps(row + i))));
+        }
+#endif
+        for (; i < count; ++i)
+            out[i] = out[i] + weight * row[i];
+    }
+
+    size_t RowGrain(uint32_t width)
+    {
+        return std::max<size_t>(1, 4096 / std::max<uint32_t>(width, 1));
+    }
+}
+
+std::vector<const void*> MipGenerator::Chain::LevelPointers() const
+{
+    std::vector<const void*> levels(offsets.size());
+    for (size_t i = 0; i < offsets.size(); ++i)
+        levels[i] = pixels.data() + offsets[i];
+    return levels;
+}
+
+uint32_t MipGenerator::LevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        ++levels;
+    return levels;
+}
+
+MipGenerator::Chain MipGenerator::Generate(const uint8_t* rgba, uint32_t width, uint32_t height,
+    const Settings& settings, Stats* stats)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+
+    Chain chain;
+    chain.width = width;
+    chain.height = height;
+    const uint32_t levels = width && height ? LevelCount(width, height) : 0;
+    size_t bytes = 0;
+    for (uint32_t l = 0; l < levels; ++l) {
+        chain.offsets.push_back(bytes);
+        bytes += size_t(chain.LevelWidth(l)) * chain.LevelHeight(l) * 4;
+    }
+    chain.pixels.resize(bytes);
+    if (levels == 0)
+        return chain;
+    std::memcpy(chain.pixels.data(), rgba, size_t(width) * height * 4);
+
+    const Codec codec(settings.content);
+    const bool simd = settings.simd;
+    JobSystem& jobs = JobSystem::I();
+
+    // the float copy of the previous level; level 0 is decoded a row at a time
+    std::vector<float> source, filtered;
+    uint64_t texelsOut = 0;
+
+    for (uint32_t l = 1; l < levels; ++l) {
+        const uint32_t sw = chain.LevelWidth(l - 1), sh = chain.LevelHeight(l - 1);
+        const uint32_t dw = chain.LevelWidth(l), dh = chain.LevelHeight(l);
+        const Axis ax = BuildAxis(sw, dw, settings);
+        const Axis ay = BuildAxis(sh, dh, settings);
+
+        filtered.resize(size_t(dw) * dh * 4);
+        uint8_t* out = chain.pixels.data() + chain.offsets[l];
+        jobs.ParallelFor(dh, RowGrain(dw), [&](size_t begin, size_t end) {
+            // horizontally filtered source rows, made when a vertical tap first
+            // needs them; consecutive rows share all but a couple of them
+            const uint32_t ringSize = ay.taps + 1;
+            std::vector<float> ring(size_t(ringSize) * dw * 4);
+            std::vector<int64_t> ringRow(ringSize, -1);
+            std::vector<float> decoded(l == 1 ? size_t(sw) * 4 : 0);
+            auto horizontal = [&](uint32_t sy) -> const float* {
+                const uint32_t slot = sy % ringSize;
+                float* row = ring.data() + size_t(slot) * dw * 4;
+                if (ringRow[slot] != int64_t(sy)) {
+                    const float* in = source.data() + size_t(sy) * sw * 4;
+                    if (l == 1) {
+                        codec.DecodeRow(rgba + size_t(sy) * sw * 4, sw, decoded.data());
+                        in = decoded.data();
+                    }
+                    FilterRowHorizontal(in, ax, dw, row, simd);
+                    ringRow[slot] = sy;
+                }
+                return row;
+            };
+
+            for (size_t y = begin; y < end; ++y) {
+                float* row = filtered.data() + y * dw * 4;
+                std::fill(row, row + size_t(dw) * 4, 0.f);
+                const float* w = &ay.weight[y * ay.taps];
+                const uint32_t* idx = &ay.index[y * ay.taps];
+                for (uint32_t k = 0; k < ay.taps; ++k)
+                    if (w[k] != 0.f)
+                        AccumulateRow(horizontal(idx[k]), w[k], size_t(dw) * 4, row, simd);
+                codec.NormalizeRow(row, dw);
+                codec.EncodeRow(row, dw, out + y * dw * 4, simd);
+            }
+        });
+
+        source.swap(filtered);
+        texelsOut += uint64_t(dw) * dh;
+    }
+
+    if (stats) {
+        stats->levels = levels;
+        stats->texelsOut = texelsOut;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    return chain;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// GPU-free mip chain generation for RGBA8 images. Every level is filtered
+// from the one above it in float, two separable passes on the JobSystem,
+// and stored as RGBA8 again.
+namespace MipGenerator
+{
+    enum class Filter : uint8_t
+    {
+        Box,        // area average of the source texels under the destination texel
+        Kaiser,     // Kaiser-windowed sinc, sharper; the default
+    };
+
+    // how texel values combine
+    enum class Content : uint8_t
+    {
+        Color,      // sRGB encoded RGB averaged in linear light, alpha linear
+        Linear,     // the stored values, for masks and metal/rough maps
+        NormalMap,  // xyz in [-1, 1], renormalised on every level; alpha linear
+    };
+
+    struct Settings
+    {
+        Filter filter = Filter::Kaiser;
+        Content content = Content::Color;
+        // edges address like the wrap sampler materials use; clamp otherwise
+        bool wrap = true;
+        // Kaiser support in destination texels and window shape
+        float kaiserWidth = 3.f;
+        float kaiserAlpha = 4.f;
+        // false takes the scalar path, for comparison; the output is the same
+        bool simd = true;
+    };
+
+    struct Stats
+    {
+        uint32_t levels = 0;
+        uint64_t texelsOut = 0;     // below level 0
+        double seconds = 0.0;
+    };
+
+    struct Chain
+    {
+        uint32_t width = 0, height = 0;
+        std::vector<uint8_t> pixels;    // all levels, tightly packed RGBA8 rows
+        std::vector<size_t> offsets;    // per level, in bytes
+
+        uint32_t LevelCount() const { return uint32_t(offsets.size()); }
+        uint32_t LevelWidth(uint32_t level) const { return width >> level ? width >> level : 1; }
+        uint32_t LevelHeight(uint32_t level) const { return height >> level ? height >> level : 1; }
+        const uint8_t* Level(uint32_t level) const { return pixels.data() + offsets[level]; }
+        // one per level, in the order Texture::CreateWithMips takes them
+        std::vector<const void*> LevelPointers() const;
+    };
+
+    // bump when the output of Generate changes
+    constexpr uint32_t kVersion = 1;
+
+    // down to 1x1, sizes halve and round down like D3D12's
+    uint32_t LevelCount(uint32_t width, uint32_t height);
+
+    // Level 0 is a copy of rgba, tightly packed rows of width texels.
+    Chain Generate(const uint8_t* rgba, uint32_t width, uint32_t height,
+        const Settings& settings = {}, Stats* stats = nullptr);
+}
@@ -0,0 +1,406 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "ObjImporter.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+    struct Float2 { float x, y; };
+    struct Float3 { float x, y, z; };
+
+    struct Material {
+        Float3 Kd{ 1,1,1 };
+        Float3 Ks{ 1,1,1 };
+        Float3 Ke{ 0,0,0 };
+        std::string map_Kd;
+        float Ns{ 128.f };
+        float d{ 1.f };
+        std::string map_normal;
+        std::string map_metalRough;
+    };
+
+    inline void Normalize(float& x, float& y, float& z)
+    {
+        const float len = std::sqrt(x * x + y * y + z * z);
+        if (len > 0.f) { x /= len; y /= len; z /= len; }
+        else { x = y = z = 0.f; }
+    }
+}
+
+std::string ObjImporter::JoinPath(const std::string& a, const std::string& b) {
+    if (a.empty()) return b;
+    const char last = a.back();
+    if (last == '/' || last == '\\') return a + b;
+    return a + "/" + b;
+}
+
+static bool parseMtlFile(const std::string& mtlPath, std::unordered_map<std::string, Material>& out) {
+    std::ifstream mtl(mtlPath);
+    if (!mtl.is_open()) {
+        std::cerr << "MTL introuvable: " << mtlPath << "\n";
+        return false;
+    }
+
+    std::string line, tok, cur;
+    while (std::getline(mtl, line)) {
+        std::istringstream iss(line);
+        if (!(iss >> tok)) continue;
+        if (tok == "newmtl") {
+            iss >> cur;
+            out[cur] = Material{};
+        }
+        else if (tok == "Kd" && !cur.empty()) {
+            iss >> out[cur].Kd.x >> out[cur].Kd.y >> out[cur].Kd.z;
+        }
+        else if (tok == "Ks" && !cur.empty()) {
+            iss >> out[cur].Ks.x >> out[cur].Ks.y >> out[cur].Ks.z;
+        }
+        else if (tok == "Ke" && !cur.empty()) {
+            iss >> out[cur].Ke.x >> out[cur].Ke.y >> out[cur].Ke.z;
+        }
+        else if (tok == "Ns" && !cur.empty()) {
+            iss >> out[cur].Ns;
+            if (out[cur].Ns < 16.0f)   out[cur].Ns = 16.0f;
+            if (out[cur].Ns > 256.0f)  out[cur].Ns = 256.0f;
+        }
+        else if (tok == "d" && !cur.empty()) {
+            iss >> out[cur].d;
+            if (out[cur].d < 0.0f) out[cur].d = 0.0f;
+            if (out[cur].d > 1.0f) out[cur].d = 1.0f;
+        }
+        else if (tok == "Tr" && !cur.empty()) {
+            float tr;
+            iss >> tr;
+
+            tr = std::max(0.f, std::min(1.f, tr));
+            out[cur].d = 1.f - tr;
+        }
+        else if (tok == "map_Kd" && !cur.empty()) {
+            iss >> out[cur].map_Kd;
+        }
+        else if ((tok == "map_Bump" || tok == "bump" || tok == "map_normal") && !cur.empty())
+        {
+            iss >> out[cur].map_normal;
+        }
+        else if (tok == "refl" && !cur.empty()) {
+            iss >> out[cur].map_metalRough;
+        }
+    }
+    return true;
+}
+
+static void parseVtxToken(const std::string& tok, int& vi, int& ti, int& ni) {
+    vi = ti = ni = 0;
+    int part = 0;
+    std::string acc;
+    auto flush = [&](void) {
+        if (acc.empty()) { ++part; return; }
+        int val = std::stoi(acc);
+        if (part == 0) vi = val;
+        else if (part == 1) ti = val;
+        else if (part == 2) ni = val;
+        acc.clear(); ++part;
+        };
+    for (char c : tok) {
+        if (c == '/') flush();
+        else acc.push_back(c);
+    }
+    flush();
+}
+
+static uint32_t getIndexForKey(
+    const std::string& token,
+    const std::string& materialKey,
+    const Material* material,
+    std::unordered_map<std::string, uint32_t>& map,
+    uint32_t& next,
+    std::vector<Vertex>& outVertices,
+    const std::vector<Float3>& positions,
+    const std::vector<Float2>& texcoords,
+    const std::vector<Float3>& normals)
+{
+    std::string combinedKey = token;
+    combinedKey.push_back('|');
+    combinedKey += materialKey;
+
+    auto it = map.find(combinedKey);
+    if (it != map.end()) return it->second;
+
+    int vi = 0, ti = 0, ni = 0;
+    parseVtxToken(token, vi, ti, ni);
+
+    Vertex vert{};
+    const auto& p = positions[(vi > 0 ? vi - 1 : 0)];
+    vert.px = p.x; vert.py = p.y; vert.pz = p.z;
+
+    if (ni > 0 && (size_t)(ni - 1) < normals.size()) {
+        const auto& n = normals[ni - 1];
+        vert.nx = n.x; vert.ny = n.y; vert.nz = n.z;
+    }
+    else {
+        vert.nx = 0.0f; vert.ny = 1.0f; vert.nz = 0.0f;
+    }
+
+    if (material) {
+        vert.r = material->Kd.x;
+        vert.g = material->Kd.y;
+        vert.b = material->Kd.z;
+    }
+    else {
+        vert.r = vert.g = vert.b = 1.0f;
+    }
+
+    if (ti > 0 && (size_t)(ti - 1) < texcoords.size()) {
+        const auto& t = texcoords[ti - 1];
+        vert.u = t.x;
+        vert.v = 1.0f - t.y;
+    }
+    else {
+        vert.u = vert.v = 0.0f;
+    }
+
+    outVertices.push_back(vert);
+    map[combinedKey] = next;
+    return next++;
+}
+
+void ObjImporter::RecomputeSmoothNormals(std::vector<Vertex>& verts,
+    const std::vector<uint32_t>& idx)
+{
+    for (auto& v : verts) { v.nx = v.ny = v.nz = 0.0f; }
+
+    for (size_t i = 0; i + 2 < idx.size(); i += 3) {
+        Vertex& a = verts[idx[i]];
+        Vertex& b = verts[idx[i + 1]];
+        Vertex& c = verts[idx[i + 2]];
+
+        const float abx = b.px - a.px, aby = b.py - a.py, abz = b.pz - a.pz;
+        const float acx = c.px - a.px, acy = c.py - a.py, acz = c.pz - a.pz;
+        const float nx = aby * acz - abz * acy;
+        const float ny = abz * acx - abx * acz;
+        const float nz = abx * acy - aby * acx;
+
+        a.nx += nx; a.ny += ny; a.nz += nz;
+        b.nx += nx; b.ny += ny; b.nz += nz;
+        c.nx += nx; c.ny += ny; c.nz += nz;
+    }
+
+    for (auto& v : verts)
+        Normalize(v.nx, v.ny, v.nz);
+}
+
+void ObjImporter::ComputeTangents(std::vector<Vertex>& verts, const std::vector<uint32_t>& idx)
+{
+    for (auto& v : verts) {
+        v.tx = v.ty = v.tz = 0;
+        v.bx = v.by = v.bz = 0;
+    }
+
+    for (size_t i = 0; i + 2 < idx.size(); i += 3) {
+        Vertex& v0 = verts[idx[i]];
+        Vertex& v1 = verts[idx[i + 1]];
+        Vertex& v2 = verts[idx[i + 2]];
+
+        float x1 = v1.px - v0.px;
+        float x2 = v2.px - v0.px;
+        float y1 = v1.py - v0.py;
+        float y2 = v2.py - v0.py;
+        float z1 = v1.pz - v0.pz;
+        float z2 = v2.pz - v0.pz;
+
+        float s1 = v1.u - v0.u;
+        float s2 = v2.u - v0.u;
+        float t1 = v1.v - v0.v;
+        float t2 = v2.v - v0.v;
+
+        float r = 1.0f / (s1 * t2 - s2 * t1);
+
+        const Float3 T{
+            (t2 * x1 - t1 * x2) * r,
+            (t2 * y1 - t1 * y2) * r,
+            (t2 * z1 - t1 * z2) * r
+        };
+
+        const Float3 B{
+            (s1 * x2 - s2 * x1) * r,
+            (s1 * y2 - s2 * y1) * r,
+            (s1 * z2 - s2 * z1) * r
+        };
+
+        for (Vertex* v : { &v0, &v1, &v2 }) {
+            v->tx += T.x; v->ty += T.y; v->tz += T.z;
+            v->bx += B.x; v->by += B.y; v->bz += B.z;
+        }
+    }
+
+    for (auto& v : verts) {
+        Normalize(v.tx, v.ty, v.tz);
+        Normalize(v.bx, v.by, v.bz);
+    }
+}
+
+static MaterialDesc ToMaterialDesc(const Material& m)
+{
+    MaterialDesc d;
+    d.kd[0] = m.Kd.x; d.kd[1] = m.Kd.y; d.kd[2] = m.Kd.z;
+    d.ks[0] = m.Ks.x; d.ks[1] = m.Ks.y; d.ks[2] = m.Ks.z;
+    d.ke[0] = m.Ke.x; d.ke[1] = m.Ke.y; d.ke[2] = m.Ke.z;
+    d.shininess = m.Ns;
+    d.opacity = m.d;
+    d.texture = m.map_Kd;
+    d.normalMap = m.map_normal;
+    d.metalRoughMap = m.map_metalRough;
+    return d;
+}
+
+bool ObjImporter::Import(const std::string& filename, MeshData& out, std::vector<std::string>* dependencies)
+{
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error: unable to open " << filename << std::endl;
+        return false;
+    }
+    if (dependencies)
+        dependencies->push_back(filename);
+
+    const size_t slash = filename.find_last_of("/\\");
+    const std::string baseDir = (slash == std::string::npos) ? "" : filename.substr(0, slash + 1);
+
+    std::vector<Float3> positions;
+    std::vector<Float3> normals;
+    std::vector<Float2> texcoords;
+    std::unordered_map<std::string, Material> materials;
+
+    std::unordered_map<std::string, uint32_t> vertexMap;
+    uint32_t nextIndex = 0;
+
+    std::string currentMaterialName;
+    const Material* currentMaterial = nullptr;
+    bool textureChosen = false;
+
+    auto beginSubmesh = [&](const Material* mat)
+        {
+            SubmeshDesc sm;
+            sm.indexStart = static_cast<uint32_t>(out.indices.size());
+            sm.hasMaterial = mat != nullptr;
+            if (mat)
+                sm.material = ToMaterialDesc(*mat);
+            out.submeshes.push_back(sm);
+        };
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string type;
+        iss >> type;
+
+        if (type == "v") {
+            Float3 pos{};
+            iss >> pos.x >> pos.y >> pos.z;
+            positions.push_back(pos);
+        }
+        else if (type == "vt") {
+            Float2 tex{};
+            iss >> tex.x >> tex.y;
+            texcoords.push_back(tex);
+        }
+        else if (type == "vn") {
+            Float3 n{};
+            iss >> n.x >> n.y >> n.z;
+            normals.push_back(n);
+        }
+        else if (type == "f") {
+            std::vector<std::string> toks;
+            std::string tok;
+            while (iss >> tok) toks.push_back(tok);
+            if (toks.size() < 3) continue;
+
+            if (out.submeshes.empty())
+                beginSubmesh(currentMaterial);
+
+            std::vector<uint32_t> faceIdx;
+            faceIdx.reserve(toks.size());
+            for (auto& t : toks) {
+                uint32_t idx = getIndexForKey(
+                    t,
+                    currentMaterialName,
+                    currentMaterial,
+                    vertexMap,
+                    nextIndex,
+                    out.vertices,
+                    positions,
+                    texcoords,
+                    normals
+                );
+                faceIdx.push_back(idx);
+            }
+
+            for (size_t i = 2; i < faceIdx.size(); ++i) {
+                out.indices.push_back(faceIdx[0]);
+                out.indices.push_back(faceIdx[i - 1]);
+                out.indices.push_back(faceIdx[i]);
+            }
+        }
+        else if (type == "mtllib") {
+            std::string mtlfile;
+            iss >> mtlfile;
+            const std::string mtlPath = JoinPath(baseDir, mtlfile);
+            if (parseMtlFile(mtlPath, materials) && dependencies)
+                dependencies->push_back(mtlPath);
+        }
+        else if (type == "usemtl") {
+            std::string name;
+            iss >> name;
+
+            auto it = materials.find(name);
+            currentMaterialName = name;
+            currentMaterial = (it != materials.end()) ? &it->second : nullptr;
+            if (!out.submeshes.empty()) {
+                auto& last = out.submeshes.back();
+                last.indexCount = static_cast<uint32_t>(out.indices.size() - last.indexStart);
+            }
+
+            beginSubmesh(currentMaterial);
+            if (currentMaterial) {
+                out.shininess = currentMaterial->Ns;
+            }
+
+            if (!textureChosen)
+            {
+                if (currentMaterial)
+                    out.texture = currentMaterial->map_Kd;
+                textureChosen = true;
+            }
+        }
+    }
+
+    if (!out.submeshes.empty()) {
+        auto& last = out.submeshes.back();
+        last.indexCount = static_cast<uint32_t>(out.indices.size() - last.indexStart);
+    }
+
+    const bool hasNormals = !normals.empty();
+    if (!hasNormals) {
+        RecomputeSmoothNormals(out.vertices, out.indices);
+    }
+
+    ComputeTangents(out.vertices, out.indices);
+
+    if (dependencies) {
+        for (const auto& sm : out.submeshes) {
+            for (const std::string* tex : { &sm.material.texture, &sm.material.normalMap, &sm.material.metalRoughMap }) {
+                if (tex->empty()) continue;
+                const std::string texPath = JoinPath(baseDir, *tex);
+                if (std::find(dependencies->begin(), dependencies->end(), texPath) == dependencies->end())
+                    dependencies->push_back(texPath);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// GPU-free Wavefront OBJ/MTL import shared by ResourceCache and the offline
+// AssetCooker. One vertex per distinct (corner token, material) pair,
+// polygons are fanned, smooth normals are generated when the file has none
+// and tangents are always computed.
+namespace ObjImporter
+{
+    // dependencies, when given, receives every file the result was built
+    // from: the OBJ, its MTL libraries and the textures they reference.
+    bool Import(const std::string& path, MeshData& out, std::vector<std::string>* dependencies = nullptr);
+
+    std::string JoinPath(const std::string& dir, const std::string& file);
+
+    // shared with the other importers, idx is a triangle list
+    void RecomputeSmoothNormals(std::vector<Vertex>& verts, const std::vector<uint32_t>& idx);
+    void ComputeTangents(std::vector<Vertex>& verts, const std::vector<uint32_t>& idx);
+}
@@ -17,18 +17,46 @@ cbuffer Scene : register(b0)
 
     float3 uKe;
     float _pad1;
+
+    float4 uTerrainNode;    // TerrainVertex.hlsl only
+    float4 uTerrainMorph;
+    float4 uTerrainMap;
+    float4 uTerrainColor;
+    float4 uTerrainTile;
+
+    float4 uProbeOrigin;    // first probe xyz, 1 / spacing
+    float4 uProbeDims;      // probe counts x, y, z, unused
+
+    float4 uEnvParams;      // last specular mip, intensity, 1 with a metal/rough map, unused
+
+    float4 uTextureRect;    // atlas page scale xy, offset zw; zero scale for a whole texture
+    float4 uNormalRect;
+    float4 uMetalRoughRect;
+
+    uint4 uSlices;          // array slice of the albedo, normal and metal/rough maps, unused
 };
 
-Texture2D uTexture : register(t0);
+// Texture views are arrays, a texture of its own is slice 0; see
+// TextureArrayPool
+Texture2DArray uTexture : register(t0);
 Texture2D uShadowMap : register(t1);
-Texture2D uNormalMap : register(t2);
-Texture2D uMetalRough : register(t3);
+Texture2DArray uNormalMap : register(t2);
+Texture2DArray uMetalRough : register(t3);
+
+// IrradianceVolume::Packed: 14 words per probe, x fastest, holding 27
+// halves of ambient SH (RGB per coefficient, coefficient major)
+ByteAddressBuffer uProbes : register(t4);
+
+// EnvironmentMap: GGX-prefiltered radiance, roughness rising linearly with
+// the mip, and the split-sum BRDF table (x = N.V, y = roughness)
+TextureCube uEnvSpecular : register(t5);
+Texture2DArray uBrdfLut : register(t6);
 
 SamplerState uSampler : register(s0);
 SamplerState uShadowSampler : register(s1);
+SamplerState uClampSampler : register(s2);
 
 static const float3 kLightColor = float3(1.0, 0.98, 0.90);
-static const float3 kAmbient = float3(0.25, 0.25, 0.25);
 static const float SHADOW_MAP_SIZE = 4096.0f;
 
 static const int POISSON_MAX = 32;
@@ -87,6 +115,7 @@ struct VSOut
     float4 shadowPos : TEXCOORD3;
     float3 tangent : TEXCOORD4;
     float3 bitangent : TEXCOORD5;
+    float ao : TEXCOORD6;
 };
 
 float Hash12(float2 p)
@@ -153,6 +182,89 @@ float ComputeShadow(float4 shadowPos, float3 normal, float4 screenPos)
 
     return acc / count;
 }
+void AddProbe(uint3 c, float w, inout float3 sh[9])
+{
+    uint probe = c.x + (uint)uProbeDims.x * (c.y + (uint)uProbeDims.y * c.z);
+    uint addr = probe * 56;
+    uint4 a = uProbes.Load4(addr);
+    uint4 b = uProbes.Load4(addr + 16);
+    uint4 d = uProbes.Load4(addr + 32);
+    uint2 e = uProbes.Load2(addr + 48);
+    uint words[14] = { a.x, a.y, a.z, a.w, b.x, b.y, b.z, b.w, d.x, d.y, d.z, d.w, e.x, e.y };
+
+    [unroll]
+    for (int k = 0; k < 27; ++k)
+    {
+        uint bits = (k & 1) ? (words[k >> 1] >> 16) : (words[k >> 1] & 0xFFFF);
+        sh[k / 3][k % 3] += w * f16tof32(bits);
+    }
+}
+
+// ambient light for normal n at p: trilinear blend of the eight surrounding
+// probes, then the SH evaluated at n (already convolved and divided by pi)
+float3 ProbeAmbient(float3 p, float3 n)
+{
+    float3 dims = uProbeDims.xyz;
+    float3 f = clamp((p - uProbeOrigin.xyz) * uProbeOrigin.w, 0.0, dims - 1.0);
+    uint3 i0 = min((uint3)f, (uint3)dims - 1);
+    uint3 i1 = min(i0 + 1, (uint3)dims - 1);
+    float3 t = f - (float3)i0;
+
+    float3 sh[9];
+    [unroll]
+    for (int k = 0; k < 9; ++k)
+        sh[k] = 0.0;
+
+    [unroll]
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        uint3 upper = uint3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+        float3 w3 = upper ? t : 1.0 - t;
+        AddProbe(upper ? i1 : i0, w3.x * w3.y * w3.z, sh);
+    }
+
+    float3 c = sh[0] * 0.282095
+        + sh[1] * (0.488603 * n.y) + sh[2] * (0.488603 * n.z) + sh[3] * (0.488603 * n.x)
+        + sh[4] * (1.092548 * n.x * n.y) + sh[5] * (1.092548 * n.y * n.z)
+        + sh[6] * (0.315392 * (3.0 * n.z * n.z - 1.0))
+        + sh[7] * (1.092548 * n.x * n.z) + sh[8] * (0.546274 * (n.x * n.x - n.y * n.y));
+    return max(c, 0.0);
+}
+
+// split-sum image-based specular: the radiance prefiltered for roughness
+// along R, times the table's scale and bias of F0
+float3 EnvironmentSpecular(float3 N, float3 V, float3 F0, float roughness)
+{
+    float NdotV = saturate(dot(N, V));
+    float3 R = reflect(-V, N);
+    float3 radiance = uEnvSpecular.SampleLevel(uSampler, R, roughness * uEnvParams.x).rgb;
+    float2 brdf = uBrdfLut.SampleLevel(uClampSampler, float3(NdotV, roughness, 0), 0).rg;
+    return radiance * (F0 * brdf.x + brdf.y) * uEnvParams.y;
+}
+
+// A map packed into a TextureAtlas page wraps inside its rectangle. The
+// gradients are taken before the frac, which would pick the smallest mip
+// along every seam otherwise; the page only holds the first few levels.
+float4 SampleMap(Texture2DArray map, float2 uv, float4 rect, uint slice)
+{
+    float2 dx = ddx(uv);
+    float2 dy = ddy(uv);
+    if (rect.x == 0.0f)
+        return map.Sample(uSampler, float3(uv, slice));
+    return map.SampleGrad(uSampler, float3(rect.zw + frac(uv) * rect.xy, slice), dx * rect.xy, dy * rect.xy);
+}
+
+// tangent-space normal; BC5 normal maps store x and y and read z as 0,
+// which a stored normal never does (it points out of the surface)
+float3 SampleTangentNormal(float2 uv)
+{
+    float3 t = SampleMap(uNormalMap, uv, uNormalRect, uSlices.y).xyz;
+    float3 n = t * 2.0f - 1.0f;
+    if (t.z == 0.0f)
+        n.z = sqrt(saturate(1.0f - dot(n.xy, n.xy)));
+    return n;
+}
+
 #define DEBUG_NODEBUG           0
 #define DEBUG_ALBEDO            1
 #define DEBUG_NORMAL_TANGENT    2
@@ -161,6 +273,9 @@ float ComputeShadow(float4 shadowPos, float3 normal, float4 screenPos)
 #define DEBUG_ROUGHNESS         5
 #define DEBUG_METALROUGH_RGB    6
 #define DEBUG_SPECULAR_PHONG    7
+#define DEBUG_AMBIENT_OCCLUSION 8
+#define DEBUG_IRRADIANCE        9
+#define DEBUG_ENVIRONMENT       10
 
 #define DEBUG_MODE DEBUG_NODEBUG
 
@@ -180,15 +295,13 @@ float4 main(VSOut i) : SV_Target
         T = normalize(T - Ng * dot(T, Ng));
         B = normalize(B - Ng * dot(B, Ng));
         float3x3 TBN = float3x3(T, B, Ng);
-        float3 nTex = uNormalMap.Sample(uSampler, i.uv).xyz;
-        nTex = nTex * 2.0f - 1.0f;
-        N = normalize(mul(nTex, TBN));
+        N = normalize(mul(SampleTangentNormal(i.uv), TBN));
     }
 
-    float4 texSample = uTexture.Sample(uSampler, i.uv);
+    float4 texSample = SampleMap(uTexture, i.uv, uTextureRect, uSlices.x);
     float3 albedo = texSample.rgb * i.col;
 
-    float3 mr = uMetalRough.Sample(uSampler, i.uv).rgb;
+    float3 mr = SampleMap(uMetalRough, i.uv, uMetalRoughRect, uSlices.z).rgb;
     float roughness = saturate(mr.g);
     float metallic = saturate(mr.b);
     float3 L = normalize(uLightDir);
@@ -211,8 +324,7 @@ float4 main(VSOut i) : SV_Target
     return float4(albedo, 1.0);
 
 #elif DEBUG_MODE == DEBUG_NORMAL_TANGENT
-    float3 nTex = uNormalMap.Sample(uSampler, i.uv).xyz;
-    return float4(nTex, 1.0);
+    return float4(SampleTangentNormal(i.uv) * 0.5f + 0.5f, 1.0);
 
 #elif DEBUG_MODE == DEBUG_NORMAL_WORLD
     float3 Nview = N * 0.5f + 0.5f;
@@ -228,12 +340,27 @@ float4 main(VSOut i) : SV_Target
     return float4(mr, 1.0);
 #elif DEBUG_MODE == DEBUG_SPECULAR_PHONG
     return float4(specular, 1.0);
+#elif DEBUG_MODE == DEBUG_AMBIENT_OCCLUSION
+    return float4(i.ao.xxx, 1.0);
+#elif DEBUG_MODE == DEBUG_IRRADIANCE
+    return float4(ProbeAmbient(i.worldPos, N), 1.0);
+#elif DEBUG_MODE == DEBUG_ENVIRONMENT
+    return float4(EnvironmentSpecular(N, V, lerp(float3(0.04, 0.04, 0.04), albedo, metallic), roughness), 1.0);
 
 #else
     
+    // without a metal/rough map the white default would make everything a
+    // rough metal, treat those surfaces as rough dielectrics instead
+    float envMetallic = metallic * uEnvParams.z;
+    float envRoughness = lerp(1.0f, roughness, uEnvParams.z);
+    float3 envF0 = lerp(float3(0.04, 0.04, 0.04), albedo, envMetallic);
+    float3 reflection = EnvironmentSpecular(N, V, envF0, envRoughness) * i.ao;
+    // metals have no diffuse, their ambient comes from the reflection
+    float ambientDiffuse = 1.0f - envMetallic * saturate(uEnvParams.y);
+
     float shadow = ComputeShadow(i.shadowPos, N, i.pos);
-    float3 lighting = kAmbient + shadow * (diffuse + specular);
-    float3 color = albedo * lighting + uKe;
+    float3 lighting = ProbeAmbient(i.worldPos, N) * i.ao * ambientDiffuse + shadow * (diffuse + specular);
+    float3 color = albedo * lighting + reflection + uKe;
     float alpha = texSample.a * uOpacity;
     return float4(color, alpha);
 #endif
@@ -0,0 +1,820 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "PotentiallyVisibleSet.h"
+#include "JobSystem.h"
+#include "MeshBVH.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+    struct Box
+    {
+        float mn[3]{ FLT_MAX, FLT_MAX, FLT_MAX };
+        float mx[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        void Grow(const float p[3])
+        {
+            for (int a = 0; a < 3; ++a) { mn[a] = std::min(mn[a], p[a]); mx[a] = std::max(mx[a], p[a]); }
+        }
+        bool Valid() const { return mn[0] <= mx[0]; }
+
+        // where the ray gets into the box, 0 from inside
+        float Enter(const BVHRay& ray) const
+        {
+            float t0 = 0.f;
+            for (int a = 0; a < 3; ++a)
+                if (ray.dir[a] != 0.f)
+                    t0 = std::max(t0, std::min((mn[a] - ray.origin[a]) / ray.dir[a], (mx[a] - ray.origin[a]) / ray.dir[a]));
+            return t0;
+        }
+    };
+
+    void TransformPoint(const float m[4][4], float x, float y, float z, float out[3])
+    {
+        for (int c = 0; c < 3; ++c)
+            out[c] = x * m[0][c] + y * m[1][c] + z * m[2][c] + m[3][c];
+    }
+
+    // small deterministic generator, seeded per cell
+    struct Random
+    {
+        uint32_t s;
+        explicit Random(uint32_t seed) : s(seed * 0x9E3779B9u + 0x6C8E9CF5u) { if (!s) s = 1; }
+        float Next()
+        {
+            s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+            return float(s >> 8) * (1.f / 16777216.f);
+        }
+    };
+
+    // a ray that got through from a point in a cell to an object
+    struct SightLine
+    {
+        uint32_t cell, object;
+        float from[3], to[3];
+    };
+
+    // any fixed order, so which of several lines is kept does not depend on
+    // the order the workers found them in
+    bool LineBefore(const SightLine& a, const SightLine& b)
+    {
+        if (a.cell != b.cell) return a.cell < b.cell;
+        if (a.object != b.object) return a.object < b.object;
+        if (const int c = std::memcmp(a.from, b.from, sizeof(a.from))) return c < 0;
+        return std::memcmp(a.to, b.to, sizeof(a.to)) < 0;
+    }
+
+    bool SamePair(const SightLine& a, const SightLine& b) { return a.cell == b.cell && a.object == b.object; }
+
+    // calls visit(cell, t) for every cell of the grid the segment a-b
+    // crosses, a + t * (b - a) a point of the segment in that cell
+    template<class Visit>
+    void WalkCells(const float a[3], const float b[3], const float origin[3], float cellSize, const uint32_t dims[3], Visit&& visit)
+    {
+        float d[3], t0 = 0.f, t1 = 1.f;
+        for (int k = 0; k < 3; ++k) {
+            d[k] = b[k] - a[k];
+            const float lo = origin[k], hi = origin[k] + dims[k] * cellSize;
+            if (d[k] == 0.f) {
+                if (a[k] < lo || a[k] > hi) return;
+                continue;
+            }
+            float ta = (lo - a[k]) / d[k], tb = (hi - a[k]) / d[k];
+            if (ta > tb) std::swap(ta, tb);
+            t0 = std::max(t0, ta);
+            t1 = std::min(t1, tb);
+        }
+        if (t0 > t1) return;
+
+        int c[3], step[3];
+        float next[3], delta[3];
+        for (int k = 0; k < 3; ++k) {
+            c[k] = std::clamp(int(std::floor((a[k] + t0 * d[k] - origin[k]) / cellSize)), 0, int(dims[k]) - 1);
+            step[k] = d[k] > 0.f ? 1 : d[k] < 0.f ? -1 : 0;
+            delta[k] = step[k] ? cellSize / std::fabs(d[k]) : FLT_MAX;
+            next[k] = step[k] ? (origin[k] + (c[k] + (step[k] > 0)) * cellSize - a[k]) / d[k] : FLT_MAX;
+        }
+        for (float enter = t0; ; ) {
+            const int k = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+            const float exit = std::min(next[k], t1);
+            visit(uint32_t(c[0] + dims[0] * (size_t(c[1]) + size_t(dims[1]) * c[2])), 0.5f * (enter + exit));
+            if (next[k] > t1) return;
+            enter = next[k];
+            c[k] += step[k];
+            if (c[k] < 0 || c[k] >= int(dims[k])) return;
+            next[k] += delta[k];
+        }
+    }
+
+    void PutVarint(std::vector<uint8_t>& out, uint32_t v)
+    {
+        while (v >= 0x80) { out.push_back(uint8_t(v | 0x80)); v >>= 7; }
+        out.push_back(uint8_t(v));
+    }
+
+    uint32_t GetVarint(const uint8_t*& p, const uint8_t* end)
+    {
+        uint32_t v = 0;
+        for (int shift = 0; p < end && shift < 35; shift += 7) {
+            const uint8_t b = *p++;
+            v |= uint32_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        return v;
+    }
+
+    // A row is a mode byte followed by
+    //   runs:  varint run lengths alternating hidden and visible, hidden first
+    //   bits:  the plain bitset
+    //   gaps:  per visible object the varint count of hidden ones before it
+    //   delta: the varint row it differs from, then the runs, or the gaps,
+    //          of the difference
+    // whichever is smallest. Neighbouring cells see nearly the same objects,
+    // so the difference is usually short; runs suit the contiguous ids of a
+    // room's objects, gaps the scattered ones sampling noise leaves.
+    enum : uint8_t { kRowRuns = 0, kRowBits = 1, kRowDelta = 2, kRowGaps = 3, kRowDeltaGaps = 4 };
+
+    void PutRuns(const uint64_t* bits, uint32_t count, std::vector<uint8_t>& out)
+    {
+        bool visible = false;
+        uint32_t run = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            const bool b = (bits[i >> 6] >> (i & 63)) & 1;
+            if (b != visible) {
+                PutVarint(out, run);
+                visible = b;
+                run = 0;
+            }
+            ++run;
+        }
+        PutVarint(out, run);
+    }
+
+    void PutGaps(const uint64_t* bits, uint32_t count, std::vector<uint8_t>& out)
+    {
+        uint32_t next = 0;
+        for (uint32_t w = 0; w < (count + 63) / 64; ++w)
+            for (uint64_t x = bits[w]; x; x &= x - 1) {
+                const uint32_t i = w * 64 + uint32_t(std::countr_zero(x));
+                PutVarint(out, i - next);
+                next = i + 1;
+            }
+    }
+
+    // XORs the runs into out, which starts cleared or as the base row
+    void ApplyRuns(const uint8_t* p, const uint8_t* end, uint32_t count, uint64_t* out)
+    {
+        uint32_t i = 0;
+        bool visible = false;
+        while (p < end && i < count) {
+            const uint32_t run = std::min(GetVarint(p, end), count - i);
+            if (visible)
+                for (uint32_t k = i; k < i + run; ++k) out[k >> 6] ^= 1ull << (k & 63);
+            i += run;
+            visible = !visible;
+        }
+    }
+
+    // likewise for the gaps
+    void ApplyGaps(const uint8_t* p, const uint8_t* end, uint32_t count, uint64_t* out)
+    {
+        uint64_t i = 0;
+        while (p < end) {
+            i += GetVarint(p, end);
+            if (i >= count) break;
+            out[i >> 6] ^= 1ull << (i & 63);
+            ++i;
+        }
+    }
+
+    // runs or gaps of bits after the mode byte, whichever is shorter
+    void PutSet(const uint64_t* bits, uint32_t count, uint8_t runsMode, uint8_t gapsMode,
+        const std::vector<uint8_t>& prefix, std::vector<uint8_t>& out, std::vector<uint8_t>& scratch)
+    {
+        out.assign(1, runsMode);
+        out.insert(out.end(), prefix.begin(), prefix.end());
+        PutRuns(bits, count, out);
+        scratch.assign(1, gapsMode);
+        scratch.insert(scratch.end(), prefix.begin(), prefix.end());
+        PutGaps(bits, count, scratch);
+        if (scratch.size() < out.size())
+            out.swap(scratch);
+    }
+
+    uint32_t WidthFor(uint64_t maxValue, uint32_t narrowest)
+    {
+        for (uint32_t bytes = narrowest; bytes < 4; bytes *= 2)
+            if (maxValue < (1ull << (8 * bytes))) return bytes;
+        return 4;
+    }
+
+    void PutUint(std::vector<uint8_t>& out, uint32_t v, uint32_t bytes)
+    {
+        for (uint32_t b = 0; b < bytes; ++b) out.push_back(uint8_t(v >> (8 * b)));
+    }
+
+    uint32_t GetUint(const uint8_t* p, uint32_t bytes)
+    {
+        uint32_t v = 0;
+        for (uint32_t b = 0; b < bytes; ++b) v |= uint32_t(p[b]) << (8 * b);
+        return v;
+    }
+}
+
+PotentiallyVisibleSet::Stats PotentiallyVisibleSet::Build(const std::vector<Object>& objects, const Settings& settings)
+{
+    Stats stats;
+    const auto t0 = std::chrono::steady_clock::now();
+
+    *this = PotentiallyVisibleSet{};
+    m_objectCount = uint32_t(objects.size());
+    if (objects.empty()) return stats;
+
+    // ---- world space occluders and object bounds ------------------------------
+
+    std::vector<Vertex> worldVertices;
+    std::vector<uint32_t> worldIndices;
+    std::vector<uint32_t> triangleObject;
+    std::vector<Box> bounds(objects.size());
+    // world corners of every object's triangles, occluder or not, for the
+    // border rays to aim at; object o owns [surfaceFirst[o], surfaceFirst[o + 1])
+    std::vector<float> surface;
+    std::vector<uint32_t> surfaceFirst(objects.size() + 1, 0);
+    std::vector<float> transformed;
+    Box scene;
+    for (size_t o = 0; o < objects.size(); ++o) {
+        const Object& obj = objects[o];
+        const uint32_t base = uint32_t(worldVertices.size());
+        transformed.resize(obj.vertexCount * 3);
+        for (size_t i = 0; i < obj.vertexCount; ++i) {
+            float* p = &transformed[i * 3];
+            TransformPoint(obj.world, obj.vertices[i].px, obj.vertices[i].py, obj.vertices[i].pz, p);
+            bounds[o].Grow(p);
+            if (obj.occluder) {
+                Vertex v{};
+                v.px = p[0]; v.py = p[1]; v.pz = p[2];
+                worldVertices.push_back(v);
+            }
+        }
+        if (bounds[o].Valid()) { scene.Grow(bounds[o].mn); scene.Grow(bounds[o].mx); }
+        for (size_t i = 0; i + 2 < obj.indexCount; i += 3) {
+            if (obj.indices[i] >= obj.vertexCount || obj.indices[i + 1] >= obj.vertexCount || obj.indices[i + 2] >= obj.vertexCount)
+                continue;
+            for (int k = 0; k < 3; ++k)
+                surface.insert(surface.end(), &transformed[obj.indices[i + k] * 3], &transformed[obj.indices[i + k] * 3] + 3);
+            if (!obj.occluder) continue;
+            for (int k = 0; k < 3; ++k) worldIndices.push_back(base + obj.indices[i + k]);
+            triangleObject.push_back(uint32_t(o));
+        }
+        surfaceFirst[o + 1] = uint32_t(surface.size() / 9);
+    }
+    if (!scene.Valid()) { *this = PotentiallyVisibleSet{}; return stats; }
+
+    // ---- grid -----------------------------------------------------------------
+
+    float extent[3];
+    for (int a = 0; a < 3; ++a) extent[a] = std::max(scene.mx[a] - scene.mn[a], 1e-3f);
+    m_cellSize = std::max(settings.cellSize, 1e-3f);
+    for (;;) {
+        uint64_t total = 1;
+        for (int a = 0; a < 3; ++a) {
+            m_dims[a] = std::max(1u, uint32_t(std::ceil(extent[a] / m_cellSize)));
+            total *= m_dims[a];
+        }
+        if (total <= std::max(1u, settings.maxCells)) break;
+        m_cellSize *= 1.25f;
+    }
+    // centre the grid on the scene
+    for (int a = 0; a < 3; ++a)
+        m_origin[a] = 0.5f * (scene.mn[a] + scene.mx[a]) - 0.5f * m_dims[a] * m_cellSize;
+
+    const uint32_t cellCount = m_dims[0] * m_dims[1] * m_dims[2];
+    const uint32_t objectWords = (m_objectCount + 63) / 64;
+
+    MeshBVH bvh;
+    if (!worldIndices.empty())
+        bvh.Build(worldVertices.data(), worldIndices.data(), worldIndices.size());
+
+    // ---- sampling -------------------------------------------------------------
+
+    // Rays go from random points in the cell to random points in the bounds
+    // of each object not yet found visible, so a distant object seen through
+    // a gap is as likely to be found as a near one. A ray whose first hit is
+    // the object itself, or that gets into the object's bounds before
+    // hitting anything, makes it visible; at is where it got to. Counting
+    // the bounds keeps slivers of a wall seen past the corner of another.
+    std::vector<uint64_t> rows(size_t(cellCount) * objectWords, 0);
+    std::atomic<uint64_t> traced{ 0 };
+    const uint32_t rays = std::max(1u, settings.raysPerObject);
+    auto reaches = [&](const BVHRay& ray, uint32_t o, float& at) {
+        BVHHit hit;
+        if (!bvh.Intersect(ray, hit)) { at = 1.f; return true; }
+        if (triangleObject[hit.triangle] == o) { at = hit.t; return true; }
+        at = bounds[o].Enter(ray);
+        return hit.t >= at;
+    };
+    std::vector<SightLine> lines;
+    std::mutex linesLock;
+    auto keepLines = [&](std::vector<SightLine>& local, std::vector<SightLine>& into) {
+        std::lock_guard<std::mutex> lock(linesLock);
+        into.insert(into.end(), local.begin(), local.end());
+    };
+
+    JobSystem::I().ParallelFor(cellCount, 4, [&](size_t begin, size_t end) {
+        uint64_t local = 0;
+        std::vector<SightLine> found;
+        for (size_t cell = begin; cell < end; ++cell) {
+            uint64_t* row = &rows[cell * objectWords];
+            const uint32_t c[3] = {
+                uint32_t(cell % m_dims[0]), uint32_t(cell / m_dims[0] % m_dims[1]), uint32_t(cell / (size_t(m_dims[0]) * m_dims[1])) };
+            Random rng{ uint32_t(cell) };
+            for (uint32_t o = 0; o < m_objectCount; ++o) {
+                const Box& box = bounds[o];
+                if (!box.Valid()) continue;
+                for (uint32_t r = 0; r < rays; ++r) {
+                    BVHRay ray;
+                    for (int a = 0; a < 3; ++a) {
+                        ray.origin[a] = m_origin[a] + (c[a] + rng.Next()) * m_cellSize;
+                        ray.dir[a] = box.mn[a] + rng.Next() * (box.mx[a] - box.mn[a]) - ray.origin[a];
+                    }
+                    ray.tMax = 1.f;
+                    ++local;
+                    if (bvh.Empty()) {
+                        row[o >> 6] |= 1ull << (o & 63);
+                        break;
+                    }
+                    float at;
+                    if (reaches(ray, o, at)) {
+                        row[o >> 6] |= 1ull << (o & 63);
+                        SightLine& line = found.emplace_back();
+                        line.cell = uint32_t(cell);
+                        line.object = o;
+                        for (int a = 0; a < 3; ++a) {
+                            line.from[a] = ray.origin[a];
+                            line.to[a] = ray.origin[a] + at * ray.dir[a];
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        traced.fetch_add(local, std::memory_order_relaxed);
+        keepLines(found, lines);
+    });
+
+    // ---- sight lines ----------------------------------------------------------
+
+    // The end of a line that got through is seen from every point up to the
+    // first occluder along the line, on past its origin, and along the lines
+    // from it toward the cells around that origin. The cells those cross see
+    // the object too, which carries a view through a chain of doorways into
+    // cells whose own rays all missed it. Lines leaving through the object
+    // itself see it from the far side and go on.
+    constexpr uint32_t kLineSpread = 8;
+    auto countVisible = [&]() {
+        uint64_t n = 0;
+        for (uint64_t bits : rows) n += uint64_t(std::popcount(bits));
+        return n;
+    };
+    const float reach = m_cellSize * std::sqrt(float(m_dims[0]) * m_dims[0] + float(m_dims[1]) * m_dims[1] + float(m_dims[2]) * m_dims[2]);
+    uint64_t lineFound = 0;
+    auto followLines = [&]() {
+        const uint64_t before = countVisible();
+        std::vector<SightLine> spawned;
+        std::vector<uint64_t> known;
+        while (!lines.empty()) {
+            // a cell a line reaches first in this round continues from there
+            known = rows;
+            JobSystem::I().ParallelFor(lines.size(), 64, [&](size_t begin, size_t end) {
+                uint64_t local = 0;
+                std::vector<SightLine> found;
+                for (size_t i = begin; i < end; ++i) {
+                    const SightLine& line = lines[i];
+                    const size_t word = line.object >> 6;
+                    const uint64_t bit = 1ull << (line.object & 63);
+                    Random rng{ line.object ^ std::bit_cast<uint32_t>(line.from[0]) ^ std::bit_cast<uint32_t>(line.from[2]) * 31u };
+                    for (uint32_t k = 0; k <= kLineSpread; ++k) {
+                        BVHRay ray;
+                        float length = 0.f;
+                        for (int a = 0; a < 3; ++a) {
+                            const float toward = k ? line.from[a] + (rng.Next() * 3.f - 1.5f) * m_cellSize : line.from[a];
+                            ray.origin[a] = line.to[a];
+                            ray.dir[a] = toward - line.to[a];
+                            length += ray.dir[a] * ray.dir[a];
+                        }
+                        if (length <= 0.f) continue;
+                        ray.tMax = reach / std::sqrt(length);
+                        float t = ray.tMax;
+                        for (int pass = 0; pass < 4; ++pass) {
+                            BVHHit hit;
+                            ++local;
+                            if (!bvh.Intersect(ray, hit)) break;
+                            if (triangleObject[hit.triangle] != line.object) { t = hit.t; break; }
+                            for (int a = 0; a < 3; ++a) ray.origin[a] += hit.t * ray.dir[a];
+                            ray.tMax -= hit.t;
+                        }
+                        float stop[3];
+                        for (int a = 0; a < 3; ++a) stop[a] = ray.origin[a] + std::min(t, ray.tMax) * ray.dir[a];
+                        WalkCells(line.to, stop, m_origin, m_cellSize, m_dims, [&](uint32_t cell, float at) {
+                            std::atomic_ref<uint64_t>(rows[cell * objectWords + word]).fetch_or(bit, std::memory_order_relaxed);
+                            if (known[cell * objectWords + word] & bit) return;
+                            SightLine& more = found.emplace_back();
+                            more.cell = cell;
+                            more.object = line.object;
+                            for (int a = 0; a < 3; ++a) {
+                                more.from[a] = line.to[a] + at * (stop[a] - line.to[a]);
+                                more.to[a] = line.to[a];
+                            }
+                        });
+                    }
+                }
+                traced.fetch_add(local, std::memory_order_relaxed);
+                std::sort(found.begin(), found.end(), LineBefore);
+                found.erase(std::unique(found.begin(), found.end(), SamePair), found.end());
+                keepLines(found, spawned);
+            });
+            std::sort(spawned.begin(), spawned.end(), LineBefore);
+            spawned.erase(std::unique(spawned.begin(), spawned.end(), SamePair), spawned.end());
+            lines.swap(spawned);
+            spawned.clear();
+        }
+        lineFound += countVisible() - before;
+    };
+    followLines();
+
+    // ---- border pairs ---------------------------------------------------------
+
+    // What a neighbouring cell sees and this one missed is mostly seen
+    // through a narrow gap, a doorway edge or a slot between props, that a
+    // few rays at the object's bounds rarely find. Those pairs get
+    // borderRays more tries, aimed at random points of the object's own
+    // triangles, which bounds samples mostly miss for thin objects. What
+    // those find is followed along its sight line and spreads the same way
+    // to the next cells until a pass finds nothing new; each pair is tried
+    // once.
+    uint32_t borderFound = 0;
+    if (settings.borderRays > 0 && !bvh.Empty()) {
+        std::vector<uint64_t> tried = rows;
+        std::vector<uint64_t> sampled;
+        for (uint32_t pass = 0; ; ++pass) {
+            sampled = rows;
+            std::atomic<uint32_t> passFound{ 0 };
+            JobSystem::I().ParallelFor(cellCount, 1, [&](size_t begin, size_t end) {
+                std::vector<uint64_t> border(objectWords);
+                std::vector<SightLine> found;
+                uint64_t local = 0;
+                uint32_t hits = 0;
+                for (size_t cell = begin; cell < end; ++cell) {
+                    const int c[3] = { int(cell % m_dims[0]), int(cell / m_dims[0] % m_dims[1]), int(cell / (size_t(m_dims[0]) * m_dims[1])) };
+                    std::fill(border.begin(), border.end(), 0);
+                    for (int dz = -1; dz <= 1; ++dz)
+                        for (int dy = -1; dy <= 1; ++dy)
+                            for (int dx = -1; dx <= 1; ++dx) {
+                                const int n[3] = { c[0] + dx, c[1] + dy, c[2] + dz };
+                                if ((!dx && !dy && !dz) || n[0] < 0 || n[1] < 0 || n[2] < 0
+                                    || n[0] >= int(m_dims[0]) || n[1] >= int(m_dims[1]) || n[2] >= int(m_dims[2]))
+                                    continue;
+                                const uint64_t* other = &sampled[(size_t(n[0]) + m_dims[0] * (size_t(n[1]) + size_t(m_dims[1]) * n[2])) * objectWords];
+                                for (uint32_t w = 0; w < objectWords; ++w) border[w] |= other[w];
+                            }
+                    uint64_t* row = &rows[cell * objectWords];
+                    uint64_t* done = &tried[cell * objectWords];
+                    for (uint32_t w = 0; w < objectWords; ++w) {
+                        border[w] &= ~(done[w] | row[w]);
+                        done[w] |= border[w];
+                    }
+
+                    Random rng{ (uint32_t(cell) ^ 0x5BD1E995u) + pass * 0x9E3779B9u };
+                    for (uint32_t w = 0; w < objectWords; ++w)
+                        for (uint64_t bits = border[w]; bits; bits &= bits - 1) {
+                            const uint32_t o = w * 64 + uint32_t(std::countr_zero(bits));
+                            const uint32_t first = surfaceFirst[o], triangles = surfaceFirst[o + 1] - first;
+                            if (!triangles) continue;
+                            for (uint32_t r = 0; r < settings.borderRays; ++r) {
+                                const float* t = &surface[size_t(first + std::min(triangles - 1, uint32_t(rng.Next() * triangles))) * 9];
+                                float u = rng.Next(), v = rng.Next();
+                                if (u + v > 1.f) { u = 1.f - u; v = 1.f - v; }
+                                BVHRay ray;
+                                for (int a = 0; a < 3; ++a) {
+                                    ray.origin[a] = m_origin[a] + (c[a] + rng.Next()) * m_cellSize;
+                                    ray.dir[a] = t[a] + u * (t[3 + a] - t[a]) + v * (t[6 + a] - t[a]) - ray.origin[a];
+                                }
+                                ray.tMax = 1.f;
+                                ++local;
+                                float at;
+                                if (reaches(ray, o, at)) {
+                                    row[w] |= 1ull << (o & 63);
+                                    SightLine& line = found.emplace_back();
+                                    line.cell = uint32_t(cell);
+                                    line.object = o;
+                                    for (int a = 0; a < 3; ++a) {
+                                        line.from[a] = ray.origin[a];
+                                        line.to[a] = ray.origin[a] + at * ray.dir[a];
+                                    }
+                                    ++hits;
+                                    break;
+                                }
+                            }
+                        }
+                }
+                traced.fetch_add(local, std::memory_order_relaxed);
+                passFound.fetch_add(hits, std::memory_order_relaxed);
+                keepLines(found, lines);
+            });
+            borderFound += passFound.load();
+            followLines();
+            if (rows == sampled) break;
+        }
+    }
+
+    if (settings.dilate) {
+        const std::vector<uint64_t> source = rows;
+        JobSystem::I().ParallelFor(cellCount, 64, [&](size_t begin, size_t end) {
+            for (size_t cell = begin; cell < end; ++cell) {
+                const int c[3] = { int(cell % m_dims[0]), int(cell / m_dims[0] % m_dims[1]), int(cell / (size_t(m_dims[0]) * m_dims[1])) };
+                uint64_t* row = &rows[cell * objectWords];
+                for (int dz = -1; dz <= 1; ++dz)
+                    for (int dy = -1; dy <= 1; ++dy)
+                        for (int dx = -1; dx <= 1; ++dx) {
+                            const int n[3] = { c[0] + dx, c[1] + dy, c[2] + dz };
+                            if ((!dx && !dy && !dz) || n[0] < 0 || n[1] < 0 || n[2] < 0
+                                || n[0] >= int(m_dims[0]) || n[1] >= int(m_dims[1]) || n[2] >= int(m_dims[2]))
+                                continue;
+                            const uint64_t* other = &source[(size_t(n[0]) + m_dims[0] * (size_t(n[1]) + size_t(m_dims[1]) * n[2])) * objectWords];
+                            for (uint32_t w = 0; w < objectWords; ++w) row[w] |= other[w];
+                        }
+            }
+        });
+    }
+
+    // ---- merging --------------------------------------------------------------
+
+    // Runs of cells along x share the union of their rows while that adds at
+    // most mergeSlack of the objects to any of them. Only ever adds
+    // visibility, and turns sampling noise into identical rows.
+    const uint32_t slack = uint32_t(std::max(0.f, settings.mergeSlack) * m_objectCount);
+    if (slack > 0) {
+        auto popcount = [&](const uint64_t* r) {
+            uint32_t n = 0;
+            for (uint32_t w = 0; w < objectWords; ++w)
+                for (uint64_t x = r[w]; x; x &= x - 1) ++n;
+            return n;
+        };
+        const uint32_t lines = m_dims[1] * m_dims[2];
+        JobSystem::I().ParallelFor(lines, 16, [&](size_t begin, size_t end) {
+            std::vector<uint64_t> group(objectWords), candidate(objectWords);
+            for (size_t line = begin; line < end; ++line) {
+                uint64_t* first = &rows[line * m_dims[0] * objectWords];
+                uint32_t start = 0;
+                while (start < m_dims[0]) {
+                    std::copy(first + size_t(start) * objectWords, first + size_t(start + 1) * objectWords, group.begin());
+                    uint32_t fewest = popcount(group.data()), next = start + 1;
+                    for (; next < m_dims[0]; ++next) {
+                        const uint64_t* r = first + size_t(next) * objectWords;
+                        for (uint32_t w = 0; w < objectWords; ++w) candidate[w] = group[w] | r[w];
+                        const uint32_t least = std::min(fewest, popcount(r));
+                        if (popcount(candidate.data()) - least > slack) break;
+                        group.swap(candidate);
+                        fewest = least;
+                    }
+                    for (uint32_t x = start; x < next; ++x)
+                        std::copy(group.begin(), group.end(), first + size_t(x) * objectWords);
+                    start = next;
+                }
+            }
+        });
+    }
+
+    // ---- encoding -------------------------------------------------------------
+
+    // Rows are deduplicated first. A new row may be stored as its difference
+    // to the row of the previous cell along x, y or z, or rather to that
+    // row's base, so decoding never follows more than one delta.
+    std::unordered_map<std::string_view, uint32_t> unique;
+    std::vector<uint32_t> cellRow(cellCount), rowOffsets, rowCell, rowBase;
+    std::vector<uint64_t> diff(objectWords);
+    std::vector<uint8_t> best, candidate, scratch, prefix;
+    const uint32_t bitBytes = (m_objectCount + 7) / 8;
+    const size_t strides[3] = { 1, m_dims[0], size_t(m_dims[0]) * m_dims[1] };
+    uint64_t visibleSum = 0;
+    for (uint32_t cell = 0; cell < cellCount; ++cell) {
+        const uint64_t* row = &rows[size_t(cell) * objectWords];
+        for (uint32_t w = 0; w < objectWords; ++w) visibleSum += uint64_t(std::popcount(row[w]));
+        const std::string_view key(reinterpret_cast<const char*>(row), objectWords * sizeof(uint64_t));
+        auto [it, inserted] = unique.emplace(key, uint32_t(rowOffsets.size()));
+        cellRow[cell] = it->second;
+        if (!inserted) continue;
+
+        prefix.clear();
+        PutSet(row, m_objectCount, kRowRuns, kRowGaps, prefix, best, scratch);
+        if (best.size() > 1 + bitBytes) {
+            best.assign(1, kRowBits);
+            for (uint32_t i = 0; i < bitBytes; ++i) best.push_back(uint8_t(row[i >> 3] >> ((i & 7) * 8)));
+        }
+        uint32_t base = it->second;
+        const uint32_t c[3] = { cell % m_dims[0], cell / m_dims[0] % m_dims[1], uint32_t(cell / strides[2]) };
+        for (int a = 0; a < 3; ++a) {
+            if (c[a] == 0) continue;
+            const uint32_t other = rowBase[cellRow[cell - strides[a]]];
+            const uint64_t* otherRow = &rows[size_t(rowCell[other]) * objectWords];
+            for (uint32_t w = 0; w < objectWords; ++w) diff[w] = row[w] ^ otherRow[w];
+            prefix.clear();
+            PutVarint(prefix, other);
+            PutSet(diff.data(), m_objectCount, kRowDelta, kRowDeltaGaps, prefix, candidate, scratch);
+            if (candidate.size() < best.size()) {
+                best.swap(candidate);
+                base = other;
+            }
+        }
+
+        rowOffsets.push_back(uint32_t(m_rowData.size()));
+        rowCell.push_back(cell);
+        rowBase.push_back(base);
+        m_rowData.insert(m_rowData.end(), best.begin(), best.end());
+    }
+    rowOffsets.push_back(uint32_t(m_rowData.size()));
+
+    const uint32_t rowCount = uint32_t(rowCell.size());
+    m_cellCount = cellCount;
+    m_cellRowBytes = WidthFor(rowCount - 1, 1);
+    m_offsetBytes = WidthFor(m_rowData.size(), 2);
+    const size_t encoded = size_t(cellCount) * m_cellRowBytes + size_t(rowCount + 1) * m_offsetBytes + m_rowData.size();
+    if (encoded >= size_t(cellCount) * bitBytes) {
+        // scattered visibility that does not repeat: plain bits are smaller
+        m_cellRowBytes = m_offsetBytes = 0;
+        m_rowData.clear();
+        m_rowData.reserve(size_t(cellCount) * bitBytes);
+        for (uint32_t cell = 0; cell < cellCount; ++cell)
+            for (uint32_t i = 0; i < bitBytes; ++i)
+                m_rowData.push_back(uint8_t(rows[size_t(cell) * objectWords + (i >> 3)] >> ((i & 7) * 8)));
+    }
+    else {
+        m_cellRows.reserve(size_t(cellCount) * m_cellRowBytes);
+        for (uint32_t r : cellRow) PutUint(m_cellRows, r, m_cellRowBytes);
+        m_rowOffsets.reserve(size_t(rowCount + 1) * m_offsetBytes);
+        for (uint32_t o : rowOffsets) PutUint(m_rowOffsets, o, m_offsetBytes);
+    }
+
+    stats.cells = cellCount;
+    stats.rays = traced.load();
+    stats.borderFound = borderFound;
+    stats.lineFound = uint32_t(lineFound);
+    stats.rawBytes = size_t(cellCount) * bitBytes;
+    stats.encodedBytes = MemoryBytes();
+    stats.uniqueRows = m_cellRowBytes ? rowCount : cellCount;
+    stats.averageVisible = float(double(visibleSum) / (double(cellCount) * m_objectCount));
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return stats;
+}
+
+size_t PotentiallyVisibleSet::MemoryBytes() const
+{
+    return m_cellRows.size() + m_rowOffsets.size() + m_rowData.size();
+}
+
+uint32_t PotentiallyVisibleSet::CellAt(const float p[3]) const
+{
+    if (!m_cellCount) return kNoCell;
+    uint32_t c[3];
+    for (int a = 0; a < 3; ++a) {
+        const float f = std::floor((p[a] - m_origin[a]) / m_cellSize);
+        if (!(f >= 0.f) || f >= float(m_dims[a])) return kNoCell;
+        c[a] = uint32_t(f);
+    }
+    return c[0] + m_dims[0] * (c[1] + m_dims[1] * c[2]);
+}
+
+void PotentiallyVisibleSet::DecodeCell(uint32_t cell, std::vector<uint64_t>& out) const
+{
+    out.assign((m_objectCount + 63) / 64, 0);
+    if (cell >= m_cellCount) return;
+    if (!m_cellRowBytes) {
+        const uint32_t bitBytes = (m_objectCount + 7) / 8;
+        const uint8_t* p = m_rowData.data() + size_t(cell) * bitBytes;
+        for (uint32_t i = 0; i < bitBytes; ++i)
+            out[i >> 3] |= uint64_t(p[i]) << ((i & 7) * 8);
+        return;
+    }
+    DecodeRow(GetUint(&m_cellRows[size_t(cell) * m_cellRowBytes], m_cellRowBytes), out.data(), true);
+}
+
+void PotentiallyVisibleSet::DecodeRow(uint32_t row, uint64_t* out, bool allowDelta) const
+{
+    const uint8_t* p = m_rowData.data() + GetUint(&m_rowOffsets[size_t(row) * m_offsetBytes], m_offsetBytes);
+    const uint8_t* end = m_rowData.data() + GetUint(&m_rowOffsets[size_t(row + 1) * m_offsetBytes], m_offsetBytes);
+    if (p == end) return;
+    const uint8_t mode = *p++;
+    switch (mode) {
+    case kRowRuns:
+        ApplyRuns(p, end, m_objectCount, out);
+        break;
+    case kRowGaps:
+        ApplyGaps(p, end, m_objectCount, out);
+        break;
+    case kRowBits:
+        for (uint32_t i = 0; p < end && i < (m_objectCount + 7) / 8; ++i, ++p)
+            out[i >> 3] |= uint64_t(*p) << ((i & 7) * 8);
+        break;
+    case kRowDelta:
+    case kRowDeltaGaps: {
+        // bases are never deltas themselves, a file claiming so decodes empty
+        const uint32_t base = GetVarint(p, end);
+        if (!allowDelta || base >= RowCount()) break;
+        DecodeRow(base, out, false);
+        if (mode == kRowDelta) ApplyRuns(p, end, m_objectCount, out);
+        else ApplyGaps(p, end, m_objectCount, out);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+bool PotentiallyVisibleSet::Save(const std::string& path) const
+{
+    const uint32_t header[11] = { kMagic, kVersion, m_objectCount, m_dims[0], m_dims[1], m_dims[2],
+        m_cellRowBytes, m_offsetBytes, uint32_t(m_cellRows.size()), uint32_t(m_rowOffsets.size()), uint32_t(m_rowData.size()) };
+    const float grid[4] = { m_origin[0], m_origin[1], m_origin[2], m_cellSize };
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.is_open()) return false;
+        f.write(reinterpret_cast<const char*>(header), sizeof(header));
+        f.write(reinterpret_cast<const char*>(grid), sizeof(grid));
+        f.write(reinterpret_cast<const char*>(m_cellRows.data()), std::streamsize(m_cellRows.size()));
+        f.write(reinterpret_cast<const char*>(m_rowOffsets.data()), std::streamsize(m_rowOffsets.size()));
+        f.write(reinterpret_cast<const char*>(m_rowData.data()), std::streamsize(m_rowData.size()));
+        if (!f.good()) return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool PotentiallyVisibleSet::Load(const std::string& path)
+{
+    *this = PotentiallyVisibleSet{};
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open()) return false;
+
+    uint32_t header[11];
+    float grid[4];
+    if (!f.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != kMagic || header[1] != kVersion)
+        return false;
+    if (!f.read(reinterpret_cast<char*>(grid), sizeof(grid)))
+        return false;
+
+    const uint64_t cells = uint64_t(header[3]) * header[4] * header[5];
+    const uint32_t cellRowBytes = header[6], offsetBytes = header[7];
+    const uint64_t bitBytes = (uint64_t(header[2]) + 7) / 8;
+    if (cells == 0 || cells > UINT32_MAX || !(grid[3] > 0.f)) return false;
+    if (cellRowBytes == 0) {
+        if (offsetBytes || header[8] || header[9] || header[10] != cells * bitBytes) return false;
+    }
+    else if ((cellRowBytes != 1 && cellRowBytes != 2 && cellRowBytes != 4) || (offsetBytes != 2 && offsetBytes != 4)
+        || header[8] != cells * cellRowBytes || header[9] % offsetBytes || header[9] < 2 * offsetBytes) {
+        return false;
+    }
+
+    PotentiallyVisibleSet pvs;
+    pvs.m_objectCount = header[2];
+    for (int a = 0; a < 3; ++a) { pvs.m_dims[a] = header[3 + a]; pvs.m_origin[a] = grid[a]; }
+    pvs.m_cellSize = grid[3];
+    pvs.m_cellCount = uint32_t(cells);
+    pvs.m_cellRowBytes = cellRowBytes;
+    pvs.m_offsetBytes = offsetBytes;
+    pvs.m_cellRows.resize(header[8]);
+    pvs.m_rowOffsets.resize(header[9]);
+    pvs.m_rowData.resize(header[10]);
+    f.read(reinterpret_cast<char*>(pvs.m_cellRows.data()), std::streamsize(pvs.m_cellRows.size()));
+    f.read(reinterpret_cast<char*>(pvs.m_rowOffsets.data()), std::streamsize(pvs.m_rowOffsets.size()));
+    f.read(reinterpret_cast<char*>(pvs.m_rowData.data()), std::streamsize(pvs.m_rowData.size()));
+    if (!f) return false;
+
+    // a corrupt file must not index out of bounds
+    if (cellRowBytes) {
+        const uint32_t rows = pvs.RowCount();
+        for (uint32_t cell = 0; cell < pvs.m_cellCount; ++cell)
+            if (GetUint(&pvs.m_cellRows[size_t(cell) * cellRowBytes], cellRowBytes) >= rows) return false;
+        uint32_t previous = 0;
+        for (uint32_t r = 0; r <= rows; ++r) {
+            const uint32_t offset = GetUint(&pvs.m_rowOffsets[size_t(r) * offsetBytes], offsetBytes);
+            if (offset > pvs.m_rowData.size() || offset < previous) return false;
+            previous = offset;
+        }
+    }
+
+    *this = std::move(pvs);
+    return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// GPU-free precomputed visibility for static scenes. The scene bounds are
+// cut into a uniform grid of view cells; from each cell, rays from random
+// points in the cell to random points in an object's bounds are traced
+// against the occluders, and the object is visible when one gets into its
+// bounds. Every such ray is followed back along its line and fanned out
+// from the point it reached, so what one cell sees through a chain of
+// doorways reaches the cells along the way. Objects a neighbouring cell
+// sees but this one missed get many more rays, aimed at points on their
+// triangles. Per-cell object bitsets are
+// deduplicated and stored as runs, as the gaps between visible objects, as
+// bits, or as the runs or gaps of their difference to a neighbouring cell's
+// row, whichever is smallest; when all that is not smaller than one bit per
+// object and cell, the cells are stored as plain bits.
+//
+// Sampling is an estimate: small gaps can be missed with too few rays, the
+// sight lines, the extra rays for borderline objects and the default
+// dilation by the neighbouring cells hide that.
+class PotentiallyVisibleSet
+{
+public:
+    static constexpr uint32_t kMagic = 0x31535650; // "PVS1"
+    static constexpr uint32_t kVersion = 2;
+    static constexpr uint32_t kNoCell = ~0u;
+
+    struct Object
+    {
+        const Vertex* vertices = nullptr;
+        size_t vertexCount = 0;
+        const uint32_t* indices = nullptr;
+        size_t indexCount = 0;
+        // row-vector world matrix (p' = p * world), as XMFLOAT4X4 stores it
+        float world[4][4]{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+        // false for small props that hide nothing; they are still culled
+        bool occluder = true;
+    };
+
+    struct Settings
+    {
+        float cellSize = 2.f;
+        // tries per cell and object, stopping at the first that gets through
+        uint32_t raysPerObject = 16;
+        // tries for an object a neighbouring cell sees and this one does not,
+        // aimed at its triangles; 0 skips that pass
+        uint32_t borderRays = 128;
+        // the cell size grows until the grid fits
+        uint32_t maxCells = 1u << 18;
+        // OR each cell with the 26 cells around it
+        bool dilate = true;
+        // neighbouring cells share one row when that adds at most this
+        // fraction of the objects to each; 0 keeps every cell exact
+        float mergeSlack = 0.05f;
+    };
+
+    struct Stats
+    {
+        uint32_t cells = 0;
+        uint64_t rays = 0;
+        uint32_t lineFound = 0;     // cell/object pairs found along sight lines
+        uint32_t borderFound = 0;   // cell/object pairs only the border rays found
+        double seconds = 0.0;
+        size_t rawBytes = 0;        // one bit per object per cell
+        size_t encodedBytes = 0;    // MemoryBytes after Build
+        uint32_t uniqueRows = 0;    // cell count when stored as plain bits
+        float averageVisible = 0.f; // fraction of the objects, over all cells
+    };
+
+    Stats Build(const std::vector<Object>& objects, const Settings& settings);
+    Stats Build(const std::vector<Object>& objects) { return Build(objects, Settings()); }
+
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+
+    bool Empty() const { return m_cellCount == 0; }
+    uint32_t ObjectCount() const { return m_objectCount; }
+    uint32_t CellCount() const { return m_cellCount; }
+    float CellSize() const { return m_cellSize; }
+    size_t MemoryBytes() const;
+
+    // kNoCell outside the grid
+    uint32_t CellAt(const float p[3]) const;
+    // Visible objects of a cell as bits, object i in bit i % 64 of word i / 64.
+    void DecodeCell(uint32_t cell, std::vector<uint64_t>& out) const;
+
+private:
+    uint32_t RowCount() const { return m_offsetBytes ? uint32_t(m_rowOffsets.size() / m_offsetBytes) - 1 : 0; }
+    void DecodeRow(uint32_t row, uint64_t* out, bool allowDelta) const;
+
+    float m_origin[3]{};
+    float m_cellSize = 1.f;
+    uint32_t m_dims[3]{};
+    uint32_t m_objectCount = 0;
+    uint32_t m_cellCount = 0;
+
+    // Little-endian integers of m_cellRowBytes (1, 2 or 4, by the row
+    // count) and m_offsetBytes (2 or 4, by the data size). With both 0 the
+    // cells are plain bits: cell i is the (objects + 7) / 8 bytes at i times that.
+    std::vector<uint8_t> m_cellRows;        // row of each cell
+    std::vector<uint8_t> m_rowOffsets;      // into m_rowData, one past the last row too
+    std::vector<uint8_t> m_rowData;         // encoded rows, see the row modes
+    uint32_t m_cellRowBytes = 0, m_offsetBytes = 0;
+};
@@ -0,0 +1,110 @@
+#include "PreloadManifest.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+void PreloadManifest::Restart()
+{
+    std::lock_guard<std::mutex> lk(m_mu);
+    m_start = std::chrono::steady_clock::now();
+    m_entries.clear();
+}
+
+void PreloadManifest::Record(Kind kind, const std::string& path)
+{
+    if (path.empty())
+        return;
+    const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+
+    std::lock_guard<std::mutex> lk(m_mu);
+    auto inserted = m_entries.emplace(Key(kind, path), Entry{});
+    if (!inserted.second)
+        return;
+    inserted.first->second.kind = kind;
+    inserted.first->second.firstUseMs = ms;
+    inserted.first->second.path = path;
+}
+
+std::vector<PreloadManifest::Entry> PreloadManifest::Entries() const
+{
+    std::vector<Entry> out;
+    {
+        std::lock_guard<std::mutex> lk(m_mu);
+        out.reserve(m_entries.size());
+        for (const auto& kv : m_entries)
+            out.push_back(kv.second);
+    }
+    std::sort(out.begin(), out.end(), [](const Entry& a, const Entry& b) {
+        if (a.firstUseMs != b.firstUseMs) return a.firstUseMs < b.firstUseMs;
+        return a.path < b.path;
+    });
+    return out;
+}
+
+size_t PreloadManifest::Size() const
+{
+    std::lock_guard<std::mutex> lk(m_mu);
+    return m_entries.size();
+}
+
+const char* PreloadManifest::KindName(Kind kind)
+{
+    switch (kind) {
+    case Kind::Mesh: return "mesh";
+    case Kind::Texture: return "texture";
+    case Kind::SkinnedModel: return "skinned";
+    }
+    return "?";
+}
+
+bool PreloadManifest::Save(const std::string& path) const
+{
+    const std::vector<Entry> entries = Entries();
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        if (!f.is_open()) return false;
+        f << "# preload manifest: <kind> <first use ms> <path>\n";
+        char ms[32];
+        for (const Entry& e : entries) {
+            std::snprintf(ms, sizeof(ms), "%.1f", e.firstUseMs);
+            f << KindName(e.kind) << ' ' << ms << ' ' << e.path << '\n';
+        }
+        if (!f.good()) return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool PreloadManifest::Load(const std::string& path)
+{
+    std::ifstream f(path);
+    if (!f.is_open()) return false;
+
+    std::unordered_map<std::string, Entry> entries;
+    std::string line;
+    while (std::getline(f, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream ls(line);
+        std::string kind;
+        Entry e;
+        if (!(ls >> kind >> e.firstUseMs)) return false;
+        if (kind == "mesh") e.kind = Kind::Mesh;
+        else if (kind == "texture") e.kind = Kind::Texture;
+        else if (kind == "skinned") e.kind = Kind::SkinnedModel;
+        else return false;
+
+        // the rest of the line, paths may contain spaces
+        std::getline(ls >> std::ws, e.path);
+        if (e.path.empty()) return false;
+        entries.emplace(Key(e.kind, e.path), std::move(e));
+    }
+
+    std::lock_guard<std::mutex> lk(m_mu);
+    m_entries = std::move(entries);
+    return true;
+}
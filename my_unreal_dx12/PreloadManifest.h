@@ -0,0 +1,51 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// GPU-free record of the assets a session touched and when it first asked
+// for each one. ResourceCache fills it while the game runs, writes it on
+// exit and prefetches its entries, in first-use order, on the next launch.
+//
+// Text file, one asset per line: "<kind> <first use ms> <path>", '#' starts
+// a comment. Paths are the ones the game passed to ResourceCache.
+class PreloadManifest
+{
+public:
+    enum class Kind : uint8_t { Mesh, Texture, SkinnedModel };
+
+    struct Entry
+    {
+        Kind kind = Kind::Mesh;
+        float firstUseMs = 0.f;
+        std::string path;
+    };
+
+    PreloadManifest() : m_start(std::chrono::steady_clock::now()) {}
+
+    // Times are measured from construction or the last Restart.
+    void Restart();
+
+    // Keeps the first use of each (kind, path), thread-safe.
+    void Record(Kind kind, const std::string& path);
+
+    // sorted by first use
+    std::vector<Entry> Entries() const;
+    size_t Size() const;
+
+    bool Save(const std::string& path) const;
+    // Replaces the recorded entries; false when missing or malformed.
+    bool Load(const std::string& path);
+
+    static const char* KindName(Kind kind);
+
+private:
+    static std::string Key(Kind kind, const std::string& path) { return char('0' + int(kind)) + path; }
+
+    mutable std::mutex m_mu;
+    std::chrono::steady_clock::time_point m_start;
+    std::unordered_map<std::string, Entry> m_entries;
+};
@@ -0,0 +1,323 @@
+#include "Primitives.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+    constexpr float kPi = 3.14159265358979323846f;
+
+    void Resize(MeshData& out, size_t vertexCount, size_t indexCount)
+    {
+        out = MeshData{};
+        out.vertices.resize(vertexCount);
+        out.indices.resize(indexCount);
+    }
+}
+
+void Primitives::Plane(MeshData& out, float width, float depth, uint32_t m, uint32_t n)
+{
+    Resize(out, size_t(m) * n, size_t(m - 1) * (n - 1) * 6);
+
+    Vertex* v = out.vertices.data();
+    for (uint32_t i = 0; i < m; ++i) {
+        const float x = -0.5f * width + i * (width / (m - 1));
+        for (uint32_t j = 0; j < n; ++j) {
+            const float z = -0.5f * depth + j * (depth / (n - 1));
+            *v++ = { x, 0.f, z,  0.f, 1.f, 0.f,  1.f, 1.f, 1.f,
+                static_cast<float>(i) / (m - 1), static_cast<float>(j) / (n - 1) };
+        }
+    }
+
+    uint32_t* idx = out.indices.data();
+    for (uint32_t i = 0; i < m - 1; ++i) {
+        for (uint32_t j = 0; j < n - 1; ++j) {
+            *idx++ = i * n + j;
+            *idx++ = (i + 1) * n + (j + 1);
+            *idx++ = (i + 1) * n + j;
+            *idx++ = i * n + j;
+            *idx++ = i * n + (j + 1);
+            *idx++ = (i + 1) * n + (j + 1);
+        }
+    }
+}
+
+void Primitives::Cube(MeshData& out, float size)
+{
+    const float s = size * 0.5f;
+    const Vertex vertices[24] = {
+        { -s, -s,  s,  0, 0, 1,  1, 1, 1,  0, 0 },
+        {  s, -s,  s,  0, 0, 1,  1, 1, 1,  1, 0 },
+        {  s,  s,  s,  0, 0, 1,  1, 1, 1,  1, 1 },
+        { -s,  s,  s,  0, 0, 1,  1, 1, 1,  0, 1 },
+
+        {  s, -s, -s,  0, 0,-1,  1, 1, 1,  0, 0 },
+        { -s, -s, -s,  0, 0,-1,  1, 1, 1,  1, 0 },
+        { -s,  s, -s,  0, 0,-1,  1, 1, 1,  1, 1 },
+        {  s,  s, -s,  0, 0,-1,  1, 1, 1,  0, 1 },
+
+        { -s,  s,  s,  0, 1, 0,  1, 1, 1,  0, 0 },
+        {  s,  s,  s,  0, 1, 0,  1, 1, 1,  1, 0 },
+        {  s,  s, -s,  0, 1, 0,  1, 1, 1,  1, 1 },
+        { -s,  s, -s,  0, 1, 0,  1, 1, 1,  0, 1 },
+
+        { -s, -s, -s,  0,-1, 0,  1, 1, 1,  0, 0 },
+        {  s, -s, -s,  0,-1, 0,  1, 1, 1,  1, 0 },
+        {  s, -s,  s,  0,-1, 0,  1, 1, 1,  1, 1 },
+        { -s, -s,  s,  0,-1, 0,  1, 1, 1,  0, 1 },
+
+        {  s, -s,  s,  1, 0, 0,  1, 1, 1,  0, 0 },
+        {  s, -s, -s,  1, 0, 0,  1, 1, 1,  1, 0 },
+        {  s,  s, -s,  1, 0, 0,  1, 1, 1,  1, 1 },
+        {  s,  s,  s,  1, 0, 0,  1, 1, 1,  0, 1 },
+
+        { -s, -s, -s, -1, 0, 0,  1, 1, 1,  0, 0 },
+        { -s, -s,  s, -1, 0, 0,  1, 1, 1,  1, 0 },
+        { -s,  s,  s, -1, 0, 0,  1, 1, 1,  1, 1 },
+        { -s,  s, -s, -1, 0, 0,  1, 1, 1,  0, 1 },
+    };
+
+    Resize(out, 24, 36);
+    std::copy(vertices, vertices + 24, out.vertices.begin());
+
+    uint32_t* idx = out.indices.data();
+    for (uint32_t f = 0; f < 6; ++f) {
+        const uint32_t i = f * 4;
+        *idx++ = i + 0; *idx++ = i + 1; *idx++ = i + 2;
+        *idx++ = i + 0; *idx++ = i + 2; *idx++ = i + 3;
+    }
+}
+
+void Primitives::Sphere(MeshData& out, float diameter, uint32_t slices, uint32_t stacks)
+{
+    Resize(out, size_t(stacks + 1) * (slices + 1), size_t(stacks) * slices * 6);
+    const float r = diameter * 0.5f;
+
+    Vertex* v = out.vertices.data();
+    for (uint32_t i = 0; i <= stacks; ++i) {
+        const float phi = kPi * i / stacks;
+        for (uint32_t j = 0; j <= slices; ++j) {
+            const float theta = 2 * kPi * j / slices;
+            const float x = sinf(phi) * cosf(theta);
+            const float y = cosf(phi);
+            const float z = sinf(phi) * sinf(theta);
+            *v++ = { x * r, y * r, z * r, x, y, z, 1, 1, 1, (float)j / slices, (float)i / stacks };
+        }
+    }
+
+    uint32_t* idx = out.indices.data();
+    for (uint32_t i = 0; i < stacks; ++i) {
+        for (uint32_t j = 0; j < slices; ++j) {
+            const uint32_t a = i * (slices + 1) + j;
+            const uint32_t b = a + slices + 1;
+            *idx++ = a;     *idx++ = a + 1; *idx++ = b;
+            *idx++ = a + 1; *idx++ = b + 1; *idx++ = b;
+        }
+    }
+}
+
+void Primitives::Icosphere(MeshData& out, float diameter, uint32_t subdivisions)
+{
+    size_t faces = 20;
+    for (uint32_t s = 0; s < subdivisions; ++s) faces *= 4;
+    // Euler: V - E + F = 2 with E = 3F/2
+    Resize(out, faces / 2 + 2, faces * 3);
+
+    const float t = (1.f + std::sqrt(5.f)) * 0.5f;
+    const float base[12][3] = {
+        { -1,  t,  0 }, {  1,  t,  0 }, { -1, -t,  0 }, {  1, -t,  0 },
+        {  0, -1,  t }, {  0,  1,  t }, {  0, -1, -t }, {  0,  1, -t },
+        {  t,  0, -1 }, {  t,  0,  1 }, { -t,  0, -1 }, { -t,  0,  1 },
+    };
+    static const uint32_t baseFaces[60] = {
+        0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+        1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+        3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+        4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1,
+    };
+
+    // unit positions first, the final pass fills in the rest of the vertex
+    Vertex* verts = out.vertices.data();
+    uint32_t vertexCount = 0;
+    auto addVertex = [&](float x, float y, float z) {
+        const float len = std::sqrt(x * x + y * y + z * z);
+        Vertex& v = verts[vertexCount];
+        v.nx = x / len; v.ny = y / len; v.nz = z / len;
+        return vertexCount++;
+        };
+    for (const auto& p : base) addVertex(p[0], p[1], p[2]);
+
+    // subdivide in place from the back of the index array, so every level
+    // reads the previous one before overwriting it
+    uint32_t* idx = out.indices.data();
+    size_t count = 60;
+    std::copy(baseFaces, baseFaces + 60, idx + (faces * 3 - count));
+
+    std::unordered_map<uint64_t, uint32_t> midpoints;
+    midpoints.reserve(faces * 3 / 2);
+    auto midpoint = [&](uint32_t a, uint32_t b) {
+        const uint64_t key = a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+        auto it = midpoints.find(key);
+        if (it != midpoints.end()) return it->second;
+        const Vertex& va = verts[a];
+        const Vertex& vb = verts[b];
+        const uint32_t m = addVertex(va.nx + vb.nx, va.ny + vb.ny, va.nz + vb.nz);
+        midpoints.emplace(key, m);
+        return m;
+        };
+
+    for (uint32_t s = 0; s < subdivisions; ++s) {
+        const uint32_t* src = idx + (faces * 3 - count);
+        uint32_t* dst = idx + (faces * 3 - count * 4);
+        midpoints.clear();
+        for (size_t f = 0; f < count; f += 3) {
+            const uint32_t a = src[f], b = src[f + 1], c = src[f + 2];
+            const uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            *dst++ = a;  *dst++ = ab; *dst++ = ca;
+            *dst++ = b;  *dst++ = bc; *dst++ = ab;
+            *dst++ = c;  *dst++ = ca; *dst++ = bc;
+            *dst++ = ab; *dst++ = bc; *dst++ = ca;
+        }
+        count *= 4;
+    }
+
+    const float r = diameter * 0.5f;
+    for (Vertex& v : out.vertices) {
+        float u = std::atan2(v.nz, v.nx) / (2.f * kPi);
+        if (u < 0.f) u += 1.f;
+        const float y = std::fmax(-1.f, std::fmin(1.f, v.ny));
+        v = { v.nx * r, v.ny * r, v.nz * r, v.nx, v.ny, v.nz, 1, 1, 1, u, std::acos(y) / kPi };
+    }
+}
+
+void Primitives::Cylinder(MeshData& out, float radius, float height, uint32_t slices, bool withCaps)
+{
+    const size_t ring = slices + 1;
+    Resize(out, 2 * ring + (withCaps ? 2 * (ring + 1) : 0), size_t(slices) * (withCaps ? 12 : 6));
+
+    const float h = height * 0.5f;
+    const float invS = 1.0f / slices;
+
+    Vertex* v = out.vertices.data();
+    uint32_t* idx = out.indices.data();
+
+    for (uint32_t i = 0; i <= slices; ++i) {
+        const float t = i * invS;
+        const float th = 2.0f * kPi * t;
+        const float x = std::cos(th), z = std::sin(th);
+        *v++ = { radius * x, -h, radius * z,  x, 0, z,  1,1,1,  t, 0.0f };
+        *v++ = { radius * x,  h, radius * z,  x, 0, z,  1,1,1,  t, 1.0f };
+    }
+
+    for (uint32_t i = 0; i < slices; ++i) {
+        const uint32_t bi = 2 * i;
+        const uint32_t ti = 2 * i + 1;
+        const uint32_t bn = 2 * (i + 1);
+        const uint32_t tn = 2 * (i + 1) + 1;
+        *idx++ = bi; *idx++ = ti; *idx++ = tn;
+        *idx++ = bi; *idx++ = tn; *idx++ = bn;
+    }
+
+    if (withCaps) {
+        auto cap = [&](float y, float ny, bool flip) {
+            const uint32_t center = uint32_t(v - out.vertices.data());
+            *v++ = { 0, y, 0,  0, ny, 0,  1,1,1,  0.5f, 0.5f };
+            const uint32_t start = center + 1;
+            for (uint32_t i = 0; i <= slices; ++i) {
+                const float th = 2.0f * kPi * (i * invS);
+                const float x = std::cos(th), z = std::sin(th);
+                *v++ = { radius * x, y, radius * z,  0, ny, 0,  1,1,1,  0.5f * (x + 1), 0.5f * (z + 1) };
+            }
+            for (uint32_t i = 0; i < slices; ++i) {
+                *idx++ = center;
+                *idx++ = flip ? start + i + 1 : start + i;
+                *idx++ = flip ? start + i : start + i + 1;
+            }
+            };
+        cap(-h, -1.f, false);
+        cap(h, 1.f, true);
+    }
+}
+
+void Primitives::Cone(MeshData& out, float radius, float height, uint32_t slices, bool withBase)
+{
+    const size_t ring = slices + 1;
+    Resize(out, 2 * ring + (withBase ? ring + 1 : 0), size_t(slices) * (withBase ? 6 : 3));
+
+    const float h = height * 0.5f;
+    const float invSlices = 1.0f / slices;
+
+    const float denom = std::sqrt(radius * radius + height * height);
+    const float ny_side = radius / denom;
+    const float k_rad = height / denom;
+
+    Vertex* v = out.vertices.data();
+    uint32_t* idx = out.indices.data();
+
+    for (uint32_t i = 0; i <= slices; ++i) {
+        const float t = i * invSlices;
+        const float theta = 2.0f * kPi * t;
+        const float x = std::cos(theta);
+        const float z = std::sin(theta);
+        const float nx = x * k_rad;
+        const float nz = z * k_rad;
+        *v++ = { radius * x, -h, radius * z,  nx, ny_side, nz,  1,1,1,  t, 0.0f };
+        *v++ = { 0.0f, +h, 0.0f,  nx, ny_side, nz,  1,1,1,  t, 1.0f };
+    }
+
+    for (uint32_t i = 0; i < slices; ++i) {
+        *idx++ = 2 * i + 1;
+        *idx++ = 2 * (i + 1);
+        *idx++ = 2 * i;
+    }
+
+    if (withBase) {
+        const uint32_t baseCenter = uint32_t(v - out.vertices.data());
+        *v++ = { 0.0f, -h, 0.0f,  0.0f, -1.0f, 0.0f,  1,1,1,  0.5f, 0.5f };
+
+        const uint32_t baseStart = baseCenter + 1;
+        for (uint32_t i = 0; i <= slices; ++i) {
+            const float theta = 2.0f * kPi * (i * invSlices);
+            const float x = std::cos(theta);
+            const float z = std::sin(theta);
+            *v++ = { radius * x, -h, radius * z,  0.0f, -1.0f, 0.0f,  1,1,1,  0.5f * (x + 1.0f), 0.5f * (z + 1.0f) };
+        }
+
+        for (uint32_t i = 0; i < slices; ++i) {
+            *idx++ = baseCenter;
+            *idx++ = baseStart + i;
+            *idx++ = baseStart + i + 1;
+        }
+    }
+}
+
+void Primitives::GridPatch(MeshData& out, uint32_t dim)
+{
+    dim = std::max(2u, dim & ~1u);
+    const uint32_t n = dim + 1;
+    const uint32_t half = dim / 2;
+    Resize(out, size_t(n) * n, size_t(dim) * dim * 6);
+
+    Vertex* v = out.vertices.data();
+    const float inv = 1.f / dim;
+    for (uint32_t i = 0; i < n; ++i)
+        for (uint32_t j = 0; j < n; ++j)
+            *v++ = { i * inv, 0.f, j * inv,  0.f, 1.f, 0.f,  1.f, 1.f, 1.f,  i * inv, j * inv };
+
+    // quadrant q = qx + 2 * qz owns indices [q, q + 1) * half * half * 6
+    uint32_t* idx = out.indices.data();
+    for (uint32_t q = 0; q < 4; ++q) {
+        const uint32_t i0 = (q & 1) * half, j0 = (q >> 1) * half;
+        for (uint32_t i = i0; i < i0 + half; ++i) {
+            for (uint32_t j = j0; j < j0 + half; ++j) {
+                *idx++ = i * n + j;
+                *idx++ = (i + 1) * n + (j + 1);
+                *idx++ = (i + 1) * n + j;
+                *idx++ = i * n + j;
+                *idx++ = i * n + (j + 1);
+                *idx++ = (i + 1) * n + (j + 1);
+            }
+        }
+    }
+}
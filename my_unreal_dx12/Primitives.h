@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include "MeshData.h"
+
+// GPU-free generators behind Mesh::CreatePlane/CreateCube/... . Each one sizes
+// the output arrays up front and writes them in place. Triangles are clockwise
+// seen from the front, as the rasterizer expects.
+namespace Primitives
+{
+    void Plane(MeshData& out, float width, float depth, uint32_t m, uint32_t n);
+    void Cube(MeshData& out, float size);
+    void Sphere(MeshData& out, float diameter, uint32_t slices, uint32_t stacks);
+    // subdivided icosahedron: 20 * 4^subdivisions evenly sized triangles and
+    // no pole fans. Spherical UVs, the seam is not split.
+    void Icosphere(MeshData& out, float diameter, uint32_t subdivisions);
+    void Cylinder(MeshData& out, float radius, float height, uint32_t slices, bool withCaps);
+    void Cone(MeshData& out, float radius, float height, uint32_t slices, bool withBase);
+    // (dim+1)^2 vertices over [0,1] in x/z for terrain nodes, dim is even. The
+    // indices are grouped per quadrant (qx + 2*qz) so a quarter can be drawn alone.
+    void GridPatch(MeshData& out, uint32_t dim);
+}
@@ -0,0 +1,93 @@
+#include "RangeAllocator.h"
+#include <cassert>
+
+void RangeAllocator::Reset(uint32_t capacity)
+{
+    m_byOffset.clear();
+    m_bySize.clear();
+    m_capacity = capacity;
+    m_used = 0;
+    m_allocations = 0;
+    if (capacity)
+        InsertFree(0, capacity);
+}
+
+void RangeAllocator::InsertFree(uint32_t offset, uint32_t size)
+{
+    m_byOffset.emplace(offset, size);
+    m_bySize.emplace(size, offset);
+}
+
+void RangeAllocator::EraseFree(std::map<uint32_t, uint32_t>::iterator it)
+{
+    auto range = m_bySize.equal_range(it->second);
+    for (auto s = range.first; s != range.second; ++s) {
+        if (s->second == it->first) {
+            m_bySize.erase(s);
+            break;
+        }
+    }
+    m_byOffset.erase(it);
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t size)
+{
+    if (size == 0) return kInvalid;
+
+    auto best = m_bySize.lower_bound(size);
+    if (best == m_bySize.end()) return kInvalid;
+
+    const uint32_t blockSize = best->first;
+    const uint32_t offset = best->second;
+    EraseFree(m_byOffset.find(offset));
+
+    if (blockSize > size)
+        InsertFree(offset + size, blockSize - size);
+
+    m_used += size;
+    ++m_allocations;
+    return offset;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t size)
+{
+    if (offset == kInvalid || size == 0) return;
+    assert(offset + size <= m_capacity);
+
+    m_used -= size;
+    --m_allocations;
+
+    auto next = m_byOffset.lower_bound(offset);
+    if (next != m_byOffset.end() && offset + size == next->first) {
+        size += next->second;
+        EraseFree(next);
+    }
+
+    auto after = m_byOffset.lower_bound(offset);
+    if (after != m_byOffset.begin()) {
+        auto prev = std::prev(after);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            EraseFree(prev);
+        }
+    }
+
+    InsertFree(offset, size);
+}
+
+uint32_t RangeAllocator::LargestFree() const
+{
+    return m_bySize.empty() ? 0u : m_bySize.rbegin()->first;
+}
+
+RangeAllocator::Stats RangeAllocator::GetStats() const
+{
+    Stats s;
+    s.capacity = m_capacity;
+    s.used = m_used;
+    s.freeBlocks = uint32_t(m_byOffset.size());
+    s.largestFree = LargestFree();
+    s.allocations = m_allocations;
+    return s;
+}
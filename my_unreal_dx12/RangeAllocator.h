@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <map>
+
+// Best-fit free-list suballocator over [0, capacity) in abstract units
+// (vertices, indices, bytes...). Adjacent free ranges are merged on Free.
+// Pure CPU, no graphics dependency; tools/RangeAllocatorTest checks it
+// under random allocate/free churn.
+class RangeAllocator
+{
+public:
+    static constexpr uint32_t kInvalid = 0xFFFFFFFFu;
+
+    struct Stats {
+        uint32_t capacity = 0;
+        uint32_t used = 0;
+        uint32_t freeBlocks = 0;
+        uint32_t largestFree = 0;
+        uint32_t allocations = 0;
+
+        // 0 = all free space is one block, tends to 1 when it is scattered
+        float Fragmentation() const {
+            const uint32_t freeSpace = capacity - used;
+            return freeSpace ? 1.f - float(largestFree) / float(freeSpace) : 0.f;
+        }
+    };
+
+    RangeAllocator() = default;
+    explicit RangeAllocator(uint32_t capacity) { Reset(capacity); }
+
+    void Reset(uint32_t capacity);
+
+    uint32_t Allocate(uint32_t size);
+    void Free(uint32_t offset, uint32_t size);
+
+    uint32_t Capacity() const { return m_capacity; }
+    uint32_t Used() const { return m_used; }
+    uint32_t LargestFree() const;
+    Stats GetStats() const;
+
+private:
+    void InsertFree(uint32_t offset, uint32_t size);
+    void EraseFree(std::map<uint32_t, uint32_t>::iterator it);
+
+    std::map<uint32_t, uint32_t> m_byOffset;
+    std::multimap<uint32_t, uint32_t> m_bySize;
+
+    uint32_t m_capacity = 0;
+    uint32_t m_used = 0;
+    uint32_t m_allocations = 0;
+};
@@ -12,15 +12,10 @@ void Renderer::DrawMesh(const Mesh& mesh,
     ID3D12GraphicsCommandList* cmd = m_cmd.Get();
 
     cmd->SetGraphicsRootConstantBufferView(0, cbAddr);
-    cmd->SetGraphicsRootDescriptorTable(1, texHandle);
-    cmd->SetGraphicsRootDescriptorTable(2, shadowHandle);
-    cmd->SetGraphicsRootDescriptorTable(3, normalHandle);
-    cmd->SetGraphicsRootDescriptorTable(4, metalRoughHandle);
+    BindTables({ texHandle, shadowHandle, normalHandle, metalRoughHandle });
 
-    cmd->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    cmd->IASetVertexBuffers(0, 1, &mesh.VBV());
-    cmd->IASetIndexBuffer(&mesh.IBV());
-    cmd->DrawIndexedInstanced(mesh.IndexCount(), 1, 0, 0, 0);
+    BindGeometry(mesh);
+    cmd->DrawIndexedInstanced(mesh.IndexCount(), 1, mesh.StartIndex(), INT(mesh.BaseVertex()), 0);
 }
 
 void Renderer::DrawMeshRange(const Mesh& mesh,
@@ -35,13 +30,8 @@ void Renderer::DrawMeshRange(const Mesh& mesh,
     ID3D12GraphicsCommandList* cmd = m_cmd.Get();
 
     cmd->SetGraphicsRootConstantBufferView(0, cbAddr);
-    cmd->SetGraphicsRootDescriptorTable(1, texHandle);
-    cmd->SetGraphicsRootDescriptorTable(2, shadowHandle);
-    cmd->SetGraphicsRootDescriptorTable(3, normalHandle);
-    cmd->SetGraphicsRootDescriptorTable(4, metalRoughHandle);
+    BindTables({ texHandle, shadowHandle, normalHandle, metalRoughHandle });
 
-    cmd->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    cmd->IASetVertexBuffers(0, 1, &mesh.VBV());
-    cmd->IASetIndexBuffer(&mesh.IBV());
-    cmd->DrawIndexedInstanced(indexCount, 1, indexStart, 0, 0);
+    BindGeometry(mesh);
+    cmd->DrawIndexedInstanced(indexCount, 1, mesh.StartIndex() + indexStart, INT(mesh.BaseVertex()), 0);
 }
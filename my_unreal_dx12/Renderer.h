@@ -45,6 +45,8 @@ public:
 
         cmd->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
+        InvalidateGeometryBindings();
+        InvalidateTableBindings();
         cmd->SetGraphicsRootSignature(pipe.Root());
         cmd->SetPipelineState(pipe.PSO());
     }
@@ -66,6 +68,8 @@ public:
     void BeginFrame(UINT frameIndex)
     {
         m_cmd.Begin(frameIndex);
+        InvalidateGeometryBindings();
+        InvalidateTableBindings();
 
         D3D12_RESOURCE_BARRIER b{};
         b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -113,10 +117,8 @@ public:
 
         cmd->SetGraphicsRootConstantBufferView(0, cbAddr); // b0
 
-        cmd->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        cmd->IASetVertexBuffers(0, 1, &mesh.VBV());
-        cmd->IASetIndexBuffer(&mesh.IBV());
-        cmd->DrawIndexedInstanced(mesh.IndexCount(), 1, 0, 0, 0);
+        BindGeometry(mesh);
+        cmd->DrawIndexedInstanced(mesh.IndexCount(), 1, mesh.StartIndex(), INT(mesh.BaseVertex()), 0);
     }
 
     void EndFrame(UINT frameIndex)
@@ -130,10 +132,13 @@ public:
         m_cmd.Get()->ResourceBarrier(1, &b);
 
         m_cmd.End();
+        // the copies of this frame's loads run first on the same queue
+        m_gd->Uploads().Submit();
         ID3D12CommandList* lists[]{ m_cmd.Get() };
         m_gd->Queue()->ExecuteCommandLists(1, lists);
         DXThrow(m_sc->Swap()->Present(1, 0));
         m_gd->WaitGPU();
+        m_gd->Uploads().Retire();
         m_sc->UpdateFrameIndex();
     }
 
@@ -150,11 +155,31 @@ public:
 
         if (m_pipe)
         {
+            InvalidateTableBindings();
             cmd->SetGraphicsRootSignature(m_pipe->Root());
             cmd->SetPipelineState(m_pipe->PSO());
         }
     }
 
+    // after BindMainRenderTargets, for pipelines using PixelShader.hlsl
+    void BindProbes(D3D12_GPU_VIRTUAL_ADDRESS probes)
+    {
+        m_cmd.Get()->SetGraphicsRootShaderResourceView(5, probes);
+    }
+
+    // after BindMainRenderTargets, for pipelines using PixelShader.hlsl
+    void BindEnvironment(D3D12_GPU_DESCRIPTOR_HANDLE specular, D3D12_GPU_DESCRIPTOR_HANDLE brdfLut)
+    {
+        m_cmd.Get()->SetGraphicsRootDescriptorTable(6, specular);
+        m_cmd.Get()->SetGraphicsRootDescriptorTable(7, brdfLut);
+    }
+
+    // after BindMainRenderTargets, for TerrainVertex.hlsl
+    void BindTerrainTiles(D3D12_GPU_DESCRIPTOR_HANDLE tiles)
+    {
+        m_cmd.Get()->SetGraphicsRootDescriptorTable(8, tiles);
+    }
+
     void OnResize(UINT newW, UINT newH)
     {
         m_viewport = { 0, 0, static_cast<float>(newW), static_cast<float>(newH), 0.0f, 1.0f };
@@ -164,6 +189,53 @@ public:
     ID3D12GraphicsCommandList* GetCommandList() { return m_cmd.Get(); }
 
 private:
+    // Meshes share GeometryPool pages, only rebind IA when the page changes.
+    void BindGeometry(const Mesh& mesh)
+    {
+        ID3D12GraphicsCommandList* cmd = m_cmd.Get();
+        if (!m_topologySet) {
+            cmd->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+            m_topologySet = true;
+        }
+        const D3D12_GPU_VIRTUAL_ADDRESS vb = mesh.VBV().BufferLocation;
+        const D3D12_GPU_VIRTUAL_ADDRESS ib = mesh.IBV().BufferLocation;
+        if (vb != m_boundVB) {
+            cmd->IASetVertexBuffers(0, 1, &mesh.VBV());
+            m_boundVB = vb;
+        }
+        if (ib != m_boundIB) {
+            cmd->IASetIndexBuffer(&mesh.IBV());
+            m_boundIB = ib;
+        }
+    }
+
+    void InvalidateGeometryBindings()
+    {
+        m_boundVB = 0;
+        m_boundIB = 0;
+        m_topologySet = false;
+    }
+
+    // Submeshes sharing an atlas page or a texture array bind the same
+    // tables (root parameters 1-4), only set the ones that changed. A new
+    // root signature drops its arguments.
+    void BindTables(const D3D12_GPU_DESCRIPTOR_HANDLE (&tables)[4])
+    {
+        ID3D12GraphicsCommandList* cmd = m_cmd.Get();
+        for (UINT i = 0; i < 4; ++i) {
+            if (tables[i].ptr != m_boundTables[i]) {
+                cmd->SetGraphicsRootDescriptorTable(1 + i, tables[i]);
+                m_boundTables[i] = tables[i].ptr;
+            }
+        }
+    }
+
+    void InvalidateTableBindings()
+    {
+        for (UINT64& t : m_boundTables)
+            t = 0;
+    }
+
     GraphicsDevice* m_gd = nullptr;
     SwapChain* m_sc = nullptr;
     DepthBuffer* m_db = nullptr;
@@ -173,4 +245,9 @@ private:
     D3D12_VIEWPORT   m_viewport{};
     D3D12_RECT       m_scissor{};
 
+    D3D12_GPU_VIRTUAL_ADDRESS m_boundVB = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS m_boundIB = 0;
+    bool m_topologySet = false;
+    UINT64 m_boundTables[4] = {};
+
 };
@@ -4,538 +4,732 @@
 #include "ResourceCache.h"
 #include "Mesh.h"
 #include "WindowDX12.h"
-#include <fstream>
-#include <sstream>
+#include "CookedMesh.h"
+#include "ObjImporter.h"
+#include "MeshOptimize.h"
+#include "AmbientOcclusion.h"
+#include "GltfLoader.h"
+#include "SkinnedMesh.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "TextureFile.h"
+#include "TextureArrayPool.h"
+#include "TextureStreamer.h"
+#include "ImageCodec.h"
+#include "stb_image.h"
+#include <chrono>
 #include <unordered_map>
 #include <DirectXMath.h>
 #include <iostream>
 #include <algorithm>
+#include <filesystem>
+#include <stdexcept>
 
 
+void ResourceCache::buildAsset(MeshData&& data, const std::string& baseDir, MeshAsset& out, std::shared_ptr<Texture> defaultWhite)
+{
+    std::unordered_map<std::string, LoadedTexture> loaded;
+    std::unordered_map<std::string, PendingTexture> pending;
 
-static std::string joinPath(const std::string& a, const std::string& b) {
-    if (a.empty()) return b;
-    const char last = a.back();
-    if (last == '/' || last == '\\') return a + b;
-    return a + "/" + b;
-}
+    // cooked and optimized meshes carry these, other imports are measured here
+    if (!data.vertices.empty() && std::any_of(data.submeshes.begin(), data.submeshes.end(),
+            [](const SubmeshDesc& d) { return d.hasMaterial && d.uvDensity == 0.f; }))
+        MeshOptimize::MeasureSubmeshes(data);
 
-static void parseMtlFile(const std::string& mtlPath, std::unordered_map<std::string, Material>& out) {
-    std::ifstream mtl(mtlPath);
-    if (!mtl.is_open()) {
-        std::cerr << "MTL introuvable: " << mtlPath << "\n";
-        return;
-    }
+    // every texture of the mesh is decoding before the first one is waited on
+    auto startTexture = [&](const std::string& file, MipGenerator::Content content, bool shared, const char* what)
+        {
+            if (file.empty())
+                return;
 
-    std::string line, tok, cur;
-    while (std::getline(mtl, line)) {
-        std::istringstream iss(line);
-        if (!(iss >> tok)) continue;
-        if (tok == "newmtl") {
-            iss >> cur;
-            out[cur] = Material{};
-        }
-        else if (tok == "Kd" && !cur.empty()) {
-            iss >> out[cur].Kd.x >> out[cur].Kd.y >> out[cur].Kd.z;
-        }
-        else if (tok == "Ks" && !cur.empty()) {
-            iss >> out[cur].Ks.x >> out[cur].Ks.y >> out[cur].Ks.z;
-        }
-        else if (tok == "Ke" && !cur.empty()) {
-            iss >> out[cur].Ke.x >> out[cur].Ke.y >> out[cur].Ke.z;
-        }
-        else if (tok == "Ns" && !cur.empty()) {
-            iss >> out[cur].Ns;
-            if (out[cur].Ns < 16.0f)   out[cur].Ns = 16.0f;
-            if (out[cur].Ns > 256.0f)  out[cur].Ns = 256.0f;
-        }
-        else if (tok == "d" && !cur.empty()) {
-            iss >> out[cur].d;
-            if (out[cur].d < 0.0f) out[cur].d = 0.0f;
-            if (out[cur].d > 1.0f) out[cur].d = 1.0f;
-        }
-        else if (tok == "Tr" && !cur.empty()) {
-            float tr;
-            iss >> tr;
+            const std::string texPath = ObjImporter::JoinPath(baseDir, file);
+            if (loaded.count(texPath) || pending.count(texPath))
+                return;
 
-            tr = std::max(0.f, std::min(1.f, tr));
-            out[cur].d = 1.f - tr;
-        }
-        else if (tok == "map_Kd" && !cur.empty()) {
-            iss >> out[cur].map_Kd;
-        }
-        else if ((tok == "map_Bump" || tok == "bump" || tok == "map_normal") && !cur.empty())
-        {
-            iss >> out[cur].map_normal;
-        }
-        else if (tok == "refl" && !cur.empty()) {
-            iss >> out[cur].map_metalRough;
-        }
+            try
+            {
+                pending.emplace(texPath, this->startTexture(texPath, content, shared));
+            }
+            catch (...)
+            {
+                std::cerr << what << texPath << "\n";
+                loaded[texPath] = LoadedTexture{};
+            }
+        };
+
+    for (const auto& desc : data.submeshes)
+    {
+        if (!desc.hasMaterial)
+            continue;
+        startTexture(desc.material.texture, MipGenerator::Content::Color, true, "Error texture: ");
+        startTexture(desc.material.normalMap, MipGenerator::Content::NormalMap, true, "Error normal map: ");
+        startTexture(desc.material.metalRoughMap, MipGenerator::Content::Linear, true, "Error metalRough: ");
     }
-}
+    // the mesh-wide texture is sampled whole, it is only shared as a map
+    startTexture(data.texture, MipGenerator::Content::Color, false, "Error texture: ");
 
-static void parseVtxToken(const std::string& tok, int& vi, int& ti, int& ni) {
-    vi = ti = ni = 0;
-    int part = 0;
-    std::string acc;
-    auto flush = [&](void) {
-        if (acc.empty()) { ++part; return; }
-        int val = std::stoi(acc);
-        if (part == 0) vi = val;
-        else if (part == 1) ti = val;
-        else if (part == 2) ni = val;
-        acc.clear(); ++part;
+    auto loadTexture = [&](const std::string& file, const char* what) -> LoadedTexture
+        {
+            if (file.empty())
+                return {};
+
+            const std::string texPath = ObjImporter::JoinPath(baseDir, file);
+            auto it = loaded.find(texPath);
+            if (it != loaded.end())
+                return it->second;
+
+            auto started = pending.find(texPath);
+            try
+            {
+                auto tex = finishTexture(texPath, std::move(started->second));
+                pending.erase(started);
+                loaded[texPath] = tex;
+                return tex;
+            }
+            catch (...)
+            {
+                std::cerr << what << texPath << "\n";
+                pending.erase(started);
+                loaded[texPath] = LoadedTexture{};
+                return {};
+            }
         };
-    for (char c : tok) {
-        if (c == '/') flush();
-        else acc.push_back(c);
-    }
-    flush();
-}
 
-static uint32_t getIndexForKey(
-    const std::string& token,
-    const std::string& materialKey,
-    const Material* material,
-    std::unordered_map<std::string, uint32_t>& map,
-    uint32_t& next,
-    std::vector<Vertex>& outVertices,
-    const std::vector<DirectX::XMFLOAT3>& positions,
-    const std::vector<DirectX::XMFLOAT2>& texcoords,
-    const std::vector<DirectX::XMFLOAT3>& normals)
-{
-    std::string combinedKey = token;
-    combinedKey.push_back('|');
-    combinedKey += materialKey;
+    for (const auto& desc : data.submeshes)
+    {
+        Submesh sm;
+        sm.indexStart = desc.indexStart;
+        sm.indexCount = desc.indexCount;
+        std::copy(desc.bounds, desc.bounds + 4, sm.bounds);
+        sm.uvDensity = desc.uvDensity;
 
-    auto it = map.find(combinedKey);
-    if (it != map.end()) return it->second;
+        if (desc.hasMaterial)
+        {
+            const MaterialDesc& mat = desc.material;
+            sm.kd = DirectX::XMFLOAT3(mat.kd[0], mat.kd[1], mat.kd[2]);
+            sm.ks = DirectX::XMFLOAT3(mat.ks[0], mat.ks[1], mat.ks[2]);
+            sm.ke = DirectX::XMFLOAT3(mat.ke[0], mat.ke[1], mat.ke[2]);
+            sm.shininess = mat.shininess;
+            sm.opacity = mat.opacity;
+
+            const LoadedTexture tex = loadTexture(mat.texture, "Error texture: ");
+            if (tex.texture)
+            {
+                sm.texture = tex.texture;
+                sm.textureRect = tex.rect;
+                sm.textureSlice = tex.slice;
+            }
+            else
+                sm.texture = defaultWhite;
 
-    int vi = 0, ti = 0, ni = 0;
-    parseVtxToken(token, vi, ti, ni);
+            const LoadedTexture n = loadTexture(mat.normalMap, "Error normal map: ");
+            if (n.texture)
+            {
+                sm.normalMap = n.texture;
+                sm.normalRect = n.rect;
+                sm.normalSlice = n.slice;
+                sm.hasNormalMap = true;
+            }
 
-    Vertex vert{};
-    const auto& p = positions[(vi > 0 ? vi - 1 : 0)];
-    vert.px = p.x; vert.py = p.y; vert.pz = p.z;
+            const LoadedTexture mr = loadTexture(mat.metalRoughMap, "Error metalRough: ");
+            if (mr.texture)
+            {
+                sm.metalRoughMap = mr.texture;
+                sm.metalRoughRect = mr.rect;
+                sm.metalRoughSlice = mr.slice;
+                sm.hasMetalRoughMap = true;
+            }
+        }
+        else
+        {
+            sm.kd = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+            sm.ks = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+            sm.ke = DirectX::XMFLOAT3(0.f, 0.f, 0.f);
+            sm.shininess = 128.f;
+            sm.opacity = 1.f;
 
-    if (ni > 0 && (size_t)(ni - 1) < normals.size()) {
-        const auto& n = normals[ni - 1];
-        vert.nx = n.x; vert.ny = n.y; vert.nz = n.z;
-    }
-    else {
-        vert.nx = 0.0f; vert.ny = 1.0f; vert.nz = 0.0f;
-    }
+            sm.texture = defaultWhite;
+        }
 
-    if (material) {
-        vert.r = material->Kd.x;
-        vert.g = material->Kd.y;
-        vert.b = material->Kd.z;
-    }
-    else {
-        vert.r = vert.g = vert.b = 1.0f;
+        out.submeshes.push_back(sm);
     }
 
-    if (ti > 0 && (size_t)(ti - 1) < texcoords.size()) {
-        const auto& t = texcoords[ti - 1];
-        vert.u = t.x;
-        vert.v = 1.0f - t.y;
-    }
-    else {
-        vert.u = vert.v = 0.0f;
-    }
+    out.shininess = data.shininess;
+    // packed, or a later slice of an array, when a submesh maps it too; the
+    // submeshes draw it then
+    const LoadedTexture whole = loadTexture(data.texture, "Error texture: ");
+    out.texture = whole.rect.x == 0.f && whole.slice == 0 ? whole.texture : nullptr;
+    if (!out.texture)
+        out.texture = defaultWhite;
 
-    outVertices.push_back(vert);
-    map[combinedKey] = next;
-    return next++;
+    out.vertices = std::move(data.vertices);
+    out.indices = std::move(data.indices);
 }
 
-static void RecomputeSmoothNormals(std::vector<Vertex>& verts,
-    const std::vector<uint32_t>& idx)
+// Opens the cooked sibling of the OBJ when it is at least as recent as the
+// source and none of the files it was imported from (MTL libraries and the
+// textures they name) changed since.
+static bool OpenCooked(const std::string& path, CookedMesh& file)
 {
-    for (auto& v : verts) { v.nx = v.ny = v.nz = 0.0f; }
-
-    for (size_t i = 0; i + 2 < idx.size(); i += 3) {
-        Vertex& a = verts[idx[i]];
-        Vertex& b = verts[idx[i + 1]];
-        Vertex& c = verts[idx[i + 2]];
-
-        DirectX::XMVECTOR pa = DirectX::XMVectorSet(a.px, a.py, a.pz, 0);
-        DirectX::XMVECTOR pb = DirectX::XMVectorSet(b.px, b.py, b.pz, 0);
-        DirectX::XMVECTOR pc = DirectX::XMVectorSet(c.px, c.py, c.pz, 0);
-
-        DirectX::XMVECTOR ab = DirectX::XMVectorSubtract(pb, pa);
-        DirectX::XMVECTOR ac = DirectX::XMVectorSubtract(pc, pa);
-        DirectX::XMVECTOR n = DirectX::XMVector3Cross(ab, ac);
-
-        DirectX::XMFLOAT3 nf;
-        DirectX::XMStoreFloat3(&nf, n);
-        a.nx += nf.x; a.ny += nf.y; a.nz += nf.z;
-        b.nx += nf.x; b.ny += nf.y; b.nz += nf.z;
-        c.nx += nf.x; c.ny += nf.y; c.nz += nf.z;
-    }
-
-    for (auto& v : verts) {
-        DirectX::XMVECTOR n = DirectX::XMVectorSet(v.nx, v.ny, v.nz, 0);
-        n = DirectX::XMVector3Normalize(n);
-        DirectX::XMFLOAT3 nf;
-        DirectX::XMStoreFloat3(&nf, n);
-        v.nx = nf.x; v.ny = nf.y; v.nz = nf.z;
-    }
+    const std::string cooked = CookedMesh::PathFor(path);
+
+    std::error_code ec, ecCooked;
+    const auto srcTime = std::filesystem::last_write_time(path, ec);
+    const auto cookedTime = std::filesystem::last_write_time(cooked, ecCooked);
+    if (ecCooked || (!ec && cookedTime < srcTime))
+        return false;
+    return file.Open(cooked) && file.DependenciesCurrent();
 }
 
-static void ComputeTangents(std::vector<Vertex>& verts, const std::vector<uint32_t>& idx)
+// Prefers the cooked file, otherwise imports the OBJ and refreshes the cooked
+// file. cookedPath is left empty when no cooked file matches the result.
+static bool LoadMeshData(const std::string& path, MeshData& out, std::string& cookedPath, Hash128& hash)
 {
-    for (auto& v : verts) {
-        v.tx = v.ty = v.tz = 0;
-        v.bx = v.by = v.bz = 0;
-    }
-
-    for (size_t i = 0; i < idx.size(); i += 3) {
-        Vertex& v0 = verts[idx[i]];
-        Vertex& v1 = verts[idx[i + 1]];
-        Vertex& v2 = verts[idx[i + 2]];
-
-        DirectX::XMFLOAT3 p0{ v0.px, v0.py, v0.pz };
-        DirectX::XMFLOAT3 p1{ v1.px, v1.py, v1.pz };
-        DirectX::XMFLOAT3 p2{ v2.px, v2.py, v2.pz };
-
-        DirectX::XMFLOAT2 uv0{ v0.u, v0.v };
-        DirectX::XMFLOAT2 uv1{ v1.u, v1.v };
-        DirectX::XMFLOAT2 uv2{ v2.u, v2.v };
-
-        XMVECTOR P0 = DirectX::XMLoadFloat3(&p0);
-        XMVECTOR P1 = DirectX::XMLoadFloat3(&p1);
-        XMVECTOR P2 = DirectX::XMLoadFloat3(&p2);
-
-        XMVECTOR uv0v = DirectX::XMLoadFloat2(&uv0);
-        XMVECTOR uv1v = DirectX::XMLoadFloat2(&uv1);
-        XMVECTOR uv2v = DirectX::XMLoadFloat2(&uv2);
-
-        float x1 = p1.x - p0.x;
-        float x2 = p2.x - p0.x;
-        float y1 = p1.y - p0.y;
-        float y2 = p2.y - p0.y;
-        float z1 = p1.z - p0.z;
-        float z2 = p2.z - p0.z;
-
-        float s1 = uv1.x - uv0.x;
-        float s2 = uv2.x - uv0.x;
-        float t1 = uv1.y - uv0.y;
-        float t2 = uv2.y - uv0.y;
-
-        float r = 1.0f / (s1 * t2 - s2 * t1);
-
-        XMFLOAT3 T{
-            (t2 * x1 - t1 * x2) * r,
-            (t2 * y1 - t1 * y2) * r,
-            (t2 * z1 - t1 * z2) * r
-        };
-
-        XMFLOAT3 B{
-            (s1 * x2 - s2 * x1) * r,
-            (s1 * y2 - s2 * y1) * r,
-            (s1 * z2 - s2 * z1) * r
-        };
-
-        for (Vertex* v : { &v0, &v1, &v2 }) {
-            v->tx += T.x; v->ty += T.y; v->tz += T.z;
-            v->bx += B.x; v->by += B.y; v->bz += B.z;
+    CookedMesh file;
+    if (OpenCooked(path, file)) {
+        out = file.Header();
+        out.vertices.resize(file.VertexCount());
+        out.indices.resize(file.IndexCount());
+        if (file.DecodeVertices(out.vertices.data()) && file.DecodeIndices(out.indices.data())) {
+            cookedPath = file.Path();
+            hash = file.ContentHash();
+            return true;
         }
+        out = MeshData{};
     }
 
-    for (auto& v : verts) {
-        XMVECTOR n = XMVector3Normalize(XMLoadFloat3((XMFLOAT3*)&v.nx));
-        XMVECTOR t = XMVector3Normalize(XMLoadFloat3((XMFLOAT3*)&v.tx));
-        XMVECTOR b = XMVector3Normalize(XMLoadFloat3((XMFLOAT3*)&v.bx));
-
-        XMStoreFloat3((XMFLOAT3*)&v.tx, t);
-        XMStoreFloat3((XMFLOAT3*)&v.bx, b);
-    }
+    std::vector<std::string> dependencies;
+    if (!ObjImporter::Import(path, out, &dependencies))
+        return false;
+    MeshOptimize::Optimize(out);
+    // baked once here, the cooked file carries it from then on
+    AmbientOcclusion::Bake(out);
+    hash = HashGeometry(out.vertices.data(), out.vertices.size(), out.indices.data(), out.indices.size());
+
+    const std::string cooked = CookedMesh::PathFor(path);
+    if (CookedMesh::Save(cooked, out, dependencies))
+        cookedPath = cooked;
+    else
+        std::cerr << "Warning: unable to write " << cooked << "\n";
+    return true;
 }
 
-static void LoadOBJIntoAsset(const std::string& filename, MeshAsset& out, std::shared_ptr<Texture> defaultWhite)
+// An authored DDS/KTX2 file, or the container the cooker wrote next to the
+// image when it is at least as recent as the image.
+static bool OpenContainer(const std::string& path, TextureFile& file)
 {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: unable to open " << filename << std::endl;
-        return;
-    }
-
-    const size_t slash = filename.find_last_of("/\\");
-    const std::string baseDir = (slash == std::string::npos) ? "" : filename.substr(0, slash + 1);
-
-    std::vector<DirectX::XMFLOAT3> positions;
-    std::vector<DirectX::XMFLOAT3> normals;
-    std::vector<DirectX::XMFLOAT2> texcoords;
-    std::unordered_map<std::string, Material> materials;
-
-    std::unordered_map<std::string, uint32_t> vertexMap;
-    uint32_t nextIndex = 0;
-
-    std::string currentMaterialName;
-    const Material* currentMaterial = nullptr;
-    std::unordered_map<std::string, std::shared_ptr<Texture>> materialTextures;
-    std::unordered_map<std::string, std::shared_ptr<Texture>> materialNormalTextures;
-    std::unordered_map<std::string, std::shared_ptr<Texture>> materialMetalRoughTextures;
+    if (TextureFile::IsContainerPath(path))
+        return file.Open(path);
+
+    const std::string cooked = TextureFile::PathFor(path);
+    std::error_code ec, ecCooked;
+    const auto srcTime = std::filesystem::last_write_time(path, ec);
+    const auto cookedTime = std::filesystem::last_write_time(cooked, ecCooked);
+    if (ecCooked || (!ec && cookedTime < srcTime))
+        return false;
+    return file.Open(cooked);
+}
 
-    auto getMaterialNormal = [&](const std::string& name) -> std::shared_ptr<Texture>
-        {
-            auto it = materialNormalTextures.find(name);
-            if (it != materialNormalTextures.end())
-                return it->second;
+// Content address of a container's texels: format, size and every level.
+static Hash128 HashContainer(const TextureFile& file, Hash128 seed)
+{
+    const uint32_t header[4] = { uint32_t(file.GetFormat()), file.Width(), file.Height(), file.LevelCount() };
+    Hash128 h = HashBytes(header, sizeof(header), seed);
+    const std::vector<const void*> levels = file.LevelPointers();
+    for (uint32_t l = 0; l < file.LevelCount(); ++l)
+        h = HashBytes(levels[l], file.GetLevel(l).size, h);
+    return h;
+}
 
-            auto matIt = materials.find(name);
-            if (matIt == materials.end() || matIt->second.map_normal.empty()) {
-                materialNormalTextures[name] = nullptr;
-                return nullptr;
+// CPU half of a load, run on the JobSystem ahead of the request
+struct ResourceCache::Prefetch
+{
+    PreloadManifest::Kind kind = PreloadManifest::Kind::Mesh;
+    std::string path;
+    JobCounter job;
+    // whoever gets here first decodes, a request arriving mid-decode blocks
+    std::once_flag once;
+    std::atomic<bool> finished{ false };
+    bool ok = false;
+
+    MeshData mesh;
+    std::string cookedPath;
+    Hash128 hash;
+
+    SkinnedMeshData skinned;
+
+    // RGBA8, as Texture::LoadFromFile decodes it, or the mapped container
+    std::unique_ptr<stbi_uc, void(*)(void*)> pixels{ nullptr, stbi_image_free };
+    int width = 0, height = 0;
+    TextureFile container;
+
+    void Run()
+    {
+        switch (kind) {
+        case PreloadManifest::Kind::Mesh:
+            ok = LoadMeshData(path, mesh, cookedPath, hash);
+            break;
+        case PreloadManifest::Kind::SkinnedModel:
+            ok = GltfLoader::LoadSkinned(path, skinned);
+            break;
+        case PreloadManifest::Kind::Texture: {
+            // the levels are only paged in; the request decides whether the
+            // container suits the material slot and decodes when it does not
+            if (OpenContainer(path, container)) {
+                container.Prefault();
+                ok = true;
+                break;
             }
+            pixels.reset(ImageCodec::Load(path.c_str(), &width, &height));
+            ok = pixels != nullptr;
+            break;
+        }
+        }
+        finished.store(true, std::memory_order_release);
+    }
+};
 
-            const std::string texPath = joinPath(baseDir, matIt->second.map_normal);
-
-            auto tex = std::make_shared<Texture>();
-            try
-            {
-                auto& win = WindowDX12::Get();
-                auto& gd = win.GetGraphicsDevice();
-                auto  alloc = win.AllocateSrv();
+static std::string PrefetchKey(PreloadManifest::Kind kind, const std::string& path)
+{
+    return char('0' + int(kind)) + path;
+}
 
-                tex->LoadFromFile(gd, texPath.c_str(), alloc.cpu, alloc.gpu);
+size_t ResourceCache::startPreload(const std::string& manifestPath) {
+    PreloadManifest manifest;
+    if (!manifest.Load(manifestPath))
+        return 0;
 
-                materialNormalTextures[name] = tex;
-                return tex;
-            }
-            catch (...)
-            {
-                std::cerr << "Error normal map: " << texPath << "\n";
-                materialNormalTextures[name] = nullptr;
-                return nullptr;
-            }
-        };
-    auto getMaterialTexture = [&](const std::string& name) -> std::shared_ptr<Texture>
-        {
-            auto it = materialTextures.find(name);
-            if (it != materialTextures.end())
-                return it->second;
+    std::vector<std::shared_ptr<Prefetch>> queued;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        for (const auto& e : manifest.Entries()) {
+            auto& slot = prefetch_[PrefetchKey(e.kind, e.path)];
+            if (slot)
+                continue;
+            slot = std::make_shared<Prefetch>();
+            slot->kind = e.kind;
+            slot->path = e.path;
+            queued.push_back(slot);
+        }
+        preloadStats_.queued += uint32_t(queued.size());
+    }
 
-            auto matIt = materials.find(name);
-            if (matIt == materials.end() || matIt->second.map_Kd.empty()) {
-                materialTextures[name] = nullptr;
-                return nullptr;
-            }
+    // external submissions are taken oldest first, so the workers follow the manifest order
+    for (auto& p : queued) {
+        Prefetch* raw = p.get();
+        JobSystem::I().Run(raw->job, [p] { std::call_once(p->once, &Prefetch::Run, p.get()); });
+    }
+    return queued.size();
+}
 
-            const std::string texPath = joinPath(baseDir, matIt->second.map_Kd);
+std::shared_ptr<ResourceCache::Prefetch> ResourceCache::takePrefetch(PreloadManifest::Kind kind, const std::string& path) {
+    std::shared_ptr<Prefetch> p;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (prefetch_.empty())
+            return nullptr;
+        auto it = prefetch_.find(PrefetchKey(kind, path));
+        if (it == prefetch_.end())
+            return nullptr;
+        p = std::move(it->second);
+        prefetch_.erase(it);
+    }
 
-            auto tex = std::make_shared<Texture>();
-            try
-            {
-                auto& win = WindowDX12::Get();
-                auto& gd = win.GetGraphicsDevice();
-                auto  alloc = win.AllocateSrv();
+    // not Wait: helping would run the newest queued jobs first, not this one
+    const bool pending = !p->finished.load(std::memory_order_acquire);
+    std::call_once(p->once, &Prefetch::Run, p.get());
 
-                tex->LoadFromFile(gd, texPath.c_str(), alloc.cpu, alloc.gpu);
+    std::lock_guard<std::mutex> lk(mu_);
+    ++preloadStats_.used;
+    if (pending)
+        ++preloadStats_.waited;
+    return p->ok ? p : nullptr;
+}
 
-                materialTextures[name] = tex;
-                return tex;
-            }
-            catch (...)
-            {
-                std::cerr << "Error texture: " << texPath << "\n";
-                materialTextures[name] = nullptr;
-                return nullptr;
-            }
-        };
-    auto getMaterialMetalRough = [&](const std::string& name) -> std::shared_ptr<Texture>
-        {
-            auto it = materialMetalRoughTextures.find(name);
-            if (it != materialMetalRoughTextures.end())
-                return it->second;
+void ResourceCache::dropPreload() {
+    std::unordered_map<std::string, std::shared_ptr<Prefetch>> unused;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        unused.swap(prefetch_);
+        preloadStats_.dropped += uint32_t(unused.size());
+    }
+    // queued jobs still hold their entry, claiming it first skips the decode
+    for (auto& kv : unused)
+        std::call_once(kv.second->once, [] {});
+}
 
-            auto matIt = materials.find(name);
-            if (matIt == materials.end() || matIt->second.map_metalRough.empty()) {
-                materialMetalRoughTextures[name] = nullptr;
-                return nullptr;
-            }
+ResourceCache::PreloadStats ResourceCache::getPreloadStats() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return preloadStats_;
+}
 
-            const std::string texPath = joinPath(baseDir, matIt->second.map_metalRough);
+bool ResourceCache::writeManifest(const std::string& manifestPath) const {
+    if (usage_.Size() == 0)
+        return false;
+    return usage_.Save(manifestPath);
+}
 
-            auto tex = std::make_shared<Texture>();
-            try
-            {
-                auto& win = WindowDX12::Get();
-                auto& gd = win.GetGraphicsDevice();
-                auto  alloc = win.AllocateSrv();
+ResourceCache::PendingTexture ResourceCache::startTexture(const std::string& path, MipGenerator::Content content, bool shared) {
+    PendingTexture pending;
+    pending.start = std::chrono::steady_clock::now();
+    pending.content = content;
+    usage_.Record(PreloadManifest::Kind::Texture, path);
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        pending.compress = compressTextures_;
+        pending.stream = streamTextures_;
+        pending.atlas = shared && atlasTextures_;
+        pending.array = shared && arrayTextures_;
+        pending.bc = BlockCompress::SettingsFor(content, textureQuality_);
+    }
+    // the same content makes a different texture under other settings
+    const uint8_t settings[] = { uint8_t(content), uint8_t(pending.compress), uint8_t(pending.bc.format),
+        uint8_t(pending.bc.quality), pending.bc.channels[0], pending.bc.channels[1],
+        uint8_t(pending.atlas), uint8_t(pending.array) };
+    pending.settings = HashBytes(settings, sizeof(settings));
+    if (pending.atlas) {
+        std::lock_guard<std::mutex> lk(atlasMu_);
+        const AtlasPages& set = atlases_[size_t(content)];
+        auto it = set.entries.find(path);
+        if (it != set.entries.end()) {
+            pending.atlasEntry = it->second;
+            return pending;
+        }
+    }
+    auto prefetched = takePrefetch(PreloadManifest::Kind::Texture, path);
+
+    // A container goes up as stored: no decode, mips or encode. Cooked ones
+    // are used when they hold what this slot compresses to, unless the
+    // image is small enough for the atlas, which packs texels; authored
+    // ones always, their channels read like the compressed slot would.
+    TextureFile file;
+    if (prefetched)
+        file = std::move(prefetched->container);
+    else
+        OpenContainer(path, file);
+    const bool authored = TextureFile::IsContainerPath(path);
+    const bool packable = pending.atlas && std::max(file.Width(), file.Height()) <= TextureAtlas::Settings{}.maxSize;
+    if (authored || (pending.compress && !packable && file.LevelCount()
+            && file.GetFormat() == TextureFile::FromBlockFormat(pending.bc.format))) {
+        if (!file.LevelCount())
+            throw std::runtime_error("Failed to load texture container");
+        pending.fileKey = HashContainer(file, pending.settings);
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!findTexture(pending.fileKey, true, pending.duplicate))
+            pending.container = std::move(file);
+        return pending;
+    }
 
-                tex->LoadFromFile(gd, texPath.c_str(), alloc.cpu, alloc.gpu);
+    // the preload already decoded it; mips and encode run at finish
+    if (prefetched && prefetched->pixels) {
+        pending.prefetched = std::move(prefetched);
+        return pending;
+    }
 
-                materialMetalRoughTextures[name] = tex;
-                return tex;
-            }
-            catch (...)
-            {
-                std::cerr << "Error metalRough: " << texPath << "\n";
-                materialMetalRoughTextures[name] = nullptr;
-                return nullptr;
-            }
-        };
+    // hashed from the mapping here, so that a copy of a loaded file is not
+    // decoded at all; the decoder then reads it from the file cache
+    {
+        MappedFile mapped;
+        if (mapped.Open(path)) {
+            pending.fileKey = HashBytes(mapped.Data(), mapped.Size(), pending.settings);
+            std::lock_guard<std::mutex> lk(mu_);
+            if (findTexture(pending.fileKey, true, pending.duplicate))
+                return pending;
+        }
+    }
 
+    ImageDecoder::Request request;
+    request.path = path;
+    request.stage = pending.compress ? ImageDecoder::Stage::Compress : ImageDecoder::Stage::Mips;
+    request.mips.content = content;
+    request.compress = pending.bc;
+    request.mipsOnlyUpTo = pending.atlas ? TextureAtlas::Settings{}.maxSize : 0;
+    pending.decode = ImageDecoder::I().Submit(std::move(request));
+    return pending;
+}
 
-    auto beginSubmesh = [&](const std::string& name, const Material* mat)
-        {
-            Submesh sm;
-            sm.indexStart = static_cast<uint32_t>(out.indices.size());
+ResourceCache::LoadedTexture ResourceCache::finishTexture(const std::string& path, PendingTexture&& pending) {
+    auto& win = WindowDX12::Get();
+    auto& gd = win.GetGraphicsDevice();
 
-            if (mat)
-            {
-                sm.kd = mat->Kd;
-                sm.ks = mat->Ks;
-                sm.ke = mat->Ke;
-                sm.shininess = mat->Ns;
-                sm.opacity = mat->d;
-
-                if (auto tex = getMaterialTexture(name))
-                    sm.texture = tex;
-                else
-                    sm.texture = defaultWhite;
-
-                if (!mat->map_normal.empty())
-                {
-                    if (auto n = getMaterialNormal(name))
-                    {
-                        sm.normalMap = n;
-                        sm.hasNormalMap = true;
-                    }
-                }
-
-                if (!mat->map_metalRough.empty())
-                {
-                    if (auto mr = getMaterialMetalRough(name))
-                    {
-                        sm.metalRoughMap = mr;
-                        sm.hasMetalRoughMap = true;
-                    }
-                }
+    if (pending.atlasEntry >= 0) {
+        std::lock_guard<std::mutex> lk(atlasMu_);
+        return atlasTexture(pending.content, pending.atlasEntry);
+    }
+    if (pending.duplicate.texture)
+        return pending.duplicate;
+
+    if (pending.container.LevelCount()) {
+        // streamed and pooled levels are read from the mapping for as long as the texture lives
+        auto mapped = std::make_shared<TextureFile>(std::move(pending.container));
+        const TextureFile& file = *mapped;
+        LoadedTexture out;
+        if (pending.array || pending.stream) {
+            TextureStreamer::Source source;
+            source.format = file.GetFormat();
+            source.channels[0] = pending.bc.channels[0];
+            source.channels[1] = pending.bc.channels[1];
+            source.width = file.Width();
+            source.height = file.Height();
+            source.levels = file.LevelPointers();
+            source.bytes = file.DataBytes();
+            source.owner = mapped;
+            if (pending.array) {
+                const TextureArrayPool::Slot slot = TextureArrayPool::I().Add(gd, std::move(source),
+                    [&] { return win.AllocateSrv(); });
+                out.texture = slot.array;
+                out.slice = slot.slice;
             }
-            else
-            {
-                sm.kd = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
-                sm.ks = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
-                sm.ke = DirectX::XMFLOAT3(0.f, 0.f, 0.f);
-                sm.shininess = 128.f;
-                sm.opacity = 1.f;
-
-                sm.texture = defaultWhite;
+            else {
+                auto alloc = win.AllocateSrv();
+                out.texture = TextureStreamer::I().Create(gd, std::move(source), alloc.cpu, alloc.gpu, path.c_str());
             }
+        }
+        else {
+            auto alloc = win.AllocateSrv();
+            out.texture = std::make_shared<Texture>();
+            out.texture->CreateFromContainer(gd, file, pending.bc.channels, alloc.cpu, alloc.gpu, path.c_str());
+        }
 
-            out.submeshes.push_back(sm);
-        };
+        uint64_t rgbaBytes = 0;
+        for (uint32_t l = 0; l < file.LevelCount(); ++l)
+            rgbaBytes += uint64_t(file.GetLevel(l).width) * file.GetLevel(l).height * 4;
 
+        std::lock_guard<std::mutex> lk(mu_);
+        ++textureStats_.textures;
+        ++textureStats_.containers;
+        textureStats_.compressed += TextureFile::IsBlockCompressed(file.GetFormat()) ? 1 : 0;
+        textureStats_.rgbaBytes += rgbaBytes;
+        textureStats_.gpuBytes += file.DataBytes();
+        textureStats_.loadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - pending.start).count();
+        publishTexture(pending.fileKey, out, file.DataBytes());
+        return out;
+    }
 
+    ImageDecoder::Result decoded;
+    if (pending.prefetched) {
+        const Prefetch& p = *pending.prefetched;
+        MipGenerator::Settings mipSettings;
+        mipSettings.content = pending.content;
+        MipGenerator::Stats mipStats;
+        decoded.width = uint32_t(p.width);
+        decoded.height = uint32_t(p.height);
+        decoded.mips = MipGenerator::Generate(p.pixels.get(), decoded.width, decoded.height, mipSettings, &mipStats);
+        decoded.mipSeconds = mipStats.seconds;
+        decoded.chainBytes = decoded.mips.pixels.size();
+        decoded.pixelHash = ImageDecoder::HashPixels(p.pixels.get(), decoded.width, decoded.height);
+        pending.prefetched.reset();
+    }
+    else {
+        decoded = pending.decode.Take();
+        if (!decoded.ok)
+            throw std::runtime_error("Failed to load image");
+    }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string type;
-        iss >> type;
+    // a copy of the file that started decoding before this one finished, or
+    // another encoding of pixels already up; its file finds them from now on
+    const Hash128 pixelKey = HashBytes(&decoded.pixelHash, sizeof(decoded.pixelHash), pending.settings);
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        LoadedTexture same;
+        if (!pending.fileKey.IsZero() && findTexture(pending.fileKey, true, same))
+            return same;
+        if (findTexture(pixelKey, false, same)) {
+            if (!pending.fileKey.IsZero())
+                textureByHash_[pending.fileKey] = textureByHash_[pixelKey];
+            return same;
+        }
+    }
 
-        if (type == "v") {
-            DirectX::XMFLOAT3 pos;
-            iss >> pos.x >> pos.y >> pos.z;
-            positions.push_back(pos);
+    if (pending.atlas && !decoded.compressed) {
+        LoadedTexture packed = packTexture(path, pending, decoded.mips);
+        if (packed.texture) {
+            std::lock_guard<std::mutex> lk(mu_);
+            ++textureStats_.textures;
+            textureStats_.rgbaBytes += decoded.chainBytes;
+            textureStats_.mipSeconds += decoded.mipSeconds;
+            textureStats_.loadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - pending.start).count();
+            // what it would take as a texture of its own; BC7 and BC5 are a quarter of RGBA8
+            const uint64_t gpuBytes = pending.compress ? decoded.chainBytes / 4 : decoded.chainBytes;
+            publishTexture(pixelKey, packed, gpuBytes);
+            publishTexture(pending.fileKey, packed, gpuBytes);
+            return packed;
         }
-        else if (type == "vt") {
-            DirectX::XMFLOAT2 tex;
-            iss >> tex.x >> tex.y;
-            texcoords.push_back(tex);
+    }
+    // prefetched, or small enough for the atlas and not taken
+    if (pending.compress && !decoded.compressed && BlockCompress::CanCompress(decoded.width, decoded.height)) {
+        BlockCompress::Stats bcStats;
+        decoded.blocks = BlockCompress::Compress(decoded.mips, pending.bc, &bcStats);
+        decoded.mips = MipGenerator::Chain{};
+        decoded.compressSeconds = bcStats.seconds;
+        decoded.compressed = true;
+    }
+
+    const uint64_t gpuBytes = decoded.compressed ? decoded.blocks.data.size() : decoded.chainBytes;
+    LoadedTexture out;
+    if (pending.array || pending.stream) {
+        TextureStreamer::Source source;
+        source.width = decoded.width;
+        source.height = decoded.height;
+        if (decoded.compressed) {
+            auto chain = std::make_shared<BlockCompress::Chain>(std::move(decoded.blocks));
+            source.format = TextureFile::FromBlockFormat(chain->format);
+            source.channels[0] = chain->channels[0];
+            source.channels[1] = chain->channels[1];
+            source.levels = chain->LevelPointers();
+            source.bytes = chain->data.size();
+            source.owner = chain;
         }
-        else if (type == "vn") {
-            DirectX::XMFLOAT3 n;
-            iss >> n.x >> n.y >> n.z;
-            normals.push_back(n);
+        else {
+            auto chain = std::make_shared<MipGenerator::Chain>(std::move(decoded.mips));
+            source.levels = chain->LevelPointers();
+            source.bytes = chain->pixels.size();
+            source.owner = chain;
         }
-        else if (type == "f") {
-            std::vector<std::string> toks;
-            std::string tok;
-            while (iss >> tok) toks.push_back(tok);
-            if (toks.size() < 3) continue;
-
-            if (out.submeshes.empty())
-                beginSubmesh(currentMaterialName, currentMaterial);
-
-            std::vector<uint32_t> faceIdx;
-            faceIdx.reserve(toks.size());
-            for (auto& t : toks) {
-                uint32_t idx = getIndexForKey(
-                    t,
-                    currentMaterialName,
-                    currentMaterial,
-                    vertexMap,
-                    nextIndex,
-                    out.vertices,
-                    positions,
-                    texcoords,
-                    normals
-                );
-                faceIdx.push_back(idx);
-            }
-
-            for (size_t i = 2; i < faceIdx.size(); ++i) {
-                out.indices.push_back(faceIdx[0]);
-                out.indices.push_back(faceIdx[i - 1]);
-                out.indices.push_back(faceIdx[i]);
-            }
+        if (pending.array) {
+            const TextureArrayPool::Slot slot = TextureArrayPool::I().Add(gd, std::move(source),
+                [&] { return win.AllocateSrv(); });
+            out.texture = slot.array;
+            out.slice = slot.slice;
         }
-        else if (type == "mtllib") {
-            std::string mtlfile;
-            iss >> mtlfile;
-            parseMtlFile(joinPath(baseDir, mtlfile), materials);
+        else {
+            auto alloc = win.AllocateSrv();
+            out.texture = TextureStreamer::I().Create(gd, std::move(source), alloc.cpu, alloc.gpu, path.c_str());
         }
-        else if (type == "usemtl") {
-            std::string name;
-            iss >> name;
-
-            auto it = materials.find(name);
-            currentMaterialName = name;
-            currentMaterial = (it != materials.end()) ? &it->second : nullptr;
-            if (!out.submeshes.empty()) {
-                auto& last = out.submeshes.back();
-                last.indexCount = static_cast<uint32_t>(out.indices.size() - last.indexStart);
-            }
+    }
+    else {
+        auto alloc = win.AllocateSrv();
+        out.texture = std::make_shared<Texture>();
+        if (decoded.compressed)
+            out.texture->CreateWithMips(gd, decoded.blocks, alloc.cpu, alloc.gpu, path.c_str());
+        else
+            out.texture->CreateWithMips(gd, decoded.mips, alloc.cpu, alloc.gpu, path.c_str());
+    }
 
-            beginSubmesh(currentMaterialName, currentMaterial);
-            if (currentMaterial) {
-                out.shininess = currentMaterial->Ns;
-            }
+    std::lock_guard<std::mutex> lk(mu_);
+    ++textureStats_.textures;
+    textureStats_.compressed += decoded.compressed ? 1 : 0;
+    textureStats_.rgbaBytes += decoded.chainBytes;
+    textureStats_.gpuBytes += gpuBytes;
+    textureStats_.mipSeconds += decoded.mipSeconds;
+    textureStats_.compressSeconds += decoded.compressSeconds;
+    textureStats_.loadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - pending.start).count();
+    publishTexture(pixelKey, out, gpuBytes);
+    publishTexture(pending.fileKey, out, gpuBytes);
+    return out;
+}
 
-            if (!out.texture)
-            {
-                if (auto tex = getMaterialTexture(name))
-                    out.texture = tex;
-                else
-                    out.texture = defaultWhite;
-            }
-        }
+ResourceCache::TextureStats ResourceCache::getTextureStats() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return textureStats_;
+}
+
+bool ResourceCache::findTexture(const Hash128& key, bool file, LoadedTexture& out) {
+    ++textureDedup_.lookups;
+    auto it = textureByHash_.find(key);
+    if (it == textureByHash_.end())
+        return false;
+    auto texture = it->second.texture.lock();
+    if (!texture) {
+        textureByHash_.erase(it);
+        return false;
     }
+    out = { std::move(texture), it->second.rect, it->second.slice };
+    ++(file ? textureDedup_.fileHits : textureDedup_.pixelHits);
+    textureDedup_.bytesSaved += it->second.gpuBytes;
+    return true;
+}
+
+void ResourceCache::publishTexture(const Hash128& key, const LoadedTexture& tex, uint64_t gpuBytes) {
+    // prefetched decodes have no file hash
+    if (!key.IsZero())
+        textureByHash_[key] = { tex.texture, tex.rect, tex.slice, gpuBytes };
+}
 
-    if (!out.submeshes.empty()) {
-        auto& last = out.submeshes.back();
-        last.indexCount = static_cast<uint32_t>(out.indices.size() - last.indexStart);
+ResourceCache::TextureDedupStats ResourceCache::getTextureDedupStats() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return textureDedup_;
+}
+
+ResourceCache::LoadedTexture ResourceCache::packTexture(const std::string& path, const PendingTexture& pending,
+    const MipGenerator::Chain& mips) {
+    std::lock_guard<std::mutex> lk(atlasMu_);
+    AtlasPages& set = atlases_[size_t(pending.content)];
+    if (!set.atlas) {
+        TextureAtlas::Settings settings;
+        settings.compress = pending.compress;
+        settings.bc = pending.bc;
+        set.atlas = std::make_unique<TextureAtlas>(settings);
     }
 
-    if (!out.texture)
-        out.texture = defaultWhite;
+    const int entry = set.atlas->Add(mips);
+    if (entry < 0)
+        return {};
+    set.entries.emplace(path, entry);
+    // a new page goes up now so that its descriptor is never empty, later
+    // entries with updateAtlases
+    while (set.pages.size() < set.atlas->PageCount())
+        uploadPage(WindowDX12::Get().GetGraphicsDevice(), pending.content, uint32_t(set.pages.size()));
+    return atlasTexture(pending.content, entry);
+}
 
-    const bool hasNormals = !normals.empty();
-    if (!hasNormals) {
-        RecomputeSmoothNormals(out.vertices, out.indices);
+ResourceCache::LoadedTexture ResourceCache::atlasTexture(MipGenerator::Content content, int entry) {
+    const AtlasPages& set = atlases_[size_t(content)];
+    const TextureAtlas::Placement& p = set.atlas->GetPlacement(entry);
+    return { set.pages[p.page], DirectX::XMFLOAT4(p.scale[0], p.scale[1], p.offset[0], p.offset[1]) };
+}
+
+void ResourceCache::uploadPage(GraphicsDevice& gd, MipGenerator::Content content, uint32_t page) {
+    static const char* const kNames[] = { "colour", "linear", "normal map" };
+    AtlasPages& set = atlases_[size_t(content)];
+    SrvHandlePair srv;
+    if (page == set.pages.size()) {
+        srv = WindowDX12::Get().AllocateSrv();
+        set.pages.push_back(std::make_shared<Texture>());
+    }
+    else {
+        srv.cpu = set.pages[page]->CPUHandle();
+        srv.gpu = set.pages[page]->GPUHandle();
     }
 
+    // rewrites the view in place, the submeshes keep the Texture
+    Texture& tex = *set.pages[page];
+    const std::string name = std::string("atlas ") + kNames[size_t(content)] + " " + std::to_string(page);
+    if (set.atlas->GetSettings().compress)
+        tex.CreateWithMips(gd, set.atlas->BuildBlocks(page), srv.cpu, srv.gpu, name.c_str());
+    else
+        tex.CreateWithMips(gd, set.atlas->BuildPixels(page), srv.cpu, srv.gpu, name.c_str());
+}
 
-    ComputeTangents(out.vertices, out.indices);
+void ResourceCache::updateAtlases(GraphicsDevice& gd) {
+    std::lock_guard<std::mutex> lk(atlasMu_);
+    for (size_t c = 0; c < 3; ++c) {
+        AtlasPages& set = atlases_[c];
+        for (uint32_t page = 0; page < set.pages.size(); ++page)
+            if (set.atlas->PageDirty(page))
+                uploadPage(gd, MipGenerator::Content(c), page);
+    }
+}
 
+ResourceCache::AtlasStats ResourceCache::getAtlasStats() {
+    std::lock_guard<std::mutex> lk(atlasMu_);
+    AtlasStats s;
+    for (const AtlasPages& set : atlases_) {
+        if (!set.atlas)
+            continue;
+        const TextureAtlas::Stats a = set.atlas->GetStats();
+        s.pages += a.pages;
+        s.textures += a.entries;
+        s.contentTexels += a.contentTexels;
+        s.pageTexels += a.pageTexels;
+        s.pageBytes += a.pageBytes;
+    }
+    return s;
 }
 
 std::shared_ptr<MeshAsset> ResourceCache::getMeshFromOBJ(const std::string& path) {
     std::shared_ptr<Texture> defaultWhiteCopy;
+    CpuResidency residency;
     {
         std::lock_guard<std::mutex> lk(mu_);
         auto it = meshCache_.find(path);
@@ -544,11 +738,64 @@ std::shared_ptr<MeshAsset> ResourceCache::getMeshFromOBJ(const std::string& path
                 return sp;
         }
         defaultWhiteCopy = defaultWhite_;
+        residency = defaultResidency_;
     }
+    usage_.Record(PreloadManifest::Kind::Mesh, path);
+    auto prefetched = takePrefetch(PreloadManifest::Kind::Mesh, path);
+
+    const size_t slash = path.find_last_of("/\\");
+    const std::string baseDir = (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+    ID3D12Device* device = WindowDX12::Get().GetDevice();
 
     auto asset = std::make_shared<MeshAsset>();
-    LoadOBJIntoAsset(path, *asset, defaultWhiteCopy);
-    asset->Upload(WindowDX12::Get().GetDevice());
+    asset->name = path;
+    asset->residency = residency;
+    asset->cached = true;
+
+    // GPU-only assets skip the CPU arrays entirely when a cooked file exists,
+    // and skip decoding too when the same content is already resident
+    CookedMesh cooked;
+    bool uploaded = false;
+    if (!prefetched && residency == CpuResidency::Discard && OpenCooked(path, cooked)) {
+        buildAsset(MeshData(cooked.Header()), baseDir, *asset, defaultWhiteCopy);
+        if (auto block = findGeometry(cooked.ContentHash(), cooked.VertexCount(), cooked.IndexCount())) {
+            asset->AdoptGeometry(std::move(block), cooked.ContentHash());
+            asset->cookedPath = cooked.Path();
+            uploaded = true;
+        }
+        else if (asset->UploadCooked(device, cooked)) {
+            publishGeometry(asset->contentHash, asset->geometry);
+            uploaded = true;
+        }
+        else {
+            asset = std::make_shared<MeshAsset>();
+            asset->name = path;
+            asset->residency = residency;
+            asset->cached = true;
+        }
+    }
+
+    if (!uploaded) {
+        MeshData data;
+        std::string cookedPath;
+        Hash128 hash;
+        bool loaded;
+        if (prefetched) {
+            data = std::move(prefetched->mesh);
+            cookedPath = std::move(prefetched->cookedPath);
+            hash = prefetched->hash;
+            loaded = true;
+        }
+        else {
+            loaded = LoadMeshData(path, data, cookedPath, hash);
+        }
+        if (loaded)
+            buildAsset(std::move(data), baseDir, *asset, defaultWhiteCopy);
+        else
+            asset->texture = defaultWhiteCopy;
+        uploadShared(*asset, hash, device);
+        asset->cookedPath = cookedPath;
+    }
 
     std::lock_guard<std::mutex> lk(mu_);
     auto it = meshCache_.find(path);
@@ -562,3 +809,144 @@ std::shared_ptr<MeshAsset> ResourceCache::getMeshFromOBJ(const std::string& path
     }
     return asset;
 }
+
+std::shared_ptr<MeshAsset> ResourceCache::getPrimitive(const std::string& key, const std::function<void(MeshData&)>& generate) {
+    std::shared_ptr<Texture> defaultWhiteCopy;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        auto it = primitiveCache_.find(key);
+        if (it != primitiveCache_.end()) {
+            if (auto sp = it->second.lock())
+                return sp;
+        }
+        defaultWhiteCopy = defaultWhite_;
+    }
+
+    MeshData data;
+    generate(data);
+
+    const Hash128 hash = HashGeometry(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size());
+
+    auto asset = std::make_shared<MeshAsset>();
+    asset->name = key;
+    asset->vertices = std::move(data.vertices);
+    asset->indices = std::move(data.indices);
+    asset->texture = defaultWhiteCopy;
+    asset->cached = true;
+    uploadShared(*asset, hash, WindowDX12::Get().GetDevice());
+
+    std::lock_guard<std::mutex> lk(mu_);
+    auto& slot = primitiveCache_[key];
+    if (auto sp = slot.lock())
+        return sp;
+    slot = asset;
+    return asset;
+}
+
+std::shared_ptr<const SkinnedModel> ResourceCache::getSkinnedModel(const std::string& path) {
+    std::shared_ptr<Texture> defaultWhiteCopy;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        auto it = skinnedCache_.find(path);
+        if (it != skinnedCache_.end()) {
+            if (auto sp = it->second.lock())
+                return sp;
+        }
+        defaultWhiteCopy = defaultWhite_;
+    }
+    usage_.Record(PreloadManifest::Kind::SkinnedModel, path);
+
+    SkinnedMeshData data;
+    if (auto prefetched = takePrefetch(PreloadManifest::Kind::SkinnedModel, path))
+        data = std::move(prefetched->skinned);
+    else if (!GltfLoader::LoadSkinned(path, data))
+        return nullptr;
+
+    const size_t slash = path.find_last_of("/\\");
+    const std::string baseDir = (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+
+    auto model = std::make_shared<SkinnedModel>();
+    model->influences = std::move(data.influences);
+    model->skeleton = std::move(data.skeleton);
+    model->clips = std::move(data.clips);
+
+    // never uploaded, each SkinnedMesh uploads its own copy
+    model->bindAsset = std::make_shared<MeshAsset>();
+    model->bindAsset->name = path;
+    model->bindAsset->residency = CpuResidency::Keep;
+    model->bindAsset->cached = true;
+    buildAsset(std::move(data.mesh), baseDir, *model->bindAsset, defaultWhiteCopy);
+
+    uint64_t cpu = model->influences.capacity() * sizeof(SkinInfluence) +
+        model->skeleton.JointCount() * (sizeof(Skeleton::Joint) + sizeof(JointTransform) + sizeof(JointMatrix)) +
+        model->bindAsset->vertices.capacity() * sizeof(Vertex) +
+        model->bindAsset->indices.capacity() * sizeof(uint32_t);
+    for (const auto& clip : model->clips)
+        cpu += clip.MemoryBytes();
+    model->ledger = MemoryLedger::I().Track(MemoryCategory::Mesh, path + " (skeleton)", cpu, 0);
+
+    std::lock_guard<std::mutex> lk(mu_);
+    auto& slot = skinnedCache_[path];
+    if (auto sp = slot.lock())
+        return sp;
+    slot = model;
+    return model;
+}
+
+std::shared_ptr<GeometryBlock> ResourceCache::findGeometry(const Hash128& hash, size_t vertexCount, size_t indexCount) {
+    if (hash.IsZero()) return nullptr;
+
+    std::lock_guard<std::mutex> lk(mu_);
+    ++dedupLookups_;
+    auto it = geometryByHash_.find(hash);
+    if (it == geometryByHash_.end()) return nullptr;
+
+    auto block = it->second.lock();
+    if (!block || block->VertexCount() != vertexCount || block->IndexCount() != indexCount)
+        return nullptr;
+    ++dedupHits_;
+    return block;
+}
+
+void ResourceCache::publishGeometry(const Hash128& hash, const std::shared_ptr<GeometryBlock>& block) {
+    if (hash.IsZero() || !block) return;
+
+    std::lock_guard<std::mutex> lk(mu_);
+    auto& slot = geometryByHash_[hash];
+    if (slot.expired())
+        slot = block;
+}
+
+void ResourceCache::uploadShared(MeshAsset& asset, const Hash128& hash, ID3D12Device* device) {
+    if (auto block = findGeometry(hash, asset.vertices.size(), asset.indices.size())) {
+        asset.AdoptGeometry(std::move(block), hash);
+        return;
+    }
+    asset.Upload(device);
+    asset.contentHash = hash;
+    publishGeometry(hash, asset.geometry);
+}
+
+ResourceCache::DedupStats ResourceCache::getDedupStats() {
+    std::lock_guard<std::mutex> lk(mu_);
+    DedupStats stats;
+    stats.lookups = dedupLookups_;
+    stats.hits = dedupHits_;
+
+    for (auto it = geometryByHash_.begin(); it != geometryByHash_.end();) {
+        auto block = it->second.lock();
+        if (!block) {
+            it = geometryByHash_.erase(it);
+            continue;
+        }
+        // owners besides the local copy, each one an asset
+        const long owners = block.use_count() - 1;
+        if (owners > 1) {
+            ++stats.sharedBlocks;
+            stats.bytesSaved += uint64_t(owners - 1) *
+                (uint64_t(block->VertexCount()) * sizeof(Vertex) + uint64_t(block->IndexCount()) * sizeof(uint32_t));
+        }
+        ++it;
+    }
+    return stats;
+}
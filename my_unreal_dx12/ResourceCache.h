@@ -1,20 +1,20 @@
 #pragma once
+#include <chrono>
+#include <functional>
 #include <unordered_map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include "BlockCompress.h"
+#include "ImageDecoder.h"
 #include "MeshAsset.h"
+#include "MipGenerator.h"
+#include "PreloadManifest.h"
+#include "TextureAtlas.h"
+#include "TextureFile.h"
 
-struct Material {
-    DirectX::XMFLOAT3 Kd{ 1,1,1 };
-    DirectX::XMFLOAT3 Ks{ 1,1,1 };
-    DirectX::XMFLOAT3 Ke{ 0,0,0 };
-    std::string map_Kd;
-    float Ns{ 128.f };
-    float d{ 1.f };
-    std::string map_normal;
-    std::string map_metalRough;
-};
+class GraphicsDevice;
+struct SkinnedModel;
 
 class ResourceCache {
 public:
@@ -22,6 +22,14 @@ public:
 
     std::shared_ptr<MeshAsset> getMeshFromOBJ(const std::string& path);
 
+    // Shared asset for a procedural mesh. key must identify the generator and
+    // all of its parameters; generate only runs on a miss.
+    std::shared_ptr<MeshAsset> getPrimitive(const std::string& key, const std::function<void(MeshData&)>& generate);
+
+    // Skeleton, clips and bind pose of a skinned glTF/GLB, nullptr when the
+    // file cannot be imported. Instances are created with SkinnedMesh.
+    std::shared_ptr<const SkinnedModel> getSkinnedModel(const std::string& path);
+
     void setDefaultWhiteTexture(std::shared_ptr<Texture> t) {
         std::lock_guard<std::mutex> lk(mu_);
         defaultWhite_ = std::move(t);
@@ -31,9 +39,219 @@ public:
         return defaultWhite_;
     }
 
+    // Meshes whose vertex/index streams hash equal share one GeometryBlock.
+    struct DedupStats {
+        uint32_t lookups = 0;       // meshes loaded with a known content hash
+        uint32_t hits = 0;          // of which reused live geometry
+        uint32_t sharedBlocks = 0;  // live blocks referenced by more than one asset
+        uint64_t bytesSaved = 0;    // pool memory the live sharers would otherwise use
+    };
+    DedupStats getDedupStats();
+
+    // applies to meshes loaded after the call
+    void setDefaultResidency(CpuResidency r) {
+        std::lock_guard<std::mutex> lk(mu_);
+        defaultResidency_ = r;
+    }
+
+    // Textures loaded after the call are block compressed: BC7 colour, BC5
+    // normal maps (x, y; the shader rebuilds z) and BC5 metal/rough maps
+    // (roughness g and metallic b). Level 0 must be whole 4x4 blocks, other
+    // sizes stay RGBA8. On by default, fast quality. A DDS or KTX2 file, or
+    // the .dds the cooker wrote next to an image, is uploaded as stored;
+    // cooked ones only while compression is on. Images are decoded, mipped
+    // and compressed on the ImageDecoder, all textures of a mesh at once.
+    void setTextureCompression(bool enabled, BlockCompress::Quality quality) {
+        std::lock_guard<std::mutex> lk(mu_);
+        compressTextures_ = enabled;
+        textureQuality_ = quality;
+    }
+
+    // Textures loaded after the call start at a low mip and stream finer
+    // ones in as the TextureStreamer decides; their chains stay in system
+    // memory. On by default.
+    void setTextureStreaming(bool enabled) {
+        std::lock_guard<std::mutex> lk(mu_);
+        streamTextures_ = enabled;
+    }
+
+    // Decoded images no larger than 256 texels a side (and dividing by 4)
+    // loaded after the call are packed into 2048 texel TextureAtlas pages,
+    // one set per content, instead of taking a texture and a descriptor of
+    // their own; their submeshes sample the page through a rectangle. An
+    // atlas compresses like the textures did when it was first used. Pages
+    // are not streamed. Off by default.
+    void setTextureAtlas(bool enabled) {
+        std::lock_guard<std::mutex> lk(mu_);
+        atlasTextures_ = enabled;
+    }
+    // Re-uploads the pages textures were packed into since the last call,
+    // new pages go up as they are made. The GPU must be done with the old
+    // contents; WindowDX12::Clear calls it.
+    void updateAtlases(GraphicsDevice& gd);
+
+    // Material maps loaded after the call that the atlas does not take go
+    // into TextureArrayPool arrays by format and size, their submeshes
+    // sampling a slice; maps of one trim sheet or tile set then share their
+    // descriptor tables. They are not streamed. Off by default.
+    void setTextureArrays(bool enabled) {
+        std::lock_guard<std::mutex> lk(mu_);
+        arrayTextures_ = enabled;
+    }
+
+    struct AtlasStats {
+        uint32_t pages = 0;
+        uint32_t textures = 0;
+        uint64_t contentTexels = 0;
+        uint64_t pageTexels = 0;
+        uint64_t pageBytes = 0;     // as uploaded
+        // share of the pages holding texture texels
+        double efficiency() const { return pageTexels ? double(contentTexels) / double(pageTexels) : 0.0; }
+        // the SRV heap slots the packed textures would take on their own, less the pages'
+        uint32_t descriptorsSaved() const { return textures - pages; }
+    };
+    AtlasStats getAtlasStats();
+
+    // A texture whose file, or whose decoded pixels, hash equal to a live
+    // one loaded with the same settings (content, compression, atlas and
+    // arrays) takes that texture instead of a copy and a descriptor of its
+    // own. Equal files are found before decoding and are not decoded again.
+    struct TextureDedupStats {
+        uint32_t lookups = 0;       // file and pixel hashes looked up
+        uint32_t fileHits = 0;      // byte-identical files or containers
+        uint32_t pixelHits = 0;     // other files decoding to the same pixels
+        uint64_t bytesSaved = 0;    // video memory the duplicates would take
+        uint32_t duplicates() const { return fileHits + pixelHits; }
+    };
+    TextureDedupStats getTextureDedupStats();
+
+    struct TextureStats {
+        uint32_t textures = 0;
+        uint32_t compressed = 0;
+        uint32_t containers = 0;    // uploaded as stored from DDS/KTX2
+        uint64_t rgbaBytes = 0;     // the mip chains as RGBA8
+        uint64_t gpuBytes = 0;      // whole chains as uploaded; streamed ones hold less
+        double mipSeconds = 0.0;
+        double compressSeconds = 0.0;
+        double loadSeconds = 0.0;   // the whole of each load, upload included
+    };
+    TextureStats getTextureStats();
+
+    // Startup preload. Every mesh, skinned model and texture the cache loads
+    // is recorded with the time of its first use; writeManifest saves that
+    // list. startPreload reads a saved list and decodes its files on the
+    // JobSystem in first-use order, the matching requests then only upload.
+    // Returns the number of entries queued, 0 when there is no manifest.
+    size_t startPreload(const std::string& manifestPath);
+    // keeps the previous manifest when nothing was loaded this session
+    bool writeManifest(const std::string& manifestPath) const;
+    // frees the decodes nobody asked for
+    void dropPreload();
+
+    struct PreloadStats {
+        uint32_t queued = 0;    // manifest entries decoding or decoded
+        uint32_t used = 0;      // requests served from a prefetched decode
+        uint32_t waited = 0;    // of which found the decode still pending
+        uint32_t dropped = 0;   // decodes freed unused
+    };
+    PreloadStats getPreloadStats();
+
 private:
     ResourceCache() = default;
+
+    struct Prefetch;
+    // Removes and returns the prefetched decode of path, finishing it on the
+    // calling thread when no worker has started it; null when not queued.
+    std::shared_ptr<Prefetch> takePrefetch(PreloadManifest::Kind kind, const std::string& path);
+
+    void buildAsset(MeshData&& data, const std::string& baseDir, MeshAsset& out, std::shared_ptr<Texture> defaultWhite);
+
+    // What a material slot samples: its own texture, an atlas page and the
+    // rectangle on it, or a slice of an array, see Submesh.
+    struct LoadedTexture {
+        std::shared_ptr<Texture> texture;
+        DirectX::XMFLOAT4 rect{};
+        uint32_t slice = 0;
+    };
+
+    // A texture between startTexture, which queues its CPU work, and
+    // finishTexture, which waits for that and uploads on the calling thread.
+    struct PendingTexture {
+        MipGenerator::Content content = MipGenerator::Content::Color;
+        bool compress = false;
+        bool stream = false;
+        bool atlas = false;
+        bool array = false;
+        int atlasEntry = -1;                // already packed, nothing to load
+        BlockCompress::Settings bc;
+        Hash128 settings;                   // what decides the texture besides the content
+        Hash128 fileKey;                    // the file bytes or container levels, under settings
+        LoadedTexture duplicate;            // the live texture fileKey found, nothing to load
+        std::chrono::steady_clock::time_point start;
+        TextureFile container;              // uploaded as stored when open
+        std::shared_ptr<Prefetch> prefetched;
+        ImageDecoder::Ticket decode;
+    };
+    // both throw like Texture::LoadFromFile; shared lets a decoded image into
+    // the TextureAtlas of its content while setTextureAtlas is on, and the
+    // texture into the TextureArrayPool while setTextureArrays is
+    PendingTexture startTexture(const std::string& path, MipGenerator::Content content, bool shared);
+    LoadedTexture finishTexture(const std::string& path, PendingTexture&& pending);
+
+    // A loaded texture by the hash of its content under the settings of its
+    // load; the texture itself is owned by the submeshes (or the atlas, or
+    // the pool) that use it.
+    struct SharedTexture {
+        std::weak_ptr<Texture> texture;
+        DirectX::XMFLOAT4 rect{};
+        uint32_t slice = 0;
+        uint64_t gpuBytes = 0;
+    };
+    // both with mu_ held; findTexture counts a live hit as a duplicate
+    bool findTexture(const Hash128& key, bool file, LoadedTexture& out);
+    void publishTexture(const Hash128& key, const LoadedTexture& tex, uint64_t gpuBytes);
+
+    // One atlas per content. Packs mips into it, making and uploading a
+    // page when none has room; no texture when the atlas does not take them.
+    struct AtlasPages {
+        std::unique_ptr<TextureAtlas> atlas;
+        std::vector<std::shared_ptr<Texture>> pages;
+        std::unordered_map<std::string, int> entries;   // by path
+    };
+    LoadedTexture packTexture(const std::string& path, const PendingTexture& pending, const MipGenerator::Chain& mips);
+    // both with atlasMu_ held; uploadPage builds page into its texture,
+    // making the texture and its descriptor for a new page
+    LoadedTexture atlasTexture(MipGenerator::Content content, int entry);
+    void uploadPage(GraphicsDevice& gd, MipGenerator::Content content, uint32_t page);
+
+    std::shared_ptr<GeometryBlock> findGeometry(const Hash128& hash, size_t vertexCount, size_t indexCount);
+    void publishGeometry(const Hash128& hash, const std::shared_ptr<GeometryBlock>& block);
+    // Upload, or AdoptGeometry when the same content is already resident
+    void uploadShared(MeshAsset& asset, const Hash128& hash, ID3D12Device* device);
+
     std::mutex mu_;
     std::unordered_map<std::string, std::weak_ptr<MeshAsset>> meshCache_;
+    std::unordered_map<std::string, std::weak_ptr<MeshAsset>> primitiveCache_;
+    std::unordered_map<std::string, std::weak_ptr<const SkinnedModel>> skinnedCache_;
+    std::unordered_map<Hash128, std::weak_ptr<GeometryBlock>, Hash128Hasher> geometryByHash_;
+    uint32_t dedupLookups_ = 0;
+    uint32_t dedupHits_ = 0;
     std::shared_ptr<Texture> defaultWhite_;
+    CpuResidency defaultResidency_ = CpuResidency::Keep;
+
+    bool compressTextures_ = true;
+    BlockCompress::Quality textureQuality_ = BlockCompress::Quality::Fast;
+    bool streamTextures_ = true;
+    bool atlasTextures_ = false;
+    bool arrayTextures_ = false;
+    TextureStats textureStats_;
+    std::unordered_map<Hash128, SharedTexture, Hash128Hasher> textureByHash_;
+    TextureDedupStats textureDedup_;
+
+    std::mutex atlasMu_;
+    AtlasPages atlases_[3];     // by MipGenerator::Content
+
+    PreloadManifest usage_;
+    std::unordered_map<std::string, std::shared_ptr<Prefetch>> prefetch_;
+    PreloadStats preloadStats_;
 };
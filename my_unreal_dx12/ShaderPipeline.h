@@ -21,7 +21,7 @@ public:
         D3D12_CULL_MODE cull = D3D12_CULL_MODE_BACK)
     {
 
-        D3D12_DESCRIPTOR_RANGE ranges[4]{};
+        D3D12_DESCRIPTOR_RANGE ranges[7]{};
 
         ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
         ranges[0].NumDescriptors = 1;
@@ -47,7 +47,25 @@ public:
         ranges[3].BaseShaderRegister = 3;
         ranges[3].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
 
-        D3D12_ROOT_PARAMETER params[5]{};
+        ranges[4].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+        ranges[4].NumDescriptors = 1;
+        ranges[4].BaseShaderRegister = 5; // t5, environment cube
+        ranges[4].RegisterSpace = 0;
+        ranges[4].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+        ranges[5].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+        ranges[5].NumDescriptors = 1;
+        ranges[5].BaseShaderRegister = 6; // t6, BRDF table
+        ranges[5].RegisterSpace = 0;
+        ranges[5].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+        ranges[6].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+        ranges[6].NumDescriptors = 1;
+        ranges[6].BaseShaderRegister = 7; // t7, terrain height tiles
+        ranges[6].RegisterSpace = 0;
+        ranges[6].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+        D3D12_ROOT_PARAMETER params[9]{};
 
         params[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
         params[0].Descriptor.ShaderRegister = 0; // b0
@@ -74,7 +92,27 @@ public:
         params[4].DescriptorTable.pDescriptorRanges = &ranges[3];
         params[4].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
-        D3D12_STATIC_SAMPLER_DESC samplers[2]{};
+        params[5].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+        params[5].Descriptor.ShaderRegister = 4; // t4, irradiance probes
+        params[5].Descriptor.RegisterSpace = 0;
+        params[5].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+        params[6].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+        params[6].DescriptorTable.NumDescriptorRanges = 1;
+        params[6].DescriptorTable.pDescriptorRanges = &ranges[4];
+        params[6].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+        params[7].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+        params[7].DescriptorTable.NumDescriptorRanges = 1;
+        params[7].DescriptorTable.pDescriptorRanges = &ranges[5];
+        params[7].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+        params[8].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+        params[8].DescriptorTable.NumDescriptorRanges = 1;
+        params[8].DescriptorTable.pDescriptorRanges = &ranges[6];
+        params[8].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+        D3D12_STATIC_SAMPLER_DESC samplers[3]{};
 
         samplers[0].Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
         samplers[0].AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
@@ -96,6 +134,12 @@ public:
         samplers[1].AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
         samplers[1].ShaderRegister = 1; // s1
 
+        samplers[2] = samplers[0];
+        samplers[2].AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+        samplers[2].AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+        samplers[2].AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+        samplers[2].ShaderRegister = 2; // s2
+
         D3D12_ROOT_SIGNATURE_DESC rsDesc{};
         rsDesc.NumParameters = _countof(params);
         rsDesc.pParameters = params;
@@ -2,6 +2,7 @@
 #include <d3d12.h>
 #include <wrl.h>
 #include <stdexcept>
+#include "MemoryLedger.h"
 
 class ShadowMap
 {
@@ -56,6 +57,8 @@ public:
         {
             throw std::runtime_error("CreateCommittedResource (shadow map) failed");
         }
+        m_ledger = MemoryLedger::I().Track(MemoryCategory::RenderTarget, "shadow map",
+            0, MemoryLedger::ResourceBytes(device, texDesc));
 
         D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc{};
         dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
@@ -121,6 +124,7 @@ private:
 
     D3D12_VIEWPORT m_viewport{};
     D3D12_RECT     m_scissor{};
+    MemoryLedger::Handle m_ledger;
 
     UINT m_width = 0;
     UINT m_height = 0;
@@ -0,0 +1,108 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "SkinnedMesh.h"
+#include "JobSystem.h"
+#include "WindowDX12.h"
+#include <algorithm>
+#include <cmath>
+
+int SkinnedModel::FindClip(const std::string& name) const
+{
+    for (size_t i = 0; i < clips.size(); ++i)
+        if (clips[i].Name() == name) return int(i);
+    return -1;
+}
+
+// Private copy of the bind asset with its own pool block, written every frame.
+static std::shared_ptr<MeshAsset> MakeInstanceAsset(const SkinnedModel& model)
+{
+    auto asset = std::make_shared<MeshAsset>(*model.bindAsset);
+    asset->cached = false;
+    asset->name += " (skinned)";
+    asset->residency = CpuResidency::Discard;
+    asset->Upload(WindowDX12::Get().GetDevice());
+    return asset;
+}
+
+SkinnedMesh::SkinnedMesh(std::shared_ptr<const SkinnedModel> model)
+    : m_model(std::move(model))
+    , m_asset(MakeInstanceAsset(*m_model))
+    , m_mesh(m_asset)
+{
+    const size_t joints = m_model->skeleton.JointCount();
+    m_pose.Resize(joints);
+    m_fadePose.Resize(joints);
+    m_world.resize(joints);
+    m_palette.resize(joints);
+    if (!m_model->clips.empty()) m_current.clip = 0;
+}
+
+void SkinnedMesh::Play(int clip, float fadeSeconds, bool loop)
+{
+    if (clip >= int(m_model->clips.size())) clip = -1;
+    if (fadeSeconds > 0.f) {
+        m_previous = m_current;
+        m_fade = 0.f;
+        m_fadeLength = fadeSeconds;
+    }
+    else {
+        m_fadeLength = 0.f;
+    }
+    m_current = Layer{ clip, 0.f, loop };
+}
+
+void SkinnedMesh::Advance(float dt)
+{
+    const float step = dt * m_speed;
+    m_current.time += step;
+    if (m_fadeLength > 0.f) {
+        m_previous.time += step;
+        m_fade += dt;
+        if (m_fade >= m_fadeLength) m_fadeLength = 0.f;
+    }
+
+    // keep looping clocks small so float precision does not degrade
+    auto wrap = [this](Layer& layer) {
+        if (layer.clip < 0 || !layer.loop) return;
+        const float duration = m_model->clips[layer.clip].Duration();
+        if (duration > 0.f) layer.time = std::fmod(layer.time, duration);
+        if (layer.time < 0.f) layer.time += duration;
+    };
+    wrap(m_current);
+    wrap(m_previous);
+}
+
+void SkinnedMesh::Evaluate()
+{
+    const SkinnedModel& model = *m_model;
+    if (m_current.clip >= 0) model.clips[m_current.clip].Sample(m_current.time, m_current.loop, m_pose);
+    else m_pose.SetBindPose(model.skeleton);
+
+    if (m_fadeLength > 0.f) {
+        if (m_previous.clip >= 0) model.clips[m_previous.clip].Sample(m_previous.time, m_previous.loop, m_fadePose);
+        else m_fadePose.SetBindPose(model.skeleton);
+        BlendPoses(m_fadePose, m_pose, m_fade / m_fadeLength, m_pose);
+    }
+
+    ComputeSkinningPalette(model.skeleton, m_pose, m_world.data(), m_palette.data());
+
+    const GeometryBlock* block = m_asset->geometry.get();
+    const MeshAsset& bind = *model.bindAsset;
+    if (!block || block->VertexCount() != bind.vertices.size()) return;
+    SkinVertices(bind.vertices.data(), model.influences.data(), bind.vertices.size(),
+        m_palette.data(), block->Vertices());
+    // the triangles moved
+    m_asset->bvh.reset();
+}
+
+void SkinnedMesh::UpdateAll(SkinnedMesh* const* instances, size_t count, float dt)
+{
+    for (size_t i = 0; i < count; ++i)
+        instances[i]->Advance(dt);
+
+    JobSystem::I().ParallelFor(count, 1, [instances](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            instances[i]->Evaluate();
+    });
+}
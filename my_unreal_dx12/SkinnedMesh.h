@@ -0,0 +1,76 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Animation.h"
+#include "Mesh.h"
+
+// Immutable part of a skinned model, shared by every instance through
+// ResourceCache::getSkinnedModel.
+struct SkinnedModel
+{
+    std::vector<SkinInfluence> influences;
+    Skeleton skeleton;
+    std::vector<AnimationClip> clips;
+    // bind pose vertices, indices and materials; never drawn itself
+    std::shared_ptr<MeshAsset> bindAsset;
+
+    // skeleton, influences and clips
+    MemoryLedger::Handle ledger;
+
+    // clip index or -1
+    int FindClip(const std::string& name) const;
+};
+
+// One animated character. Skinning runs on the CPU straight into the pool
+// memory of a private copy of the bind asset, so the vertex layout and the
+// pipelines stay unchanged; Renderer::EndFrame waits for the GPU, so that
+// memory is free to rewrite before the next frame is recorded.
+class SkinnedMesh
+{
+public:
+    explicit SkinnedMesh(std::shared_ptr<const SkinnedModel> model);
+
+    SkinnedMesh(const SkinnedMesh&) = delete;
+    SkinnedMesh& operator=(const SkinnedMesh&) = delete;
+
+    // Switches to clip, cross-fading from the current one over fadeSeconds.
+    void Play(int clip, float fadeSeconds = 0.f, bool loop = true);
+    void SetSpeed(float speed) { m_speed = speed; }
+    void SetTime(float seconds) { m_current.time = seconds; }
+
+    const SkinnedModel& Model() const { return *m_model; }
+    // position, rotation and scale of the character, drawn with WindowDX12::Draw
+    Mesh& GetMesh() { return m_mesh; }
+    const Mesh& GetMesh() const { return m_mesh; }
+
+    // Advances the clocks by dt seconds, then samples, blends, builds the
+    // palette and skins each instance, spread over the JobSystem.
+    static void UpdateAll(SkinnedMesh* const* instances, size_t count, float dt);
+
+private:
+    struct Layer
+    {
+        int clip = -1;
+        float time = 0.f;
+        bool loop = true;
+    };
+
+    void Advance(float dt);
+    void Evaluate();
+
+    std::shared_ptr<const SkinnedModel> m_model;
+    std::shared_ptr<MeshAsset> m_asset;
+    Mesh m_mesh;
+
+    Layer m_current;
+    Layer m_previous;
+    float m_fade = 0.f;         // seconds into the cross-fade
+    float m_fadeLength = 0.f;   // zero when not fading
+    float m_speed = 1.f;
+
+    Pose m_pose;
+    Pose m_fadePose;
+    std::vector<JointMatrix> m_world;
+    std::vector<JointMatrix> m_palette;
+};
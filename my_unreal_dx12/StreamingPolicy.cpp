@@ -0,0 +1,192 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "StreamingPolicy.h"
+#include <algorithm>
+#include <cmath>
+
+StreamingPolicy::Id StreamingPolicy::Add(uint32_t width, uint32_t height, const uint64_t* levelBytes, uint32_t levelCount,
+    uint32_t coarsestFirst)
+{
+    Id id;
+    if (!m_free.empty()) {
+        id = m_free.back();
+        m_free.pop_back();
+    }
+    else {
+        id = Id(m_entries.size());
+        m_entries.emplace_back();
+    }
+
+    Entry& e = m_entries[id];
+    e = Entry{};
+    e.live = true;
+    e.width = width;
+    e.height = height;
+    e.suffixBytes.assign(size_t(levelCount) + 1, 0);
+    for (uint32_t l = levelCount; l-- > 0;)
+        e.suffixBytes[l] = e.suffixBytes[l + 1] + levelBytes[l];
+
+    uint32_t tail = 0;
+    while (tail + 1 < levelCount && std::max(std::max(width >> tail, 1u), std::max(height >> tail, 1u)) > m_settings.tailSize)
+        ++tail;
+    e.minFirst = levelCount ? std::min(std::min(tail, coarsestFirst), levelCount - 1) : 0;
+    e.first = e.target = e.minFirst;
+    m_resident += e.suffixBytes[e.first];
+    return id;
+}
+
+void StreamingPolicy::Remove(Id id)
+{
+    Entry& e = m_entries[id];
+    if (!e.live) return;
+    m_resident -= e.suffixBytes[e.first];
+    e = Entry{};
+    m_free.push_back(id);
+}
+
+void StreamingPolicy::Request(Id id, float mip, float weight)
+{
+    Entry& e = m_entries[id];
+    if (!e.live) return;
+    e.requested = e.seen ? std::min(e.requested, mip) : mip;
+    e.frameWeight += weight;
+    e.seen = true;
+}
+
+float StreamingPolicy::MipFor(uint32_t width, uint32_t height, float uvPerPixel)
+{
+    if (!(uvPerPixel > 0.f)) return 0.f;
+    return std::log2(uvPerPixel * float(std::max(width, height)));
+}
+
+float StreamingPolicy::KeepValue(const Entry& e) const
+{
+    if (e.first < e.target) return 0.f;
+    return e.weight * float(1 + e.first - e.target);
+}
+
+bool StreamingPolicy::Evict(float value, Id except)
+{
+    Id best = except;
+    float bestValue = value;
+    for (Id id = 0; id < Id(m_entries.size()); ++id) {
+        const Entry& e = m_entries[id];
+        if (!e.live || id == except || e.first >= e.minFirst) continue;
+        const float v = KeepValue(e);
+        // among equals the largest level frees the most
+        if (v < bestValue || (best != except && v == bestValue && LevelBytes(e, e.first) > LevelBytes(m_entries[best], m_entries[best].first))) {
+            best = id;
+            bestValue = v;
+        }
+    }
+    if (best == except) return false;
+
+    Entry& e = m_entries[best];
+    m_resident -= LevelBytes(e, e.first);
+    ++e.first;
+    e.coarserFor = 0;
+    ++m_stats.evictions;
+    m_evicted.push_back(best);
+    return true;
+}
+
+const std::vector<StreamingPolicy::Change>& StreamingPolicy::Update()
+{
+    const Settings& s = m_settings;
+    m_changes.clear();
+    m_firstBefore.resize(m_entries.size());
+
+    // targets, and the drops the hysteresis allows
+    for (Id id = 0; id < Id(m_entries.size()); ++id) {
+        Entry& e = m_entries[id];
+        if (!e.live) continue;
+        m_firstBefore[id] = e.first;
+
+        float wanted = 1e30f;
+        if (e.seen) {
+            e.weight = e.frameWeight;
+            wanted = std::max(e.requested + s.bias, 0.f);
+        }
+        else {
+            e.weight *= s.weightDecay;
+        }
+        e.target = wanted >= float(e.minFirst) ? e.minFirst : uint32_t(wanted);
+        e.seen = false;
+        e.frameWeight = 0.f;
+
+        if (e.target > e.first && wanted >= float(e.first + 1) + s.hysteresis) {
+            if (++e.coarserFor >= s.dropFrames) {
+                m_resident -= e.suffixBytes[e.first] - e.suffixBytes[e.target];
+                e.first = e.target;
+                e.coarserFor = 0;
+                ++m_stats.drops;
+            }
+        }
+        else {
+            e.coarserFor = 0;
+        }
+    }
+
+    // a smaller budget than what is resident
+    while (m_resident > s.budgetBytes && Evict(1e30f, Id(m_entries.size()))) {}
+
+    struct Candidate { Id id; float priority; };
+    std::vector<Candidate> candidates;
+    for (Id id = 0; id < Id(m_entries.size()); ++id) {
+        const Entry& e = m_entries[id];
+        if (e.live && e.target < e.first)
+            candidates.push_back({ id, e.weight * float(e.first - e.target) });
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+        [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+
+    uint64_t uploaded = 0;
+    for (const Candidate& c : candidates) {
+        Entry& e = m_entries[c.id];
+        const uint64_t bytes = LevelBytes(e, e.first - 1);
+        // a new first mip re-uploads the levels below it as well
+        const uint64_t upload = e.suffixBytes[e.first - 1];
+        if (uploaded && uploaded + upload > s.uploadBytesPerUpdate) {
+            ++m_stats.deferred;
+            continue;
+        }
+        m_evicted.clear();
+        while (m_resident + bytes > s.budgetBytes && Evict(c.priority, c.id)) {}
+        if (m_resident + bytes > s.budgetBytes) {
+            // not enough to free, the victims keep their levels
+            for (Id v : m_evicted) {
+                Entry& victim = m_entries[v];
+                --victim.first;
+                m_resident += LevelBytes(victim, victim.first);
+                --m_stats.evictions;
+            }
+            ++m_stats.deferred;
+            continue;
+        }
+        --e.first;
+        m_resident += bytes;
+        uploaded += upload;
+        ++m_stats.loads;
+    }
+
+    for (Id id = 0; id < Id(m_entries.size()); ++id) {
+        const Entry& e = m_entries[id];
+        if (e.live && e.first != m_firstBefore[id])
+            m_changes.push_back({ id, e.first });
+    }
+    return m_changes;
+}
+
+StreamingPolicy::Stats StreamingPolicy::GetStats() const
+{
+    Stats s = m_stats;
+    s.residentBytes = m_resident;
+    s.budgetBytes = m_settings.budgetBytes;
+    for (const Entry& e : m_entries) {
+        if (!e.live) continue;
+        ++s.textures;
+        s.wantedBytes += e.suffixBytes[e.target];
+    }
+    return s;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// GPU-free residency decisions for mip streaming. Every texture has a first
+// resident mip: that level and all smaller ones are in memory. Each frame
+// the renderer reports, per visible use, the mip the use samples (see MipFor)
+// and a weight ranking the use; Update turns the reports into new first mips.
+//
+// Loads go one level per texture per Update, the most needed first: weight
+// times the levels missing. When a load does not fit the budget it evicts
+// finer levels than needed from any texture, then needed levels of textures
+// that matter less than the load. Without budget pressure a level is only
+// dropped after the requests stayed hysteresis past it for dropFrames
+// updates in a row, so a texture at a mip boundary does not bounce.
+class StreamingPolicy
+{
+public:
+    using Id = uint32_t;
+
+    struct Settings
+    {
+        uint64_t budgetBytes = 512ull << 20;
+        uint64_t uploadBytesPerUpdate = 32ull << 20;    // at least one load always goes
+        uint32_t tailSize = 64;     // levels of this size and smaller never leave
+        float bias = 0.f;           // added to every request, positive is blurrier
+        float hysteresis = 0.25f;   // in mips
+        uint32_t dropFrames = 60;
+        float weightDecay = 0.9f;   // per Update, while a texture goes unrequested
+    };
+
+    struct Change
+    {
+        Id id = 0;
+        uint32_t firstMip = 0;
+    };
+
+    struct Stats
+    {
+        uint32_t textures = 0;
+        uint64_t residentBytes = 0;
+        uint64_t wantedBytes = 0;   // with every texture at the mip it was asked for
+        uint64_t budgetBytes = 0;
+        uint64_t loads = 0;         // levels, since creation
+        uint64_t drops = 0;         // textures dropping levels after the hysteresis
+        uint64_t evictions = 0;     // levels evicted for the budget
+        uint64_t deferred = 0;      // loads that did not fit an Update
+    };
+
+    // levelBytes[l] for each of levelCount levels of a width x height chain.
+    // The texture starts, and stays at least, at the first level no larger
+    // than tailSize, or at coarsestFirst when that is finer (formats whose
+    // small levels cannot be the top of a resource).
+    Id Add(uint32_t width, uint32_t height, const uint64_t* levelBytes, uint32_t levelCount, uint32_t coarsestFirst);
+    void Remove(Id id);
+
+    // mip may be fractional and negative; the finest request of an Update wins
+    void Request(Id id, float mip, float weight);
+
+    // Ends the frame's requests; the first mips that moved, one per texture.
+    const std::vector<Change>& Update();
+
+    uint32_t FirstMip(Id id) const { return m_entries[id].first; }
+    uint32_t TargetMip(Id id) const { return m_entries[id].target; }
+    uint32_t MinFirstMip(Id id) const { return m_entries[id].minFirst; }
+
+    void SetSettings(const Settings& settings) { m_settings = settings; }
+    const Settings& GetSettings() const { return m_settings; }
+    Stats GetStats() const;
+
+    // The mip a use samples when one screen pixel spans uvPerPixel texture
+    // coordinate units; 0 (not known) asks for the full resolution.
+    static float MipFor(uint32_t width, uint32_t height, float uvPerPixel);
+
+private:
+    struct Entry
+    {
+        bool live = false;
+        uint32_t width = 0, height = 0;
+        std::vector<uint64_t> suffixBytes;  // [l]: levels l to the end, one past the end 0
+        uint32_t minFirst = 0;
+        uint32_t first = 0;
+        uint32_t target = 0;
+        float requested = 0.f;
+        bool seen = false;                  // requested this Update
+        float frameWeight = 0.f;
+        float weight = 0.f;
+        uint32_t coarserFor = 0;
+    };
+
+    uint64_t LevelBytes(const Entry& e, uint32_t level) const { return e.suffixBytes[level] - e.suffixBytes[level + 1]; }
+    // what losing the finest resident level costs; 0 for a level finer than needed
+    float KeepValue(const Entry& e) const;
+    // evicts the cheapest level worth less than value, false when none is;
+    // appends the texture to m_evicted
+    bool Evict(float value, Id except);
+
+    Settings m_settings;
+    std::vector<Entry> m_entries;
+    std::vector<Id> m_free;
+    std::vector<Change> m_changes;
+    std::vector<uint32_t> m_firstBefore;
+    std::vector<Id> m_evicted;
+    uint64_t m_resident = 0;
+    Stats m_stats;
+};
@@ -0,0 +1,102 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "Terrain.h"
+#include "WindowDX12.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+static bool HasRawExtension(const std::string& path)
+{
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = path.substr(dot + 1);
+    for (auto& c : ext) c = char(tolower(c));
+    return ext == "r16" || ext == "raw";
+}
+
+// the patch is built from the normalized patchDim the quadtree and the shader use
+Terrain::Terrain(const std::string& heightmapPath, const TerrainQuadtree::Settings& settings)
+    : m_patch(Mesh::CreateGridPatch(TerrainQuadtree::Normalize(settings).patchDim))
+{
+    if (HasRawExtension(heightmapPath)) {
+        // mapped, the pages the tiles read come in from the file cache
+        if (!m_file.Open(heightmapPath))
+            throw std::runtime_error("Failed to open heightmap: " + heightmapPath);
+        const size_t bytes = m_file.Size();
+        const uint32_t side = uint32_t(std::lround(std::sqrt(double(bytes / 2))));
+        if (side < 2 || size_t(side) * side * 2 != bytes)
+            throw std::runtime_error("Raw heightmap is not a square 16-bit image: " + heightmapPath);
+        m_width = m_height = side;
+    }
+    else {
+        int iw = 0, ih = 0, comp = 0;
+        stbi_us* data = stbi_load_16(heightmapPath.c_str(), &iw, &ih, &comp, 1);
+        if (!data)
+            throw std::runtime_error("Failed to load heightmap: " + heightmapPath);
+        m_decoded.assign(data, data + size_t(iw) * ih);
+        stbi_image_free(data);
+        m_width = uint32_t(iw);
+        m_height = uint32_t(ih);
+    }
+
+    m_tree.Build(Heights(), m_width, m_height, settings);
+    const TerrainQuadtree::Settings& ts = m_tree.GetSettings();
+
+    // one selection must fit, half as much again keeps tiles around as the
+    // camera moves; D3D12 arrays stop at 2048 slices
+    const uint32_t selected = m_tree.MaxSelectedNodes();
+    if (selected > D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION)
+        throw std::runtime_error("Terrain settings select up to " + std::to_string(selected)
+            + " nodes, more than the 2048 tiles of the tile array; lower lod0Range or raise patchDim: "
+            + heightmapPath);
+    const uint32_t capacity = std::min<uint32_t>(selected + selected / 2, D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION);
+    m_tileCache.Reset(capacity);
+
+    const uint32_t side = TerrainTileCache::TileSide(ts.patchDim);
+    m_tileScratch.assign(size_t(side) * side * capacity, 0);
+    std::vector<const void*> slices(capacity);
+    for (uint32_t s = 0; s < capacity; ++s)
+        slices[s] = m_tileScratch.data() + size_t(side) * side * s;
+
+    auto& win = WindowDX12::Get();
+    auto alloc = win.AllocateSrv();
+    m_tiles = std::make_shared<Texture>();
+    m_tiles->CreateArrayFromPixels(win.GetGraphicsDevice(), slices.data(), side, side, capacity,
+        DXGI_FORMAT_R16_UNORM, alloc.cpu, alloc.gpu, (heightmapPath + " (tiles)").c_str());
+
+    m_ledger = MemoryLedger::I().Track(MemoryCategory::Terrain, heightmapPath + " (quadtree)",
+        m_tree.MemoryBytes() + (m_decoded.capacity() + m_tileScratch.capacity()) * sizeof(uint16_t), 0);
+}
+
+const uint16_t* Terrain::Heights() const
+{
+    return m_file.IsOpen() ? reinterpret_cast<const uint16_t*>(m_file.Data()) : m_decoded.data();
+}
+
+bool Terrain::Page(const std::vector<TerrainQuadtree::Node>& nodes, std::vector<uint32_t>& slices)
+{
+    if (!m_tileCache.Assign(nodes, slices, m_fills))
+        return false;
+    if (m_fills.empty())
+        return true;
+
+    const uint32_t patchDim = m_tree.GetSettings().patchDim;
+    const size_t tileSamples = size_t(TerrainTileCache::TileSide(patchDim)) * TerrainTileCache::TileSide(patchDim);
+    std::vector<UINT> fillSlices(m_fills.size());
+    std::vector<const void*> data(m_fills.size());
+    for (size_t i = 0; i < m_fills.size(); ++i) {
+        const TerrainQuadtree::Node& n = nodes[m_fills[i]];
+        uint16_t* tile = m_tileScratch.data() + tileSamples * i;
+        TerrainTileCache::Extract(Heights(), m_width, m_height, patchDim, n.level, n.nx, n.nz, tile);
+        fillSlices[i] = slices[m_fills[i]];
+        data[i] = tile;
+    }
+    // staged during the call, so the scratch is free again for the next one
+    m_tiles->UpdateSlices(WindowDX12::Get().GetGraphicsDevice(), fillSlices.data(), UINT(fillSlices.size()), data.data());
+    return true;
+}
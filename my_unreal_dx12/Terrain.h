@@ -0,0 +1,57 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "MappedFile.h"
+#include "MemoryLedger.h"
+#include "Mesh.h"
+#include "Texture.h"
+#include "TerrainQuadtree.h"
+#include "TerrainTileCache.h"
+
+// Heightmap terrain drawn with CDLOD: one shared grid patch is instanced per
+// selected quadtree node and displaced in TerrainVertex.hlsl from that node's
+// tile, a patch-sized R16 slice of a tile array paged in by Page. The array
+// is sized by the LOD settings, so GPU memory does not grow with the map;
+// the heights stay in the mapped .r16 file, or the decoded image, on the CPU.
+class Terrain
+{
+public:
+    // .r16 / .raw: square, 16-bit little endian, no header. Anything else goes
+    // through stb_image (16-bit PNG keeps its precision, 8-bit images are widened).
+    // Throws when the settings select more nodes than a tile array holds.
+    Terrain(const std::string& heightmapPath, const TerrainQuadtree::Settings& settings = {});
+
+    // Assigns every node a tile slice and queues the copies of the tiles that
+    // were not resident; slices[i] is the slice of nodes[i]. Returns false
+    // when the nodes do not fit the tile array, which the constructor rules out.
+    bool Page(const std::vector<TerrainQuadtree::Node>& nodes, std::vector<uint32_t>& slices);
+
+    void SetColor(float r, float g, float b) { m_color = { r, g, b, 1.f }; }
+    const DirectX::XMFLOAT4& Color() const { return m_color; }
+
+    const Mesh& Patch() const { return m_patch; }
+    const Texture& Tiles() const { return *m_tiles; }
+    const TerrainQuadtree& Quadtree() const { return m_tree; }
+    TerrainTileCache::Stats TileStats() const { return m_tileCache.GetStats(); }
+
+    // indices of one patch quadrant, quadrant q starts at q * QuadrantIndexCount()
+    UINT QuadrantIndexCount() const { return m_patch.IndexCount() / 4; }
+
+private:
+    const uint16_t* Heights() const;
+
+    MappedFile m_file;                  // .r16 / .raw heights
+    std::vector<uint16_t> m_decoded;    // or those of a decoded image
+    uint32_t m_width = 0, m_height = 0;
+
+    TerrainQuadtree m_tree;
+    Mesh m_patch;
+    std::shared_ptr<Texture> m_tiles;
+    TerrainTileCache m_tileCache;
+    std::vector<uint16_t> m_tileScratch;
+    std::vector<uint32_t> m_fills;
+    DirectX::XMFLOAT4 m_color{ 0.35f, 0.45f, 0.25f, 1.f };
+    MemoryLedger::Handle m_ledger;
+};
@@ -0,0 +1,179 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "TerrainQuadtree.h"
+#include <algorithm>
+#include <cmath>
+
+TerrainQuadtree::Settings TerrainQuadtree::Normalize(const Settings& settings)
+{
+    Settings s = settings;
+    s.patchDim = std::max(2u, settings.patchDim & ~1u);
+    s.lodLevels = std::max(1u, settings.lodLevels);
+    return s;
+}
+
+void TerrainQuadtree::Build(const uint16_t* heights, uint32_t width, uint32_t height, const Settings& settings)
+{
+    m_settings = Normalize(settings);
+    m_width = width;
+    m_height = height;
+
+    const uint32_t levels = m_settings.lodLevels;
+    const uint32_t leaf = m_settings.patchDim;
+
+    m_levels.assign(levels, Level{});
+
+    // finest level straight from the heightmap; nodes share their edge texels
+    {
+        Level& l = m_levels[0];
+        l.nodesX = std::max(1u, (width - 1 + leaf - 1) / leaf);
+        l.nodesZ = std::max(1u, (height - 1 + leaf - 1) / leaf);
+        l.bounds.resize(size_t(l.nodesX) * l.nodesZ);
+        for (uint32_t nz = 0; nz < l.nodesZ; ++nz) {
+            for (uint32_t nx = 0; nx < l.nodesX; ++nx) {
+                const uint32_t x0 = nx * leaf, x1 = std::min(width - 1, x0 + leaf);
+                const uint32_t z0 = nz * leaf, z1 = std::min(height - 1, z0 + leaf);
+                uint16_t mn = 0xFFFF, mx = 0;
+                for (uint32_t z = z0; z <= z1; ++z) {
+                    const uint16_t* row = heights + size_t(z) * width;
+                    for (uint32_t x = x0; x <= x1; ++x) {
+                        mn = std::min(mn, row[x]);
+                        mx = std::max(mx, row[x]);
+                    }
+                }
+                l.bounds[size_t(nz) * l.nodesX + nx] = { mn, mx };
+            }
+        }
+    }
+
+    for (uint32_t li = 1; li < levels; ++li) {
+        const Level& c = m_levels[li - 1];
+        Level& l = m_levels[li];
+        l.nodesX = (c.nodesX + 1) / 2;
+        l.nodesZ = (c.nodesZ + 1) / 2;
+        l.bounds.resize(size_t(l.nodesX) * l.nodesZ);
+        for (uint32_t nz = 0; nz < l.nodesZ; ++nz) {
+            for (uint32_t nx = 0; nx < l.nodesX; ++nx) {
+                MinMax mm{ 0xFFFF, 0 };
+                for (uint32_t q = 0; q < 4; ++q) {
+                    const uint32_t cx = nx * 2 + (q & 1), cz = nz * 2 + (q >> 1);
+                    if (cx >= c.nodesX || cz >= c.nodesZ) continue;
+                    const MinMax& b = c.bounds[size_t(cz) * c.nodesX + cx];
+                    mm.mn = std::min(mm.mn, b.mn);
+                    mm.mx = std::max(mm.mx, b.mx);
+                }
+                l.bounds[size_t(nz) * l.nodesX + nx] = mm;
+            }
+        }
+    }
+
+    m_ranges.resize(levels);
+    m_morphStart.resize(levels);
+    float prev = 0.f;
+    for (uint32_t li = 0; li < levels; ++li) {
+        m_ranges[li] = m_settings.lod0Range * float(1u << li);
+        m_morphStart[li] = prev + (m_ranges[li] - prev) * m_settings.morphStartRatio;
+        prev = m_ranges[li];
+    }
+}
+
+void TerrainQuadtree::NodeBox(uint32_t level, uint32_t nx, uint32_t nz, float mn[3], float mx[3]) const
+{
+    const Level& l = m_levels[level];
+    const MinMax& b = l.bounds[size_t(nz) * l.nodesX + nx];
+    const float texels = float(m_settings.patchDim << level);
+    const float size = texels * m_settings.texelSpacing;
+    const float hs = m_settings.heightScale / 65535.f;
+
+    mn[0] = m_settings.originX + nx * size;
+    mn[2] = m_settings.originZ + nz * size;
+    mx[0] = std::min(mn[0] + size, m_settings.originX + (m_width - 1) * m_settings.texelSpacing);
+    mx[2] = std::min(mn[2] + size, m_settings.originZ + (m_height - 1) * m_settings.texelSpacing);
+    mn[1] = m_settings.baseHeight + b.mn * hs;
+    mx[1] = m_settings.baseHeight + b.mx * hs;
+}
+
+static bool BoxIntersectsSphere(const float mn[3], const float mx[3], const float c[3], float r)
+{
+    float d2 = 0.f;
+    for (int a = 0; a < 3; ++a) {
+        const float v = std::max(mn[a] - c[a], std::max(0.f, c[a] - mx[a]));
+        d2 += v * v;
+    }
+    return d2 <= r * r;
+}
+
+// Returns false when the node is beyond the range of its level, the parent
+// then draws that quarter itself.
+bool TerrainQuadtree::SelectNode(uint32_t level, uint32_t nx, uint32_t nz, const float cam[3],
+    const Frustum* frustum, std::vector<Node>& out, Stats& stats) const
+{
+    const Level& l = m_levels[level];
+    if (nx >= l.nodesX || nz >= l.nodesZ)
+        return true;
+
+    float mn[3], mx[3];
+    NodeBox(level, nx, nz, mn, mx);
+
+    if (!BoxIntersectsSphere(mn, mx, cam, m_ranges[level]))
+        return false;
+    if (frustum && !frustum->IntersectsBox(mn, mx))
+        return true;
+
+    uint32_t quadrants = 0xF;
+    if (level > 0 && BoxIntersectsSphere(mn, mx, cam, m_ranges[level - 1])) {
+        quadrants = 0;
+        for (uint32_t q = 0; q < 4; ++q) {
+            if (!SelectNode(level - 1, nx * 2 + (q & 1), nz * 2 + (q >> 1), cam, frustum, out, stats))
+                quadrants |= 1u << q;
+        }
+        if (!quadrants)
+            return true;
+    }
+
+    const float size = float(m_settings.patchDim << level) * m_settings.texelSpacing;
+    out.push_back({ mn[0], mn[2], size, mn[1], mx[1], level, quadrants, nx, nz });
+
+    uint32_t drawn = 0;
+    for (uint32_t q = quadrants; q; q &= q - 1) ++drawn;
+    const uint32_t half = m_settings.patchDim / 2;
+    stats.nodes += 1;
+    stats.quadrants += drawn;
+    stats.triangles += drawn * half * half * 2;
+    return true;
+}
+
+TerrainQuadtree::Stats TerrainQuadtree::Select(const float cameraPos[3], const Frustum* frustum, std::vector<Node>& out) const
+{
+    out.clear();
+    Stats stats;
+    if (m_levels.empty()) return stats;
+
+    const uint32_t top = uint32_t(m_levels.size()) - 1;
+    const Level& roots = m_levels[top];
+    for (uint32_t nz = 0; nz < roots.nodesZ; ++nz)
+        for (uint32_t nx = 0; nx < roots.nodesX; ++nx)
+            SelectNode(top, nx, nz, cameraPos, frustum, out, stats);
+    return stats;
+}
+
+uint32_t TerrainQuadtree::MaxSelectedNodes() const
+{
+    // range and node size both double per level, so the ratio is the same
+    const double nodeSize = double(m_settings.patchDim) * m_settings.texelSpacing;
+    const double span = std::ceil(2.0 * m_settings.lod0Range / nodeSize) + 1.0;
+    const uint32_t perAxis = uint32_t(std::min(span, 65536.0));
+    uint64_t total = 0;
+    for (const Level& l : m_levels)
+        total += uint64_t(std::min(l.nodesX, perAxis)) * std::min(l.nodesZ, perAxis);
+    return uint32_t(std::min<uint64_t>(total, UINT32_MAX));
+}
+
+size_t TerrainQuadtree::MemoryBytes() const
+{
+    size_t bytes = (m_ranges.capacity() + m_morphStart.capacity()) * sizeof(float);
+    for (const Level& l : m_levels)
+        bytes += l.bounds.capacity() * sizeof(MinMax);
+    return bytes;
+}
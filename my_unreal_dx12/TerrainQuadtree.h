@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Frustum.h"
+
+// CDLOD node selection over a 16-bit heightmap. Every node is drawn with the
+// same patchDim x patchDim grid, so the finest level has one quad per
+// heightmap texel and each coarser level doubles the node size. Only a min/max
+// height pair per node is stored.
+class TerrainQuadtree
+{
+public:
+    struct Settings
+    {
+        uint32_t patchDim = 32;         // grid quads per node side, even
+        uint32_t lodLevels = 6;         // view distance is lod0Range * 2^(lodLevels-1)
+        float lod0Range = 64.f;         // world distance drawn at the finest level
+        float morphStartRatio = 0.66f;  // fraction of a level's range before morphing starts
+        float texelSpacing = 1.f;       // world units between heightmap samples
+        float heightScale = 100.f;      // world height of a 65535 sample
+        float baseHeight = 0.f;
+        float originX = 0.f;            // world position of texel (0, 0)
+        float originZ = 0.f;
+    };
+
+    struct Node
+    {
+        float x, z;             // world position of the node corner
+        float size;             // world size of the node side
+        float minY, maxY;
+        uint32_t level;         // 0 = finest
+        uint32_t quadrants;     // bit (qx + 2*qz) set for each quarter to draw, 0xF = all
+        uint32_t nx, nz;        // index of the node within its level
+    };
+
+    struct Stats
+    {
+        uint32_t nodes = 0;
+        uint32_t quadrants = 0;
+        uint32_t triangles = 0;
+    };
+
+    // patchDim rounded down to even and at least 2, at least one level;
+    // Build keeps these, so patches and shaders should use them too
+    static Settings Normalize(const Settings& settings);
+
+    void Build(const uint16_t* heights, uint32_t width, uint32_t height, const Settings& settings);
+
+    // frustum may be null to skip culling
+    Stats Select(const float cameraPos[3], const Frustum* frustum, std::vector<Node>& out) const;
+
+    // distance band over which vertices of a level morph into the next one
+    float MorphStart(uint32_t level) const { return m_morphStart[level]; }
+    float MorphEnd(uint32_t level) const { return m_ranges[level]; }
+
+    // Most nodes one Select can return: per level, the nodes a square of
+    // twice that level's range overlaps. Depends on the settings, not the
+    // map size beyond small maps, so it bounds the per-node GPU data.
+    uint32_t MaxSelectedNodes() const;
+
+    const Settings& GetSettings() const { return m_settings; }
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    size_t MemoryBytes() const;
+
+private:
+    struct MinMax { uint16_t mn, mx; };
+    struct Level {
+        uint32_t nodesX = 0, nodesZ = 0;
+        std::vector<MinMax> bounds;
+    };
+
+    void NodeBox(uint32_t level, uint32_t nx, uint32_t nz, float mn[3], float mx[3]) const;
+    bool SelectNode(uint32_t level, uint32_t nx, uint32_t nz, const float cam[3],
+        const Frustum* frustum, std::vector<Node>& out, Stats& stats) const;
+
+    Settings m_settings;
+    uint32_t m_width = 0, m_height = 0;
+    std::vector<Level> m_levels;
+    std::vector<float> m_ranges;
+    std::vector<float> m_morphStart;
+};
@@ -0,0 +1,92 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "TerrainTileCache.h"
+#include <algorithm>
+
+void TerrainTileCache::Extract(const uint16_t* heights, uint32_t width, uint32_t height,
+    uint32_t patchDim, uint32_t level, uint32_t nx, uint32_t nz, uint16_t* out)
+{
+    const uint32_t side = TileSide(patchDim);
+    const int64_t stride = int64_t(1) << level;
+    const int64_t x0 = int64_t(nx) * patchDim * stride - stride;
+    const int64_t z0 = int64_t(nz) * patchDim * stride - stride;
+
+    for (uint32_t j = 0; j < side; ++j) {
+        const int64_t z = std::clamp<int64_t>(z0 + j * stride, 0, int64_t(height) - 1);
+        const uint16_t* row = heights + size_t(z) * width;
+        for (uint32_t i = 0; i < side; ++i)
+            out[size_t(j) * side + i] = row[std::clamp<int64_t>(x0 + i * stride, 0, int64_t(width) - 1)];
+    }
+}
+
+void TerrainTileCache::Reset(uint32_t capacity)
+{
+    m_slots.assign(capacity, Slot{});
+    m_lookup.clear();
+    m_lookup.reserve(capacity);
+    m_oldest = m_newest = kNone;
+    for (uint32_t s = 0; s < capacity; ++s)
+        PushNewest(s);
+    m_hits = m_fills = 0;
+}
+
+void TerrainTileCache::Unlink(uint32_t slot)
+{
+    Slot& s = m_slots[slot];
+    (s.prev != kNone ? m_slots[s.prev].next : m_oldest) = s.next;
+    (s.next != kNone ? m_slots[s.next].prev : m_newest) = s.prev;
+    s.prev = s.next = kNone;
+}
+
+void TerrainTileCache::PushNewest(uint32_t slot)
+{
+    Slot& s = m_slots[slot];
+    s.prev = m_newest;
+    s.next = kNone;
+    (m_newest != kNone ? m_slots[m_newest].next : m_oldest) = slot;
+    m_newest = slot;
+}
+
+bool TerrainTileCache::Assign(const std::vector<TerrainQuadtree::Node>& nodes,
+    std::vector<uint32_t>& slices, std::vector<uint32_t>& fills)
+{
+    slices.clear();
+    fills.clear();
+    if (nodes.size() > m_slots.size())
+        return false;
+
+    // every node of this call becomes newer than anything it could evict
+    slices.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const uint64_t key = Key(nodes[i]);
+        uint32_t slot;
+        if (auto it = m_lookup.find(key); it != m_lookup.end()) {
+            slot = it->second;
+            ++m_hits;
+        }
+        else {
+            slot = m_oldest;
+            if (m_slots[slot].key != UINT64_MAX)
+                m_lookup.erase(m_slots[slot].key);
+            m_slots[slot].key = key;
+            m_lookup.emplace(key, slot);
+            fills.push_back(uint32_t(i));
+            ++m_fills;
+        }
+        Unlink(slot);
+        PushNewest(slot);
+        slices[i] = slot;
+    }
+    return true;
+}
+
+TerrainTileCache::Stats TerrainTileCache::GetStats() const
+{
+    Stats s;
+    s.capacity = Capacity();
+    s.resident = uint32_t(m_lookup.size());
+    s.hits = m_hits;
+    s.fills = m_fills;
+    return s;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "TerrainQuadtree.h"
+
+// Which slice of the terrain's tile array holds the heights of each selected
+// node. A tile is the node's patch grid, (patchDim + 1)^2 samples at the
+// node's texel stride plus a one-sample border for the normals, so every
+// level costs the same and the array is sized by the LOD settings instead of
+// the heightmap. Slices are reused least recently used first; the nodes of
+// one Assign never evict each other, so the capacity must cover
+// TerrainQuadtree::MaxSelectedNodes. GPU-free, Terrain uploads the tiles.
+class TerrainTileCache
+{
+public:
+    struct Stats
+    {
+        uint32_t capacity = 0;
+        uint32_t resident = 0;
+        uint64_t hits = 0;
+        uint64_t fills = 0;     // tiles extracted and uploaded
+    };
+
+    static uint32_t TileSide(uint32_t patchDim) { return patchDim + 3; }
+
+    // samples of one node's tile, row-major TileSide^2, sample (1, 1) at the
+    // node corner; past the map edge the edge texels repeat
+    static void Extract(const uint16_t* heights, uint32_t width, uint32_t height,
+        uint32_t patchDim, uint32_t level, uint32_t nx, uint32_t nz, uint16_t* out);
+
+    // forgets every tile
+    void Reset(uint32_t capacity);
+
+    // slices[i] is the slice of nodes[i]; fills gets the indices of the nodes
+    // whose slice must be (re)written before drawing. Returns false, and
+    // assigns nothing, when the nodes do not fit the capacity.
+    bool Assign(const std::vector<TerrainQuadtree::Node>& nodes,
+        std::vector<uint32_t>& slices, std::vector<uint32_t>& fills);
+
+    uint32_t Capacity() const { return uint32_t(m_slots.size()); }
+    Stats GetStats() const;
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Slot
+    {
+        uint64_t key = UINT64_MAX;
+        uint32_t prev = kNone, next = kNone;    // use order, oldest first
+    };
+
+    static uint64_t Key(const TerrainQuadtree::Node& n)
+    {
+        return (uint64_t(n.level) << 56) | (uint64_t(n.nz) << 28) | n.nx;
+    }
+    void Unlink(uint32_t slot);
+    void PushNewest(uint32_t slot);
+
+    std::vector<Slot> m_slots;
+    std::unordered_map<uint64_t, uint32_t> m_lookup;
+    uint32_t m_oldest = kNone, m_newest = kNone;
+    uint64_t m_hits = 0, m_fills = 0;
+};
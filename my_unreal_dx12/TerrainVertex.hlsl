@@ -0,0 +1,119 @@
+cbuffer Scene : register(b0)
+{
+    float4x4 uModel;
+    float4x4 uViewProj;
+    float4x4 uNormalMatrix;
+
+    float3 uCameraPos;
+    float uShininess;
+
+    float4x4 uLightViewProj;
+
+    float3 uLightDir;
+    float _pad0;
+
+    float3 uKs;
+    float uOpacity;
+
+    float3 uKe;
+    float _pad1;
+
+    float4 uTerrainNode;   // node x, node z, node size, patch dim
+    float4 uTerrainMorph;  // morph start, morph end, height scale, base height
+    float4 uTerrainMap;    // origin x, origin z, 1 / texel spacing, unused
+    float4 uTerrainColor;
+    float4 uTerrainTile;   // tile slice, texel stride, last texel x, last texel z
+};
+
+// Terrain::Page: per node (patch dim + 3)^2 samples at the node's texel
+// stride, sample (1, 1) at the node corner, edge texels repeated past the map
+Texture2DArray<float> uHeightTiles : register(t7);
+
+struct VSIn
+{
+    float3 pos : POSITION;
+    float3 nrm : NORMAL0;
+    float3 col : COLOR0;
+    float2 uv : TEXCOORD0;
+    float3 tangent : TANGENT0;
+    float3 bitangent : BINORMAL0;
+    float ao : TEXCOORD1;
+};
+
+struct VSOut
+{
+    float4 pos : SV_Position;
+    float3 worldPos : TEXCOORD0;
+    float3 nrm : NORMAL1;
+    float3 col : COLOR1;
+    float2 uv : TEXCOORD2;
+    float4 shadowPos : TEXCOORD3;
+    float3 tangent : TEXCOORD4;
+    float3 bitangent : TEXCOORD5;
+    float ao : TEXCOORD6;
+};
+
+// bilinear height in world units at a sample coordinate of the node's tile
+float SampleHeight(float2 at, float last)
+{
+    at = clamp(at, 0.0, last);
+    int2 i0 = int2(floor(at));
+    int2 i1 = min(i0 + 1, int2(last, last));
+    float2 f = at - i0;
+    int slice = int(uTerrainTile.x);
+
+    float h00 = uHeightTiles.Load(int4(i0.x, i0.y, slice, 0));
+    float h10 = uHeightTiles.Load(int4(i1.x, i0.y, slice, 0));
+    float h01 = uHeightTiles.Load(int4(i0.x, i1.y, slice, 0));
+    float h11 = uHeightTiles.Load(int4(i1.x, i1.y, slice, 0));
+    float h = lerp(lerp(h00, h10, f.x), lerp(h01, h11, f.x), f.y);
+    return uTerrainMorph.w + h * uTerrainMorph.z;
+}
+
+VSOut main(VSIn v)
+{
+    VSOut o;
+
+    float2 maxTexel = uTerrainTile.zw;
+    float2 origin = uTerrainMap.xy;
+    float invSpacing = uTerrainMap.z;
+    float nodeSize = uTerrainNode.z;
+    float dim = uTerrainNode.w;
+    float last = dim + 2.0;
+
+    float2 grid = v.pos.xz;
+    float2 xz = uTerrainNode.xy + grid * nodeSize;
+    float y = SampleHeight(grid * dim + 1.0, last);
+
+    // CDLOD morph: odd vertices slide onto the next coarser grid near the end
+    // of the level's range so neighbouring levels meet without cracks
+    float dist = distance(uCameraPos, float3(xz.x, y, xz.y));
+    float k = saturate((dist - uTerrainMorph.x) / (uTerrainMorph.y - uTerrainMorph.x));
+    grid -= frac(grid * dim * 0.5) * (2.0 / dim) * k;
+
+    // vertices past the map edge collapse onto it; the tile repeats the edge
+    // texels there, so their height is the edge height
+    float2 at = grid * dim + 1.0;
+    float2 texel = clamp((uTerrainNode.xy + grid * nodeSize - origin) * invSpacing, 0.0, maxTexel);
+    xz = origin + texel / invSpacing;
+    y = SampleHeight(at, last);
+
+    float spacing = uTerrainTile.y / invSpacing;
+    float hl = SampleHeight(at - float2(1, 0), last);
+    float hr = SampleHeight(at + float2(1, 0), last);
+    float hd = SampleHeight(at - float2(0, 1), last);
+    float hu = SampleHeight(at + float2(0, 1), last);
+
+    float4 wpos = float4(xz.x, y, xz.y, 1.0);
+    o.worldPos = wpos.xyz;
+    o.pos = mul(wpos, uViewProj);
+    o.nrm = normalize(float3(hl - hr, 2.0 * spacing, hd - hu));
+    o.tangent = 0;
+    o.bitangent = 0;
+    o.col = uTerrainColor.rgb;
+    o.uv = texel / maxTexel;
+    o.ao = 1.0;
+    o.shadowPos = mul(wpos, uLightViewProj);
+
+    return o;
+}
@@ -1,137 +1,270 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include "Texture.h"
+#include "ImageCodec.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
 
 void Texture::LoadFromFile(GraphicsDevice& gd,
     const char* path,
     D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
-    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu)
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    MipGenerator::Content content)
 {
-    int w = 0, h = 0, comp = 0;
-    unsigned char* data = stbi_load(path, &w, &h, &comp, 4);
+    if (TextureFile::IsContainerPath(path)) {
+        TextureFile file;
+        if (!file.Open(path))
+            throw std::runtime_error("Failed to load texture container: " + file.Error());
+        const BlockCompress::Settings stored = BlockCompress::SettingsFor(content);
+        CreateFromContainer(gd, file, stored.channels, srvCpu, srvGpu, path);
+        return;
+    }
+
+    int w = 0, h = 0;
+    unsigned char* data = ImageCodec::Load(path, &w, &h);
     if (!data) {
         throw std::runtime_error("Failed to load image");
     }
 
-    auto device = gd.Device();
+    MipGenerator::Settings settings;
+    settings.content = content;
+    const MipGenerator::Chain chain = MipGenerator::Generate(data, UINT(w), UINT(h), settings);
+    stbi_image_free(data);
+
+    CreateWithMips(gd, chain, srvCpu, srvGpu, path);
+}
+
+void Texture::CreateFromPixels(GraphicsDevice& gd,
+    const void* pixels, UINT w, UINT h,
+    DXGI_FORMAT format, UINT bytesPerPixel,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name)
+{
+    CreateWithMips(gd, &pixels, w, h, 1, format, bytesPerPixel, srvCpu, srvGpu, name);
+}
+
+void Texture::CreateWithMips(GraphicsDevice& gd, const MipGenerator::Chain& chain,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name)
+{
+    const std::vector<const void*> levels = chain.LevelPointers();
+    CreateWithMips(gd, levels.data(), chain.width, chain.height, chain.LevelCount(),
+        DXGI_FORMAT_R8G8B8A8_UNORM, 4, srvCpu, srvGpu, name);
+}
 
+void Texture::CreateWithMips(GraphicsDevice& gd, const BlockCompress::Chain& chain,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name)
+{
+    CreateFromLevels(gd, TextureFile::FromBlockFormat(chain.format), chain.channels, chain.LevelPointers().data(),
+        chain.width, chain.height, chain.LevelCount(), srvCpu, srvGpu, name);
+}
+
+void Texture::CreateFromContainer(GraphicsDevice& gd, const TextureFile& file, const uint8_t channels[2],
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name)
+{
+    CreateFromLevels(gd, file.GetFormat(), channels, file.LevelPointers().data(),
+        file.Width(), file.Height(), file.LevelCount(), srvCpu, srvGpu, name);
+}
+
+void Texture::CreateStreamed(GraphicsDevice& gd, TextureFile::Format format, const uint8_t channels[2],
+    const void* const* levels, UINT w, UINT h, UINT mipCount, UINT firstMip,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name)
+{
+    CreateFromLevels(gd, format, channels, levels + firstMip, std::max(w >> firstMip, 1u), std::max(h >> firstMip, 1u),
+        mipCount - firstMip, srvCpu, srvGpu, name);
+    m_firstMip = firstMip;
+}
+
+void Texture::SetFirstMip(GraphicsDevice& gd, const void* const* levels, UINT w, UINT h, UINT mipCount, UINT firstMip)
+{
+    // the ledger entry and the old resource go with the Upload; copies of it
+    // still queued on the UploadManager keep it alive themselves
+    const std::string name = m_name;
+    Create2D(gd, levels + firstMip, std::max(w >> firstMip, 1u), std::max(h >> firstMip, 1u), mipCount - firstMip,
+        m_format, m_mapping, m_srvCPU, m_srvGPU, name.c_str());
+    m_firstMip = firstMip;
+}
+
+void Texture::CreateArray(GraphicsDevice& gd, TextureFile::Format format, const uint8_t channels[2],
+    const void* const* levels, UINT w, UINT h, UINT mipCount, UINT sliceCount,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name)
+{
+    CreateFromLevels(gd, format, channels, levels, w, h, mipCount, srvCpu, srvGpu, name, sliceCount);
+}
+
+void Texture::CreateArrayFromPixels(GraphicsDevice& gd,
+    const void* const* slices, UINT w, UINT h, UINT sliceCount, DXGI_FORMAT format,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name)
+{
+    Create2D(gd, slices, w, h, 1, format, D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING, srvCpu, srvGpu, name, sliceCount);
+}
+
+void Texture::UpdateSlices(GraphicsDevice& gd, const UINT* slices, UINT count, const void* const* levels)
+{
+    const UINT mipCount = m_tex->GetDesc().MipLevels;
+    std::vector<UINT> subresources;
+    subresources.reserve(size_t(count) * mipCount);
+    for (UINT i = 0; i < count; ++i)
+        for (UINT mip = 0; mip < mipCount; ++mip)
+            subresources.push_back(slices[i] * mipCount + mip);
+    gd.Uploads().UpdateTexture(m_tex.Get(), subresources.data(), UINT(subresources.size()), levels,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+}
+
+void Texture::CreateFromLevels(GraphicsDevice& gd, TextureFile::Format container, const uint8_t channels[2],
+    const void* const* levels, UINT w, UINT h, UINT mipCount,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name, UINT sliceCount)
+{
+    // sRGB files load as UNORM too; the shaders work on the stored values
+    DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    UINT mapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    UINT sources[4] = {
+        D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_0, D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_0,
+        D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_0, D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1 };
+    switch (container) {
+    case TextureFile::Format::RGBA8: format = DXGI_FORMAT_R8G8B8A8_UNORM; break;
+    case TextureFile::Format::BC1: format = DXGI_FORMAT_BC1_UNORM; break;
+    case TextureFile::Format::BC3: format = DXGI_FORMAT_BC3_UNORM; break;
+    case TextureFile::Format::BC7: format = DXGI_FORMAT_BC7_UNORM; break;
+    case TextureFile::Format::BC4:
+        format = DXGI_FORMAT_BC4_UNORM;
+        sources[channels[0]] = D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0;
+        mapping = D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(sources[0], sources[1], sources[2], sources[3]);
+        break;
+    case TextureFile::Format::BC5:
+        format = DXGI_FORMAT_BC5_UNORM;
+        sources[channels[0]] = D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_0;
+        sources[channels[1]] = D3D12_SHADER_COMPONENT_MAPPING_FROM_MEMORY_COMPONENT_1;
+        mapping = D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(sources[0], sources[1], sources[2], sources[3]);
+        break;
+    }
+    Create2D(gd, levels, w, h, mipCount, format, mapping, srvCpu, srvGpu, name, sliceCount);
+}
+
+void Texture::CreateWithMips(GraphicsDevice& gd,
+    const void* const* levels, UINT w, UINT h, UINT mipCount,
+    DXGI_FORMAT format, UINT bytesPerPixel,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name)
+{
+    Create2D(gd, levels, w, h, mipCount, format, D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING, srvCpu, srvGpu, name);
+}
+
+void Texture::Create2D(GraphicsDevice& gd,
+    const void* const* levels, UINT w, UINT h, UINT mipCount,
+    DXGI_FORMAT format, UINT componentMapping,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name, UINT sliceCount)
+{
     D3D12_RESOURCE_DESC desc{};
     desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
     desc.Width = (UINT)w;
     desc.Height = (UINT)h;
-    desc.DepthOrArraySize = 1;
-    desc.MipLevels = 1;
-    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.DepthOrArraySize = UINT16(sliceCount);
+    desc.MipLevels = UINT16(mipCount);
+    desc.Format = format;
     desc.SampleDesc.Count = 1;
     desc.SampleDesc.Quality = 0;
     desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
     desc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-    D3D12_HEAP_PROPERTIES heapDef{};
-    heapDef.Type = D3D12_HEAP_TYPE_DEFAULT;
+    Upload(gd, desc, levels, name);
 
-    DXThrow(device->CreateCommittedResource(
-        &heapDef,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        D3D12_RESOURCE_STATE_COPY_DEST,
-        nullptr,
-        IID_PPV_ARGS(&m_tex)));
-
-    UINT64 uploadSize = 0;
-    D3D12_PLACED_SUBRESOURCE_FOOTPRINT fp{};
-    UINT numRows = 0;
-    UINT64 rowSize = 0, totalBytes = 0;
-    device->GetCopyableFootprints(&desc, 0, 1, 0, &fp, &numRows, &rowSize, &totalBytes);
-    uploadSize = totalBytes;
-
-    D3D12_HEAP_PROPERTIES heapUp{};
-    heapUp.Type = D3D12_HEAP_TYPE_UPLOAD;
-
-    D3D12_RESOURCE_DESC bufDesc{};
-    bufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    bufDesc.Width = uploadSize;
-    bufDesc.Height = 1;
-    bufDesc.DepthOrArraySize = 1;
-    bufDesc.MipLevels = 1;
-    bufDesc.Format = DXGI_FORMAT_UNKNOWN;
-    bufDesc.SampleDesc.Count = 1;
-    bufDesc.SampleDesc.Quality = 0;
-    bufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-    bufDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-    DXThrow(device->CreateCommittedResource(
-        &heapUp,
-        D3D12_HEAP_FLAG_NONE,
-        &bufDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&m_upload)));
-
-    uint8_t* mapped = nullptr;
-    D3D12_RANGE r{ 0,0 };
-    DXThrow(m_upload->Map(0, &r, reinterpret_cast<void**>(&mapped)));
-
-    const size_t srcPitch = size_t(w) * 4;
-    for (UINT row = 0; row < numRows; ++row) {
-        memcpy(
-            mapped + fp.Offset + row * fp.Footprint.RowPitch,
-            data + row * srcPitch,
-            srcPitch
-        );
-    }
-
-    m_upload->Unmap(0, nullptr);
-    stbi_image_free(data);
-
-    ComPtr<ID3D12CommandAllocator> alloc;
-    DXThrow(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&alloc)));
-
-    ComPtr<ID3D12GraphicsCommandList> list;
-    DXThrow(device->CreateCommandList(
-        0,
-        D3D12_COMMAND_LIST_TYPE_DIRECT,
-        alloc.Get(),
-        nullptr,
-        IID_PPV_ARGS(&list)));
-
-    D3D12_TEXTURE_COPY_LOCATION dst{};
-    dst.pResource = m_tex.Get();
-    dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-    dst.SubresourceIndex = 0;
+    m_srvCPU = srvCpu;
+    m_srvGPU = srvGpu;
+    m_format = format;
+    m_mapping = componentMapping;
+    m_name = name ? name : "texture";
+    m_firstMip = 0;
+    m_sliceCount = sliceCount;
 
-    D3D12_TEXTURE_COPY_LOCATION src{};
-    src.pResource = m_upload.Get();
-    src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-    src.PlacedFootprint = fp;
+    D3D12_SHADER_RESOURCE_VIEW_DESC srv{};
+    srv.Shader4ComponentMapping = componentMapping;
+    srv.Format = format;
+    srv.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+    srv.Texture2DArray.MostDetailedMip = 0;
+    srv.Texture2DArray.MipLevels = mipCount;
+    srv.Texture2DArray.FirstArraySlice = 0;
+    srv.Texture2DArray.ArraySize = sliceCount;
 
-    list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    gd.Device()->CreateShaderResourceView(m_tex.Get(), &srv, m_srvCPU);
+}
 
-    D3D12_RESOURCE_BARRIER b{};
-    b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    b.Transition.pResource = m_tex.Get();
-    b.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-    b.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-    b.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
-    list->ResourceBarrier(1, &b);
+void Texture::CreateCube(GraphicsDevice& gd,
+    const void* const* levels, UINT size, UINT mipCount,
+    DXGI_FORMAT format, UINT bytesPerPixel,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+    D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+    const char* name)
+{
+    D3D12_RESOURCE_DESC desc{};
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Width = size;
+    desc.Height = size;
+    desc.DepthOrArraySize = 6;
+    desc.MipLevels = UINT16(mipCount);
+    desc.Format = format;
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    desc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-    DXThrow(list->Close());
-    ID3D12CommandList* lists[]{ list.Get() };
-    gd.Queue()->ExecuteCommandLists(1, lists);
-    gd.WaitGPU();
+    Upload(gd, desc, levels, name);
 
     m_srvCPU = srvCpu;
     m_srvGPU = srvGpu;
 
     D3D12_SHADER_RESOURCE_VIEW_DESC srv{};
     srv.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srv.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    srv.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srv.Texture2D.MostDetailedMip = 0;
-    srv.Texture2D.MipLevels = 1;
+    srv.Format = format;
+    srv.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+    srv.TextureCube.MostDetailedMip = 0;
+    srv.TextureCube.MipLevels = mipCount;
+
+    gd.Device()->CreateShaderResourceView(m_tex.Get(), &srv, m_srvCPU);
+}
+
+void Texture::Upload(GraphicsDevice& gd, const D3D12_RESOURCE_DESC& desc,
+    const void* const* subresources, const char* name)
+{
+    auto device = gd.Device();
+
+    D3D12_HEAP_PROPERTIES heapDef{};
+    heapDef.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    DXThrow(device->CreateCommittedResource(
+        &heapDef,
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&m_tex)));
+    m_ledger = MemoryLedger::I().Track(MemoryCategory::Texture, name ? name : "texture",
+        0, MemoryLedger::ResourceBytes(device, desc));
 
-    device->CreateShaderResourceView(m_tex.Get(), &srv, m_srvCPU);
+    // staged and recorded now, copied ahead of the next frame
+    gd.Uploads().UploadTexture(m_tex.Get(), subresources,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 }
 
 void Texture::InitWhite1x1(GraphicsDevice& gd,
@@ -1,17 +1,107 @@
 ﻿#pragma once
+#include <string>
 #include <wrl.h>
 #include <d3d12.h>
 #include "GraphicsDevice.h"
+#include "BlockCompress.h"
+#include "MemoryLedger.h"
+#include "MipGenerator.h"
+#include "TextureFile.h"
 
 class Texture
 {
 public:
     Texture() = default;
 
+    // RGBA8 with the full mip chain; content picks how the mips are filtered.
+    // DDS and KTX2 files go up as stored, see CreateFromContainer.
     void LoadFromFile(GraphicsDevice& gd,
         const char* path,
         D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
-        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu);
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        MipGenerator::Content content = MipGenerator::Content::Color);
+
+    // tightly packed rows of w * bytesPerPixel bytes, single mip, readable
+    // from every shader stage; name labels it in the MemoryLedger
+    void CreateFromPixels(GraphicsDevice& gd,
+        const void* pixels, UINT w, UINT h,
+        DXGI_FORMAT format, UINT bytesPerPixel,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name = "texture");
+
+    // levels[mip] for mipCount levels of w x h, tightly packed like
+    // CreateFromPixels; all of them go up in one copy
+    void CreateWithMips(GraphicsDevice& gd,
+        const void* const* levels, UINT w, UINT h, UINT mipCount,
+        DXGI_FORMAT format, UINT bytesPerPixel,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name = "texture");
+    void CreateWithMips(GraphicsDevice& gd, const MipGenerator::Chain& chain,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name = "texture");
+    // BC4 and BC5 read their channels back where the chain took them from;
+    // channels they do not store read 0, alpha 1
+    void CreateWithMips(GraphicsDevice& gd, const BlockCompress::Chain& chain,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name = "texture");
+
+    // Levels of an opened container copied from its mapping straight into
+    // the upload buffer, no decode. BC4 and BC5 read their channels back
+    // where channels says, like a compressed chain; the file does not say.
+    void CreateFromContainer(GraphicsDevice& gd, const TextureFile& file, const uint8_t channels[2],
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name = "texture");
+
+    // Only level firstMip of the chain and the smaller ones go up, the view
+    // covers those; SetFirstMip moves the first resident level later, from
+    // the same levels. How the TextureStreamer creates what it streams.
+    void CreateStreamed(GraphicsDevice& gd, TextureFile::Format format, const uint8_t channels[2],
+        const void* const* levels, UINT w, UINT h, UINT mipCount, UINT firstMip,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name = "texture");
+    // Re-creates the resource with the chain from firstMip down and rewrites
+    // the view in place. The GPU must be done with the current resource.
+    void SetFirstMip(GraphicsDevice& gd, const void* const* levels, UINT w, UINT h, UINT mipCount, UINT firstMip);
+    UINT FirstMip() const { return m_firstMip; }
+
+    // sliceCount chains of one size, format and mip count in one resource;
+    // levels[slice * mipCount + mip], channels as for CreateFromContainer.
+    // Called again on the same texture it re-creates the resource and
+    // rewrites the view in place, the GPU must be done with the old one.
+    void CreateArray(GraphicsDevice& gd, TextureFile::Format format, const uint8_t channels[2],
+        const void* const* levels, UINT w, UINT h, UINT mipCount, UINT sliceCount,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name = "texture array");
+    UINT SliceCount() const { return m_sliceCount; }
+
+    // sliceCount single-mip slices of an uncompressed format, slices[i]
+    // tightly packed like CreateFromPixels; for arrays whose slices are
+    // rewritten later with UpdateSlices
+    void CreateArrayFromPixels(GraphicsDevice& gd,
+        const void* const* slices, UINT w, UINT h, UINT sliceCount, DXGI_FORMAT format,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name = "texture array");
+    // Rewrites count whole slices in place, levels[i * mipCount + mip] for
+    // slices[i], packed as at creation. The copies run ahead of the frame
+    // being recorded, like the first upload; the resource and view stay.
+    void UpdateSlices(GraphicsDevice& gd, const UINT* slices, UINT count, const void* const* levels);
+
+    // six faces in +X -X +Y -Y +Z -Z order with mipCount levels each;
+    // levels[face * mipCount + mip] is tightly packed like CreateFromPixels
+    void CreateCube(GraphicsDevice& gd,
+        const void* const* levels, UINT size, UINT mipCount,
+        DXGI_FORMAT format, UINT bytesPerPixel,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name = "cube");
 
     void InitWhite1x1(GraphicsDevice& gd,
         D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
@@ -23,8 +113,40 @@ public:
     D3D12_CPU_DESCRIPTOR_HANDLE CPUHandle() const { return m_srvCPU; }
 
 private:
+    // format and mapping for the container format, then Create2D
+    void CreateFromLevels(GraphicsDevice& gd, TextureFile::Format container, const uint8_t channels[2],
+        const void* const* levels, UINT w, UINT h, UINT mipCount,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name, UINT sliceCount = 1);
+
+    // The view is a Texture2DArray whatever the slice count: the material
+    // slots of PixelShader.hlsl sample arrays, a plain texture is slice 0.
+    void Create2D(GraphicsDevice& gd,
+        const void* const* levels, UINT w, UINT h, UINT mipCount,
+        DXGI_FORMAT format, UINT componentMapping,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu,
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu,
+        const char* name, UINT sliceCount = 1);
+
+    // creates m_tex from desc and queues the copy of one pointer per
+    // subresource into it on the UploadManager; rows, or rows of blocks,
+    // are tightly packed. The pointers are only read during the call.
+    void Upload(GraphicsDevice& gd, const D3D12_RESOURCE_DESC& desc,
+        const void* const* subresources, const char* name);
+
     Microsoft::WRL::ComPtr<ID3D12Resource> m_tex;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_upload;
+    MemoryLedger::Handle m_ledger;
+
+    // what Create2D made the view with, for SetFirstMip
+    DXGI_FORMAT m_format = DXGI_FORMAT_UNKNOWN;
+    UINT m_mapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    std::string m_name;
+    UINT m_firstMip = 0;
+    UINT m_sliceCount = 1;
+    // TextureStreamer id + 1, 0 when not streamed
+    friend class TextureStreamer;
+    uint32_t m_streamId = 0;
 
     D3D12_CPU_DESCRIPTOR_HANDLE m_srvCPU{};
     D3D12_GPU_DESCRIPTOR_HANDLE m_srvGPU{};
@@ -0,0 +1,146 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "TextureArrayPool.h"
+#include <algorithm>
+#include <string>
+#include "WindowDX12.h"
+
+bool TextureArrayPool::Matches(const Array& a, const Source& s)
+{
+    if (a.format != s.format || a.width != s.width || a.height != s.height
+        || a.levelCount != s.levels.size() || a.used >= kMaxSlices)
+        return false;
+    // only the one and two channel formats map their channels in the view
+    const bool mapped = s.format == TextureFile::Format::BC4 || s.format == TextureFile::Format::BC5;
+    return !mapped || (a.channels[0] == s.channels[0] && a.channels[1] == s.channels[1]);
+}
+
+void TextureArrayPool::TrackSources()
+{
+    if (!m_ledger)
+        m_ledger = MemoryLedger::I().Track(MemoryCategory::Texture, "texture array sources", m_sourceBytes, 0);
+    else
+        m_ledger.Update(m_sourceBytes, 0);
+}
+
+TextureArrayPool::Slot TextureArrayPool::Add(GraphicsDevice& gd, Source source, const AllocateSrv& allocateSrv)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_sourceBytes += source.bytes;
+    TrackSources();
+
+    for (uint32_t i = 0; i < m_arrays.size(); ++i) {
+        Array& a = m_arrays[i];
+        if (!Matches(a, source)) continue;
+        uint32_t slice;
+        if (!a.free.empty()) {
+            slice = a.free.back();
+            a.free.pop_back();
+            a.slices[slice] = std::move(source);
+        }
+        else {
+            slice = uint32_t(a.slices.size());
+            a.slices.push_back(std::move(source));
+        }
+        ++a.used;
+        // the resource stays, the copy runs ahead of the next frame
+        if (slice < a.capacity)
+            a.texture->UpdateSlices(gd, &slice, 1, a.slices[slice].levels.data());
+        return { Lease(i, slice), slice };
+    }
+
+    Array a;
+    a.format = source.format;
+    a.channels[0] = source.channels[0];
+    a.channels[1] = source.channels[1];
+    a.width = source.width;
+    a.height = source.height;
+    a.levelCount = uint32_t(source.levels.size());
+    a.texture = std::make_shared<Texture>();
+    const SrvHandlePair srv = allocateSrv();
+    a.srvCpu = srv.cpu;
+    a.srvGpu = srv.gpu;
+    a.slices.push_back(std::move(source));
+    a.used = 1;
+    // up now with its one slice, so that the descriptor is never empty
+    m_arrays.push_back(std::move(a));
+    const uint32_t index = uint32_t(m_arrays.size() - 1);
+    Build(gd, m_arrays.back(), index);
+    return { Lease(index, 0), 0 };
+}
+
+std::shared_ptr<Texture> TextureArrayPool::Lease(uint32_t index, uint32_t slice)
+{
+    // aliases the array, so users hold a Texture like any other
+    struct Holder
+    {
+        Holder(std::shared_ptr<Texture> a, TextureArrayPool* p, uint32_t i, uint32_t s)
+            : array(std::move(a)), pool(p), index(i), slice(s) {}
+        Holder(const Holder&) = delete;
+        Holder& operator=(const Holder&) = delete;
+        ~Holder() { pool->Release(index, slice); }
+
+        std::shared_ptr<Texture> array;
+        TextureArrayPool* pool;
+        uint32_t index, slice;
+    };
+    auto holder = std::make_shared<Holder>(m_arrays[index].texture, this, index, slice);
+    Texture* texture = holder->array.get();
+    return std::shared_ptr<Texture>(std::move(holder), texture);
+}
+
+void TextureArrayPool::Release(uint32_t index, uint32_t slice)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    Array& a = m_arrays[index];
+    m_sourceBytes -= a.slices[slice].bytes;
+    TrackSources();
+    a.slices[slice] = Source{};
+    a.free.push_back(slice);
+    --a.used;
+}
+
+void TextureArrayPool::Update(GraphicsDevice& gd)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    for (uint32_t i = 0; i < m_arrays.size(); ++i) {
+        const Array& a = m_arrays[i];
+        const bool waiting = std::any_of(a.slices.begin() + std::min<size_t>(a.capacity, a.slices.size()), a.slices.end(),
+            [](const Source& s) { return !s.levels.empty(); });
+        if (waiting)
+            Build(gd, m_arrays[i], i);
+    }
+}
+
+void TextureArrayPool::Build(GraphicsDevice& gd, Array& a, uint32_t index)
+{
+    const uint32_t capacity = std::min(kMaxSlices, std::max(uint32_t(a.slices.size()), a.capacity * 2));
+    // free and unused slices repeat one in use, whatever it is
+    const Source& filler = *std::find_if(a.slices.begin(), a.slices.end(), [](const Source& s) { return !s.levels.empty(); });
+    std::vector<const void*> levels;
+    levels.reserve(size_t(capacity) * a.levelCount);
+    for (uint32_t slice = 0; slice < capacity; ++slice) {
+        const Source& s = slice < a.slices.size() && !a.slices[slice].levels.empty() ? a.slices[slice] : filler;
+        levels.insert(levels.end(), s.levels.begin(), s.levels.end());
+    }
+
+    // the old resource goes with the Upload, the view is rewritten in place
+    const std::string name = "texture array " + std::to_string(index);
+    a.texture->CreateArray(gd, a.format, a.channels, levels.data(), a.width, a.height,
+        a.levelCount, capacity, a.srvCpu, a.srvGpu, name.c_str());
+    a.capacity = capacity;
+}
+
+TextureArrayPool::Stats TextureArrayPool::GetStats() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    Stats s;
+    s.arrays = uint32_t(m_arrays.size());
+    for (const Array& a : m_arrays) {
+        s.slices += a.used;
+        s.capacity += a.capacity;
+    }
+    s.sourceBytes = m_sourceBytes;
+    return s;
+}
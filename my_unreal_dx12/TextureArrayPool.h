@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "MemoryLedger.h"
+#include "Texture.h"
+#include "TextureStreamer.h"
+
+struct SrvHandlePair;
+
+// Groups the textures ResourceCache loads by format, channels, size and mip
+// count into Texture2DArrays, so that materials of one trim sheet or tile
+// set bind the same descriptor tables and differ by the slice the shader
+// samples (see Submesh). A new group's array goes up with its first slice
+// at once, so its descriptor is never empty. Arrays have room for twice
+// the slices they held when last built, up to kMaxSlices: a slice that
+// fits is copied in by Add, only that slice; one that does not waits for
+// Update, once per frame while the GPU is idle, which re-creates the array
+// at the larger size and rewrites its view in place. Until then a draw
+// sampling the new slice reads the last one already up. A slice goes back
+// to its array when the last copy of the Slot's texture pointer is gone,
+// and the next texture of the group takes it. The chains stay in system
+// memory to rebuild from; pooled textures are not streamed.
+class TextureArrayPool
+{
+public:
+    static TextureArrayPool& I() { static TextureArrayPool s; return s; }
+
+    // a full array starts a new one of the same group
+    static constexpr uint32_t kMaxSlices = 64;
+
+    using Source = TextureStreamer::Source;
+    // the descriptor of a new array
+    using AllocateSrv = std::function<SrvHandlePair()>;
+
+    struct Slot
+    {
+        // shares the array; the slice is free again once every copy is gone
+        std::shared_ptr<Texture> array;
+        uint32_t slice = 0;
+    };
+
+    Slot Add(GraphicsDevice& gd, Source source, const AllocateSrv& allocateSrv);
+
+    // Re-creates the arrays that ran out of room since the last call; the
+    // GPU must be idle.
+    void Update(GraphicsDevice& gd);
+
+    struct Stats
+    {
+        uint32_t arrays = 0;
+        uint32_t slices = 0;        // in use
+        uint32_t capacity = 0;      // the slices the arrays have room for
+        uint64_t sourceBytes = 0;   // the chains kept in system memory
+    };
+    Stats GetStats() const;
+
+private:
+    TextureArrayPool() = default;
+
+    struct Array
+    {
+        TextureFile::Format format = TextureFile::Format::RGBA8;
+        uint8_t channels[2] = { 0, 1 };
+        uint32_t width = 0, height = 0, levelCount = 0;
+        std::shared_ptr<Texture> texture;
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu{};
+        D3D12_GPU_DESCRIPTOR_HANDLE srvGpu{};
+        std::vector<Source> slices;     // a free slice has no levels
+        std::vector<uint32_t> free;     // taken before a new slice
+        uint32_t used = 0;
+        uint32_t capacity = 0;          // slices in the resource
+    };
+
+    static bool Matches(const Array& a, const Source& s);
+    // (re-)creates the resource of array index with room for its slices
+    void Build(GraphicsDevice& gd, Array& a, uint32_t index);
+    // the pointer the Slot hands out, which frees the slice when it goes
+    std::shared_ptr<Texture> Lease(uint32_t index, uint32_t slice);
+    void Release(uint32_t index, uint32_t slice);
+    void TrackSources();
+
+    mutable std::mutex m_mutex;
+    std::vector<Array> m_arrays;
+    uint64_t m_sourceBytes = 0;
+    MemoryLedger::Handle m_ledger;
+};
@@ -0,0 +1,199 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-function"        // warning: 'xxxx' defined but not used
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"          // warning: 'xxxx' defined but not used
+#endif
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+struct TextureAtlas::Page
+{
+    stbrp_context packer{};
+    std::vector<stbrp_node> nodes;
+    std::vector<int> entries;
+    bool dirty = false;
+};
+
+TextureAtlas::TextureAtlas(const Settings& settings)
+    : m_settings(settings)
+{
+    m_settings.levels = std::max(m_settings.levels, 1u);
+    m_settings.pageSize = std::max(m_settings.pageSize / Align() * Align(), Align());
+}
+
+TextureAtlas::~TextureAtlas() = default;
+
+bool TextureAtlas::Fits(uint32_t width, uint32_t height) const
+{
+    const uint32_t divisor = 1u << (m_settings.levels - 1);
+    if (!width || !height || width > m_settings.maxSize || height > m_settings.maxSize)
+        return false;
+    if (width % divisor || height % divisor)
+        return false;
+    const uint32_t a = Align(), g = Gutter();
+    return (width + 2 * g + a - 1) / a * a <= m_settings.pageSize
+        && (height + 2 * g + a - 1) / a * a <= m_settings.pageSize;
+}
+
+int TextureAtlas::Add(const MipGenerator::Chain& mips)
+{
+    if (!Fits(mips.width, mips.height) || mips.LevelCount() < m_settings.levels)
+        return -1;
+
+    const uint32_t a = Align(), g = Gutter();
+    Entry e;
+    e.width = (mips.width + 2 * g + a - 1) / a * a;
+    e.height = (mips.height + 2 * g + a - 1) / a * a;
+
+    // every texel of the rectangle wraps into the level, the gutters and
+    // the padding up to the alignment alike
+    MipGenerator::Chain& rect = e.pixels;
+    rect.width = e.width;
+    rect.height = e.height;
+    size_t bytes = 0;
+    for (uint32_t l = 0; l < m_settings.levels; ++l) {
+        rect.offsets.push_back(bytes);
+        bytes += size_t(rect.LevelWidth(l)) * rect.LevelHeight(l) * 4;
+    }
+    rect.pixels.resize(bytes);
+    for (uint32_t l = 0; l < m_settings.levels; ++l) {
+        const uint32_t w = rect.LevelWidth(l), h = rect.LevelHeight(l), gl = g >> l;
+        const uint32_t sw = mips.LevelWidth(l), sh = mips.LevelHeight(l);
+        const uint8_t* src = mips.Level(l);
+        uint8_t* dst = rect.pixels.data() + rect.offsets[l];
+        for (uint32_t y = 0; y < h; ++y) {
+            const uint32_t sy = (y + sh - gl % sh) % sh;
+            const uint8_t* row = src + size_t(sy) * sw * 4;
+            for (uint32_t x = 0; x < w; ++x) {
+                const uint32_t sx = (x + sw - gl % sw) % sw;
+                std::memcpy(dst + (size_t(y) * w + x) * 4, row + size_t(sx) * 4, 4);
+            }
+        }
+    }
+    if (m_settings.compress) {
+        e.blocks = BlockCompress::Compress(rect, m_settings.bc);
+        e.pixels = MipGenerator::Chain{};
+    }
+
+    const int id = int(m_entries.size());
+    stbrp_rect r{};
+    r.id = id;
+    r.w = int(e.width / a);
+    r.h = int(e.height / a);
+    uint32_t page = 0;
+    for (; page < m_pages.size(); ++page)
+        if (stbrp_pack_rects(&m_pages[page]->packer, &r, 1))
+            break;
+    if (page == m_pages.size()) {
+        const int cells = int(m_settings.pageSize / a);
+        auto p = std::make_unique<Page>();
+        p->nodes.resize(size_t(cells));
+        stbrp_init_target(&p->packer, cells, cells, p->nodes.data(), cells);
+        m_pages.push_back(std::move(p));
+        if (!stbrp_pack_rects(&m_pages[page]->packer, &r, 1))
+            return -1;
+    }
+
+    e.x = uint32_t(r.x) * a;
+    e.y = uint32_t(r.y) * a;
+    const float inv = 1.f / float(m_settings.pageSize);
+    e.placement.page = page;
+    e.placement.scale[0] = float(mips.width) * inv;
+    e.placement.scale[1] = float(mips.height) * inv;
+    e.placement.offset[0] = float(e.x + g) * inv;
+    e.placement.offset[1] = float(e.y + g) * inv;
+
+    m_pages[page]->entries.push_back(id);
+    m_pages[page]->dirty = true;
+    m_contentTexels += uint64_t(mips.width) * mips.height;
+    m_entries.push_back(std::move(e));
+    return id;
+}
+
+bool TextureAtlas::PageDirty(uint32_t page) const
+{
+    return m_pages[page]->dirty;
+}
+
+void TextureAtlas::BuildLevels(uint32_t page, uint32_t blockSize, uint32_t blockBytes,
+    std::vector<uint8_t>& data, std::vector<size_t>& offsets)
+{
+    const uint32_t size = m_settings.pageSize;
+    size_t bytes = 0;
+    for (uint32_t l = 0; l < m_settings.levels; ++l) {
+        offsets.push_back(bytes);
+        const size_t blocks = (size >> l) / blockSize;
+        bytes += blocks * blocks * blockBytes;
+    }
+    data.assign(bytes, 0);
+
+    Page& p = *m_pages[page];
+    for (int id : p.entries) {
+        const Entry& e = m_entries[id];
+        for (uint32_t l = 0; l < m_settings.levels; ++l) {
+            const uint8_t* src = blockSize == 1 ? e.pixels.Level(l) : e.blocks.Level(l);
+            const size_t rowBytes = size_t((e.width >> l) / blockSize) * blockBytes;
+            const size_t pitch = size_t((size >> l) / blockSize) * blockBytes;
+            const uint32_t rows = (e.height >> l) / blockSize;
+            uint8_t* dst = data.data() + offsets[l]
+                + size_t((e.y >> l) / blockSize) * pitch + size_t((e.x >> l) / blockSize) * blockBytes;
+            for (uint32_t row = 0; row < rows; ++row)
+                std::memcpy(dst + row * pitch, src + row * rowBytes, rowBytes);
+        }
+    }
+    p.dirty = false;
+}
+
+MipGenerator::Chain TextureAtlas::BuildPixels(uint32_t page)
+{
+    MipGenerator::Chain chain;
+    chain.width = chain.height = m_settings.pageSize;
+    BuildLevels(page, 1, 4, chain.pixels, chain.offsets);
+    return chain;
+}
+
+BlockCompress::Chain TextureAtlas::BuildBlocks(uint32_t page)
+{
+    BlockCompress::Chain chain;
+    chain.format = m_settings.bc.format;
+    chain.channels[0] = m_settings.bc.channels[0];
+    chain.channels[1] = m_settings.bc.channels[1];
+    chain.width = chain.height = m_settings.pageSize;
+    BuildLevels(page, 4, BlockCompress::BlockBytes(chain.format), chain.data, chain.offsets);
+    return chain;
+}
+
+TextureAtlas::Stats TextureAtlas::GetStats() const
+{
+    Stats s;
+    s.pages = uint32_t(m_pages.size());
+    s.entries = uint32_t(m_entries.size());
+    s.contentTexels = m_contentTexels;
+    for (const Entry& e : m_entries)
+        s.usedTexels += uint64_t(e.width) * e.height;
+    s.pageTexels = uint64_t(s.pages) * m_settings.pageSize * m_settings.pageSize;
+    const uint32_t blockSize = m_settings.compress ? 4 : 1;
+    const uint32_t blockBytes = m_settings.compress ? BlockCompress::BlockBytes(m_settings.bc.format) : 4;
+    for (uint32_t l = 0; l < m_settings.levels; ++l) {
+        const uint64_t blocks = (m_settings.pageSize >> l) / blockSize;
+        s.pageBytes += uint64_t(s.pages) * blocks * blocks * blockBytes;
+    }
+    return s;
+}
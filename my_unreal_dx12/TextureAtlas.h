@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "BlockCompress.h"
+#include "MipGenerator.h"
+
+// GPU-free packing of small textures into shared pages, so that they cost
+// the descriptor and the table bind of their page instead of their own.
+// Rectangles are packed with imstb_rectpack in units of align texels. Each
+// entry sits inside a gutter of its own texels, wrapped, on every level, so
+// that filtering across its edge reads what a wrapping sampler would; a
+// shader maps the entry's uv to offset + frac(uv) * scale.
+//
+// Pages hold the first levels of the entries only, their coarsest level
+// having a gutter of 2 texels. When compressing, each entry is compressed
+// once as it is added; its rectangle is whole blocks on every page level,
+// so building a page copies blocks and never encodes.
+class TextureAtlas
+{
+public:
+    struct Settings
+    {
+        uint32_t pageSize = 2048;
+        uint32_t maxSize = 256;     // larger sides keep their own texture
+        uint32_t levels = 3;        // page mips; entry sides must divide by 1 << (levels - 1)
+        bool compress = false;
+        BlockCompress::Settings bc;
+    };
+
+    struct Placement
+    {
+        uint32_t page = 0;
+        float scale[2] = { 0.f, 0.f };
+        float offset[2] = { 0.f, 0.f };
+    };
+
+    struct Stats
+    {
+        uint32_t pages = 0;
+        uint32_t entries = 0;
+        uint64_t contentTexels = 0;     // level 0 of the entries
+        uint64_t usedTexels = 0;        // their rectangles, gutters and alignment included
+        uint64_t pageTexels = 0;        // level 0 of the pages
+        uint64_t pageBytes = 0;         // every level, as built
+        // share of the pages holding entry texels
+        double Efficiency() const { return pageTexels ? double(contentTexels) / double(pageTexels) : 0.0; }
+    };
+
+    explicit TextureAtlas(const Settings& settings);
+    ~TextureAtlas();
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    const Settings& GetSettings() const { return m_settings; }
+
+    bool Fits(uint32_t width, uint32_t height) const;
+    // Copies the first levels of mips in, into the first page with room or a
+    // new one; -1 when it does not Fit or has too few levels.
+    int Add(const MipGenerator::Chain& mips);
+    const Placement& GetPlacement(int entry) const { return m_entries[entry].placement; }
+
+    uint32_t PageCount() const { return uint32_t(m_pages.size()); }
+    // entries were added since the page was last built
+    bool PageDirty(uint32_t page) const;
+    // The page with every entry so far, the unused area 0; clears PageDirty.
+    // Pixels without compress, blocks with it.
+    MipGenerator::Chain BuildPixels(uint32_t page);
+    BlockCompress::Chain BuildBlocks(uint32_t page);
+
+    Stats GetStats() const;
+
+private:
+    struct Page;
+
+    struct Entry
+    {
+        Placement placement;
+        uint32_t x = 0, y = 0;                  // rectangle on level 0, in texels
+        uint32_t width = 0, height = 0;         // rectangle, gutters included
+        MipGenerator::Chain pixels;             // the rectangle, without compress
+        BlockCompress::Chain blocks;            // with it
+    };
+
+    uint32_t Align() const { return 4u << (m_settings.levels - 1); }
+    uint32_t Gutter() const { return 2u << (m_settings.levels - 1); }
+
+    // level by level copy of the entries' rows of blocks (1x1 of 4 bytes
+    // for pixels) into a page of the same layout
+    void BuildLevels(uint32_t page, uint32_t blockSize, uint32_t blockBytes,
+        std::vector<uint8_t>& data, std::vector<size_t>& offsets);
+
+    Settings m_settings;
+    std::vector<Entry> m_entries;
+    // stable addresses, the packer keeps pointers into each page
+    std::vector<std::unique_ptr<Page>> m_pages;
+    uint64_t m_contentTexels = 0;
+};
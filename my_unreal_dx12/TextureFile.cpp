@@ -0,0 +1,391 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "TextureFile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    constexpr uint32_t FourCC(char a, char b, char c, char d)
+    {
+        return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+    }
+
+    constexpr uint32_t kDdsMagic = FourCC('D', 'D', 'S', ' ');
+    constexpr size_t kDdsHeaderBytes = 4 + 124;
+    constexpr size_t kDx10HeaderBytes = 20;
+
+    // DDS_HEADER flags and caps
+    constexpr uint32_t kDdsdCaps = 0x1, kDdsdHeight = 0x2, kDdsdWidth = 0x4, kDdsdPixelFormat = 0x1000;
+    constexpr uint32_t kDdsdMipMapCount = 0x20000, kDdsdLinearSize = 0x80000;
+    constexpr uint32_t kDdpfAlphaPixels = 0x1, kDdpfFourCC = 0x4, kDdpfRgb = 0x40;
+    constexpr uint32_t kDdsCapsComplex = 0x8, kDdsCapsTexture = 0x1000, kDdsCapsMipMap = 0x400000;
+    constexpr uint32_t kDdsCaps2Cubemap = 0x200, kDdsCaps2Volume = 0x200000;
+    constexpr uint32_t kDx10Texture2D = 3, kDx10MiscCube = 0x4;
+
+    // the DXGI_FORMAT values of the formats we upload
+    enum : uint32_t
+    {
+        kDxgiRGBA8 = 28, kDxgiRGBA8Srgb = 29,
+        kDxgiBC1 = 71, kDxgiBC1Srgb = 72,
+        kDxgiBC3 = 77, kDxgiBC3Srgb = 78,
+        kDxgiBC4 = 80, kDxgiBC5 = 83,
+        kDxgiBC7 = 98, kDxgiBC7Srgb = 99,
+    };
+
+    // and their VkFormat values, which KTX2 stores
+    enum : uint32_t
+    {
+        kVkRGBA8 = 37, kVkRGBA8Srgb = 43,
+        kVkBC1Rgb = 131, kVkBC1RgbSrgb = 132, kVkBC1 = 133, kVkBC1Srgb = 134,
+        kVkBC3 = 137, kVkBC3Srgb = 138,
+        kVkBC4 = 139, kVkBC5 = 141,
+        kVkBC7 = 145, kVkBC7Srgb = 146,
+    };
+
+    const uint8_t kKtx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    constexpr size_t kKtx2HeaderBytes = 80;
+    constexpr size_t kKtx2LevelBytes = 24;
+
+    uint32_t U32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+    uint64_t U64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+
+    uint64_t Align(uint64_t v, uint64_t a) { return (v + a - 1) / a * a; }
+
+    TextureFile::Level Layout(TextureFile::Format format, uint32_t width, uint32_t height)
+    {
+        TextureFile::Level l;
+        l.width = std::max(width, 1u);
+        l.height = std::max(height, 1u);
+        if (TextureFile::IsBlockCompressed(format)) {
+            l.rows = (l.height + 3) / 4;
+            l.rowBytes = (l.width + 3) / 4 * TextureFile::ElementBytes(format);
+        }
+        else {
+            l.rows = l.height;
+            l.rowBytes = l.width * TextureFile::ElementBytes(format);
+        }
+        l.size = size_t(l.rows) * l.rowBytes;
+        return l;
+    }
+
+    bool FromDxgi(uint32_t dxgi, TextureFile::Format& format, bool& srgb)
+    {
+        using F = TextureFile::Format;
+        srgb = dxgi == kDxgiRGBA8Srgb || dxgi == kDxgiBC1Srgb || dxgi == kDxgiBC3Srgb || dxgi == kDxgiBC7Srgb;
+        switch (dxgi) {
+        case kDxgiRGBA8: case kDxgiRGBA8Srgb: format = F::RGBA8; return true;
+        case kDxgiBC1: case kDxgiBC1Srgb: format = F::BC1; return true;
+        case kDxgiBC3: case kDxgiBC3Srgb: format = F::BC3; return true;
+        case kDxgiBC4: format = F::BC4; return true;
+        case kDxgiBC5: format = F::BC5; return true;
+        case kDxgiBC7: case kDxgiBC7Srgb: format = F::BC7; return true;
+        default: return false;
+        }
+    }
+
+    uint32_t ToDxgi(TextureFile::Format format)
+    {
+        using F = TextureFile::Format;
+        switch (format) {
+        case F::BC1: return kDxgiBC1;
+        case F::BC3: return kDxgiBC3;
+        case F::BC4: return kDxgiBC4;
+        case F::BC5: return kDxgiBC5;
+        case F::BC7: return kDxgiBC7;
+        default: return kDxgiRGBA8;
+        }
+    }
+
+    bool FromVk(uint32_t vk, TextureFile::Format& format, bool& srgb)
+    {
+        using F = TextureFile::Format;
+        srgb = vk == kVkRGBA8Srgb || vk == kVkBC1RgbSrgb || vk == kVkBC1Srgb || vk == kVkBC3Srgb || vk == kVkBC7Srgb;
+        switch (vk) {
+        case kVkRGBA8: case kVkRGBA8Srgb: format = F::RGBA8; return true;
+        case kVkBC1Rgb: case kVkBC1RgbSrgb: case kVkBC1: case kVkBC1Srgb: format = F::BC1; return true;
+        case kVkBC3: case kVkBC3Srgb: format = F::BC3; return true;
+        case kVkBC4: format = F::BC4; return true;
+        case kVkBC5: format = F::BC5; return true;
+        case kVkBC7: case kVkBC7Srgb: format = F::BC7; return true;
+        default: return false;
+        }
+    }
+
+    // DDS with a DX10 header, every format written the same way
+    bool WriteDds(const std::string& path, TextureFile::Format format, uint32_t width, uint32_t height,
+        const void* const* levels, uint32_t levelCount)
+    {
+        uint32_t header[32] = {};
+        header[0] = kDdsMagic;
+        uint32_t* h = header + 1;
+        h[0] = 124;
+        h[1] = kDdsdCaps | kDdsdHeight | kDdsdWidth | kDdsdPixelFormat | kDdsdMipMapCount | kDdsdLinearSize;
+        h[2] = height;
+        h[3] = width;
+        h[4] = uint32_t(Layout(format, width, height).size);
+        h[6] = levelCount;
+        h[18] = 32;
+        h[19] = kDdpfFourCC;
+        h[20] = FourCC('D', 'X', '1', '0');
+        h[26] = kDdsCapsTexture | (levelCount > 1 ? kDdsCapsComplex | kDdsCapsMipMap : 0);
+        const uint32_t dx10[5] = { ToDxgi(format), kDx10Texture2D, 0, 1, 0 };
+
+        const std::string tmp = path + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+            if (!f.is_open()) return false;
+            f.write(reinterpret_cast<const char*>(header), sizeof(header));
+            f.write(reinterpret_cast<const char*>(dx10), sizeof(dx10));
+            for (uint32_t l = 0; l < levelCount; ++l) {
+                const TextureFile::Level level = Layout(format, width >> l, height >> l);
+                f.write(static_cast<const char*>(levels[l]), std::streamsize(level.size));
+            }
+            if (!f.good()) return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+}
+
+bool TextureFile::IsContainerPath(const std::string& path)
+{
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return ext == "dds" || ext == "ktx2";
+}
+
+bool TextureFile::Save(const std::string& path, const BlockCompress::Chain& chain)
+{
+    const std::vector<const void*> levels = chain.LevelPointers();
+    return WriteDds(path, FromBlockFormat(chain.format), chain.width, chain.height, levels.data(), chain.LevelCount());
+}
+
+bool TextureFile::Save(const std::string& path, const MipGenerator::Chain& chain)
+{
+    const std::vector<const void*> levels = chain.LevelPointers();
+    return WriteDds(path, Format::RGBA8, chain.width, chain.height, levels.data(), chain.LevelCount());
+}
+
+bool TextureFile::Open(const std::string& path)
+{
+    MappedFile file;
+    if (!file.Open(path))
+        return Fail("cannot map the file");
+    if (!Parse(file.Data(), file.Size()))
+        return false;
+    m_file = std::move(file);
+    return true;
+}
+
+bool TextureFile::Parse(const uint8_t* data, size_t size)
+{
+    m_file.Close();
+    m_data = data;
+    m_size = size;
+    m_error.clear();
+    m_levels.clear();
+    m_srgb = false;
+    if (size >= 4 && U32(data) == kDdsMagic)
+        return ParseDds(data, size);
+    if (size >= sizeof(kKtx2Identifier) && memcmp(data, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0)
+        return ParseKtx2(data, size);
+    return Fail("neither DDS nor KTX2");
+}
+
+bool TextureFile::Fail(const char* why)
+{
+    m_error = why;
+    m_levels.clear();
+    m_data = nullptr;
+    m_size = 0;
+    return false;
+}
+
+bool TextureFile::ParseDds(const uint8_t* data, size_t size)
+{
+    if (size < kDdsHeaderBytes)
+        return Fail("truncated DDS header");
+    uint32_t h[31];
+    memcpy(h, data + 4, sizeof(h));
+    if (h[0] != 124 || h[18] != 32)
+        return Fail("bad DDS header size");
+    if (h[27] & (kDdsCaps2Cubemap | kDdsCaps2Volume))
+        return Fail("DDS cube maps and volumes are not supported");
+
+    m_width = h[3];
+    m_height = h[2];
+    const uint32_t levels = (h[1] & kDdsdMipMapCount) && h[6] ? h[6] : 1;
+    const uint32_t pfFlags = h[19], fourCC = h[20];
+    size_t offset = kDdsHeaderBytes;
+
+    if ((pfFlags & kDdpfFourCC) && fourCC == FourCC('D', 'X', '1', '0')) {
+        if (size < kDdsHeaderBytes + kDx10HeaderBytes)
+            return Fail("truncated DX10 header");
+        const uint8_t* dx10 = data + kDdsHeaderBytes;
+        if (U32(dx10 + 4) != kDx10Texture2D || (U32(dx10 + 8) & kDx10MiscCube) || U32(dx10 + 12) > 1)
+            return Fail("only single 2D DDS textures are supported");
+        if (!FromDxgi(U32(dx10), m_format, m_srgb))
+            return Fail("unsupported DXGI format");
+        offset += kDx10HeaderBytes;
+    }
+    else if (pfFlags & kDdpfFourCC) {
+        switch (fourCC) {
+        case FourCC('D', 'X', 'T', '1'): m_format = Format::BC1; break;
+        case FourCC('D', 'X', 'T', '5'): m_format = Format::BC3; break;
+        case FourCC('A', 'T', 'I', '1'): case FourCC('B', 'C', '4', 'U'): m_format = Format::BC4; break;
+        case FourCC('A', 'T', 'I', '2'): case FourCC('B', 'C', '5', 'U'): m_format = Format::BC5; break;
+        default: return Fail("unsupported DDS FourCC");
+        }
+    }
+    else if ((pfFlags & kDdpfRgb) && (pfFlags & kDdpfAlphaPixels) && h[21] == 32 &&
+        h[22] == 0xFFu && h[23] == 0xFF00u && h[24] == 0xFF0000u && h[25] == 0xFF000000u) {
+        m_format = Format::RGBA8;
+    }
+    else {
+        return Fail("unsupported DDS pixel format");
+    }
+    return PackLevels(offset, size, levels);
+}
+
+bool TextureFile::ParseKtx2(const uint8_t* data, size_t size)
+{
+    if (size < kKtx2HeaderBytes)
+        return Fail("truncated KTX2 header");
+    const uint8_t* h = data + sizeof(kKtx2Identifier);
+    const uint32_t vkFormat = U32(h), depth = U32(h + 16), layers = U32(h + 20), faces = U32(h + 24);
+    const uint32_t levels = std::max(U32(h + 28), 1u), supercompression = U32(h + 32);
+    m_width = U32(h + 8);
+    m_height = U32(h + 12);
+    if (depth > 0 || layers > 1 || faces != 1)
+        return Fail("only single 2D KTX2 textures are supported");
+    if (supercompression != 0)
+        return Fail("supercompressed KTX2 is not supported");
+    if (!FromVk(vkFormat, m_format, m_srgb))
+        return Fail("unsupported VkFormat");
+    if (!m_width || !m_height || levels > MipGenerator::LevelCount(m_width, m_height) || (size - kKtx2HeaderBytes) / kKtx2LevelBytes < levels)
+        return Fail("bad KTX2 level index");
+
+    // the level index gives every level a place of its own, smallest last in the file
+    for (uint32_t l = 0; l < levels; ++l) {
+        const uint8_t* e = data + kKtx2HeaderBytes + l * kKtx2LevelBytes;
+        const uint64_t offset = U64(e), length = U64(e + 8);
+        Level level = Layout(m_format, m_width >> l, m_height >> l);
+        if (length != level.size || offset > size || size - offset < length)
+            return Fail("KTX2 level out of range");
+        level.offset = size_t(offset);
+        m_levels.push_back(level);
+    }
+    return true;
+}
+
+bool TextureFile::PackLevels(size_t offset, size_t size, uint32_t count)
+{
+    if (!m_width || !m_height || count > MipGenerator::LevelCount(m_width, m_height))
+        return Fail("bad image size or level count");
+    for (uint32_t l = 0; l < count; ++l) {
+        Level level = Layout(m_format, m_width >> l, m_height >> l);
+        if (size - offset < level.size)
+            return Fail("truncated level data");
+        level.offset = offset;
+        offset += level.size;
+        m_levels.push_back(level);
+    }
+    return true;
+}
+
+std::vector<const void*> TextureFile::LevelPointers() const
+{
+    std::vector<const void*> out(m_levels.size());
+    for (uint32_t l = 0; l < LevelCount(); ++l)
+        out[l] = LevelData(l);
+    return out;
+}
+
+size_t TextureFile::DataBytes() const
+{
+    size_t bytes = 0;
+    for (const Level& l : m_levels)
+        bytes += l.size;
+    return bytes;
+}
+
+void TextureFile::Prefault() const
+{
+    if (!m_file.IsOpen()) return;
+    for (const Level& l : m_levels)
+        m_file.Prefault(l.offset, l.size);
+}
+
+const char* TextureFile::FormatName(Format format)
+{
+    switch (format) {
+    case Format::BC1: return "BC1";
+    case Format::BC3: return "BC3";
+    case Format::BC4: return "BC4";
+    case Format::BC5: return "BC5";
+    case Format::BC7: return "BC7";
+    default: return "RGBA8";
+    }
+}
+
+uint32_t TextureFile::ElementBytes(Format format)
+{
+    return format == Format::BC1 || format == Format::BC4 ? 8u : format == Format::RGBA8 ? 4u : 16u;
+}
+
+TextureFile::Format TextureFile::FromBlockFormat(BlockCompress::Format format)
+{
+    switch (format) {
+    case BlockCompress::Format::BC1: return Format::BC1;
+    case BlockCompress::Format::BC3: return Format::BC3;
+    case BlockCompress::Format::BC4: return Format::BC4;
+    case BlockCompress::Format::BC5: return Format::BC5;
+    default: return Format::BC7;
+    }
+}
+
+uint64_t TextureFile::PlaceFootprints(Format format, uint32_t width, uint32_t height, uint32_t levels,
+    std::vector<Footprint>& out)
+{
+    constexpr uint64_t kPitchAlignment = 256;       // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+    constexpr uint64_t kPlacementAlignment = 512;   // D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+
+    out.resize(levels);
+    uint64_t end = 0;
+    for (uint32_t l = 0; l < levels; ++l) {
+        const Level level = Layout(format, width >> l, height >> l);
+        Footprint& fp = out[l];
+        fp.offset = Align(end, kPlacementAlignment);
+        fp.width = IsBlockCompressed(format) ? (level.width + 3) & ~3u : level.width;
+        fp.height = IsBlockCompressed(format) ? (level.height + 3) & ~3u : level.height;
+        fp.rowPitch = uint32_t(Align(level.rowBytes, kPitchAlignment));
+        fp.rows = level.rows;
+        fp.rowBytes = level.rowBytes;
+        // the last row is not padded to the pitch
+        end = fp.offset + uint64_t(fp.rowPitch) * (fp.rows - 1) + fp.rowBytes;
+    }
+    return end;
+}
+
+void TextureFile::CopyLevels(uint8_t* upload, const Footprint* footprints) const
+{
+    for (uint32_t l = 0; l < LevelCount(); ++l) {
+        const Level& level = m_levels[l];
+        const Footprint& fp = footprints[l];
+        const uint8_t* src = m_data + level.offset;
+        uint8_t* dst = upload + fp.offset;
+        if (fp.rowPitch == level.rowBytes) {
+            memcpy(dst, src, level.size);
+            continue;
+        }
+        for (uint32_t row = 0; row < level.rows; ++row)
+            memcpy(dst + size_t(row) * fp.rowPitch, src + size_t(row) * level.rowBytes, level.rowBytes);
+    }
+}
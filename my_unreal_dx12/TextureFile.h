@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BlockCompress.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+
+// Texture container holding a ready-to-upload mip chain: DDS (FourCC or
+// DX10 header) or KTX2 without supercompression, single 2D image, RGBA8 or
+// BC1/3/4/5/7. Open maps the file and records where each level lies; the
+// level bytes are never copied or decoded on the CPU, Texture hands them
+// to the upload buffer straight from the mapping. GPU-free, including the
+// footprint layout the copy uses, so both can be checked without a device.
+class TextureFile
+{
+public:
+    enum class Format : uint8_t { RGBA8, BC1, BC3, BC4, BC5, BC7 };
+
+    struct Level
+    {
+        uint32_t width = 0, height = 0;
+        uint32_t rows = 0;          // rows of texels, or of 4x4 blocks
+        uint32_t rowBytes = 0;      // tightly packed
+        size_t offset = 0;          // in the file
+        size_t size = 0;            // rows * rowBytes
+    };
+
+    // Where one level goes in an upload buffer, as
+    // ID3D12Device::GetCopyableFootprints places it for a 2D texture: rows
+    // on 256 byte pitches, levels on 512 byte boundaries, block compressed
+    // levels padded to whole blocks.
+    struct Footprint
+    {
+        uint64_t offset = 0;
+        uint32_t width = 0, height = 0;
+        uint32_t rowPitch = 0;
+        uint32_t rows = 0;
+        uint32_t rowBytes = 0;
+    };
+
+    // where the cooker writes the container for a source image
+    static std::string PathFor(const std::string& sourcePath) { return sourcePath + ".dds"; }
+    // .dds or .ktx2, by extension
+    static bool IsContainerPath(const std::string& path);
+
+    static bool Save(const std::string& path, const BlockCompress::Chain& chain);
+    static bool Save(const std::string& path, const MipGenerator::Chain& chain);
+
+    bool Open(const std::string& path);
+    // Parses a container already in memory; data must outlive the object.
+    bool Parse(const uint8_t* data, size_t size);
+    // why Open or Parse failed
+    const std::string& Error() const { return m_error; }
+
+    Format GetFormat() const { return m_format; }
+    // the file asked for sRGB sampling; the renderer reads the stored values
+    // like it does for decoded images, so this is informational
+    bool Srgb() const { return m_srgb; }
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t LevelCount() const { return uint32_t(m_levels.size()); }
+    const Level& GetLevel(uint32_t level) const { return m_levels[level]; }
+    const uint8_t* LevelData(uint32_t level) const { return m_data + m_levels[level].offset; }
+    std::vector<const void*> LevelPointers() const;
+    // bytes of all levels, as they go to the GPU
+    size_t DataBytes() const;
+
+    // warms the level data of a mapped file, see MappedFile::Prefault
+    void Prefault() const;
+
+    static const char* FormatName(Format format);
+    static bool IsBlockCompressed(Format format) { return format != Format::RGBA8; }
+    // bytes per texel for RGBA8, per 4x4 block otherwise
+    static uint32_t ElementBytes(Format format);
+    static Format FromBlockFormat(BlockCompress::Format format);
+
+    // Lays out levels mips of a width x height texture; returns the buffer size.
+    static uint64_t PlaceFootprints(Format format, uint32_t width, uint32_t height, uint32_t levels,
+        std::vector<Footprint>& out);
+    // copies every level into an upload buffer laid out by PlaceFootprints
+    void CopyLevels(uint8_t* upload, const Footprint* footprints) const;
+
+private:
+    bool Fail(const char* why);
+    bool ParseDds(const uint8_t* data, size_t size);
+    bool ParseKtx2(const uint8_t* data, size_t size);
+    // fills m_levels for packed levels from offset on, checking they fit
+    bool PackLevels(size_t offset, size_t size, uint32_t count);
+
+    MappedFile m_file;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    std::string m_error;
+
+    Format m_format = Format::RGBA8;
+    bool m_srgb = false;
+    uint32_t m_width = 0, m_height = 0;
+    std::vector<Level> m_levels;
+};
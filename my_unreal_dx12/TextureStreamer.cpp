@@ -0,0 +1,97 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "TextureStreamer.h"
+#include <algorithm>
+
+std::shared_ptr<Texture> TextureStreamer::Create(GraphicsDevice& gd, Source source,
+    D3D12_CPU_DESCRIPTOR_HANDLE srvCpu, D3D12_GPU_DESCRIPTOR_HANDLE srvGpu, const char* name)
+{
+    const uint32_t levelCount = uint32_t(source.levels.size());
+    const bool blocks = TextureFile::IsBlockCompressed(source.format);
+    std::vector<uint64_t> levelBytes(levelCount);
+    uint32_t coarsest = 0;
+    for (uint32_t l = 0; l < levelCount; ++l) {
+        const uint32_t w = std::max(source.width >> l, 1u), h = std::max(source.height >> l, 1u);
+        levelBytes[l] = blocks
+            ? uint64_t((w + 3) / 4) * ((h + 3) / 4) * TextureFile::ElementBytes(source.format)
+            : uint64_t(w) * h * TextureFile::ElementBytes(source.format);
+        // the top of a block compressed resource must be whole blocks
+        if (!blocks || (w % 4 == 0 && h % 4 == 0))
+            coarsest = l;
+    }
+
+    auto texture = std::make_shared<Texture>();
+    std::lock_guard<std::mutex> lk(m_mutex);
+    const StreamingPolicy::Id id = m_policy.Add(source.width, source.height, levelBytes.data(), levelCount, coarsest);
+    const uint32_t first = m_policy.FirstMip(id);
+    texture->CreateStreamed(gd, source.format, source.channels, source.levels.data(), source.width, source.height,
+        levelCount, first, srvCpu, srvGpu, name);
+    if (first == 0) {
+        m_policy.Remove(id);
+        return texture;
+    }
+
+    if (m_entries.size() <= id)
+        m_entries.resize(size_t(id) + 1);
+    texture->m_streamId = id + 1;
+    m_sourceBytes += source.bytes;
+    m_entries[id].texture = texture;
+    m_entries[id].source = std::move(source);
+    if (!m_ledger)
+        m_ledger = MemoryLedger::I().Track(MemoryCategory::Texture, "streaming sources", m_sourceBytes, 0);
+    else
+        m_ledger.Update(m_sourceBytes, 0);
+    return texture;
+}
+
+void TextureStreamer::Request(const Texture* texture, float uvPerPixel, float weight)
+{
+    if (!texture || !texture->m_streamId)
+        return;
+    const StreamingPolicy::Id id = texture->m_streamId - 1;
+    std::lock_guard<std::mutex> lk(m_mutex);
+    const Source& s = m_entries[id].source;
+    m_policy.Request(id, StreamingPolicy::MipFor(s.width, s.height, uvPerPixel), weight);
+}
+
+void TextureStreamer::Update(GraphicsDevice& gd)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    const uint64_t sourceBytes = m_sourceBytes;
+    for (StreamingPolicy::Id id = 0; id < StreamingPolicy::Id(m_entries.size()); ++id) {
+        Entry& e = m_entries[id];
+        if (!e.source.levels.empty() && e.texture.expired()) {
+            m_policy.Remove(id);
+            m_sourceBytes -= e.source.bytes;
+            e = Entry{};
+        }
+    }
+    if (m_sourceBytes != sourceBytes)
+        m_ledger.Update(m_sourceBytes, 0);
+
+    for (const StreamingPolicy::Change& c : m_policy.Update()) {
+        const Entry& e = m_entries[c.id];
+        if (auto texture = e.texture.lock())
+            texture->SetFirstMip(gd, e.source.levels.data(), e.source.width, e.source.height,
+                UINT(e.source.levels.size()), c.firstMip);
+    }
+}
+
+void TextureStreamer::SetSettings(const StreamingPolicy::Settings& settings)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_policy.SetSettings(settings);
+}
+
+StreamingPolicy::Settings TextureStreamer::GetSettings() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_policy.GetSettings();
+}
+
+StreamingPolicy::Stats TextureStreamer::GetStats() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_policy.GetStats();
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "MemoryLedger.h"
+#include "StreamingPolicy.h"
+#include "Texture.h"
+
+// Mip streaming for the textures ResourceCache loads. A streamed texture
+// starts with only its tail resident (see StreamingPolicy::Settings); the
+// renderer reports how finely each visible use samples it, and Update, once
+// per frame while the GPU is idle, applies what the policy decided. A move
+// of the first resident mip re-creates the committed resource from that
+// level down and rewrites the view in place, so the descriptors materials
+// hold stay valid. The whole chain stays in system memory, or mapped when
+// it came from a container, to stream from.
+class TextureStreamer
+{
+public:
+    static TextureStreamer& I() { static TextureStreamer s; return s; }
+
+    struct Source
+    {
+        TextureFile::Format format = TextureFile::Format::RGBA8;
+        uint8_t channels[2] = { 0, 1 };     // as for Texture::CreateFromContainer
+        uint32_t width = 0, height = 0;
+        std::vector<const void*> levels;    // tightly packed, one per mip
+        std::shared_ptr<const void> owner;  // keeps levels valid
+        uint64_t bytes = 0;                 // of system memory owner holds
+    };
+
+    // Chains no larger than the tail go up whole and are not tracked.
+    std::shared_ptr<Texture> Create(GraphicsDevice& gd, Source source,
+        D3D12_CPU_DESCRIPTOR_HANDLE srvCpu, D3D12_GPU_DESCRIPTOR_HANDLE srvGpu, const char* name);
+
+    // One visible use of texture this frame: uvPerPixel texture coordinate
+    // units across a screen pixel where it is sampled most finely, 0 when
+    // not known (full resolution); weight ranks uses, its area in pixels.
+    // Textures that are not streamed are ignored.
+    void Request(const Texture* texture, float uvPerPixel, float weight);
+
+    // Ends the frame's requests and re-creates the textures whose first
+    // mip moved; the GPU must be idle.
+    void Update(GraphicsDevice& gd);
+
+    // applies from the next Update; a smaller budget evicts then
+    void SetSettings(const StreamingPolicy::Settings& settings);
+    StreamingPolicy::Settings GetSettings() const;
+    StreamingPolicy::Stats GetStats() const;
+
+private:
+    TextureStreamer() = default;
+
+    struct Entry
+    {
+        std::weak_ptr<Texture> texture;
+        Source source;
+    };
+
+    mutable std::mutex m_mutex;
+    StreamingPolicy m_policy;
+    std::vector<Entry> m_entries;   // by policy id
+    uint64_t m_sourceBytes = 0;
+    MemoryLedger::Handle m_ledger;
+};
@@ -0,0 +1,302 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "UploadManager.h"
+#include "Utils.h"
+#include <cstring>
+#include <stdexcept>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    uint64_t AlignUp(uint64_t v, uint64_t a) { return (v + a - 1) / a * a; }
+
+    ComPtr<ID3D12Resource> CreateUploadBuffer(ID3D12Device* device, uint64_t bytes, uint8_t*& mapped)
+    {
+        ComPtr<ID3D12Resource> res;
+        D3D12_HEAP_PROPERTIES hp{}; hp.Type = D3D12_HEAP_TYPE_UPLOAD;
+        D3D12_RESOURCE_DESC rd{}; rd.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        rd.Width = bytes; rd.Height = 1; rd.DepthOrArraySize = 1;
+        rd.MipLevels = 1; rd.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR; rd.SampleDesc = { 1,0 };
+        DXThrow(device->CreateCommittedResource(&hp, D3D12_HEAP_FLAG_NONE, &rd,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&res)));
+
+        D3D12_RANGE r{ 0,0 };
+        DXThrow(res->Map(0, &r, reinterpret_cast<void**>(&mapped)));
+        return res;
+    }
+}
+
+UploadManager::~UploadManager()
+{
+    if (m_fence) {
+        try { WaitIdle(); }
+        catch (...) {}
+    }
+    if (m_fenceEvent) CloseHandle(m_fenceEvent);
+}
+
+void UploadManager::Initialize(ID3D12Device* device, ID3D12CommandQueue* queue, uint64_t ringBytes)
+{
+    m_device = device;
+    m_queue = queue;
+    // whole placements, so every ring offset a texture gets stays aligned
+    m_capacity = AlignUp(ringBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    m_ring = CreateUploadBuffer(device, m_capacity, m_ringCpu);
+    m_ring->SetName(L"upload ring");
+    m_ledger = MemoryLedger::I().Track(MemoryCategory::Upload, "upload ring", 0,
+        MemoryLedger::ResourceBytes(device, m_ring->GetDesc()));
+    m_stats.ringCapacity = m_capacity;
+
+    DXThrow(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+    m_fenceEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+    if (!m_fenceEvent) throw std::runtime_error("CreateEventEx failed");
+}
+
+void UploadManager::UploadTexture(ID3D12Resource* dst, const void* const* subresources, D3D12_RESOURCE_STATES stateAfter)
+{
+    const D3D12_RESOURCE_DESC desc = dst->GetDesc();
+    const UINT count = UINT(desc.MipLevels) *
+        (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1u : UINT(desc.DepthOrArraySize));
+    std::vector<UINT> indices(count);
+    for (UINT i = 0; i < count; ++i)
+        indices[i] = i;
+
+    std::lock_guard<std::mutex> lk(m_mutex);
+    const uint64_t bytes = CopySubresources(dst, indices.data(), count, subresources,
+        D3D12_RESOURCE_STATE_COPY_DEST);
+
+    D3D12_RESOURCE_BARRIER b{};
+    b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    b.Transition.pResource = dst;
+    b.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    b.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    b.Transition.StateAfter = stateAfter;
+    m_list->ResourceBarrier(1, &b);
+
+    m_current.keepAlive.emplace_back(dst);
+    ++m_stats.copies;
+    m_stats.bytes += bytes;
+}
+
+void UploadManager::UpdateTexture(ID3D12Resource* dst, const UINT* indices, UINT count,
+    const void* const* subresources, D3D12_RESOURCE_STATES state)
+{
+    if (!count) return;
+    std::lock_guard<std::mutex> lk(m_mutex);
+    // earlier frames reading dst ran before this batch on the same queue
+    const uint64_t bytes = CopySubresources(dst, indices, count, subresources, state);
+
+    D3D12_RESOURCE_BARRIER b{};
+    b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    b.Transition.pResource = dst;
+    b.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    b.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    b.Transition.StateAfter = state;
+    m_list->ResourceBarrier(1, &b);
+
+    m_current.keepAlive.emplace_back(dst);
+    ++m_stats.copies;
+    m_stats.bytes += bytes;
+}
+
+uint64_t UploadManager::CopySubresources(ID3D12Resource* dst, const UINT* indices, UINT count,
+    const void* const* subresources, D3D12_RESOURCE_STATES stateBefore)
+{
+    const D3D12_RESOURCE_DESC desc = dst->GetDesc();
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> fp(count);
+    std::vector<UINT> numRows(count);
+    std::vector<UINT64> rowSize(count);
+    UINT64 totalBytes = 0;
+    for (UINT i = 0; i < count; ++i) {
+        UINT64 bytes = 0;
+        totalBytes = AlignUp(totalBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        m_device->GetCopyableFootprints(&desc, indices[i], 1, totalBytes, &fp[i], &numRows[i], &rowSize[i], &bytes);
+        totalBytes += bytes;
+    }
+
+    const Staging staging = Allocate(totalBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+    // subresource n is mip n % MipLevels of slice n / MipLevels; for block
+    // compressed formats the rows are rows of blocks
+    for (UINT i = 0; i < count; ++i) {
+        const uint8_t* data = static_cast<const uint8_t*>(subresources[i]);
+        const size_t srcPitch = size_t(rowSize[i]);
+        for (UINT row = 0; row < numRows[i]; ++row)
+            memcpy(staging.cpu + fp[i].Offset + row * fp[i].Footprint.RowPitch, data + row * srcPitch, srcPitch);
+    }
+
+    // a full ring may have submitted the open batch, so only now
+    Open();
+    if (stateBefore != D3D12_RESOURCE_STATE_COPY_DEST) {
+        D3D12_RESOURCE_BARRIER b{};
+        b.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+        b.Transition.pResource = dst;
+        b.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+        b.Transition.StateBefore = stateBefore;
+        b.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+        m_list->ResourceBarrier(1, &b);
+    }
+    for (UINT i = 0; i < count; ++i) {
+        D3D12_TEXTURE_COPY_LOCATION dstLoc{};
+        dstLoc.pResource = dst;
+        dstLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dstLoc.SubresourceIndex = indices[i];
+
+        D3D12_TEXTURE_COPY_LOCATION src{};
+        src.pResource = staging.buffer;
+        src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src.PlacedFootprint = fp[i];
+        src.PlacedFootprint.Offset += staging.offset;
+
+        m_list->CopyTextureRegion(&dstLoc, 0, 0, 0, &src, nullptr);
+    }
+    return totalBytes;
+}
+
+void UploadManager::UploadBuffer(ID3D12Resource* dst, uint64_t dstOffset, const void* data, uint64_t bytes)
+{
+    if (!bytes) return;
+    std::lock_guard<std::mutex> lk(m_mutex);
+    const Staging staging = Allocate(bytes, 16);
+    memcpy(staging.cpu, data, size_t(bytes));
+
+    Open();
+    m_list->CopyBufferRegion(dst, dstOffset, staging.buffer, staging.offset, bytes);
+
+    m_current.keepAlive.emplace_back(dst);
+    ++m_stats.copies;
+    m_stats.bytes += bytes;
+}
+
+UploadManager::Staging UploadManager::Allocate(uint64_t bytes, uint64_t alignment)
+{
+    if (bytes > m_capacity) {
+        Staging s;
+        ComPtr<ID3D12Resource> buffer = CreateUploadBuffer(m_device.Get(), bytes, s.cpu);
+        s.buffer = buffer.Get();
+        m_current.keepAlive.push_back(std::move(buffer));
+        ++m_stats.dedicated;
+        return s;
+    }
+
+    for (;;) {
+        // an idle ring starts over at offset 0, where the most fits
+        if (m_head == m_tail)
+            m_head = m_tail = AlignUp(m_head, m_capacity);
+
+        const uint64_t pos = m_head % m_capacity;
+        uint64_t pad = AlignUp(pos, alignment) - pos;
+        // no copy straddles the end, the rest of the ring is skipped
+        if (pos + pad + bytes > m_capacity)
+            pad = m_capacity - pos;
+        if (m_head + pad + bytes - m_tail <= m_capacity) {
+            Staging s;
+            s.buffer = m_ring.Get();
+            s.offset = (m_head + pad) % m_capacity;
+            s.cpu = m_ringCpu + s.offset;
+            m_head += pad + bytes;
+            return s;
+        }
+
+        // Full: what is still recorded goes to the GPU, then the oldest
+        // batch is waited for. Only loads larger than the frames retire
+        // get here.
+        RetireLocked();
+        if (m_head == m_tail) continue;
+        if (m_inFlight.empty() && !SubmitLocked())
+            throw std::logic_error("upload ring in use without a batch");
+        ++m_stats.ringWaits;
+        WaitFor(m_inFlight.front().fence);
+        RetireLocked();
+    }
+}
+
+void UploadManager::Open()
+{
+    if (m_open) return;
+    if (m_freeAllocators.empty()) {
+        DXThrow(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_current.allocator)));
+    }
+    else {
+        m_current.allocator = std::move(m_freeAllocators.back());
+        m_freeAllocators.pop_back();
+        DXThrow(m_current.allocator->Reset());
+    }
+
+    if (!m_list) {
+        DXThrow(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+            m_current.allocator.Get(), nullptr, IID_PPV_ARGS(&m_list)));
+        m_list->SetName(L"uploads");
+    }
+    else {
+        DXThrow(m_list->Reset(m_current.allocator.Get(), nullptr));
+    }
+    m_open = true;
+}
+
+uint64_t UploadManager::Submit()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return SubmitLocked();
+}
+
+uint64_t UploadManager::SubmitLocked()
+{
+    if (!m_open)
+        return 0;
+    DXThrow(m_list->Close());
+    ID3D12CommandList* lists[]{ m_list.Get() };
+    m_queue->ExecuteCommandLists(1, lists);
+    DXThrow(m_queue->Signal(m_fence.Get(), ++m_fenceValue));
+    m_open = false;
+
+    m_current.fence = m_fenceValue;
+    m_current.ringEnd = m_head;
+    m_inFlight.push_back(std::move(m_current));
+    m_current = Batch{};
+    ++m_stats.batches;
+    return m_fenceValue;
+}
+
+void UploadManager::Retire()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    RetireLocked();
+}
+
+void UploadManager::RetireLocked()
+{
+    const uint64_t completed = m_fence->GetCompletedValue();
+    while (!m_inFlight.empty() && m_inFlight.front().fence <= completed) {
+        Batch& batch = m_inFlight.front();
+        m_tail = batch.ringEnd;
+        m_freeAllocators.push_back(std::move(batch.allocator));
+        m_inFlight.pop_front();
+    }
+}
+
+void UploadManager::WaitFor(uint64_t fence)
+{
+    if (m_fence->GetCompletedValue() >= fence) return;
+    DXThrow(m_fence->SetEventOnCompletion(fence, m_fenceEvent));
+    if (WaitForSingleObject(m_fenceEvent, INFINITE) == WAIT_FAILED)
+        throw std::runtime_error("WaitForSingleObject failed");
+}
+
+void UploadManager::WaitIdle()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    SubmitLocked();
+    WaitFor(m_fenceValue);
+    RetireLocked();
+}
+
+UploadManager::Stats UploadManager::GetStats() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    Stats s = m_stats;
+    s.ringInUse = m_head - m_tail;
+    return s;
+}
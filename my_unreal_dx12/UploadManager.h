@@ -0,0 +1,116 @@
+#pragma once
+#include <wrl.h>
+#include <d3d12.h>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "MemoryLedger.h"
+
+// Batches the copies that fill textures and buffers into one command list
+// per submission on the direct queue, executed ahead of the frame that uses
+// them. Staging memory comes from a persistently mapped upload ring; the
+// part a batch used is reused once the batch's fence value has passed, so a
+// load never waits for the GPU unless the ring is full. Copies larger than
+// the ring get an upload buffer of their own, released the same way.
+// Thread-safe; copies execute in the order they were recorded.
+class UploadManager
+{
+public:
+    static constexpr uint64_t kDefaultRingBytes = 64ull << 20;
+
+    struct Stats
+    {
+        uint64_t batches = 0;       // submissions that carried copies
+        uint64_t copies = 0;        // textures and buffer ranges recorded
+        uint64_t bytes = 0;         // staging bytes written
+        uint64_t ringWaits = 0;     // times a full ring waited for the GPU
+        uint64_t dedicated = 0;     // copies too large for the ring
+        uint64_t ringCapacity = 0;
+        uint64_t ringInUse = 0;     // written and not yet retired
+    };
+
+    UploadManager() = default;
+    ~UploadManager();
+    UploadManager(const UploadManager&) = delete;
+    UploadManager& operator=(const UploadManager&) = delete;
+
+    void Initialize(ID3D12Device* device, ID3D12CommandQueue* queue, uint64_t ringBytes = kDefaultRingBytes);
+
+    // Copies one pointer per subresource into dst, which must be in
+    // COPY_DEST: tightly packed rows, or rows of blocks, in subresource
+    // order. dst then transitions to stateAfter and is kept alive until the
+    // copy has executed.
+    void UploadTexture(ID3D12Resource* dst, const void* const* subresources, D3D12_RESOURCE_STATES stateAfter);
+    // Rewrites count subresources of dst, which stays in state: indices[i]
+    // gets subresources[i], packed as for UploadTexture. dst goes to
+    // COPY_DEST for the copies and back, ahead of the frame that reads it.
+    void UpdateTexture(ID3D12Resource* dst, const UINT* indices, UINT count,
+        const void* const* subresources, D3D12_RESOURCE_STATES state);
+    // dst is a buffer in COMMON; the copy promotes it and the reads after
+    // the batch promote it again, so no barrier is recorded.
+    void UploadBuffer(ID3D12Resource* dst, uint64_t dstOffset, const void* data, uint64_t bytes);
+
+    // Executes what was recorded since the last call. The frame calls it
+    // right before its own command list. Returns the fence value of the
+    // batch, 0 when nothing was recorded.
+    uint64_t Submit();
+    // recycles the staging memory and allocators of batches that completed
+    void Retire();
+    // submits and waits until every batch has completed
+    void WaitIdle();
+
+    Stats GetStats() const;
+
+private:
+    struct Batch
+    {
+        uint64_t fence = 0;
+        uint64_t ringEnd = 0;   // ring head when the batch was submitted
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+        // destinations, and the staging buffers of oversized copies
+        std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> keepAlive;
+    };
+
+    struct Staging
+    {
+        ID3D12Resource* buffer = nullptr;
+        uint64_t offset = 0;
+        uint8_t* cpu = nullptr;
+    };
+
+    // all under m_mutex
+    Staging Allocate(uint64_t bytes, uint64_t alignment);
+    // Stages subresources[i] and records its copy into subresource
+    // indices[i], after the transition of dst from stateBefore to COPY_DEST
+    // when they differ. Returns the staged bytes.
+    uint64_t CopySubresources(ID3D12Resource* dst, const UINT* indices, UINT count,
+        const void* const* subresources, D3D12_RESOURCE_STATES stateBefore);
+    void Open();
+    uint64_t SubmitLocked();
+    void RetireLocked();
+    void WaitFor(uint64_t fence);
+
+    Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+    ID3D12CommandQueue* m_queue = nullptr;
+
+    mutable std::mutex m_mutex;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_ring;
+    uint8_t* m_ringCpu = nullptr;
+    uint64_t m_capacity = 0;
+    // running byte counts; the ring offset is the count modulo the capacity
+    uint64_t m_head = 0, m_tail = 0;
+    MemoryLedger::Handle m_ledger;
+
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_list;
+    bool m_open = false;
+    Batch m_current;
+    std::deque<Batch> m_inFlight;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> m_freeAllocators;
+
+    Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+    uint64_t m_fenceValue = 0;
+    HANDLE m_fenceEvent = nullptr;
+
+    Stats m_stats;
+};
@@ -27,6 +27,7 @@ struct VSIn
     float2 uv : TEXCOORD0;
     float3 tangent : TANGENT0;
     float3 bitangent : BINORMAL0;
+    float ao : TEXCOORD1;
 };
 
 struct VSOut
@@ -39,6 +40,7 @@ struct VSOut
     float4 shadowPos : TEXCOORD3;
     float3 tangent : TEXCOORD4;
     float3 bitangent : TEXCOORD5;
+    float ao : TEXCOORD6;
 };
 
 VSOut main(VSIn v)
@@ -56,6 +58,7 @@ VSOut main(VSIn v)
 
     o.col = v.col;
     o.uv = v.uv;
+    o.ao = v.ao;
 
     o.shadowPos = mul(w, uLightViewProj);
 
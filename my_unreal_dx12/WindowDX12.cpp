@@ -1,4 +1,10 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include "WindowDX12.h"
+#include "ResourceCache.h"
+#include "TextureArrayPool.h"
+#include <algorithm>
 
 struct TransparentCommand {
     Mesh* mesh;
@@ -23,7 +29,7 @@ WindowDX12::WindowDX12(UINT w, UINT h, const std::wstring& title)
     {
         D3D12_DESCRIPTOR_HEAP_DESC srvDesc{};
         srvDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        srvDesc.NumDescriptors = 1024;
+        srvDesc.NumDescriptors = kSrvHeapSize;
         srvDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
         srvDesc.NodeMask = 0;
 
@@ -133,6 +139,27 @@ WindowDX12::WindowDX12(UINT w, UINT h, const std::wstring& title)
     }
     ResourceCache::I().setDefaultWhiteTexture(getDefaultTextureShared());
 
+    {
+        IrradianceVolume flat;
+        const float ambient[3] = { 0.25f, 0.25f, 0.25f };
+        flat.SetUniform(ambient);
+        SetIrradianceVolume(flat);
+    }
+
+    {
+        // black placeholders keep the tables valid until SetEnvironmentMap
+        m_envSpecularSrv = AllocateSrv();
+        m_brdfLutSrv = AllocateSrv();
+        const uint16_t black[4] = {};
+        const void* faces[6] = { black, black, black, black, black, black };
+        m_envSpecular = std::make_unique<Texture>();
+        m_envSpecular->CreateCube(m_gfx, faces, 1, 1, DXGI_FORMAT_R16G16B16A16_FLOAT, 8,
+            m_envSpecularSrv.cpu, m_envSpecularSrv.gpu, "environment specular");
+        m_brdfLut = std::make_unique<Texture>();
+        m_brdfLut->CreateFromPixels(m_gfx, black, 1, 1, DXGI_FORMAT_R16G16_FLOAT, 4,
+            m_brdfLutSrv.cpu, m_brdfLutSrv.gpu, "BRDF table");
+    }
+
 #if _DEBUG
     {
         Microsoft::WRL::ComPtr<ID3D12InfoQueue> q;
@@ -159,6 +186,8 @@ void WindowDX12::CreateShader(void)
       D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
     { "BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 56,
       D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD", 1, DXGI_FORMAT_R32_FLOAT,       0, 68,
+      D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
     };
     char* vertexShaderSrc = nullptr;
     char* pixelShaderSrc = nullptr;
@@ -208,6 +237,29 @@ void WindowDX12::CreateShader(void)
         D3D12_CULL_MODE_NONE
     );
 
+    {
+        std::ifstream terrainFile("TerrainVertex.hlsl", std::ios::in | std::ios::binary);
+        if (!terrainFile.is_open()) {
+            throw std::runtime_error("Failed to open terrain shader file.");
+        }
+        terrainFile.seekg(0, std::ios::end);
+        size_t size = static_cast<size_t>(terrainFile.tellg());
+        terrainFile.seekg(0, std::ios::beg);
+        std::string terrainVsSrc(size, '\0');
+        terrainFile.read(terrainVsSrc.data(), size);
+
+        m_terrainPipeline.Create(
+            m_gfx.Device(),
+            il, _countof(il),
+            terrainVsSrc.c_str(), pixelShaderSrc,
+            DXGI_FORMAT_R8G8B8A8_UNORM,
+            DXGI_FORMAT_D32_FLOAT,
+            false,
+            true,
+            D3D12_CULL_MODE_BACK
+        );
+    }
+
     m_renderer.SetPipeline(m_pipeline);
 
     delete[] vertexShaderSrc;
@@ -258,6 +310,16 @@ uint32_t WindowDX12::Clear()
         float(m_window.GetWidth()) / float(m_window.GetHeight()));
 
     m_drawCursor = 0;
+    // EndFrame waited for the GPU
+    m_retiredProbeBuffer.Reset();
+    m_retiredEnvSpecular.reset();
+    m_retiredBrdfLut.reset();
+    // the last frame's requests; textures re-created here are not in flight
+    TextureStreamer::I().Update(m_gfx);
+    // atlas pages textures were packed into since, likewise
+    ResourceCache::I().updateAtlases(m_gfx);
+    // and arrays slices were added to
+    TextureArrayPool::I().Update(m_gfx);
 
     using namespace DirectX;
 
@@ -282,6 +344,7 @@ uint32_t WindowDX12::Clear()
     auto s = m_trianglesCount;
     m_trianglesCount = 0;
     m_DrawList.clear();
+    m_terrain = nullptr;
     return s;
 }
 
@@ -317,6 +380,11 @@ void WindowDX12::Draw(const Mesh& mesh)
     m_DrawList.push_back(const_cast<Mesh*>(&mesh));
 }
 
+void WindowDX12::Draw(Terrain& terrain)
+{
+    m_terrain = &terrain;
+}
+
 void WindowDX12::Display()
 {
     RenderShadowPass(m_DrawList);
@@ -324,6 +392,7 @@ void WindowDX12::Display()
     m_imgui.Draw(m_renderer);
     const UINT frame = m_swap.FrameIndex();
     m_renderer.EndFrame(frame);
+    GeometryPool::I().CollectGarbage();
 }
 
 void WindowDX12::SetCameraLookAt(DirectX::XMVECTOR eye, DirectX::XMVECTOR at, DirectX::XMVECTOR up)
@@ -338,6 +407,68 @@ void WindowDX12::SetCameraPerspective(float fov, float aspect, float zn, float z
     m_proj = m_camera.Proj();
 }
 
+void WindowDX12::SetVisibilitySet(std::shared_ptr<const PotentiallyVisibleSet> pvs)
+{
+    m_visibilitySet = std::move(pvs);
+    m_visibleCell = PotentiallyVisibleSet::kNoCell;
+    m_visibleBits.clear();
+}
+
+void WindowDX12::SetIrradianceVolume(const IrradianceVolume& volume)
+{
+    if (volume.Empty()) return;
+
+    // video memory, filled by a copy ahead of the next frame
+    const UINT64 bytes = volume.Packed().size() * sizeof(uint32_t);
+    D3D12_HEAP_PROPERTIES hp{}; hp.Type = D3D12_HEAP_TYPE_DEFAULT;
+    D3D12_RESOURCE_DESC rd{}; rd.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    rd.Width = bytes; rd.Height = 1; rd.DepthOrArraySize = 1;
+    rd.MipLevels = 1; rd.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR; rd.SampleDesc = { 1,0 };
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+    DXThrow(m_gfx.Device()->CreateCommittedResource(&hp, D3D12_HEAP_FLAG_NONE, &rd,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&buffer)));
+    m_gfx.Uploads().UploadBuffer(buffer.Get(), 0, volume.Packed().data(), bytes);
+
+    if (m_probeBuffer) m_retiredProbeBuffer = std::move(m_probeBuffer);
+    m_probeBuffer = std::move(buffer);
+    m_probeLedger = MemoryLedger::I().Track(MemoryCategory::Lighting, "irradiance probes", 0,
+        MemoryLedger::ResourceBytes(m_gfx.Device(), rd));
+    const float* o = volume.Origin();
+    const uint32_t* d = volume.Dims();
+    m_probeOrigin = DirectX::XMFLOAT4(o[0], o[1], o[2], 1.f / volume.Spacing());
+    m_probeDims = DirectX::XMFLOAT4(float(d[0]), float(d[1]), float(d[2]), 0.f);
+}
+
+void WindowDX12::SetEnvironmentMap(const EnvironmentMap& env)
+{
+    if (env.Empty()) {
+        m_envParams.y = 0.f;
+        return;
+    }
+
+    std::vector<const void*> levels;
+    for (uint32_t face = 0; face < 6; ++face)
+        for (uint32_t mip = 0; mip < env.MipCount(); ++mip)
+            levels.push_back(env.Specular(face, mip));
+    auto specular = std::make_unique<Texture>();
+    specular->CreateCube(m_gfx, levels.data(), env.FaceSize(), env.MipCount(), DXGI_FORMAT_R16G16B16A16_FLOAT, 8,
+        m_envSpecularSrv.cpu, m_envSpecularSrv.gpu, "environment specular");
+    auto lut = std::make_unique<Texture>();
+    lut->CreateFromPixels(m_gfx, env.BrdfLut().data(), env.LutSize(), env.LutSize(), DXGI_FORMAT_R16G16_FLOAT, 4,
+        m_brdfLutSrv.cpu, m_brdfLutSrv.gpu, "BRDF table");
+
+    m_retiredEnvSpecular = std::move(m_envSpecular);
+    m_retiredBrdfLut = std::move(m_brdfLut);
+    m_envSpecular = std::move(specular);
+    m_brdfLut = std::move(lut);
+    m_envParams = DirectX::XMFLOAT4(float(env.MipCount() - 1), 1.f, 0.f, 0.f);
+
+    IrradianceVolume ambient;
+    ambient.SetProbe(env.Irradiance());
+    SetIrradianceVolume(ambient);
+}
+
 void WindowDX12::ActivateConsole()
 {
     AllocConsole();
@@ -352,10 +483,44 @@ void WindowDX12::DrawScene() {
 
     std::vector<TransparentCommand> transparent;
 
+    m_materialBinds = {};
+    for (MaterialSlot& slot : m_lastMaterial)
+        slot = {};
+
     m_renderer.SetPipeline(m_pipeline);
     m_renderer.BindMainRenderTargets();
+    m_renderer.BindProbes(m_probeBuffer->GetGPUVirtualAddress());
+    m_renderer.BindEnvironment(m_envSpecularSrv.gpu, m_brdfLutSrv.gpu);
+
+    // one lookup per frame, the cell's row is only decoded when it changes
+    const uint64_t* visible = nullptr;
+    uint32_t visibleCount = 0;
+    m_visibilityRejected = 0;
+    if (m_visibilitySet) {
+        const XMFLOAT3 eye = m_camera.getPosition();
+        const float p[3] = { eye.x, eye.y, eye.z };
+        const uint32_t cell = m_visibilitySet->CellAt(p);
+        if (cell != PotentiallyVisibleSet::kNoCell) {
+            if (cell != m_visibleCell) {
+                m_visibilitySet->DecodeCell(cell, m_visibleBits);
+                m_visibleCell = cell;
+            }
+            visible = m_visibleBits.data();
+            visibleCount = m_visibilitySet->ObjectCount();
+        }
+    }
+
+    XMFLOAT4X4 viewProj;
+    XMStoreFloat4x4(&viewProj, m_camera.View() * m_camera.Proj());
+    const Frustum frustum = Frustum::FromViewProj(viewProj.m);
 
     for (auto& meshPtr : m_DrawList) {
+        const uint32_t id = meshPtr->VisibilityIndex();
+        if (visible && id < visibleCount && !((visible[id >> 6] >> (id & 63)) & 1)) {
+            ++m_visibilityRejected;
+            continue;
+        }
+
         XMMATRIX M = meshPtr->Transform();
         XMMATRIX V = m_camera.View();
         XMMATRIX P = m_camera.Proj();
@@ -381,12 +546,16 @@ void WindowDX12::DrawScene() {
         base.uOpacity = 1.f;
         base.uKe = DirectX::XMFLOAT3(0.f, 0.f, 0.f);
         base._pad1 = 0.0f;
+        base.uProbeOrigin = m_probeOrigin;
+        base.uProbeDims = m_probeDims;
+        base.uEnvParams = m_envParams;
 
         const UINT frame = m_swap.FrameIndex();
         const MeshAsset* asset = meshPtr->GetAsset();
 
         if (asset && !asset->submeshes.empty()) {
             for (const auto& sm : asset->submeshes) {
+                RequestTextureMips(M, sm, frustum);
                 if (sm.opacity < 0.999f) {
                     transparent.push_back({ meshPtr, &sm });
                     continue;
@@ -394,9 +563,14 @@ void WindowDX12::DrawScene() {
 
                 SceneCB cb = base;
                 cb.uShininess = sm.shininess;
+                cb.uEnvParams.z = (sm.hasMetalRoughMap && sm.metalRoughMap) ? 1.f : 0.f;
                 cb.uKs = sm.ks;
                 cb.uOpacity = sm.opacity;
                 cb.uKe = sm.ke;
+                cb.uTextureRect = sm.textureRect;
+                cb.uNormalRect = sm.normalRect;
+                cb.uMetalRoughRect = sm.metalRoughRect;
+                cb.uSlices = DirectX::XMUINT4(sm.textureSlice, sm.normalSlice, sm.metalRoughSlice, 0);
 
                 const UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
                 D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
@@ -421,6 +595,7 @@ void WindowDX12::DrawScene() {
                 D3D12_GPU_DESCRIPTOR_HANDLE normalHandle = normalTex->GPUHandle();
                 D3D12_GPU_DESCRIPTOR_HANDLE metalRoughHandle = mrTex->GPUHandle();
 
+                CountMaterialBinds({ texHandle, normalHandle, metalRoughHandle }, &sm);
                 m_renderer.DrawMeshRange(*meshPtr, addr,
                     texHandle, shadowHandle, normalHandle, metalRoughHandle,
                     sm.indexStart, sm.indexCount);
@@ -445,6 +620,7 @@ void WindowDX12::DrawScene() {
             D3D12_GPU_DESCRIPTOR_HANDLE normalHandle = normalTex->GPUHandle();
             D3D12_GPU_DESCRIPTOR_HANDLE metalRoughHandle = mrTex->GPUHandle();
 
+            CountMaterialBinds({ texHandle, normalHandle, metalRoughHandle }, nullptr);
             m_renderer.DrawMesh(*meshPtr, addr,
                 texHandle, shadowHandle, normalHandle, metalRoughHandle);
 
@@ -452,9 +628,14 @@ void WindowDX12::DrawScene() {
         }
     }
 
+    if (m_terrain)
+        DrawTerrain();
+
     if (!transparent.empty()) {
         m_renderer.SetPipeline(m_alphaPipeline);
         m_renderer.BindMainRenderTargets();
+        m_renderer.BindProbes(m_probeBuffer->GetGPUVirtualAddress());
+        m_renderer.BindEnvironment(m_envSpecularSrv.gpu, m_brdfLutSrv.gpu);
 
         const UINT frame = m_swap.FrameIndex();
 
@@ -487,6 +668,14 @@ void WindowDX12::DrawScene() {
             cb.uOpacity = sm->opacity;
             cb.uKe = sm->ke;
             cb._pad1 = 0.0f;
+            cb.uProbeOrigin = m_probeOrigin;
+            cb.uProbeDims = m_probeDims;
+            cb.uEnvParams = m_envParams;
+            cb.uEnvParams.z = (sm->hasMetalRoughMap && sm->metalRoughMap) ? 1.f : 0.f;
+            cb.uTextureRect = sm->textureRect;
+            cb.uNormalRect = sm->normalRect;
+            cb.uMetalRoughRect = sm->metalRoughRect;
+            cb.uSlices = DirectX::XMUINT4(sm->textureSlice, sm->normalSlice, sm->metalRoughSlice, 0);
 
             const UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
             D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
@@ -511,6 +700,7 @@ void WindowDX12::DrawScene() {
             D3D12_GPU_DESCRIPTOR_HANDLE normalHandle = normalTex->GPUHandle();
             D3D12_GPU_DESCRIPTOR_HANDLE metalRoughHandle = mrTex->GPUHandle();
 
+            CountMaterialBinds({ texHandle, normalHandle, metalRoughHandle }, sm);
             m_renderer.DrawMeshRange(*meshPtr, addr,
                 texHandle, shadowHandle, normalHandle, metalRoughHandle,
                 sm->indexStart, sm->indexCount);
@@ -519,3 +709,141 @@ void WindowDX12::DrawScene() {
         }
     }
 }
+
+void WindowDX12::RequestTextureMips(const DirectX::XMMATRIX& model, const Submesh& sm, const Frustum& frustum)
+{
+    using namespace DirectX;
+
+    const float screen = float(m_window.GetWidth()) * float(m_window.GetHeight());
+    float uvPerPixel = 0.f;
+    float weight = screen;
+    if (sm.bounds[3] > 0.f) {
+        const XMVECTOR centre = XMVector3TransformCoord(XMVectorSet(sm.bounds[0], sm.bounds[1], sm.bounds[2], 1.f), model);
+        const float scale = std::max({ XMVectorGetX(XMVector3Length(model.r[0])),
+            XMVectorGetX(XMVector3Length(model.r[1])), XMVectorGetX(XMVector3Length(model.r[2])) });
+        const float radius = sm.bounds[3] * scale;
+        XMFLOAT3 c;
+        XMStoreFloat3(&c, centre);
+        const float mn[3] = { c.x - radius, c.y - radius, c.z - radius };
+        const float mx[3] = { c.x + radius, c.y + radius, c.z + radius };
+        if (!frustum.IntersectsBox(mn, mx))
+            return;
+
+        // pixels per world unit at the closest point of the bounds
+        const XMFLOAT3 eye = m_camera.getPosition();
+        const float distance = std::max(XMVectorGetX(XMVector3Length(centre - XMLoadFloat3(&eye))) - radius, 1e-3f);
+        const float pixelsPerUnit = 0.5f * float(m_window.GetHeight()) * XMVectorGetY(m_camera.Proj().r[1]) / distance;
+        if (sm.uvDensity > 0.f)
+            uvPerPixel = sm.uvDensity / scale / pixelsPerUnit;
+        const float r = radius * pixelsPerUnit;
+        weight = std::min(XM_PI * r * r, screen);
+    }
+
+    TextureStreamer& streamer = TextureStreamer::I();
+    streamer.Request(sm.texture.get(), uvPerPixel, weight);
+    if (sm.hasNormalMap)
+        streamer.Request(sm.normalMap.get(), uvPerPixel, weight);
+    if (sm.hasMetalRoughMap)
+        streamer.Request(sm.metalRoughMap.get(), uvPerPixel, weight);
+}
+
+void WindowDX12::CountMaterialBinds(const D3D12_GPU_DESCRIPTOR_HANDLE (&tables)[3], const Submesh* sm)
+{
+    const DirectX::XMFLOAT4 whole{};
+    const DirectX::XMFLOAT4* rects[3] = { &whole, &whole, &whole };
+    uint32_t slices[3] = {};
+    if (sm) {
+        rects[0] = &sm->textureRect;
+        rects[1] = &sm->normalRect;
+        rects[2] = &sm->metalRoughRect;
+        slices[0] = sm->textureSlice;
+        slices[1] = sm->normalSlice;
+        slices[2] = sm->metalRoughSlice;
+    }
+    for (int i = 0; i < 3; ++i) {
+        MaterialSlot& last = m_lastMaterial[i];
+        const bool table = tables[i].ptr != last.table;
+        m_materialBinds.switches += table ? 1 : 0;
+        m_materialBinds.unpackedSwitches += table || rects[i]->z != last.u || rects[i]->w != last.v
+            || slices[i] != last.slice ? 1 : 0;
+        last = { tables[i].ptr, rects[i]->z, rects[i]->w, slices[i] };
+    }
+}
+
+void WindowDX12::DrawTerrain()
+{
+    using namespace DirectX;
+
+    const TerrainQuadtree& tree = m_terrain->Quadtree();
+    const TerrainQuadtree::Settings& ts = tree.GetSettings();
+
+    const XMMATRIX VP = m_camera.View() * m_camera.Proj();
+    XMFLOAT4X4 vp;
+    XMStoreFloat4x4(&vp, VP);
+    const Frustum frustum = Frustum::FromViewProj(vp.m);
+
+    const XMFLOAT3 camPos = m_camera.getPosition();
+    const float cam[3]{ camPos.x, camPos.y, camPos.z };
+    tree.Select(cam, &frustum, m_terrainNodes);
+    if (m_terrainNodes.empty() || !m_terrain->Page(m_terrainNodes, m_terrainSlices))
+        return;
+
+    m_renderer.SetPipeline(m_terrainPipeline);
+    m_renderer.BindMainRenderTargets();
+    m_renderer.BindProbes(m_probeBuffer->GetGPUVirtualAddress());
+    m_renderer.BindEnvironment(m_envSpecularSrv.gpu, m_brdfLutSrv.gpu);
+    m_renderer.BindTerrainTiles(m_terrain->Tiles().GPUHandle());
+
+    SceneCB base{};
+    base.uShininess = 16.0f;
+    XMStoreFloat4x4(&base.uModel, XMMatrixIdentity());
+    XMStoreFloat4x4(&base.uViewProj, XMMatrixTranspose(VP));
+    XMStoreFloat4x4(&base.uNormalMatrix, XMMatrixIdentity());
+    base.uCameraPos = camPos;
+    base.uLightViewProj = m_lightViewProj;
+    base.uLightDir = m_lightDir;
+    base.uKs = XMFLOAT3(0.1f, 0.1f, 0.1f);
+    base.uOpacity = 1.f;
+    base.uKe = XMFLOAT3(0.f, 0.f, 0.f);
+    base.uTerrainMap = XMFLOAT4(ts.originX, ts.originZ, 1.f / ts.texelSpacing, 0.f);
+    base.uTerrainColor = m_terrain->Color();
+    base.uProbeOrigin = m_probeOrigin;
+    base.uProbeDims = m_probeDims;
+    base.uEnvParams = m_envParams;
+
+    const Mesh& patch = m_terrain->Patch();
+    const UINT frame = m_swap.FrameIndex();
+    const UINT quadrantIndices = m_terrain->QuadrantIndexCount();
+
+    D3D12_GPU_DESCRIPTOR_HANDLE whiteHandle = getDefaultTexture().GPUHandle();
+    D3D12_GPU_DESCRIPTOR_HANDLE shadowHandle = m_shadowMap.SRVGPU();
+
+    for (size_t i = 0; i < m_terrainNodes.size(); ++i) {
+        const TerrainQuadtree::Node& node = m_terrainNodes[i];
+        SceneCB cb = base;
+        cb.uTerrainNode = XMFLOAT4(node.x, node.z, node.size, float(ts.patchDim));
+        cb.uTerrainTile = XMFLOAT4(float(m_terrainSlices[i]), float(1u << node.level),
+            float(tree.Width() - 1), float(tree.Height() - 1));
+        cb.uTerrainMorph = XMFLOAT4(tree.MorphStart(node.level), tree.MorphEnd(node.level),
+            ts.heightScale, ts.baseHeight);
+
+        const UINT slice = frame * kMaxDrawsPerFrame + (m_drawCursor++);
+        D3D12_GPU_VIRTUAL_ADDRESS addr = m_cb.UploadSlice(slice, cb);
+
+        if (node.quadrants == 0xF) {
+            m_renderer.DrawMeshRange(patch, addr,
+                whiteHandle, shadowHandle, whiteHandle, whiteHandle,
+                0, quadrantIndices * 4);
+            m_trianglesCount += quadrantIndices * 4 / 3;
+            continue;
+        }
+        for (UINT q = 0; q < 4; ++q) {
+            if (!(node.quadrants & (1u << q)))
+                continue;
+            m_renderer.DrawMeshRange(patch, addr,
+                whiteHandle, shadowHandle, whiteHandle, whiteHandle,
+                q * quadrantIndices, quadrantIndices);
+            m_trianglesCount += quadrantIndices / 3;
+        }
+    }
+}
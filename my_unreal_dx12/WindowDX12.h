@@ -10,7 +10,15 @@
 #include "Camera.h"
 #include "Window.h"
 #include "CameraController.h"
+#include "Terrain.h"
+#include "PotentiallyVisibleSet.h"
+#include "IrradianceVolume.h"
+#include "EnvironmentMap.h"
+#include "MemoryLedger.h"
+#include "Frustum.h"
+#include "TextureStreamer.h"
 #include <chrono>
+#include <memory>
 #include <wrl.h>
 #include "ImGuiDx12.h"
 #include <fstream>
@@ -50,6 +58,9 @@ public:
 
 
     void Draw(const Mesh& mesh);
+    // one terrain per frame, drawn after the opaque meshes; it does not cast
+    // shadows. Drawing pages in the tiles of the selected nodes.
+    void Draw(Terrain& terrain);
 
     void Display();
 
@@ -57,6 +68,25 @@ public:
 
     void SetCameraPerspective(float fov, float aspect, float zn, float zf);
 
+    // Precomputed visibility for the static meshes, matched by
+    // Mesh::VisibilityIndex. Meshes hidden from the camera's cell are skipped
+    // before any per-object work; outside the grid everything is drawn.
+    // Shadows are unaffected, a hidden mesh can still cast into view.
+    void SetVisibilitySet(std::shared_ptr<const PotentiallyVisibleSet> pvs);
+    // meshes the visibility set rejected in the last frame
+    uint32_t GetVisibilityRejected() const { return m_visibilityRejected; }
+
+    // Replaces the probes PixelShader.hlsl takes its ambient light from,
+    // safe mid-frame. Starts as one probe of the old flat ambient.
+    void SetIrradianceVolume(const IrradianceVolume& volume);
+    // Image-based lighting for PixelShader.hlsl: reflections from the
+    // prefiltered cube and BRDF table, ambient from the environment's
+    // irradiance as a single probe (replacing any baked volume). Safe
+    // mid-frame; an empty map turns the reflections off.
+    void SetEnvironmentMap(const EnvironmentMap& env);
+    // towards the sun, what the shaders get as uLightDir
+    DirectX::XMFLOAT3 GetLightDirection() const { return m_lightDir; }
+
     DirectX::XMFLOAT3 GetCameraPosition() const {
         return m_camera.getPosition();
     }
@@ -64,6 +94,20 @@ public:
     ID3D12Device* GetDevice() const { return m_gfx.Device(); }
     GraphicsDevice& GetGraphicsDevice() { return m_gfx; }
 
+    static constexpr UINT kSrvHeapSize = 1024;
+    // slots AllocateSrv handed out, of kSrvHeapSize; none are freed
+    UINT GetSrvCount() const { return m_nextSrvIndex; }
+
+    // Material maps (albedo, normal, metal/rough) whose descriptor table
+    // differed from the previous draw's in the last frame, the binds the
+    // Renderer issued for them, and how many would with every map packed by
+    // the TextureAtlas or the TextureArrayPool in a texture of its own.
+    struct MaterialBindStats {
+        uint32_t switches = 0;
+        uint32_t unpackedSwitches = 0;
+    };
+    MaterialBindStats GetMaterialBindStats() const { return m_materialBinds; }
+
     static void ActivateConsole();
 
 private:
@@ -78,6 +122,7 @@ private:
     ShaderPipeline  m_pipeline;
     ShaderPipeline  m_shadowPipeline;
     ShaderPipeline  m_alphaPipeline;
+    ShaderPipeline  m_terrainPipeline;
     ShadowMap       m_shadowMap;
 
     ConstantBuffer  m_cb{};
@@ -100,9 +145,49 @@ private:
 
 	std::vector<Mesh*> m_DrawList;
 
+    std::shared_ptr<const PotentiallyVisibleSet> m_visibilitySet;
+    uint32_t m_visibleCell = PotentiallyVisibleSet::kNoCell;   // cell m_visibleBits was decoded for
+    std::vector<uint64_t> m_visibleBits;
+    uint32_t m_visibilityRejected = 0;
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_probeBuffer;
+    // replaced this frame, still referenced by the recorded command list
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_retiredProbeBuffer;
+    MemoryLedger::Handle m_probeLedger;
+    DirectX::XMFLOAT4 m_probeOrigin{};
+    DirectX::XMFLOAT4 m_probeDims{};
+
+    // descriptors stay, SetEnvironmentMap rewrites them for the new textures
+    SrvHandlePair m_envSpecularSrv{};
+    SrvHandlePair m_brdfLutSrv{};
+    std::unique_ptr<Texture> m_envSpecular;
+    std::unique_ptr<Texture> m_brdfLut;
+    std::unique_ptr<Texture> m_retiredEnvSpecular;
+    std::unique_ptr<Texture> m_retiredBrdfLut;
+    DirectX::XMFLOAT4 m_envParams{};
+    Terrain* m_terrain = nullptr;
+    std::vector<TerrainQuadtree::Node> m_terrainNodes;
+    std::vector<uint32_t> m_terrainSlices;
+
     std::chrono::steady_clock::time_point m_t0 = std::chrono::steady_clock::now();
     float dt = 0.0f;
     mutable uint32_t m_trianglesCount = 0;
 
+    // what the last draw bound per material slot: the table, and the
+    // offset of the atlas rectangle or the array slice telling maps in one
+    // texture apart
+    struct MaterialSlot {
+        UINT64 table = 0;
+        float u = 0.f, v = 0.f;
+        uint32_t slice = 0;
+    };
+    MaterialSlot m_lastMaterial[3];
+    MaterialBindStats m_materialBinds;
+
     void DrawScene();
+    void DrawTerrain();
+    // tells the TextureStreamer how finely the submesh samples its textures
+    void RequestTextureMips(const DirectX::XMMATRIX& model, const Submesh& sm, const Frustum& frustum);
+    // tables of the albedo, normal and metal/rough slots; sm gives their rectangles and slices
+    void CountMaterialBinds(const D3D12_GPU_DESCRIPTOR_HANDLE (&tables)[3], const Submesh* sm);
 };
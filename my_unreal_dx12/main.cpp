@@ -20,6 +20,10 @@
 #include "ShaderPipeline.h"
 #include "ConstantBuffer.h"
 #include "Mesh.h"
+#include "ImageDecoder.h"
+#include "TextureArrayPool.h"
+#include "TextureStreamer.h"
+#include "SkinnedMesh.h"
 #include "Camera.h"
 #include "CameraController.h"
 #include "Renderer.h"
@@ -32,9 +36,28 @@
 #pragma comment(lib, "dxguid.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 
-int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
+// assets and textures the last session loaded, in first-use order
+static const char* kPreloadManifest = "preload.manifest";
+
+int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR cmdLine, int)
 {
+    const auto startTime = std::chrono::steady_clock::now();
     WindowDX12::ActivateConsole();
+
+    // decodes run on the JobSystem while the device and window come up;
+    // --no-preload gives the cold start to compare against
+    const bool preload = !(cmdLine && wcsstr(cmdLine, L"--no-preload"));
+    const size_t preloaded = preload ? ResourceCache::I().startPreload(kPreloadManifest) : 0;
+
+    // textures are block compressed as they load; --no-bc keeps RGBA8,
+    // --bc-high spends longer on the encode
+    ResourceCache::I().setTextureCompression(!(cmdLine && wcsstr(cmdLine, L"--no-bc")),
+        cmdLine && wcsstr(cmdLine, L"--bc-high") ? BlockCompress::Quality::High : BlockCompress::Quality::Fast);
+    // --atlas packs small material textures into shared pages
+    ResourceCache::I().setTextureAtlas(cmdLine && wcsstr(cmdLine, L"--atlas"));
+    // --arrays groups the other material maps of one format and size into arrays
+    ResourceCache::I().setTextureArrays(cmdLine && wcsstr(cmdLine, L"--arrays"));
+
     auto& win = WindowDX12::Get();
 
     win.setWindowTitle(L"My ruru");
@@ -93,6 +116,80 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
         }
     });
 
+    std::vector<std::unique_ptr<SkinnedMesh>> characters;
+    std::vector<SkinnedMesh*> characterPtrs;
+
+    auto characterText = win.getImGui().addText("Skinned: 0");
+    win.getImGui().AddButton("Add 10 skinned characters", [&characters, &characterPtrs]() {
+        auto model = ResourceCache::I().getSkinnedModel("test/skinned_snake.gltf");
+        if (!model) return;
+        for (int i = 0; i < 10; ++i) {
+            auto c = std::make_unique<SkinnedMesh>(model);
+            c->GetMesh().SetPosition(
+                ((rand() % 100) / 100.f - 0.5f) * 30.f,
+                -5.f,
+                ((rand() % 100) / 100.f - 0.5f) * 30.f
+            );
+            c->SetTime((rand() % 100) / 50.f);
+            c->SetSpeed(0.5f + (rand() % 100) / 100.f);
+            characterPtrs.push_back(c.get());
+            characters.push_back(std::move(c));
+        }
+    });
+
+    auto probeText = win.getImGui().addText("Probes: flat ambient");
+    win.getImGui().AddButton("Bake irradiance probes", [&floor, &geometricsMeshes, &weapons, &win, probeText]() {
+        std::vector<const Mesh*> statics{ &floor };
+        for (auto& g : geometricsMeshes) statics.push_back(g.get());
+        for (auto& w : weapons) statics.push_back(w.get());
+
+        std::vector<std::vector<Vertex>> vertices(statics.size());
+        std::vector<std::vector<uint32_t>> indices(statics.size());
+        std::vector<IrradianceVolume::Object> objects;
+        for (size_t i = 0; i < statics.size(); ++i) {
+            if (!statics[i]->CopyGeometry(vertices[i], indices[i])) continue;
+            IrradianceVolume::Object o;
+            o.vertices = vertices[i].data();
+            o.vertexCount = vertices[i].size();
+            o.indices = indices[i].data();
+            o.indexCount = indices[i].size();
+            DirectX::XMStoreFloat4x4(reinterpret_cast<DirectX::XMFLOAT4X4*>(o.world), statics[i]->Transform());
+            objects.push_back(o);
+        }
+
+        IrradianceVolume::Lighting lighting;
+        const DirectX::XMFLOAT3 sun = win.GetLightDirection();
+        lighting.sunDirection[0] = sun.x; lighting.sunDirection[1] = sun.y; lighting.sunDirection[2] = sun.z;
+        IrradianceVolume::Settings settings;
+        settings.spacing = 4.f;
+
+        IrradianceVolume volume;
+        const auto stats = volume.Bake(objects, lighting, settings);
+        win.SetIrradianceVolume(volume);
+        probeText->setText("Probes: %u, %.0f ms (%.1f Mrays/s), %.1f KB", stats.probes, stats.seconds * 1000.0,
+            stats.rays / std::max(stats.seconds, 1e-9) * 1e-6, stats.bytes / 1024.0);
+    });
+
+    auto envText = win.getImGui().addText("Environment: off");
+    win.getImGui().AddButton("Environment lighting", [&win, envText]() {
+        // sky.hdr next to the executable, prefiltered once into sky.hdr.envc;
+        // without one a procedural sky around the current sun
+        EnvironmentMap env;
+        EnvironmentMap::Stats stats;
+        const char* source = "sky.hdr";
+        if (!env.LoadOrBuild(source, EnvironmentMap::Settings(), &stats)) {
+            const DirectX::XMFLOAT3 sun = win.GetLightDirection();
+            const float sunDirection[3] = { sun.x, sun.y, sun.z };
+            env.SetSky(sunDirection, 256);
+            stats = env.Prefilter();
+            source = "procedural sky";
+        }
+        win.SetEnvironmentMap(env);
+        envText->setText("Environment: %s, %ux%u, %.0f ms%s", source, env.FaceSize(), env.FaceSize(),
+            (stats.loadSeconds + stats.specularSeconds + stats.irradianceSeconds + stats.lutSeconds) * 1000.0,
+            stats.cached ? " (cached)" : "");
+    });
+
     win.getImGui().addSeparator();
 
     float rotateFighter = 0.0f;
@@ -112,14 +209,39 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
     win.getImGui().addSeparator();
 
     auto triangleText = win.getImGui().addText("Triangles: 0");
+    auto dedupText = win.getImGui().addText("Geometry dedup: 0 hits");
+    auto preloadText = win.getImGui().addText("Preload: off");
+    auto textureText = win.getImGui().addText("Textures: 0");
+    auto textureDedupText = win.getImGui().addText("Texture dedup: 0 duplicates");
+    auto uploadText = win.getImGui().addText("Uploads: 0");
+    auto decodeText = win.getImGui().addText("Decodes: 0");
+    auto streamText = win.getImGui().addText("Streaming: 0");
+    auto atlasText = win.getImGui().addText("Atlas: 0");
+    auto arrayText = win.getImGui().addText("Arrays: 0");
+    win.getImGui().addMemoryLedger();
 
     std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
     auto msFrame = win.getImGui().addText("Frame Time: 0 ms");
-
+    bool firstFrame = true;
     while (win.IsOpen())
     {
         uint32_t trianglesLastFrame = win.Clear();
 
+        auto currentTime = std::chrono::steady_clock::now();
+        auto frameDuration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastTime).count();
+        const float dt = std::chrono::duration<float>(currentTime - lastTime).count();
+        lastTime = currentTime;
+
+        if (!characters.empty()) {
+            auto skinStart = std::chrono::steady_clock::now();
+            SkinnedMesh::UpdateAll(characterPtrs.data(), characterPtrs.size(), dt);
+            const float skinMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - skinStart).count();
+            characterText->setText("Skinned: %u, %.2f ms (%.1f per ms)", (unsigned)characters.size(),
+                skinMs, skinMs > 0.f ? characters.size() / skinMs : 0.f);
+            for (auto& c : characters)
+                win.Draw(c->GetMesh());
+        }
+
         for (auto& w : weapons)
             win.Draw(*w);
 
@@ -128,15 +250,61 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
         for (auto& g : geometricsMeshes)
             win.Draw(*g);
 
-        auto currentTime = std::chrono::steady_clock::now();
-        auto frameDuration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastTime).count();
-        lastTime = currentTime;
-
         msFrame->setText("Frame Time: %lld ms", frameDuration);
         triangleText->setText("Triangles: %u", trianglesLastFrame);
 
+        const auto dedup = ResourceCache::I().getDedupStats();
+        dedupText->setText("Geometry dedup: %u/%u hits, %.1f KB saved",
+            dedup.hits, dedup.lookups, dedup.bytesSaved / 1024.0);
+
+        const auto textures = ResourceCache::I().getTextureStats();
+        textureText->setText("Textures: %u (%u BC, %u DDS/KTX2), %.1f MB of %.1f MB RGBA8; load %.0f ms, mips %.0f ms, encode %.0f ms",
+            textures.textures, textures.compressed, textures.containers, textures.gpuBytes / 1048576.0,
+            textures.rgbaBytes / 1048576.0, textures.loadSeconds * 1000.0,
+            textures.mipSeconds * 1000.0, textures.compressSeconds * 1000.0);
+        const auto textureDedup = ResourceCache::I().getTextureDedupStats();
+        textureDedupText->setText("Texture dedup: %u duplicates (%u files, %u pixels) of %u lookups, %.1f MB saved",
+            textureDedup.duplicates(), textureDedup.fileHits, textureDedup.pixelHits, textureDedup.lookups,
+            textureDedup.bytesSaved / 1048576.0);
+        const auto uploads = win.GetGraphicsDevice().Uploads().GetStats();
+        uploadText->setText("Uploads: %llu copies in %llu batches, %.1f MB staged; ring %.1f of %.1f MB, %llu waits, %llu oversized",
+            (unsigned long long)uploads.copies, (unsigned long long)uploads.batches, uploads.bytes / 1048576.0,
+            uploads.ringInUse / 1048576.0, uploads.ringCapacity / 1048576.0,
+            (unsigned long long)uploads.ringWaits, (unsigned long long)uploads.dedicated);
+        const auto decodes = ImageDecoder::I().GetStats();
+        decodeText->setText("Decodes: %llu of %llu (%llu failed), %.1f MB decoded; peak %.1f MB in flight, %llu throttled",
+            (unsigned long long)decodes.completed, (unsigned long long)decodes.submitted, (unsigned long long)decodes.failed,
+            decodes.bytesDecoded / 1048576.0, decodes.peakBytesInFlight / 1048576.0, (unsigned long long)decodes.throttled);
+        const auto streaming = TextureStreamer::I().GetStats();
+        streamText->setText("Streaming: %u textures, %.1f MB resident of %.1f MB, %.1f MB wanted; %llu loads, %llu drops, %llu evictions",
+            streaming.textures, streaming.residentBytes / 1048576.0, streaming.budgetBytes / 1048576.0,
+            streaming.wantedBytes / 1048576.0, (unsigned long long)streaming.loads, (unsigned long long)streaming.drops,
+            (unsigned long long)streaming.evictions);
+        const auto atlas = ResourceCache::I().getAtlasStats();
+        const auto binds = win.GetMaterialBindStats();
+        atlasText->setText("Atlas: %u textures on %u pages, %.0f%% used, %.1f MB; %u descriptors saved, SRV heap %u of %u; map binds %u, %u unpacked",
+            atlas.textures, atlas.pages, atlas.efficiency() * 100.0, atlas.pageBytes / 1048576.0, atlas.descriptorsSaved(),
+            win.GetSrvCount(), WindowDX12::kSrvHeapSize, binds.switches, binds.unpackedSwitches);
+        const auto arrays = TextureArrayPool::I().GetStats();
+        arrayText->setText("Arrays: %u textures in %u arrays of %u slices, %.1f MB of sources",
+            arrays.slices, arrays.arrays, arrays.capacity, arrays.sourceBytes / 1048576.0);
+
+        if (preload) {
+            const auto pre = ResourceCache::I().getPreloadStats();
+            preloadText->setText("Preload: %u/%u used, %u waited", pre.used, pre.queued, pre.waited);
+        }
+
         win.Display();
+
+        if (firstFrame) {
+            firstFrame = false;
+            const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            std::cout << "First interactive frame after " << ms << " ms ("
+                << (preload ? std::to_string(preloaded) + " manifest entries prefetched" : std::string("no preload")) << ")\n";
+        }
     }
 
+    ResourceCache::I().dropPreload();
+    ResourceCache::I().writeManifest(kPreloadManifest);
     return 0;
 }
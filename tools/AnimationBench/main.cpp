@@ -0,0 +1,181 @@
+// Headless skeletal animation benchmark: loads a skinned glTF with the
+// engine's importer and runs what SkinnedMesh::Evaluate does per character,
+// sample two clip times, cross-fade them, build the skinning palette and
+// skin every vertex, on one thread over a crowd of characters at different
+// times. Reports characters per millisecond with and without skinning.
+// AnimationBench runs the SSE2 loops, AnimationBenchScalar the same code
+// built with ANIMATION_SCALAR. Before timing it checks that the bind pose
+// skins back to the bind vertices and that the palette matches a scalar
+// reference built from the pose; either failing fails the run.
+//
+//   AnimationBench <model.gltf> [--characters <n>] [--iterations <n>]
+//
+// test/skinned_snake.gltf is the reference model.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Animation.h"
+#include "GltfLoader.h"
+
+namespace
+{
+    double Seconds(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    JointMatrix Compose(const JointTransform& x)
+    {
+        const float qx = x.r[0], qy = x.r[1], qz = x.r[2], qw = x.r[3];
+        JointMatrix m = JointMatrix::Identity();
+        const float cols[3][3] = {
+            { 1.f - 2.f * (qy * qy + qz * qz), 2.f * (qx * qy + qw * qz), 2.f * (qx * qz - qw * qy) },
+            { 2.f * (qx * qy - qw * qz), 1.f - 2.f * (qx * qx + qz * qz), 2.f * (qy * qz + qw * qx) },
+            { 2.f * (qx * qz + qw * qy), 2.f * (qy * qz - qw * qx), 1.f - 2.f * (qx * qx + qy * qy) } };
+        for (int c = 0; c < 3; ++c)
+            for (int r = 0; r < 3; ++r)
+                m.c[c][r] = cols[c][r] * x.s[c];
+        for (int r = 0; r < 3; ++r)
+            m.c[3][r] = x.t[r];
+        return m;
+    }
+
+    JointMatrix Multiply(const JointMatrix& a, const JointMatrix& b)
+    {
+        JointMatrix m = JointMatrix::Identity();
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 3; ++r)
+                m.c[c][r] = a.c[0][r] * b.c[c][0] + a.c[1][r] * b.c[c][1] + a.c[2][r] * b.c[c][2] + (c == 3 ? a.c[3][r] : 0.f);
+        return m;
+    }
+
+    float PaletteError(const Skeleton& skeleton, const Pose& pose, const JointMatrix* palette)
+    {
+        std::vector<JointMatrix> world(skeleton.JointCount());
+        float error = 0.f;
+        for (size_t j = 0; j < skeleton.JointCount(); ++j) {
+            const int32_t parent = skeleton.joints[j].parent;
+            world[j] = Multiply(parent >= 0 ? world[parent] : skeleton.root, Compose(pose.Get(j)));
+            const JointMatrix expected = Multiply(world[j], skeleton.inverseBind[j]);
+            for (int c = 0; c < 4; ++c)
+                for (int r = 0; r < 3; ++r)
+                    error = std::max(error, std::fabs(expected.c[c][r] - palette[j].c[c][r]));
+        }
+        return error;
+    }
+
+    struct Character
+    {
+        float time = 0.f, fadeTime = 0.f, weight = 0.f;
+        Pose pose, fadePose;
+        std::vector<JointMatrix> world, palette;
+        std::vector<Vertex> skinned;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    size_t characterCount = 256;
+    int iterations = 5;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--characters" && i + 1 < argc) characterCount = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        else if (a == "--iterations" && i + 1 < argc) iterations = std::max(1, std::atoi(argv[++i]));
+        else if (a[0] != '-' && path.empty()) path = a;
+        else {
+            path.clear();
+            break;
+        }
+    }
+    if (path.empty()) {
+        std::fprintf(stderr, "usage: AnimationBench <model.gltf> [--characters <n>] [--iterations <n>]\n");
+        return 2;
+    }
+
+    SkinnedMeshData model;
+    if (!GltfLoader::LoadSkinned(path, model) || model.clips.empty()) {
+        std::fprintf(stderr, "cannot load a skinned, animated model from %s\n", path.c_str());
+        return 1;
+    }
+    const Skeleton& skeleton = model.skeleton;
+    const std::vector<Vertex>& bind = model.mesh.vertices;
+    const size_t joints = skeleton.JointCount();
+#if defined(ANIMATION_SCALAR)
+    const char* variant = "scalar";
+#else
+    const char* variant = "SSE2";
+#endif
+    std::printf("%s (%s): %zu joints, %zu vertices, %zu clips\n", path.c_str(), variant, joints, bind.size(), model.clips.size());
+
+    // the bind pose skins back to the bind vertices
+    Character c;
+    c.pose.Resize(joints);
+    c.pose.SetBindPose(skeleton);
+    c.world.resize(joints);
+    c.palette.resize(joints);
+    c.skinned.resize(bind.size());
+    ComputeSkinningPalette(skeleton, c.pose, c.world.data(), c.palette.data());
+    SkinVertices(bind.data(), model.influences.data(), bind.size(), c.palette.data(), c.skinned.data());
+    float bindError = 0.f;
+    for (size_t i = 0; i < bind.size(); ++i) {
+        bindError = std::max(bindError, std::fabs(c.skinned[i].px - bind[i].px));
+        bindError = std::max(bindError, std::fabs(c.skinned[i].py - bind[i].py));
+        bindError = std::max(bindError, std::fabs(c.skinned[i].pz - bind[i].pz));
+    }
+
+    // and the palette of an animated pose matches the scalar reference
+    const AnimationClip& clip = model.clips[0];
+    const AnimationClip& fadeClip = model.clips[model.clips.size() > 1 ? 1 : 0];
+    clip.Sample(clip.Duration() * 0.37f, true, c.pose);
+    ComputeSkinningPalette(skeleton, c.pose, c.world.data(), c.palette.data());
+    const float paletteError = PaletteError(skeleton, c.pose, c.palette.data());
+    std::printf("bind pose error %.2g, palette error %.2g\n", bindError, paletteError);
+    if (bindError > 1e-4f || paletteError > 1e-4f) {
+        std::fprintf(stderr, "FAILED: skinning does not match the reference\n");
+        return 1;
+    }
+
+    std::vector<Character> crowd(characterCount);
+    for (size_t i = 0; i < characterCount; ++i) {
+        Character& ch = crowd[i];
+        ch.time = clip.Duration() * float(i) / float(characterCount);
+        ch.fadeTime = fadeClip.Duration() * float((i * 7) % characterCount) / float(characterCount);
+        ch.weight = float(i % 16) / 16.f;
+        ch.pose.Resize(joints);
+        ch.fadePose.Resize(joints);
+        ch.world.resize(joints);
+        ch.palette.resize(joints);
+        ch.skinned.resize(bind.size());
+    }
+
+    // sample + blend + palette, then the same with skinning
+    double animate = 1e30, full = 1e30;
+    for (int it = 0; it < iterations; ++it) {
+        for (int skin = 0; skin < 2; ++skin) {
+            const auto t0 = std::chrono::steady_clock::now();
+            for (Character& ch : crowd) {
+                clip.Sample(ch.time, true, ch.pose);
+                fadeClip.Sample(ch.fadeTime, true, ch.fadePose);
+                BlendPoses(ch.fadePose, ch.pose, ch.weight, ch.pose);
+                ComputeSkinningPalette(skeleton, ch.pose, ch.world.data(), ch.palette.data());
+                if (skin)
+                    SkinVertices(bind.data(), model.influences.data(), bind.size(), ch.palette.data(), ch.skinned.data());
+            }
+            double& best = skin ? full : animate;
+            best = std::min(best, Seconds(t0));
+        }
+    }
+    const double ms = 1000.0 / double(characterCount);
+    std::printf("%zu characters, best of %d, one thread\n", characterCount, iterations);
+    std::printf("sample+blend+palette       %8.1f characters/ms\n", 1.0 / (animate * ms));
+    std::printf("sample+blend+palette+skin  %8.1f characters/ms, %.1f Mvertices/s\n",
+        1.0 / (full * ms), double(characterCount) * bind.size() / full / 1e6);
+    return 0;
+}
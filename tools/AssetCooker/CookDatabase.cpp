@@ -0,0 +1,156 @@
+#include "CookDatabase.h"
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    bool ReadFile(const std::string& path, std::vector<uint8_t>& out)
+    {
+        std::ifstream f(path, std::ios::binary | std::ios::ate);
+        if (!f.is_open()) return false;
+        const std::streamsize size = f.tellg();
+        f.seekg(0, std::ios::beg);
+        out.resize(size_t(size > 0 ? size : 0));
+        return out.empty() || bool(f.read(reinterpret_cast<char*>(out.data()), size));
+    }
+
+    // D|O <size> <mtime> <hash lo> <hash hi> <path>, the path runs to the end of the line
+    void WriteState(std::ostream& os, char tag, const CookDatabase::FileState& s)
+    {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "%c %" PRId64 " %" PRId64 " %016" PRIx64 " %016" PRIx64 " ",
+            tag, s.size, s.mtime, s.hash.lo, s.hash.hi);
+        os << buf << s.path << '\n';
+    }
+
+    bool ReadState(const std::string& line, CookDatabase::FileState& s)
+    {
+        std::istringstream is(line.substr(2));
+        std::string lo, hi;
+        if (!(is >> s.size >> s.mtime >> lo >> hi)) return false;
+        s.hash.lo = std::stoull(lo, nullptr, 16);
+        s.hash.hi = std::stoull(hi, nullptr, 16);
+        is.get();
+        std::getline(is, s.path);
+        return !s.path.empty();
+    }
+}
+
+void CookDatabase::Load(const std::string& path, const std::string& toolVersion)
+{
+    m_toolVersion = toolVersion;
+    m_entries.clear();
+
+    std::ifstream f(path);
+    std::string line;
+    if (!f.is_open() || !std::getline(f, line) || line != "assetcook " + toolVersion)
+        return;
+
+    Entry* current = nullptr;
+    while (std::getline(f, line)) {
+        if (line.size() < 3) continue;
+        FileState s;
+        switch (line[0]) {
+        case 'S':
+            current = &m_entries[line.substr(2)];
+            break;
+        case 'O':
+            if (current && ReadState(line, s)) current->output = s;
+            break;
+        case 'D':
+            if (current && ReadState(line, s)) current->dependencies.push_back(s);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool CookDatabase::Save(const std::string& path) const
+{
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        if (!f.is_open()) return false;
+        f << "assetcook " << m_toolVersion << '\n';
+        for (const auto& [source, entry] : m_entries) {
+            f << "S " << source << '\n';
+            WriteState(f, 'O', entry.output);
+            for (const auto& d : entry.dependencies)
+                WriteState(f, 'D', d);
+        }
+        if (!f.good()) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    return !ec;
+}
+
+CookDatabase::FileState CookDatabase::Snapshot(const std::string& path, const FileState* known)
+{
+    FileState s;
+    s.path = path;
+
+    std::error_code ec;
+    const auto size = fs::file_size(path, ec);
+    if (ec) return s;
+    const auto mtime = fs::last_write_time(path, ec);
+    if (ec) return s;
+
+    s.size = int64_t(size);
+    s.mtime = int64_t(mtime.time_since_epoch().count());
+    if (known && known->size == s.size && known->mtime == s.mtime) {
+        s.hash = known->hash;
+        return s;
+    }
+
+    std::vector<uint8_t> data;
+    if (!ReadFile(path, data)) {
+        s.size = -1;
+        return s;
+    }
+    s.hash = HashBytes(data.data(), data.size());
+    return s;
+}
+
+bool CookDatabase::Matches(FileState& known) const
+{
+    const FileState now = Snapshot(known.path, &known);
+    if (now.size != known.size || now.hash != known.hash)
+        return false;
+    // touched but identical: remember the new mtime so it is not hashed again
+    known.mtime = now.mtime;
+    return true;
+}
+
+bool CookDatabase::IsUpToDate(const std::string& source)
+{
+    Entry entry;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        auto it = m_entries.find(source);
+        if (it == m_entries.end()) return false;
+        entry = it->second;
+    }
+
+    if (entry.output.size < 0 || !Matches(entry.output))
+        return false;
+    for (auto& d : entry.dependencies)
+        if (!Matches(d))
+            return false;
+
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_entries[source] = std::move(entry);
+    return true;
+}
+
+void CookDatabase::Record(const std::string& source, Entry entry)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_entries[source] = std::move(entry);
+}
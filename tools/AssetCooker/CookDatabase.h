@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Hash128.h"
+
+// Dependency database of the asset cooker: for each cooked source, the
+// files it was built from with their content hash, and the output it
+// produced. A source is rebuilt when the tool version changed, its output is
+// missing or modified, or any dependency hashes differently. Size and mtime
+// are kept only to skip re-hashing files that were not touched.
+class CookDatabase
+{
+public:
+    struct FileState
+    {
+        std::string path;
+        int64_t size = -1;          // -1: the file did not exist
+        int64_t mtime = 0;
+        Hash128 hash;
+    };
+
+    struct Entry
+    {
+        FileState output;
+        std::vector<FileState> dependencies;
+    };
+
+    // an unreadable file or another tool version gives an empty database
+    void Load(const std::string& path, const std::string& toolVersion);
+    bool Save(const std::string& path) const;
+
+    // false when source needs cooking
+    bool IsUpToDate(const std::string& source);
+    void Record(const std::string& source, Entry entry);
+
+    // stat + hash, the hash is reused when size and mtime match a known state
+    static FileState Snapshot(const std::string& path, const FileState* known = nullptr);
+
+private:
+    bool Matches(FileState& known) const;
+
+    std::string m_toolVersion;
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+};
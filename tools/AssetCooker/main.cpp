@@ -0,0 +1,334 @@
+// Offline asset cooker: walks an asset directory, imports every OBJ with the
+// engine's importer, cleans and optimises it and writes the cooked .cmesh
+// next to the source, where ResourceCache picks it up at runtime. A
+// dependency database in the asset directory makes re-runs rebuild only
+// the sources whose OBJ, MTL or textures changed. Per-vertex ambient
+// occlusion is baked into the cooked vertices; --ao-rays 0 skips it. The
+// textures the materials name are cooked too, once per run however many
+// meshes share them: mips, high quality BC7 or BC5 for the slot, written as
+// a .dds next to the image that ResourceCache uploads without decoding.
+//
+//   AssetCooker <asset-dir> [--force] [--verbose] [--ao-rays <n>]
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AmbientOcclusion.h"
+#include "BlockCompress.h"
+#include "CookDatabase.h"
+#include "CookedMesh.h"
+#include "ImageCodec.h"
+#include "JobSystem.h"
+#include "MeshOptimize.h"
+#include "MipGenerator.h"
+#include "ObjImporter.h"
+#include "TextureFile.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr uint32_t kCookerVersion = 1;
+    constexpr const char* kDatabaseName = ".assetcook.db";
+
+    // anything that changes the bytes written for the same input
+    std::string ToolVersion(const AmbientOcclusion::Settings& ao)
+    {
+        return "cooker" + std::to_string(kCookerVersion)
+            + " cmesh" + std::to_string(CookedMesh::kVersion)
+            + " opt" + std::to_string(MeshOptimize::kVersion)
+            + " vtx" + std::to_string(sizeof(Vertex))
+            + " ao" + std::to_string(AmbientOcclusion::kVersion) + "x" + std::to_string(ao.raysPerVertex)
+            + " mip" + std::to_string(MipGenerator::kVersion)
+            + " bc" + std::to_string(BlockCompress::kVersion);
+    }
+
+    bool IsObj(const fs::path& p)
+    {
+        std::string ext = p.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        return ext == ".obj";
+    }
+
+    struct Job
+    {
+        std::string source;
+        bool cooked = false;
+        bool failed = false;
+        uint64_t bytes = 0;
+        MeshOptimize::Stats stats;
+        AmbientOcclusion::Stats ao;
+        double ms = 0.0;
+        std::string message;
+    };
+
+    struct TextureJob
+    {
+        std::string source;
+        MipGenerator::Content content = MipGenerator::Content::Color;
+        bool cooked = false;
+        bool failed = false;
+        uint32_t width = 0, height = 0;
+        BlockCompress::Format format = BlockCompress::Format::BC7;
+        BlockCompress::Stats stats;
+        double ms = 0.0;
+        std::string message;
+    };
+
+    // Textures shared between meshes cook on the first mesh that reaches
+    // them; the others wait for that to finish, then record the result.
+    struct TextureCooks
+    {
+        struct Slot
+        {
+            std::once_flag once;
+            TextureJob job;
+        };
+
+        bool force = false;
+        std::mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<Slot>> slots;
+
+        Slot& Claim(const std::string& source, MipGenerator::Content content)
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            auto& slot = slots[source];
+            if (!slot) {
+                slot = std::make_unique<Slot>();
+                slot->job.source = source;
+                // a texture in two kinds of slot keeps the first
+                slot->job.content = content;
+            }
+            return *slot;
+        }
+    };
+
+    void CookTexture(TextureJob& job, CookDatabase& db, bool force)
+    {
+        if (!force && db.IsUpToDate(job.source))
+            return;
+        const auto t0 = std::chrono::steady_clock::now();
+
+        int w = 0, h = 0;
+        uint8_t* pixels = ImageCodec::Load(job.source.c_str(), &w, &h);
+        if (!pixels) {
+            job.failed = true;
+            job.message = "missing or unreadable";
+            return;
+        }
+        job.width = uint32_t(w);
+        job.height = uint32_t(h);
+        if (!BlockCompress::CanCompress(job.width, job.height)) {
+            stbi_image_free(pixels);
+            job.message = "not whole 4x4 blocks, decoded at runtime";
+            return;
+        }
+
+        MipGenerator::Settings mipSettings;
+        mipSettings.content = job.content;
+        const MipGenerator::Chain mips = MipGenerator::Generate(pixels, job.width, job.height, mipSettings);
+        stbi_image_free(pixels);
+        const BlockCompress::Settings bc = BlockCompress::SettingsFor(job.content, BlockCompress::Quality::High);
+        job.format = bc.format;
+        const BlockCompress::Chain chain = BlockCompress::Compress(mips, bc, &job.stats);
+
+        const std::string out = TextureFile::PathFor(job.source);
+        if (!TextureFile::Save(out, chain)) {
+            job.failed = true;
+            job.message = "cannot write " + out;
+            return;
+        }
+
+        CookDatabase::Entry entry;
+        entry.output = CookDatabase::Snapshot(out);
+        entry.dependencies.push_back(CookDatabase::Snapshot(job.source));
+        db.Record(job.source, std::move(entry));
+
+        job.cooked = true;
+        job.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    void Cook(Job& job, CookDatabase& db, const AmbientOcclusion::Settings& ao, TextureCooks& textures)
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+
+        MeshData mesh;
+        std::vector<std::string> deps;
+        if (!ObjImporter::Import(job.source, mesh, &deps)) {
+            job.failed = true;
+            job.message = "import failed";
+            return;
+        }
+
+        // the cooked textures are dependencies too, deleting one re-cooks it
+        const size_t slash = job.source.find_last_of("/\\");
+        const std::string baseDir = (slash == std::string::npos) ? "" : job.source.substr(0, slash + 1);
+        std::vector<std::string> cookedTextures;
+        for (const auto& sm : mesh.submeshes) {
+            const std::pair<const std::string*, MipGenerator::Content> slots[] = {
+                { &sm.material.texture, MipGenerator::Content::Color },
+                { &sm.material.normalMap, MipGenerator::Content::NormalMap },
+                { &sm.material.metalRoughMap, MipGenerator::Content::Linear } };
+            for (const auto& [file, content] : slots) {
+                if (file->empty()) continue;
+                const std::string texPath = ObjImporter::JoinPath(baseDir, *file);
+                const std::string out = TextureFile::PathFor(texPath);
+                if (std::find(cookedTextures.begin(), cookedTextures.end(), out) != cookedTextures.end())
+                    continue;
+                cookedTextures.push_back(out);
+                TextureCooks::Slot& slot = textures.Claim(texPath, content);
+                std::call_once(slot.once, CookTexture, std::ref(slot.job), std::ref(db), textures.force);
+                if (slot.job.failed)
+                    job.message += slot.job.message + " texture " + texPath + "; ";
+            }
+        }
+
+        job.stats = MeshOptimize::Optimize(mesh);
+        if (ao.raysPerVertex > 0)
+            job.ao = AmbientOcclusion::Bake(mesh, ao);
+
+        const std::string out = CookedMesh::PathFor(job.source);
+        if (!CookedMesh::Save(out, mesh, deps)) {
+            job.failed = true;
+            job.message += "cannot write " + out;
+            return;
+        }
+
+        CookDatabase::Entry entry;
+        entry.output = CookDatabase::Snapshot(out);
+        // missing textures are recorded too (size -1), so adding them later re-cooks
+        for (const auto& d : deps)
+            entry.dependencies.push_back(CookDatabase::Snapshot(d));
+        for (const auto& t : cookedTextures)
+            entry.dependencies.push_back(CookDatabase::Snapshot(t));
+        db.Record(job.source, std::move(entry));
+
+        job.bytes = uint64_t(std::max<int64_t>(0, CookDatabase::Snapshot(out).size));
+        job.cooked = true;
+        job.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string root;
+    bool force = false, verbose = false;
+    AmbientOcclusion::Settings ao;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--force") force = true;
+        else if (a == "--verbose") verbose = true;
+        else if (a == "--ao-rays" && i + 1 < argc) ao.raysPerVertex = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        else if (root.empty()) root = a;
+        else { root.clear(); break; }
+    }
+    if (root.empty() || !fs::is_directory(root)) {
+        std::fprintf(stderr, "usage: AssetCooker <asset-dir> [--force] [--verbose] [--ao-rays <n>]\n");
+        return 2;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+
+    // work from the asset root so the database and the material paths the
+    // importer records stay relative and the directory can be moved
+    std::error_code ec;
+    fs::current_path(root, ec);
+    if (ec) {
+        std::fprintf(stderr, "cannot enter %s: %s\n", root.c_str(), ec.message().c_str());
+        return 2;
+    }
+    const std::string dbPath = kDatabaseName;
+
+    CookDatabase db;
+    db.Load(dbPath, ToolVersion(ao));
+
+    std::vector<std::string> sources;
+    for (const auto& e : fs::recursive_directory_iterator(".", fs::directory_options::skip_permission_denied))
+        if (e.is_regular_file() && IsObj(e.path()))
+            sources.push_back(e.path().lexically_normal().generic_string());
+    std::sort(sources.begin(), sources.end());
+
+    std::vector<Job> jobs(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i)
+        jobs[i].source = sources[i];
+
+    // the up-to-date check hashes touched files, so it runs on the pool too
+    std::vector<Job*> stale(jobs.size(), nullptr);
+    JobSystem::I().ParallelFor(jobs.size(), 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+            if (force || !db.IsUpToDate(jobs[i].source))
+                stale[i] = &jobs[i];
+    });
+    stale.erase(std::remove(stale.begin(), stale.end(), nullptr), stale.end());
+
+    TextureCooks textures;
+    textures.force = force;
+    JobSystem::I().ParallelFor(stale.size(), 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+            Cook(*stale[i], db, ao, textures);
+    });
+
+    size_t cooked = 0, failed = 0;
+    uint64_t bytes = 0;
+    for (const auto& j : jobs) {
+        if (j.failed) {
+            ++failed;
+            std::fprintf(stderr, "FAILED  %s: %s\n", j.source.c_str(), j.message.c_str());
+            continue;
+        }
+        if (!j.cooked) {
+            if (verbose) std::printf("ok      %s\n", j.source.c_str());
+            continue;
+        }
+        ++cooked;
+        bytes += j.bytes;
+        std::printf("cooked  %s  %.1f ms, %zu -> %zu verts (%zu welded), %zu -> %zu tris, ACMR %.3f -> %.3f, %.1f KB\n",
+            j.source.c_str(), j.ms, j.stats.verticesIn, j.stats.verticesOut, j.stats.welded,
+            j.stats.trianglesIn, j.stats.trianglesOut, j.stats.acmrIn, j.stats.acmrOut, j.bytes / 1024.0);
+        if (j.ao.rays)
+            std::printf("        AO %llu rays in %.1f ms, %.2f Mrays/s, average %.3f\n",
+                (unsigned long long)j.ao.rays, j.ao.seconds * 1000.0,
+                j.ao.rays / std::max(j.ao.seconds, 1e-9) * 1e-6, j.ao.averageAO);
+        if (!j.message.empty())
+            std::fprintf(stderr, "warning %s: %s\n", j.source.c_str(), j.message.c_str());
+    }
+
+    std::vector<const TextureJob*> textureJobs;
+    for (const auto& [source, slot] : textures.slots)
+        textureJobs.push_back(&slot->job);
+    std::sort(textureJobs.begin(), textureJobs.end(), [](const TextureJob* a, const TextureJob* b) { return a->source < b->source; });
+    size_t texturesCooked = 0;
+    for (const TextureJob* t : textureJobs) {
+        if (t->failed) continue;    // reported with the meshes using it
+        if (!t->cooked) {
+            if (verbose) std::printf("ok      %s%s%s\n", t->source.c_str(), t->message.empty() ? "" : ", ", t->message.c_str());
+            continue;
+        }
+        ++texturesCooked;
+        bytes += t->stats.bytesOut;
+        std::printf("cooked  %s  %.1f ms, %ux%u %s, %.1f KB of %.1f KB RGBA8\n",
+            t->source.c_str(), t->ms, t->width, t->height, BlockCompress::FormatName(t->format),
+            t->stats.bytesOut / 1024.0, t->stats.bytesIn / 1024.0);
+    }
+
+    if (!db.Save(dbPath))
+        std::fprintf(stderr, "warning: cannot write %s\n", dbPath.c_str());
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::printf("%zu sources: %zu cooked, %zu up to date, %zu failed; %zu textures cooked; %.1f KB written in %.1f ms (%u workers)\n",
+        jobs.size(), cooked, jobs.size() - cooked - failed, failed, texturesCooked, bytes / 1024.0, ms,
+        JobSystem::I().WorkerCount() + 1);
+    return failed ? 1 : 0;
+}
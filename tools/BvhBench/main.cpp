@@ -0,0 +1,176 @@
+// Headless MeshBVH benchmark: imports an OBJ with the engine's importer,
+// times the binned SAH build (parallel on the JobSystem above 8k
+// triangles) and traces random rays aimed at the model, closest hit and
+// any hit, reporting rays per second. A subset of the rays is checked
+// against a brute-force loop over every triangle; any disagreement fails
+// the run.
+//
+//   BvhBench <mesh.obj> [--rays <n>] [--iterations <n>] [--check <n>]
+//
+// mirage2000/scene.obj is the reference model.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+#include "MeshBVH.h"
+#include "ObjImporter.h"
+
+namespace
+{
+    struct Rng
+    {
+        uint32_t s = 12345;
+        float Next() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return float(s >> 8) * (1.f / 16777216.f); }
+    };
+
+    double Seconds(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    // Moller-Trumbore over every triangle, the reference for the checks
+    bool BruteForce(const MeshData& mesh, const BVHRay& ray, float& tBest, uint32_t& triangle)
+    {
+        tBest = ray.tMax;
+        triangle = BVHHit::kNone;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const Vertex& a = mesh.vertices[mesh.indices[i]];
+            const Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+            const Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+            const float e1[3] = { b.px - a.px, b.py - a.py, b.pz - a.pz };
+            const float e2[3] = { c.px - a.px, c.py - a.py, c.pz - a.pz };
+            const float* d = ray.dir;
+            const float p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+            const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+            if (std::fabs(det) < 1e-12f)
+                continue;
+            const float inv = 1.f / det;
+            const float s[3] = { ray.origin[0] - a.px, ray.origin[1] - a.py, ray.origin[2] - a.pz };
+            const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+            if (u < 0.f || u > 1.f)
+                continue;
+            const float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+            const float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+            if (v < 0.f || u + v > 1.f)
+                continue;
+            const float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+            if (t > 0.f && t < tBest) {
+                tBest = t;
+                triangle = uint32_t(i / 3);
+            }
+        }
+        return triangle != BVHHit::kNone;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    size_t rayCount = 500000, checkCount = 2000;
+    int iterations = 5;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--rays" && i + 1 < argc) rayCount = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        else if (a == "--check" && i + 1 < argc) checkCount = std::strtoull(argv[++i], nullptr, 10);
+        else if (a == "--iterations" && i + 1 < argc) iterations = std::max(1, std::atoi(argv[++i]));
+        else if (a[0] != '-' && path.empty()) path = a;
+        else {
+            std::fprintf(stderr, "usage: BvhBench <mesh.obj> [--rays <n>] [--iterations <n>] [--check <n>]\n");
+            return 2;
+        }
+    }
+    if (path.empty()) {
+        std::fprintf(stderr, "usage: BvhBench <mesh.obj> [--rays <n>] [--iterations <n>] [--check <n>]\n");
+        return 2;
+    }
+
+    MeshData mesh;
+    if (!ObjImporter::Import(path, mesh) || mesh.indices.empty()) {
+        std::fprintf(stderr, "cannot load %s\n", path.c_str());
+        return 1;
+    }
+    std::printf("%s: %zu vertices, %zu triangles; %u workers, %u-wide triangle tests\n", path.c_str(),
+        mesh.vertices.size(), mesh.indices.size() / 3, JobSystem::I().WorkerCount() + 1, MeshBVH::kSimdWidth);
+
+    MeshBVH bvh;
+    double build = 1e30;
+    for (int i = 0; i < iterations; ++i) {
+        const auto t0 = std::chrono::steady_clock::now();
+        bvh.Build(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size());
+        build = std::min(build, Seconds(t0));
+    }
+    std::printf("build: %.2f ms best of %d, %zu nodes, %.2f MB\n",
+        build * 1000.0, iterations, bvh.NodeCount(), bvh.MemoryBytes() / 1048576.0);
+
+    // from a sphere around the bounds towards a random point inside them
+    float mn[3] = { 1e30f, 1e30f, 1e30f }, mx[3] = { -1e30f, -1e30f, -1e30f };
+    for (const Vertex& v : mesh.vertices) {
+        const float p[3] = { v.px, v.py, v.pz };
+        for (int a = 0; a < 3; ++a) { mn[a] = std::min(mn[a], p[a]); mx[a] = std::max(mx[a], p[a]); }
+    }
+    float center[3], radius = 0.f;
+    for (int a = 0; a < 3; ++a) {
+        center[a] = 0.5f * (mn[a] + mx[a]);
+        radius += (mx[a] - mn[a]) * (mx[a] - mn[a]);
+    }
+    radius = std::sqrt(radius);
+
+    Rng rng;
+    std::vector<BVHRay> rays(rayCount);
+    for (BVHRay& ray : rays) {
+        const float z = 2.f * rng.Next() - 1.f, phi = 6.2831853f * rng.Next();
+        const float s = std::sqrt(std::max(0.f, 1.f - z * z));
+        const float dir[3] = { s * std::cos(phi), s * std::sin(phi), z };
+        for (int a = 0; a < 3; ++a) {
+            ray.origin[a] = center[a] + dir[a] * radius;
+            const float target = mn[a] + rng.Next() * (mx[a] - mn[a]);
+            ray.dir[a] = target - ray.origin[a];
+        }
+    }
+
+    // one thread, so the figure is per core
+    std::vector<BVHHit> hits(rayCount);
+    double closest = 1e30, any = 1e30;
+    size_t hitCount = 0, occludedCount = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        hitCount = 0;
+        for (size_t r = 0; r < rayCount; ++r) {
+            hits[r] = BVHHit{};
+            hitCount += bvh.Intersect(rays[r], hits[r]);
+        }
+        closest = std::min(closest, Seconds(t0));
+
+        t0 = std::chrono::steady_clock::now();
+        occludedCount = 0;
+        for (const BVHRay& ray : rays)
+            occludedCount += bvh.Occluded(ray);
+        any = std::min(any, Seconds(t0));
+    }
+    std::printf("%zu rays, %.1f%% hit: closest hit %.2f Mrays/s, any hit %.2f Mrays/s\n", rayCount,
+        100.0 * hitCount / rayCount, rayCount / closest / 1e6, rayCount / any / 1e6);
+    if (hitCount != occludedCount) {
+        std::fprintf(stderr, "FAILED: %zu closest hits but %zu occluded rays\n", hitCount, occludedCount);
+        return 1;
+    }
+
+    // t within float noise; another triangle only where it is as close
+    checkCount = std::min(checkCount, rayCount);
+    size_t mismatches = 0;
+    for (size_t r = 0; r < checkCount; ++r) {
+        float t;
+        uint32_t triangle;
+        const bool hit = BruteForce(mesh, rays[r], t, triangle);
+        const bool same = hit == hits[r].Valid()
+            && (!hit || std::fabs(t - hits[r].t) <= 1e-5f * std::max(1.f, t));
+        mismatches += !same;
+    }
+    std::printf("brute force check: %zu of %zu rays differ\n", mismatches, checkCount);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+#include "BakeScene.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "ObjImporter.h"
+
+namespace
+{
+    // four vertices per face for the outward normals the probe baker needs;
+    // corner c has x, y, z from bits 0, 1, 2, faces go -z +z -y +y -x +x
+    void AddBox(MeshData& m, const float lo[3], const float hi[3], const float color[3])
+    {
+        static const uint32_t faces[12][3] = {
+            { 0, 2, 1 }, { 1, 2, 3 }, { 4, 5, 6 }, { 5, 7, 6 }, { 0, 1, 4 }, { 1, 5, 4 },
+            { 2, 6, 3 }, { 3, 6, 7 }, { 0, 4, 2 }, { 2, 4, 6 }, { 1, 3, 5 }, { 3, 7, 5 } };
+        for (int f = 0; f < 6; ++f) {
+            const int axis = 2 - f / 2;
+            const uint32_t side = f & 1;
+            uint32_t local[8] = {};
+            for (uint32_t c = 0; c < 8; ++c) {
+                if (((c >> axis) & 1) != side) continue;
+                local[c] = uint32_t(m.vertices.size());
+                Vertex vx{};
+                vx.px = (c & 1) ? hi[0] : lo[0];
+                vx.py = (c & 2) ? hi[1] : lo[1];
+                vx.pz = (c & 4) ? hi[2] : lo[2];
+                float n[3] = { 0.f, 0.f, 0.f };
+                n[axis] = side ? 1.f : -1.f;
+                vx.nx = n[0]; vx.ny = n[1]; vx.nz = n[2];
+                vx.r = color[0]; vx.g = color[1]; vx.b = color[2];
+                m.vertices.push_back(vx);
+            }
+            for (int t = f * 2; t < f * 2 + 2; ++t)
+                for (uint32_t c : faces[t]) m.indices.push_back(local[c]);
+        }
+    }
+
+    // wall along x (axis 0) or z (axis 1) at the given coordinate, with a
+    // doorway unless doorAt is negative
+    void AddWall(MeshData& m, int axis, float at, float from, float to, float doorAt, const float color[3])
+    {
+        using namespace BakeScene;
+        auto box = [&](float a0, float a1, float y0, float y1) {
+            if (a1 - a0 <= 1e-4f) return;
+            const int along = axis == 0 ? 0 : 2, across = axis == 0 ? 2 : 0;
+            float lo[3], hi[3];
+            lo[along] = a0; hi[along] = a1;
+            lo[across] = at - kWall * 0.5f; hi[across] = at + kWall * 0.5f;
+            lo[1] = y0; hi[1] = y1;
+            AddBox(m, lo, hi, color);
+        };
+        if (doorAt < 0.f) { box(from, to, 0.f, kHeight); return; }
+        box(from, doorAt - kDoor * 0.5f, 0.f, kHeight);
+        box(doorAt + kDoor * 0.5f, to, 0.f, kHeight);
+        box(doorAt - kDoor * 0.5f, doorAt + kDoor * 0.5f, kDoorHeight, kHeight);
+    }
+}
+
+void BakeScene::BuildDemo(int rooms, const DemoOptions& options, std::vector<std::unique_ptr<Object>>& out)
+{
+    static const float palette[4][3] = { { 0.8f, 0.2f, 0.2f }, { 0.2f, 0.8f, 0.2f }, { 0.2f, 0.3f, 0.8f }, { 0.8f, 0.8f, 0.8f } };
+    const float grey[3] = { 0.5f, 0.5f, 0.5f }, wood[3] = { 0.6f, 0.45f, 0.3f };
+    Rng rng;
+    auto add = [&](bool occluder) -> MeshData& {
+        out.push_back(std::make_unique<Object>());
+        out.back()->occluder = occluder;
+        return out.back()->mesh;
+    };
+    for (int i = 0; i <= rooms; ++i) {
+        for (int j = 0; j < rooms; ++j) {
+            const float from = j * kRoom, to = from + kRoom;
+            const bool outer = i == 0 || i == rooms;
+            for (int axis = 0; axis < 2; ++axis) {
+                const float door = outer ? -1.f : from + 1.5f + rng.Next() * (kRoom - 3.f);
+                AddWall(add(true), axis, i * kRoom, from, to, door, palette[(i + j * 3 + axis) & 3]);
+            }
+        }
+    }
+    for (int x = 0; x < rooms; ++x) {
+        for (int z = 0; z < rooms; ++z) {
+            const float x0 = x * kRoom, z0 = z * kRoom;
+            const float floorLo[3] = { x0, -0.2f, z0 }, floorHi[3] = { x0 + kRoom, 0.f, z0 + kRoom };
+            AddBox(add(true), floorLo, floorHi, grey);
+            if (options.ceilings) {
+                const float lo[3] = { x0, kHeight, z0 }, hi[3] = { x0 + kRoom, kHeight + 0.2f, z0 + kRoom };
+                AddBox(add(true), lo, hi, grey);
+            }
+            if (!options.props) continue;
+            for (int p = 0; p < 4; ++p) {
+                const float s = 0.3f + rng.Next() * 0.7f;
+                const float px = x0 + 1.f + rng.Next() * (kRoom - 2.f - s);
+                const float pz = z0 + 1.f + rng.Next() * (kRoom - 2.f - s);
+                const float lo[3] = { px, 0.f, pz }, hi[3] = { px + s, s * 1.5f, pz + s };
+                AddBox(add(false), lo, hi, wood);
+            }
+        }
+    }
+}
+
+bool BakeScene::LoadScene(const std::string& path, std::vector<std::unique_ptr<Object>>& out)
+{
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return false;
+    }
+    const size_t slash = path.find_last_of("/\\");
+    const std::string dir = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(f, line)) {
+        ++lineNo;
+        line = line.substr(0, line.find('#'));
+        std::istringstream ls(line);
+        std::string file;
+        if (!(ls >> file)) continue;
+        float t[3] = { 0.f, 0.f, 0.f }, scale = 1.f;
+        ls >> t[0] >> t[1] >> t[2] >> scale;
+
+        auto obj = std::make_unique<Object>();
+        if (!ObjImporter::Import(ObjImporter::JoinPath(dir, file), obj->mesh)) {
+            std::fprintf(stderr, "%s:%d: cannot import %s\n", path.c_str(), lineNo, file.c_str());
+            return false;
+        }
+        for (int a = 0; a < 3; ++a) {
+            obj->world[a][a] = scale;
+            obj->world[3][a] = t[a];
+        }
+        out.push_back(std::move(obj));
+    }
+    return true;
+}
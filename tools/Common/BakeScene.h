@@ -0,0 +1,43 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// Static scenes for the offline bakers, PvsBuilder and ProbeBaker: a scene
+// file of OBJ instances or the demo grid of walled rooms. Each tool turns
+// the objects into its own bake input.
+namespace BakeScene
+{
+    struct Object
+    {
+        MeshData mesh;
+        // row-vector world matrix (p' = p * world), as the bakers take it
+        float world[4][4]{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+        // false for the demo's props, which hide nothing
+        bool occluder = true;
+    };
+
+    struct Rng
+    {
+        uint32_t s = 12345;
+        float Next() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return float(s >> 8) * (1.f / 16777216.f); }
+    };
+
+    constexpr float kRoom = 10.f, kHeight = 4.f, kWall = 0.2f, kDoor = 1.4f, kDoorHeight = 2.4f;
+
+    struct DemoOptions
+    {
+        bool ceilings = true;
+        bool props = true;      // a few small boxes per room
+    };
+
+    // rooms x rooms grid of kRoom rooms with a doorway in every inner wall,
+    // each wall in one of four colours, per room a floor, a ceiling and the
+    // props. Box faces have outward normals; the vertex colours are the albedo.
+    void BuildDemo(int rooms, const DemoOptions& options, std::vector<std::unique_ptr<Object>>& out);
+
+    // one object per line, "<file.obj> [x y z] [scale]", paths relative to
+    // the scene file, '#' starts a comment; reports what failed on stderr
+    bool LoadScene(const std::string& path, std::vector<std::unique_ptr<Object>>& out);
+}
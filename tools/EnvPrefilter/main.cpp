@@ -0,0 +1,90 @@
+// Offline environment prefilter: loads an HDR environment, prefilters it at
+// a range of resolutions reporting the time of each stage, and writes the
+// cache of the largest one where the engine looks for it.
+//
+//   EnvPrefilter <env.hdr> [-o out.envc] [--sizes 32,64,128,256] [--samples <n>] [--mips <n>]
+//   EnvPrefilter --sky [...]
+//
+// The environment is equirectangular (2:1) or a 6:1 strip of cube faces,
+// see EnvironmentMap::LoadSource. --sky prefilters the procedural sky the
+// demo falls back to; it has no source file, so only -o writes it.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "EnvironmentMap.h"
+#include "JobSystem.h"
+
+int main(int argc, char** argv)
+{
+    std::string sourcePath, outPath;
+    bool sky = false;
+    std::vector<uint32_t> sizes = { 32, 64, 128, 256 };
+    EnvironmentMap::Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "-o" && i + 1 < argc) outPath = argv[++i];
+        else if (a == "--sky") sky = true;
+        else if (a == "--samples" && i + 1 < argc) settings.samples = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        else if (a == "--mips" && i + 1 < argc) settings.mipCount = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        else if (a == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ','))
+                if (const uint32_t s = uint32_t(std::strtoul(item.c_str(), nullptr, 10))) sizes.push_back(s);
+        }
+        else if (sourcePath.empty() && a[0] != '-') sourcePath = a;
+        else { sourcePath.clear(); sky = false; break; }
+    }
+    if (sourcePath.empty() == !sky || sizes.empty()) {
+        std::fprintf(stderr, "usage: EnvPrefilter <env.hdr> | --sky  [-o out.envc] [--sizes 32,64,...] [--samples <n>] [--mips <n>]\n");
+        return 2;
+    }
+    std::sort(sizes.begin(), sizes.end());
+
+    EnvironmentMap env;
+    const auto t0 = std::chrono::steady_clock::now();
+    if (sky) {
+        const float sun[3] = { -0.2762f, 0.9206f, -0.2762f };
+        env.SetSky(sun, 256);
+    }
+    else if (!env.LoadSource(sourcePath)) {
+        std::fprintf(stderr, "cannot load %s\n", sourcePath.c_str());
+        return 1;
+    }
+    const double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::printf("source: %s, loaded in %.1f ms; %u samples per texel, %u workers\n",
+        sky ? "procedural sky" : sourcePath.c_str(), loadSeconds * 1000.0, settings.samples, JobSystem::I().WorkerCount() + 1);
+    std::printf("%6s %5s %10s %10s %9s %10s %8s %9s\n", "size", "mips", "taps", "specular", "Mtaps/s", "irradiance", "lut", "KB");
+
+    for (uint32_t size : sizes) {
+        settings.faceSize = size;
+        const auto stats = env.Prefilter(settings);
+        std::printf("%6u %5u %9.2fM %8.1fms %9.1f %8.2fms %6.1fms %9.1f\n", env.FaceSize(), env.MipCount(),
+            stats.taps * 1e-6, stats.specularSeconds * 1000.0, stats.taps / std::max(stats.specularSeconds, 1e-9) * 1e-6,
+            stats.irradianceSeconds * 1000.0, stats.lutSeconds * 1000.0, stats.bytes / 1024.0);
+    }
+
+    const float (*sh)[3] = env.Irradiance();
+    std::printf("irradiance DC: %.3f %.3f %.3f\n", sh[0][0] * 0.282095f, sh[0][1] * 0.282095f, sh[0][2] * 0.282095f);
+
+    if (outPath.empty() && !sky) outPath = EnvironmentMap::CachePathFor(sourcePath);
+    if (!outPath.empty()) {
+        EnvironmentMap reloaded;
+        if (!env.Save(outPath) || !reloaded.Load(outPath) || reloaded.FaceSize() != env.FaceSize()) {
+            std::fprintf(stderr, "cannot write %s\n", outPath.c_str());
+            return 1;
+        }
+        std::printf("wrote %s\n", outPath.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+// Headless benchmark of GeometryCodec, the vertex and index stream codec of
+// cooked meshes: finds every OBJ under the given directories, cooks it the
+// way ResourceCache does (import, MeshOptimize, ambient occlusion bake, so
+// the shipped Vertex layout with its tangents and AO), encodes both streams
+// and reports per mesh and in total the compression ratio of each stream
+// and how fast DecodeVertices and DecodeIndices write the raw buffers, on
+// one thread. Every decode must reproduce the cooked streams exactly, and
+// the index decoder must reject the streams against too few vertices;
+// either failing fails the run.
+//
+//   GeometryCodecBench <dir or mesh.obj>... [--iterations <n>]
+//
+// The engine directory holds the repository's meshes.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "AmbientOcclusion.h"
+#include "GeometryCodec.h"
+#include "MeshOptimize.h"
+#include "ObjImporter.h"
+
+namespace
+{
+    double Seconds(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    // best seconds per call, each timing repeating fn for at least 20 ms
+    template <typename Fn>
+    double Time(int iterations, Fn&& fn)
+    {
+        double best = 1e30;
+        for (int i = 0; i < iterations; ++i) {
+            int calls = 0;
+            const auto t0 = std::chrono::steady_clock::now();
+            double elapsed = 0.0;
+            do {
+                fn();
+                ++calls;
+                elapsed = Seconds(t0);
+            } while (elapsed < 0.02);
+            best = std::min(best, elapsed / calls);
+        }
+        return best;
+    }
+
+    struct Totals
+    {
+        uint64_t vertexRaw = 0, vertexEncoded = 0, indexRaw = 0, indexEncoded = 0;
+        double vertexSeconds = 0.0, indexSeconds = 0.0;
+    };
+
+    void Row(const char* name, uint64_t vertices, uint64_t indices, const Totals& t)
+    {
+        std::printf("%-28s %9llu %9llu %8.2fx %8.2fx %10.0f %10.0f\n", name,
+            (unsigned long long)vertices, (unsigned long long)indices,
+            double(t.vertexRaw) / std::max<uint64_t>(1, t.vertexEncoded),
+            double(t.indexRaw) / std::max<uint64_t>(1, t.indexEncoded),
+            t.vertexRaw / std::max(t.vertexSeconds, 1e-12) / 1e6, t.indexRaw / std::max(t.indexSeconds, 1e-12) / 1e6);
+    }
+
+    // the codec keeps triangle order and winding but may rotate the first corner
+    bool SameTriangles(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+    {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i + 2 < a.size(); i += 3) {
+            const uint32_t* x = &a[i];
+            const uint32_t* y = &b[i];
+            if (!(x[0] == y[0] && x[1] == y[1] && x[2] == y[2]) && !(x[0] == y[1] && x[1] == y[2] && x[2] == y[0])
+                && !(x[0] == y[2] && x[1] == y[0] && x[2] == y[1]))
+                return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> roots;
+    int iterations = 5;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--iterations" && i + 1 < argc) iterations = std::max(1, std::atoi(argv[++i]));
+        else if (a[0] != '-') roots.push_back(a);
+        else {
+            roots.clear();
+            break;
+        }
+    }
+    if (roots.empty()) {
+        std::fprintf(stderr, "usage: GeometryCodecBench <dir or mesh.obj>... [--iterations <n>]\n");
+        return 2;
+    }
+
+    std::vector<std::string> paths;
+    for (const std::string& root : roots) {
+        std::error_code ec;
+        if (std::filesystem::is_directory(root, ec)) {
+            for (const auto& e : std::filesystem::recursive_directory_iterator(root, ec))
+                if (e.is_regular_file() && e.path().extension() == ".obj")
+                    paths.push_back(e.path().generic_string());
+        }
+        else {
+            paths.push_back(root);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        std::fprintf(stderr, "no OBJ files found\n");
+        return 1;
+    }
+
+    std::printf("GeometryCodec on %zu cooked meshes, %zu-byte vertices, best of %d, one thread\n",
+        paths.size(), sizeof(Vertex), iterations);
+    std::printf("%-28s %9s %9s %9s %9s %10s %10s\n", "mesh", "vertices", "indices", "vtx ratio", "idx ratio",
+        "vtx MB/s", "idx MB/s");
+    Totals all;
+    uint64_t allVertices = 0, allIndices = 0;
+    for (const std::string& path : paths) {
+        MeshData mesh;
+        if (!ObjImporter::Import(path, mesh)) {
+            std::fprintf(stderr, "FAILED: cannot import %s\n", path.c_str());
+            return 1;
+        }
+        MeshOptimize::Optimize(mesh);
+        AmbientOcclusion::Bake(mesh);
+        const size_t vertexCount = mesh.vertices.size(), indexCount = mesh.indices.size();
+
+        const std::vector<uint8_t> vertexStream = GeometryCodec::EncodeVertices(mesh.vertices.data(), vertexCount, sizeof(Vertex));
+        const std::vector<uint8_t> indexStream = GeometryCodec::EncodeIndices(mesh.indices.data(), indexCount);
+        std::vector<Vertex> vertices(vertexCount);
+        std::vector<uint32_t> indices(indexCount);
+        bool ok = true;
+        Totals t;
+        t.vertexSeconds = Time(iterations, [&] {
+            ok = GeometryCodec::DecodeVertices(vertices.data(), vertexCount, sizeof(Vertex), vertexStream.data(), vertexStream.size()) && ok;
+        });
+        t.indexSeconds = Time(iterations, [&] {
+            ok = GeometryCodec::DecodeIndices(indices.data(), indexCount, vertexCount, indexStream.data(), indexStream.size()) && ok;
+        });
+        const std::string name = std::filesystem::path(path).parent_path().filename().generic_string() + "/"
+            + std::filesystem::path(path).filename().generic_string();
+        if (!ok || std::memcmp(vertices.data(), mesh.vertices.data(), vertexCount * sizeof(Vertex)) != 0
+            || !SameTriangles(indices, mesh.indices)) {
+            std::fprintf(stderr, "FAILED: %s does not decode to the cooked streams\n", name.c_str());
+            return 1;
+        }
+        const uint32_t largest = indexCount ? *std::max_element(mesh.indices.begin(), mesh.indices.end()) : 0;
+        if (indexCount && GeometryCodec::DecodeIndices(indices.data(), indexCount, largest, indexStream.data(), indexStream.size())) {
+            std::fprintf(stderr, "FAILED: %s decodes an index past the vertex count\n", name.c_str());
+            return 1;
+        }
+
+        t.vertexRaw = vertexCount * sizeof(Vertex);
+        t.vertexEncoded = vertexStream.size();
+        t.indexRaw = indexCount * sizeof(uint32_t);
+        t.indexEncoded = indexStream.size();
+        Row(name.c_str(), vertexCount, indexCount, t);
+
+        all.vertexRaw += t.vertexRaw;
+        all.vertexEncoded += t.vertexEncoded;
+        all.indexRaw += t.indexRaw;
+        all.indexEncoded += t.indexEncoded;
+        all.vertexSeconds += t.vertexSeconds;
+        all.indexSeconds += t.indexSeconds;
+        allVertices += vertexCount;
+        allIndices += indexCount;
+    }
+    Row("total", allVertices, allIndices, all);
+    return 0;
+}
@@ -0,0 +1,129 @@
+// CPU-only checks that a throwing job cannot take JobSystem down: jobs that
+// throw on workers and on the waiting thread still drain their counter and
+// Wait rethrows the first exception, nested waits carry it to the outer
+// counter, and ParallelFor runs every chunk to the end before an exception,
+// from the caller's chunk or a queued one, leaves it. Every round ends with
+// a clean batch on the same pool, which hangs or fails if an earlier throw
+// left it broken.
+//
+//   JobSystemTest [--rounds <n>]
+//
+// Exits non-zero on the first failed check.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include "JobSystem.h"
+
+namespace
+{
+    int Fail(const char* what, int round)
+    {
+        std::fprintf(stderr, "FAILED in round %d: %s\n", round, what);
+        return 1;
+    }
+
+    // runs Wait and reports whether it threw the expected message
+    bool WaitThrows(JobCounter& counter, const char* expected)
+    {
+        try {
+            JobSystem::I().Wait(counter);
+        }
+        catch (const std::runtime_error& e) {
+            return expected == nullptr || std::string(e.what()) == expected;
+        }
+        return false;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int rounds = 200;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--rounds" && i + 1 < argc) rounds = std::max(1, std::atoi(argv[++i]));
+        else {
+            std::fprintf(stderr, "usage: JobSystemTest [--rounds <n>]\n");
+            return 2;
+        }
+    }
+
+    JobSystem& jobs = JobSystem::I();
+    std::printf("%d rounds on %u workers\n", rounds, jobs.WorkerCount());
+    for (int round = 0; round < rounds; ++round) {
+        // many jobs, some throwing, taken by workers and by Wait alike
+        {
+            JobCounter counter;
+            std::atomic<int> ran{ 0 };
+            for (int i = 0; i < 256; ++i)
+                jobs.Run(counter, [&ran, i] {
+                    ran.fetch_add(1);
+                    if (i % 64 == 7) throw std::runtime_error("job");
+                });
+            if (!WaitThrows(counter, "job")) return Fail("Wait did not rethrow a job's exception", round);
+            if (!counter.Done() || ran.load() != 256) return Fail("a throwing batch did not run every job", round);
+        }
+
+        // a child's exception reaches the parent's Wait through the parent job
+        {
+            JobCounter outer;
+            jobs.Run(outer, [&jobs] {
+                JobCounter inner;
+                for (int i = 0; i < 8; ++i)
+                    jobs.Run(inner, [i] { if (i == 3) throw std::runtime_error("child"); });
+                jobs.Wait(inner);
+            });
+            if (!WaitThrows(outer, "child")) return Fail("a nested exception did not reach the outer Wait", round);
+        }
+
+        // the caller's chunk throws first; queued chunks capture fn by reference
+        // and must all have finished when the exception arrives
+        {
+            std::atomic<size_t> items{ 0 };
+            size_t firstEnd = 0;
+            bool threw = false;
+            try {
+                jobs.ParallelFor(4096, 16, [&items, &firstEnd](size_t begin, size_t end) {
+                    if (begin == 0) {
+                        firstEnd = end;
+                        throw std::runtime_error("first chunk");
+                    }
+                    items.fetch_add(end - begin);
+                });
+            }
+            catch (const std::runtime_error&) {
+                threw = true;
+            }
+            if (!threw) return Fail("ParallelFor swallowed the caller's chunk exception", round);
+            if (items.load() != 4096 - firstEnd)
+                return Fail("ParallelFor returned before its queued chunks finished", round);
+        }
+
+        // a queued chunk throws
+        {
+            bool threw = false;
+            try {
+                jobs.ParallelFor(4096, 16, [](size_t begin, size_t) {
+                    if (begin >= 2048 && begin < 2064) throw std::runtime_error("queued chunk");
+                });
+            }
+            catch (const std::runtime_error& e) {
+                threw = std::string(e.what()) == "queued chunk";
+            }
+            if (!threw) return Fail("ParallelFor did not rethrow a queued chunk's exception", round);
+        }
+
+        // the pool still works
+        std::atomic<size_t> sum{ 0 };
+        jobs.ParallelFor(4096, 16, [&sum](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) sum.fetch_add(i, std::memory_order_relaxed);
+        });
+        if (sum.load() != size_t(4095) * 4096 / 2) return Fail("a clean ParallelFor after the throws lost work", round);
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,188 @@
+// Offline PVS builder: loads a static scene, bakes its PotentiallyVisibleSet
+// and reports build time, data size and how many objects the runtime would
+// reject from sampled camera positions, checked against rays traced from
+// each exact position; an object hit from a camera but rejected by its
+// cell fails the run.
+//
+//   PvsBuilder <scene.txt> [-o out.pvs] [--cell <size>] [--rays <n>] [--border <n>] [--merge <fraction>] [--no-dilate]
+//   PvsBuilder --demo <rooms> [...]
+//
+// A scene file lists one object per line, "<file.obj> [x y z] [scale]",
+// paths relative to the scene file, '#' starts a comment. Objects get their
+// PVS index in file order, which is what Mesh::SetVisibilityIndex expects.
+// --demo builds a rooms x rooms grid of walled rooms with one doorway per
+// inner wall and a few props each. --rays is the tries per cell and object,
+// --border the tries for objects only a neighbouring cell sees, --merge
+// the fraction of the objects neighbouring cells may add to each other to
+// share a row.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BakeScene.h"
+#include "JobSystem.h"
+#include "MeshBVH.h"
+#include "PotentiallyVisibleSet.h"
+
+int main(int argc, char** argv)
+{
+    std::string scenePath, outPath;
+    int demoRooms = 0;
+    PotentiallyVisibleSet::Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "-o" && i + 1 < argc) outPath = argv[++i];
+        else if (a == "--demo" && i + 1 < argc) demoRooms = std::atoi(argv[++i]);
+        else if (a == "--cell" && i + 1 < argc) settings.cellSize = float(std::atof(argv[++i]));
+        else if (a == "--rays" && i + 1 < argc) settings.raysPerObject = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        else if (a == "--border" && i + 1 < argc) settings.borderRays = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        else if (a == "--merge" && i + 1 < argc) settings.mergeSlack = float(std::atof(argv[++i]));
+        else if (a == "--no-dilate") settings.dilate = false;
+        else if (scenePath.empty() && a[0] != '-') scenePath = a;
+        else { scenePath.clear(); demoRooms = 0; break; }
+    }
+    if (scenePath.empty() == (demoRooms <= 0)) {
+        std::fprintf(stderr, "usage: PvsBuilder <scene.txt> | --demo <rooms>  [-o out.pvs] [--cell <size>] [--rays <n>] [--border <n>] [--merge <fraction>] [--no-dilate]\n");
+        return 2;
+    }
+
+    std::vector<std::unique_ptr<BakeScene::Object>> scene;
+    if (demoRooms > 0) BakeScene::BuildDemo(demoRooms, BakeScene::DemoOptions{}, scene);
+    else if (!BakeScene::LoadScene(scenePath, scene)) return 1;
+
+    std::vector<PotentiallyVisibleSet::Object> objects;
+    size_t triangles = 0;
+    for (const auto& o : scene) {
+        PotentiallyVisibleSet::Object desc;
+        desc.vertices = o->mesh.vertices.data();
+        desc.vertexCount = o->mesh.vertices.size();
+        desc.indices = o->mesh.indices.data();
+        desc.indexCount = o->mesh.indices.size();
+        std::memcpy(desc.world, o->world, sizeof(desc.world));
+        desc.occluder = o->occluder;
+        objects.push_back(desc);
+        triangles += o->mesh.indices.size() / 3;
+    }
+
+    PotentiallyVisibleSet pvs;
+    const auto stats = pvs.Build(objects, settings);
+    if (pvs.Empty()) {
+        std::fprintf(stderr, "empty scene\n");
+        return 1;
+    }
+
+    std::printf("scene: %zu objects, %zu triangles\n", objects.size(), triangles);
+    std::printf("grid: %u cells of %.2f\n", stats.cells, pvs.CellSize());
+    std::printf("build: %.2f s, %.2fM rays, %.2f Mrays/s (%u workers)\n", stats.seconds, stats.rays * 1e-6,
+        stats.rays / std::max(stats.seconds, 1e-9) * 1e-6, JobSystem::I().WorkerCount() + 1);
+    std::printf("cell/object pairs found along sight lines: %u, by border rays: %u\n", stats.lineFound, stats.borderFound);
+    std::printf("data: %.1f KB raw -> %.1f KB encoded, %u unique rows\n", stats.rawBytes / 1024.0,
+        stats.encodedBytes / 1024.0, stats.uniqueRows);
+    std::printf("visible per cell: %.1f%% of the objects on average\n", stats.averageVisible * 100.f);
+
+    if (!outPath.empty()) {
+        PotentiallyVisibleSet reloaded;
+        if (!pvs.Save(outPath) || !reloaded.Load(outPath)) {
+            std::fprintf(stderr, "cannot write %s\n", outPath.c_str());
+            return 1;
+        }
+        std::vector<uint64_t> a, b;
+        for (uint32_t cell = 0; cell < pvs.CellCount(); ++cell) {
+            pvs.DecodeCell(cell, a);
+            reloaded.DecodeCell(cell, b);
+            if (a != b) {
+                std::fprintf(stderr, "%s: cell %u does not read back\n", outPath.c_str(), cell);
+                return 1;
+            }
+        }
+        std::printf("wrote %s\n", outPath.c_str());
+    }
+
+    // ---- rejection rate from sampled cameras, checked with exact rays ----------
+
+    std::vector<Vertex> worldVertices;
+    std::vector<uint32_t> worldIndices, triangleObject;
+    float mn[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, mx[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t o = 0; o < objects.size(); ++o) {
+        const auto& d = objects[o];
+        const uint32_t base = uint32_t(worldVertices.size());
+        for (size_t i = 0; i < d.vertexCount; ++i) {
+            Vertex v{};
+            const Vertex& s = d.vertices[i];
+            v.px = s.px * d.world[0][0] + s.py * d.world[1][0] + s.pz * d.world[2][0] + d.world[3][0];
+            v.py = s.px * d.world[0][1] + s.py * d.world[1][1] + s.pz * d.world[2][1] + d.world[3][1];
+            v.pz = s.px * d.world[0][2] + s.py * d.world[1][2] + s.pz * d.world[2][2] + d.world[3][2];
+            const float p[3] = { v.px, v.py, v.pz };
+            for (int a = 0; a < 3; ++a) { mn[a] = std::min(mn[a], p[a]); mx[a] = std::max(mx[a], p[a]); }
+            worldVertices.push_back(v);
+        }
+        for (size_t i = 0; i + 2 < d.indexCount; i += 3) {
+            for (int k = 0; k < 3; ++k) worldIndices.push_back(base + d.indices[i + k]);
+            triangleObject.push_back(uint32_t(o));
+        }
+    }
+    MeshBVH bvh;
+    bvh.Build(worldVertices.data(), worldIndices.data(), worldIndices.size());
+
+    constexpr int kCameras = 256;
+    constexpr int kCheckRays = 8192;
+    BakeScene::Rng rng;
+    rng.s = 987654321u;
+    std::vector<float> cameras;
+    while (cameras.size() < size_t(kCameras) * 3) {
+        float p[3];
+        if (demoRooms > 0) {
+            // inside a room, away from the walls, at eye height
+            const int rx = int(rng.Next() * demoRooms), rz = int(rng.Next() * demoRooms);
+            p[0] = rx * BakeScene::kRoom + 0.5f + rng.Next() * (BakeScene::kRoom - 1.f);
+            p[1] = 1.7f;
+            p[2] = rz * BakeScene::kRoom + 0.5f + rng.Next() * (BakeScene::kRoom - 1.f);
+        }
+        else {
+            for (int a = 0; a < 3; ++a) p[a] = mn[a] + rng.Next() * (mx[a] - mn[a]);
+        }
+        cameras.insert(cameras.end(), p, p + 3);
+    }
+
+    uint64_t rejected = 0, seen = 0, wronglyRejected = 0;
+    std::vector<uint64_t> visible;
+    std::vector<uint8_t> hitObjects(objects.size());
+    for (int c = 0; c < kCameras; ++c) {
+        const float* p = &cameras[size_t(c) * 3];
+        pvs.DecodeCell(pvs.CellAt(p), visible);
+        std::fill(hitObjects.begin(), hitObjects.end(), 0);
+        JobSystem::I().ParallelFor(kCheckRays, 256, [&](size_t b, size_t e) {
+            for (size_t r = b; r < e; ++r) {
+                // Fibonacci sphere
+                const float z = 1.f - (2.f * r + 1.f) / kCheckRays;
+                const float s = std::sqrt(std::max(0.f, 1.f - z * z));
+                const float phi = 2.39996323f * float(r);
+                BVHRay ray;
+                for (int a = 0; a < 3; ++a) ray.origin[a] = p[a];
+                ray.dir[0] = s * std::cos(phi); ray.dir[1] = s * std::sin(phi); ray.dir[2] = z;
+                BVHHit hit;
+                if (bvh.Intersect(ray, hit)) hitObjects[triangleObject[hit.triangle]] = 1;
+            }
+        });
+        for (size_t o = 0; o < objects.size(); ++o) {
+            const bool pvsVisible = (visible[o >> 6] >> (o & 63)) & 1;
+            rejected += !pvsVisible;
+            seen += hitObjects[o];
+            wronglyRejected += hitObjects[o] && !pvsVisible;
+        }
+    }
+    std::printf("rejection: %.1f%% of the objects over %d cameras; %llu of %llu objects hit by %d rays per camera were rejected\n",
+        100.0 * rejected / (double(kCameras) * objects.size()), kCameras,
+        (unsigned long long)wronglyRejected, (unsigned long long)seen, kCheckRays);
+    if (wronglyRejected > 0) {
+        std::fprintf(stderr, "FAILED: the PVS rejects objects a camera sees\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+// CPU-only fragmentation harness for RangeAllocator, the best-fit free list
+// GeometryPool suballocates its vertex and index pages with. Runs random
+// allocations and frees of mesh-like sizes (log-uniform, mostly small, the
+// odd large one) around a target fill, and checks after every operation
+// that live ranges do not overlap and every few thousand that the free
+// list is fully coalesced: as many free blocks as gaps between live ranges,
+// the largest one the largest gap. Prints the fragmentation stats as it
+// goes and frees everything at the end, which must leave one block.
+//
+//   RangeAllocatorTest [--ops <n>] [--capacity <units>] [--fill <fraction>] [--seed <n>]
+//
+// Exits non-zero on the first failed check.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "RangeAllocator.h"
+
+namespace
+{
+    struct Rng
+    {
+        uint32_t s = 12345;
+        uint32_t Next() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+        float Unit() { return float(Next() >> 8) * (1.f / 16777216.f); }
+    };
+
+    struct Range
+    {
+        uint32_t offset = 0, size = 0;
+    };
+
+    // 16 to 64K units log-uniform, one in a hundred up to 1M
+    uint32_t MeshSize(Rng& rng)
+    {
+        const float maxLog = rng.Next() % 100 == 0 ? 20.f : 16.f;
+        return uint32_t(std::exp2(4.f + rng.Unit() * (maxLog - 4.f)));
+    }
+
+    int Fail(const char* what, uint64_t op)
+    {
+        std::fprintf(stderr, "FAILED after op %llu: %s\n", (unsigned long long)op, what);
+        return 1;
+    }
+
+    // the gaps between live ranges are what a coalesced free list holds
+    bool Coalesced(const std::map<uint32_t, uint32_t>& live, const RangeAllocator& a)
+    {
+        uint32_t gaps = 0, largest = 0, at = 0;
+        for (const auto& [offset, size] : live) {
+            if (offset > at) {
+                ++gaps;
+                largest = std::max(largest, offset - at);
+            }
+            at = offset + size;
+        }
+        if (a.Capacity() > at) {
+            ++gaps;
+            largest = std::max(largest, a.Capacity() - at);
+        }
+        const RangeAllocator::Stats s = a.GetStats();
+        return s.freeBlocks == gaps && s.largestFree == largest && s.allocations == live.size();
+    }
+
+    void Report(const char* label, const RangeAllocator& a, uint64_t failed)
+    {
+        const RangeAllocator::Stats s = a.GetStats();
+        std::printf("%-10s %6.1f%% used %9u allocs %8u free blocks %10u largest %6.3f fragmentation %8llu failed\n",
+            label, 100.0 * s.used / std::max(1u, s.capacity), s.allocations, s.freeBlocks, s.largestFree,
+            s.Fragmentation(), (unsigned long long)failed);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t ops = 200000;
+    uint32_t capacity = 1u << 24;
+    float fill = 0.75f;
+    Rng rng;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--ops" && i + 1 < argc) ops = std::strtoull(argv[++i], nullptr, 10);
+        else if (a == "--capacity" && i + 1 < argc) capacity = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        else if (a == "--fill" && i + 1 < argc) fill = std::clamp(float(std::atof(argv[++i])), 0.05f, 0.99f);
+        else if (a == "--seed" && i + 1 < argc) rng.s = std::max(1u, uint32_t(std::strtoul(argv[++i], nullptr, 10)));
+        else {
+            std::fprintf(stderr, "usage: RangeAllocatorTest [--ops <n>] [--capacity <units>] [--fill <fraction>] [--seed <n>]\n");
+            return 2;
+        }
+    }
+    if (capacity < 1024) {
+        std::fprintf(stderr, "capacity must be at least 1024\n");
+        return 2;
+    }
+
+    RangeAllocator allocator(capacity);
+    std::vector<Range> ranges;                  // live, for picking one to free
+    std::map<uint32_t, uint32_t> live;          // offset to size, for the checks
+    uint64_t failed = 0;
+    const uint64_t reportEvery = std::max<uint64_t>(1, ops / 8);
+
+    std::printf("%llu ops on %u units, target fill %.0f%%\n", (unsigned long long)ops, capacity, fill * 100.f);
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint64_t op = 1; op <= ops; ++op) {
+        // allocate more often below the target fill, free more above it
+        const float used = float(allocator.Used()) / float(capacity);
+        const bool allocate = ranges.empty() || rng.Unit() < (used < fill ? 0.65f : 0.35f);
+        if (allocate) {
+            const uint32_t size = MeshSize(rng);
+            const uint32_t offset = allocator.Allocate(size);
+            if (offset == RangeAllocator::kInvalid) {
+                if (size <= allocator.LargestFree())
+                    return Fail("allocation failed with a large enough free block", op);
+                ++failed;
+                continue;
+            }
+            if (uint64_t(offset) + size > capacity)
+                return Fail("range past the capacity", op);
+            auto next = live.lower_bound(offset);
+            if (next != live.end() && offset + size > next->first)
+                return Fail("range overlaps the next live one", op);
+            if (next != live.begin()) {
+                const auto prev = std::prev(next);
+                if (prev->first + prev->second > offset)
+                    return Fail("range overlaps the previous live one", op);
+            }
+            live.emplace(offset, size);
+            ranges.push_back({ offset, size });
+        }
+        else {
+            const size_t i = rng.Next() % ranges.size();
+            allocator.Free(ranges[i].offset, ranges[i].size);
+            live.erase(ranges[i].offset);
+            ranges[i] = ranges.back();
+            ranges.pop_back();
+        }
+
+        if (op % 4096 == 0 && !Coalesced(live, allocator))
+            return Fail("free list does not match the gaps between live ranges", op);
+        if (op % reportEvery == 0)
+            Report(("op " + std::to_string(op)).c_str(), allocator, failed);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    if (!Coalesced(live, allocator))
+        return Fail("free list does not match the gaps between live ranges", ops);
+    Report("end", allocator, failed);
+
+    // everything back in random order must merge into the one block
+    for (size_t i = ranges.size(); i > 1; --i)
+        std::swap(ranges[i - 1], ranges[rng.Next() % i]);
+    for (const Range& r : ranges)
+        allocator.Free(r.offset, r.size);
+    const RangeAllocator::Stats s = allocator.GetStats();
+    if (s.used != 0 || s.allocations != 0 || s.freeBlocks != 1 || s.largestFree != capacity)
+        return Fail("freeing everything did not coalesce into one block", ops);
+    Report("all freed", allocator, failed);
+
+    std::printf("%.2f ms, %.0f ns per op; all checks passed\n", seconds * 1000.0, seconds * 1e9 / double(ops));
+    return 0;
+}
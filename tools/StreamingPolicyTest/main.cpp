@@ -0,0 +1,333 @@
+// Checks of StreamingPolicy, the residency decisions of mip streaming, on
+// RGBA8 chains without a GPU: textures start at their tail, load one level
+// per Update finest-needed first, hold a level at a mip boundary until the
+// requests stayed past the hysteresis for dropFrames updates, drop to the
+// tail once nobody asks for them, share a tight budget by weight, respect
+// the per-Update upload cap and hand out the ids of removed textures fresh.
+// Every Update must keep the resident bytes within the budget and report
+// exactly the textures whose first mip moved.
+//
+//   StreamingPolicyTest
+//
+// Exits non-zero on the first failed check.
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "StreamingPolicy.h"
+
+namespace
+{
+    using Id = StreamingPolicy::Id;
+
+    int Fail(const std::string& what)
+    {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        return 1;
+    }
+
+    struct Chain
+    {
+        uint32_t width = 0, height = 0;
+        std::vector<uint64_t> levels;
+
+        Chain(uint32_t w, uint32_t h) : width(w), height(h)
+        {
+            for (uint32_t l = 0; (std::max(w, h) >> l) > 0; ++l)
+                levels.push_back(uint64_t(std::max(w >> l, 1u)) * std::max(h >> l, 1u) * 4);
+        }
+        uint64_t From(uint32_t first) const
+        {
+            uint64_t bytes = 0;
+            for (uint32_t l = first; l < levels.size(); ++l) bytes += levels[l];
+            return bytes;
+        }
+    };
+
+    Id Add(StreamingPolicy& policy, const Chain& c, uint32_t coarsestFirst = UINT32_MAX)
+    {
+        return policy.Add(c.width, c.height, c.levels.data(), uint32_t(c.levels.size()), coarsestFirst);
+    }
+
+    // runs an Update and checks what it reports against the first mips it left
+    std::string Update(StreamingPolicy& policy, const std::vector<Id>& ids)
+    {
+        std::map<Id, uint32_t> before;
+        for (Id id : ids) before[id] = policy.FirstMip(id);
+        const std::vector<StreamingPolicy::Change>& changes = policy.Update();
+        std::map<Id, uint32_t> reported;
+        for (const StreamingPolicy::Change& c : changes) {
+            if (!reported.emplace(c.id, c.firstMip).second)
+                return "texture " + std::to_string(c.id) + " reported twice";
+        }
+        for (Id id : ids) {
+            const uint32_t first = policy.FirstMip(id);
+            const auto it = reported.find(id);
+            if ((first != before[id]) != (it != reported.end()) || (it != reported.end() && it->second != first))
+                return "changes do not match the first mip of texture " + std::to_string(id);
+        }
+        const StreamingPolicy::Stats s = policy.GetStats();
+        if (s.residentBytes > s.budgetBytes)
+            return "resident bytes past the budget";
+        return {};
+    }
+
+    std::string TailStart()
+    {
+        StreamingPolicy policy;
+        const Chain big(1024, 1024), wide(1024, 16), small(32, 32);
+        const Id a = Add(policy, big), b = Add(policy, wide), c = Add(policy, small), d = Add(policy, big, 2);
+        // 1024 >> 4 is the first level no larger than the 64 texel tail
+        if (policy.FirstMip(a) != 4 || policy.MinFirstMip(a) != 4) return "1024^2 does not start at mip 4";
+        if (policy.FirstMip(b) != 4) return "1024x16 does not start at mip 4";
+        if (policy.FirstMip(c) != 0) return "a texture within the tail does not start at mip 0";
+        if (policy.FirstMip(d) != 2 || policy.MinFirstMip(d) != 2) return "coarsestFirst does not bound the tail";
+        const uint64_t resident = big.From(4) + wide.From(4) + small.From(0) + big.From(2);
+        if (policy.GetStats().residentBytes != resident) return "tail bytes are not counted as resident";
+
+        // the tail stays, whatever the requests
+        for (int i = 0; i < 100; ++i) {
+            policy.Request(a, 20.f, 1.f);
+            if (std::string e = Update(policy, { a, b, c, d }); !e.empty()) return e;
+        }
+        if (policy.FirstMip(a) != 4 || policy.FirstMip(c) != 0) return "a texture left its tail";
+        return {};
+    }
+
+    std::string ProgressiveLoads()
+    {
+        StreamingPolicy policy;
+        const Chain chain(1024, 1024);
+        const Id id = Add(policy, chain);
+        // one level per Update, each reported, until the request is met
+        for (uint32_t expected = 3; expected != UINT32_MAX; --expected) {
+            policy.Request(id, 0.4f, 1.f);
+            if (std::string e = Update(policy, { id }); !e.empty()) return e;
+            if (policy.FirstMip(id) != expected) return "did not load one level per Update";
+            if (policy.GetStats().residentBytes != chain.From(expected)) return "resident bytes do not follow the loads";
+        }
+        policy.Request(id, 0.4f, 1.f);
+        if (!policy.Update().empty()) return "a met request still changes the texture";
+        if (policy.GetStats().loads != 4) return "expected 4 loads";
+
+        // the finest request of an Update wins, bias shifts it
+        StreamingPolicy biased;
+        StreamingPolicy::Settings s;
+        s.bias = 1.f;
+        biased.SetSettings(s);
+        const Id b = Add(biased, chain);
+        for (int i = 0; i < 10; ++i) {
+            biased.Request(b, 3.f, 1.f);
+            biased.Request(b, 1.f, 1.f);
+            if (std::string e = Update(biased, { b }); !e.empty()) return e;
+        }
+        if (biased.FirstMip(b) != 2 || biased.TargetMip(b) != 2) return "finest request plus bias is not the target";
+        return {};
+    }
+
+    std::string Hysteresis()
+    {
+        StreamingPolicy policy;
+        StreamingPolicy::Settings s;
+        s.dropFrames = 5;
+        policy.SetSettings(s);
+        const Chain chain(1024, 1024);
+        const Id id = Add(policy, chain);
+        for (int i = 0; i < 3; ++i) {
+            policy.Request(id, 1.f, 1.f);
+            if (std::string e = Update(policy, { id }); !e.empty()) return e;
+        }
+        if (policy.FirstMip(id) != 1) return "did not load to mip 1";
+
+        // hovering around the boundary, within the hysteresis, never drops
+        const float hover[] = { 1.9f, 2.1f, 2.2f, 1.6f, 2.24f };
+        for (int i = 0; i < 100; ++i) {
+            policy.Request(id, hover[i % 5], 1.f);
+            if (std::string e = Update(policy, { id }); !e.empty()) return e;
+            if (policy.FirstMip(id) != 1) return "a request within the hysteresis dropped a level";
+        }
+        // past it, one Update short of dropFrames, then back: no drop
+        for (uint32_t i = 0; i + 1 < s.dropFrames; ++i) {
+            policy.Request(id, 2.3f, 1.f);
+            if (std::string e = Update(policy, { id }); !e.empty()) return e;
+        }
+        policy.Request(id, 1.5f, 1.f);
+        if (std::string e = Update(policy, { id }); !e.empty()) return e;
+        if (policy.FirstMip(id) != 1) return "dropped before dropFrames updates in a row";
+        // dropFrames in a row drop
+        for (uint32_t i = 0; i < s.dropFrames; ++i) {
+            if (policy.FirstMip(id) != 1) return "dropped before dropFrames updates in a row";
+            policy.Request(id, 2.3f, 1.f);
+            if (std::string e = Update(policy, { id }); !e.empty()) return e;
+        }
+        if (policy.FirstMip(id) != 2) return "did not drop after dropFrames updates";
+        if (policy.GetStats().drops != 1) return "expected one drop";
+        return {};
+    }
+
+    std::string Unseen()
+    {
+        StreamingPolicy policy;
+        StreamingPolicy::Settings s;
+        s.dropFrames = 8;
+        policy.SetSettings(s);
+        const Chain chain(512, 512);
+        const Id seen = Add(policy, chain), gone = Add(policy, chain);
+        for (int i = 0; i < 4; ++i) {
+            policy.Request(seen, 0.f, 1.f);
+            policy.Request(gone, 0.f, 1.f);
+            if (std::string e = Update(policy, { seen, gone }); !e.empty()) return e;
+        }
+        if (policy.FirstMip(gone) != 0) return "did not load to mip 0";
+
+        // a texture nobody asks for goes back to its tail in one step
+        for (uint32_t i = 0; i < s.dropFrames; ++i) {
+            if (policy.FirstMip(gone) != 0) return "an unseen texture dropped before dropFrames updates";
+            policy.Request(seen, 0.f, 1.f);
+            if (std::string e = Update(policy, { seen, gone }); !e.empty()) return e;
+        }
+        if (policy.FirstMip(gone) != policy.MinFirstMip(gone)) return "an unseen texture did not drop to its tail";
+        if (policy.FirstMip(seen) != 0) return "a seen texture dropped";
+        if (policy.GetStats().residentBytes != chain.From(0) + chain.From(policy.MinFirstMip(gone)))
+            return "the drop did not free the levels";
+        return {};
+    }
+
+    std::string BudgetContention()
+    {
+        // room for the tails and one full chain
+        const Chain chain(256, 256);
+        StreamingPolicy policy;
+        StreamingPolicy::Settings s;
+        s.budgetBytes = chain.From(2) * 2 + chain.levels[0] + chain.levels[1];
+        policy.SetSettings(s);
+        const Id a = Add(policy, chain), b = Add(policy, chain);
+        auto run = [&](float weightA, float weightB) -> std::string {
+            for (int i = 0; i < 20; ++i) {
+                policy.Request(a, 0.f, weightA);
+                policy.Request(b, 0.f, weightB);
+                if (std::string e = Update(policy, { a, b }); !e.empty()) return e;
+            }
+            return {};
+        };
+        if (std::string e = run(10.f, 1.f); !e.empty()) return e;
+        if (policy.FirstMip(a) != 0 || policy.FirstMip(b) != 2) return "the heavier texture did not get the budget";
+        if (policy.GetStats().deferred == 0) return "the lighter texture's loads were not deferred";
+
+        // the weights flip: the heavier texture evicts the other's two levels
+        uint64_t evictions = policy.GetStats().evictions;
+        if (std::string e = run(1.f, 10.f); !e.empty()) return e;
+        if (policy.FirstMip(a) != 2 || policy.FirstMip(b) != 0) return "the budget did not move to the heavier texture";
+        if (policy.GetStats().evictions != evictions + 2) return "expected two evictions";
+
+        // equal weights share the budget once and then stop evicting each other
+        if (std::string e = run(1.f, 1.f); !e.empty()) return e;
+        evictions = policy.GetStats().evictions;
+        const uint32_t firstA = policy.FirstMip(a), firstB = policy.FirstMip(b);
+        if (std::string e = run(1.f, 1.f); !e.empty()) return e;
+        if (policy.GetStats().evictions != evictions || policy.FirstMip(a) != firstA || policy.FirstMip(b) != firstB)
+            return "equal weights keep evicting each other";
+
+        // a smaller budget evicts without any load
+        s.budgetBytes = chain.From(2) * 2;
+        policy.SetSettings(s);
+        if (std::string e = Update(policy, { a, b }); !e.empty()) return e;
+        if (policy.FirstMip(a) != 2 || policy.FirstMip(b) != 2) return "a shrunk budget did not evict down to the tails";
+        return {};
+    }
+
+    std::string UploadCap()
+    {
+        const Chain chain(256, 256);
+        StreamingPolicy policy;
+        StreamingPolicy::Settings s;
+        s.uploadBytesPerUpdate = 1;
+        policy.SetSettings(s);
+        std::vector<Id> ids;
+        for (int i = 0; i < 3; ++i) ids.push_back(Add(policy, chain));
+
+        // at least one load always goes, and only one fits
+        for (int update = 0; update < 6; ++update) {
+            for (Id id : ids) policy.Request(id, 0.f, 1.f);
+            const uint64_t loads = policy.GetStats().loads;
+            if (std::string e = Update(policy, ids); !e.empty()) return e;
+            if (policy.GetStats().loads != loads + 1) return "the upload cap let more than one load through";
+        }
+        for (Id id : ids)
+            if (policy.FirstMip(id) != 0) return "capped loads did not reach every texture";
+
+        // a new first mip re-uploads the levels below it: the cap covers them,
+        // so two loads of mip 1 fit twice its chain but not a byte less
+        for (uint64_t cap : { chain.From(1) * 2, chain.From(1) * 2 - 1 }) {
+            StreamingPolicy capped;
+            s.uploadBytesPerUpdate = cap;
+            capped.SetSettings(s);
+            std::vector<Id> more;
+            for (int i = 0; i < 3; ++i) more.push_back(Add(capped, chain));
+            for (Id id : more) capped.Request(id, 1.f, 1.f);
+            if (std::string e = Update(capped, more); !e.empty()) return e;
+            uint32_t atOne = 0;
+            for (Id id : more) atOne += capped.FirstMip(id) == 1;
+            if (atOne != (cap == chain.From(1) * 2 ? 2u : 1u)) return "the cap does not count the levels below a load";
+        }
+        return {};
+    }
+
+    std::string IdReuse()
+    {
+        StreamingPolicy policy;
+        const Chain big(1024, 1024), small(32, 32);
+        const Id a = Add(policy, big), b = Add(policy, big);
+        for (int i = 0; i < 4; ++i) {
+            policy.Request(a, 0.f, 1.f);
+            policy.Request(b, 0.f, 1.f);
+            if (std::string e = Update(policy, { a, b }); !e.empty()) return e;
+        }
+        policy.Remove(a);
+        policy.Remove(a);
+        policy.Request(a, 0.f, 1.f);
+        if (std::string e = Update(policy, { b }); !e.empty()) return e;
+        if (policy.GetStats().textures != 1 || policy.GetStats().residentBytes != big.From(policy.FirstMip(b)))
+            return "a removed texture still counts";
+
+        // the id comes back with nothing of the old texture
+        const Id c = Add(policy, small);
+        if (c != a) return "the removed id was not reused";
+        if (policy.FirstMip(c) != 0 || policy.MinFirstMip(c) != 0) return "a reused id kept the old texture's mips";
+        const Id d = Add(policy, big);
+        if (d == a || d == b) return "a live id was handed out again";
+        if (policy.FirstMip(d) != 4) return "a new id does not start at its tail";
+        for (int i = 0; i < 2; ++i)
+            if (std::string e = Update(policy, { b, c, d }); !e.empty()) return e;
+        if (policy.GetStats().residentBytes != big.From(policy.FirstMip(b)) + small.From(0) + big.From(policy.FirstMip(d)))
+            return "resident bytes wrong after reuse";
+        return {};
+    }
+}
+
+int main(int argc, char**)
+{
+    if (argc > 1) {
+        std::fprintf(stderr, "usage: StreamingPolicyTest\n");
+        return 2;
+    }
+    const struct { const char* name; std::string (*run)(); } cases[] = {
+        { "tail start", TailStart },
+        { "progressive loads", ProgressiveLoads },
+        { "hysteresis", Hysteresis },
+        { "unseen textures drop", Unseen },
+        { "budget contention", BudgetContention },
+        { "upload cap", UploadCap },
+        { "id reuse", IdReuse },
+    };
+    for (const auto& c : cases) {
+        if (std::string e = c.run(); !e.empty())
+            return Fail(std::string(c.name) + ": " + e);
+        std::printf("%-24s ok\n", c.name);
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
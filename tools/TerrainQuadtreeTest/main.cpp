@@ -0,0 +1,328 @@
+// Headless checks and timings for TerrainQuadtree selection and the tile
+// paging Terrain draws it with, on a synthetic heightmap. For a set of
+// cameras it checks the drawn quadrants on a grid of level-0 quadrants:
+// no cell drawn twice, no hole inside a drawn root node, every cell whose
+// root is within view range drawn, and no two neighbouring cells more than
+// one level apart. The frustum-culled selection must be a subset of the
+// unculled one with every node intersecting the frustum. The tile cache is
+// flown along a path and must hand each frame distinct slices, with tiles
+// that hold the heights of their node; MaxSelectedNodes must bound every
+// selection. Prints Build, Select and paging timings.
+//
+//   TerrainQuadtreeTest [--size <texels>] [--patch <dim>] [--levels <n>] [--iterations <n>]
+//
+// Exits non-zero on the first failed check.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Frustum.h"
+#include "TerrainQuadtree.h"
+#include "TerrainTileCache.h"
+
+namespace
+{
+    using Node = TerrainQuadtree::Node;
+
+    double Seconds(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    int Fail(const std::string& what)
+    {
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+        return 1;
+    }
+
+    // rolling hills with some high-frequency roughness, so node bounds vary
+    std::vector<uint16_t> MakeHeights(uint32_t side)
+    {
+        std::vector<uint16_t> h(size_t(side) * side);
+        for (uint32_t z = 0; z < side; ++z) {
+            for (uint32_t x = 0; x < side; ++x) {
+                const float fx = float(x) / float(side), fz = float(z) / float(side);
+                float v = 0.5f + 0.25f * std::sin(fx * 9.f) * std::cos(fz * 7.f)
+                    + 0.15f * std::sin((fx + fz) * 41.f) + 0.05f * std::sin(fx * 197.f) * std::sin(fz * 211.f);
+                uint32_t n = x * 374761393u + z * 668265263u;
+                n = (n ^ (n >> 13)) * 1274126177u;
+                v += float(n >> 24) * (0.01f / 255.f);
+                h[size_t(z) * side + x] = uint16_t(std::clamp(v, 0.f, 1.f) * 65535.f);
+            }
+        }
+        return h;
+    }
+
+    // row-vector view-projection like XMMatrixLookAtLH * XMMatrixPerspectiveFovLH
+    Frustum MakeFrustum(const float eye[3], const float at[3], float fovY, float aspect, float zn, float zf)
+    {
+        float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+        float len = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+        for (float& c : z) c /= len;
+        float x[3] = { z[2], 0.f, -z[0] };     // up (0, 1, 0) cross z
+        len = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+        for (float& c : x) c /= len;
+        const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+        float view[4][4] = {};
+        for (int r = 0; r < 3; ++r) {
+            view[r][0] = x[r];
+            view[r][1] = y[r];
+            view[r][2] = z[r];
+        }
+        view[3][0] = -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]);
+        view[3][1] = -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]);
+        view[3][2] = -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]);
+        view[3][3] = 1.f;
+
+        const float h = 1.f / std::tan(fovY * 0.5f), w = h / aspect, q = zf / (zf - zn);
+        const float proj[4][4] = { { w, 0, 0, 0 }, { 0, h, 0, 0 }, { 0, 0, q, 1 }, { 0, 0, -q * zn, 0 } };
+
+        float m[4][4] = {};
+        for (int r = 0; r < 4; ++r)
+            for (int c = 0; c < 4; ++c)
+                for (int k = 0; k < 4; ++k)
+                    m[r][c] += view[r][k] * proj[k][c];
+        return Frustum::FromViewProj(m);
+    }
+
+    struct Camera
+    {
+        float eye[3], at[3];
+    };
+
+    // level of the quadrant drawn over each level-0 quadrant, -1 when none
+    struct Coverage
+    {
+        uint32_t cellsX = 0, cellsZ = 0;
+        std::vector<int> level;
+        std::vector<int> count;
+
+        Coverage(const TerrainQuadtree& tree)
+        {
+            const uint32_t leaf = tree.GetSettings().patchDim;
+            cellsX = std::max(1u, (tree.Width() - 1 + leaf - 1) / leaf) * 2;
+            cellsZ = std::max(1u, (tree.Height() - 1 + leaf - 1) / leaf) * 2;
+            level.assign(size_t(cellsX) * cellsZ, -1);
+            count.assign(size_t(cellsX) * cellsZ, 0);
+        }
+
+        void Add(const Node& n)
+        {
+            const uint32_t span = 1u << n.level;
+            for (uint32_t q = 0; q < 4; ++q) {
+                if (!(n.quadrants & (1u << q)))
+                    continue;
+                const uint32_t x0 = (n.nx * 2 + (q & 1)) * span, z0 = (n.nz * 2 + (q >> 1)) * span;
+                for (uint32_t z = z0; z < std::min(z0 + span, cellsZ); ++z) {
+                    for (uint32_t x = x0; x < std::min(x0 + span, cellsX); ++x) {
+                        level[size_t(z) * cellsX + x] = int(n.level);
+                        ++count[size_t(z) * cellsX + x];
+                    }
+                }
+            }
+        }
+    };
+
+    std::string CheckSelection(const TerrainQuadtree& tree, const float cam[3], const std::vector<Node>& nodes)
+    {
+        const TerrainQuadtree::Settings& s = tree.GetSettings();
+        Coverage cov(tree);
+        for (const Node& n : nodes)
+            cov.Add(n);
+
+        const uint32_t top = s.lodLevels - 1;
+        const uint32_t rootCells = 2u << top;
+        const float cellSize = float(s.patchDim / 2) * s.texelSpacing;
+        const float range = tree.MorphEnd(top);
+        const float dy = std::max(std::fabs(cam[1] - s.baseHeight), std::fabs(cam[1] - s.baseHeight - s.heightScale));
+
+        for (uint32_t z = 0; z < cov.cellsZ; ++z) {
+            for (uint32_t x = 0; x < cov.cellsX; ++x) {
+                const size_t i = size_t(z) * cov.cellsX + x;
+                if (cov.count[i] > 1)
+                    return "cell (" + std::to_string(x) + ", " + std::to_string(z) + ") drawn " + std::to_string(cov.count[i]) + " times";
+
+                // a root is drawn whole or not at all
+                const uint32_t rx = x / rootCells * rootCells, rz = z / rootCells * rootCells;
+                const bool rootDrawn = cov.count[size_t(rz) * cov.cellsX + rx] > 0;
+                if (rootDrawn != (cov.count[i] > 0))
+                    return "hole at cell (" + std::to_string(x) + ", " + std::to_string(z) + ")";
+
+                // a cell this close puts its root inside the top range
+                const float cx = s.originX + (float(x) + 0.5f) * cellSize, cz = s.originZ + (float(z) + 0.5f) * cellSize;
+                const float dx = std::max(0.f, std::fabs(cx - cam[0]) - 0.5f * cellSize);
+                const float dz = std::max(0.f, std::fabs(cz - cam[2]) - 0.5f * cellSize);
+                if (!cov.count[i] && dx * dx + dz * dz + dy * dy <= range * range)
+                    return "cell (" + std::to_string(x) + ", " + std::to_string(z) + ") in range but not drawn";
+
+                if (cov.count[i] && x + 1 < cov.cellsX && cov.count[i + 1] && std::abs(cov.level[i] - cov.level[i + 1]) > 1)
+                    return "LOD jump of more than one level at cell (" + std::to_string(x) + ", " + std::to_string(z) + ")";
+                if (cov.count[i] && z + 1 < cov.cellsZ && cov.count[i + cov.cellsX] && std::abs(cov.level[i] - cov.level[i + cov.cellsX]) > 1)
+                    return "LOD jump of more than one level at cell (" + std::to_string(x) + ", " + std::to_string(z) + ")";
+            }
+        }
+        return {};
+    }
+
+    std::string CheckCulled(const TerrainQuadtree& tree, const Frustum& frustum,
+        const std::vector<Node>& all, const std::vector<Node>& culled)
+    {
+        std::set<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> unculled;
+        for (const Node& n : all)
+            unculled.emplace(n.level, n.nx, n.nz, n.quadrants);
+
+        const TerrainQuadtree::Settings& s = tree.GetSettings();
+        const float edgeX = s.originX + float(tree.Width() - 1) * s.texelSpacing;
+        const float edgeZ = s.originZ + float(tree.Height() - 1) * s.texelSpacing;
+        Coverage cov(tree);
+        for (const Node& n : culled) {
+            // culling only drops nodes; a kept parent draws the same quarters
+            auto it = unculled.lower_bound({ n.level, n.nx, n.nz, 0 });
+            if (it == unculled.end() || std::get<0>(*it) != n.level || std::get<1>(*it) != n.nx || std::get<2>(*it) != n.nz
+                || (n.quadrants & ~std::get<3>(*it)))
+                return "culled selection has a node the unculled one does not";
+            const float mn[3] = { n.x, n.minY, n.z };
+            const float mx[3] = { std::min(n.x + n.size, edgeX), n.maxY, std::min(n.z + n.size, edgeZ) };
+            if (!frustum.IntersectsBox(mn, mx))
+                return "culled selection has a node outside the frustum";
+            cov.Add(n);
+        }
+        for (int c : cov.count)
+            if (c > 1)
+                return "culled selection draws a cell twice";
+        return {};
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t size = 4097;
+    int iterations = 20;
+    TerrainQuadtree::Settings settings;
+    settings.heightScale = 400.f;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--size" && i + 1 < argc) size = std::max(2u, uint32_t(std::strtoul(argv[++i], nullptr, 10)));
+        else if (a == "--patch" && i + 1 < argc) settings.patchDim = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        else if (a == "--levels" && i + 1 < argc) settings.lodLevels = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        else if (a == "--iterations" && i + 1 < argc) iterations = std::max(1, std::atoi(argv[++i]));
+        else {
+            std::fprintf(stderr, "usage: TerrainQuadtreeTest [--size <texels>] [--patch <dim>] [--levels <n>] [--iterations <n>]\n");
+            return 2;
+        }
+    }
+
+    const std::vector<uint16_t> heights = MakeHeights(size);
+    TerrainQuadtree tree;
+    double build = 1e30;
+    for (int i = 0; i < std::min(iterations, 5); ++i) {
+        const auto t0 = std::chrono::steady_clock::now();
+        tree.Build(heights.data(), size, size, settings);
+        build = std::min(build, Seconds(t0));
+    }
+    const TerrainQuadtree::Settings& s = tree.GetSettings();
+    const uint32_t maxNodes = tree.MaxSelectedNodes();
+    std::printf("%ux%u map, patch %u (asked %u), %u levels: build %.2f ms, %.1f KB; at most %u nodes per selection\n",
+        size, size, s.patchDim, settings.patchDim, s.lodLevels, build * 1000.0, tree.MemoryBytes() / 1024.0, maxNodes);
+
+    const float extent = float(size - 1) * s.texelSpacing;
+    const Camera cameras[] = {
+        { { extent * 0.5f, 150.f, extent * 0.5f }, { extent * 0.5f + 100.f, 100.f, extent * 0.5f + 60.f } },
+        { { 10.f, 420.f, 10.f }, { extent, 0.f, extent } },
+        { { extent * 0.25f, 40.f, extent * 0.8f }, { extent * 0.3f, 30.f, extent * 0.2f } },
+        { { extent - 5.f, 220.f, extent * 0.5f }, { 0.f, 200.f, extent * 0.5f } },
+        { { -300.f, 600.f, -300.f }, { extent * 0.2f, 0.f, extent * 0.2f } },
+        { { extent * 0.6f, 2000.f, extent * 0.4f }, { extent * 0.6f, 0.f, extent * 0.41f } },
+    };
+
+    std::vector<Node> all, culled;
+    double selectAll = 0.0, selectCulled = 0.0;
+    for (const Camera& c : cameras) {
+        const Frustum frustum = MakeFrustum(c.eye, c.at, 1.0f, 16.f / 9.f, 0.5f, 1e5f);
+        double bestAll = 1e30, bestCulled = 1e30;
+        TerrainQuadtree::Stats statsAll, statsCulled;
+        for (int i = 0; i < iterations; ++i) {
+            auto t0 = std::chrono::steady_clock::now();
+            statsAll = tree.Select(c.eye, nullptr, all);
+            bestAll = std::min(bestAll, Seconds(t0));
+            t0 = std::chrono::steady_clock::now();
+            statsCulled = tree.Select(c.eye, &frustum, culled);
+            bestCulled = std::min(bestCulled, Seconds(t0));
+        }
+        selectAll += bestAll;
+        selectCulled += bestCulled;
+        std::printf("camera (%.0f, %.0f, %.0f): %u nodes / %u triangles, %u / %u in the frustum; select %.1f / %.1f us\n",
+            c.eye[0], c.eye[1], c.eye[2], statsAll.nodes, statsAll.triangles, statsCulled.nodes, statsCulled.triangles,
+            bestAll * 1e6, bestCulled * 1e6);
+
+        if (all.size() > maxNodes)
+            return Fail(std::to_string(all.size()) + " nodes selected, more than MaxSelectedNodes");
+        if (std::string e = CheckSelection(tree, c.eye, all); !e.empty())
+            return Fail(e);
+        if (std::string e = CheckCulled(tree, frustum, all, culled); !e.empty())
+            return Fail(e);
+    }
+
+    // fly low across the map like Terrain::Page does every frame
+    TerrainTileCache tiles;
+    tiles.Reset(maxNodes + maxNodes / 2);
+    const uint32_t side = TerrainTileCache::TileSide(s.patchDim);
+    std::vector<uint16_t> tile(size_t(side) * side);
+    std::vector<uint32_t> slices, fills;
+    const int frames = 600;
+    size_t peakFills = 0;
+    double paging = 0.0;
+    for (int f = 0; f < frames; ++f) {
+        const float t = float(f) / float(frames - 1);
+        const float eye[3] = { extent * (0.1f + 0.8f * t), 120.f, extent * (0.5f + 0.3f * std::sin(t * 6.f)) };
+        tree.Select(eye, nullptr, all);
+
+        const auto t0 = std::chrono::steady_clock::now();
+        if (!tiles.Assign(all, slices, fills))
+            return Fail("selection does not fit the tile cache");
+        for (uint32_t i : fills) {
+            const Node& n = all[i];
+            TerrainTileCache::Extract(heights.data(), size, size, s.patchDim, n.level, n.nx, n.nz, tile.data());
+        }
+        paging += Seconds(t0);
+        peakFills = std::max(peakFills, fills.size());
+
+        std::vector<uint32_t> sorted = slices;
+        std::sort(sorted.begin(), sorted.end());
+        if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+            return Fail("two nodes of one frame share a tile slice");
+        if (f == 0 && fills.size() != all.size())
+            return Fail("first frame did not fill every tile");
+    }
+
+    // sample (1, 1) is the node corner, samples step by the level's stride
+    for (const Node& n : all) {
+        TerrainTileCache::Extract(heights.data(), size, size, s.patchDim, n.level, n.nx, n.nz, tile.data());
+        const uint32_t stride = 1u << n.level;
+        for (uint32_t j = 1; j + 1 < side; j += s.patchDim / 2) {
+            for (uint32_t i = 1; i + 1 < side; i += s.patchDim / 2) {
+                const uint32_t x = std::min(size - 1, (n.nx * s.patchDim + i - 1) * stride);
+                const uint32_t z = std::min(size - 1, (n.nz * s.patchDim + j - 1) * stride);
+                if (tile[size_t(j) * side + i] != heights[size_t(z) * size + x])
+                    return Fail("tile sample does not hold the height of its texel");
+            }
+        }
+    }
+
+    const TerrainTileCache::Stats ts = tiles.GetStats();
+    std::printf("select, mean over cameras: %.1f us unculled, %.1f us culled\n",
+        selectAll / std::size(cameras) * 1e6, selectCulled / std::size(cameras) * 1e6);
+    std::printf("paging over %d frames: %u tiles of %ux%u (%.1f KB), %llu fills, peak %zu per frame, %.1f us per frame\n",
+        frames, ts.capacity, side, side, ts.capacity * side * side * 2 / 1024.0,
+        (unsigned long long)ts.fills, peakFills, paging / frames * 1e6);
+    std::printf("all checks passed\n");
+    return 0;
+}
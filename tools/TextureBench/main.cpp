@@ -0,0 +1,581 @@
+// Headless texture processing benchmark: decodes images with the engine's
+// ImageCodec and times the stages the loader runs on them, mip generation
+// and block compression, checking that the SIMD paths produce the same
+// bytes as the scalar ones. The codec section times ImageCodec against
+// stb_image on the same file bytes and checks the PNG fast path, with and
+// without SIMD, gives the pixels stb_image does. Compression reports PSNR of level 0 against
+// the uncompressed mip and the size against the RGBA8 chain. The load
+// comparison times what the loader does with an image file (decode, mips,
+// encode) against mapping the same content as a DDS and copying its levels
+// into upload footprints, and checks the DDS and KTX2 parsers against it.
+// The decode section runs batches of the image files through ImageDecoder
+// at each concurrency up to the thread count, decode alone and the whole
+// decode, mips and encode pipeline. The atlas section packs every level of
+// the images small enough for a TextureAtlas as a texture of its own and
+// reports how much of the pages they fill and how long packing and page
+// builds take. The dedup section hashes the files and their decoded pixels
+// like the loader does and lists the images that would share a texture,
+// with the video memory that saves; run it on every image of a model set.
+//
+//   TextureBench <image>... [--iterations <n>] [--normal | --linear]
+//
+// Without images it runs on a generated 2048x2048 pattern.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "BlockCompress.h"
+#include "Hash128.h"
+#include "ImageCodec.h"
+#include "ImageDecoder.h"
+#include "JobSystem.h"
+#include "MipGenerator.h"
+#include "TextureAtlas.h"
+#include "TextureFile.h"
+
+namespace
+{
+    struct Image
+    {
+        std::string name;
+        std::string path;       // empty for the generated pattern
+        uint32_t width = 0, height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    Image Pattern(uint32_t size)
+    {
+        Image image;
+        image.name = "pattern " + std::to_string(size);
+        image.width = image.height = size;
+        image.rgba.resize(size_t(size) * size * 4);
+        uint32_t seed = 0x9E3779B9u;
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                seed = seed * 1664525u + 1013904223u;
+                uint8_t* p = &image.rgba[(size_t(y) * size + x) * 4];
+                // bricks with noise, the kind of detail that aliases without mips
+                const bool mortar = (y % 32) < 3 || ((x + (y / 32 % 2) * 32) % 64) < 3;
+                p[0] = uint8_t(mortar ? 200 : 140 + (seed >> 27));
+                p[1] = uint8_t(mortar ? 200 : 60 + (seed >> 28));
+                p[2] = uint8_t(mortar ? 190 : 40 + (seed >> 29));
+                p[3] = 255;
+            }
+        }
+        return image;
+    }
+
+    const char* FilterName(MipGenerator::Filter filter)
+    {
+        return filter == MipGenerator::Filter::Box ? "box" : "kaiser";
+    }
+
+    void BenchMips(const Image& image, MipGenerator::Content content, int iterations)
+    {
+        for (MipGenerator::Filter filter : { MipGenerator::Filter::Box, MipGenerator::Filter::Kaiser }) {
+            MipGenerator::Chain chains[2];
+            double best[2] = { 1e30, 1e30 };
+            for (int simd = 0; simd < 2; ++simd) {
+                MipGenerator::Settings settings;
+                settings.filter = filter;
+                settings.content = content;
+                settings.simd = simd != 0;
+                for (int i = 0; i < iterations; ++i) {
+                    MipGenerator::Stats stats;
+                    chains[simd] = MipGenerator::Generate(image.rgba.data(), image.width, image.height, settings, &stats);
+                    best[simd] = std::min(best[simd], stats.seconds);
+                }
+            }
+            const double mpix = double(image.width) * image.height * 1e-6;
+            std::printf("%-28s %5ux%-5u %7s %3u %9.2fms %8.1f %9.2fms %8.1f %6.2fx  %s\n",
+                image.name.c_str(), image.width, image.height, FilterName(filter), chains[1].LevelCount(),
+                best[0] * 1000.0, mpix / best[0], best[1] * 1000.0, mpix / best[1], best[0] / best[1],
+                chains[0].pixels == chains[1].pixels ? "same" : "DIFFERENT");
+        }
+    }
+
+    struct Candidate
+    {
+        BlockCompress::Format format;
+        uint8_t channels[2];
+    };
+
+    // what the loader would pick for the content, and the alternatives
+    std::vector<Candidate> CandidatesFor(MipGenerator::Content content)
+    {
+        using BlockCompress::Format;
+        switch (content) {
+        case MipGenerator::Content::NormalMap: return { { Format::BC5, { 0, 1 } }, { Format::BC1, { 0, 1 } } };
+        case MipGenerator::Content::Linear: return { { Format::BC5, { 1, 2 } }, { Format::BC4, { 1, 1 } } };
+        default: return { { Format::BC7, { 0, 1 } }, { Format::BC1, { 0, 1 } }, { Format::BC3, { 0, 1 } } };
+        }
+    }
+
+    void BenchCompress(const Image& image, MipGenerator::Content content, int iterations)
+    {
+        if (!BlockCompress::CanCompress(image.width, image.height)) {
+            std::printf("%-28s not a multiple of 4, stays RGBA8\n", image.name.c_str());
+            return;
+        }
+        MipGenerator::Settings mipSettings;
+        mipSettings.content = content;
+        const MipGenerator::Chain mips = MipGenerator::Generate(image.rgba.data(), image.width, image.height, mipSettings);
+        const double mpix = double(mips.pixels.size() / 4) * 1e-6;
+
+        for (const Candidate& candidate : CandidatesFor(content)) {
+            for (BlockCompress::Quality quality : { BlockCompress::Quality::Fast, BlockCompress::Quality::High }) {
+                BlockCompress::Settings settings;
+                settings.format = candidate.format;
+                settings.quality = quality;
+                settings.channels[0] = candidate.channels[0];
+                settings.channels[1] = candidate.channels[1];
+
+                BlockCompress::Chain chains[2];
+                BlockCompress::Stats stats;
+                double best[2] = { 1e30, 1e30 };
+                for (int simd = 0; simd < 2; ++simd) {
+                    settings.simd = simd != 0;
+                    for (int i = 0; i < iterations; ++i) {
+                        chains[simd] = BlockCompress::Compress(mips, settings, &stats);
+                        best[simd] = std::min(best[simd], stats.seconds);
+                    }
+                }
+
+                const std::vector<uint8_t> decoded = BlockCompress::Decompress(chains[1], 0);
+                const double psnr = BlockCompress::Psnr(mips.Level(0), decoded.data(), size_t(mips.width) * mips.height,
+                    BlockCompress::ChannelMask(chains[1]));
+                std::printf("%-28s %4s %-4s %9.1fms %8.2f %6.2fx %7.2fdB %9.1f %9.1f %5.1fx  %s\n",
+                    image.name.c_str(), BlockCompress::FormatName(candidate.format),
+                    quality == BlockCompress::Quality::Fast ? "fast" : "high",
+                    best[1] * 1000.0, mpix / best[1], best[0] / best[1], psnr,
+                    stats.bytesIn / 1024.0, stats.bytesOut / 1024.0, double(stats.bytesIn) / double(stats.bytesOut),
+                    chains[0].data == chains[1].data ? "same" : "DIFFERENT");
+            }
+        }
+    }
+
+    double Seconds(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    // KTX2 of the chain in memory, to run the second parser on the same levels
+    std::vector<uint8_t> Ktx2(const BlockCompress::Chain& chain)
+    {
+        const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+        const uint32_t vkFormat = chain.format == BlockCompress::Format::BC1 ? 133 : chain.format == BlockCompress::Format::BC3 ? 137
+            : chain.format == BlockCompress::Format::BC4 ? 139 : chain.format == BlockCompress::Format::BC5 ? 141 : 145;
+        const uint32_t header[17] = { vkFormat, 1, chain.width, chain.height, 0, 0, 1, chain.LevelCount(), 0 };
+        std::vector<uint8_t> out(sizeof(identifier) + sizeof(header) + size_t(chain.LevelCount()) * 24);
+        memcpy(out.data(), identifier, sizeof(identifier));
+        memcpy(out.data() + sizeof(identifier), header, sizeof(header));
+        const size_t dataStart = out.size();
+        // levels smallest first in the file, as KTX2 writers store them
+        std::vector<uint64_t> offsets(chain.LevelCount());
+        size_t at = dataStart;
+        for (uint32_t l = chain.LevelCount(); l-- > 0;) {
+            offsets[l] = at;
+            at += (l + 1 < chain.LevelCount() ? chain.offsets[l + 1] : chain.data.size()) - chain.offsets[l];
+        }
+        for (uint32_t l = 0; l < chain.LevelCount(); ++l) {
+            const uint64_t length = (l + 1 < chain.LevelCount() ? chain.offsets[l + 1] : chain.data.size()) - chain.offsets[l];
+            const uint64_t entry[3] = { offsets[l], length, length };
+            memcpy(out.data() + sizeof(identifier) + sizeof(header) + size_t(l) * 24, entry, sizeof(entry));
+        }
+        out.resize(at);
+        for (uint32_t l = 0; l < chain.LevelCount(); ++l) {
+            const size_t length = (l + 1 < chain.LevelCount() ? chain.offsets[l + 1] : chain.data.size()) - chain.offsets[l];
+            memcpy(out.data() + offsets[l], chain.Level(l), length);
+        }
+        return out;
+    }
+
+    // the parsed levels are the chain's bytes, the footprints keep the copy rules
+    bool Matches(const TextureFile& file, const BlockCompress::Chain& chain)
+    {
+        if (file.Width() != chain.width || file.Height() != chain.height || file.LevelCount() != chain.LevelCount() ||
+            file.GetFormat() != TextureFile::FromBlockFormat(chain.format))
+            return false;
+        for (uint32_t l = 0; l < chain.LevelCount(); ++l) {
+            const size_t length = (l + 1 < chain.LevelCount() ? chain.offsets[l + 1] : chain.data.size()) - chain.offsets[l];
+            if (file.GetLevel(l).size != length || memcmp(file.LevelData(l), chain.Level(l), length) != 0)
+                return false;
+        }
+        std::vector<TextureFile::Footprint> footprints;
+        const uint64_t total = TextureFile::PlaceFootprints(file.GetFormat(), file.Width(), file.Height(), file.LevelCount(), footprints);
+        uint64_t end = 0;
+        for (uint32_t l = 0; l < file.LevelCount(); ++l) {
+            const TextureFile::Footprint& fp = footprints[l];
+            if (fp.offset % 512 || fp.rowPitch % 256 || fp.rowPitch < fp.rowBytes || fp.offset < end ||
+                fp.width % 4 || fp.height % 4 || fp.rows != fp.height / 4 || fp.rowBytes != file.GetLevel(l).rowBytes)
+                return false;
+            end = fp.offset + uint64_t(fp.rowPitch) * (fp.rows - 1) + fp.rowBytes;
+        }
+        return end == total;
+    }
+
+    // the file decoded from memory by stb_image and by ImageCodec, which
+    // takes the PNG fast path when it can
+    void BenchCodec(const Image& image, int iterations)
+    {
+        if (image.path.empty())
+            return;
+        std::ifstream in(image.path, std::ios::binary);
+        const std::vector<uint8_t> file{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+        uint32_t w = 0, h = 0;
+        const bool fast = [&] {
+            uint8_t* data = ImageCodec::DecodePng(file.data(), file.size(), w, h);
+            stbi_image_free(data);
+            return data != nullptr;
+        }();
+
+        double stb = 1e30, codec = 1e30, scalar = 1e30;
+        bool same = true;
+        for (int i = 0; i < iterations; ++i) {
+            int sw = 0, sh = 0, comp = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            stbi_uc* reference = stbi_load_from_memory(file.data(), int(file.size()), &sw, &sh, &comp, 4);
+            stb = std::min(stb, Seconds(t0));
+
+            int cw = 0, ch = 0;
+            t0 = std::chrono::steady_clock::now();
+            uint8_t* decoded = ImageCodec::LoadFromMemory(file.data(), file.size(), &cw, &ch);
+            codec = std::min(codec, Seconds(t0));
+            same = same && reference && decoded && sw == cw && sh == ch
+                && std::memcmp(reference, decoded, size_t(sw) * sh * 4) == 0;
+            stbi_image_free(decoded);
+
+            if (fast) {
+                t0 = std::chrono::steady_clock::now();
+                decoded = ImageCodec::DecodePng(file.data(), file.size(), w, h, false);
+                scalar = std::min(scalar, Seconds(t0));
+                same = same && decoded && std::memcmp(reference, decoded, size_t(w) * h * 4) == 0;
+                stbi_image_free(decoded);
+            }
+            stbi_image_free(reference);
+        }
+
+        const double mpix = double(image.width) * image.height / 1e6;
+        std::printf("%-28s %-9s %9.2fms %8.1f %9.2fms %8.1f ", image.name.c_str(), fast ? "png fast" : "stb_image",
+            stb * 1000.0, mpix / stb, codec * 1000.0, mpix / codec);
+        if (fast)
+            std::printf("%9.2fms %8.1f", scalar * 1000.0, mpix / scalar);
+        else
+            std::printf("%11s %8s", "-", "-");
+        std::printf(" %7.2fx  %s\n", stb / codec, same ? "same" : "DIFFERENT");
+    }
+
+    void BenchLoad(const Image& image, MipGenerator::Content content, int iterations)
+    {
+        if (!BlockCompress::CanCompress(image.width, image.height)) {
+            std::printf("%-28s not a multiple of 4, stays a runtime decode\n", image.name.c_str());
+            return;
+        }
+        const BlockCompress::Settings bc = BlockCompress::SettingsFor(content);
+        MipGenerator::Settings mipSettings;
+        mipSettings.content = content;
+
+        // the loader without a container: the file read and decoded, mips, encode
+        double decode = 1e30, mips = 1e30, encode = 1e30;
+        BlockCompress::Chain chain;
+        for (int i = 0; i < iterations; ++i) {
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<uint8_t> rgba;
+            if (!image.path.empty()) {
+                int w = 0, h = 0;
+                uint8_t* data = ImageCodec::Load(image.path.c_str(), &w, &h);
+                rgba.assign(data, data + size_t(w) * h * 4);
+                stbi_image_free(data);
+                decode = std::min(decode, Seconds(t0));
+            }
+            else {
+                rgba = image.rgba;
+                decode = 0.0;
+            }
+            t0 = std::chrono::steady_clock::now();
+            const MipGenerator::Chain chainRgba = MipGenerator::Generate(rgba.data(), image.width, image.height, mipSettings);
+            mips = std::min(mips, Seconds(t0));
+            t0 = std::chrono::steady_clock::now();
+            chain = BlockCompress::Compress(chainRgba, bc);
+            encode = std::min(encode, Seconds(t0));
+        }
+
+        const std::string dds = (std::filesystem::temp_directory_path() / "TextureBench.dds").string();
+        if (!TextureFile::Save(dds, chain)) {
+            std::printf("%-28s cannot write %s\n", image.name.c_str(), dds.c_str());
+            return;
+        }
+
+        // with one: map, parse, lay out and fill the upload buffer
+        double open = 1e30, copy = 1e30;
+        std::vector<uint8_t> upload;
+        bool same = true;
+        for (int i = 0; i < iterations; ++i) {
+            auto t0 = std::chrono::steady_clock::now();
+            TextureFile file;
+            same = file.Open(dds) && same;
+            open = std::min(open, Seconds(t0));
+            t0 = std::chrono::steady_clock::now();
+            std::vector<TextureFile::Footprint> footprints;
+            upload.resize(size_t(TextureFile::PlaceFootprints(file.GetFormat(), file.Width(), file.Height(), file.LevelCount(), footprints)));
+            file.CopyLevels(upload.data(), footprints.data());
+            copy = std::min(copy, Seconds(t0));
+            if (i == 0) same = same && Matches(file, chain);
+        }
+        std::filesystem::remove(dds);
+
+        const std::vector<uint8_t> ktx2 = Ktx2(chain);
+        TextureFile parsed;
+        same = same && parsed.Parse(ktx2.data(), ktx2.size()) && Matches(parsed, chain);
+
+        const double fromImage = decode + mips + encode, fromDds = open + copy;
+        std::printf("%-28s %4s %9.2fms %9.2fms %9.2fms %9.2fms %9.3fms %9.3fms %9.3fms %7.0fx  %s\n",
+            image.name.c_str(), BlockCompress::FormatName(bc.format), decode * 1000.0, mips * 1000.0, encode * 1000.0,
+            fromImage * 1000.0, open * 1000.0, copy * 1000.0, fromDds * 1000.0, fromImage / fromDds,
+            same ? "same" : "DIFFERENT");
+    }
+
+    // images decoded per second with 1..n requests running at once; the
+    // files are read up front so the batch measures decoding, not the disk
+    void BenchDecode(const std::vector<Image>& images, MipGenerator::Content content, int iterations)
+    {
+        std::vector<std::vector<uint8_t>> files;
+        uint64_t pixels = 0;
+        for (const Image& image : images) {
+            if (image.path.empty()) continue;
+            std::ifstream in(image.path, std::ios::binary);
+            files.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            pixels += uint64_t(image.width) * image.height;
+        }
+        if (files.empty()) {
+            std::printf("needs image files\n");
+            return;
+        }
+        // enough requests per batch to keep every thread busy
+        const unsigned threads = JobSystem::I().WorkerCount() + 1;
+        const size_t batch = std::max<size_t>(files.size(), size_t(threads) * 4 / files.size() * files.size());
+        pixels *= batch / files.size();
+
+        ImageDecoder& decoder = ImageDecoder::I();
+        for (ImageDecoder::Stage stage : { ImageDecoder::Stage::Decode, ImageDecoder::Stage::Compress }) {
+            double base = 0.0;
+            for (unsigned concurrent = 1; concurrent <= threads; ++concurrent) {
+                decoder.SetLimits(1ull << 30, concurrent);
+                double best = 1e30;
+                bool ok = true;
+                for (int i = 0; i < iterations; ++i) {
+                    const auto t0 = std::chrono::steady_clock::now();
+                    std::vector<ImageDecoder::Ticket> tickets;
+                    for (size_t r = 0; r < batch; ++r) {
+                        ImageDecoder::Request request;
+                        request.encoded = files[r % files.size()];
+                        request.stage = stage;
+                        request.mips.content = content;
+                        request.compress = BlockCompress::SettingsFor(content);
+                        tickets.push_back(decoder.Submit(std::move(request)));
+                    }
+                    for (ImageDecoder::Ticket& ticket : tickets)
+                        ok = ticket.Wait().ok && ok;
+                    best = std::min(best, Seconds(t0));
+                }
+                if (concurrent == 1) base = best;
+                std::printf("%-10s %10u %8zu %9.1fms %9.1f %9.1f %7.2fx  %s\n",
+                    stage == ImageDecoder::Stage::Decode ? "decode" : "pipeline", concurrent, batch, best * 1000.0,
+                    batch / best, pixels / best / 1e6, base / best, ok ? "ok" : "FAILED");
+            }
+        }
+        decoder.SetLimits(256ull << 20);
+        const ImageDecoder::Stats stats = decoder.GetStats();
+        // every ticket is gone, so nothing may stay reserved
+        std::printf("%llu requests, peak %.1f MB reserved, %.1f MB left\n", (unsigned long long)stats.submitted,
+            stats.peakBytesInFlight / (1024.0 * 1024.0), stats.bytesInFlight / (1024.0 * 1024.0));
+    }
+
+    void BenchAtlas(const std::vector<Image>& images, MipGenerator::Content content, int iterations)
+    {
+        MipGenerator::Settings mipSettings;
+        mipSettings.content = content;
+        const TextureAtlas probe(TextureAtlas::Settings{});
+        std::vector<MipGenerator::Chain> textures;
+        for (const Image& image : images) {
+            const MipGenerator::Chain chain = MipGenerator::Generate(image.rgba.data(), image.width, image.height, mipSettings);
+            for (uint32_t l = 0; l < chain.LevelCount(); ++l)
+                if (probe.Fits(chain.LevelWidth(l), chain.LevelHeight(l)))
+                    textures.push_back(MipGenerator::Generate(chain.Level(l), chain.LevelWidth(l), chain.LevelHeight(l), mipSettings));
+        }
+        if (textures.empty()) {
+            std::printf("no level fits\n");
+            return;
+        }
+
+        for (bool compress : { false, true }) {
+            TextureAtlas::Settings settings;
+            settings.compress = compress;
+            settings.bc = BlockCompress::SettingsFor(content);
+            double bestAdd = 1e30, bestBuild = 1e30;
+            TextureAtlas::Stats stats;
+            for (int i = 0; i < iterations; ++i) {
+                TextureAtlas atlas(settings);
+                auto t0 = std::chrono::steady_clock::now();
+                for (const MipGenerator::Chain& texture : textures)
+                    atlas.Add(texture);
+                bestAdd = std::min(bestAdd, Seconds(t0));
+                t0 = std::chrono::steady_clock::now();
+                for (uint32_t page = 0; page < atlas.PageCount(); ++page) {
+                    if (compress) atlas.BuildBlocks(page);
+                    else atlas.BuildPixels(page);
+                }
+                bestBuild = std::min(bestBuild, Seconds(t0));
+                stats = atlas.GetStats();
+            }
+            std::printf("%-6s %8u %6u %9.1f%% %9.1f%% %9.1fms %9.1fms %9.1f %11u\n",
+                compress ? BlockCompress::FormatName(settings.bc.format) : "RGBA8", stats.entries, stats.pages,
+                stats.Efficiency() * 100.0, double(stats.usedTexels) / double(stats.pageTexels) * 100.0,
+                bestAdd * 1000.0, bestBuild * 1000.0, stats.pageBytes / (1024.0 * 1024.0), stats.entries - stats.pages);
+        }
+    }
+
+    void BenchDedup(const std::vector<Image>& images, int iterations)
+    {
+        struct Hashed
+        {
+            Hash128 file, pixels;
+            uint64_t fileBytes = 0;
+        };
+        std::vector<Hashed> hashed(images.size());
+        std::vector<std::vector<uint8_t>> files(images.size());
+        uint64_t fileBytes = 0, pixelBytes = 0;
+        for (size_t i = 0; i < images.size(); ++i) {
+            if (images[i].path.empty())
+                continue;
+            std::ifstream in(images[i].path, std::ios::binary);
+            files[i].assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            fileBytes += files[i].size();
+            pixelBytes += images[i].rgba.size();
+        }
+
+        double bestFile = 1e30, bestPixels = 1e30;
+        for (int it = 0; it < iterations; ++it) {
+            auto t0 = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < images.size(); ++i)
+                hashed[i].file = HashBytes(files[i].data(), files[i].size());
+            bestFile = std::min(bestFile, Seconds(t0));
+            t0 = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < images.size(); ++i)
+                hashed[i].pixels = ImageDecoder::HashPixels(images[i].rgba.data(), images[i].width, images[i].height);
+            bestPixels = std::min(bestPixels, Seconds(t0));
+        }
+
+        // the first image with a hash is loaded, the later ones share it
+        uint32_t fileHits = 0, pixelHits = 0;
+        uint64_t rgbaSaved = 0, bcSaved = 0;
+        for (size_t i = 0; i < images.size(); ++i) {
+            const Image& image = images[i];
+            for (size_t j = 0; j < i; ++j) {
+                const bool file = !files[i].empty() && hashed[j].file == hashed[i].file;
+                if (!file && hashed[j].pixels != hashed[i].pixels)
+                    continue;
+                ++(file ? fileHits : pixelHits);
+                MipGenerator::Chain chain = MipGenerator::Generate(image.rgba.data(), image.width, image.height, {});
+                const uint64_t rgba = chain.pixels.size();
+                const uint64_t bc = BlockCompress::CanCompress(image.width, image.height)
+                    ? BlockCompress::Compress(chain).data.size() : rgba;
+                rgbaSaved += rgba;
+                bcSaved += bc;
+                std::printf("%-28s same %-6s as %s\n", image.name.c_str(), file ? "file" : "pixels", images[j].name.c_str());
+                break;
+            }
+        }
+        std::printf("%zu images, %u duplicates (%u files, %u pixels); saves %.2f MB RGBA8 chains, %.2f MB BC7\n",
+            images.size(), fileHits + pixelHits, fileHits, pixelHits, rgbaSaved / 1048576.0, bcSaved / 1048576.0);
+        std::printf("hashing: files %.0f MB/s, pixels %.0f MB/s\n",
+            fileBytes / 1048576.0 / std::max(bestFile, 1e-9), pixelBytes / 1048576.0 / std::max(bestPixels, 1e-9));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    int iterations = 5;
+    MipGenerator::Content content = MipGenerator::Content::Color;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--iterations" && i + 1 < argc) iterations = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--normal") content = MipGenerator::Content::NormalMap;
+        else if (a == "--linear") content = MipGenerator::Content::Linear;
+        else if (a[0] != '-') paths.push_back(a);
+        else {
+            std::fprintf(stderr, "usage: TextureBench <image>... [--iterations <n>] [--normal | --linear]\n");
+            return 2;
+        }
+    }
+
+    std::vector<Image> images;
+    for (const std::string& path : paths) {
+        int w = 0, h = 0;
+        uint8_t* data = ImageCodec::Load(path.c_str(), &w, &h);
+        if (!data) {
+            std::fprintf(stderr, "cannot load %s\n", path.c_str());
+            return 1;
+        }
+        Image image;
+        image.name = path.substr(path.find_last_of("/\\") + 1);
+        image.path = path;
+        image.width = uint32_t(w);
+        image.height = uint32_t(h);
+        image.rgba.assign(data, data + size_t(w) * h * 4);
+        stbi_image_free(data);
+        images.push_back(std::move(image));
+    }
+    if (images.empty())
+        images.push_back(Pattern(2048));
+
+    std::printf("mip chains, best of %d, %u workers; Mpix/s of level 0\n", iterations, JobSystem::I().WorkerCount() + 1);
+    std::printf("%-28s %11s %7s %3s %11s %8s %11s %8s %7s\n",
+        "image", "size", "filter", "mip", "scalar", "Mpix/s", "simd", "Mpix/s", "speedup");
+    for (const Image& image : images)
+        BenchMips(image, content, iterations);
+
+    std::printf("\nblock compression of the Kaiser chain, best of %d; Mpix/s of the whole chain\n", iterations);
+    std::printf("%-28s %4s %-4s %11s %8s %7s %9s %9s %9s %6s\n",
+        "image", "fmt", "mode", "simd", "Mpix/s", "vs sc.", "PSNR", "RGBA8 KB", "BC KB", "ratio");
+    for (const Image& image : images)
+        BenchCompress(image, content, iterations);
+
+    std::printf("\nimage decode from memory, best of %d; stb_image against ImageCodec, and the PNG fast path without SIMD\n", iterations);
+    std::printf("%-28s %-9s %11s %8s %11s %8s %11s %8s %8s\n",
+        "image", "path", "stb_image", "Mpix/s", "codec", "Mpix/s", "scalar", "Mpix/s", "speedup");
+    for (const Image& image : images)
+        BenchCodec(image, iterations);
+
+    std::printf("\nload to a filled upload buffer, best of %d, warm file cache; image file vs DDS of the same levels\n", iterations);
+    std::printf("%-28s %4s %11s %11s %11s %11s %11s %11s %11s %8s\n",
+        "image", "fmt", "decode", "mips", "encode", "total", "dds open", "copy", "total", "speedup");
+    for (const Image& image : images)
+        BenchLoad(image, content, iterations);
+
+    std::printf("\nImageDecoder batches, best of %d, from memory; scaling against one request at a time\n", iterations);
+    std::printf("%-10s %10s %8s %11s %9s %9s %8s\n",
+        "stage", "concurrent", "images", "time", "images/s", "Mpix/s", "scaling");
+    BenchDecode(images, content, iterations);
+
+    std::printf("\ntexture atlas of the levels up to %u texels as textures, best of %d\n", TextureAtlas::Settings{}.maxSize, iterations);
+    std::printf("%-6s %8s %6s %10s %10s %11s %11s %9s %11s\n",
+        "format", "textures", "pages", "content", "rects", "add", "build", "page MB", "SRVs saved");
+    BenchAtlas(images, content, iterations);
+
+    std::printf("\ncontent dedup, hashes as the loader takes them; best of %d\n", iterations);
+    BenchDedup(images, iterations);
+    return 0;
+}